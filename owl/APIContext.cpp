@@ -17,21 +17,6 @@
 #include "APIContext.h"
 #include "APIHandle.h"
 
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
   
 namespace owl {
   
@@ -46,11 +31,11 @@ namespace owl {
 
   void APIContext::releaseAll()
   {
-    LOG("#owl: context is dying; number of API handles (other than context itself) "
+    OWL_LOG_INFO("context is dying; number of API handles (other than context itself) "
         << "that have not yet been released: "
         << (activeHandles.size()-1));
     for (auto handle : activeHandles)
-      LOG(" - " + handle->toString());
+      OWL_LOG_INFO(" - " + handle->toString());
 
     // create a COPY of the handles we need to destroy, else
     // destroying the handles modifies the std::set while we're
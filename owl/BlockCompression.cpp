@@ -0,0 +1,676 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "BlockCompression.h"
+#include "owl/common/parallel/parallel_for.h"
+#include <algorithm>
+#include <math.h>
+#include <limits>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && !defined(__CUDACC__)
+# include <immintrin.h>
+# define OWL_HAVE_SSE2_BC 1
+#endif
+
+namespace owl {
+  namespace bc {
+
+    /*! number of rows of blocks each parallel task encodes */
+    enum { BLOCK_ROWS_PER_TASK = 4 };
+
+    size_t bytesPerBlock(OWLTexelFormat format)
+    {
+      switch (format) {
+      case OWL_TEXEL_FORMAT_BC1:
+      case OWL_TEXEL_FORMAT_BC4: return 8;
+      case OWL_TEXEL_FORMAT_BC5:
+      case OWL_TEXEL_FORMAT_BC7: return 16;
+      default:
+        throw std::runtime_error("not a block compressed texel format");
+      }
+    }
+
+    /*! the 4x4 RGBA8 texels of one block */
+    typedef vec4uc Texels[16];
+
+    // ------------------------------------------------------------------
+    // fitting a line through a block's texels - shared by BC1 and BC7
+    // ------------------------------------------------------------------
+
+    /*! a block's texels as floats, one array per channel */
+    struct Block {
+      alignas(16) float c[4][16];
+    };
+
+    static inline float clamp255(float f)
+    { return std::min(std::max(f,0.f),255.f); }
+
+    /*! mean and principal axis of the block's texels, considering
+        only the first 'numChannels' channels; the axis is of unit
+        length, or zero for constant blocks */
+    template<int numChannels>
+    static void principalAxis(const Block &block,
+                              float mean[4], float axis[4])
+    {
+      for (int c=0;c<4;c++) {
+        mean[c] = 0.f;
+        axis[c] = 0.f;
+      }
+      for (int c=0;c<numChannels;c++) {
+        float sum = 0.f;
+        for (int i=0;i<16;i++)
+          sum += block.c[c][i];
+        mean[c] = sum*(1.f/16.f);
+      }
+      float cov[4][4];
+      for (int a=0;a<numChannels;a++)
+        for (int b=a;b<numChannels;b++) {
+          float sum = 0.f;
+          for (int i=0;i<16;i++)
+            sum += (block.c[a][i]-mean[a])*(block.c[b][i]-mean[b]);
+          cov[a][b] = cov[b][a] = sum;
+        }
+
+      // power iteration, starting with the covariance row of the
+      // channel that varies most (which can't be orthogonal to the
+      // principal axis)
+      int start = 0;
+      for (int c=1;c<numChannels;c++)
+        if (cov[c][c] > cov[start][start]) start = c;
+      if (cov[start][start] < 1e-3f)
+        return;
+      float v[4] = { 0.f, 0.f, 0.f, 0.f };
+      for (int c=0;c<numChannels;c++)
+        v[c] = cov[start][c];
+      for (int iter=0;iter<8;iter++) {
+        float w[4] = { 0.f, 0.f, 0.f, 0.f };
+        float len2 = 0.f;
+        for (int a=0;a<numChannels;a++) {
+          for (int b=0;b<numChannels;b++)
+            w[a] += cov[a][b]*v[b];
+          len2 += w[a]*w[a];
+        }
+        if (len2 == 0.f)
+          break;
+        const float scale = 1.f/sqrtf(len2);
+        for (int c=0;c<numChannels;c++)
+          v[c] = w[c]*scale;
+      }
+      float len2 = 0.f;
+      for (int c=0;c<numChannels;c++)
+        len2 += v[c]*v[c];
+      if (len2 == 0.f)
+        return;
+      const float scale = 1.f/sqrtf(len2);
+      for (int c=0;c<numChannels;c++)
+        axis[c] = v[c]*scale;
+    }
+
+    /*! initial endpoints: the extent of the block's texels along its
+        principal axis */
+    template<int numChannels>
+    static void initialEndpoints(const Block &block,
+                                 float e0[4], float e1[4])
+    {
+      float mean[4], axis[4];
+      principalAxis<numChannels>(block,mean,axis);
+      float tMin = 0.f, tMax = 0.f;
+      for (int i=0;i<16;i++) {
+        float t = 0.f;
+        for (int c=0;c<numChannels;c++)
+          t += (block.c[c][i]-mean[c])*axis[c];
+        tMin = std::min(tMin,t);
+        tMax = std::max(tMax,t);
+      }
+      for (int c=0;c<4;c++) {
+        e0[c] = clamp255(mean[c]+tMin*axis[c]);
+        e1[c] = clamp255(mean[c]+tMax*axis[c]);
+      }
+    }
+
+    /*! snaps each texel to the closest of the numSteps+1 (evenly
+        spaced) points on the line from e0 to e1, writing the point's
+        index into 'steps'; and returns the squared error of
+        approximating the texels by e0+weights[step]*(e1-e0) (the
+        weights being what the format actually interpolates with,
+        which need not be exactly evenly spaced) */
+    template<int numChannels>
+    static float fitToLine(const Block &block,
+                           const float e0[4], const float e1[4],
+                           int numSteps, const float *weights,
+                           int steps[16])
+    {
+      float d[4] = { 0.f, 0.f, 0.f, 0.f };
+      float dd = 0.f;
+      for (int c=0;c<numChannels;c++) {
+        d[c] = e1[c]-e0[c];
+        dd  += d[c]*d[c];
+      }
+      const float scale = (dd > 0.f) ? numSteps/dd : 0.f;
+#if OWL_HAVE_SSE2_BC
+      const __m128 zero = _mm_setzero_ps();
+      __m128 error = zero;
+      for (int i=0;i<16;i+=4) {
+        __m128 diff[4];
+        __m128 t = zero;
+        for (int c=0;c<numChannels;c++) {
+          diff[c] = _mm_sub_ps(_mm_load_ps(block.c[c]+i),_mm_set1_ps(e0[c]));
+          t = _mm_add_ps(t,_mm_mul_ps(diff[c],_mm_set1_ps(d[c])));
+        }
+        t = _mm_mul_ps(t,_mm_set1_ps(scale));
+        t = _mm_min_ps(_mm_max_ps(t,zero),_mm_set1_ps(float(numSteps)));
+        _mm_storeu_si128((__m128i*)(steps+i),
+                         _mm_cvttps_epi32(_mm_add_ps(t,_mm_set1_ps(.5f))));
+        const __m128 w = _mm_set_ps(weights[steps[i+3]],weights[steps[i+2]],
+                                    weights[steps[i+1]],weights[steps[i+0]]);
+        for (int c=0;c<numChannels;c++) {
+          const __m128 r = _mm_sub_ps(_mm_mul_ps(w,_mm_set1_ps(d[c])),diff[c]);
+          error = _mm_add_ps(error,_mm_mul_ps(r,r));
+        }
+      }
+      alignas(16) float sum[4];
+      _mm_store_ps(sum,error);
+      return (sum[0]+sum[1])+(sum[2]+sum[3]);
+#else
+      float error = 0.f;
+      for (int i=0;i<16;i++) {
+        float diff[4];
+        float t = 0.f;
+        for (int c=0;c<numChannels;c++) {
+          diff[c] = block.c[c][i]-e0[c];
+          t += diff[c]*d[c];
+        }
+        t = std::min(std::max(t*scale,0.f),float(numSteps));
+        steps[i] = int(t+.5f);
+        const float w = weights[steps[i]];
+        for (int c=0;c<numChannels;c++) {
+          const float r = w*d[c]-diff[c];
+          error += r*r;
+        }
+      }
+      return error;
+#endif
+    }
+
+    /*! the endpoints that minimize the squared error for given
+        steps; returns false (and leaves e0/e1 alone) if there are
+        none, ie, if all texels are on the same step */
+    template<int numChannels>
+    static bool leastSquares(const Block &block,
+                             const int steps[16], const float *weights,
+                             float e0[4], float e1[4])
+    {
+      float aa = 0.f, ab = 0.f, bb = 0.f;
+      float x0[4] = { 0.f, 0.f, 0.f, 0.f };
+      float x1[4] = { 0.f, 0.f, 0.f, 0.f };
+      for (int i=0;i<16;i++) {
+        const float b = weights[steps[i]];
+        const float a = 1.f-b;
+        aa += a*a;
+        ab += a*b;
+        bb += b*b;
+        for (int c=0;c<numChannels;c++) {
+          x0[c] += a*block.c[c][i];
+          x1[c] += b*block.c[c][i];
+        }
+      }
+      const float det = aa*bb-ab*ab;
+      if (fabsf(det) < 1e-6f)
+        return false;
+      const float rcpDet = 1.f/det;
+      for (int c=0;c<numChannels;c++) {
+        e0[c] = clamp255((bb*x0[c]-ab*x1[c])*rcpDet);
+        e1[c] = clamp255((aa*x1[c]-ab*x0[c])*rcpDet);
+      }
+      return true;
+    }
+
+    static void toBlock(const Texels texels, Block &block)
+    {
+      for (int i=0;i<16;i++)
+        for (int c=0;c<4;c++)
+          block.c[c][i] = texels[i][c];
+    }
+
+    static inline void writeLE(uint8_t *out, uint64_t value, int numBytes)
+    {
+      for (int i=0;i<numBytes;i++)
+        out[i] = uint8_t(value >> (8*i));
+    }
+
+    static inline uint64_t readLE(const uint8_t *in, int numBytes)
+    {
+      uint64_t value = 0;
+      for (int i=0;i<numBytes;i++)
+        value |= uint64_t(in[i]) << (8*i);
+      return value;
+    }
+
+    // ------------------------------------------------------------------
+    // BC1
+    // ------------------------------------------------------------------
+
+    static const float bc1Weights[4] = { 0.f, 1.f/3.f, 2.f/3.f, 1.f };
+
+    static inline uint16_t toRGB565(const float c[4])
+    {
+      const int r = int(c[0]*(31.f/255.f)+.5f);
+      const int g = int(c[1]*(63.f/255.f)+.5f);
+      const int b = int(c[2]*(31.f/255.f)+.5f);
+      return uint16_t((r << 11) | (g << 5) | b);
+    }
+
+    static inline vec3i fromRGB565(uint16_t v)
+    {
+      const int r = (v >> 11) & 31;
+      const int g = (v >> 5) & 63;
+      const int b = v & 31;
+      return vec3i((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+    }
+
+    struct BC1Candidate {
+      uint16_t c0, c1;
+      int      steps[16];
+      float    error;
+    };
+
+    /*! quantizes given endpoints, and fits the block to those */
+    static void evalBC1(const Block &block, const float e0[4], const float e1[4],
+                        BC1Candidate &candidate)
+    {
+      candidate.c0 = toRGB565(e0);
+      candidate.c1 = toRGB565(e1);
+      const vec3i q0 = fromRGB565(candidate.c0);
+      const vec3i q1 = fromRGB565(candidate.c1);
+      const float f0[4] = { float(q0.x), float(q0.y), float(q0.z), 0.f };
+      const float f1[4] = { float(q1.x), float(q1.y), float(q1.z), 0.f };
+      candidate.error = fitToLine<3>(block,f0,f1,3,bc1Weights,candidate.steps);
+    }
+
+    static void encodeBC1(const Texels texels, uint8_t *out)
+    {
+      Block block;
+      toBlock(texels,block);
+      float e0[4], e1[4];
+      initialEndpoints<3>(block,e0,e1);
+
+      BC1Candidate best, candidate;
+      evalBC1(block,e0,e1,best);
+      for (int iter=0;iter<2;iter++) {
+        if (!leastSquares<3>(block,best.steps,bc1Weights,e0,e1))
+          break;
+        evalBC1(block,e0,e1,candidate);
+        if (candidate.error >= best.error)
+          break;
+        best = candidate;
+      }
+
+      // four-color mode requires c0 > c1; if they are equal all
+      // texels are the same anyway, and index 0 is c0 in either mode
+      uint16_t c0 = best.c0, c1 = best.c1;
+      uint32_t indices = 0;
+      if (c0 != c1) {
+        const bool swapped = c0 < c1;
+        if (swapped) std::swap(c0,c1);
+        // step 0..3 along the line from c0 to c1 -> index
+        static const int indexOfStep[4] = { 0, 2, 3, 1 };
+        for (int i=0;i<16;i++) {
+          const int step = swapped ? 3-best.steps[i] : best.steps[i];
+          indices |= uint32_t(indexOfStep[step]) << (2*i);
+        }
+      }
+      writeLE(out+0,c0,2);
+      writeLE(out+2,c1,2);
+      writeLE(out+4,indices,4);
+    }
+
+    static void decodeBC1(const uint8_t *in, Texels texels)
+    {
+      const uint16_t c0 = (uint16_t)readLE(in+0,2);
+      const uint16_t c1 = (uint16_t)readLE(in+2,2);
+      const uint32_t indices = (uint32_t)readLE(in+4,4);
+      const vec3i p0 = fromRGB565(c0);
+      const vec3i p1 = fromRGB565(c1);
+      vec4uc palette[4];
+      palette[0] = vec4uc(vec3uc(p0),255);
+      palette[1] = vec4uc(vec3uc(p1),255);
+      if (c0 > c1) {
+        palette[2] = vec4uc(vec3uc((2*p0+p1+1)/3),255);
+        palette[3] = vec4uc(vec3uc((p0+2*p1+1)/3),255);
+      } else {
+        palette[2] = vec4uc(vec3uc((p0+p1+1)/2),255);
+        palette[3] = vec4uc(0,0,0,0);
+      }
+      for (int i=0;i<16;i++)
+        texels[i] = palette[(indices >> (2*i)) & 3];
+    }
+
+    // ------------------------------------------------------------------
+    // BC4 (and BC5, which is two BC4 blocks)
+    // ------------------------------------------------------------------
+
+    static void bc4Palette(int r0, int r1, uint8_t palette[8])
+    {
+      palette[0] = uint8_t(r0);
+      palette[1] = uint8_t(r1);
+      if (r0 > r1) {
+        for (int i=1;i<7;i++)
+          palette[i+1] = uint8_t(((7-i)*r0+i*r1+3)/7);
+      } else {
+        for (int i=1;i<5;i++)
+          palette[i+1] = uint8_t(((5-i)*r0+i*r1+2)/5);
+        palette[6] = 0;
+        palette[7] = 255;
+      }
+    }
+
+    /*! encodes channel 'channel' of the texels; always uses the
+        eight-value mode, with the block's min and max as endpoints */
+    static void encodeBC4(const Texels texels, int channel, uint8_t *out)
+    {
+      alignas(16) uint8_t values[16];
+      for (int i=0;i<16;i++)
+        values[i] = texels[i][channel];
+      const uint8_t lo = *std::min_element(values,values+16);
+      const uint8_t hi = *std::max_element(values,values+16);
+      out[0] = hi;
+      out[1] = lo;
+      if (lo == hi) {
+        // (six-value mode, then, but index 0 is still 'hi')
+        writeLE(out+2,0,6);
+        return;
+      }
+      uint8_t palette[8];
+      bc4Palette(hi,lo,palette);
+
+      alignas(16) uint8_t index[16];
+#if OWL_HAVE_SSE2_BC
+      // all 16 texels at once: per palette entry, the absolute
+      // difference, and whether that's smaller than the best so far
+      const __m128i v = _mm_load_si128((const __m128i*)values);
+      __m128i bestDist  = _mm_set1_epi8(-1);
+      __m128i bestIndex = _mm_setzero_si128();
+      for (int i=0;i<8;i++) {
+        const __m128i p = _mm_set1_epi8((char)palette[i]);
+        const __m128i dist = _mm_or_si128(_mm_subs_epu8(v,p),_mm_subs_epu8(p,v));
+        // dist < bestDist <=> max(dist,bestDist) != dist
+        const __m128i notCloser = _mm_cmpeq_epi8(_mm_max_epu8(dist,bestDist),dist);
+        bestIndex = _mm_or_si128(_mm_and_si128(notCloser,bestIndex),
+                                 _mm_andnot_si128(notCloser,_mm_set1_epi8((char)i)));
+        bestDist  = _mm_min_epu8(dist,bestDist);
+      }
+      _mm_store_si128((__m128i*)index,bestIndex);
+#else
+      for (int t=0;t<16;t++) {
+        int bestDist = 256;
+        for (int i=0;i<8;i++) {
+          const int dist = abs(int(values[t])-int(palette[i]));
+          if (dist < bestDist) {
+            bestDist = dist;
+            index[t] = uint8_t(i);
+          }
+        }
+      }
+#endif
+      uint64_t bits = 0;
+      for (int i=0;i<16;i++)
+        bits |= uint64_t(index[i]) << (3*i);
+      writeLE(out+2,bits,6);
+    }
+
+    static void decodeBC4(const uint8_t *in, int channel, Texels texels)
+    {
+      uint8_t palette[8];
+      bc4Palette(in[0],in[1],palette);
+      const uint64_t bits = readLE(in+2,6);
+      for (int i=0;i<16;i++)
+        texels[i][channel] = palette[(bits >> (3*i)) & 7];
+    }
+
+    // ------------------------------------------------------------------
+    // BC7 (mode 6 only)
+    // ------------------------------------------------------------------
+
+    static const int bc7Weights4[16]
+    = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    static const float bc7Weights[16]
+    = { 0/64.f, 4/64.f, 9/64.f, 13/64.f, 17/64.f, 21/64.f, 26/64.f, 30/64.f,
+        34/64.f, 38/64.f, 43/64.f, 47/64.f, 51/64.f, 55/64.f, 60/64.f, 64/64.f };
+
+    struct BC7Candidate {
+      int   q0[4], q1[4]; // 7-bit endpoints
+      int   p0, p1;       // and their p-bits
+      int   steps[16];
+      float error;
+    };
+
+    /*! quantizes given endpoints with each combination of p-bits,
+        and fits the block to those; updates 'best' if any of these
+        is better */
+    static void evalBC7(const Block &block, const float e0[4], const float e1[4],
+                        BC7Candidate &best)
+    {
+      BC7Candidate candidate;
+      for (int p=0;p<4;p++) {
+        candidate.p0 = p & 1;
+        candidate.p1 = p >> 1;
+        float v0[4], v1[4];
+        for (int c=0;c<4;c++) {
+          candidate.q0[c] = std::min(std::max(int((e0[c]-candidate.p0)*.5f+.5f),0),127);
+          candidate.q1[c] = std::min(std::max(int((e1[c]-candidate.p1)*.5f+.5f),0),127);
+          v0[c] = float(2*candidate.q0[c]+candidate.p0);
+          v1[c] = float(2*candidate.q1[c]+candidate.p1);
+        }
+        candidate.error = fitToLine<4>(block,v0,v1,15,bc7Weights,candidate.steps);
+        if (candidate.error < best.error)
+          best = candidate;
+      }
+    }
+
+    /*! writes bits LSB-first into a 128-bit block */
+    struct BitWriter {
+      BitWriter(uint8_t *out) : out(out) { memset(out,0,16); }
+      void put(uint32_t value, int numBits)
+      {
+        for (int i=0;i<numBits;i++,pos++)
+          out[pos >> 3] |= uint8_t(((value >> i) & 1) << (pos & 7));
+      }
+      uint8_t *const out;
+      int            pos { 0 };
+    };
+
+    struct BitReader {
+      BitReader(const uint8_t *in) : in(in) {}
+      uint32_t get(int numBits)
+      {
+        uint32_t value = 0;
+        for (int i=0;i<numBits;i++,pos++)
+          value |= uint32_t((in[pos >> 3] >> (pos & 7)) & 1) << i;
+        return value;
+      }
+      const uint8_t *const in;
+      int                  pos { 0 };
+    };
+
+    static void encodeBC7(const Texels texels, uint8_t *out)
+    {
+      Block block;
+      toBlock(texels,block);
+      float e0[4], e1[4];
+      initialEndpoints<4>(block,e0,e1);
+
+      BC7Candidate best;
+      best.error = std::numeric_limits<float>::infinity();
+      evalBC7(block,e0,e1,best);
+      for (int iter=0;iter<2;iter++) {
+        const float prevError = best.error;
+        if (!leastSquares<4>(block,best.steps,bc7Weights,e0,e1))
+          break;
+        evalBC7(block,e0,e1,best);
+        if (!(best.error < prevError))
+          break;
+      }
+
+      // the first texel's index has only three bits; if its MSB
+      // would be set, swap the endpoints instead
+      if (best.steps[0] >= 8) {
+        for (int c=0;c<4;c++)
+          std::swap(best.q0[c],best.q1[c]);
+        std::swap(best.p0,best.p1);
+        for (int i=0;i<16;i++)
+          best.steps[i] = 15-best.steps[i];
+      }
+
+      BitWriter bits(out);
+      bits.put(1<<6,7);
+      for (int c=0;c<4;c++) {
+        bits.put(best.q0[c],7);
+        bits.put(best.q1[c],7);
+      }
+      bits.put(best.p0,1);
+      bits.put(best.p1,1);
+      bits.put(best.steps[0],3);
+      for (int i=1;i<16;i++)
+        bits.put(best.steps[i],4);
+    }
+
+    static void decodeBC7(const uint8_t *in, Texels texels)
+    {
+      BitReader bits(in);
+      if (bits.get(7) != (1<<6)) {
+        for (int i=0;i<16;i++)
+          texels[i] = vec4uc(255,0,255,255);
+        return;
+      }
+      int e0[4], e1[4];
+      for (int c=0;c<4;c++) {
+        e0[c] = bits.get(7) << 1;
+        e1[c] = bits.get(7) << 1;
+      }
+      const int p0 = bits.get(1);
+      const int p1 = bits.get(1);
+      for (int c=0;c<4;c++) {
+        e0[c] |= p0;
+        e1[c] |= p1;
+      }
+      for (int i=0;i<16;i++) {
+        const int w = bc7Weights4[bits.get(i == 0 ? 3 : 4)];
+        for (int c=0;c<4;c++)
+          texels[i][c] = uint8_t(((64-w)*e0[c]+w*e1[c]+32) >> 6);
+      }
+    }
+
+    // ------------------------------------------------------------------
+    // whole textures
+    // ------------------------------------------------------------------
+
+    /*! fetches the texels of block (bx,by), replicating the last
+        row/column for blocks that extend beyond the texture */
+    static void loadTexels(const uint8_t *rgba8, vec2i size, size_t pitch,
+                           int bx, int by, Texels texels)
+    {
+      for (int iy=0;iy<4;iy++) {
+        const int y = std::min(4*by+iy,size.y-1);
+        const vec4uc *row = (const vec4uc *)(rgba8+y*pitch);
+        for (int ix=0;ix<4;ix++)
+          texels[4*iy+ix] = row[std::min(4*bx+ix,size.x-1)];
+      }
+    }
+
+    void encode(OWLTexelFormat format,
+                const void *rgba8, vec2i size, size_t linePitchInBytes,
+                void *blocks)
+    {
+      if (size.x <= 0 || size.y <= 0)
+        throw std::runtime_error("invalid texture size");
+      const size_t blockSize = bytesPerBlock(format);
+      const size_t pitch
+        = linePitchInBytes ? linePitchInBytes : size_t(size.x)*sizeof(vec4uc);
+      const vec2i count = numBlocks(size);
+
+      const int numTasks = divRoundUp(count.y,(int)BLOCK_ROWS_PER_TASK);
+      parallel_for(numTasks,[&](int taskID){
+          const int by0 = taskID*BLOCK_ROWS_PER_TASK;
+          const int by1 = std::min(by0+(int)BLOCK_ROWS_PER_TASK,count.y);
+          Texels texels;
+          for (int by=by0;by<by1;by++)
+            for (int bx=0;bx<count.x;bx++) {
+              loadTexels((const uint8_t *)rgba8,size,pitch,bx,by,texels);
+              uint8_t *out
+                = (uint8_t *)blocks + (size_t(by)*count.x+bx)*blockSize;
+              switch (format) {
+              case OWL_TEXEL_FORMAT_BC1:
+                encodeBC1(texels,out);
+                break;
+              case OWL_TEXEL_FORMAT_BC4:
+                encodeBC4(texels,0,out);
+                break;
+              case OWL_TEXEL_FORMAT_BC5:
+                encodeBC4(texels,0,out);
+                encodeBC4(texels,1,out+8);
+                break;
+              default:
+                encodeBC7(texels,out);
+              }
+            }
+        });
+    }
+
+    void decode(OWLTexelFormat format,
+                const void *blocks, vec2i size,
+                void *rgba8)
+    {
+      const size_t blockSize = bytesPerBlock(format);
+      const vec2i count = numBlocks(size);
+
+      parallel_for(count.y,[&](int by){
+          Texels texels;
+          for (int bx=0;bx<count.x;bx++) {
+            const uint8_t *in
+              = (const uint8_t *)blocks + (size_t(by)*count.x+bx)*blockSize;
+            switch (format) {
+            case OWL_TEXEL_FORMAT_BC1:
+              decodeBC1(in,texels);
+              break;
+            case OWL_TEXEL_FORMAT_BC4:
+              for (int i=0;i<16;i++) texels[i] = vec4uc(0,0,0,255);
+              decodeBC4(in,0,texels);
+              break;
+            case OWL_TEXEL_FORMAT_BC5:
+              for (int i=0;i<16;i++) texels[i] = vec4uc(0,0,0,255);
+              decodeBC4(in,0,texels);
+              decodeBC4(in+8,1,texels);
+              break;
+            default:
+              decodeBC7(in,texels);
+            }
+            for (int iy=0;iy<4;iy++) {
+              const int y = 4*by+iy;
+              if (y >= size.y) break;
+              vec4uc *row = (vec4uc *)rgba8 + size_t(y)*size.x;
+              for (int ix=0;ix<4;ix++) {
+                const int x = 4*bx+ix;
+                if (x >= size.x) break;
+                row[x] = texels[4*iy+ix];
+              }
+            }
+          }
+        });
+    }
+
+  } // ::owl::bc
+} // ::owl
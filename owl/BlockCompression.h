@@ -0,0 +1,93 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/BlockCompression.h Host-side encoder (and decoder) for
+    the block compressed texel formats.
+
+    All of these store 4x4 texel blocks in 8 (BC1, BC4) or 16 (BC5,
+    BC7) bytes, ie, at 4 or 8 bits per texel rather than RGBA8's 32:
+
+    - BC1: opaque RGB, two RGB565 endpoints and 2-bit indices. Alpha
+      gets dropped.
+    - BC4: a single channel (red), two 8-bit endpoints and 3-bit
+      indices.
+    - BC5: two channels (red and green; eg, normal maps), each stored
+      like BC4.
+    - BC7: RGBA. The encoder only emits mode 6 (a single RGBA line
+      with 7-bit endpoints plus p-bits, and 4-bit indices), which is
+      fast to search and handles smooth content (and alpha) well, but
+      is not as good on blocks with several distinct colors as an
+      encoder that searches all eight modes would be.
+
+    Endpoints come from the block's principal axis and get refined
+    by least squares; index selection and error evaluation use SSE
+    where available, and rows of blocks are encoded in parallel.
+
+    The decoder exists mostly to validate the encoder; for BC7 it
+    only handles mode 6 (others decode to magenta).
+
+    Like MipMap.h, this doesn't depend on CUDA or a Context. */
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+
+namespace owl {
+  namespace bc {
+
+    /*! whether the given format is one of the block compressed
+        ones */
+    inline bool isBlockCompressed(OWLTexelFormat format)
+    {
+      return (format == OWL_TEXEL_FORMAT_BC1 ||
+              format == OWL_TEXEL_FORMAT_BC4 ||
+              format == OWL_TEXEL_FORMAT_BC5 ||
+              format == OWL_TEXEL_FORMAT_BC7);
+    }
+
+    /*! size of one 4x4 block of given format, in bytes */
+    size_t bytesPerBlock(OWLTexelFormat format);
+
+    /*! number of blocks in x and y for a texture of given size */
+    inline vec2i numBlocks(vec2i size)
+    { return vec2i((size.x+3)/4,(size.y+3)/4); }
+
+    /*! number of bytes a texture of given size and format takes,
+        with blocks tightly packed */
+    inline size_t compressedSize(OWLTexelFormat format, vec2i size)
+    {
+      const vec2i blocks = numBlocks(size);
+      return size_t(blocks.x)*size_t(blocks.y)*bytesPerBlock(format);
+    }
+
+    /*! compresses RGBA8 texels into blocks of given format. Blocks
+        are written row by row, tightly packed; for sizes that are
+        not a multiple of four the last row/column of texels gets
+        replicated to fill the border blocks */
+    void encode(OWLTexelFormat format,
+                const void *rgba8, vec2i size, size_t linePitchInBytes,
+                void *blocks);
+
+    /*! decompresses (tightly packed) blocks of given format into
+        (tightly packed) RGBA8 texels. Channels a format doesn't
+        store come out as 0 (and alpha as 255) */
+    void decode(OWLTexelFormat format,
+                const void *blocks, vec2i size,
+                void *rgba8);
+
+  } // ::owl::bc
+} // ::owl
@@ -17,6 +17,7 @@
 #include "Buffer.h"
 #include "Context.h"
 #include "APIHandle.h"
+#include "Profiler.h"
 #include "owl/owl_device_buffer.h"
 
 namespace owl {
@@ -94,7 +95,7 @@ namespace owl {
 
     SetActiveGPU forLifeTime(device);
 
-    CUDA_CALL_NOTHROW(Free(d_pointer));
+    deviceFree(d_pointer);
     d_pointer = nullptr;
   }
   
@@ -118,17 +119,26 @@ namespace owl {
   
   void DeviceBuffer::upload(const void *hostPtr, size_t offset, int64_t count)
   {
+    // timed including the sync, so the bandwidth is what the copies
+    // to all devices actually took
+    OWL_PROFILE_SCOPE_BYTES("DeviceBuffer::upload",
+                            deviceData.size()
+                            * ((count == -1) ? elementCount : count) * sizeOf(type));
     assert(deviceData.size() == context->deviceCount());
     for (auto dd : deviceData)
       dd->as<DeviceBuffer::DeviceData>().uploadAsync(hostPtr, offset, count);
-    CUDA_SYNC_CHECK();
+    if (!context->onNullDevices())
+      CUDA_SYNC_CHECK();
   }
   
   void DeviceBuffer::upload(const int deviceID, const void *hostPtr, size_t offset, int64_t count) 
   {
+    OWL_PROFILE_SCOPE_BYTES("DeviceBuffer::upload",
+                            ((count == -1) ? elementCount : count) * sizeOf(type));
     assert(deviceID < (int)deviceData.size());
     deviceData[deviceID]->as<DeviceBuffer::DeviceData>().uploadAsync(hostPtr, offset, count);
-    CUDA_SYNC_CHECK();
+    if (!context->onNullDevices())
+      CUDA_SYNC_CHECK();
   }
   
 
@@ -148,11 +158,11 @@ namespace owl {
   {
     SetActiveGPU forLifeTime(device);
     if (d_pointer) {
-      CUDA_CALL(Free(d_pointer)); d_pointer = nullptr;
+      deviceFree(d_pointer); d_pointer = nullptr;
     }
 
     if (parent->elementCount)
-      CUDA_CALL(Malloc(&d_pointer,parent->elementCount*sizeof(cudaTextureObject_t)));
+      deviceMalloc(&d_pointer,parent->elementCount*sizeof(cudaTextureObject_t),OWL_MEMORY_BUFFER);
     
   }
   
@@ -173,10 +183,9 @@ namespace owl {
       } else
         hostHandles[i] = nullptr;
 
-    CUDA_CALL(MemcpyAsync((char*)d_pointer + offset, devRep.data(),
-                          devRep.size()*sizeof(devRep[0]),
-                          cudaMemcpyDefault,
-                          device->getStream()));
+    deviceMemcpyAsync((char*)d_pointer + offset, devRep.data(),
+                      devRep.size()*sizeof(devRep[0]),
+                      device->getStream());
   }
   
   void DeviceBuffer::DeviceDataForBuffers::executeResize() 
@@ -184,11 +193,11 @@ namespace owl {
     SetActiveGPU forLifeTime(device);
     
     if (d_pointer) {
-      CUDA_CALL(Free(d_pointer)); d_pointer = nullptr;
+      deviceFree(d_pointer); d_pointer = nullptr;
     }
 
     if (parent->elementCount) {
-      CUDA_CALL(Malloc(&d_pointer,parent->elementCount*sizeof(device::Buffer)));
+      deviceMalloc(&d_pointer,parent->elementCount*sizeof(device::Buffer),OWL_MEMORY_BUFFER);
     }
   }
   
@@ -216,10 +225,9 @@ namespace owl {
         devRep[i].count   = 0;
       }
 
-    CUDA_CALL(MemcpyAsync((char*)d_pointer + offset,devRep.data(),
-                          devRep.size()*sizeof(devRep[0]),
-                          cudaMemcpyDefault,
-                          device->getStream()));
+    deviceMemcpyAsync((char*)d_pointer + offset,devRep.data(),
+                      devRep.size()*sizeof(devRep[0]),
+                      device->getStream());
   }
 
 
@@ -230,10 +238,10 @@ namespace owl {
   {
     SetActiveGPU forLifeTime(device);
     
-    if (d_pointer) { CUDA_CALL(Free(d_pointer)); d_pointer = nullptr; }
+    if (d_pointer) { deviceFree(d_pointer); d_pointer = nullptr; }
 
     if (parent->elementCount)
-      CUDA_CALL(Malloc(&d_pointer,parent->elementCount*sizeof(OptixTraversableHandle)));
+      deviceMalloc(&d_pointer,parent->elementCount*sizeof(OptixTraversableHandle),OWL_MEMORY_BUFFER);
   }
   
   void DeviceBuffer::DeviceDataForGroups::uploadAsync(const void *hostDataPtr, size_t offset, int64_t count) 
@@ -260,10 +268,9 @@ namespace owl {
         devRep[i] = 0;
       }
 
-    CUDA_CALL(MemcpyAsync((char*)d_pointer + offset,devRep.data(),
-                          devRep.size()*sizeof(devRep[0]),
-                          cudaMemcpyDefault,
-                          device->getStream()));
+    deviceMemcpyAsync((char*)d_pointer + offset,devRep.data(),
+                      devRep.size()*sizeof(devRep[0]),
+                      device->getStream());
   }
 
 
@@ -274,22 +281,25 @@ namespace owl {
     SetActiveGPU forLifeTime(device);
     
     if (d_pointer) {
-      CUDA_CALL(Free(d_pointer)); d_pointer = nullptr;
+      deviceFree(d_pointer); d_pointer = nullptr;
     }
 
     if (parent->elementCount) {
-      CUDA_CALL(Malloc(&d_pointer,parent->elementCount*sizeOf(parent->type)));
+      deviceMalloc(&d_pointer,parent->elementCount*sizeOf(parent->type),OWL_MEMORY_BUFFER);
     }
   }
   
   void DeviceBuffer::DeviceDataForCopyableData::uploadAsync(const void *hostDataPtr, size_t offset, int64_t count)
   {
+    const size_t numBytes
+      = ((count == -1) ? parent->elementCount : count)*sizeOf(parent->type);
+    // only enqueues the copy, so no point in recording its bytes here
+    OWL_PROFILE_SCOPE("uploadAsync");
     SetActiveGPU forLifeTime(device);
     
-    CUDA_CALL(MemcpyAsync((char*)d_pointer + offset,hostDataPtr,
-                          ((count == -1) ? parent->elementCount : count)*sizeOf(parent->type),
-                          cudaMemcpyDefault,
-                          device->getStream()));
+    deviceMemcpyAsync((char*)d_pointer + offset,hostDataPtr,
+                      numBytes,
+                      device->getStream());
   }
   
 
@@ -313,14 +323,23 @@ namespace owl {
 
   void HostPinnedBuffer::resize(size_t newElementCount)
   {
+    // on null devices, all memory is host memory, pinned or not
+    const bool onNull = context->onNullDevices();
     if (cudaHostPinnedMem) {
-      CUDA_CALL_NOTHROW(FreeHost(cudaHostPinnedMem));
+      if (onNull)
+        free(cudaHostPinnedMem);
+      else
+        CUDA_CALL_NOTHROW(FreeHost(cudaHostPinnedMem));
       cudaHostPinnedMem = nullptr;
     }
 
     elementCount = newElementCount;
-    if (newElementCount > 0)
-      CUDA_CALL(MallocHost((void**)&cudaHostPinnedMem, sizeInBytes()));
+    if (newElementCount > 0) {
+      if (onNull)
+        cudaHostPinnedMem = malloc(sizeInBytes());
+      else
+        CUDA_CALL(MallocHost((void**)&cudaHostPinnedMem, sizeInBytes()));
+    }
 
     for (auto device : context->getDevices()) {
       getDD(device).d_pointer = cudaHostPinnedMem;
@@ -330,6 +349,8 @@ namespace owl {
   void HostPinnedBuffer::upload(const void *sourcePtr, size_t offset, int64_t count)
   {
     assert(cudaHostPinnedMem);
+    OWL_PROFILE_SCOPE_BYTES("HostPinnedBuffer::upload",
+                            (count == -1) ? sizeInBytes() : count * sizeOf(type));
     memcpy((char*)cudaHostPinnedMem + offset, sourcePtr, (count == -1) ? sizeInBytes() : count * sizeOf(type));
   }
   
@@ -356,14 +377,30 @@ namespace owl {
 
   void ManagedMemoryBuffer::resize(size_t newElementCount)
   {
+    // on null devices, all memory is host memory, managed or not
+    const bool onNull = context->onNullDevices();
+    // managed memory is shared by all devices; it gets accounted for
+    // on the first one
+    MemoryTracker &tracker = context->getDevice(0)->memoryTracker;
     if (cudaManagedMem) {
-      CUDA_CALL_NOTHROW(Free(cudaManagedMem));
+      tracker.freed(cudaManagedMem);
+      if (onNull)
+        free(cudaManagedMem);
+      else
+        CUDA_CALL_NOTHROW(Free(cudaManagedMem));
       cudaManagedMem = 0;
     }
     
     elementCount = newElementCount;
-    if (newElementCount > 0) {
-      CUDA_CALL(MallocManaged((void**)&cudaManagedMem, sizeInBytes()));
+    DeviceAllocator *pool = context->getDevice(0)->allocator.get();
+    if (newElementCount > 0)
+      detail::checkBudget(&tracker,pool,sizeInBytes(),sizeInBytes(),OWL_MEMORY_BUFFER);
+    if (newElementCount > 0 && onNull)
+      cudaManagedMem = malloc(sizeInBytes());
+    else if (newElementCount > 0) {
+      CUDA_CHECK(detail::retryAfterReleasingCache
+                 (pool,[&]{ return cudaMallocManaged((void**)&cudaManagedMem,
+                                                     sizeInBytes()); }));
       unsigned char *mem_end = (unsigned char *)cudaManagedMem + sizeInBytes();
       size_t pageSize = 16*1024*1024;
       int pageID = 0;
@@ -380,23 +417,20 @@ namespace owl {
             cudaError_t rc = cudaMemAdvise((void*)begin, end-begin,
                                            cudaMemAdviseSetPreferredLocation, cudaDevID);
             if (rc != cudaSuccess) {
-#ifndef NDEBUG
               static bool alreadyWarned = false;
               if (!alreadyWarned) {
-                std::cout << OWL_TERMINAL_RED
-                          << "#owl: Warning - error in trying to memadvise a managed "
-                          << "memory buffer: " << cudaGetErrorString(rc)
-                          << " (should be OK, ignoring this)."
-                          << OWL_TERMINAL_DEFAULT << std::endl;
+                OWL_LOG_INFO("Warning - error in trying to memadvise a managed "
+                             << "memory buffer: " << cudaGetErrorString(rc)
+                             << " (should be OK, ignoring this).");
                 alreadyWarned = true;
               }
-#endif
               /* clear this error */cudaGetLastError();
             }
           
           }
         }
     }
+    tracker.allocated(cudaManagedMem,sizeInBytes(),OWL_MEMORY_BUFFER);
     
     for (auto device : context->getDevices())
       getDD(device).d_pointer = cudaManagedMem;
@@ -405,8 +439,14 @@ namespace owl {
   void ManagedMemoryBuffer::upload(const void *hostPtr, size_t offset, int64_t count)
   {
     assert(cudaManagedMem);
-    cudaMemcpy((char*)cudaManagedMem + offset, hostPtr,
-               (count == -1) ? sizeInBytes() : count * sizeOf(type), cudaMemcpyDefault);
+    OWL_PROFILE_SCOPE_BYTES("ManagedMemoryBuffer::upload",
+                            (count == -1) ? sizeInBytes() : count * sizeOf(type));
+    if (context->onNullDevices())
+      memcpy((char*)cudaManagedMem + offset, hostPtr,
+             (count == -1) ? sizeInBytes() : count * sizeOf(type));
+    else
+      cudaMemcpy((char*)cudaManagedMem + offset, hostPtr,
+                 (count == -1) ? sizeInBytes() : count * sizeOf(type), cudaMemcpyDefault);
   }
   
   void ManagedMemoryBuffer::upload(const int deviceID,
@@ -22,22 +22,9 @@
 #include "Texture.h"
 #include "TrianglesGeomGroup.h"
 #include "UserGeomGroup.h"
-
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
+#include "Profiler.h"
+#include "MipMap.h"
+#include "BlockCompression.h"
 
 namespace owl {
 
@@ -74,14 +61,16 @@ namespace owl {
 
   void Context::enablePeerAccess()
   {
-    LOG("enabling peer access ('.'=self, '+'=can access other device)");
+    if (onNullDevices())
+      return;
+    OWL_LOG_INFO("enabling peer access ('.'=self, '+'=can access other device)");
     auto &devices = getDevices();
 
     int deviceCount = int(devices.size());
-    LOG("found " << deviceCount << " CUDA capable devices");
+    OWL_LOG_INFO("found " << deviceCount << " CUDA capable devices");
     for (auto device : devices) 
-      LOG(" - device #" << device->ID << " : " << device->getDeviceName());
-    LOG("enabling peer access:");
+      OWL_LOG_INFO(" - device #" << device->ID << " : " << device->getDeviceName());
+    OWL_LOG_INFO("enabling peer access:");
     
     for (auto device : devices) {
       std::stringstream ss;
@@ -115,7 +104,7 @@ namespace owl {
           ss << " +";
         }
       }
-      LOG(ss.str()); 
+      OWL_LOG_INFO(ss.str()); 
     }
   }
   
@@ -184,6 +173,72 @@ namespace owl {
     assert(texture);
     return texture;
   }
+
+  Texture::SP
+  Context::texture2DCreateMipmapped(OWLTexelFormat texelFormat,
+                                    OWLMipmapFilter mipmapFilter,
+                                    OWLTextureFilterMode filterMode,
+                                    OWLTextureAddressMode addressMode,
+                                    OWLTextureColorSpace colorSpace,
+                                    const vec2i size,
+                                    const void **levels,
+                                    uint32_t numLevels)
+  {
+    if (size.x <= 0 || size.y <= 0)
+      throw std::runtime_error("invalid texture size");
+    if (numLevels < 1 || !levels)
+      throw std::runtime_error("mip-mapped texture needs at least level 0");
+    const uint32_t fullChain = (uint32_t)mipmap::numLevels(size);
+    if (numLevels > fullChain)
+      throw std::runtime_error("more mip levels than texture size allows");
+    if (numLevels < fullChain && bc::isBlockCompressed(texelFormat))
+      throw std::runtime_error("cannot generate mip levels for block compressed "
+                               "textures; all levels have to be given");
+    
+    std::vector<const void *> chain(levels,levels+numLevels);
+    std::vector<mipmap::Level> generated;
+    if (numLevels < fullChain) {
+      OWL_PROFILE_SCOPE("texture2DCreateMipmapped.generate");
+      const int last = numLevels-1;
+      generated = mipmap::generate(texelFormat,colorSpace,mipmapFilter,addressMode,
+                                   levels[last],mipmap::levelSize(size,last));
+      for (auto &level : generated)
+        chain.push_back(level.texels.data());
+      OWL_LOG_INFO("generated " << generated.size() << " mip levels for "
+                   << size.x << "x" << size.y << " texture");
+    }
+    
+    Texture::SP texture
+      = std::make_shared<Texture>(this,size,texelFormat,filterMode,addressMode,colorSpace,
+                                  chain);
+    assert(texture);
+    return texture;
+  }
+
+  Texture::SP
+  Context::texture2DCreateCompressed(OWLTexelFormat compressedFormat,
+                                     OWLTextureFilterMode filterMode,
+                                     OWLTextureAddressMode addressMode,
+                                     OWLTextureColorSpace colorSpace,
+                                     const vec2i size,
+                                     uint32_t linePitchInBytes,
+                                     const void *rgba8Texels)
+  {
+    if (!bc::isBlockCompressed(compressedFormat))
+      throw std::runtime_error("not a block compressed texel format");
+    if (size.x <= 0 || size.y <= 0)
+      throw std::runtime_error("invalid texture size");
+
+    std::vector<uint8_t> blocks(bc::compressedSize(compressedFormat,size));
+    {
+      OWL_PROFILE_SCOPE("texture2DCreateCompressed.encode");
+      bc::encode(compressedFormat,rgba8Texels,size,linePitchInBytes,blocks.data());
+    }
+    OWL_LOG_INFO("compressed " << size.x << "x" << size.y << " texture to "
+                 << prettyNumber(blocks.size()) << "B");
+    return texture2DCreate(compressedFormat,filterMode,addressMode,colorSpace,
+                           size,0,blocks.data());
+  }
     
 
   Buffer::SP
@@ -191,6 +246,9 @@ namespace owl {
                                 size_t count,
                                 cudaGraphicsResource_t resource)
   {
+    if (onNullDevices())
+      throw std::runtime_error("graphics resource buffers need a "
+                               "CUDA device, not a null device");
     Buffer::SP buffer
       = std::make_shared<GraphicsBuffer>(this, type, resource);
     
@@ -226,7 +284,7 @@ namespace owl {
     // for backwards compatibility: automatically set miss prog if none are set, yet
     if (mp->ID < numRayTypes &&
         (mp->ID >= (int)missProgPerRayType.size() || !missProgPerRayType[mp->ID]))
-      LOG("for backwards compatibility to pre-0.9.0 versions of OWL, "
+      OWL_LOG_INFO("for backwards compatibility to pre-0.9.0 versions of OWL, "
           "hereby installing this miss program for ray type #" << mp->ID);
       setMissProg(mp->ID,mp);
     return mp;
@@ -349,7 +407,8 @@ namespace owl {
 
   void Context::buildHitGroupRecordsOn(const DeviceContext::SP &device)
   {
-    LOG("building SBT hit group records");
+    OWL_PROFILE_SCOPE("buildHitGroupRecords");
+    OWL_LOG_INFO("building SBT hit group records");
     SetActiveGPU forLifeTime(device);
     if (device->sbt.hitGroupRecordsBuffer.alloced())
       device->sbt.hitGroupRecordsBuffer.free();
@@ -411,16 +470,17 @@ namespace owl {
         }
       }
     }
-    device->sbt.hitGroupRecordsBuffer.alloc(hitGroupRecords.size());
+    device->sbt.hitGroupRecordsBuffer.alloc(hitGroupRecords.size(),OWL_MEMORY_SBT);
     device->sbt.hitGroupRecordsBuffer.upload(hitGroupRecords);
     
-    LOG_OK("done building (and uploading) SBT hit group records");
+    OWL_LOG_OK("done building (and uploading) SBT hit group records");
   }
   
   
   void Context::buildMissProgRecordsOn(const DeviceContext::SP &device)
   {
-    LOG("building SBT miss group records");
+    OWL_PROFILE_SCOPE("buildMissProgRecords");
+    OWL_LOG_INFO("building SBT miss group records");
     SetActiveGPU forLifeTime(device);
     
     size_t numMissProgRecords = numRayTypes;
@@ -459,15 +519,16 @@ namespace owl {
         = missProgRecords.data() + recordID*missProgRecordSize;
       miss->writeSBTRecord(sbtRecord,device);
     }
-    device->sbt.missProgRecordsBuffer.alloc(missProgRecords.size());
+    device->sbt.missProgRecordsBuffer.alloc(missProgRecords.size(),OWL_MEMORY_SBT);
     device->sbt.missProgRecordsBuffer.upload(missProgRecords);
-    LOG_OK("done building (and uploading) SBT miss group records");
+    OWL_LOG_OK("done building (and uploading) SBT miss group records");
   }
 
 
   void Context::buildRayGenRecordsOn(const DeviceContext::SP &device)
   {
-    LOG("building SBT rayGen prog records");
+    OWL_PROFILE_SCOPE("buildRayGenRecords");
+    OWL_LOG_INFO("building SBT rayGen prog records");
     SetActiveGPU forLifeTime(device);
 
     for (size_t rgID=0;rgID<rayGens.size();rgID++) {
@@ -483,6 +544,7 @@ namespace owl {
   
   void Context::buildSBT(OWLBuildSBTFlags flags)
   {
+    OWL_PROFILE_SCOPE("buildSBT");
     if (flags & OWL_SBT_HITGROUPS)
       for (auto device : getDevices())
         buildHitGroupRecordsOn(device);
@@ -500,6 +562,7 @@ namespace owl {
 
   void Context::buildPipeline()
   {
+    OWL_PROFILE_SCOPE("buildPipeline");
     for (auto device : getDevices()) {
       device->destroyPipeline();
       device->buildPipeline();
@@ -508,6 +571,7 @@ namespace owl {
   
   void Context::buildModules(bool debug)
   {
+    OWL_PROFILE_SCOPE("buildModules");
     destroyModules();
     for (auto device : getDevices()) {
       device->configurePipelineOptions(debug);
@@ -515,6 +579,7 @@ namespace owl {
         Module *module = modules.getPtr(moduleID);
         if (!module) continue;
         
+        OWL_PROFILE_SCOPE("Module::build");
         module->getDD(device).build();
       }
     }
@@ -539,7 +604,7 @@ namespace owl {
         v.boundValuePtr });
     }
 #else
-    LOG("Ignoring bound launch params for old version of OptiX");
+    OWL_LOG_INFO("Ignoring bound launch params for old version of OptiX");
 #endif
   }
 
@@ -583,11 +648,34 @@ namespace owl {
     motionBlurEnabled = true;
   }
 
+  std::string Context::memoryReportJSON() const
+  {
+    std::stringstream ss;
+    ss << "{\"devices\":[";
+    for (auto device : devices)
+      ss << (device->ID ? "," : "") << "\n  " << device->memoryTracker.toJSON();
+    ss << "\n],\"pools\":[";
+    bool first = true;
+    for (auto device : devices) {
+      CachingAllocator::SP pool
+        = std::dynamic_pointer_cast<CachingAllocator>(device->allocator);
+      if (!pool) continue;
+      const std::string json = pool->toJSON();
+      ss << (first ? "" : ",") << "\n  {\"deviceID\":" << device->ID
+         << "," << json.substr(1);
+      first = false;
+    }
+    ss << "\n]}\n";
+    return ss.str();
+  }
+
   void Context::buildPrograms(bool debug)
   {
+    OWL_PROFILE_SCOPE("buildPrograms");
     buildModules(debug);
     
     for (auto device : getDevices()) {
+      OWL_PROFILE_SCOPE("DeviceContext::buildPrograms");
       SetActiveGPU forLifeTime(device);
       device->buildPrograms();
     }
@@ -24,6 +24,7 @@
 #include "RayGen.h"
 #include "LaunchParams.h"
 #include "MissProg.h"
+#include "Logging.h"
 
 namespace owl {
 
@@ -32,14 +33,10 @@ namespace owl {
   struct Context : public Object {
     typedef std::shared_ptr<Context> SP;
 
-    /*! returns whether logging is enabled */
+    /*! returns whether (info-level) logging is enabled */
     inline static bool logging()
     {
-#ifdef NDEBUG
-      return false;
-#else
-      return true;
-#endif
+      return Logger::enabled(OWL_LOG_LEVEL_INFO);
     }
 
     /*! creates a context with the given device IDs. If list of device
@@ -56,6 +53,13 @@ namespace owl {
     const std::vector<DeviceContext::SP> &getDevices() const { return devices; }
     DeviceContext::SP getDevice(int ID) const
     { assert(ID >= 0 && ID < (int)devices.size()); return devices[ID]; }
+    /*! whether this context runs on null devices (see
+        OWL_NULL_DEVICE); it's either all of them, or none */
+    bool onNullDevices() const { return devices[0]->isNull(); }
+
+    /*! all devices' memory usage and budgets (see MemoryTracker), and
+        the stats of their caching allocators, as one JSON object */
+    std::string memoryReportJSON() const;
 
     /*! part of the SBT creation - builds the hit group array */
     void buildHitGroupRecordsOn(const DeviceContext::SP &device);
@@ -126,6 +130,30 @@ namespace owl {
                     uint32_t linePitchInBytes,
                     const void *texels);
 
+    /*! creates a mip-mapped 2D texture from the first 'numLevels'
+      levels given in 'levels'; all remaining levels get generated
+      on the host */
+    Texture::SP
+    texture2DCreateMipmapped(OWLTexelFormat texelFormat,
+                             OWLMipmapFilter mipmapFilter,
+                             OWLTextureFilterMode filterMode,
+                             OWLTextureAddressMode addressMode,
+                             OWLTextureColorSpace colorSpace,
+                             const vec2i size,
+                             const void **levels,
+                             uint32_t numLevels);
+
+    /*! creates a 2D texture of a block compressed format, from RGBA8
+      texels that get compressed on the host */
+    Texture::SP
+    texture2DCreateCompressed(OWLTexelFormat compressedFormat,
+                              OWLTextureFilterMode filterMode,
+                              OWLTextureAddressMode addressMode,
+                              OWLTextureColorSpace colorSpace,
+                              const vec2i size,
+                              uint32_t linePitchInBytes,
+                              const void *rgba8Texels);
+
     /*! create a new *triangles* geometry group that will eventually
       create a BVH over all the trinalges in all its child
       geometries. only TrianglesGeoms can be added to this
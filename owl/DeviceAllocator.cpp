@@ -0,0 +1,173 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "DeviceAllocator.h"
+#include <sstream>
+
+namespace owl {
+
+  CachingAllocator::CachingAllocator(DeviceAllocator::SP backing,
+                                     const CachingAllocatorConfig &config)
+    : backing(backing),
+      config(config)
+  {
+    assert(backing);
+    if (config.minBlockSize == 0 || config.classesPerPowerOfTwo < 1)
+      throw std::runtime_error("#owl: invalid caching allocator config");
+  }
+
+  CachingAllocator::~CachingAllocator()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    trimCache(0);
+  }
+
+  size_t CachingAllocator::sizeClassOf(size_t size) const
+  {
+    if (size <= config.minBlockSize)
+      return config.minBlockSize;
+    // the classes between 2^k and 2^(k+1) are 'step' apart
+    int log2 = 0;
+    while ((size_t(2) << log2) <= size) log2++;
+    const size_t step
+      = std::max(size_t(1),(size_t(1) << log2)/size_t(config.classesPerPowerOfTwo));
+    return ((size+step-1)/step)*step;
+  }
+
+  size_t CachingAllocator::reservedSizeOf(size_t size) const
+  {
+    return size ? sizeClassOf(size) : 0;
+  }
+
+  size_t CachingAllocator::cachedBytes() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats.bytesCached;
+  }
+
+  void *CachingAllocator::allocate(size_t size)
+  {
+    if (size == 0) return nullptr;
+    const size_t sizeClass = sizeClassOf(size);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.numAllocs++;
+    void *ptr = nullptr;
+    auto it = cached.find(sizeClass);
+    if (it != cached.end()) {
+      ptr = it->second.back();
+      it->second.pop_back();
+      if (it->second.empty()) cached.erase(it);
+      stats.bytesCached -= sizeClass;
+      stats.numHits++;
+    } else {
+      stats.numMisses++;
+      stats.numBackingAllocs++;
+      ptr = backing->allocate(sizeClass);
+      if (!ptr && !cached.empty()) {
+        // out of memory: give back what we're only holding on to,
+        // and try again
+        stats.numPressureReleases++;
+        trimCache(0);
+        stats.numBackingAllocs++;
+        ptr = backing->allocate(sizeClass);
+      }
+      if (!ptr) return nullptr;
+    }
+
+    inUse[ptr] = { size, sizeClass };
+    stats.bytesRequested += size;
+    stats.bytesInUse     += sizeClass;
+    stats.peakBytesReserved
+      = std::max(stats.peakBytesReserved,stats.bytesInUse+stats.bytesCached);
+    return ptr;
+  }
+
+  void CachingAllocator::free(void *ptr)
+  {
+    if (!ptr) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = inUse.find(ptr);
+    if (it == inUse.end()) {
+      // not ours (eg, allocated before this allocator got plugged
+      // in); the best guess is it came from the same place
+      backing->free(ptr);
+      return;
+    }
+    const Block block = it->second;
+    inUse.erase(it);
+    stats.numFrees++;
+    stats.bytesRequested -= block.requested;
+    stats.bytesInUse     -= block.sizeClass;
+
+    cached[block.sizeClass].push_back(ptr);
+    stats.bytesCached += block.sizeClass;
+    trimCache(config.maxCachedBytes);
+  }
+
+  void CachingAllocator::trimCache(size_t maxBytes)
+  {
+    while (stats.bytesCached > maxBytes) {
+      auto largest = std::prev(cached.end());
+      backing->free(largest->second.back());
+      stats.numBackingFrees++;
+      stats.bytesCached -= largest->first;
+      largest->second.pop_back();
+      if (largest->second.empty()) cached.erase(largest);
+    }
+  }
+
+  void CachingAllocator::releaseCached()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    trimCache(0);
+  }
+
+  void CachingAllocator::setMaxCachedBytes(size_t maxCachedBytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    config.maxCachedBytes = maxCachedBytes;
+    trimCache(maxCachedBytes);
+  }
+
+  CachingAllocatorStats CachingAllocator::getStats() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+  }
+
+  std::string CachingAllocator::toJSON() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::stringstream ss;
+    ss << "{\"maxCachedBytes\":" << config.maxCachedBytes
+       << ",\"numAllocations\":" << stats.numAllocs
+       << ",\"numHits\":" << stats.numHits
+       << ",\"numMisses\":" << stats.numMisses
+       << ",\"hitRate\":" << stats.hitRate()
+       << ",\"numBackingAllocations\":" << stats.numBackingAllocs
+       << ",\"numBackingFrees\":" << stats.numBackingFrees
+       << ",\"numPressureReleases\":" << stats.numPressureReleases
+       << ",\"bytesRequested\":" << stats.bytesRequested
+       << ",\"bytesInUse\":" << stats.bytesInUse
+       << ",\"bytesCached\":" << stats.bytesCached
+       << ",\"peakBytesReserved\":" << stats.peakBytesReserved
+       << ",\"fragmentation\":" << stats.fragmentation()
+       << "}";
+    return ss.str();
+  }
+
+} // ::owl
@@ -0,0 +1,262 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/DeviceAllocator.h Where device memory comes from.
+
+    DeviceMemory and deviceMalloc()/deviceFree() allocate through the
+    DeviceAllocator of the device that SetActiveGPU has active. By
+    default that's a CachingAllocator - a pool that rounds requests up
+    to size classes (four per power of two), and keeps freed blocks
+    around to hand out again, instead of returning them - over a
+    CudaAllocator (or a HostAllocator, on null devices). That saves
+    the synchronizing cudaMalloc/cudaFree calls for the memory that
+    gets allocated and freed over and over: accels (build temp
+    memory, compacted sizes, and the BVHs themselves), and SBT
+    tables. Everything else - buffers, launch params, etc - comes
+    from the pool's backing allocator (see DeviceAllocator::uncached()
+    and detail::allocatorFor()).
+
+    Pooled blocks get re-used without any synchronization; that is
+    safe because all that owl does with them is on the legacy default
+    stream, which implicitly synchronizes with all other (blocking)
+    streams: accel builds and compaction, and the synchronous
+    cudaMemcpy's that fill instance buffers and SBT tables. So a
+    block can't be handed out again while a launch - async or not, on
+    whatever stream - may still be reading it, because whoever gets
+    it next will only touch it once that launch is done. Buffers
+    aren't pooled because that doesn't hold for them: they get
+    written by async uploads on DeviceContext::stream, which is not
+    ordered with the LaunchParams' streams that async launches run
+    on; for them, cudaFree's implicit device sync is what keeps a
+    new buffer's upload from overwriting memory a running launch
+    still reads.
+
+    The pool's cached blocks count towards the device's memory
+    budget (see MemoryTracker), and get released when the budget
+    would otherwise be exceeded, or when cuda runs out of memory -
+    be that in the pool, or when allocating textures or managed
+    memory. */
+
+#pragma once
+
+#include "owl/helper/cuda.h"
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace owl {
+
+  /*! the interface for anything device memory can be allocated
+      from */
+  struct DeviceAllocator {
+    typedef std::shared_ptr<DeviceAllocator> SP;
+
+    virtual ~DeviceAllocator() {}
+
+    /*! returns null if out of memory; a size of 0 is valid, and may
+        also return null */
+    virtual void *allocate(size_t size) = 0;
+    virtual void  free(void *ptr) = 0;
+
+    /*! returns what memory the allocator holds on to without it being
+        in use (if any) to where it came from */
+    virtual void  releaseCached() {}
+
+    /*! how much memory allocating 'size' bytes actually takes */
+    virtual size_t reservedSizeOf(size_t size) const { return size; }
+
+    /*! how much memory the allocator holds on to without it being in
+        use */
+    virtual size_t cachedBytes() const { return 0; }
+
+    /*! where to allocate memory that must not get cached (and then
+        re-used) from; for anything but a pool, that's itself */
+    virtual DeviceAllocator *uncached() { return this; }
+  };
+
+  /*! cudaMalloc and cudaFree, on whatever device is current */
+  struct CudaAllocator : public DeviceAllocator {
+    void *allocate(size_t size) override
+    {
+      void *ptr = nullptr;
+      const cudaError_t rc = cudaMalloc(&ptr, size);
+      if (rc == cudaErrorMemoryAllocation) {
+        // not sticky, but clear it anyway
+        cudaGetLastError();
+        return nullptr;
+      }
+      CUDA_CHECK(rc);
+      return ptr;
+    }
+    void free(void *ptr) override
+    {
+      CUDA_CHECK_NOTHROW(cudaFree(ptr));
+    }
+  };
+
+  /*! malloc and free, for null devices */
+  struct HostAllocator : public DeviceAllocator {
+    void *allocate(size_t size) override { return size ? ::malloc(size) : nullptr; }
+    void  free(void *ptr)       override { ::free(ptr); }
+  };
+
+  struct CachingAllocatorConfig {
+    /*! smallest size class; smaller requests get rounded up to it */
+    size_t minBlockSize     = 512;
+    /*! size classes per power of two; with N classes, rounding up
+        wastes less than 1/N of a block */
+    int    classesPerPowerOfTwo = 4;
+    /*! at most this much unused memory gets kept; blocks that would
+        go over it get released, largest ones first. 0 disables
+        caching altogether */
+    size_t maxCachedBytes   = size_t(256)<<20;
+  };
+
+  /*! counters of a CachingAllocator; bytes are current values, all
+      else counts since it got created */
+  struct CachingAllocatorStats {
+    /*! share of allocations that got served from the cache */
+    inline double hitRate() const
+    { return numAllocs ? double(numHits)/numAllocs : 0.; }
+
+    /*! share of the memory in use that got lost to rounding up to
+        size classes (ie, internal fragmentation) */
+    inline double fragmentation() const
+    { return bytesInUse ? 1.-double(bytesRequested)/bytesInUse : 0.; }
+
+    size_t numAllocs         = 0;
+    size_t numHits           = 0;
+    size_t numMisses         = 0;
+    size_t numFrees          = 0;
+    /*! calls to the backing allocator */
+    size_t numBackingAllocs  = 0;
+    size_t numBackingFrees   = 0;
+    /*! times the backing allocator ran out of memory, and the whole
+        cache got released to make room */
+    size_t numPressureReleases = 0;
+    /*! what is in use, as requested ... */
+    size_t bytesRequested    = 0;
+    /*! ... and rounded up to size classes */
+    size_t bytesInUse        = 0;
+    /*! what is kept around for re-use */
+    size_t bytesCached       = 0;
+    /*! most memory ever held from the backing allocator (in use plus
+        cached) */
+    size_t peakBytesReserved = 0;
+  };
+
+  /*! a size-class caching pool over another allocator; thread-safe */
+  struct CachingAllocator : public DeviceAllocator {
+    typedef std::shared_ptr<CachingAllocator> SP;
+
+    CachingAllocator(DeviceAllocator::SP backing,
+                     const CachingAllocatorConfig &config = CachingAllocatorConfig());
+    /*! releases the cached blocks; blocks still in use get leaked */
+    ~CachingAllocator() override;
+
+    void *allocate(size_t size) override;
+    void  free(void *ptr) override;
+    void  releaseCached() override;
+    size_t reservedSizeOf(size_t size) const override;
+    size_t cachedBytes() const override;
+    DeviceAllocator *uncached() override { return backing.get(); }
+
+    /*! changes the cache limit, releasing blocks if it's now over it */
+    void setMaxCachedBytes(size_t maxCachedBytes);
+
+    /*! the size class (ie, the block size) a request gets rounded up
+        to */
+    size_t sizeClassOf(size_t size) const;
+
+    CachingAllocatorStats getStats() const;
+
+    /*! config and stats, as a JSON object */
+    std::string toJSON() const;
+
+    const DeviceAllocator::SP backing;
+
+  private:
+    struct Block {
+      size_t requested;
+      size_t sizeClass;
+    };
+
+    /*! releases cached blocks, largest first, until at most
+        'maxBytes' are left; must be called with the mutex locked */
+    void trimCache(size_t maxBytes);
+
+    CachingAllocatorConfig config;
+    CachingAllocatorStats  stats;
+    /*! the blocks in use */
+    std::unordered_map<void *,Block>       inUse;
+    /*! the cached blocks, per size class */
+    std::map<size_t,std::vector<void *>>   cached;
+    mutable std::mutex mutex;
+  };
+
+  namespace detail {
+    /*! the allocator of the device that SetActiveGPU currently has
+        active on this thread; null if none, in which case memory
+        comes straight from cudaMalloc (or malloc, if
+        activeDeviceIsNull() says so) */
+    inline DeviceAllocator *&activeDeviceAllocator()
+    {
+      static thread_local DeviceAllocator *allocator = nullptr;
+      return allocator;
+    }
+
+    /*! allocates from the given allocator, or throws */
+    inline void *allocateOrThrow(DeviceAllocator *allocator, size_t size)
+    {
+      void *ptr = allocator->allocate(size);
+      if (!ptr && size)
+        throw std::runtime_error("#owl: out of device memory (trying to allocate "
+                                 +prettyBytes(size)+"B)");
+      return ptr;
+    }
+
+    /*! runs 'cudaAlloc' - some cudaMalloc*() call, for memory that
+        doesn't come from 'allocator' (like cuda arrays) - and if
+        that runs out of memory, releases what 'allocator' keeps
+        cached, and tries again */
+    template<typename CudaAlloc>
+    inline cudaError_t retryAfterReleasingCache(DeviceAllocator *allocator,
+                                                const CudaAlloc &cudaAlloc)
+    {
+      cudaError_t rc = cudaAlloc();
+      if (rc == cudaErrorMemoryAllocation && allocator && allocator->cachedBytes()) {
+        cudaGetLastError();
+        allocator->releaseCached();
+        rc = cudaAlloc();
+      }
+      return rc;
+    }
+  }
+
+  /*! the allocator that memory allocated on this thread (now) comes
+      from */
+  inline DeviceAllocator *currentDeviceAllocator()
+  {
+    if (DeviceAllocator *allocator = detail::activeDeviceAllocator())
+      return allocator;
+    static CudaAllocator cudaAllocator;
+    static HostAllocator hostAllocator;
+    if (detail::activeDeviceIsNull())
+      return &hostAllocator;
+    return &cudaAllocator;
+  }
+
+} // ::owl
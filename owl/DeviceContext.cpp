@@ -19,22 +19,6 @@
 
 #include <optix_function_table_definition.h>
 
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
 namespace owl {
 
   /*! logging callback passed to optix for intercepting optix log messages */
@@ -43,8 +27,44 @@ namespace owl {
                              const char *message,
                              void *)
   {
+    // optix levels are 1:fatal, 2:error, 3:warning, 4:print; of
+    // those we only used to show the first two, so keep optix's
+    // warnings at debug level
     if (level == 1 || level == 2)
-      fprintf( stderr, "[%2d][%12s]: %s\n", (int)level, tag, message );
+      OWL_LOG_ERROR("optix [" << tag << "]: " << message);
+    else
+      OWL_LOG_DEBUG("optix [" << tag << "]: " << message);
+  }
+
+  /*! optixProgramGroupCreate for a single program group; on a null
+      device, program groups are fake handles, numbered 1,2,... in the
+      order they get created */
+  static void createProgramGroup(DeviceContext *device,
+                                 const OptixProgramGroupDesc &pgDesc,
+                                 const OptixProgramGroupOptions &pgOptions,
+                                 OptixProgramGroup &pg)
+  {
+    if (device->isNull()) {
+      pg = (OptixProgramGroup)uintptr_t(device->allActivePrograms.size()+1);
+      device->nullStats.numPrograms++;
+      return;
+    }
+    char log[2048];
+    size_t sizeof_log = sizeof( log );
+    OPTIX_CHECK(optixProgramGroupCreate(device->optixContext,
+                                        &pgDesc,
+                                        1,
+                                        &pgOptions,
+                                        log,&sizeof_log,
+                                        &pg
+                                        ));
+  }
+
+  static void destroyProgramGroup(DeviceContext *device,
+                                  OptixProgramGroup pg)
+  {
+    if (!device->isNull())
+      OPTIX_CHECK(optixProgramGroupDestroy(pg));
   }
 
   /*! allocate 'size' consecutive SBT entries, and return index of
@@ -98,6 +118,19 @@ namespace owl {
   }
 
   
+  /*! whether OWL_BACKEND=null asks for all devices to be null
+      devices */
+  static bool nullBackendRequestedByEnv()
+  {
+    const char *fromEnv = getenv("OWL_BACKEND");
+    if (!fromEnv) return false;
+    const std::string s = fromEnv;
+    if (s == "null")  return true;
+    if (s != "optix")
+      OWL_LOG_WARNING("unknown OWL_BACKEND '" << s << "' (ignoring)");
+    return false;
+  }
+  
   /*! creates the N device contexts with the given device IDs. If list
     of device is nullptr, and number requested devices is > 1, then
     the first N devices will get used; invalid device IDs in the
@@ -106,19 +139,39 @@ namespace owl {
                                                       int32_t *deviceIDs,
                                                       int      numDevices)
   {
-    LOG("context ramping up - creating low-level devicegroup");
+    OWL_LOG_INFO("context ramping up - creating low-level devicegroup");
+
+    // ------------------------------------------------------------------
+    // null devices don't need (nor touch) either cuda or optix
+    // ------------------------------------------------------------------
+    int numNullDevicesRequested = 0;
+    if (deviceIDs)
+      for (int i=0;i<numDevices;i++)
+        if (deviceIDs[i] == OWL_NULL_DEVICE)
+          numNullDevicesRequested++;
+    if (numNullDevicesRequested > 0 && numNullDevicesRequested != numDevices)
+      throw std::runtime_error("#owl: null devices can't be mixed with real ones");
+    if (numNullDevicesRequested > 0 || nullBackendRequestedByEnv()) {
+      if (numDevices <= 0)
+        numDevices = 1;
+      OWL_LOG_INFO("creating " << numDevices << " null device(s) - no CUDA, no optix");
+      std::vector<DeviceContext::SP> devices;
+      for (int i=0;i<numDevices;i++)
+        devices.push_back(std::make_shared<DeviceContext>(parent,i,OWL_NULL_DEVICE));
+      return devices;
+    }
 
     // ------------------------------------------------------------------
     // init cuda, and error-out if no cuda devices exist
     // ------------------------------------------------------------------
-    LOG("initializing CUDA");
+    OWL_LOG_INFO("initializing CUDA");
     cudaFree(0);
     
     int totalNumDevicesAvailable = 0;
     CUDA_CALL(GetDeviceCount(&totalNumDevicesAvailable));
     if (totalNumDevicesAvailable == 0)
       throw std::runtime_error("#owl: no CUDA capable devices found!");
-    LOG_OK("found " << totalNumDevicesAvailable << " CUDA device(s)");
+    OWL_LOG_OK("found " << totalNumDevicesAvailable << " CUDA device(s)");
 
 
     // ------------------------------------------------------------------
@@ -143,13 +196,13 @@ namespace owl {
     // init optix itself
     // ------------------------------------------------------------------
 #if OPTIX_VERSION >= 70300
-    LOG("initializing optix 7.3");
+    OWL_LOG_INFO("initializing optix 7.3");
 #elif OPTIX_VERSION >= 70200
-    LOG("initializing optix 7.2");
+    OWL_LOG_INFO("initializing optix 7.2");
 #elif OPTIX_VERSION >= 70100
-    LOG("initializing optix 7.1");
+    OWL_LOG_INFO("initializing optix 7.1");
 #else
-    LOG("initializing optix 7");
+    OWL_LOG_INFO("initializing optix 7");
 #endif
     static bool initialized = false;
     if (!initialized) {
@@ -170,10 +223,8 @@ namespace owl {
         assert(dev);
         devices.push_back(dev);
       } catch (std::exception &e) {
-        std::cout << OWL_TERMINAL_RED
-                  << "#owl: Error creating optix device on CUDA device #"
-                  << deviceIDs[i] << ": " << e.what() << " ... dropping this device"
-                  << OWL_TERMINAL_DEFAULT << std::endl;
+        OWL_LOG_WARNING("Error creating optix device on CUDA device #"
+                        << deviceIDs[i] << ": " << e.what() << " ... dropping this device");
       }
     }
     
@@ -184,22 +235,40 @@ namespace owl {
     if (devices.empty())
       throw std::runtime_error("fatal error - could not find/create any optix devices");
     
-    LOG_OK("successfully created device group with " << devices.size() << " devices");
+    OWL_LOG_OK("successfully created device group with " << devices.size() << " devices");
     return devices;
   }
   
   
   
+  /*! a caching pool over cudaMalloc, or over malloc for null
+      devices */
+  static DeviceAllocator::SP defaultAllocatorFor(int cudaID)
+  {
+    DeviceAllocator::SP backing;
+    if (cudaID == OWL_NULL_DEVICE)
+      backing = std::make_shared<HostAllocator>();
+    else
+      backing = std::make_shared<CudaAllocator>();
+    return std::make_shared<CachingAllocator>(backing);
+  }
+  
   DeviceContext::DeviceContext(Context *parent,
                                int owlID,
                                int cudaID)
-    : parent(parent),
+    : memoryTracker(owlID),
+      allocator(defaultAllocatorFor(cudaID)),
+      parent(parent),
       ID(owlID),
       cudaDeviceID(cudaID)
   {
-    LOG("trying to create owl device on CUDA device #" << cudaDeviceID);
+    if (isNull()) {
+      OWL_LOG_INFO("created owl device #" << ID << " as a null device");
+      return;
+    }
+    OWL_LOG_INFO("trying to create owl device on CUDA device #" << cudaDeviceID);
     
-    LOG(" - device: " << getDeviceName());
+    OWL_LOG_INFO(" - device: " << getDeviceName());
     
     CUDA_CHECK(cudaSetDevice(cudaDeviceID));
     CUDA_CHECK(cudaStreamCreate(&stream));
@@ -220,6 +289,20 @@ namespace owl {
     destroyHitGroupPrograms();
     destroyPrograms();
     destroyPipeline();
+
+    {
+      // give the pool's memory back while this device is still the
+      // one it gets freed on
+      SetActiveGPU forLifeTime(this);
+      rayBatchPipeline = nullptr;
+      sbt.rayGenRecordsBuffer.free();
+      sbt.hitGroupRecordsBuffer.free();
+      sbt.missProgRecordsBuffer.free();
+      sbt.launchParamsBuffer.free();
+      allocator->releaseCached();
+    }
+
+    if (isNull()) return;
     
     OPTIX_CHECK(optixDeviceContextDestroy(optixContext));
     cudaStreamDestroy(stream);
@@ -229,6 +312,8 @@ namespace owl {
   /*! return CUDA's name string for given device */
   std::string DeviceContext::getDeviceName() const
   {
+    if (isNull())
+      return "null device";
     cudaDeviceProp prop;
     cudaGetDeviceProperties(&prop, getCudaDeviceID());
     return prop.name;
@@ -246,7 +331,8 @@ namespace owl {
     
     SetActiveGPU forLifeTime(this);
     
-    OPTIX_CHECK(optixPipelineDestroy(pipeline));
+    if (!isNull())
+      OPTIX_CHECK(optixPipelineDestroy(pipeline));
     pipeline = 0;
   }
   
@@ -262,7 +348,7 @@ namespace owl {
     moduleCompileOptions.debugLevel        = OPTIX_COMPILE_DEBUG_LEVEL_NONE;
   } 
   else {
-    std::cout << "WARNING: RUNNING OPTIX PROGRAMS IN -O0 DEBUG MODE!!!" << std::endl;
+    OWL_LOG_WARNING("RUNNING OPTIX PROGRAMS IN -O0 DEBUG MODE!!!");
     moduleCompileOptions.maxRegisterCount  = 50;
     moduleCompileOptions.optLevel          = OPTIX_COMPILE_OPTIMIZATION_LEVEL_3;
     moduleCompileOptions.debugLevel        = OPTIX_COMPILE_DEBUG_LEVEL_LINEINFO;
@@ -317,6 +403,13 @@ namespace owl {
     auto &allPGs = allActivePrograms;
     if (allPGs.empty())
       throw std::runtime_error("trying to create a pipeline w/ 0 programs!?");
+
+    if (isNull()) {
+      // nothing to link; any non-null handle will do
+      pipeline = (OptixPipeline)uintptr_t(1);
+      nullStats.numPipelines++;
+      return;
+    }
     
     char log[2048];
     size_t sizeof_log = sizeof( log );
@@ -401,15 +494,7 @@ namespace owl {
       pgDesc.miss.module            = optixModule;
       pgDesc.miss.entryFunctionName = prog->annotatedProgName.c_str();
       
-      char log[2048];
-      size_t sizeof_log = sizeof( log );
-      OPTIX_CHECK(optixProgramGroupCreate(optixContext,
-                                          &pgDesc,
-                                          1,
-                                          &pgOptions,
-                                          log,&sizeof_log,
-                                          &dd.pg
-                                          ));
+      createProgramGroup(this,pgDesc,pgOptions,dd.pg);
       assert(dd.pg);
       allActivePrograms.push_back(dd.pg);
     }
@@ -423,7 +508,7 @@ namespace owl {
       auto &dd = prog->getDD(shared_from_this());
       if (dd.pg == 0) continue;
 
-      OPTIX_CHECK(optixProgramGroupDestroy(dd.pg));
+      destroyProgramGroup(this,dd.pg);
       dd.pg = 0;
     }
   }
@@ -450,15 +535,7 @@ namespace owl {
       pgDesc.raygen.module            = optixModule;
       pgDesc.raygen.entryFunctionName = prog->annotatedProgName.c_str();
       
-      char log[2048];
-      size_t sizeof_log = sizeof( log );
-      OPTIX_CHECK(optixProgramGroupCreate(optixContext,
-                                          &pgDesc,
-                                          1,
-                                          &pgOptions,
-                                          log,&sizeof_log,
-                                          &dd.pg
-                                          ));
+      createProgramGroup(this,pgDesc,pgOptions,dd.pg);
       assert(dd.pg);
       allActivePrograms.push_back(dd.pg);
     }
@@ -473,7 +550,7 @@ namespace owl {
       auto &dd = prog->getDD(shared_from_this());
       if (dd.pg == 0) continue;
       
-      OPTIX_CHECK(optixProgramGroupDestroy(dd.pg));
+      destroyProgramGroup(this,dd.pg);
       dd.pg = 0;
     }
   }
@@ -518,16 +595,8 @@ namespace owl {
         // now let the type fill in what it has
         dd.fillPGDesc(pgDesc,geomType.get(),rt);
 
-        char log[2048];
-        size_t sizeof_log = sizeof( log );
         OptixProgramGroup &pg = dd.hgPGs[rt];
-        OPTIX_CHECK(optixProgramGroupCreate(optixContext,
-                                            &pgDesc,
-                                            1,
-                                            &pgOptions,
-                                            log,&sizeof_log,
-                                            &pg
-                                            ));
+        createProgramGroup(this,pgDesc,pgOptions,pg);
         allActivePrograms.push_back(pg);
       }
     }
@@ -542,11 +611,164 @@ namespace owl {
 
       auto &dd = geomType->getDD(shared_from_this());
       for (auto &pg : dd.hgPGs) 
-        if (pg) {
-          OPTIX_CHECK(optixProgramGroupDestroy(pg));
-        }
+        if (pg)
+          destroyProgramGroup(this,pg);
       dd.hgPGs.clear();
     }
   }
   
+  // ------------------------------------------------------------------
+  // optix calls, and their null-device stand-ins
+  // ------------------------------------------------------------------
+
+  /*! what null devices report for the size of a BVH: roughly what
+      optix's (uncompacted) BVHs take per primitive, and for build
+      temp memory */
+  static const size_t nullAccelBytesPerPrim = 64;
+  static const size_t nullAccelTempBytesPerPrim = 32;
+  
+  /*! number of primitives (triangles, boxes, or instances) in an
+      accel build input */
+  static size_t numPrimsIn(const OptixBuildInput &input)
+  {
+    switch (input.type) {
+    case OPTIX_BUILD_INPUT_TYPE_TRIANGLES:
+      return input.triangleArray.numIndexTriplets
+        ? input.triangleArray.numIndexTriplets
+        : input.triangleArray.numVertices/3;
+    case OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES:
+#if OPTIX_VERSION >= 70100
+      return input.customPrimitiveArray.numPrimitives;
+#else
+      return input.aabbArray.numPrimitives;
+#endif
+    case OPTIX_BUILD_INPUT_TYPE_INSTANCES:
+      return input.instanceArray.numInstances;
+    default:
+      return 0;
+    }
+  }
+  
+  uint32_t DeviceContext::getProperty(OptixDeviceProperty property) const
+  {
+    if (isNull())
+      return uint32_t(-1);
+    uint32_t value = 0;
+    OPTIX_CHECK(optixDeviceContextGetProperty(optixContext,property,
+                                              &value,sizeof(value)));
+    return value;
+  }
+  
+  void DeviceContext::sbtRecordPackHeader(OptixProgramGroup pg,
+                                          uint8_t *header) const
+  {
+    if (isNull()) {
+      memset(header,0,OPTIX_SBT_RECORD_HEADER_SIZE);
+      memcpy(header,&pg,sizeof(pg));
+      return;
+    }
+    OPTIX_CHECK(optixSbtRecordPackHeader(pg,header));
+  }
+
+  void DeviceContext::accelComputeMemoryUsage(const OptixAccelBuildOptions &options,
+                                              const OptixBuildInput *inputs,
+                                              uint32_t numInputs,
+                                              OptixAccelBufferSizes &sizes) const
+  {
+    if (isNull()) {
+      size_t numPrims = 0;
+      for (uint32_t i=0;i<numInputs;i++)
+        numPrims += numPrimsIn(inputs[i]);
+      sizes.outputSizeInBytes     = numPrims*nullAccelBytesPerPrim;
+      sizes.tempSizeInBytes       = numPrims*nullAccelTempBytesPerPrim;
+      sizes.tempUpdateSizeInBytes = numPrims*nullAccelTempBytesPerPrim;
+      return;
+    }
+    OPTIX_CHECK(optixAccelComputeMemoryUsage(optixContext,&options,
+                                             inputs,numInputs,&sizes));
+  }
+
+  void DeviceContext::accelBuild(const OptixAccelBuildOptions &options,
+                                 const OptixBuildInput *inputs,
+                                 uint32_t numInputs,
+                                 DeviceMemory &tempBuffer,
+                                 DeviceMemory &outputBuffer,
+                                 OptixTraversableHandle &traversable,
+                                 const OptixAccelEmitDesc *emittedProperties,
+                                 uint32_t numEmittedProperties)
+  {
+    if (isNull()) {
+      if (options.operation == OPTIX_BUILD_OPERATION_BUILD) {
+        nullStats.numAccelBuilds++;
+        nullStats.accelBytes += outputBuffer.size();
+      } else
+        nullStats.numAccelRefits++;
+      for (uint32_t i=0;i<numEmittedProperties;i++)
+        if (emittedProperties[i].type == OPTIX_PROPERTY_TYPE_COMPACTED_SIZE) {
+          const uint64_t compactedSize = outputBuffer.size();
+          memcpy((void*)emittedProperties[i].result,&compactedSize,sizeof(compactedSize));
+        }
+      traversable = (OptixTraversableHandle)outputBuffer.d_pointer;
+      return;
+    }
+    OPTIX_CHECK(optixAccelBuild(optixContext,
+                                /* todo: stream */0,
+                                &options,
+                                inputs,numInputs,
+                                (CUdeviceptr)tempBuffer.get(),
+                                tempBuffer.size(),
+                                (CUdeviceptr)outputBuffer.get(),
+                                outputBuffer.size(),
+                                &traversable,
+                                emittedProperties,numEmittedProperties
+                                ));
+  }
+
+  void DeviceContext::accelCompact(OptixTraversableHandle input,
+                                   DeviceMemory &outputBuffer,
+                                   OptixTraversableHandle &output)
+  {
+    if (isNull()) {
+      output = (OptixTraversableHandle)outputBuffer.d_pointer;
+      return;
+    }
+    OPTIX_CHECK(optixAccelCompact(optixContext,
+                                  /*TODO: stream:*/0,
+                                  input,
+                                  (CUdeviceptr)outputBuffer.get(),
+                                  outputBuffer.size(),
+                                  &output));
+  }
+
+  OptixTraversableHandle
+  DeviceContext::convertPointerToTraversableHandle(CUdeviceptr pointer,
+                                                   OptixTraversableType type) const
+  {
+    if (isNull())
+      return (OptixTraversableHandle)pointer;
+    OptixTraversableHandle handle = 0;
+    OPTIX_CHECK(optixConvertPointerToTraversableHandle(optixContext,pointer,
+                                                       type,&handle));
+    return handle;
+  }
+
+  void DeviceContext::launch(CUstream stream,
+                             DeviceMemory &launchParams,
+                             const OptixShaderBindingTable &sbt,
+                             const vec2i &dims)
+  {
+    if (isNull()) {
+      nullStats.numLaunches++;
+      nullStats.numLaunchedRays += size_t(dims.x)*size_t(dims.y);
+      return;
+    }
+    OPTIX_CHECK(optixLaunch(pipeline,
+                            stream,
+                            (CUdeviceptr)launchParams.get(),
+                            launchParams.sizeInBytes,
+                            &sbt,
+                            dims.x,dims.y,1
+                            ));
+  }
+  
 } // ::owl
@@ -57,8 +57,28 @@ namespace owl {
     DeviceMemory launchParamsBuffer;
   };
 
+  /*! what a null device (see DeviceContext::isNull()) did in place
+      of the module, program, pipeline and accel builds and launches
+      it doesn't have a GPU for */
+  struct NullDeviceStats {
+    size_t numModules      = 0;
+    /*! sum of the built modules' PTX sizes */
+    size_t moduleBytes     = 0;
+    size_t numPrograms     = 0;
+    size_t numPipelines    = 0;
+    size_t numAccelBuilds  = 0;
+    size_t numAccelRefits  = 0;
+    /*! sum of the (estimated, see accelComputeMemoryUsage()) output
+        sizes of all accel builds */
+    size_t accelBytes      = 0;
+    size_t numLaunches     = 0;
+    /*! sum of launch widths times heights */
+    size_t numLaunchedRays = 0;
+  };
+  
   /*! what will eventually containt the whole owl context across all gpus */
   struct Context;
+  struct RayBatchPipeline;
 
   /*! optix and cuda context for a single, specific GPU */
   struct DeviceContext : public std::enable_shared_from_this<DeviceContext>  {
@@ -66,7 +86,8 @@ namespace owl {
 
     /*! create a new device context with given context object, using
         given GPU "cudaID", and serving the rols at the "owlID"th GPU
-        in that context */
+        in that context; a cudaID of OWL_NULL_DEVICE creates a null
+        device */
     DeviceContext(Context *parent,
                   int owlID,
                   int cudaID);
@@ -78,6 +99,14 @@ namespace owl {
     /*! helper function - return cuda device ID of this device */
     int getCudaDeviceID() const;
 
+    /*! whether this is a null device, ie, one with no GPU behind
+        it: its "device" memory is host memory, module, program,
+        pipeline and accel builds and launches only get counted (in
+        nullStats), and SBT records and launch params still get fully
+        packed - so the host side of owl can be tested and
+        benchmarked on machines without a GPU */
+    bool isNull() const { return cudaDeviceID == OWL_NULL_DEVICE; }
+
     /*! return the optix default stream for this device. launch params
         may use their own stream */
     CUstream getStream() const { return stream; }
@@ -100,6 +129,53 @@ namespace owl {
     void destroyPipeline();
     void buildPipeline();
 
+    // ------------------------------------------------------------------
+    // the optix calls that the rest of owl makes on this device; on a
+    // null device those get stubbed out
+    // ------------------------------------------------------------------
+
+    /*! optixDeviceContextGetProperty; a null device has no limits */
+    uint32_t getProperty(OptixDeviceProperty property) const;
+    
+    /*! optixSbtRecordPackHeader; on a null device the header is the
+        program group's (fake) handle, zero-padded */
+    void sbtRecordPackHeader(OptixProgramGroup pg, uint8_t *header) const;
+
+    /*! optixAccelComputeMemoryUsage; a null device estimates sizes
+        from the build inputs' primitive counts */
+    void accelComputeMemoryUsage(const OptixAccelBuildOptions &options,
+                                 const OptixBuildInput *inputs,
+                                 uint32_t numInputs,
+                                 OptixAccelBufferSizes &sizes) const;
+
+    /*! optixAccelBuild (on the default stream); a null device only
+        writes the compacted size (the output size, for it) and hands
+        out the output buffer's address as traversable */
+    void accelBuild(const OptixAccelBuildOptions &options,
+                    const OptixBuildInput *inputs,
+                    uint32_t numInputs,
+                    DeviceMemory &tempBuffer,
+                    DeviceMemory &outputBuffer,
+                    OptixTraversableHandle &traversable,
+                    const OptixAccelEmitDesc *emittedProperties,
+                    uint32_t numEmittedProperties);
+
+    /*! optixAccelCompact (on the default stream) */
+    void accelCompact(OptixTraversableHandle input,
+                      DeviceMemory &outputBuffer,
+                      OptixTraversableHandle &output);
+
+    /*! optixConvertPointerToTraversableHandle; on a null device the
+        handle is the pointer */
+    OptixTraversableHandle convertPointerToTraversableHandle(CUdeviceptr pointer,
+                                                             OptixTraversableType type) const;
+
+    /*! optixLaunch of this device's pipeline */
+    void launch(CUstream stream,
+                DeviceMemory &launchParams,
+                const OptixShaderBindingTable &sbt,
+                const vec2i &dims);
+
     /*! collects all compiled programs during 'buildPrograms', such
         that all active progs can then be passed to optix durign
         pipeline creation */
@@ -113,7 +189,24 @@ namespace owl {
     OptixPipelineLinkOptions    pipelineLinkOptions    = {};
     OptixModuleCompileOptions   moduleCompileOptions   = {};
     OptixPipeline               pipeline               = nullptr;
+    /*! accounting (and budget) of all memory owl allocates on this
+        device; declared ahead of anything holding device memory, so
+        it outlives all of it */
+    mutable MemoryTracker       memoryTracker;
+    /*! what all device memory (but managed memory) on this device
+        gets allocated from; by default a CachingAllocator over
+        cudaMalloc (or malloc, on a null device), which only pools
+        accel and SBT memory (see DeviceAllocator.h). It can be replaced
+        with any other allocator, as long as nothing has been
+        allocated on this device yet */
+    DeviceAllocator::SP         allocator;
     SBT                         sbt                    = {};
+    /*! what owlGroupTraceRays() traces with on this device; created on
+        first use (see RayBatch.h) */
+    std::shared_ptr<RayBatchPipeline> rayBatchPipeline;
+
+    /*! only counted on null devices */
+    NullDeviceStats             nullStats;
 
     /*! the owl context that this device is in */
     Context *const parent;
@@ -141,21 +234,34 @@ namespace owl {
       after class dies */
   struct SetActiveGPU {
     inline SetActiveGPU(const DeviceContext::SP &device)
-    {
-      CUDA_CHECK(cudaGetDevice(&savedActiveDeviceID));
-      CUDA_CHECK(cudaSetDevice(device->cudaDeviceID));
-    }
+      : SetActiveGPU(device.get())
+    {}
     inline SetActiveGPU(const DeviceContext *device)
+      : savedActiveDeviceIsNull(detail::activeDeviceIsNull()),
+        savedActiveMemoryTracker(detail::activeMemoryTracker()),
+        savedActiveAllocator(detail::activeDeviceAllocator())
     {
-      CUDA_CHECK(cudaGetDevice(&savedActiveDeviceID));
-      CUDA_CHECK(cudaSetDevice(device->cudaDeviceID));
+      if (!device->isNull()) {
+        CUDA_CHECK(cudaGetDevice(&savedActiveDeviceID));
+        CUDA_CHECK(cudaSetDevice(device->cudaDeviceID));
+      }
+      detail::activeDeviceIsNull()  = device->isNull();
+      detail::activeMemoryTracker() = &device->memoryTracker;
+      detail::activeDeviceAllocator() = device->allocator.get();
     }
     inline ~SetActiveGPU()
     {
-      CUDA_CHECK_NOTHROW(cudaSetDevice(savedActiveDeviceID));
+      if (savedActiveDeviceID >= 0)
+        CUDA_CHECK_NOTHROW(cudaSetDevice(savedActiveDeviceID));
+      detail::activeDeviceIsNull()  = savedActiveDeviceIsNull;
+      detail::activeMemoryTracker() = savedActiveMemoryTracker;
+      detail::activeDeviceAllocator() = savedActiveAllocator;
     }
   private:
-    int savedActiveDeviceID = -1;
+    int            savedActiveDeviceID = -1;
+    bool           savedActiveDeviceIsNull = false;
+    MemoryTracker *savedActiveMemoryTracker = nullptr;
+    DeviceAllocator *savedActiveAllocator = nullptr;
   };
   
 } // ::owl
@@ -17,9 +17,21 @@
 #pragma once
 
 #include "owl/helper/cuda.h"
+#include "owl/MemoryTracker.h"
+#include "owl/DeviceAllocator.h"
 
 namespace owl {
 
+  /*! a chunk of memory on the device that's active (see SetActiveGPU)
+      when it gets allocated; on a null device that's plain host
+      memory, which is also what lets host-side tests read back what
+      got "uploaded". Memory comes from that device's
+      DeviceAllocator - its pool for accel and SBT memory, else
+      uncached (see detail::allocatorFor()); except for managed
+      memory, which always comes from cudaMallocManaged - and gets
+      recorded, under the given
+      category, in its MemoryTracker - and allocations fail if they'd
+      go over its budget */
   struct DeviceMemory {
     inline ~DeviceMemory() { free(); }
     inline bool   alloced()  const { return !empty(); }
@@ -27,8 +39,10 @@ namespace owl {
     inline bool   notEmpty() const { return !empty(); }
     inline size_t size()     const { return sizeInBytes; }
     
-    inline void alloc(size_t size);
-    inline void allocManaged(size_t size);
+    inline void alloc(size_t size,
+                      OWLMemoryCategory category = OWL_MEMORY_OTHER);
+    inline void allocManaged(size_t size,
+                             OWLMemoryCategory category = OWL_MEMORY_OTHER);
     inline void *get();
     inline void upload(const void *h_pointer, const char *debugMessage = nullptr);
     inline void uploadAsync(const void *h_pointer, cudaStream_t stream);
@@ -39,23 +53,114 @@ namespace owl {
       
     size_t      sizeInBytes { 0 };
     CUdeviceptr d_pointer   { 0 };
+    /*! whether this got allocated on a null device, so lives in
+        host memory */
+    bool        onHost      { false };
+    /*! where this allocation got recorded, if anywhere */
+    MemoryTracker   *tracker   { nullptr };
+    /*! where this came from; null for managed memory */
+    DeviceAllocator *allocator { nullptr };
   };
 
-  inline void DeviceMemory::alloc(size_t size)
+  namespace detail {
+    /*! whether memory of the given category comes from the device's
+        pool (see DeviceAllocator.h for why only these do) */
+    inline bool isPooled(OWLMemoryCategory category)
+    {
+      return category == OWL_MEMORY_ACCEL
+        ||   category == OWL_MEMORY_ACCEL_TEMP
+        ||   category == OWL_MEMORY_SBT;
+    }
+
+    /*! the allocator that memory of the given category comes from */
+    inline DeviceAllocator *allocatorFor(OWLMemoryCategory category)
+    {
+      DeviceAllocator *allocator = currentDeviceAllocator();
+      return isPooled(category) ? allocator : allocator->uncached();
+    }
+
+    /*! checks allocating 'size' bytes, which take up 'reserved'
+        bytes, against the tracker's budget - counting what
+        'allocator' keeps cached, too; if it's the cache that's in
+        the way, that gets released first */
+    inline void checkBudget(MemoryTracker *tracker, DeviceAllocator *allocator,
+                            size_t size, size_t reserved,
+                            OWLMemoryCategory category)
+    {
+      if (!tracker) return;
+      if (!tracker->fitsBudget(reserved+allocator->cachedBytes()))
+        allocator->releaseCached();
+      tracker->checkBudget(size, category, reserved, allocator->cachedBytes());
+    }
+  }
+
+  /*! cudaMalloc, cudaFree and cudaMemcpyAsync for code that manages
+      raw device pointers itself; on a null device (see
+      DeviceMemory) these are malloc, free and memcpy. Like
+      DeviceMemory, they go through the active device's
+      DeviceAllocator, and record what they allocate in its
+      MemoryTracker; so deviceFree() has to be called with the same
+      device active as deviceMalloc() was */
+  inline void deviceMalloc(void **ptr, size_t size,
+                           OWLMemoryCategory category = OWL_MEMORY_OTHER)
+  {
+    MemoryTracker   *tracker   = detail::activeMemoryTracker();
+    DeviceAllocator *allocator = detail::allocatorFor(category);
+    const size_t reserved = allocator->reservedSizeOf(size);
+    detail::checkBudget(tracker, currentDeviceAllocator(), size, reserved, category);
+    *ptr = detail::allocateOrThrow(allocator, size);
+    if (tracker) tracker->allocated(*ptr, size, category, reserved);
+  }
+
+  /*! (the pool hands anything it didn't allocate itself on to its
+      backing allocator, so this also frees uncached memory) */
+  inline void deviceFree(void *ptr)
+  {
+    if (MemoryTracker *tracker = detail::activeMemoryTracker())
+      tracker->freed(ptr);
+    currentDeviceAllocator()->free(ptr);
+  }
+
+  inline void deviceMemcpyAsync(void *dst, const void *src, size_t size,
+                                cudaStream_t stream)
+  {
+    if (detail::activeDeviceIsNull())
+      memcpy(dst, src, size);
+    else
+      CUDA_CHECK(cudaMemcpyAsync(dst, src, size, cudaMemcpyDefault, stream));
+  }
+
+  inline void DeviceMemory::alloc(size_t size, OWLMemoryCategory category)
   {
     if (alloced()) free();
       
     assert(empty());
+    tracker = detail::activeMemoryTracker();
+    allocator = detail::allocatorFor(category);
+    const size_t reserved = allocator->reservedSizeOf(size);
+    detail::checkBudget(tracker, currentDeviceAllocator(), size, reserved, category);
+    d_pointer = (CUdeviceptr)detail::allocateOrThrow(allocator, size);
     this->sizeInBytes = size;
-    CUDA_CHECK(cudaMalloc( (void**)&d_pointer, sizeInBytes));
+    onHost = detail::activeDeviceIsNull();
+    if (tracker) tracker->allocated((void*)d_pointer, size, category, reserved);
     assert(alloced() || size == 0);
   }
     
-  inline void DeviceMemory::allocManaged(size_t size)
+  inline void DeviceMemory::allocManaged(size_t size, OWLMemoryCategory category)
   {
     assert(empty());
+    tracker = detail::activeMemoryTracker();
+    // doesn't come from the allocator, but competes with its cache
+    DeviceAllocator *pool = currentDeviceAllocator();
+    detail::checkBudget(tracker, pool, size, size, category);
     this->sizeInBytes = size;
-    CUDA_CHECK(cudaMallocManaged( (void**)&d_pointer, sizeInBytes));
+    onHost = detail::activeDeviceIsNull();
+    if (onHost)
+      d_pointer = (CUdeviceptr)(size ? malloc(size) : nullptr);
+    else
+      CUDA_CHECK(detail::retryAfterReleasingCache
+                 (pool,[&]{ return cudaMallocManaged((void**)&d_pointer, sizeInBytes); }));
+    if (tracker) tracker->allocated((void*)d_pointer, size, category);
     assert(alloced() || size == 0);
   }
     
@@ -67,6 +172,10 @@ namespace owl {
   inline void DeviceMemory::upload(const void *h_pointer, const char *debugMessage)
   {
     assert(alloced() || empty());
+    if (onHost) {
+      if (sizeInBytes) memcpy((void*)d_pointer, h_pointer, sizeInBytes);
+      return;
+    }
     CUDA_CHECK2(debugMessage,
                 cudaMemcpy((void*)d_pointer, h_pointer,
                            sizeInBytes, cudaMemcpyHostToDevice));
@@ -75,6 +184,10 @@ namespace owl {
   inline void DeviceMemory::uploadAsync(const void *h_pointer, cudaStream_t stream)
   {
     assert(alloced() || empty());
+    if (onHost) {
+      if (sizeInBytes) memcpy((void*)d_pointer, h_pointer, sizeInBytes);
+      return;
+    }
     CUDA_CHECK(cudaMemcpyAsync((void*)d_pointer, h_pointer,
                                sizeInBytes, cudaMemcpyHostToDevice,
                                stream));
@@ -83,6 +196,10 @@ namespace owl {
   inline void DeviceMemory::download(void *h_pointer)
   {
     assert(alloced() || sizeInBytes == 0);
+    if (onHost) {
+      if (sizeInBytes) memcpy(h_pointer, (void*)d_pointer, sizeInBytes);
+      return;
+    }
     CUDA_CHECK(cudaMemcpy(h_pointer, (void*)d_pointer, 
                           sizeInBytes, cudaMemcpyDeviceToHost));
   }
@@ -91,10 +208,19 @@ namespace owl {
   {
     assert(alloced() || empty());
     if (!empty()) {
-      CUDA_CHECK(cudaFree((void*)d_pointer));
+      if (tracker) tracker->freed((void*)d_pointer);
+      if (allocator)
+        allocator->free((void*)d_pointer);
+      else if (onHost)
+        ::free((void*)d_pointer);
+      else
+        CUDA_CHECK(cudaFree((void*)d_pointer));
     }
     sizeInBytes = 0;
     d_pointer   = 0;
+    onHost      = false;
+    tracker     = nullptr;
+    allocator   = nullptr;
     assert(empty());
   }
 
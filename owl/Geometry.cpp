@@ -137,7 +137,7 @@ namespace owl {
     // ------------------------------------------------------------------
     auto &dd = geomType->getDD(device);
     assert(rayTypeID < (int)dd.hgPGs.size());
-    OPTIX_CALL(SbtRecordPackHeader(dd.hgPGs[rayTypeID],sbtRecordHeader));
+    device->sbtRecordPackHeader(dd.hgPGs[rayTypeID],sbtRecordHeader);
     
     // ------------------------------------------------------------------
     // then, write the data for that record
@@ -23,6 +23,8 @@
 
 namespace owl {
 
+  struct HostAccel;
+
   /*! abstract base class for any sort of group (ie, BVH), BLAS'es and
       IAS'es will be derived from this class */
   struct Group : public RegisteredObject {
@@ -94,6 +96,11 @@ namespace owl {
 
     /*! bounding box for t=0 and t=1; for motion blur. */
     box3f bounds[2];
+
+    /*! host-side BVH for tracing ray batches on the CPU (see
+        RayBatch.h); built on first use, and dropped whenever the
+        group's accel gets (re-)built or refit */
+    std::shared_ptr<HostAccel> hostAccel;
   };
 
   /*! a group containing geometries (ie, BLASes, whereas the
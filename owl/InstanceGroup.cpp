@@ -16,19 +16,7 @@
 
 #include "InstanceGroup.h"
 #include "Context.h"
-
-#define LOG(message)                                    \
-  if (Context::logging())                               \
-    std::cout << "#owl(" << device->ID << "): "         \
-              << message                                \
-              << std::endl
-
-#define LOG_OK(message)                                         \
-  if (Context::logging())                                       \
-    std::cout << OWL_TERMINAL_GREEN                             \
-              << "#owl(" << device->ID << "): "                 \
-              << message << OWL_TERMINAL_DEFAULT << std::endl
-
+#include "Profiler.h"
 
 namespace owl {
 
@@ -117,6 +105,7 @@ namespace owl {
 
   void InstanceGroup::buildAccel()
   {
+    OWL_PROFILE_SCOPE("InstanceGroup::buildAccel");
     for (auto device : context->getDevices())
       if (transforms[1].empty())
         staticBuildOn<true>(device);
@@ -126,6 +115,7 @@ namespace owl {
   
   void InstanceGroup::refitAccel()
   {
+    OWL_PROFILE_SCOPE("InstanceGroup::refitAccel");
     for (auto device : context->getDevices())
       if (transforms[1].empty())
         staticBuildOn<false>(device);
@@ -136,22 +126,18 @@ namespace owl {
   template<bool FULL_REBUILD>
   void InstanceGroup::staticBuildOn(const DeviceContext::SP &device) 
   {
+    OWL_PROFILE_SCOPE(FULL_REBUILD ? "buildAccelOn" : "refitAccelOn");
     DeviceData &dd = getDD(device);
-    auto optixContext = device->optixContext;
 
     SetActiveGPU forLifeTime(device);
-    LOG("building instance accel over "
+    OWL_LOG_INFO("device #" << device->ID << ": building instance accel over "
         << children.size() << " groups");
 
     // ==================================================================
     // sanity check that that many instances are actualy allowed by optix:
     // ==================================================================
-    uint32_t maxInstsPerIAS = 0;
-    optixDeviceContextGetProperty
-      (optixContext,
-       OPTIX_DEVICE_PROPERTY_LIMIT_MAX_INSTANCES_PER_IAS,
-       &maxInstsPerIAS,
-       sizeof(maxInstsPerIAS));
+    const uint32_t maxInstsPerIAS
+      = device->getProperty(OPTIX_DEVICE_PROPERTY_LIMIT_MAX_INSTANCES_PER_IAS);
       
     if (children.size() > maxInstsPerIAS)
       throw std::runtime_error("number of children in instance group exceeds "
@@ -207,7 +193,8 @@ namespace owl {
     }
 
     dd.optixInstanceBuffer.alloc(optixInstances.size()*
-                                 sizeof(optixInstances[0]));
+                                 sizeof(optixInstances[0]),
+                                 OWL_MEMORY_ACCEL);
     dd.optixInstanceBuffer.upload(optixInstances.data(),"optixinstances");
     
     // ==================================================================
@@ -238,12 +225,10 @@ namespace owl {
     // query build buffer sizes, and allocate those buffers
     // ==================================================================
     OptixAccelBufferSizes blasBufferSizes;
-    OPTIX_CHECK(optixAccelComputeMemoryUsage(optixContext,
-                                             &accelOptions,
-                                             &instanceInput,
-                                             1, // num build inputs
-                                             &blasBufferSizes
-                                             ));
+    device->accelComputeMemoryUsage(accelOptions,
+                                    &instanceInput,
+                                    1, // num build inputs
+                                    blasBufferSizes);
     
     // ==================================================================
     // trigger the build ....
@@ -252,37 +237,32 @@ namespace owl {
       = FULL_REBUILD
       ? blasBufferSizes.tempSizeInBytes
       : blasBufferSizes.tempUpdateSizeInBytes;
-    LOG("starting to build/refit "
+    OWL_LOG_INFO("device #" << device->ID << ": starting to build/refit "
         << prettyNumber(optixInstances.size()) << " instances, "
         << prettyNumber(blasBufferSizes.outputSizeInBytes) << "B in output and "
         << prettyNumber(tempSize) << "B in temp data");
       
     DeviceMemory tempBuffer;
-    tempBuffer.alloc(tempSize);
+    tempBuffer.alloc(tempSize,OWL_MEMORY_ACCEL_TEMP);
       
     if (FULL_REBUILD) {
-      dd.bvhMemory.alloc(blasBufferSizes.outputSizeInBytes);
+      dd.bvhMemory.alloc(blasBufferSizes.outputSizeInBytes,OWL_MEMORY_ACCEL);
       dd.memPeak += tempBuffer.size();
       dd.memPeak += dd.bvhMemory.size();
       dd.memFinal = dd.bvhMemory.size();
     }
       
-    OPTIX_CHECK(optixAccelBuild(optixContext,
-                                /* todo: stream */0,
-                                &accelOptions,
-                                // array of build inputs:
-                                &instanceInput,1,
-                                // buffer of temp memory:
-                                (CUdeviceptr)tempBuffer.get(),
-                                tempBuffer.size(),
-                                // where we store initial, uncomp bvh:
-                                (CUdeviceptr)dd.bvhMemory.get(),
-                                dd.bvhMemory.size(),
-                                /* the traversable we're building: */ 
-                                &dd.traversable,
-                                /* no compaction for instances: */
-                                nullptr,0u
-                                ));
+    device->accelBuild(accelOptions,
+                       // array of build inputs:
+                       &instanceInput,1,
+                       // buffer of temp memory:
+                       tempBuffer,
+                       // where we store initial, uncomp bvh:
+                       dd.bvhMemory,
+                       /* the traversable we're building: */ 
+                       dd.traversable,
+                       /* no compaction for instances: */
+                       nullptr,0u);
       
     CUDA_SYNC_CHECK();
     
@@ -293,7 +273,7 @@ namespace owl {
     // frees until all objects are done
     tempBuffer.free();
       
-    LOG_OK("successfully built instance group accel");
+    OWL_LOG_OK("device #" << device->ID << ": successfully built instance group accel");
   }
     
 
@@ -302,22 +282,18 @@ namespace owl {
   template<bool FULL_REBUILD>
   void InstanceGroup::motionBlurBuildOn(const DeviceContext::SP &device)
   {
+    OWL_PROFILE_SCOPE(FULL_REBUILD ? "buildAccelOn" : "refitAccelOn");
     DeviceData &dd = getDD(device);
-    auto optixContext = device->optixContext;
     
     SetActiveGPU forLifeTime(device);
-    LOG("building instance accel over "
+    OWL_LOG_INFO("device #" << device->ID << ": building instance accel over "
         << children.size() << " groups");
     
     // ==================================================================
     // sanity check that that many instances are actualy allowed by optix:
     // ==================================================================
-    uint32_t maxInstsPerIAS = 0;
-    optixDeviceContextGetProperty
-      (optixContext,
-       OPTIX_DEVICE_PROPERTY_LIMIT_MAX_INSTANCES_PER_IAS,
-       &maxInstsPerIAS,
-       sizeof(maxInstsPerIAS));
+    const uint32_t maxInstsPerIAS
+      = device->getProperty(OPTIX_DEVICE_PROPERTY_LIMIT_MAX_INSTANCES_PER_IAS);
     
     if (children.size() > maxInstsPerIAS)
       throw std::runtime_error("number of children in instnace group exceeds "
@@ -375,14 +351,15 @@ namespace owl {
     }
     // and upload
     dd.motionTransformsBuffer.alloc(motionTransforms.size()*
-                                    sizeof(motionTransforms[0]));
+                                    sizeof(motionTransforms[0]),
+                                    OWL_MEMORY_ACCEL);
     dd.motionTransformsBuffer.upload(motionTransforms.data(),"motionTransforms");
       
 #if OPTIX_VERSION >= 70200
     /* since 7.2, optix no longer requires those aabbs (and in fact,
        no longer supports specifying them */
 #else
-    dd.motionAABBsBuffer.alloc(motionAABBs.size()*sizeof(box3f));
+    dd.motionAABBsBuffer.alloc(motionAABBs.size()*sizeof(box3f),OWL_MEMORY_ACCEL);
     dd.motionAABBsBuffer.upload(motionAABBs.data(),"motionaabbs");
 #endif      
     // ==================================================================
@@ -399,14 +376,12 @@ namespace owl {
       Group::SP child = children[childID];
       assert(child);
 
-      OptixTraversableHandle childMotionHandle = 0;
-      OPTIX_CHECK(optixConvertPointerToTraversableHandle
-                  (optixContext,
-                   (CUdeviceptr)(((const uint8_t*)dd.motionTransformsBuffer.get())
-                                 +childID*sizeof(motionTransforms[0])
-                                 ),
-                   OPTIX_TRAVERSABLE_TYPE_MATRIX_MOTION_TRANSFORM,
-                   &childMotionHandle));
+      const OptixTraversableHandle childMotionHandle
+        = device->convertPointerToTraversableHandle
+        ((CUdeviceptr)(((const uint8_t*)dd.motionTransformsBuffer.get())
+                       +childID*sizeof(motionTransforms[0])
+                       ),
+         OPTIX_TRAVERSABLE_TYPE_MATRIX_MOTION_TRANSFORM);
         
       OptixInstance oi    = {};
       oi.transform[0*4+0]  = 1.f;//xfm.l.vx.x;
@@ -433,7 +408,8 @@ namespace owl {
     }
 
     dd.optixInstanceBuffer.alloc(optixInstances.size()*
-                                 sizeof(optixInstances[0]));
+                                 sizeof(optixInstances[0]),
+                                 OWL_MEMORY_ACCEL);
     dd.optixInstanceBuffer.upload(optixInstances.data(),"optixinstances");
 
     // ==================================================================
@@ -477,12 +453,10 @@ namespace owl {
     // query build buffer sizes, and allocate those buffers
     // ==================================================================
     OptixAccelBufferSizes blasBufferSizes;
-    OPTIX_CHECK(optixAccelComputeMemoryUsage(optixContext,
-                                             &accelOptions,
-                                             &instanceInput,
-                                             1, // num build inputs
-                                             &blasBufferSizes
-                                             ));
+    device->accelComputeMemoryUsage(accelOptions,
+                                    &instanceInput,
+                                    1, // num build inputs
+                                    blasBufferSizes);
     
     // ==================================================================
     // trigger the build ....
@@ -491,33 +465,28 @@ namespace owl {
       = FULL_REBUILD
       ? blasBufferSizes.tempSizeInBytes
       : blasBufferSizes.tempUpdateSizeInBytes;
-    LOG("starting to build/refit "
+    OWL_LOG_INFO("device #" << device->ID << ": starting to build/refit "
         << prettyNumber(optixInstances.size()) << " instances, "
         << prettyNumber(blasBufferSizes.outputSizeInBytes) << "B in output and "
         << prettyNumber(tempSize) << "B in temp data");
       
     DeviceMemory tempBuffer;
-    tempBuffer.alloc(tempSize);
+    tempBuffer.alloc(tempSize,OWL_MEMORY_ACCEL_TEMP);
       
     if (FULL_REBUILD)
-      dd.bvhMemory.alloc(blasBufferSizes.outputSizeInBytes);
+      dd.bvhMemory.alloc(blasBufferSizes.outputSizeInBytes,OWL_MEMORY_ACCEL);
       
-    OPTIX_CHECK(optixAccelBuild(optixContext,
-                                /* todo: stream */0,
-                                &accelOptions,
-                                // array of build inputs:
-                                &instanceInput,1,
-                                // buffer of temp memory:
-                                (CUdeviceptr)tempBuffer.get(),
-                                tempBuffer.size(),
-                                // where we store initial, uncomp bvh:
-                                (CUdeviceptr)dd.bvhMemory.get(),
-                                dd.bvhMemory.size(),
-                                /* the traversable we're building: */ 
-                                &dd.traversable,
-                                /* no compaction for instances: */
-                                nullptr,0u
-                                ));
+    device->accelBuild(accelOptions,
+                       // array of build inputs:
+                       &instanceInput,1,
+                       // buffer of temp memory:
+                       tempBuffer,
+                       // where we store initial, uncomp bvh:
+                       dd.bvhMemory,
+                       /* the traversable we're building: */ 
+                       dd.traversable,
+                       /* no compaction for instances: */
+                       nullptr,0u);
 
     CUDA_SYNC_CHECK();
     
@@ -528,7 +497,7 @@ namespace owl {
     // frees until all objects are done
     tempBuffer.free();
       
-    LOG_OK("successfully built instance group accel");
+    OWL_LOG_OK("device #" << device->ID << ": successfully built instance group accel");
   }
   
 } // ::owl
@@ -43,14 +43,16 @@ namespace owl {
   {
     SetActiveGPU forLifeTime(device);
     
-    CUDA_CHECK(cudaStreamCreate(&stream));
-    deviceMemory.alloc(dataSize);
+    if (!device->isNull())
+      CUDA_CHECK(cudaStreamCreate(&stream));
+    deviceMemory.alloc(dataSize,OWL_MEMORY_LAUNCH_PARAMS);
     hostMemory.resize(dataSize);
   }
 
   LaunchParams::DeviceData::~DeviceData()
   {
-    cudaStreamDestroy(stream);
+    if (stream)
+      cudaStreamDestroy(stream);
   }
   
   // ------------------------------------------------------------------
@@ -97,6 +99,7 @@ namespace owl {
   void LaunchParams::sync()
   {
     for (auto device : context->getDevices()) {
+      if (device->isNull()) continue;
       SetActiveGPU forLifeTime(device);
       cudaStreamSynchronize(getCudaStream(device));
     }
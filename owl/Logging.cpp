@@ -0,0 +1,215 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "Logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace owl {
+
+  // ------------------------------------------------------------------
+  // sinks
+  // ------------------------------------------------------------------
+
+  FileLogSink::FileLogSink()
+    : file(stderr), ownsFile(false), useColors(true)
+  {}
+
+  FileLogSink::FileLogSink(const std::string &fileName)
+    : file(fopen(fileName.c_str(),"w")), ownsFile(true), useColors(false)
+  {
+    if (!file)
+      throw std::runtime_error("could not open log file '"+fileName+"'");
+  }
+
+  FileLogSink::~FileLogSink()
+  {
+    if (ownsFile) fclose(file);
+  }
+
+  void FileLogSink::write(OWLLogLevel level, const std::string &message)
+  {
+    if (!useColors) {
+      fprintf(file,"#owl: %s\n",message.c_str());
+      return;
+    }
+    const char *color
+      = (level == OWL_LOG_LEVEL_ERROR)   ? OWL_TERMINAL_RED
+      : (level == OWL_LOG_LEVEL_WARNING) ? OWL_TERMINAL_YELLOW
+      : (level == OWL_LOG_LEVEL_OK)      ? OWL_TERMINAL_BLUE
+      : (level == OWL_LOG_LEVEL_DEBUG)   ? OWL_TERMINAL_DEFAULT
+      :                                    OWL_TERMINAL_LIGHT_BLUE;
+    fprintf(file,"%s#owl: %s%s\n",color,message.c_str(),OWL_TERMINAL_DEFAULT);
+  }
+
+  void FileLogSink::flush()
+  {
+    fflush(file);
+  }
+
+  // ------------------------------------------------------------------
+  // logger
+  // ------------------------------------------------------------------
+
+  static int defaultLogLevel()
+  {
+#ifdef NDEBUG
+    int level = OWL_LOG_LEVEL_WARNING;
+#else
+    int level = OWL_LOG_LEVEL_INFO;
+#endif
+    const char *fromEnv = getenv("OWL_LOG_LEVEL");
+    if (fromEnv) {
+      const std::string s = fromEnv;
+      if      (s == "debug")   level = OWL_LOG_LEVEL_DEBUG;
+      else if (s == "info")    level = OWL_LOG_LEVEL_INFO;
+      else if (s == "ok")      level = OWL_LOG_LEVEL_OK;
+      else if (s == "warning") level = OWL_LOG_LEVEL_WARNING;
+      else if (s == "error")   level = OWL_LOG_LEVEL_ERROR;
+      else if (s == "none")    level = OWL_LOG_LEVEL_NONE;
+      else
+        fprintf(stderr,"#owl: unknown OWL_LOG_LEVEL '%s' (ignoring)\n",fromEnv);
+    }
+    return level;
+  }
+
+  std::atomic<int> Logger::threshold { defaultLogLevel() };
+
+  Logger &Logger::get()
+  {
+    static Logger logger;
+    return logger;
+  }
+
+  Logger::Logger()
+    : slots(QUEUE_SIZE),
+      sink(std::make_shared<FileLogSink>())
+  {
+    for (size_t i=0;i<slots.size();i++)
+      slots[i].sequence.store(i,std::memory_order_relaxed);
+    thread = std::thread([this](){ drainLoop(); });
+  }
+
+  Logger::~Logger()
+  {
+    quit = true;
+    {
+      std::lock_guard<std::mutex> lock(wakeupMutex);
+      wakeup.notify_one();
+    }
+    thread.join();
+    // drainLoop() drains once more after seeing 'quit', but a
+    // producer might still have slipped something in
+    drain();
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    sink->flush();
+  }
+
+  void Logger::log(OWLLogLevel level, std::string &&message)
+  {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (1) {
+      slot = &slots[pos % QUEUE_SIZE];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+      if (diff == 0) {
+        if (enqueuePos.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        // queue full - if that's us logging from within a sink we'd
+        // wait for ourselves, so drop the message ...
+        if (std::this_thread::get_id() == thread.get_id())
+          return;
+        // ... otherwise make sure the consumer is awake, and wait for
+        // it to free up a slot
+        wakeup.notify_one();
+        std::this_thread::yield();
+        pos = enqueuePos.load(std::memory_order_relaxed);
+      } else
+        pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+    slot->level   = level;
+    slot->message = std::move(message);
+    slot->sequence.store(pos+1,std::memory_order_release);
+
+    if (sleeping.load())
+      wakeup.notify_one();
+
+    if (level >= OWL_LOG_LEVEL_ERROR)
+      flush();
+  }
+
+  size_t Logger::drain()
+  {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    size_t numDrained = 0;
+    while (1) {
+      Slot &slot = slots[dequeuePos % QUEUE_SIZE];
+      if (slot.sequence.load(std::memory_order_acquire) != dequeuePos+1)
+        break;
+      const OWLLogLevel level = slot.level;
+      const std::string message = std::move(slot.message);
+      slot.message.clear();
+      slot.sequence.store(dequeuePos+QUEUE_SIZE,std::memory_order_release);
+      ++dequeuePos;
+      sink->write(level,message);
+      numWritten.store(dequeuePos,std::memory_order_release);
+      ++numDrained;
+    }
+    return numDrained;
+  }
+
+  void Logger::drainLoop()
+  {
+    while (!quit) {
+      if (drain() > 0)
+        continue;
+      std::unique_lock<std::mutex> lock(wakeupMutex);
+      sleeping = true;
+      // producers only notify if they see us sleeping, so a message
+      // queued just before we set 'sleeping' could be missed - hence
+      // the timeout rather than an unbounded wait
+      wakeup.wait_for(lock,std::chrono::milliseconds(10));
+      sleeping = false;
+    }
+    drain();
+  }
+
+  void Logger::flush()
+  {
+    // called from within a sink: the background thread is already
+    // busy writing, and holds the sink lock
+    if (std::this_thread::get_id() == thread.get_id())
+      return;
+
+    const size_t target = enqueuePos.load();
+    while (numWritten.load(std::memory_order_acquire) < target) {
+      wakeup.notify_one();
+      std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    sink->flush();
+  }
+
+  void Logger::setSink(LogSink::SP newSink)
+  {
+    flush();
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    sink = newSink ? newSink : std::make_shared<FileLogSink>();
+  }
+
+} // ::owl
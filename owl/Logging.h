@@ -0,0 +1,172 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/Logging.h OWL's (internal) logging subsystem.
+
+    Code logs through the OWL_LOG_XXX(message) macros, where
+    'message' is anything that can be streamed into a std::ostream
+    ("built " << numPrims << " prims"). If the message's level is
+    disabled the macro does nothing but compare two ints; otherwise
+    the formatted message gets pushed into a lock-free queue, and
+    written out by a background thread, to whatever LogSink is
+    currently installed (stderr by default). Errors are the
+    exception: those get flushed out right away. */
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+#include <condition_variable>
+#include <thread>
+
+namespace owl {
+
+  /*! a destination for log messages. Sinks only ever get called
+      from the logger's background thread, so don't have to be
+      thread safe */
+  struct LogSink {
+    typedef std::shared_ptr<LogSink> SP;
+
+    virtual ~LogSink() {}
+    virtual void write(OWLLogLevel level, const std::string &message) = 0;
+    virtual void flush() {}
+  };
+
+  /*! writes messages to a FILE - either stderr (with colors), or a
+      file it opens (and owns) */
+  struct FileLogSink : public LogSink {
+    /*! sink for stderr */
+    FileLogSink();
+    /*! sink writing into the given file; throws if that can't be
+        opened */
+    FileLogSink(const std::string &fileName);
+    virtual ~FileLogSink();
+
+    void write(OWLLogLevel level, const std::string &message) override;
+    void flush() override;
+
+    FILE *const file;
+    const bool  ownsFile;
+    const bool  useColors;
+  };
+
+  /*! forwards messages to a user-supplied OWLLogCallback */
+  struct CallbackLogSink : public LogSink {
+    CallbackLogSink(OWLLogCallback callback, void *userData)
+      : callback(callback), userData(userData)
+    {}
+
+    void write(OWLLogLevel level, const std::string &message) override
+    { callback(level,message.c_str(),userData); }
+
+    const OWLLogCallback callback;
+    void *const          userData;
+  };
+
+  /*! the logger singleton: a bounded multi-producer/single-consumer
+      queue of messages (Vyukov-style: each slot carries a sequence
+      number that tells producers and consumer whose turn it is),
+      drained by a background thread */
+  struct Logger {
+    enum { QUEUE_SIZE = 4096 };
+
+    static Logger &get();
+
+    /*! whether messages of the given level get emitted; this is what
+        the OWL_LOG macros check before formatting anything */
+    static inline bool enabled(OWLLogLevel level)
+    { return int(level) >= threshold.load(std::memory_order_relaxed); }
+
+    static void setLevel(OWLLogLevel level)
+    { threshold.store(int(level)); }
+
+    /*! a per-thread, emptied, stream to format messages into;
+        re-using this is quite a bit cheaper than constructing a new
+        std::ostringstream for every message */
+    static inline std::ostringstream &formatStream()
+    {
+      static thread_local std::ostringstream stream;
+      stream.str(std::string());
+      stream.clear();
+      return stream;
+    }
+
+    /*! queues a (formatted) message; blocks only if the queue is
+        full. Messages of level OWL_LOG_LEVEL_ERROR also get flushed
+        right away */
+    void log(OWLLogLevel level, std::string &&message);
+
+    /*! blocks until every message queued so far has been written,
+        and flushes the sink */
+    void flush();
+
+    /*! replaces the current sink (after writing out everything
+        queued so far to the old one); null restores stderr */
+    void setSink(LogSink::SP sink);
+
+  private:
+    Logger();
+    ~Logger();
+
+    void drainLoop();
+    /*! writes out all currently available messages; returns number
+        of messages written */
+    size_t drain();
+
+    struct Slot {
+      std::atomic<size_t> sequence;
+      OWLLogLevel         level;
+      std::string         message;
+    };
+
+    std::vector<Slot>       slots;
+    std::atomic<size_t>     enqueuePos { 0 };
+    /*! number of messages fully written; only modified by the
+        background thread */
+    std::atomic<size_t>     numWritten { 0 };
+    size_t                  dequeuePos { 0 };
+
+    std::mutex              sinkMutex;
+    LogSink::SP             sink;
+
+    std::mutex              wakeupMutex;
+    std::condition_variable wakeup;
+    std::atomic<bool>       sleeping { false };
+    std::atomic<bool>       quit     { false };
+    std::thread             thread;
+
+    static std::atomic<int> threshold;
+  };
+
+} // ::owl
+
+/*! logs 'message' (anything that can be streamed into a
+    std::ostream) at the given level; formats nothing if that level
+    is disabled */
+#define OWL_LOG(level,message)                                  \
+  do {                                                          \
+    if (owl::Logger::enabled(level)) {                          \
+      std::ostringstream &owl_log_ss = owl::Logger::formatStream(); \
+      owl_log_ss << message;                                    \
+      owl::Logger::get().log(level,owl_log_ss.str());           \
+    }                                                           \
+  } while (0)
+
+#define OWL_LOG_DEBUG(message)   OWL_LOG(OWL_LOG_LEVEL_DEBUG,message)
+#define OWL_LOG_INFO(message)    OWL_LOG(OWL_LOG_LEVEL_INFO,message)
+#define OWL_LOG_OK(message)      OWL_LOG(OWL_LOG_LEVEL_OK,message)
+#define OWL_LOG_WARNING(message) OWL_LOG(OWL_LOG_LEVEL_WARNING,message)
+#define OWL_LOG_ERROR(message)   OWL_LOG(OWL_LOG_LEVEL_ERROR,message)
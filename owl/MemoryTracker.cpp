@@ -0,0 +1,188 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "MemoryTracker.h"
+#include <sstream>
+
+namespace owl {
+
+  const char *MemoryTracker::categoryName(OWLMemoryCategory category)
+  {
+    switch (category) {
+    case OWL_MEMORY_BUFFER:        return "buffer";
+    case OWL_MEMORY_TEXTURE:       return "texture";
+    case OWL_MEMORY_SBT:           return "sbt";
+    case OWL_MEMORY_LAUNCH_PARAMS: return "launchParams";
+    case OWL_MEMORY_ACCEL:         return "accel";
+    case OWL_MEMORY_ACCEL_TEMP:    return "accelTemp";
+    case OWL_MEMORY_OTHER:         return "other";
+    case OWL_MEMORY_ALL:           return "all";
+    default:                       return "invalid";
+    }
+  }
+
+  static OWLMemoryCategory checkCategory(OWLMemoryCategory category)
+  {
+    if (unsigned(category) > unsigned(OWL_MEMORY_ALL))
+      throw std::runtime_error("#owl: invalid memory category "
+                               +std::to_string(int(category)));
+    return category;
+  }
+
+  std::string MemoryTracker::describeUsage() const
+  {
+    std::stringstream ss;
+    ss << prettyBytes(currentBytes[OWL_MEMORY_ALL]) << "B in use";
+    const char *separator = " (";
+    for (int i=0;i<OWL_MEMORY_NUM_CATEGORIES;i++) {
+      if (!numAllocs[i]) continue;
+      ss << separator << categoryName((OWLMemoryCategory)i) << ": "
+         << prettyBytes(currentBytes[i]) << "B in "
+         << numAllocs[i] << " allocation" << (numAllocs[i] == 1 ? "" : "s");
+      separator = ", ";
+    }
+    if (numAllocs[OWL_MEMORY_ALL]) ss << ")";
+    if (reservedBytes > currentBytes[OWL_MEMORY_ALL])
+      ss << ", " << prettyBytes(reservedBytes) << "B with rounding";
+    ss << ", peak " << prettyBytes(peakBytes[OWL_MEMORY_ALL]) << "B";
+    return ss.str();
+  }
+
+  void MemoryTracker::checkBudget(size_t size, OWLMemoryCategory category,
+                                  size_t reserved, size_t cached) const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (budget == 0 || reservedBytes+cached+std::max(size,reserved) <= budget)
+      return;
+    std::stringstream ss;
+    ss << "#owl: allocating " << prettyBytes(size) << "B ("
+       << size << " bytes) of " << categoryName(category)
+       << " memory on device #" << deviceID
+       << " would exceed its memory budget of " << prettyBytes(budget)
+       << "B; " << describeUsage();
+    if (cached)
+      ss << ", plus " << prettyBytes(cached) << "B cached";
+    throw std::runtime_error(ss.str());
+  }
+
+  bool MemoryTracker::fitsBudget(size_t bytes) const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return budget == 0 || reservedBytes+bytes <= budget;
+  }
+
+  void MemoryTracker::allocated(const void *ptr, size_t size, OWLMemoryCategory category,
+                                size_t reserved)
+  {
+    if (!ptr) return;
+    checkCategory(category);
+    std::lock_guard<std::mutex> lock(mutex);
+    Allocation &alloc = allocations[ptr];
+    if (alloc.size) {
+      // address got re-used without us seeing the free (eg, memory
+      // that got freed directly through cuda)
+      currentBytes[alloc.category] -= alloc.size;
+      currentBytes[OWL_MEMORY_ALL] -= alloc.size;
+      numAllocs[alloc.category]--;
+      numAllocs[OWL_MEMORY_ALL]--;
+      reservedBytes -= alloc.reserved;
+    }
+    alloc.size     = size;
+    alloc.reserved = std::max(size,reserved);
+    alloc.category = category;
+    reservedBytes += alloc.reserved;
+    for (int i : { int(category), int(OWL_MEMORY_ALL) }) {
+      currentBytes[i] += size;
+      numAllocs[i]++;
+      peakBytes[i] = std::max(peakBytes[i],currentBytes[i]);
+    }
+  }
+
+  void MemoryTracker::freed(const void *ptr)
+  {
+    if (!ptr) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = allocations.find(ptr);
+    if (it == allocations.end()) return;
+    for (int i : { int(it->second.category), int(OWL_MEMORY_ALL) }) {
+      currentBytes[i] -= it->second.size;
+      numAllocs[i]--;
+    }
+    reservedBytes -= it->second.reserved;
+    allocations.erase(it);
+  }
+
+  size_t MemoryTracker::current(OWLMemoryCategory category) const
+  {
+    checkCategory(category);
+    std::lock_guard<std::mutex> lock(mutex);
+    return currentBytes[category];
+  }
+
+  size_t MemoryTracker::peak(OWLMemoryCategory category) const
+  {
+    checkCategory(category);
+    std::lock_guard<std::mutex> lock(mutex);
+    return peakBytes[category];
+  }
+
+  size_t MemoryTracker::reserved() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return reservedBytes;
+  }
+
+  void MemoryTracker::resetPeaks()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i=0;i<=OWL_MEMORY_ALL;i++)
+      peakBytes[i] = currentBytes[i];
+  }
+
+  void MemoryTracker::setBudget(size_t maxBytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = maxBytes;
+  }
+
+  size_t MemoryTracker::getBudget() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return budget;
+  }
+
+  std::string MemoryTracker::toJSON() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::stringstream ss;
+    ss << "{\"deviceID\":" << deviceID
+       << ",\"budget\":" << budget
+       << ",\"current\":" << currentBytes[OWL_MEMORY_ALL]
+       << ",\"reserved\":" << reservedBytes
+       << ",\"peak\":" << peakBytes[OWL_MEMORY_ALL]
+       << ",\"numAllocations\":" << numAllocs[OWL_MEMORY_ALL]
+       << ",\"categories\":{";
+    for (int i=0;i<OWL_MEMORY_NUM_CATEGORIES;i++)
+      ss << (i ? "," : "")
+         << "\"" << categoryName((OWLMemoryCategory)i) << "\":{"
+         << "\"current\":" << currentBytes[i]
+         << ",\"peak\":" << peakBytes[i]
+         << ",\"numAllocations\":" << numAllocs[i] << "}";
+    ss << "}}";
+    return ss.str();
+  }
+
+} // ::owl
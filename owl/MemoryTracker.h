@@ -0,0 +1,122 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/MemoryTracker.h Per-device accounting of the device
+    memory that owl allocates.
+
+    Each DeviceContext has one tracker; SetActiveGPU makes it the
+    calling thread's active one, and DeviceMemory::alloc(),
+    deviceMalloc() and friends record every allocation (keyed by its
+    address, and tagged with an OWLMemoryCategory) in it, and remove
+    it again when it gets freed. Each tracker keeps current and peak
+    usage per category and in total, and can have a budget that
+    allocations get checked against *before* they get made.
+
+    Usage counts what got asked for; the budget is about what that
+    actually takes up: each allocation's 'reserved' size (ie, its
+    size class, if it came from a CachingAllocator), plus whatever
+    the allocator keeps cached besides. */
+
+#pragma once
+
+#include "owl/owl_host.h"
+#include "owl/common.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace owl {
+
+  struct MemoryTracker {
+    MemoryTracker(int deviceID) : deviceID(deviceID) {}
+
+    /*! throws (with a report of what's using the memory) if
+        allocating another 'size' bytes - that take up 'reserved'
+        bytes, if that's more - would go over the budget, given that
+        'cached' bytes are held on to besides what's reserved
+        already */
+    void checkBudget(size_t size, OWLMemoryCategory category,
+                     size_t reserved = 0, size_t cached = 0) const;
+
+    /*! whether another 'bytes' bytes on top of what's reserved would
+        still be within the budget (if there is one) */
+    bool fitsBudget(size_t bytes) const;
+
+    /*! records an allocation of 'size' bytes, which take up
+        'reserved' bytes if that's more; null pointers get ignored */
+    void allocated(const void *ptr, size_t size, OWLMemoryCategory category,
+                   size_t reserved = 0);
+
+    /*! removes the allocation at the given address, if there is one */
+    void freed(const void *ptr);
+
+    /*! current and peak usage of the given category, or all of them
+        (OWL_MEMORY_ALL) */
+    size_t current(OWLMemoryCategory category) const;
+    size_t peak(OWLMemoryCategory category) const;
+
+    /*! what all current allocations take up, rounding included */
+    size_t reserved() const;
+
+    /*! sets all peaks to current usage */
+    void resetPeaks();
+
+    /*! 0 means no budget */
+    void   setBudget(size_t maxBytes);
+    size_t getBudget() const;
+
+    /*! one device's usage, budget, and allocation counts, as a JSON
+        object */
+    std::string toJSON() const;
+
+    /*! lower camel case name, as used in reports */
+    static const char *categoryName(OWLMemoryCategory category);
+
+    /*! owl's ID of the device this tracks */
+    const int deviceID;
+
+  private:
+    struct Allocation {
+      size_t            size;
+      size_t            reserved;
+      OWLMemoryCategory category;
+    };
+
+    /*! human-readable usage per category, for error messages; must
+        be called with the mutex locked */
+    std::string describeUsage() const;
+
+    mutable std::mutex mutex;
+    std::unordered_map<const void *,Allocation> allocations;
+    /*! per category, with the totals at [OWL_MEMORY_ALL] */
+    size_t currentBytes[OWL_MEMORY_NUM_CATEGORIES+1] = {};
+    size_t peakBytes[OWL_MEMORY_NUM_CATEGORIES+1]    = {};
+    size_t numAllocs[OWL_MEMORY_NUM_CATEGORIES+1]    = {};
+    size_t reservedBytes = 0;
+    size_t budget = 0;
+  };
+
+  namespace detail {
+    /*! the memory tracker of the device that SetActiveGPU currently
+        has active on this thread; null if none (in which case
+        allocations don't get tracked) */
+    inline MemoryTracker *&activeMemoryTracker()
+    {
+      static thread_local MemoryTracker *tracker = nullptr;
+      return tracker;
+    }
+  }
+
+} // ::owl
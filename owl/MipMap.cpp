@@ -0,0 +1,429 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "MipMap.h"
+#include "owl/common/parallel/parallel_for.h"
+#include <algorithm>
+#include <math.h>
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && !defined(__CUDACC__)
+# include <immintrin.h>
+# define OWL_HAVE_SSE2_MIPMAP 1
+#endif
+
+namespace owl {
+  namespace mipmap {
+
+    /*! number of output rows each parallel task computes */
+    enum { ROWS_PER_TASK = 16 };
+
+    /*! support of the Kaiser filter, in texels of the *output*
+        level, and its alpha (ie, shape) parameter */
+    static const float kaiserWidth = 3.f;
+    static const float kaiserAlpha = 4.f;
+    
+    size_t bytesPerTexel(OWLTexelFormat format)
+    {
+      switch (format) {
+      case OWL_TEXEL_FORMAT_RGBA8:   return sizeof(vec4uc);
+      case OWL_TEXEL_FORMAT_RGBA32F: return sizeof(vec4f);
+      case OWL_TEXEL_FORMAT_R8:      return sizeof(uint8_t);
+      case OWL_TEXEL_FORMAT_R32F:    return sizeof(float);
+      default:
+        throw std::runtime_error("texel format not implemented");
+      }
+    }
+
+    static inline int numChannels(OWLTexelFormat format)
+    {
+      return (format == OWL_TEXEL_FORMAT_RGBA8 ||
+              format == OWL_TEXEL_FORMAT_RGBA32F) ? 4 : 1;
+    }
+
+    static inline bool isFloat(OWLTexelFormat format)
+    {
+      return (format == OWL_TEXEL_FORMAT_RGBA32F ||
+              format == OWL_TEXEL_FORMAT_R32F);
+    }
+
+    int numLevels(vec2i size)
+    {
+      int n = 1;
+      for (int s = std::max(size.x,size.y); s > 1; s >>= 1)
+        n++;
+      return n;
+    }
+
+    // ------------------------------------------------------------------
+    // 8-bit <-> float conversion, including sRGB
+    // ------------------------------------------------------------------
+
+    static inline float srgbToLinear(float c)
+    {
+      return (c <= 0.04045f) ? c/12.92f : powf((c+0.055f)/1.055f,2.4f);
+    }
+    
+    /*! lookup tables for converting 8-bit unorm values from and to
+        (linear) floats. Encoding to sRGB is exact (ie, gives the
+        same result as rounding the sRGB curve): a coarse table gets
+        us to (just below) the right value, and the exact rounding
+        thresholds from there */
+    struct UNorm8Tables {
+      enum { COARSE_SIZE = 4096 };
+      
+      UNorm8Tables()
+      {
+        for (int i=0;i<256;i++) {
+          linear[i] = i/255.f;
+          fromSRGB[i] = srgbToLinear(i/255.f);
+        }
+        for (int i=0;i<255;i++)
+          srgbThreshold[i] = srgbToLinear((i+.5f)/255.f);
+        int code = 0;
+        for (int i=0;i<=COARSE_SIZE;i++) {
+          const float v = i/float(COARSE_SIZE);
+          while (code < 255 && v >= srgbThreshold[code]) code++;
+          coarseSRGB[i] = (uint8_t)code;
+        }
+      }
+
+      inline uint8_t toSRGB(float v) const
+      {
+        v = std::min(std::max(v,0.f),1.f);
+        int code = coarseSRGB[int(v*COARSE_SIZE)];
+        while (code < 255 && v >= srgbThreshold[code]) code++;
+        return (uint8_t)code;
+      }
+      
+      static inline uint8_t toLinear(float v)
+      {
+        v = std::min(std::max(v,0.f),1.f);
+        return (uint8_t)(v*255.f+.5f);
+      }
+
+      float   linear[256];
+      float   fromSRGB[256];
+      float   srgbThreshold[255];
+      uint8_t coarseSRGB[COARSE_SIZE+1];
+    };
+
+    static const UNorm8Tables &unorm8Tables()
+    {
+      static UNorm8Tables tables;
+      return tables;
+    }
+    
+    /*! converts a row of texels to floats - linearizing sRGB color
+        channels (but never alpha) */
+    static void decodeRow(OWLTexelFormat format, bool srgb,
+                          const void *in, int numTexels, float *out)
+    {
+      if (isFloat(format)) {
+        memcpy(out,in,numTexels*bytesPerTexel(format));
+        return;
+      }
+      const UNorm8Tables &tables = unorm8Tables();
+      const uint8_t *texels = (const uint8_t *)in;
+      const float *color = srgb ? tables.fromSRGB : tables.linear;
+      if (format == OWL_TEXEL_FORMAT_R8)
+        for (int i=0;i<numTexels;i++)
+          out[i] = color[texels[i]];
+      else
+        for (int i=0;i<numTexels;i++) {
+          out[4*i+0] = color[texels[4*i+0]];
+          out[4*i+1] = color[texels[4*i+1]];
+          out[4*i+2] = color[texels[4*i+2]];
+          out[4*i+3] = tables.linear[texels[4*i+3]];
+        }
+    }
+
+    /*! inverse of decodeRow */
+    static void encodeRow(OWLTexelFormat format, bool srgb,
+                          const float *in, int numTexels, void *out)
+    {
+      if (isFloat(format)) {
+        memcpy(out,in,numTexels*bytesPerTexel(format));
+        return;
+      }
+      const UNorm8Tables &tables = unorm8Tables();
+      uint8_t *texels = (uint8_t *)out;
+      if (format == OWL_TEXEL_FORMAT_R8) {
+        for (int i=0;i<numTexels;i++)
+          texels[i] = srgb ? tables.toSRGB(in[i]) : tables.toLinear(in[i]);
+      } else if (srgb) {
+        for (int i=0;i<numTexels;i++) {
+          texels[4*i+0] = tables.toSRGB(in[4*i+0]);
+          texels[4*i+1] = tables.toSRGB(in[4*i+1]);
+          texels[4*i+2] = tables.toSRGB(in[4*i+2]);
+          texels[4*i+3] = tables.toLinear(in[4*i+3]);
+        }
+      } else {
+        int i = 0;
+#if OWL_HAVE_SSE2_MIPMAP
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one  = _mm_set1_ps(1.f);
+        const __m128 s    = _mm_set1_ps(255.f);
+        for (;i+4<=numTexels;i+=4) {
+          __m128i v[4];
+          for (int j=0;j<4;j++) {
+            __m128 f = _mm_loadu_ps(in+4*(i+j));
+            f = _mm_min_ps(_mm_max_ps(f,zero),one);
+            // values are non-negative, so rounding equals +.5 and
+            // truncating, same as the scalar code
+            v[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f,s),_mm_set1_ps(.5f)));
+          }
+          const __m128i lo = _mm_packs_epi32(v[0],v[1]);
+          const __m128i hi = _mm_packs_epi32(v[2],v[3]);
+          _mm_storeu_si128((__m128i*)(texels+4*i),_mm_packus_epi16(lo,hi));
+        }
+#endif
+        for (int j=4*i;j<4*numTexels;j++)
+          texels[j] = tables.toLinear(in[j]);
+      }
+    }
+
+    // ------------------------------------------------------------------
+    // filter taps
+    // ------------------------------------------------------------------
+
+    /*! which texels (and with what weights) each output texel gets
+        computed from, along one dimension */
+    struct Taps {
+      /*! taps of output texel i are [begin[i],begin[i+1]) */
+      std::vector<int>   begin;
+      std::vector<int>   index;
+      std::vector<float> weight;
+      /*! whether this is the identity (ie, in- and output size are
+          the same), so filtering can be skipped */
+      bool               identity;
+    };
+
+    /*! maps a (possibly out-of-range) texel index into [0,size),
+        according to the address mode */
+    static inline int resolve(int i, int size, OWLTextureAddressMode addressMode)
+    {
+      if (i >= 0 && i < size)
+        return i;
+      switch (addressMode) {
+      case OWL_TEXTURE_WRAP:
+        return ((i % size) + size) % size;
+      case OWL_TEXTURE_MIRROR: {
+        const int m = ((i % (2*size)) + 2*size) % (2*size);
+        return m < size ? m : 2*size-1-m;
+      }
+      default:
+        // clamp, and border: (at least) for filtering, repeating the
+        // edge texels makes more sense than blending in the border
+        // color
+        return std::min(std::max(i,0),size-1);
+      }
+    }
+
+    /*! modified Bessel function of the first kind, order zero */
+    static double besselI0(double x)
+    {
+      double sum = 1., term = 1.;
+      for (int k=1;k<50 && term > 1e-12*sum;k++) {
+        term *= (x/(2.*k))*(x/(2.*k));
+        sum += term;
+      }
+      return sum;
+    }
+
+    /*! Kaiser-windowed sinc, for a distance 'd' measured in output
+        texels */
+    static double kaiser(double d)
+    {
+      const double x = d/kaiserWidth;
+      if (fabs(x) >= 1.) return 0.;
+      const double sinc = (d == 0.) ? 1. : sin(M_PI*d)/(M_PI*d);
+      return sinc * besselI0(kaiserAlpha*sqrt(1.-x*x)) / besselI0(kaiserAlpha);
+    }
+    
+    static Taps computeTaps(int inSize, int outSize,
+                            OWLMipmapFilter filter,
+                            OWLTextureAddressMode addressMode)
+    {
+      Taps taps;
+      taps.identity = (inSize == outSize);
+      const double scale = inSize / double(outSize);
+      for (int o=0;o<outSize;o++) {
+        taps.begin.push_back((int)taps.index.size());
+        double sum = 0.;
+        std::vector<std::pair<int,double>> texelTaps;
+        if (filter == OWL_MIPMAP_FILTER_BOX) {
+          // area of the input texels covered by this output texel
+          const double lo = o*scale, hi = (o+1)*scale;
+          for (int i=(int)floor(lo);i<(int)ceil(hi);i++) {
+            const double w = std::min(hi,i+1.)-std::max(lo,double(i));
+            if (w > 0.) texelTaps.push_back({i,w});
+          }
+        } else {
+          const double center = (o+.5)*scale;
+          const double radius = kaiserWidth*scale;
+          for (int i=(int)floor(center-radius);i<=(int)ceil(center+radius);i++) {
+            const double w = kaiser((i+.5-center)/scale);
+            if (w != 0.) texelTaps.push_back({i,w});
+          }
+        }
+        for (auto &t : texelTaps) sum += t.second;
+        for (auto &t : texelTaps) {
+          taps.index.push_back(resolve(t.first,inSize,addressMode));
+          taps.weight.push_back(float(t.second/sum));
+        }
+      }
+      taps.begin.push_back((int)taps.index.size());
+      return taps;
+    }
+
+    // ------------------------------------------------------------------
+    // filtering
+    // ------------------------------------------------------------------
+
+    /*! filters one (decoded) row along x */
+    static void filterRow(const Taps &taps, int numChannels,
+                          const float *in, float *out, int outSize)
+    {
+      if (numChannels == 4) {
+        for (int o=0;o<outSize;o++) {
+#if OWL_HAVE_SSE2_MIPMAP
+          __m128 sum = _mm_setzero_ps();
+          for (int t=taps.begin[o];t<taps.begin[o+1];t++)
+            sum = _mm_add_ps(sum,_mm_mul_ps(_mm_set1_ps(taps.weight[t]),
+                                            _mm_loadu_ps(in+4*taps.index[t])));
+          _mm_storeu_ps(out+4*o,sum);
+#else
+          float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+          for (int t=taps.begin[o];t<taps.begin[o+1];t++)
+            for (int c=0;c<4;c++)
+              sum[c] += taps.weight[t] * in[4*taps.index[t]+c];
+          for (int c=0;c<4;c++)
+            out[4*o+c] = sum[c];
+#endif
+        }
+      } else {
+        for (int o=0;o<outSize;o++) {
+          float sum = 0.f;
+          for (int t=taps.begin[o];t<taps.begin[o+1];t++)
+            sum += taps.weight[t] * in[taps.index[t]];
+          out[o] = sum;
+        }
+      }
+    }
+
+    /*! out[i] += w * in[i] */
+    static inline void addScaled(float *out, const float *in, float w, size_t count)
+    {
+      size_t i = 0;
+#if OWL_HAVE_SSE2_MIPMAP
+      const __m128 w4 = _mm_set1_ps(w);
+      for (;i+4<=count;i+=4)
+        _mm_storeu_ps(out+i,_mm_add_ps(_mm_loadu_ps(out+i),
+                                       _mm_mul_ps(w4,_mm_loadu_ps(in+i))));
+#endif
+      for (;i<count;i++)
+        out[i] += w*in[i];
+    }
+    
+    void downsample(OWLTexelFormat        format,
+                    OWLTextureColorSpace  colorSpace,
+                    OWLMipmapFilter       filter,
+                    OWLTextureAddressMode addressMode,
+                    const void *in, vec2i inSize, size_t inPitch,
+                    void *out, vec2i outSize)
+    {
+      if (inSize.x <= 0 || inSize.y <= 0 || outSize.x <= 0 || outSize.y <= 0)
+        throw std::runtime_error("invalid mip level size");
+      const size_t texelSize = bytesPerTexel(format);
+      if (inPitch == 0)
+        inPitch = inSize.x*texelSize;
+      const size_t outPitch = outSize.x*texelSize;
+      const int    C        = numChannels(format);
+      // sRGB only applies to 8-bit formats; float textures are
+      // always linear
+      const bool   srgb
+        = (colorSpace == OWL_COLOR_SPACE_SRGB) && !isFloat(format);
+
+      const Taps tapsX = computeTaps(inSize.x,outSize.x,filter,addressMode);
+      const Taps tapsY = computeTaps(inSize.y,outSize.y,filter,addressMode);
+      
+      const int numTasks = divRoundUp(outSize.y,(int)ROWS_PER_TASK);
+      parallel_for(numTasks,[&](int taskID){
+          const int y0 = taskID*ROWS_PER_TASK;
+          const int y1 = std::min(y0+(int)ROWS_PER_TASK,outSize.y);
+
+          // the input rows these output rows need (with wrap/mirror
+          // modes those aren't necessarily contiguous) ...
+          std::vector<int> rows(tapsY.index.begin()+tapsY.begin[y0],
+                                tapsY.index.begin()+tapsY.begin[y1]);
+          std::sort(rows.begin(),rows.end());
+          rows.erase(std::unique(rows.begin(),rows.end()),rows.end());
+
+          // ... decoded and filtered in x
+          const size_t rowSize = size_t(outSize.x)*C;
+          std::vector<float> filtered(rows.size()*rowSize);
+          std::vector<float> decoded(tapsX.identity ? 0 : size_t(inSize.x)*C);
+          for (size_t r=0;r<rows.size();r++) {
+            const uint8_t *row = (const uint8_t *)in + rows[r]*inPitch;
+            float *dst = filtered.data()+r*rowSize;
+            if (tapsX.identity)
+              decodeRow(format,srgb,row,inSize.x,dst);
+            else {
+              decodeRow(format,srgb,row,inSize.x,decoded.data());
+              filterRow(tapsX,C,decoded.data(),dst,outSize.x);
+            }
+          }
+
+          // then filter in y
+          std::vector<float> sum(rowSize);
+          for (int y=y0;y<y1;y++) {
+            std::fill(sum.begin(),sum.end(),0.f);
+            for (int t=tapsY.begin[y];t<tapsY.begin[y+1];t++) {
+              const size_t r
+                = std::lower_bound(rows.begin(),rows.end(),tapsY.index[t])-rows.begin();
+              addScaled(sum.data(),filtered.data()+r*rowSize,tapsY.weight[t],rowSize);
+            }
+            encodeRow(format,srgb,sum.data(),outSize.x,(uint8_t *)out + y*outPitch);
+          }
+        });
+    }
+
+    std::vector<Level> generate(OWLTexelFormat        format,
+                                OWLTextureColorSpace  colorSpace,
+                                OWLMipmapFilter       filter,
+                                OWLTextureAddressMode addressMode,
+                                const void *texels, vec2i size,
+                                size_t linePitchInBytes)
+    {
+      const int n = numLevels(size);
+      std::vector<Level> levels(n-1);
+      const void *in = texels;
+      size_t inPitch = linePitchInBytes;
+      for (int l=1;l<n;l++) {
+        Level &level = levels[l-1];
+        level.size = levelSize(size,l);
+        level.texels.resize(size_t(level.size.x)*level.size.y*bytesPerTexel(format));
+        downsample(format,colorSpace,filter,addressMode,
+                   in,levelSize(size,l-1),inPitch,
+                   level.texels.data(),level.size);
+        in      = level.texels.data();
+        inPitch = 0;
+      }
+      return levels;
+    }
+    
+  } // ::owl::mipmap
+} // ::owl
@@ -0,0 +1,76 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/MipMap.h Host-side mip chain generation for textures.
+
+    Each level gets computed from the one above it with a separable
+    filter (box, or Kaiser-windowed sinc), on linear values - ie,
+    sRGB texels get linearized before filtering and re-encoded
+    afterwards. Rows of each level are processed in parallel, and
+    filtering itself uses SSE where available.
+
+    This does not depend on CUDA (or on a Context), so can be used -
+    and tested - on its own. */
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+
+namespace owl {
+  namespace mipmap {
+
+    /*! size of a single texel of given format, in bytes */
+    size_t bytesPerTexel(OWLTexelFormat format);
+
+    /*! number of levels in a full mip chain for given base size,
+        ie, down to and including 1x1 */
+    int numLevels(vec2i size);
+
+    /*! size of given level, for given base level size */
+    inline vec2i levelSize(vec2i size, int level)
+    { return vec2i(std::max(1,size.x >> level),std::max(1,size.y >> level)); }
+
+    /*! one level of a mip chain; texels are tightly packed */
+    struct Level {
+      vec2i                size;
+      std::vector<uint8_t> texels;
+    };
+
+    /*! computes one level from the one above it; 'out' has to be
+        tightly packed. Sizes do not have to be exactly half those of
+        'in' (odd sizes are fine, and so are levels that get
+        down-sampled in only one dimension). The address mode
+        determines how the filter treats texels beyond the borders */
+    void downsample(OWLTexelFormat        format,
+                    OWLTextureColorSpace  colorSpace,
+                    OWLMipmapFilter       filter,
+                    OWLTextureAddressMode addressMode,
+                    const void *in, vec2i inSize, size_t inPitchInBytes,
+                    void *out, vec2i outSize);
+
+    /*! generates levels 1 .. numLevels(size)-1 from the given base
+        level (which does not get copied, and is not part of the
+        returned vector); ie, result[i] is level i+1 */
+    std::vector<Level> generate(OWLTexelFormat        format,
+                                OWLTextureColorSpace  colorSpace,
+                                OWLMipmapFilter       filter,
+                                OWLTextureAddressMode addressMode,
+                                const void *texels, vec2i size,
+                                size_t linePitchInBytes = 0);
+    
+  } // ::owl::mipmap
+} // ::owl
@@ -85,7 +85,7 @@ namespace owl {
     // ------------------------------------------------------------------
     // pack record header with the corresponding hit group:
     // ------------------------------------------------------------------
-    OPTIX_CALL(SbtRecordPackHeader(dd.pg,sbtRecordHeader));
+    device->sbtRecordPackHeader(dd.pg,sbtRecordHeader);
     
     // ------------------------------------------------------------------
     // then, write the data for that record
@@ -17,23 +17,6 @@
 #include "Module.h"
 #include "Context.h"
 
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-
 namespace owl {
 
   /*! get next single line of PTX code */
@@ -92,7 +75,7 @@ namespace owl {
   {
     SetActiveGPU forLifeTime(device);
     
-    if (module)
+    if (module && !device->isNull())
       optixModuleDestroy(module);
     module = 0;
   }
@@ -103,7 +86,15 @@ namespace owl {
     assert(module == 0);
     SetActiveGPU forLifeTime(device);
     
-    LOG("building module #" + parent->toString());
+    OWL_LOG_INFO("building module #" + parent->toString());
+
+    if (device->isNull()) {
+      // nothing to compile the PTX for; any non-null handle will do
+      module = (OptixModule)uintptr_t(parent->ID+1);
+      device->nullStats.numModules++;
+      device->nullStats.moduleBytes += parent->ptxCode.size();
+      return;
+    }
     
     char log[2048];
     size_t sizeof_log = sizeof( log );
@@ -132,7 +123,7 @@ namespace owl {
     // just leave them in (and as it's in a module that never gets
     // used by optix, this should actually be OK).
     // ------------------------------------------------------------------
-    LOG("generating second, 'non-optix' version of that module, too");
+    OWL_LOG_INFO("generating second, 'non-optix' version of that module, too");
     CUresult rc = (CUresult)0;
     const std::string fixedPtxCode
       = killAllInternalOptixSymbolsFromPtxString(parent->ptxCode.c_str());
@@ -157,7 +148,7 @@ namespace owl {
                                "for bounds program kernel"
                                +std::string(errName));
     }
-    LOG_OK("created module #" << parent->ID << " (both optix and cuda)");
+    OWL_LOG_OK("created module #" << parent->ID << " (both optix and cuda)");
   }
   
 
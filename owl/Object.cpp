@@ -126,6 +126,51 @@ namespace owl {
     case OWL_FLOAT4:
       return 4*sizeof(float);
 
+    case OWL_HALF:
+      return sizeof(half);
+    case OWL_HALF2:
+      return 2*sizeof(half);
+    case OWL_HALF3:
+      return 3*sizeof(half);
+    case OWL_HALF4:
+      return 4*sizeof(half);
+      
+    case OWL_UNORM8:
+      return sizeof(unorm8);
+    case OWL_UNORM8_2:
+      return 2*sizeof(unorm8);
+    case OWL_UNORM8_3:
+      return 3*sizeof(unorm8);
+    case OWL_UNORM8_4:
+      return 4*sizeof(unorm8);
+      
+    case OWL_SNORM8:
+      return sizeof(snorm8);
+    case OWL_SNORM8_2:
+      return 2*sizeof(snorm8);
+    case OWL_SNORM8_3:
+      return 3*sizeof(snorm8);
+    case OWL_SNORM8_4:
+      return 4*sizeof(snorm8);
+      
+    case OWL_UNORM16:
+      return sizeof(unorm16);
+    case OWL_UNORM16_2:
+      return 2*sizeof(unorm16);
+    case OWL_UNORM16_3:
+      return 3*sizeof(unorm16);
+    case OWL_UNORM16_4:
+      return 4*sizeof(unorm16);
+      
+    case OWL_SNORM16:
+      return sizeof(snorm16);
+    case OWL_SNORM16_2:
+      return 2*sizeof(snorm16);
+    case OWL_SNORM16_3:
+      return 3*sizeof(snorm16);
+    case OWL_SNORM16_4:
+      return 4*sizeof(snorm16);
+      
     case OWL_AFFINE3F:
       return sizeof(affine3f);
 
@@ -261,6 +306,54 @@ namespace owl {
     case OWL_ULONG4:
       return "ulong4";
       
+      // ------------------------------------------------------------------
+      // compact storage types
+      // ------------------------------------------------------------------
+    case OWL_HALF:
+      return "half";
+    case OWL_HALF2:
+      return "half2";
+    case OWL_HALF3:
+      return "half3";
+    case OWL_HALF4:
+      return "half4";
+      
+    case OWL_UNORM8:
+      return "unorm8";
+    case OWL_UNORM8_2:
+      return "unorm8_2";
+    case OWL_UNORM8_3:
+      return "unorm8_3";
+    case OWL_UNORM8_4:
+      return "unorm8_4";
+      
+    case OWL_SNORM8:
+      return "snorm8";
+    case OWL_SNORM8_2:
+      return "snorm8_2";
+    case OWL_SNORM8_3:
+      return "snorm8_3";
+    case OWL_SNORM8_4:
+      return "snorm8_4";
+      
+    case OWL_UNORM16:
+      return "unorm16";
+    case OWL_UNORM16_2:
+      return "unorm16_2";
+    case OWL_UNORM16_3:
+      return "unorm16_3";
+    case OWL_UNORM16_4:
+      return "unorm16_4";
+      
+    case OWL_SNORM16:
+      return "snorm16";
+    case OWL_SNORM16_2:
+      return "snorm16_2";
+    case OWL_SNORM16_3:
+      return "snorm16_3";
+    case OWL_SNORM16_4:
+      return "snorm16_4";
+      
       // ------------------------------------------------------------------
       // other copable
       // ------------------------------------------------------------------
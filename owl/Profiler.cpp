@@ -0,0 +1,239 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+namespace owl {
+  namespace profiler {
+
+    /*! all thread buffers ever created; buffers stay alive after
+        their thread exits, so their events can still be exported */
+    struct Registry {
+      static Registry &get()
+      {
+        static Registry registry;
+        return registry;
+      }
+
+      std::mutex                mutex;
+      std::vector<ThreadBuffer::SP> buffers;
+      /*! events recorded before this time got discarded by reset() */
+      std::atomic<int64_t>      resetTime { 0 };
+    };
+
+    ThreadBuffer &threadBuffer()
+    {
+      static thread_local ThreadBuffer *buffer = nullptr;
+      if (!buffer) {
+        Registry &registry = Registry::get();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.buffers.push_back
+          (std::make_shared<ThreadBuffer>((uint32_t)registry.buffers.size()));
+        buffer = registry.buffers.back().get();
+      }
+      return *buffer;
+    }
+
+    bool enabled()
+    {
+#if OWL_ENABLE_PROFILING
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    /*! snapshot of one thread's (still available) events, in the
+        order they got completed */
+    struct ThreadEvents {
+      uint32_t           threadID;
+      std::vector<Event> events;
+      /*! number of events lost to ring buffer wrap-around */
+      uint64_t           numDropped;
+    };
+
+    static std::vector<ThreadEvents> snapshot()
+    {
+      Registry &registry = Registry::get();
+      const int64_t resetTime = registry.resetTime.load();
+      std::vector<ThreadEvents> result;
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (auto &buffer : registry.buffers) {
+        const uint64_t numWritten
+          = buffer->numWritten.load(std::memory_order_acquire);
+        const uint64_t numAvail
+          = std::min(numWritten,(uint64_t)ThreadBuffer::CAPACITY);
+        ThreadEvents te;
+        te.threadID   = buffer->threadID;
+        te.numDropped = numWritten - numAvail;
+        for (uint64_t i=numWritten-numAvail;i<numWritten;i++) {
+          const Event &e = buffer->events[i % ThreadBuffer::CAPACITY];
+          if (e.begin >= resetTime)
+            te.events.push_back(e);
+        }
+        if (!te.events.empty())
+          result.push_back(te);
+      }
+      return result;
+    }
+
+    static std::string jsonEscape(const char *s)
+    {
+      std::string result;
+      for (;*s;s++) {
+        if (*s == '"' || *s == '\\') result += '\\';
+        if ((unsigned char)*s >= 0x20) result += *s;
+      }
+      return result;
+    }
+
+    void writeChromeTrace(const std::string &fileName)
+    {
+      std::vector<ThreadEvents> threads = snapshot();
+      int64_t t0 = std::numeric_limits<int64_t>::max();
+      for (auto &te : threads)
+        for (auto &e : te.events)
+          t0 = std::min(t0,e.begin);
+
+      std::ofstream out(fileName);
+      if (!out.good())
+        throw std::runtime_error("could not open '"+fileName
+                                 +"' for writing the profiler trace");
+
+      out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+      out << std::fixed << std::setprecision(3);
+      bool first = true;
+      for (auto &te : threads) {
+        out << (first?"":",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\""
+            << ",\"pid\":0,\"tid\":" << te.threadID
+            << ",\"args\":{\"name\":\"owl thread " << te.threadID << "\"}}";
+        first = false;
+        for (auto &e : te.events) {
+          // chrome traces are in (fractional) microseconds
+          out << ",\n{\"ph\":\"X\",\"cat\":\"owl\",\"name\":\""
+              << jsonEscape(e.name) << "\""
+              << ",\"pid\":0,\"tid\":" << te.threadID
+              << ",\"ts\":" << (e.begin-t0)*1e-3
+              << ",\"dur\":" << (e.end-e.begin)*1e-3;
+          if (e.bytes)
+            out << ",\"args\":{\"bytes\":" << e.bytes << "}";
+          out << "}";
+        }
+      }
+      out << "\n]}\n";
+    }
+
+    /*! accumulated stats for one call path */
+    struct PathStats {
+      std::string path;
+      int         depth      { 0 };
+      uint64_t    numCalls   { 0 };
+      int64_t     totalTime  { 0 };
+      int64_t     selfTime   { 0 };
+      int64_t     maxTime    { 0 };
+      uint64_t    bytes      { 0 };
+    };
+
+    void printSummary(std::ostream &out)
+    {
+      std::vector<ThreadEvents> threads = snapshot();
+      std::map<std::string,PathStats> stats;
+      uint64_t numDropped = 0;
+      for (auto &te : threads) {
+        numDropped += te.numDropped;
+        // events got pushed when their scope ended, ie, children
+        // before parents; sort by begin time (parents first for
+        // equal times) to walk the scope tree top-down
+        std::vector<Event> &events = te.events;
+        std::stable_sort(events.begin(),events.end(),
+                         [](const Event &a, const Event &b)
+                         { return a.begin < b.begin
+                             || (a.begin == b.begin && a.depth < b.depth); });
+        std::vector<std::string> pathStack;
+        std::vector<PathStats *> statsStack;
+        for (auto &e : events) {
+          pathStack.resize(std::min(pathStack.size(),(size_t)e.depth));
+          statsStack.resize(pathStack.size());
+          const std::string path
+            = pathStack.empty() ? std::string(e.name) : pathStack.back()+"/"+e.name;
+          PathStats &ps = stats[path];
+          if (ps.numCalls == 0) {
+            ps.path  = path;
+            ps.depth = (int)pathStack.size();
+          }
+          const int64_t duration = e.end - e.begin;
+          ps.numCalls  ++;
+          ps.totalTime += duration;
+          ps.selfTime  += duration;
+          ps.maxTime   = std::max(ps.maxTime,duration);
+          ps.bytes     += e.bytes;
+          if (!statsStack.empty())
+            statsStack.back()->selfTime -= duration;
+          pathStack.push_back(path);
+          statsStack.push_back(&ps);
+        }
+      }
+
+      // print in tree order: children right after their parents
+      // (which plain string order on the paths doesn't guarantee if
+      // names contain characters smaller than '/')
+      std::vector<std::pair<std::string,const PathStats *>> sorted;
+      for (auto &it : stats) {
+        std::string key = it.first;
+        std::replace(key.begin(),key.end(),'/','\x01');
+        sorted.push_back({key,&it.second});
+      }
+      std::sort(sorted.begin(),sorted.end());
+
+      out << OWL_TERMINAL_LIGHT_BLUE
+          << "#owl.profiler: summary (times in ms)" << std::endl
+          << "    calls      total       self        max  phase"
+          << OWL_TERMINAL_DEFAULT << std::endl;
+      const std::ios::fmtflags flags = out.flags();
+      out << std::fixed << std::setprecision(3);
+      for (auto &it : sorted) {
+        const PathStats *ps = it.second;
+        const size_t slash = ps->path.rfind('/');
+        out << std::setw(9)  << ps->numCalls
+            << std::setw(11) << ps->totalTime*1e-6
+            << std::setw(11) << ps->selfTime*1e-6
+            << std::setw(11) << ps->maxTime*1e-6 << "  "
+            << std::string(2*ps->depth,' ')
+            << (slash == std::string::npos ? ps->path : ps->path.substr(slash+1));
+        if (ps->bytes)
+          out << " (" << prettyNumber(ps->bytes) << "B, "
+              << prettyDouble(ps->bytes/std::max(ps->totalTime*1e-9,1e-9)) << "B/s)";
+        out << std::endl;
+      }
+      out.flags(flags);
+      if (numDropped)
+        out << OWL_TERMINAL_RED
+            << "#owl.profiler: " << numDropped
+            << " oldest events got dropped (ring buffer full)"
+            << OWL_TERMINAL_DEFAULT << std::endl;
+    }
+
+    void reset()
+    {
+      Registry::get().resetTime = now();
+    }
+
+  } // ::owl::profiler
+} // ::owl
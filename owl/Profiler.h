@@ -0,0 +1,143 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/Profiler.h Scoped, hierarchical timers for OWL's build
+    phases (modules, programs, pipeline, SBT, accels, uploads).
+
+    Instrumented code uses OWL_PROFILE_SCOPE("name"), which records
+    one event (begin, end, nesting depth) into a per-thread ring
+    buffer when the scope is left; there is no locking or allocation
+    on that path. The recorded events can then be exported as a
+    Chrome trace (chrome://tracing, or ui.perfetto.dev), or printed
+    as a per-phase summary - see owlProfilerWriteTrace() and
+    owlProfilerPrintSummary().
+
+    Profiling only gets compiled in if OWL_ENABLE_PROFILING is
+    defined (cmake option of the same name); otherwise all
+    OWL_PROFILE_XXX macros expand to nothing. */
+
+#pragma once
+
+#include "owl/common.h"
+#include <chrono>
+
+namespace owl {
+  namespace profiler {
+
+    /*! one completed profiling scope */
+    struct Event {
+      /*! name of the scope; has to be a string literal (or otherwise
+          outlive the profiler), we only store the pointer */
+      const char *name;
+      /*! begin and end time, in nanoseconds, on the steady clock */
+      int64_t     begin, end;
+      /*! optional payload (eg, number of bytes uploaded); 0 if none */
+      uint64_t    bytes;
+      /*! nesting depth of this scope within its thread */
+      uint32_t    depth;
+    };
+
+    /*! per-thread ring buffer of completed events. Only the owning
+        thread ever writes into it; once full, the oldest events get
+        overwritten */
+    struct ThreadBuffer {
+      typedef std::shared_ptr<ThreadBuffer> SP;
+      enum { CAPACITY = 16*1024 };
+
+      ThreadBuffer(uint32_t threadID)
+        : events(CAPACITY), threadID(threadID)
+      {}
+
+      inline void push(const Event &event)
+      {
+        const uint64_t n = numWritten.load(std::memory_order_relaxed);
+        events[n % CAPACITY] = event;
+        numWritten.store(n+1,std::memory_order_release);
+      }
+
+      std::vector<Event>    events;
+      /*! total number of events ever pushed (ie, not modulo capacity) */
+      std::atomic<uint64_t> numWritten { 0 };
+      /*! number of currently open scopes on this thread */
+      uint32_t              depth { 0 };
+      const uint32_t        threadID;
+    };
+
+    /*! returns the calling thread's event buffer, creating (and
+        registering) it upon first use */
+    ThreadBuffer &threadBuffer();
+
+    inline int64_t now()
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /*! RAII helper behind OWL_PROFILE_SCOPE */
+    struct Scope {
+      inline Scope(const char *name, uint64_t bytes = 0)
+        : buffer(threadBuffer()),
+          name(name),
+          bytes(bytes),
+          depth(buffer.depth++),
+          begin(now())
+      {}
+      inline ~Scope()
+      {
+        const Event event = { name, begin, now(), bytes, depth };
+        buffer.depth--;
+        buffer.push(event);
+      }
+
+      ThreadBuffer  &buffer;
+      const char    *name;
+      const uint64_t bytes;
+      const uint32_t depth;
+      const int64_t  begin;
+    };
+
+    /*! whether the profiler has been compiled in */
+    bool enabled();
+
+    /*! writes all events recorded so far, on all threads, as a
+        Chrome trace JSON file. Should not be called while other
+        threads are still recording events */
+    void writeChromeTrace(const std::string &fileName);
+
+    /*! prints, for each distinct call path of scopes, the number of
+        calls, total/self/max time, and bytes */
+    void printSummary(std::ostream &out);
+
+    /*! discards all events recorded so far */
+    void reset();
+
+  } // ::owl::profiler
+} // ::owl
+
+#if OWL_ENABLE_PROFILING
+# define OWL_PROFILE_CONCAT_(a,b) a##b
+# define OWL_PROFILE_CONCAT(a,b) OWL_PROFILE_CONCAT_(a,b)
+/*! times the remainder of the enclosing scope under the given name */
+# define OWL_PROFILE_SCOPE(name)                                        \
+  owl::profiler::Scope OWL_PROFILE_CONCAT(owlProfileScope_,__LINE__)(name)
+/*! same as OWL_PROFILE_SCOPE, but also records a byte count (eg, for
+    uploads), which the summary turns into a bandwidth */
+# define OWL_PROFILE_SCOPE_BYTES(name,numBytes)                         \
+  owl::profiler::Scope OWL_PROFILE_CONCAT(owlProfileScope_,__LINE__)(name,numBytes)
+#else
+# define OWL_PROFILE_SCOPE(name)                 /* profiling disabled */
+# define OWL_PROFILE_SCOPE_BYTES(name,numBytes)  /* profiling disabled */
+#endif
@@ -0,0 +1,566 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "RayBatch.h"
+#include "RayBatchPrograms.h"
+#include "Triangles.h"
+#include "TrianglesGeomGroup.h"
+#include "UserGeomGroup.h"
+#include "InstanceGroup.h"
+#include "Context.h"
+#include "owl/common/math/rayReorder.h"
+#include "owl/common/parallel/parallel_for.h"
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+/*! the PTX of RayBatchPrograms.cu */
+extern "C" char rayBatchPTX[];
+
+namespace owl {
+
+  using owl::common::HostHit;
+  using owl::common::BVH;
+  using owl::common::RayReorder;
+
+  /*! number of rays each parallel task traces */
+  enum { RAYS_PER_TASK = 1024 };
+
+  /*! most rays a single (1D) optixLaunch can take */
+  enum : size_t { MAX_RAYS_PER_LAUNCH = size_t(1)<<30 };
+
+  /*! returns a host-readable pointer to the buffer's contents on the
+      given device; that's the buffer's own memory for anything that
+      lives in host-visible memory, else a copy in 'copy' */
+  static const uint8_t *readableOnHost(const Buffer::SP &buffer,
+                                       const DeviceContext::SP &device,
+                                       std::vector<uint8_t> &copy)
+  {
+    const void *pointer = buffer->getPointer(device);
+    if (device->isNull()
+        || std::dynamic_pointer_cast<HostPinnedBuffer>(buffer)
+        || std::dynamic_pointer_cast<ManagedMemoryBuffer>(buffer))
+      return (const uint8_t *)pointer;
+
+    copy.resize(buffer->sizeInBytes());
+    SetActiveGPU forLifeTime(device);
+    CUDA_CHECK(cudaMemcpy(copy.data(),pointer,copy.size(),cudaMemcpyDefault));
+    return copy.data();
+  }
+
+  // ------------------------------------------------------------------
+  // triangle geom groups
+  // ------------------------------------------------------------------
+
+  /*! BVH over all triangles of all geoms of a TrianglesGeomGroup */
+  struct TrianglesHostAccel : public HostAccel {
+    TrianglesHostAccel(const TrianglesGeomGroup &group);
+
+    bool closestHit(HostRay &ray, uint32_t mask, OWLBatchHit &hit) const override;
+    bool anyHit(const HostRay &ray, uint32_t mask, OWLBatchHit &hit) const override;
+
+    inline bool intersect(int primID, HostRay &ray, HostHit &hit) const
+    {
+      const Triangle &tri = triangles[primID];
+      return intersectTriangle(ray,hit,tri.v0,tri.v1,tri.v2,primID);
+    }
+    inline void writeHit(OWLBatchHit &hit, float t, const HostHit &hostHit) const
+    {
+      hit.t      = t;
+      hit.primID = primRefs[hostHit.primID].primID;
+      hit.geomID = primRefs[hostHit.primID].geomID;
+      hit.instID = -1;
+      hit.u      = hostHit.u;
+      hit.v      = hostHit.v;
+    }
+
+    struct Triangle {
+      vec3f v0, v1, v2;
+    };
+    struct PrimRef {
+      int geomID, primID;
+    };
+    std::vector<Triangle> triangles;
+    /*! for each triangle, which geom (and which of its prims) it is */
+    std::vector<PrimRef>  primRefs;
+    BVH                   bvh;
+  };
+
+  TrianglesHostAccel::TrianglesHostAccel(const TrianglesGeomGroup &group)
+  {
+    DeviceContext::SP device = group.context->getDevice(0);
+    for (size_t geomID=0;geomID<group.geometries.size();geomID++) {
+      TrianglesGeom::SP mesh = std::dynamic_pointer_cast<TrianglesGeom>
+        (group.geometries[geomID]);
+      if (!mesh) continue;
+      if (mesh->vertex.buffers.empty() || !mesh->index.buffer)
+        throw std::runtime_error("#owl: triangles geom without vertices or"
+                                 " indices in owlGroupTraceRaysOnHost()");
+      std::vector<uint8_t> vertexCopy, indexCopy;
+      const uint8_t *vertices
+        = readableOnHost(mesh->vertex.buffers[0],device,vertexCopy) + mesh->vertex.offset;
+      const uint8_t *indices
+        = readableOnHost(mesh->index.buffer,device,indexCopy) + mesh->index.offset;
+      for (size_t primID=0;primID<mesh->index.count;primID++) {
+        const vec3i index = *(const vec3i *)(indices+primID*mesh->index.stride);
+        if (index.x < 0 || size_t(index.x) >= mesh->vertex.count ||
+            index.y < 0 || size_t(index.y) >= mesh->vertex.count ||
+            index.z < 0 || size_t(index.z) >= mesh->vertex.count)
+          throw std::runtime_error("#owl: triangle index out of range in"
+                                   " owlGroupTraceRaysOnHost()");
+        Triangle tri;
+        tri.v0 = *(const vec3f *)(vertices+index.x*mesh->vertex.stride);
+        tri.v1 = *(const vec3f *)(vertices+index.y*mesh->vertex.stride);
+        tri.v2 = *(const vec3f *)(vertices+index.z*mesh->vertex.stride);
+        triangles.push_back(tri);
+        primRefs.push_back({int(geomID),int(primID)});
+      }
+    }
+
+    std::vector<box3f> primBounds(triangles.size());
+    for (size_t i=0;i<triangles.size();i++) {
+      primBounds[i] = box3f()
+        .including(triangles[i].v0)
+        .including(triangles[i].v1)
+        .including(triangles[i].v2);
+      bounds.extend(primBounds[i]);
+    }
+    if (!triangles.empty())
+      bvh.build(primBounds.data(),primBounds.size());
+  }
+
+  bool TrianglesHostAccel::closestHit(HostRay &ray, uint32_t mask, OWLBatchHit &hit) const
+  {
+    HostHit hostHit;
+    if (!traceClosest(bvh,ray,hostHit,[this](int primID, HostRay &ray, HostHit &hit){
+          return intersect(primID,ray,hit);
+        }))
+      return false;
+    writeHit(hit,ray.tmax,hostHit);
+    return true;
+  }
+
+  bool TrianglesHostAccel::anyHit(const HostRay &ray, uint32_t mask, OWLBatchHit &hit) const
+  {
+    return traceAny(bvh,ray,[this,&hit](int primID, HostRay &ray, HostHit &hostHit){
+        if (!intersect(primID,ray,hostHit)) return false;
+        writeHit(hit,ray.tmax,hostHit);
+        return true;
+      });
+  }
+
+  // ------------------------------------------------------------------
+  // instance groups
+  // ------------------------------------------------------------------
+
+  /*! BVH over the (world-space bounds of the) instances of an
+      InstanceGroup */
+  struct InstancesHostAccel : public HostAccel {
+    InstancesHostAccel(const InstanceGroup &group);
+
+    bool closestHit(HostRay &ray, uint32_t mask, OWLBatchHit &hit) const override;
+    bool anyHit(const HostRay &ray, uint32_t mask, OWLBatchHit &hit) const override;
+
+    struct Instance {
+      affine3f      worldToObject;
+      HostAccel::SP child;
+      int32_t       instID;
+      uint32_t      visibilityMask;
+    };
+
+    inline HostRay toObjectSpace(const Instance &instance, const HostRay &ray) const
+    {
+      return HostRay(xfmPoint(instance.worldToObject,ray.origin),
+                     xfmVector(instance.worldToObject,ray.direction),
+                     ray.tmin,ray.tmax);
+    }
+
+    /*! only instances with non-empty bounds */
+    std::vector<Instance> instances;
+    BVH                   bvh;
+  };
+
+  InstancesHostAccel::InstancesHostAccel(const InstanceGroup &group)
+  {
+    std::vector<box3f> instanceBounds;
+    for (size_t childID=0;childID<group.children.size();childID++) {
+      const Group::SP &child = group.children[childID];
+      if (!child) continue;
+
+      Instance instance;
+      instance.child = getHostAccel(child);
+      if (instance.child->bounds.empty()) continue;
+
+      const affine3f objectToWorld
+        = childID < group.transforms[0].size()
+        ? group.transforms[0][childID]
+        : affine3f(owl::common::one);
+      instance.worldToObject = rcp(objectToWorld);
+      instance.instID
+        = group.instanceIDs.empty()
+        ? int32_t(childID)
+        : int32_t(group.instanceIDs[childID]);
+      instance.visibilityMask
+        = group.visibilityMasks.empty()
+        ? 0xffu
+        : group.visibilityMasks[childID];
+      instances.push_back(instance);
+      instanceBounds.push_back(xfmBounds(objectToWorld,instance.child->bounds));
+      bounds.extend(instanceBounds.back());
+    }
+    if (!instances.empty())
+      bvh.build(instanceBounds.data(),instanceBounds.size());
+  }
+
+  bool InstancesHostAccel::closestHit(HostRay &ray, uint32_t mask, OWLBatchHit &hit) const
+  {
+    HostHit unused;
+    return traceClosest(bvh,ray,unused,[&](int instanceID, HostRay &ray, HostHit &){
+        const Instance &instance = instances[instanceID];
+        if (!(instance.visibilityMask & mask)) return false;
+        HostRay objectRay = toObjectSpace(instance,ray);
+        if (!instance.child->closestHit(objectRay,mask,hit)) return false;
+        // t's are the same in object and world space, since we don't
+        // normalize the transformed direction
+        ray.tmax = objectRay.tmax;
+        if (hit.instID < 0) hit.instID = instance.instID;
+        return true;
+      });
+  }
+
+  bool InstancesHostAccel::anyHit(const HostRay &ray, uint32_t mask, OWLBatchHit &hit) const
+  {
+    return traceAny(bvh,ray,[&](int instanceID, HostRay &ray, HostHit &){
+        const Instance &instance = instances[instanceID];
+        if (!(instance.visibilityMask & mask)) return false;
+        if (!instance.child->anyHit(toObjectSpace(instance,ray),mask,hit)) return false;
+        if (hit.instID < 0) hit.instID = instance.instID;
+        return true;
+      });
+  }
+
+  // ------------------------------------------------------------------
+  // tracing
+  // ------------------------------------------------------------------
+
+  HostAccel::SP getHostAccel(const Group::SP &group)
+  {
+    if (group->hostAccel)
+      return group->hostAccel;
+
+    if (std::shared_ptr<TrianglesGeomGroup> triangles
+        = std::dynamic_pointer_cast<TrianglesGeomGroup>(group))
+      group->hostAccel = std::make_shared<TrianglesHostAccel>(*triangles);
+    else if (InstanceGroup::SP instances
+             = std::dynamic_pointer_cast<InstanceGroup>(group))
+      group->hostAccel = std::make_shared<InstancesHostAccel>(*instances);
+    else if (std::dynamic_pointer_cast<UserGeomGroup>(group))
+      throw std::runtime_error("#owl: owlGroupTraceRaysOnHost() can't trace user geometry"
+                               " (its intersection programs only run on the device)");
+    else
+      throw std::runtime_error("#owl: owlGroupTraceRaysOnHost() on unsupported group type "
+                               +group->toString());
+    return group->hostAccel;
+  }
+
+  static inline HostRay toHostRay(const OWLBatchRay &ray)
+  {
+    return HostRay(vec3f(ray.origin[0],ray.origin[1],ray.origin[2]),
+                   vec3f(ray.direction[0],ray.direction[1],ray.direction[2]),
+                   ray.tmin,ray.tmax);
+  }
+
+  void traceRayBatchOnHost(const Group::SP &group,
+                           const OWLBatchRay *rays,
+                           OWLBatchHit *hits,
+                           size_t numRays,
+                           uint32_t flags)
+  {
+    HostAccel::SP accel = getHostAccel(group);
+
+    // hits get written straight to where they belong, so all we
+    // need of the reordering is its permutation
+    std::vector<uint32_t> order;
+    if (flags & OWL_RAY_BATCH_SORT_RAYS) {
+      RayReorder reorder;
+      reorder.compute(numRays,accel->bounds,[rays](size_t rayID){
+          return toHostRay(rays[rayID]);
+        });
+      order.swap(reorder.permutation);
+    }
+
+    const bool anyHit = (flags & OWL_RAY_BATCH_ANY_HIT);
+    parallel_for_blocked(0,numRays,RAYS_PER_TASK,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          const size_t rayID = order.empty() ? i : order[i];
+          const OWLBatchRay &in = rays[rayID];
+          HostRay ray = toHostRay(in);
+          OWLBatchHit &hit = hits[rayID];
+          hit.t      = std::numeric_limits<float>::infinity();
+          hit.primID = hit.instID = hit.geomID = -1;
+          hit.u      = hit.v = 0.f;
+          if (anyHit)
+            accel->anyHit(ray,in.mask,hit);
+          else
+            accel->closestHit(ray,in.mask,hit);
+        }
+      });
+  }
+
+  // ------------------------------------------------------------------
+  // on the device
+  // ------------------------------------------------------------------
+
+  RayBatchPipeline::RayBatchPipeline(DeviceContext *device)
+    : device(device)
+  {
+    assert(!device->isNull());
+  }
+
+  RayBatchPipeline::~RayBatchPipeline()
+  {
+    SetActiveGPU forLifeTime(device);
+    destroy();
+    rayGenRecord.free();
+    missRecord.free();
+    hitGroupRecords.free();
+    launchParams.free();
+  }
+
+  void RayBatchPipeline::destroy()
+  {
+    if (pipeline)   OPTIX_CHECK(optixPipelineDestroy(pipeline));
+    if (hitGroupPG) OPTIX_CHECK(optixProgramGroupDestroy(hitGroupPG));
+    if (missPG)     OPTIX_CHECK(optixProgramGroupDestroy(missPG));
+    if (rayGenPG)   OPTIX_CHECK(optixProgramGroupDestroy(rayGenPG));
+    if (module)     OPTIX_CHECK(optixModuleDestroy(module));
+    pipeline   = nullptr;
+    hitGroupPG = nullptr;
+    missPG     = nullptr;
+    rayGenPG   = nullptr;
+    module     = nullptr;
+    builtWithMaxDepth  = -1;
+    numHitGroupRecords = 0;
+  }
+
+  void RayBatchPipeline::update()
+  {
+    const OptixPipelineCompileOptions &options = device->pipelineCompileOptions;
+    const int maxDepth = device->parent->maxInstancingDepth;
+    uint8_t header[OPTIX_SBT_RECORD_HEADER_SIZE];
+
+    if (options.usesMotionBlur        != builtWithMotionBlur ||
+        options.traversableGraphFlags != builtWithGraphFlags ||
+        maxDepth                      != builtWithMaxDepth) {
+      destroy();
+
+      // the context's bound launch param values are for its own
+      // launch params, not for ours
+      OptixModuleCompileOptions moduleOptions = device->moduleCompileOptions;
+#if OPTIX_VERSION >= 70200
+      moduleOptions.boundValues    = nullptr;
+      moduleOptions.numBoundValues = 0;
+#endif
+      char log[2048];
+      size_t sizeof_log = sizeof( log );
+      OPTIX_CHECK_LOG(optixModuleCreateFromPTX(device->optixContext,
+                                               &moduleOptions,
+                                               &options,
+                                               rayBatchPTX,
+                                               strlen(rayBatchPTX),
+                                               log,&sizeof_log,
+                                               &module
+                                               ));
+
+      OptixProgramGroupDesc pgDescs[3] = {};
+      pgDescs[0].kind                         = OPTIX_PROGRAM_GROUP_KIND_RAYGEN;
+      pgDescs[0].raygen.module                = module;
+      pgDescs[0].raygen.entryFunctionName     = "__raygen__owlRayBatch";
+      pgDescs[1].kind                         = OPTIX_PROGRAM_GROUP_KIND_MISS;
+      pgDescs[1].miss.module                  = module;
+      pgDescs[1].miss.entryFunctionName       = "__miss__owlRayBatch";
+      pgDescs[2].kind                         = OPTIX_PROGRAM_GROUP_KIND_HITGROUP;
+      pgDescs[2].hitgroup.moduleCH            = module;
+      pgDescs[2].hitgroup.entryFunctionNameCH = "__closesthit__owlRayBatch";
+      pgDescs[2].hitgroup.moduleAH            = module;
+      pgDescs[2].hitgroup.entryFunctionNameAH = "__anyhit__owlRayBatch";
+      OptixProgramGroupOptions pgOptions = {};
+      OptixProgramGroup pgs[3];
+      sizeof_log = sizeof( log );
+      OPTIX_CHECK(optixProgramGroupCreate(device->optixContext,
+                                          pgDescs,3,
+                                          &pgOptions,
+                                          log,&sizeof_log,
+                                          pgs
+                                          ));
+      rayGenPG   = pgs[0];
+      missPG     = pgs[1];
+      hitGroupPG = pgs[2];
+
+      sizeof_log = sizeof( log );
+      OPTIX_CHECK(optixPipelineCreate(device->optixContext,
+                                      &options,
+                                      &device->pipelineLinkOptions,
+                                      pgs,3,
+                                      log,&sizeof_log,
+                                      &pipeline
+                                      ));
+      // same stack sizes as the context's own pipeline
+      OPTIX_CHECK(optixPipelineSetStackSize(pipeline,
+                                            2*1024,2*1024,2*1024,
+                                            maxDepth+1));
+
+      device->sbtRecordPackHeader(rayGenPG,header);
+      if (!rayGenRecord.alloced())
+        rayGenRecord.alloc(sizeof(header),OWL_MEMORY_SBT);
+      rayGenRecord.upload(header,"ray batch raygen record");
+      device->sbtRecordPackHeader(missPG,header);
+      if (!missRecord.alloced())
+        missRecord.alloc(sizeof(header),OWL_MEMORY_SBT);
+      missRecord.upload(header,"ray batch miss record");
+
+      builtWithMotionBlur = options.usesMotionBlur;
+      builtWithGraphFlags = options.traversableGraphFlags;
+      builtWithMaxDepth   = maxDepth;
+    }
+
+    // every SBT offset an instance can have (see the context's own
+    // SBT in Context::buildHitGroupRecordsOn()) needs a record, even
+    // though they're all the same
+    Context *context = device->parent;
+    const size_t numNeeded
+      = context->sbtRangeAllocator.maxAllocedID*context->numRayTypes + 1;
+    if (numNeeded > numHitGroupRecords) {
+      device->sbtRecordPackHeader(hitGroupPG,header);
+      std::vector<uint8_t> records(numNeeded*sizeof(header));
+      for (size_t i=0;i<numNeeded;i++)
+        memcpy(records.data()+i*sizeof(header),header,sizeof(header));
+      hitGroupRecords.free();
+      hitGroupRecords.alloc(records.size(),OWL_MEMORY_SBT);
+      hitGroupRecords.upload(records.data(),"ray batch hit group records");
+      numHitGroupRecords = numNeeded;
+    }
+  }
+
+  void RayBatchPipeline::trace(OptixTraversableHandle world,
+                               bool ignoreMasks,
+                               const OWLBatchRay *d_rays,
+                               OWLBatchHit *d_hits,
+                               size_t numRays,
+                               uint32_t flags)
+  {
+    SetActiveGPU forLifeTime(device);
+    update();
+
+    OptixShaderBindingTable sbt = {};
+    sbt.raygenRecord                = rayGenRecord.d_pointer;
+    sbt.missRecordBase              = missRecord.d_pointer;
+    sbt.missRecordStrideInBytes     = OPTIX_SBT_RECORD_HEADER_SIZE;
+    sbt.missRecordCount             = 1;
+    sbt.hitgroupRecordBase          = hitGroupRecords.d_pointer;
+    sbt.hitgroupRecordStrideInBytes = OPTIX_SBT_RECORD_HEADER_SIZE;
+    sbt.hitgroupRecordCount         = (unsigned)numHitGroupRecords;
+
+    RayBatchLaunchParams lp = {};
+    lp.world       = world;
+    lp.flags       = flags;
+    lp.ignoreMasks = ignoreMasks;
+    if (!launchParams.alloced())
+      launchParams.alloc(sizeof(lp),OWL_MEMORY_LAUNCH_PARAMS);
+
+    for (size_t begin=0;begin<numRays;begin+=MAX_RAYS_PER_LAUNCH) {
+      const size_t count = std::min(numRays-begin,size_t(MAX_RAYS_PER_LAUNCH));
+      lp.rays    = d_rays+begin;
+      lp.hits    = d_hits+begin;
+      lp.numRays = uint32_t(count);
+      // a synchronous copy, so this also waits for the previous
+      // chunk's launch to be done with the launch params
+      launchParams.upload(&lp,"ray batch launch params");
+      OPTIX_CHECK(optixLaunch(pipeline,
+                              device->stream,
+                              launchParams.d_pointer,
+                              launchParams.sizeInBytes,
+                              &sbt,
+                              unsigned(count),1,1));
+    }
+  }
+
+  /*! throws unless all geometry in the group (and everything it
+      instantiates) is triangles, the only kind the built-in programs
+      can intersect */
+  static void checkTraceableOnDevice(const Group::SP &group)
+  {
+    if (std::dynamic_pointer_cast<TrianglesGeomGroup>(group))
+      return;
+    if (InstanceGroup::SP instances
+        = std::dynamic_pointer_cast<InstanceGroup>(group)) {
+      for (auto &child : instances->children)
+        if (child) checkTraceableOnDevice(child);
+      return;
+    }
+    if (std::dynamic_pointer_cast<UserGeomGroup>(group))
+      throw std::runtime_error("#owl: owlGroupTraceRays() can't trace user geometry"
+                               " (the built-in ray batch programs have no"
+                               " intersection programs)");
+    throw std::runtime_error("#owl: owlGroupTraceRays() on unsupported group type "
+                             +group->toString());
+  }
+
+  void traceRayBatch(const Group::SP &group,
+                     const Buffer::SP &rays,
+                     const Buffer::SP &hits,
+                     size_t numRays,
+                     uint32_t flags)
+  {
+    if (rays->sizeInBytes() < numRays*sizeof(OWLBatchRay))
+      throw std::runtime_error("#owl: owlGroupTraceRays(): ray buffer is too small"
+                               " for the given number of rays");
+    if (hits->sizeInBytes() < numRays*sizeof(OWLBatchHit))
+      throw std::runtime_error("#owl: owlGroupTraceRays(): hit buffer is too small"
+                               " for the given number of rays");
+
+    const bool ignoreMasks = !std::dynamic_pointer_cast<InstanceGroup>(group);
+    const std::vector<DeviceContext::SP> &devices = group->context->getDevices();
+    for (auto device : devices) {
+      const OWLBatchRay *d_rays = (const OWLBatchRay *)rays->getPointer(device);
+      OWLBatchHit *d_hits = (OWLBatchHit *)hits->getPointer(device);
+      if (!d_rays || !d_hits)
+        throw std::runtime_error("#owl: owlGroupTraceRays() on a buffer that"
+                                 " has no device memory");
+      if (device->isNull()) {
+        // a null device's "device" memory is host memory
+        traceRayBatchOnHost(group,d_rays,d_hits,numRays,flags);
+        continue;
+      }
+      checkTraceableOnDevice(group);
+      const OptixTraversableHandle world = group->getTraversable(device);
+      if (!world)
+        throw std::runtime_error("#owl: owlGroupTraceRays() on a group whose"
+                                 " accel hasn't been built");
+      if (!device->rayBatchPipeline)
+        device->rayBatchPipeline = std::make_shared<RayBatchPipeline>(device.get());
+      device->rayBatchPipeline->trace(world,ignoreMasks,d_rays,d_hits,numRays,flags);
+    }
+
+    // like owlLaunch2D(), this returns once all devices are done
+    for (auto device : devices) {
+      if (device->isNull()) continue;
+      SetActiveGPU forLifeTime(device);
+      CUDA_CHECK(cudaStreamSynchronize(device->stream));
+    }
+  }
+
+} // ::owl
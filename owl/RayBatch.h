@@ -0,0 +1,139 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/RayBatch.h owlGroupTraceRays(), which traces ray
+    batches in device buffers on the GPU, and owlGroupTraceRaysOnHost(),
+    which traces ray batches in host memory on the CPU.
+
+    On the device, each DeviceContext gets a RayBatchPipeline: the
+    built-in programs of RayBatchPrograms.cu, compiled with the
+    device's own pipeline options, plus an SBT that covers every SBT
+    offset an instance can have. It traces the group's optix accel,
+    one raygen thread per ray, independently of the context's own
+    programs, pipeline, and SBT.
+
+    On the host, every group traced against gets a HostAccel: for
+    triangle geom groups that's a BVH (owl/common/bvh/BVH.h) over all
+    triangles of all its geoms, for instance groups a BVH over the
+    world-space bounds of its instances, which forward rays -
+    transformed into object space - to their child group's
+    HostAccel. These get built on first use from the same buffers,
+    transforms, instance IDs and visibility masks that go into the
+    optix accels (read back from the first device if needed), and are
+    cached in the Group until its accel gets rebuilt or refit.
+
+    Rays of a host batch get traced in parallel, in blocks; optionally
+    in an order that puts rays with similar origins and directions
+    next to each other (see owl/common/math/rayReorder.h). */
+
+#pragma once
+
+#include "Group.h"
+#include "owl/common/bvh/BVHTraversal.h"
+
+namespace owl {
+
+  using owl::common::HostRay;
+
+  /*! host-side acceleration structure for one group */
+  struct HostAccel {
+    typedef std::shared_ptr<HostAccel> SP;
+
+    virtual ~HostAccel() {}
+
+    /*! finds the closest hit in [ray.tmin,ray.tmax); if there is
+        one, shrinks ray.tmax to it, overwrites all of 'hit' (instID
+        is -1 unless the hit is inside an instance), and returns
+        true. 'mask' is the ray's visibility mask */
+    virtual bool closestHit(HostRay &ray, uint32_t mask, OWLBatchHit &hit) const = 0;
+
+    /*! like closestHit(), but returns the first hit found */
+    virtual bool anyHit(const HostRay &ray, uint32_t mask, OWLBatchHit &hit) const = 0;
+
+    /*! world-space (or, for instantiated groups, object-space)
+        bounds of everything in this accel */
+    box3f bounds;
+  };
+
+  /*! returns the given group's HostAccel, building it - and those of
+      the groups it instantiates - if it doesn't exist yet */
+  HostAccel::SP getHostAccel(const Group::SP &group);
+
+  /*! the built-in ray batch programs (RayBatchPrograms.cu), and the
+      pipeline and SBT to launch them with, on one (non-null) device;
+      created on first use, and owned by the DeviceContext */
+  struct RayBatchPipeline {
+    typedef std::shared_ptr<RayBatchPipeline> SP;
+
+    RayBatchPipeline(DeviceContext *device);
+    ~RayBatchPipeline();
+
+    /*! enqueues tracing 'numRays' rays from device memory against
+        'world' into 'hits' (also device memory) on the device's
+        stream; 'ignoreMasks' is for worlds that aren't instance
+        groups */
+    void trace(OptixTraversableHandle world,
+               bool ignoreMasks,
+               const OWLBatchRay *d_rays,
+               OWLBatchHit *d_hits,
+               size_t numRays,
+               uint32_t flags);
+
+  private:
+    /*! (re-)builds module, programs, and pipeline if the device's
+        pipeline options changed since they were last built (or if
+        they never were), and grows the hit group records to cover all
+        SBT offsets currently in use */
+    void update();
+    void destroy();
+
+    DeviceContext *const device;
+
+    /*! the device's pipeline options that module and pipeline got
+        built with */
+    bool              builtWithMotionBlur = false;
+    unsigned int      builtWithGraphFlags = 0;
+    int               builtWithMaxDepth   = -1;
+
+    OptixModule       module     = nullptr;
+    OptixProgramGroup rayGenPG   = nullptr;
+    OptixProgramGroup missPG     = nullptr;
+    OptixProgramGroup hitGroupPG = nullptr;
+    OptixPipeline     pipeline   = nullptr;
+
+    /*! all records are header-only (see RayBatchPrograms.cu) */
+    DeviceMemory      rayGenRecord;
+    DeviceMemory      missRecord;
+    DeviceMemory      hitGroupRecords;
+    size_t            numHitGroupRecords = 0;
+    DeviceMemory      launchParams;
+  };
+
+  /*! the implementation of owlGroupTraceRays() */
+  void traceRayBatch(const Group::SP &group,
+                     const Buffer::SP &rays,
+                     const Buffer::SP &hits,
+                     size_t numRays,
+                     uint32_t flags);
+
+  /*! the implementation of owlGroupTraceRaysOnHost() */
+  void traceRayBatchOnHost(const Group::SP &group,
+                           const OWLBatchRay *rays,
+                           OWLBatchHit *hits,
+                           size_t numRays,
+                           uint32_t flags);
+
+} // ::owl
@@ -0,0 +1,91 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/RayBatchPrograms.cu The built-in device programs that
+    owlGroupTraceRays() and owlGroupTraceRayBuffers() trace ray
+    batches with; these get compiled to PTX and embedded in the owl
+    library (as 'rayBatchPTX'), and get their own pipeline and SBT
+    (see RayBatch.cpp).
+
+    One raygen thread per ray; every hit group record is the same one
+    closest-hit/any-hit pair, which reads everything it reports from
+    optix - not from the SBT - so the records can be all header, and
+    the SBT stride can be 0. Any-hit queries terminate on the first
+    hit the any-hit program sees. */
+
+#include "owl/owl.h"
+#include "RayBatchPrograms.h"
+#include <optix_device.h>
+
+using namespace owl;
+
+extern "C" __constant__ RayBatchLaunchParams optixLaunchParams;
+
+OPTIX_RAYGEN_PROGRAM(owlRayBatch)()
+{
+  const RayBatchLaunchParams &lp = optixLaunchParams;
+  const uint32_t rayID = optixGetLaunchIndex().x;
+  if (rayID >= lp.numRays) return;
+
+  const OWLBatchRay ray = lp.rays[rayID];
+  OWLBatchHit hit;
+  hit.t      = __int_as_float(0x7f800000);
+  hit.primID = hit.instID = hit.geomID = -1;
+  hit.u      = hit.v = 0.f;
+
+  const bool anyHit = (lp.flags & OWL_RAY_BATCH_ANY_HIT);
+  uint32_t p0, p1;
+  packPointer(&hit,p0,p1);
+  optixTrace(lp.world,
+             make_float3(ray.origin[0],ray.origin[1],ray.origin[2]),
+             make_float3(ray.direction[0],ray.direction[1],ray.direction[2]),
+             ray.tmin,
+             ray.tmax,
+             /* time: motion blur gets traced at t=0, as on the host */0.f,
+             lp.ignoreMasks ? 0xffu : (ray.mask & 0xffu),
+             anyHit ? OPTIX_RAY_FLAG_ENFORCE_ANYHIT : OPTIX_RAY_FLAG_DISABLE_ANYHIT,
+             /*SBToffset   */0,
+             /*SBTstride   */0,
+             /*missSBTIndex*/0,
+             p0,
+             p1);
+  lp.hits[rayID] = hit;
+}
+
+OPTIX_CLOSEST_HIT_PROGRAM(owlRayBatch)()
+{
+  OWLBatchHit &hit = getPRD<OWLBatchHit>();
+  const float2 uv = optixGetTriangleBarycentrics();
+  hit.t      = optixGetRayTmax();
+  hit.primID = optixGetPrimitiveIndex();
+  hit.geomID = optixGetSbtGASIndex();
+  // the instance closest to the geometry, as on the host
+  hit.instID = optixGetTransformListSize() ? int32_t(optixGetInstanceId()) : -1;
+  hit.u      = uv.x;
+  hit.v      = uv.y;
+}
+
+OPTIX_ANY_HIT_PROGRAM(owlRayBatch)()
+{
+  // only runs for any-hit queries (closest-hit ones disable it); the
+  // hit gets accepted, and then reported by the closest-hit program
+  optixTerminateRay();
+}
+
+OPTIX_MISS_PROGRAM(owlRayBatch)()
+{
+  // the raygen program already initialized the hit to "no hit"
+}
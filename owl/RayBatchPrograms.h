@@ -0,0 +1,40 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/RayBatchPrograms.h What the host side of
+    owlGroupTraceRays() (RayBatch.cpp) and the built-in device
+    programs that trace the rays (RayBatchPrograms.cu) share */
+
+#pragma once
+
+#include "owl/owl_host.h"
+
+namespace owl {
+
+  /*! the launch params of the built-in ray batch pipeline */
+  struct RayBatchLaunchParams {
+    OptixTraversableHandle world;
+    const OWLBatchRay     *rays;
+    OWLBatchHit           *hits;
+    uint32_t               numRays;
+    /*! OWLRayBatchFlags */
+    uint32_t               flags;
+    /*! whether 'world' is a geom group, which has no instances for
+        the rays' visibility masks to apply to */
+    int32_t                ignoreMasks;
+  };
+
+} // ::owl
@@ -68,7 +68,7 @@ namespace owl {
   {
     SetActiveGPU forLifeTime(device);
     
-    sbtRecordBuffer.alloc(rayGenRecordSize);
+    sbtRecordBuffer.alloc(rayGenRecordSize,OWL_MEMORY_SBT);
   }
 
   // ------------------------------------------------------------------
@@ -121,7 +121,7 @@ namespace owl {
     // ------------------------------------------------------------------
     // pack record header with the corresponding hit group:
     // ------------------------------------------------------------------
-    OPTIX_CALL(SbtRecordPackHeader(dd.pg,sbtRecordHeader));
+    device->sbtRecordPackHeader(dd.pg,sbtRecordHeader);
     
     // ------------------------------------------------------------------
     // then, write the data for that record
@@ -194,13 +194,7 @@ namespace owl {
     sbt.hitgroupRecordCount
       = (uint32_t)device->sbt.hitGroupRecordCount;
     
-    OPTIX_CALL(Launch(device->pipeline,
-                      lpDD.stream,
-                      (CUdeviceptr)lpDD.deviceMemory.get(),
-                      lpDD.deviceMemory.sizeInBytes,
-                      &lpDD.sbt,
-                      dims.x,dims.y,1
-                      ));
+    device->launch(lpDD.stream,lpDD.deviceMemory,lpDD.sbt,dims);
 
     /* note we do NOT sync here ! */
   }
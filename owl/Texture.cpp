@@ -16,21 +16,101 @@
 
 #include "Texture.h"
 #include "Context.h"
+#include "MipMap.h"
+#include "BlockCompression.h"
 
 namespace owl {
 
-  size_t bytesPerTexel(OWLTexelFormat       texelFormat)
+  static cudaChannelFormatDesc channelDescFor(OWLTexelFormat       texelFormat,
+                                              OWLTextureColorSpace colorSpace)
   {
-    switch(texelFormat){
-    case OWL_TEXEL_FORMAT_RGBA8:
-      return sizeof(vec4uc);
-    case OWL_TEXEL_FORMAT_RGBA32F:
-      return sizeof(vec4f);
-    case OWL_TEXEL_FORMAT_R32F:
-      return sizeof(float);
+    const bool srgb = (colorSpace == OWL_COLOR_SPACE_SRGB);
+    switch(texelFormat) {
+    case OWL_TEXEL_FORMAT_RGBA8:   return cudaCreateChannelDesc<uchar4>();
+    case OWL_TEXEL_FORMAT_RGBA32F: return cudaCreateChannelDesc<float4>();
+    case OWL_TEXEL_FORMAT_R8:      return cudaCreateChannelDesc<uint8_t>();
+    case OWL_TEXEL_FORMAT_R32F:    return cudaCreateChannelDesc<float>();
+#if CUDART_VERSION >= 11050
+    case OWL_TEXEL_FORMAT_BC1:
+      return cudaCreateChannelDesc(8,8,8,8,
+                                   srgb
+                                   ? cudaChannelFormatKindUnsignedBlockCompressed1SRGB
+                                   : cudaChannelFormatKindUnsignedBlockCompressed1);
+    case OWL_TEXEL_FORMAT_BC4:
+      if (srgb) throw std::runtime_error("BC4 textures cannot be sRGB");
+      return cudaCreateChannelDesc(8,0,0,0,cudaChannelFormatKindUnsignedBlockCompressed4);
+    case OWL_TEXEL_FORMAT_BC5:
+      if (srgb) throw std::runtime_error("BC5 textures cannot be sRGB");
+      return cudaCreateChannelDesc(8,8,0,0,cudaChannelFormatKindUnsignedBlockCompressed5);
+    case OWL_TEXEL_FORMAT_BC7:
+      return cudaCreateChannelDesc(8,8,8,8,
+                                   srgb
+                                   ? cudaChannelFormatKindUnsignedBlockCompressed7SRGB
+                                   : cudaChannelFormatKindUnsignedBlockCompressed7);
+#endif
     default:
       throw std::runtime_error("texel format not implemented");
-    };
+    }
+  }
+
+  /*! how texels of given format are laid out in memory, for
+      cudaMemcpy2DToArray: the number of bytes in a (tightly packed)
+      row, and the number of rows. For block compressed formats a
+      'row' is a row of 4x4 blocks */
+  static void rowLayoutFor(OWLTexelFormat texelFormat, vec2i size,
+                           size_t &bytesPerRow, size_t &numRows)
+  {
+    if (bc::isBlockCompressed(texelFormat)) {
+      const vec2i blocks = bc::numBlocks(size);
+      bytesPerRow = blocks.x*bc::bytesPerBlock(texelFormat);
+      numRows     = blocks.y;
+    } else {
+      bytesPerRow = size.x*mipmap::bytesPerTexel(texelFormat);
+      numRows     = size.y;
+    }
+  }
+
+  static cudaTextureDesc textureDescFor(OWLTexelFormat        texelFormat,
+                                        OWLTextureFilterMode  filterMode,
+                                        OWLTextureAddressMode addressMode,
+                                        OWLTextureColorSpace  colorSpace,
+                                        int                   numLevels)
+  {
+    cudaTextureDesc tex_desc     = {};
+    if (addressMode == OWL_TEXTURE_BORDER) {
+      tex_desc.addressMode[0]      = cudaAddressModeBorder;
+      tex_desc.addressMode[1]      = cudaAddressModeBorder;
+    } else if (addressMode == OWL_TEXTURE_CLAMP) {
+      tex_desc.addressMode[0]      = cudaAddressModeClamp;
+      tex_desc.addressMode[1]      = cudaAddressModeClamp;
+    } else if (addressMode == OWL_TEXTURE_WRAP) {
+      tex_desc.addressMode[0]      = cudaAddressModeWrap;
+      tex_desc.addressMode[1]      = cudaAddressModeWrap;
+    } else {
+      tex_desc.addressMode[0]      = cudaAddressModeMirror;
+      tex_desc.addressMode[1]      = cudaAddressModeMirror;
+    }
+    assert(filterMode == OWL_TEXTURE_NEAREST
+           ||
+           filterMode == OWL_TEXTURE_LINEAR);
+    tex_desc.filterMode          =
+      filterMode == OWL_TEXTURE_NEAREST
+      ? cudaFilterModePoint
+      : cudaFilterModeLinear;
+    tex_desc.readMode            =
+      ((texelFormat == OWL_TEXEL_FORMAT_R8) || (texelFormat == OWL_TEXEL_FORMAT_RGBA8)
+       || bc::isBlockCompressed(texelFormat)) ?
+      cudaReadModeNormalizedFloat : cudaReadModeElementType;
+    tex_desc.normalizedCoords    = 1;
+    tex_desc.maxAnisotropy       = 1;
+    tex_desc.maxMipmapLevelClamp = (numLevels > 1) ? float(numLevels-1) : 99;
+    tex_desc.minMipmapLevelClamp = 0;
+    tex_desc.mipmapFilterMode    = (numLevels > 1)
+      ? tex_desc.filterMode
+      : cudaFilterModePoint;
+    tex_desc.borderColor[0]      = 1.0f;
+    tex_desc.sRGB                = (colorSpace == OWL_COLOR_SPACE_SRGB);
+    return tex_desc;
   }
   
   Texture::Texture(Context *const context,
@@ -42,91 +122,58 @@ namespace owl {
                    OWLTextureColorSpace colorSpace,
                    const void *texels
                    )
-    : RegisteredObject(context,context->textures)
+    : RegisteredObject(context,context->textures),
+      size(size),
+      linePitchInBytes(linePitchInBytes),
+      texelFormat(texelFormat),
+      filterMode(filterMode)
   {
     assert(size.x > 0);
     assert(size.y > 0);
-    int32_t pitch  = linePitchInBytes;
-    if (pitch == 0)
-      pitch = int(size.x*bytesPerTexel(texelFormat));
-    assert(
-      (texelFormat == OWL_TEXEL_FORMAT_RGBA8) ||
-      (texelFormat == OWL_TEXEL_FORMAT_RGBA32F) ||
-      (texelFormat == OWL_TEXEL_FORMAT_R8) ||
-      (texelFormat == OWL_TEXEL_FORMAT_R32F)
-    );
-    if (pitch == 0) {
-      switch(texelFormat) {
-        case OWL_TEXEL_FORMAT_RGBA8:   pitch = size.x*sizeof(vec4uc); break;
-        case OWL_TEXEL_FORMAT_RGBA32F: pitch = size.x*sizeof(vec4f); break;
-        case OWL_TEXEL_FORMAT_R8:      pitch = size.x*sizeof(uint8_t); break;
-        case OWL_TEXEL_FORMAT_R32F:    pitch = size.x*sizeof(float); break;
-        default: assert(false);
-      }  
-    }
+    size_t bytesPerRow, numRows;
+    rowLayoutFor(texelFormat,size,bytesPerRow,numRows);
+    const size_t pitch = linePitchInBytes ? linePitchInBytes : bytesPerRow;
 
     assert(texels != nullptr);
     
     for (auto device : context->getDevices()) {
+      if (device->isNull()) {
+        // no texture units to bind to; device code would see a null
+        // texture object
+        textureArrays.push_back(nullptr);
+        textureObjects.push_back(0);
+        continue;
+      }
       SetActiveGPU forLifeTime(device);
 
       cudaResourceDesc res_desc = {};
       
-      cudaChannelFormatDesc channel_desc;
-      switch(texelFormat) {
-        case OWL_TEXEL_FORMAT_RGBA8:   channel_desc = cudaCreateChannelDesc<uchar4>(); break;
-        case OWL_TEXEL_FORMAT_RGBA32F: channel_desc = cudaCreateChannelDesc<float4>(); break;
-        case OWL_TEXEL_FORMAT_R8:      channel_desc = cudaCreateChannelDesc<uint8_t>(); break;
-        case OWL_TEXEL_FORMAT_R32F:    channel_desc = cudaCreateChannelDesc<float>(); break;
-        default: assert(false);
-      }        
+      cudaChannelFormatDesc channel_desc = channelDescFor(texelFormat,colorSpace);
 
+      // (cuda may pad, so that's an estimate)
+      const size_t arrayBytes = bytesPerRow*numRows;
+      DeviceAllocator *pool = device->allocator.get();
+      detail::checkBudget(&device->memoryTracker,pool,
+                          arrayBytes,arrayBytes,OWL_MEMORY_TEXTURE);
       cudaArray_t   pixelArray;
-      CUDA_CALL(MallocArray(&pixelArray,
-                             &channel_desc,
-                             size.x,size.y));
+      CUDA_CHECK(detail::retryAfterReleasingCache
+                 (pool,[&]{ return cudaMallocArray(&pixelArray,
+                                                   &channel_desc,
+                                                   size.x,size.y); }));
+      device->memoryTracker.allocated(pixelArray,arrayBytes,OWL_MEMORY_TEXTURE);
       textureArrays.push_back(pixelArray);
       
       CUDA_CALL(Memcpy2DToArray(pixelArray,
                                  /* offset */0,0,
                                  texels,
-                                 pitch,pitch,size.y,
+                                 pitch,bytesPerRow,numRows,
                                  cudaMemcpyHostToDevice));
       
       res_desc.resType          = cudaResourceTypeArray;
       res_desc.res.array.array  = pixelArray;
       
-      cudaTextureDesc tex_desc     = {};
-      if (addressMode == OWL_TEXTURE_BORDER) {
-        tex_desc.addressMode[0]      = cudaAddressModeBorder;
-        tex_desc.addressMode[1]      = cudaAddressModeBorder;
-      } else if (addressMode == OWL_TEXTURE_CLAMP) {
-        tex_desc.addressMode[0]      = cudaAddressModeClamp;
-        tex_desc.addressMode[1]      = cudaAddressModeClamp;
-      } else if (addressMode == OWL_TEXTURE_WRAP) {
-        tex_desc.addressMode[0]      = cudaAddressModeWrap;
-        tex_desc.addressMode[1]      = cudaAddressModeWrap;
-      } else {
-        tex_desc.addressMode[0]      = cudaAddressModeMirror;
-        tex_desc.addressMode[1]      = cudaAddressModeMirror;
-      }
-      assert(filterMode == OWL_TEXTURE_NEAREST
-             ||
-             filterMode == OWL_TEXTURE_LINEAR);
-      tex_desc.filterMode          =
-        filterMode == OWL_TEXTURE_NEAREST
-        ? cudaFilterModePoint
-        : cudaFilterModeLinear;
-      tex_desc.readMode            =
-        ((texelFormat == OWL_TEXEL_FORMAT_R8) || (texelFormat == OWL_TEXEL_FORMAT_RGBA8)) ?
-        cudaReadModeNormalizedFloat : cudaReadModeElementType;
-      tex_desc.normalizedCoords    = 1;
-      tex_desc.maxAnisotropy       = 1;
-      tex_desc.maxMipmapLevelClamp = 99;
-      tex_desc.minMipmapLevelClamp = 0;
-      tex_desc.mipmapFilterMode    = cudaFilterModePoint;
-      tex_desc.borderColor[0]      = 1.0f;
-      tex_desc.sRGB                = (colorSpace == OWL_COLOR_SPACE_SRGB);
+      cudaTextureDesc tex_desc
+        = textureDescFor(texelFormat,filterMode,addressMode,colorSpace,1);
       
       // Create texture object
       cudaTextureObject_t cuda_tex = 0;
@@ -136,6 +183,81 @@ namespace owl {
     }
   }
 
+  Texture::Texture(Context *const context,
+                   vec2i                size,
+                   OWLTexelFormat       texelFormat,
+                   OWLTextureFilterMode filterMode,
+                   OWLTextureAddressMode addressMode,
+                   OWLTextureColorSpace colorSpace,
+                   const std::vector<const void *> &levels
+                   )
+    : RegisteredObject(context,context->textures),
+      size(size),
+      linePitchInBytes(0),
+      texelFormat(texelFormat),
+      filterMode(filterMode),
+      numLevels((int)levels.size())
+  {
+    assert(size.x > 0);
+    assert(size.y > 0);
+    assert(numLevels == mipmap::numLevels(size));
+
+    // what the levels take without any padding cuda may add
+    size_t arrayBytes = 0;
+    for (int level=0;level<numLevels;level++) {
+      size_t bytesPerRow, numRows;
+      rowLayoutFor(texelFormat,mipmap::levelSize(size,level),bytesPerRow,numRows);
+      arrayBytes += bytesPerRow*numRows;
+    }
+    
+    for (auto device : context->getDevices()) {
+      if (device->isNull()) {
+        mipmappedArrays.push_back(nullptr);
+        textureObjects.push_back(0);
+        continue;
+      }
+      SetActiveGPU forLifeTime(device);
+
+      cudaChannelFormatDesc channel_desc = channelDescFor(texelFormat,colorSpace);
+      DeviceAllocator *pool = device->allocator.get();
+      detail::checkBudget(&device->memoryTracker,pool,
+                          arrayBytes,arrayBytes,OWL_MEMORY_TEXTURE);
+      cudaMipmappedArray_t mipmappedArray;
+      CUDA_CHECK(detail::retryAfterReleasingCache
+                 (pool,[&]{ return cudaMallocMipmappedArray(&mipmappedArray,
+                                                            &channel_desc,
+                                                            make_cudaExtent(size.x,size.y,0),
+                                                            numLevels); }));
+      device->memoryTracker.allocated(mipmappedArray,arrayBytes,OWL_MEMORY_TEXTURE);
+      mipmappedArrays.push_back(mipmappedArray);
+
+      for (int level=0;level<numLevels;level++) {
+        const vec2i levelSize = mipmap::levelSize(size,level);
+        size_t bytesPerRow, numRows;
+        rowLayoutFor(texelFormat,levelSize,bytesPerRow,numRows);
+        cudaArray_t levelArray;
+        CUDA_CALL(GetMipmappedArrayLevel(&levelArray,mipmappedArray,level));
+        CUDA_CALL(Memcpy2DToArray(levelArray,
+                                  /* offset */0,0,
+                                  levels[level],
+                                  bytesPerRow,bytesPerRow,numRows,
+                                  cudaMemcpyHostToDevice));
+      }
+      
+      cudaResourceDesc res_desc = {};
+      res_desc.resType           = cudaResourceTypeMipmappedArray;
+      res_desc.res.mipmap.mipmap = mipmappedArray;
+      
+      cudaTextureDesc tex_desc
+        = textureDescFor(texelFormat,filterMode,addressMode,colorSpace,numLevels);
+      
+      cudaTextureObject_t cuda_tex = 0;
+      CUDA_CALL(CreateTextureObject(&cuda_tex, &res_desc, &tex_desc, nullptr));
+
+      textureObjects.push_back(cuda_tex);
+    }
+  }
+
   /* return the cuda texture object corresponding to the specified 
        device ID*/
   cudaTextureObject_t Texture::getObject(int deviceID)
@@ -158,10 +280,17 @@ namespace owl {
       return;
 
     for (auto device : context->getDevices()) {
+      if (device->isNull()) continue;
       SetActiveGPU forLifeTime(device);
       uint32_t id = device->ID;
       cudaDestroyTextureObject(textureObjects[id]);
-      cudaFreeArray(textureArrays[id]);
+      if (isMipmapped()) {
+        device->memoryTracker.freed(mipmappedArrays[id]);
+        cudaFreeMipmappedArray(mipmappedArrays[id]);
+      } else {
+        device->memoryTracker.freed(textureArrays[id]);
+        cudaFreeArray(textureArrays[id]);
+      }
     }
 
     deviceData.clear();
@@ -33,6 +33,17 @@ namespace owl {
             OWLTextureColorSpace colorSpace,
             const void          *texels
             );
+
+    /*! creates a mip-mapped texture; 'levels' has to be the full
+        chain, down to 1x1, with each level tightly packed */
+    Texture(Context *const context,
+            vec2i                size,
+            OWLTexelFormat       texelFormat,
+            OWLTextureFilterMode filterMode,
+            OWLTextureAddressMode addressMode,
+            OWLTextureColorSpace colorSpace,
+            const std::vector<const void *> &levels
+            );
     
     /*! destructor - free device data, de-regsiter, and destruct */
     virtual ~Texture();
@@ -52,11 +63,20 @@ namespace owl {
     /*! one entry per device */
     std::vector<cudaTextureObject_t> textureObjects;
     std::vector<cudaArray_t>         textureArrays;
+    /*! one entry per device, for mip-mapped textures (which do not
+        use textureArrays) */
+    std::vector<cudaMipmappedArray_t> mipmappedArrays;
+
+    /*! whether this got created as a mip-mapped texture; note that
+        can be a single level (eg, for 1x1 textures), so numLevels
+        doesn't tell */
+    inline bool isMipmapped() const { return !mipmappedArrays.empty(); }
     
     vec2i                size;
     uint32_t             linePitchInBytes;
     OWLTexelFormat       texelFormat;
     OWLTextureFilterMode filterMode;
+    int                  numLevels { 1 };
   };
 
 } // ::owl
@@ -0,0 +1,201 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "TextureAtlas.h"
+#include "MipMap.h"
+#include "owl/common/parallel/parallel_for.h"
+#include <algorithm>
+#include <limits>
+
+namespace owl {
+  namespace atlas {
+
+    // ------------------------------------------------------------------
+    // skyline packer
+    // ------------------------------------------------------------------
+
+    SkylinePacker::SkylinePacker(vec2i size)
+      : size(size)
+    {
+      skyline.push_back({0,0,size.x});
+    }
+
+    bool SkylinePacker::insert(vec2i rect, vec2i &position)
+    {
+      if (rect.x <= 0 || rect.y <= 0 || rect.x > size.x || rect.y > size.y)
+        return false;
+      
+      // find the segment at whose left edge the rectangle's top ends
+      // up lowest (and, of those, leftmost)
+      int bestSegment = -1, bestY = 0, bestTop = std::numeric_limits<int>::max();
+      for (int i=0;i<(int)skyline.size();i++) {
+        const int x = skyline[i].x;
+        if (x + rect.x > size.x) break;
+        // rectangle rests on the highest segment it spans
+        int y = 0;
+        for (int j=i;j<(int)skyline.size() && skyline[j].x < x+rect.x;j++)
+          y = std::max(y,skyline[j].y);
+        const int top = y + rect.y;
+        if (top <= size.y && top < bestTop) {
+          bestSegment = i;
+          bestY       = y;
+          bestTop     = top;
+        }
+      }
+      if (bestSegment < 0)
+        return false;
+      position = vec2i(skyline[bestSegment].x,bestY);
+
+      // replace the spanned part of the skyline with the rectangle's
+      // top edge ...
+      const int x0 = position.x, x1 = position.x + rect.x;
+      std::vector<Segment> updated;
+      updated.reserve(skyline.size()+2);
+      for (auto &seg : skyline) {
+        const int segEnd = seg.x + seg.width;
+        if (segEnd <= x0 || seg.x >= x1) {
+          updated.push_back(seg);
+          continue;
+        }
+        if (seg.x < x0)
+          updated.push_back({seg.x,seg.y,x0-seg.x});
+        if (segEnd > x1)
+          updated.push_back({x1,seg.y,segEnd-x1});
+      }
+      // ... (inserted in x order) ...
+      auto at = std::lower_bound(updated.begin(),updated.end(),x0,
+                                 [](const Segment &s, int x){ return s.x < x; });
+      updated.insert(at,Segment{x0,bestTop,rect.x});
+      // ... and merge neighbors of same height
+      skyline.clear();
+      for (auto &seg : updated)
+        if (!skyline.empty() && skyline.back().y == seg.y)
+          skyline.back().width += seg.width;
+        else
+          skyline.push_back(seg);
+      
+      usedArea += size_t(rect.x)*rect.y;
+      return true;
+    }
+
+    int SkylinePacker::usedHeight() const
+    {
+      int height = 0;
+      for (auto &seg : skyline)
+        height = std::max(height,seg.y);
+      return height;
+    }
+
+    float SkylinePacker::occupancy() const
+    {
+      const int height = usedHeight();
+      return height ? usedArea / float(size_t(size.x)*height) : 0.f;
+    }
+
+    // ------------------------------------------------------------------
+    // building atlases
+    // ------------------------------------------------------------------
+
+    /*! copies a texture (plus gutter of replicated edge texels) into
+        the atlas */
+    static void blit(Atlas &atlas, size_t texelSize,
+                     const Input &input, vec2i position, int gutter)
+    {
+      const size_t inPitch
+        = input.linePitchInBytes ? input.linePitchInBytes : input.size.x*texelSize;
+      const size_t outPitch = atlas.size.x*texelSize;
+      const uint8_t *in = (const uint8_t *)input.texels;
+      for (int y=-gutter;y<input.size.y+gutter;y++) {
+        const int srcY = std::min(std::max(y,0),input.size.y-1);
+        const uint8_t *srcLine = in + srcY*inPitch;
+        uint8_t *dstLine = atlas.texels.data() + (position.y+y)*outPitch;
+        // left gutter, texels, right gutter
+        for (int x=-gutter;x<0;x++)
+          memcpy(dstLine+(position.x+x)*texelSize,srcLine,texelSize);
+        memcpy(dstLine+position.x*texelSize,srcLine,input.size.x*texelSize);
+        for (int x=input.size.x;x<input.size.x+gutter;x++)
+          memcpy(dstLine+(position.x+x)*texelSize,
+                 srcLine+(input.size.x-1)*texelSize,texelSize);
+      }
+    }
+    
+    Result build(OWLTexelFormat            format,
+                 const std::vector<Input> &textures,
+                 int                       maxAtlasSize,
+                 int                       gutter)
+    {
+      if (maxAtlasSize <= 0 || gutter < 0)
+        throw std::runtime_error("invalid atlas parameters");
+      const size_t texelSize = mipmap::bytesPerTexel(format);
+      
+      Result result;
+      result.placements.resize(textures.size());
+
+      // tallest first; that's what skyline packing likes best
+      std::vector<int> order;
+      for (int i=0;i<(int)textures.size();i++)
+        if (textures[i].size.x > 0 && textures[i].size.y > 0)
+          order.push_back(i);
+      std::stable_sort(order.begin(),order.end(),[&](int a, int b){
+          const vec2i sa = textures[a].size, sb = textures[b].size;
+          return sa.y != sb.y ? sa.y > sb.y : sa.x > sb.x;
+        });
+
+      std::vector<SkylinePacker> packers;
+      std::vector<vec2i> paddedPosition(textures.size());
+      for (int i : order) {
+        const vec2i padded = textures[i].size + vec2i(2*gutter);
+        if (padded.x > maxAtlasSize || padded.y > maxAtlasSize)
+          // too large; stays on its own
+          continue;
+        Placement &placement = result.placements[i];
+        for (int a=0;a<(int)packers.size() && placement.atlasID < 0;a++)
+          if (packers[a].insert(padded,paddedPosition[i]))
+            placement.atlasID = a;
+        if (placement.atlasID < 0) {
+          packers.push_back(SkylinePacker(vec2i(maxAtlasSize)));
+          packers.back().insert(padded,paddedPosition[i]);
+          placement.atlasID = (int)packers.size()-1;
+        }
+        placement.position = paddedPosition[i] + vec2i(gutter);
+      }
+
+      // atlases don't have to be taller than what is actually used
+      result.atlases.resize(packers.size());
+      for (size_t a=0;a<packers.size();a++) {
+        Atlas &atlas = result.atlases[a];
+        atlas.size      = vec2i(maxAtlasSize,packers[a].usedHeight());
+        atlas.occupancy = packers[a].occupancy();
+        atlas.texels.resize(size_t(atlas.size.x)*atlas.size.y*texelSize);
+      }
+
+      // copy textures over; those don't overlap (not even their
+      // gutters), so can all be done in parallel
+      parallel_for(textures.size(),[&](size_t i){
+          Placement &placement = result.placements[i];
+          if (placement.atlasID < 0) return;
+          Atlas &atlas = result.atlases[placement.atlasID];
+          blit(atlas,texelSize,textures[i],placement.position,gutter);
+          placement.uvTransform.scale
+            = vec2f(textures[i].size) / vec2f(atlas.size);
+          placement.uvTransform.offset
+            = vec2f(placement.position) / vec2f(atlas.size);
+        });
+      return result;
+    }
+    
+  } // ::owl::atlas
+} // ::owl
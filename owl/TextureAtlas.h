@@ -0,0 +1,110 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/TextureAtlas.h Host-side texture atlas builder.
+
+    Packs many (small) textures into a few large ones - fewer
+    cudaArrays, texture objects, and texture handles to pass around -
+    and tells for each input texture where it ended up, as a
+    transform to apply to its texture coordinates. Each texture gets
+    surrounded by a gutter of replicated edge texels, so bilinear
+    filtering near its borders doesn't pick up texels of its
+    neighbors.
+
+    Like MipMap.h, this doesn't depend on CUDA or a Context. */
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+
+namespace owl {
+  namespace atlas {
+
+    /*! bottom-left skyline rectangle packer: keeps track of the
+        "skyline" of already placed rectangles, and places each new
+        one where its top edge ends up lowest */
+    struct SkylinePacker {
+      SkylinePacker(vec2i size);
+
+      /*! finds a place for a rectangle of given size, and marks it
+          as used; returns false if there is none */
+      bool insert(vec2i rectSize, vec2i &position);
+
+      /*! highest point of the skyline, ie, height actually used */
+      int usedHeight() const;
+
+      /*! fraction of the area up to usedHeight() that is covered by
+          rectangles */
+      float occupancy() const;
+
+      const vec2i size;
+    private:
+      struct Segment { int x, y, width; };
+      std::vector<Segment> skyline;
+      size_t               usedArea { 0 };
+    };
+
+    /*! one texture to be packed into an atlas */
+    struct Input {
+      vec2i       size;
+      const void *texels;
+      /*! 0 means tightly packed */
+      size_t      linePitchInBytes { 0 };
+    };
+
+    /*! maps texture coordinates of an input texture to those in its
+        atlas: uv_atlas = uv * scale + offset. Only valid for uvs
+        within [0,1] - wrapping doesn't work in an atlas */
+    struct UVTransform {
+      vec2f scale  { 1.f, 1.f };
+      vec2f offset { 0.f, 0.f };
+    };
+
+    /*! where an input texture ended up */
+    struct Placement {
+      /*! index into Result::atlases; -1 if the texture was too large
+          to go into an atlas (and should stay a texture of its own) */
+      int         atlasID { -1 };
+      /*! position of the texture's first texel (not of its gutter)
+          within its atlas */
+      vec2i       position;
+      UVTransform uvTransform;
+    };
+
+    struct Atlas {
+      vec2i                size;
+      std::vector<uint8_t> texels;
+      /*! fraction of the atlas covered by textures (incl. gutters) */
+      float                occupancy;
+    };
+
+    struct Result {
+      std::vector<Atlas>     atlases;
+      /*! one per input texture */
+      std::vector<Placement> placements;
+    };
+
+    /*! packs the given textures (all of the same format) into as few
+        atlases of (at most) maxAtlasSize x maxAtlasSize texels as
+        possible; textures get copied over in parallel */
+    Result build(OWLTexelFormat            format,
+                 const std::vector<Input> &textures,
+                 int                       maxAtlasSize = 4096,
+                 int                       gutter = 2);
+    
+  } // ::owl::atlas
+} // ::owl
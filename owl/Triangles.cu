@@ -113,6 +113,20 @@ namespace owl {
     DeviceContext::SP device = context->getDevice(0);
     assert(device);
     SetActiveGPU forLifeTime(device);
+
+    if (device->isNull()) {
+      // "device" memory is host memory - no need for a kernel
+      for (int key=0;key<(int)vertex.buffers.size();key++) {
+        const uint8_t *vertices
+          = (const uint8_t *)vertex.buffers[key]->getPointer(device)+vertex.offset;
+        bounds[key] = box3f();
+        for (size_t vtxID=0;vtxID<vertex.count;vtxID++)
+          bounds[key].extend(*(const vec3f*)(vertices+vtxID*vertex.stride));
+      }
+      if (vertex.buffers.size() == 1)
+        bounds[1] = bounds[0];
+      return;
+    }
       
     DeviceMemory d_bounds;
     d_bounds.alloc(2*sizeof(box3f));
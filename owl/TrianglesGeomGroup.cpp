@@ -17,19 +17,7 @@
 #include "TrianglesGeomGroup.h"
 #include "Triangles.h"
 #include "Context.h"
-
-#define LOG(message)                                            \
-  if (Context::logging())                                       \
-    std::cout << "#owl(" << device->ID << "): "                 \
-              << message                                        \
-              << std::endl
-
-#define LOG_OK(message)                                         \
-  if (Context::logging())                                       \
-    std::cout << OWL_TERMINAL_GREEN                             \
-              << "#owl(" << device->ID << "): "                 \
-              << message << OWL_TERMINAL_DEFAULT << std::endl
-
+#include "Profiler.h"
 
 namespace owl {
 
@@ -59,6 +47,7 @@ namespace owl {
   
   void TrianglesGeomGroup::buildAccel()
   {
+    OWL_PROFILE_SCOPE("TrianglesGeomGroup::buildAccel");
     for (auto device : context->getDevices()) 
       buildAccelOn<true>(device);
 
@@ -68,6 +57,7 @@ namespace owl {
   
   void TrianglesGeomGroup::refitAccel()
   {
+    OWL_PROFILE_SCOPE("TrianglesGeomGroup::refitAccel");
     for (auto device : context->getDevices()) 
       buildAccelOn<false>(device);
     
@@ -78,6 +68,7 @@ namespace owl {
   template<bool FULL_REBUILD>
   void TrianglesGeomGroup::buildAccelOn(const DeviceContext::SP &device) 
   {
+    OWL_PROFILE_SCOPE(FULL_REBUILD ? "buildAccelOn" : "refitAccelOn");
     DeviceData &dd = getDD(device);
 
     if (FULL_REBUILD && !dd.bvhMemory.empty())
@@ -92,15 +83,11 @@ namespace owl {
     }
    
     SetActiveGPU forLifeTime(device);
-    LOG("building triangles accel over "
+    OWL_LOG_INFO("device #" << device->ID << ": building triangles accel over "
         << geometries.size() << " geometries");
     size_t   sumPrims = 0;
-    uint32_t maxPrimsPerGAS = 0;
-    optixDeviceContextGetProperty
-      (device->optixContext,
-       OPTIX_DEVICE_PROPERTY_LIMIT_MAX_PRIMITIVES_PER_GAS,
-       &maxPrimsPerGAS,
-       sizeof(maxPrimsPerGAS));
+    const uint32_t maxPrimsPerGAS
+      = device->getProperty(OPTIX_DEVICE_PROPERTY_LIMIT_MAX_PRIMITIVES_PER_GAS);
 
     assert(!geometries.empty());
     TrianglesGeom::SP child0 = geometries[0]->as<TrianglesGeom>();
@@ -194,13 +181,10 @@ namespace owl {
       accelOptions.operation            = OPTIX_BUILD_OPERATION_UPDATE;
       
     OptixAccelBufferSizes blasBufferSizes;
-    OPTIX_CHECK(optixAccelComputeMemoryUsage
-                (device->optixContext,
-                 &accelOptions,
-                 triangleInputs.data(),
-                 (uint32_t)triangleInputs.size(),
-                 &blasBufferSizes
-                 ));
+    device->accelComputeMemoryUsage(accelOptions,
+                                    triangleInputs.data(),
+                                    (uint32_t)triangleInputs.size(),
+                                    blasBufferSizes);
     
     // ------------------------------------------------------------------
     // ... and allocate buffers: temp buffer, initial (uncompacted)
@@ -212,7 +196,7 @@ namespace owl {
         = FULL_REBUILD
         ? blasBufferSizes.tempSizeInBytes
         : blasBufferSizes.tempUpdateSizeInBytes;
-    LOG("starting to build/refit "
+    OWL_LOG_INFO("device #" << device->ID << ": starting to build/refit "
         << prettyNumber(triangleInputs.size()) << " triangle geom groups, "
         << prettyNumber(blasBufferSizes.outputSizeInBytes) << "B in output and "
         << prettyNumber(tempSize) << "B in temp data");
@@ -221,16 +205,18 @@ namespace owl {
     DeviceMemory tempBuffer;
     tempBuffer.alloc(FULL_REBUILD
                      ?blasBufferSizes.tempSizeInBytes
-                     :blasBufferSizes.tempUpdateSizeInBytes);
+                     :blasBufferSizes.tempUpdateSizeInBytes,
+                     OWL_MEMORY_ACCEL_TEMP);
     
     // buffer for initial, uncompacted bvh
     DeviceMemory outputBuffer;
-    outputBuffer.alloc(blasBufferSizes.outputSizeInBytes);
+    outputBuffer.alloc(blasBufferSizes.outputSizeInBytes,
+                       OWL_MEMORY_ACCEL_TEMP);
 
     // single size-t buffer to store compacted size in
     DeviceMemory compactedSizeBuffer;
     if (FULL_REBUILD) {
-      compactedSizeBuffer.alloc(sizeof(uint64_t));
+      compactedSizeBuffer.alloc(sizeof(uint64_t),OWL_MEMORY_ACCEL_TEMP);
       // this is only 8 bytes, so woon't matter... but still
       dd.memPeak += tempBuffer.size();
       dd.memPeak += outputBuffer.size();
@@ -245,41 +231,31 @@ namespace owl {
     emitDesc.result = (CUdeviceptr)compactedSizeBuffer.get();
 
     if (FULL_REBUILD) {
-      OPTIX_CHECK(optixAccelBuild(device->optixContext,
-                                  /* todo: stream */0,
-                                  &accelOptions,
-                                  // array of build inputs:
-                                  triangleInputs.data(),
-                                  (uint32_t)triangleInputs.size(),
-                                  // buffer of temp memory:
-                                  (CUdeviceptr)tempBuffer.get(),
-                                  tempBuffer.size(),
-                                  // where we store initial, uncomp bvh:
-                                  (CUdeviceptr)outputBuffer.get(),
-                                  outputBuffer.size(),
-                                  /* the traversable we're building: */ 
-                                  &dd.traversable,
-                                  /* we're also querying compacted size: */
-                                  &emitDesc,1u
-                                  ));
+      device->accelBuild(accelOptions,
+                         // array of build inputs:
+                         triangleInputs.data(),
+                         (uint32_t)triangleInputs.size(),
+                         // buffer of temp memory:
+                         tempBuffer,
+                         // where we store initial, uncomp bvh:
+                         outputBuffer,
+                         /* the traversable we're building: */ 
+                         dd.traversable,
+                         /* we're also querying compacted size: */
+                         &emitDesc,1u);
     } else {
-      OPTIX_CHECK(optixAccelBuild(device->optixContext,
-                                  /* todo: stream */0,
-                                  &accelOptions,
-                                  // array of build inputs:
-                                  triangleInputs.data(),
-                                  (uint32_t)triangleInputs.size(),
-                                  // buffer of temp memory:
-                                  (CUdeviceptr)tempBuffer.get(),
-                                  tempBuffer.size(),
-                                  // where we store initial, uncomp bvh:
-                                  (CUdeviceptr)dd.bvhMemory.get(),
-                                  dd.bvhMemory.size(),
-                                  /* the traversable we're building: */ 
-                                  &dd.traversable,
-                                  /* we're also querying compacted size: */
-                                  nullptr,0
-                                  ));
+      device->accelBuild(accelOptions,
+                         // array of build inputs:
+                         triangleInputs.data(),
+                         (uint32_t)triangleInputs.size(),
+                         // buffer of temp memory:
+                         tempBuffer,
+                         // where we store initial, uncomp bvh:
+                         dd.bvhMemory,
+                         /* the traversable we're building: */ 
+                         dd.traversable,
+                         /* we're also querying compacted size: */
+                         nullptr,0);
     }
     CUDA_SYNC_CHECK();
     
@@ -289,19 +265,14 @@ namespace owl {
     
     // alloc the buffer...
     if (FULL_REBUILD) {
+      OWL_PROFILE_SCOPE("compactAccel");
       // download builder's compacted size from device
       uint64_t compactedSize;
       compactedSizeBuffer.download(&compactedSize);
       
-      dd.bvhMemory.alloc(compactedSize);
+      dd.bvhMemory.alloc(compactedSize,OWL_MEMORY_ACCEL);
       // ... and perform compaction
-      OPTIX_CALL(AccelCompact(device->optixContext,
-                              /*TODO: stream:*/0,
-                              // OPTIX_COPY_MODE_COMPACT,
-                              dd.traversable,
-                              (CUdeviceptr)dd.bvhMemory.get(),
-                              dd.bvhMemory.size(),
-                              &dd.traversable));
+      device->accelCompact(dd.traversable,dd.bvhMemory,dd.traversable);
       dd.memPeak += dd.bvhMemory.size();
       dd.memFinal = dd.bvhMemory.size();
     }
@@ -316,7 +287,7 @@ namespace owl {
     if (FULL_REBUILD)
       compactedSizeBuffer.free();
 
-    LOG_OK("successfully build triangles geom group accel");
+    OWL_LOG_OK("device #" << device->ID << ": successfully build triangles geom group accel");
   }
   
 } // ::owl
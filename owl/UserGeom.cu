@@ -19,17 +19,7 @@
 
 namespace owl {
 
-#define LOG(message)                                    \
-  if (Context::logging())                               \
-    std::cout << "#owl(" << device->ID << "): "         \
-              << message                                \
-              << std::endl
 
-#define LOG_OK(message)                                         \
-  if (Context::logging())                                       \
-    std::cout << OWL_TERMINAL_GREEN                             \
-              << "#owl(" << device->ID << "): "                 \
-              << message << OWL_TERMINAL_DEFAULT << std::endl
 
   __device__ static float atomicMax(float* address, float val)
   {
@@ -110,6 +100,18 @@ namespace owl {
     DeviceContext::SP device = context->getDevices()[0];
     SetActiveGPU forLifeTime(device);
 
+    if (device->isNull()) {
+      // "device" memory is host memory - no need for a kernel
+      const box3f *primBounds
+        = (const box3f *)getDD(device).internalBufferForBoundsProgram.get();
+      bounds[0] = box3f();
+      for (size_t primID=0;primID<primCount;primID++)
+        if (!primBounds[primID].empty())
+          bounds[0].extend(primBounds[primID]);
+      bounds[1] = bounds[0];
+      return;
+    }
+
     DeviceMemory d_bounds;
     d_bounds.alloc(sizeof(box3f));
     bounds[0] = bounds[1] = box3f();
@@ -179,7 +181,7 @@ namespace owl {
     tempMem.alloc(geomType->varStructSize);
     
     DeviceData &dd = getDD(device);
-    dd.internalBufferForBoundsProgram.alloc(primCount*sizeof(box3f));
+    dd.internalBufferForBoundsProgram.alloc(primCount*sizeof(box3f),OWL_MEMORY_ACCEL);
     // dd.internalBufferForBoundsProgram.allocManaged(primCount*sizeof(box3f));
 
     writeVariables(userGeomData.data(),device);
@@ -199,6 +201,15 @@ namespace owl {
     vec3i gridDims(numBlocks_x,numBlocks_y,numBlocks_z);
 
     tempMem.upload(userGeomData);
+
+    if (device->isNull()) {
+      // no bounds program to run on a null device; leave all prims
+      // with empty bounds
+      box3f *primBounds = (box3f *)dd.internalBufferForBoundsProgram.get();
+      for (size_t primID=0;primID<primCount;primID++)
+        primBounds[primID] = box3f();
+      return;
+    }
     
     void  *d_geomData = tempMem.get();
     vec3f *d_boundsArray = (vec3f*)dd.internalBufferForBoundsProgram.get();
@@ -260,7 +271,10 @@ namespace owl {
     assert(module);
 
     for (auto device : context->getDevices()) {
-      LOG("building bounds function ....");
+      if (device->isNull())
+        // no bounds module to get the kernel from
+        continue;
+      OWL_LOG_INFO("device #" << device->ID << ": building bounds function ....");
       SetActiveGPU forLifeTime(device);
       auto &typeDD = getDD(device);
       auto &moduleDD = module->getDD(device);
@@ -278,7 +292,7 @@ namespace owl {
       switch(rc) {
       case CUDA_SUCCESS:
         /* all OK, nothing to do */
-        LOG_OK("found bounds function " << annotatedProgName << " ... perfect!");
+        OWL_LOG_OK("device #" << device->ID << ": found bounds function " << annotatedProgName << " ... perfect!");
         break;
       case CUDA_ERROR_NOT_FOUND:
         throw std::runtime_error("in "+std::string(__PRETTY_FUNCTION__)
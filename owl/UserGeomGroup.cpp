@@ -16,18 +16,7 @@
 
 #include "UserGeomGroup.h"
 #include "Context.h"
-
-#define LOG(message)                                            \
-  if (Context::logging())                                       \
-    std::cout << "#owl(" << device->ID << "): "                 \
-              << message                                        \
-              << std::endl
-
-#define LOG_OK(message)                                         \
-  if (Context::logging())                                       \
-    std::cout << OWL_TERMINAL_GREEN                             \
-              << "#owl(" << device->ID << "): "                 \
-              << message << OWL_TERMINAL_DEFAULT << std::endl
+#include "Profiler.h"
 
 namespace owl {
   
@@ -39,6 +28,7 @@ namespace owl {
   void UserGeomGroup::buildOrRefit(bool FULL_REBUILD)
   {
     for (auto child : geometries) {
+      OWL_PROFILE_SCOPE("UserGeom::boundsProgram");
       UserGeom::SP userGeom = child->as<UserGeom>();
       assert(userGeom);
       for (auto device : context->getDevices())
@@ -54,11 +44,13 @@ namespace owl {
   
   void UserGeomGroup::buildAccel()
   {
+    OWL_PROFILE_SCOPE("UserGeomGroup::buildAccel");
     buildOrRefit(true);
   }
 
   void UserGeomGroup::refitAccel()
   {
+    OWL_PROFILE_SCOPE("UserGeomGroup::refitAccel");
     buildOrRefit(false);
   }
 
@@ -66,8 +58,8 @@ namespace owl {
   template<bool FULL_REBUILD>
   void UserGeomGroup::buildAccelOn(const DeviceContext::SP &device)
   {
+    OWL_PROFILE_SCOPE(FULL_REBUILD ? "buildAccelOn" : "refitAccelOn");
     DeviceData &dd = getDD(device);
-    auto optixContext = device->optixContext;
 
     if (FULL_REBUILD && !dd.bvhMemory.empty())
       dd.bvhMemory.free();
@@ -86,16 +78,12 @@ namespace owl {
     //   assert("check DOES exist on first build " && !dd.bvhMemory.empty());
       
     SetActiveGPU forLifeTime(device);
-    LOG("building user accel over "
+    OWL_LOG_INFO("device #" << device->ID << ": building user accel over "
         << geometries.size() << " geometries");
 
     size_t sumPrims = 0;
-    uint32_t maxPrimsPerGAS = 0;
-    optixDeviceContextGetProperty
-      (device->optixContext,
-       OPTIX_DEVICE_PROPERTY_LIMIT_MAX_PRIMITIVES_PER_GAS,
-       &maxPrimsPerGAS,
-       sizeof(maxPrimsPerGAS));
+    const uint32_t maxPrimsPerGAS
+      = device->getProperty(OPTIX_DEVICE_PROPERTY_LIMIT_MAX_PRIMITIVES_PER_GAS);
     
     // ==================================================================
     // create triangle inputs
@@ -177,13 +165,10 @@ namespace owl {
       accelOptions.operation            = OPTIX_BUILD_OPERATION_UPDATE;
     
     OptixAccelBufferSizes blasBufferSizes;
-    OPTIX_CHECK(optixAccelComputeMemoryUsage
-                (optixContext,
-                 &accelOptions,
-                 userGeomInputs.data(),
-                 (uint32_t)userGeomInputs.size(),
-                 &blasBufferSizes
-                 ));
+    device->accelComputeMemoryUsage(accelOptions,
+                                    userGeomInputs.data(),
+                                    (uint32_t)userGeomInputs.size(),
+                                    blasBufferSizes);
     
     // ------------------------------------------------------------------
     // ... and allocate buffers: temp buffer, initial (uncompacted)
@@ -195,7 +180,7 @@ namespace owl {
         = FULL_REBUILD
         ? blasBufferSizes.tempSizeInBytes
         : blasBufferSizes.tempUpdateSizeInBytes;
-    LOG("starting to build/refit "
+    OWL_LOG_INFO("device #" << device->ID << ": starting to build/refit "
         << prettyNumber(userGeomInputs.size()) << " user geoms, "
         << prettyNumber(blasBufferSizes.outputSizeInBytes) << "B in output and "
         << prettyNumber(tempSize) << "B in temp data");
@@ -205,32 +190,28 @@ namespace owl {
     tempBuffer.alloc
       (FULL_REBUILD
        ? blasBufferSizes.tempSizeInBytes
-       : blasBufferSizes.tempUpdateSizeInBytes);
+       : blasBufferSizes.tempUpdateSizeInBytes,
+       OWL_MEMORY_ACCEL_TEMP);
 
     if (FULL_REBUILD) {
       dd.memPeak += tempBuffer.size();
       // alloc only on first rebuild
-      dd.bvhMemory.alloc(blasBufferSizes.outputSizeInBytes);
+      dd.bvhMemory.alloc(blasBufferSizes.outputSizeInBytes,OWL_MEMORY_ACCEL);
       dd.memPeak += dd.bvhMemory.size();
       dd.memFinal = dd.bvhMemory.size();
     }
-    OPTIX_CHECK(optixAccelBuild(optixContext,
-                                /* todo: stream */0,
-                                &accelOptions,
-                                // array of build inputs:
-                                userGeomInputs.data(),
-                                (uint32_t)userGeomInputs.size(),
-                                // buffer of temp memory:
-                                (CUdeviceptr)tempBuffer.get(),
-                                tempBuffer.size(),
-                                // where we store initial, uncomp bvh:
-                                (CUdeviceptr)dd.bvhMemory.get(),
-                                dd.bvhMemory.size(),
-                                /* the dd.traversable we're building: */ 
-                                &dd.traversable,
-                                /* we're also querying compacted size: */
-                                nullptr,0u
-                                ));
+    device->accelBuild(accelOptions,
+                       // array of build inputs:
+                       userGeomInputs.data(),
+                       (uint32_t)userGeomInputs.size(),
+                       // buffer of temp memory:
+                       tempBuffer,
+                       // where we store initial, uncomp bvh:
+                       dd.bvhMemory,
+                       /* the dd.traversable we're building: */ 
+                       dd.traversable,
+                       /* we're also querying compacted size: */
+                       nullptr,0u);
       
     CUDA_SYNC_CHECK();
 
@@ -240,7 +221,7 @@ namespace owl {
 
     tempBuffer.free();
 
-    LOG_OK("successfully built user geom group accel");
+    OWL_LOG_OK("device #" << device->ID << ": successfully built user geom group accel");
 
     // size_t sumPrims = 0;
     size_t sumBoundsMem = 0;
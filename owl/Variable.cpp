@@ -199,6 +199,31 @@ namespace owl {
     T value;
   };
 
+  /*! Variable type for the compact storage types (half, unorm8,
+      etc); these get set on the host through their "full" type
+      (float, vec3f, etc), and get converted to the compact type on
+      set. setRaw() copies the already-packed binary representation */
+  template<typename T, typename HostT>
+  struct CompactVariableT : public Variable {
+    typedef std::shared_ptr<CompactVariableT<T,HostT>> SP;
+
+    CompactVariableT(const OWLVarDecl *const varDecl)
+      : Variable(varDecl)
+    {}
+    
+    void set(const HostT &value) override { this->value = T(value); }
+    void setRaw(const void *ptr) override { memcpy(&value,ptr,sizeof(value)); }
+
+    /*! writes the device specific representation of the given type */
+    void writeToSBT(uint8_t *sbtEntry,
+                    const DeviceContext::SP &device) const override
+    {
+      memcpy(sbtEntry,&value,sizeof(value));
+    }
+
+    T value;
+  };
+
   /*! Variable type that accepts owl buffer types, and on the
       device-side writes just the raw device pointer into the SBT */
   struct BufferPointerVariable : public Variable {
@@ -508,6 +533,54 @@ namespace owl {
     case OWL_DOUBLE4:
       return std::make_shared<VariableT<vec4d>>(decl);
 
+      // ------------------------------------------------------------------
+      // compact storage types
+      // ------------------------------------------------------------------
+    case OWL_HALF:
+      return std::make_shared<CompactVariableT<half,float>>(decl);
+    case OWL_HALF2:
+      return std::make_shared<CompactVariableT<vec_t<half,2>,vec2f>>(decl);
+    case OWL_HALF3:
+      return std::make_shared<CompactVariableT<vec_t<half,3>,vec3f>>(decl);
+    case OWL_HALF4:
+      return std::make_shared<CompactVariableT<vec_t<half,4>,vec4f>>(decl);
+
+    case OWL_UNORM8:
+      return std::make_shared<CompactVariableT<unorm8,float>>(decl);
+    case OWL_UNORM8_2:
+      return std::make_shared<CompactVariableT<vec_t<unorm8,2>,vec2f>>(decl);
+    case OWL_UNORM8_3:
+      return std::make_shared<CompactVariableT<vec_t<unorm8,3>,vec3f>>(decl);
+    case OWL_UNORM8_4:
+      return std::make_shared<CompactVariableT<vec_t<unorm8,4>,vec4f>>(decl);
+
+    case OWL_SNORM8:
+      return std::make_shared<CompactVariableT<snorm8,float>>(decl);
+    case OWL_SNORM8_2:
+      return std::make_shared<CompactVariableT<vec_t<snorm8,2>,vec2f>>(decl);
+    case OWL_SNORM8_3:
+      return std::make_shared<CompactVariableT<vec_t<snorm8,3>,vec3f>>(decl);
+    case OWL_SNORM8_4:
+      return std::make_shared<CompactVariableT<vec_t<snorm8,4>,vec4f>>(decl);
+
+    case OWL_UNORM16:
+      return std::make_shared<CompactVariableT<unorm16,float>>(decl);
+    case OWL_UNORM16_2:
+      return std::make_shared<CompactVariableT<vec_t<unorm16,2>,vec2f>>(decl);
+    case OWL_UNORM16_3:
+      return std::make_shared<CompactVariableT<vec_t<unorm16,3>,vec3f>>(decl);
+    case OWL_UNORM16_4:
+      return std::make_shared<CompactVariableT<vec_t<unorm16,4>,vec4f>>(decl);
+
+    case OWL_SNORM16:
+      return std::make_shared<CompactVariableT<snorm16,float>>(decl);
+    case OWL_SNORM16_2:
+      return std::make_shared<CompactVariableT<vec_t<snorm16,2>,vec2f>>(decl);
+    case OWL_SNORM16_3:
+      return std::make_shared<CompactVariableT<vec_t<snorm16,3>,vec3f>>(decl);
+    case OWL_SNORM16_4:
+      return std::make_shared<CompactVariableT<vec_t<snorm16,4>,vec4f>>(decl);
+
     case OWL_AFFINE3F:
       return std::make_shared<VariableT<affine3f>>(decl);
       
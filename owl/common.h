@@ -23,6 +23,8 @@
 #include <owl/common/math/vec.h>
 #include <owl/common/math/box.h>
 #include <owl/common/math/AffineSpace.h>
+#include <owl/common/math/half.h>
+#include <owl/common/math/fixedpoint.h>
 
 #include <string.h>
 #include <set>
@@ -60,6 +62,12 @@ namespace owl {
   using owl::common::vec3ul;
   using owl::common::vec4ul;
   
+  using owl::common::half;
+  using owl::common::unorm8;
+  using owl::common::snorm8;
+  using owl::common::unorm16;
+  using owl::common::snorm16;
+  
   using owl::common::box3f;
   using owl::common::linear3f;
   using owl::common::affine3f;
@@ -19,6 +19,20 @@
 #include "owl/common.h"
 #include <cuda_runtime.h>
 
+namespace owl {
+  namespace detail {
+    /*! whether SetActiveGPU currently has a null device (see
+        OWL_NULL_DEVICE) active on this thread; while it does, there
+        is no CUDA device to talk to, so DeviceMemory uses host
+        memory, and CUDA_SYNC_CHECK does nothing */
+    inline bool &activeDeviceIsNull()
+    {
+      static thread_local bool isNull = false;
+      return isNull;
+    }
+  }
+}
+
 #define CUDA_CHECK( call )                                              \
   {                                                                     \
     cudaError_t rc = call;                                              \
@@ -48,15 +62,17 @@
   }
 
 #define CUDA_SYNC_CHECK()                                       \
-  {                                                             \
-    cudaDeviceSynchronize();                                    \
-    cudaError_t rc = cudaGetLastError();                        \
-    if (rc != cudaSuccess) {                                    \
-      fprintf(stderr, "error (%s: line %d): %s\n",              \
-              __FILE__, __LINE__, cudaGetErrorString(rc));      \
-      throw std::runtime_error("fatal cuda error");             \
+  do {                                                          \
+    if (!owl::detail::activeDeviceIsNull()) {                   \
+      cudaDeviceSynchronize();                                  \
+      cudaError_t rc = cudaGetLastError();                      \
+      if (rc != cudaSuccess) {                                  \
+        fprintf(stderr, "error (%s: line %d): %s\n",            \
+                __FILE__, __LINE__, cudaGetErrorString(rc));    \
+        throw std::runtime_error("fatal cuda error");           \
+      }                                                         \
     }                                                           \
-  }
+  } while (0)
 
 
 
@@ -21,6 +21,10 @@
 #include "Triangles.h"
 #include "UserGeom.h"
 #include "InstanceGroup.h"
+#include "RayBatch.h"
+#include "Profiler.h"
+#include "TextureAtlas.h"
+#include <fstream>
 
 #undef OWL_API
 #define OWL_API extern "C" OWL_DLL_EXPORT
@@ -35,21 +39,7 @@ using namespace owl;
 #endif
 
 
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
+
   
   OWL_API OWLContext owlContextCreate(int32_t *requestedDeviceIDs,
                                       int      numRequestedDevices)
@@ -57,7 +47,7 @@ using namespace owl;
     LOG_API_CALL();
     APIContext::SP context = std::make_shared<APIContext>(requestedDeviceIDs,
                                                           numRequestedDevices);
-    LOG("context created...");
+    OWL_LOG_INFO("context created...");
     return (OWLContext)context->createHandle(context);
   }
 
@@ -69,6 +59,64 @@ using namespace owl;
     return context;
   }
 
+  inline bool checkProfilerEnabled()
+  {
+    if (profiler::enabled()) return true;
+    OWL_LOG_WARNING("OWL was built without OWL_ENABLE_PROFILING,"
+                    << " there are no profiling events to report");
+    return false;
+  }
+
+  OWL_API void owlProfilerWriteTrace(const char *fileName)
+  {
+    LOG_API_CALL();
+    assert(fileName);
+    if (!checkProfilerEnabled()) return;
+    profiler::writeChromeTrace(fileName);
+    OWL_LOG_OK("wrote profiler trace to '" << fileName << "'");
+  }
+
+  OWL_API void owlProfilerPrintSummary(void)
+  {
+    LOG_API_CALL();
+    if (!checkProfilerEnabled()) return;
+    profiler::printSummary(std::cout);
+  }
+
+  OWL_API void owlProfilerReset(void)
+  {
+    LOG_API_CALL();
+    profiler::reset();
+  }
+
+  OWL_API void owlLogSetLevel(OWLLogLevel level)
+  {
+    LOG_API_CALL();
+    Logger::setLevel(level);
+  }
+
+  OWL_API void owlLogSetFile(const char *fileName)
+  {
+    LOG_API_CALL();
+    Logger::get().setSink(fileName
+                          ? std::make_shared<FileLogSink>(fileName)
+                          : LogSink::SP());
+  }
+
+  OWL_API void owlLogSetCallback(OWLLogCallback callback, void *userData)
+  {
+    LOG_API_CALL();
+    Logger::get().setSink(callback
+                          ? std::make_shared<CallbackLogSink>(callback,userData)
+                          : LogSink::SP());
+  }
+
+  OWL_API void owlLogFlush(void)
+  {
+    LOG_API_CALL();
+    Logger::get().flush();
+  }
+
   /* return the cuda stream associated with the given device. */
   OWL_API CUstream owlContextGetStream(OWLContext _context, int deviceID)
   {
@@ -76,6 +124,84 @@ using namespace owl;
     return checkGet(_context)->getDevice(deviceID)->getStream();
   }
 
+  static MemoryTracker &memoryTrackerOf(APIContext::SP context, int deviceID)
+  {
+    if (deviceID < 0 || deviceID >= (int)context->deviceCount())
+      throw std::runtime_error("#owl: invalid device ID "+std::to_string(deviceID));
+    return context->getDevice(deviceID)->memoryTracker;
+  }
+
+  OWL_API void owlContextGetMemoryUsage(OWLContext _context,
+                                        int deviceID,
+                                        OWLMemoryCategory category,
+                                        size_t *p_current,
+                                        size_t *p_peak)
+  {
+    LOG_API_CALL();
+    MemoryTracker &tracker = memoryTrackerOf(checkGet(_context),deviceID);
+    if (p_current) *p_current = tracker.current(category);
+    if (p_peak)    *p_peak    = tracker.peak(category);
+  }
+
+  OWL_API void owlContextResetMemoryPeaks(OWLContext _context)
+  {
+    LOG_API_CALL();
+    for (auto device : checkGet(_context)->getDevices())
+      device->memoryTracker.resetPeaks();
+  }
+
+  OWL_API void owlContextSetMemoryBudget(OWLContext _context,
+                                         int deviceID,
+                                         size_t maxBytes)
+  {
+    LOG_API_CALL();
+    APIContext::SP context = checkGet(_context);
+    if (deviceID == -1)
+      for (auto device : context->getDevices())
+        device->memoryTracker.setBudget(maxBytes);
+    else
+      memoryTrackerOf(context,deviceID).setBudget(maxBytes);
+  }
+
+  OWL_API void owlContextWriteMemoryReport(OWLContext _context,
+                                           const char *fileName)
+  {
+    LOG_API_CALL();
+    assert(fileName);
+    std::ofstream out(fileName);
+    if (!out)
+      throw std::runtime_error("#owl: could not open '"+std::string(fileName)
+                               +"' for writing");
+    out << checkGet(_context)->memoryReportJSON();
+    OWL_LOG_OK("wrote memory report to '" << fileName << "'");
+  }
+
+  OWL_API void owlContextSetMemoryCacheSize(OWLContext _context,
+                                            size_t maxCachedBytes)
+  {
+    LOG_API_CALL();
+    for (auto device : checkGet(_context)->getDevices()) {
+      CachingAllocator::SP pool
+        = std::dynamic_pointer_cast<CachingAllocator>(device->allocator);
+      if (!pool)
+        OWL_LOG_WARNING("device #" << device->ID << " doesn't use a caching "
+                        << "allocator; ignoring owlContextSetMemoryCacheSize()");
+      else {
+        SetActiveGPU forLifeTime(device);
+        pool->setMaxCachedBytes(maxCachedBytes);
+      }
+    }
+  }
+
+  OWL_API void owlContextReleaseCachedMemory(OWLContext _context)
+  {
+    LOG_API_CALL();
+    for (auto device : checkGet(_context)->getDevices()) {
+      SetActiveGPU forLifeTime(device);
+      device->allocator->releaseCached();
+    }
+  }
+
   /* return the optix context associated with the given device. */
   OWL_API OptixDeviceContext owlContextGetOptixContext(OWLContext _context, int deviceID)
   {
@@ -541,6 +667,7 @@ using namespace owl;
     LOG_API_CALL();
     APIContext::SP context = checkGet(_context);
     context->releaseAll();
+    Logger::get().flush();
   }
 
   /*! creates a device buffer where every device has its own local
@@ -592,6 +719,106 @@ using namespace owl;
     return (OWLTexture)context->createHandle(texture);
   }
 
+  OWL_API OWLTexture
+  owlTexture2DCreateMipmapped(OWLContext _context,
+                              OWLTexelFormat texelFormat,
+                              uint32_t size_x,
+                              uint32_t size_y,
+                              const void **levels,
+                              uint32_t numLevels,
+                              OWLMipmapFilter mipmapFilter,
+                              OWLTextureFilterMode filterMode,
+                              OWLTextureAddressMode addressMode,
+                              OWLTextureColorSpace colorSpace)
+  {
+    LOG_API_CALL();
+    APIContext::SP context = checkGet(_context);
+    Texture::SP  texture
+      = context->texture2DCreateMipmapped(texelFormat,
+                                          mipmapFilter,
+                                          filterMode,
+                                          addressMode,
+                                          colorSpace,
+                                          vec2i(size_x,size_y),
+                                          levels,
+                                          numLevels);
+    assert(texture);
+    return (OWLTexture)context->createHandle(texture);
+  }
+
+  OWL_API OWLTexture
+  owlTexture2DCreateCompressed(OWLContext _context,
+                               OWLTexelFormat compressedFormat,
+                               uint32_t size_x,
+                               uint32_t size_y,
+                               const void *rgba8Texels,
+                               OWLTextureFilterMode filterMode,
+                               OWLTextureAddressMode addressMode,
+                               OWLTextureColorSpace colorSpace,
+                               uint32_t linePitchInBytes)
+  {
+    LOG_API_CALL();
+    APIContext::SP context = checkGet(_context);
+    Texture::SP texture
+      = context->texture2DCreateCompressed(compressedFormat,
+                                           filterMode,
+                                           addressMode,
+                                           colorSpace,
+                                           vec2i(size_x,size_y),
+                                           linePitchInBytes,
+                                           rgba8Texels);
+    assert(texture);
+    return (OWLTexture)context->createHandle(texture);
+  }
+
+  OWL_API int
+  owlTextureAtlasCreate(OWLContext _context,
+                        OWLTexelFormat texelFormat,
+                        uint32_t numTextures,
+                        const owl2i *sizes,
+                        const void **texels,
+                        OWLTexture *atlases,
+                        OWLTextureAtlasPlacement *placements,
+                        uint32_t maxAtlasSize,
+                        uint32_t gutter,
+                        OWLTextureFilterMode filterMode,
+                        OWLTextureColorSpace colorSpace)
+  {
+    LOG_API_CALL();
+    APIContext::SP context = checkGet(_context);
+    assert(sizes && texels && atlases && placements);
+
+    std::vector<atlas::Input> inputs(numTextures);
+    for (uint32_t i=0;i<numTextures;i++) {
+      inputs[i].size   = (const vec2i&)sizes[i];
+      inputs[i].texels = texels[i];
+    }
+    const atlas::Result result
+      = atlas::build(texelFormat,inputs,maxAtlasSize,gutter);
+    
+    for (size_t a=0;a<result.atlases.size();a++) {
+      const atlas::Atlas &atlas = result.atlases[a];
+      Texture::SP texture
+        = context->texture2DCreate(texelFormat,
+                                   filterMode,
+                                   OWL_TEXTURE_CLAMP,
+                                   colorSpace,
+                                   atlas.size,
+                                   0,
+                                   atlas.texels.data());
+      atlases[a] = (OWLTexture)context->createHandle(texture);
+      OWL_LOG_INFO("texture atlas #" << a << ": " << atlas.size.x << "x" << atlas.size.y
+                   << ", " << int(100.f*atlas.occupancy) << "% occupied");
+    }
+    for (uint32_t i=0;i<numTextures;i++) {
+      const atlas::Placement &placement = result.placements[i];
+      placements[i].atlasID  = placement.atlasID;
+      placements[i].uvScale  = (const owl2f&)placement.uvTransform.scale;
+      placements[i].uvOffset = (const owl2f&)placement.uvTransform.offset;
+    }
+    return (int)result.atlases.size();
+  }
+
   OWL_API CUtexObject
   owlTextureGetObject(OWLTexture _texture, int deviceID)
   {
@@ -618,7 +845,9 @@ using namespace owl;
     assert(texture);
     texture->destroy();
 
-    handle->clear();
+    // not just clear()'ed, else the context still lists it, and trips
+    // over its missing object when it gets destroyed
+    delete handle;
   }
 
   /*! creates a buffer that uses CUDA host pinned memory; that memory is
@@ -959,6 +1188,7 @@ using namespace owl;
     assert(group);
     
     group->buildAccel();
+    group->hostAccel = nullptr;
   }  
 
   /*! returns the (device) memory used for this group's acceleration
@@ -998,8 +1228,57 @@ using namespace owl;
     assert(group);
     
     group->refitAccel();
+    group->hostAccel = nullptr;
   }  
 
+  OWL_API void owlGroupTraceRays(OWLGroup _group,
+                                 OWLBuffer _rays,
+                                 OWLBuffer _hits,
+                                 size_t numRays,
+                                 uint32_t flags)
+  {
+    LOG_API_CALL();
+
+    assert(_group);
+    assert(_rays);
+    assert(_hits);
+
+    Group::SP group
+      = ((APIHandle *)_group)->get<Group>();
+    assert(group);
+
+    Buffer::SP rays
+      = ((APIHandle *)_rays)->get<Buffer>();
+    assert(rays);
+
+    Buffer::SP hits
+      = ((APIHandle *)_hits)->get<Buffer>();
+    assert(hits);
+
+    if (numRays == 0) return;
+    traceRayBatch(group,rays,hits,numRays,flags);
+  }
+
+  OWL_API void owlGroupTraceRaysOnHost(OWLGroup _group,
+                                       const OWLBatchRay *rays,
+                                       OWLBatchHit *hits,
+                                       size_t numRays,
+                                       uint32_t flags)
+  {
+    LOG_API_CALL();
+
+    assert(_group);
+
+    Group::SP group
+      = ((APIHandle *)_group)->get<Group>();
+    assert(group);
+
+    if (numRays == 0) return;
+    assert(rays);
+    assert(hits);
+    traceRayBatchOnHost(group,rays,hits,numRays,flags);
+  }
+
   OWL_API void
   owlTrianglesSetIndices(OWLGeom   _triangles,
                          OWLBuffer _buffer,
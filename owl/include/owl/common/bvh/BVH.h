@@ -0,0 +1,598 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/bvh/BVH.h A host-side binary BVH over primitive
+    bounding boxes, for spatial queries on the CPU (picking,
+    clustering, proximity tests, validating renders, ...).
+
+    The BVH only knows about the prims' boxes: nodes are 32 bytes
+    (bounds plus two ints), the two children of an inner node are
+    stored next to each other, and leaves refer to a range of
+    BVH::primIDs.
+
+    The builder is a binned SAH builder that works breadth first, one
+    level of the tree at a time: all nodes of a level get split in
+    parallel, except for the (few) large ones near the root, which
+    each get binned in parallel instead.
+
+    Host only; do not include this from device code. */
+
+#pragma once
+
+#include "owl/common/math/box.h"
+#include "owl/common/parallel/parallel_for.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && !defined(__CUDACC__)
+# include <emmintrin.h>
+# define OWL_HAVE_SSE2_BVH 1
+#endif
+
+namespace owl {
+  namespace common {
+
+    /*! a node of a binary BVH */
+    struct BVHNode {
+      vec3f    lower;
+      /*! for inner nodes, the index of the first of the two
+          (adjacent) children; for leaves, the index of the leaf's
+          first prim in BVH::primIDs */
+      uint32_t offset;
+      vec3f    upper;
+      /*! number of prims in a leaf; 0 for inner nodes */
+      uint32_t count;
+
+      inline bool  isLeaf() const { return count != 0; }
+      inline box3f bounds() const { return box3f(lower,upper); }
+      inline void  setBounds(const box3f &b) { lower = b.lower; upper = b.upper; }
+    };
+
+    struct BVHBuildConfig {
+      /*! nodes with more prims than this always get split */
+      int   maxLeafSize      = 8;
+      /*! number of bins per axis, at most BVH_MAX_BINS */
+      int   numBins          = 16;
+      /*! SAH cost of traversing a node, and of intersecting a prim */
+      float traversalCost    = 1.f;
+      float intersectionCost = 1.f;
+    };
+
+    struct BVH {
+      /*! (re-)builds the BVH over the given prim bounds; prims must
+          have non-empty bounds */
+      inline void build(const box3f *primBounds, size_t numPrims,
+                        const BVHBuildConfig &config = BVHBuildConfig());
+
+      /*! updates all node bounds for prims that moved (the prims
+          have to be the same ones the BVH was built over), without
+          changing the tree's topology. Quality degrades the more the
+          prims moved relative to each other, at some point a
+          re-build is the better option */
+      inline void refit(const box3f *primBounds);
+
+      /*! expected cost of a random ray traversing the BVH (relative
+          to the root's surface area), under the given cost model */
+      inline float sahCost(const BVHBuildConfig &config = BVHBuildConfig()) const;
+
+      inline size_t numLeaves() const;
+      inline int    depth() const;
+      inline size_t sizeInBytes() const
+      { return nodes.size()*sizeof(BVHNode) + primIDs.size()*sizeof(uint32_t); }
+
+      /*! calls 'fct(primID)' for each prim in a leaf that overlaps
+          'queryBox'; as the BVH doesn't know the prims' own bounds,
+          'fct' still has to check those if it needs an exact
+          answer */
+      template<typename Fct>
+      inline void forEachLeafPrimOverlapping(const box3f &queryBox, const Fct &fct) const;
+
+      inline box3f bounds() const
+      { return nodes.empty() ? box3f() : nodes[0].bounds(); }
+
+      /*! nodes[0] is the root */
+      std::vector<BVHNode>  nodes;
+      std::vector<uint32_t> primIDs;
+    };
+
+    enum { BVH_MAX_BINS = 32 };
+
+    namespace bvh_detail {
+
+      enum {
+        /*! ranges with more prims than this get binned in parallel */
+        PARALLEL_BINNING_THRESHOLD = 32*1024,
+        /*! number of prims per parallel binning task */
+        BINNING_CHUNK_SIZE = 8*1024
+      };
+
+      /*! half the surface area; zero for empty boxes */
+      inline float halfArea(const box3f &b)
+      {
+        if (b.empty()) return 0.f;
+        const vec3f d = b.span();
+        return d.x*d.y + d.y*d.z + d.z*d.x;
+      }
+
+      /*! a prim's bounds and ID; the builder partitions these in
+          place (rather than just the IDs), so binning always walks
+          memory linearly instead of gathering each prim's bounds.
+          Laid out like a BVHNode, so either half loads as one
+          4-wide vector */
+      struct PrimRef {
+        vec3f    lower;
+        uint32_t primID;
+        vec3f    upper;
+        uint32_t pad;
+
+        inline vec3f centroid() const { return (lower+upper)*.5f; }
+        inline box3f bounds() const { return box3f(lower,upper); }
+      };
+
+      struct Bin {
+        box3f    bounds;
+        box3f    centroidBounds;
+        uint32_t count = 0;
+
+        inline void extend(const Bin &other)
+        {
+          bounds.extend(other.bounds);
+          centroidBounds.extend(other.centroidBounds);
+          count += other.count;
+        }
+      };
+
+      /*! maps centroids to bins, per axis */
+      struct BinMapping {
+        BinMapping(const box3f &centroidBounds, int numBins)
+          : numBins(numBins), lower(centroidBounds.lower)
+        {
+          const vec3f extent = centroidBounds.span();
+          for (int axis=0;axis<3;axis++)
+            scale[axis] = extent[axis] > 0.f ? (numBins*.99999f)/extent[axis] : 0.f;
+        }
+
+        /*! clamps before converting to int, exactly like the SSE
+            path in Binning::add() does, so binning and partitioning
+            always agree on which bin a prim is in */
+        inline int binOf(const vec3f &centroid, int axis) const
+        {
+          const float bin = (centroid[axis]-lower[axis])*scale[axis];
+          return int(std::min(std::max(bin,0.f),float(numBins-1)));
+        }
+
+        int   numBins;
+        vec3f lower;
+        vec3f scale;
+      };
+
+      /*! per-axis bins; the bounds are stored as (x,y,z,unused)
+          vectors, so the SSE path can update them with a single
+          min/max each, and only the bins in use get initialized */
+      struct Binning {
+        Binning(int numBins) : numBins(numBins)
+        {
+          const float inf = std::numeric_limits<float>::infinity();
+          for (int axis=0;axis<3;axis++)
+            for (int i=0;i<numBins;i++) {
+              for (int k=0;k<4;k++) {
+                lower[axis][i][k] = centroidLower[axis][i][k] = +inf;
+                upper[axis][i][k] = centroidUpper[axis][i][k] = -inf;
+              }
+              count[axis][i] = 0;
+            }
+        }
+
+        inline void add(const BinMapping &mapping, const PrimRef &prim);
+        inline void merge(const Binning &other);
+        inline void extendBounds(box3f &bounds, int axis, int i) const
+        {
+          bounds.extend(box3f(vec3f(lower[axis][i][0],lower[axis][i][1],lower[axis][i][2]),
+                              vec3f(upper[axis][i][0],upper[axis][i][1],upper[axis][i][2])));
+        }
+        inline Bin  bin(int axis, int i) const
+        {
+          Bin bin;
+          bin.bounds.lower = vec3f(lower[axis][i][0],lower[axis][i][1],lower[axis][i][2]);
+          bin.bounds.upper = vec3f(upper[axis][i][0],upper[axis][i][1],upper[axis][i][2]);
+          bin.centroidBounds.lower
+            = vec3f(centroidLower[axis][i][0],centroidLower[axis][i][1],centroidLower[axis][i][2]);
+          bin.centroidBounds.upper
+            = vec3f(centroidUpper[axis][i][0],centroidUpper[axis][i][1],centroidUpper[axis][i][2]);
+          bin.count = count[axis][i];
+          return bin;
+        }
+
+        int      numBins;
+        float    lower[3][BVH_MAX_BINS][4];
+        float    upper[3][BVH_MAX_BINS][4];
+        float    centroidLower[3][BVH_MAX_BINS][4];
+        float    centroidUpper[3][BVH_MAX_BINS][4];
+        uint32_t count[3][BVH_MAX_BINS];
+      };
+
+#if OWL_HAVE_SSE2_BVH
+      inline void Binning::add(const BinMapping &mapping, const PrimRef &prim)
+      {
+        // the w lanes hold primID/pad bits, which must not leak into
+        // any arithmetic (they might be denormals)
+        const __m128 xyz  = _mm_castsi128_ps(_mm_set_epi32(0,-1,-1,-1));
+        const __m128 lo   = _mm_and_ps(_mm_loadu_ps(&prim.lower.x),xyz);
+        const __m128 hi   = _mm_and_ps(_mm_loadu_ps(&prim.upper.x),xyz);
+        const __m128 c    = _mm_mul_ps(_mm_add_ps(lo,hi),_mm_set1_ps(.5f));
+        const __m128 binF
+          = _mm_mul_ps(_mm_sub_ps(c,_mm_setr_ps(mapping.lower.x,mapping.lower.y,mapping.lower.z,0.f)),
+                       _mm_setr_ps(mapping.scale.x,mapping.scale.y,mapping.scale.z,0.f));
+        const __m128 clamped
+          = _mm_min_ps(_mm_max_ps(binF,_mm_setzero_ps()),_mm_set1_ps(float(numBins-1)));
+        alignas(16) int32_t binID[4];
+        _mm_store_si128((__m128i*)binID,_mm_cvttps_epi32(clamped));
+        for (int axis=0;axis<3;axis++) {
+          const int i = binID[axis];
+          _mm_storeu_ps(lower[axis][i],_mm_min_ps(_mm_loadu_ps(lower[axis][i]),lo));
+          _mm_storeu_ps(upper[axis][i],_mm_max_ps(_mm_loadu_ps(upper[axis][i]),hi));
+          _mm_storeu_ps(centroidLower[axis][i],_mm_min_ps(_mm_loadu_ps(centroidLower[axis][i]),c));
+          _mm_storeu_ps(centroidUpper[axis][i],_mm_max_ps(_mm_loadu_ps(centroidUpper[axis][i]),c));
+          count[axis][i]++;
+        }
+      }
+#else
+      inline void Binning::add(const BinMapping &mapping, const PrimRef &prim)
+      {
+        const vec3f c = prim.centroid();
+        for (int axis=0;axis<3;axis++) {
+          const int i = mapping.binOf(c,axis);
+          for (int k=0;k<3;k++) {
+            lower[axis][i][k] = std::min(lower[axis][i][k],prim.lower[k]);
+            upper[axis][i][k] = std::max(upper[axis][i][k],prim.upper[k]);
+            centroidLower[axis][i][k] = std::min(centroidLower[axis][i][k],c[k]);
+            centroidUpper[axis][i][k] = std::max(centroidUpper[axis][i][k],c[k]);
+          }
+          count[axis][i]++;
+        }
+      }
+#endif
+
+      inline void Binning::merge(const Binning &other)
+      {
+        for (int axis=0;axis<3;axis++)
+          for (int i=0;i<numBins;i++) {
+            for (int k=0;k<4;k++) {
+              lower[axis][i][k] = std::min(lower[axis][i][k],other.lower[axis][i][k]);
+              upper[axis][i][k] = std::max(upper[axis][i][k],other.upper[axis][i][k]);
+              centroidLower[axis][i][k]
+                = std::min(centroidLower[axis][i][k],other.centroidLower[axis][i][k]);
+              centroidUpper[axis][i][k]
+                = std::max(centroidUpper[axis][i][k],other.centroidUpper[axis][i][k]);
+            }
+            count[axis][i] += other.count[axis][i];
+          }
+      }
+
+      /*! a node that still needs to be split (or turned into a leaf),
+          along with the range of prims it covers */
+      struct BuildRange {
+        uint32_t nodeID;
+        uint32_t begin, end;
+        box3f    centroidBounds;
+      };
+
+      /*! what happens to a BuildRange: either it becomes a leaf, or
+          its prims got partitioned into [begin,mid) and [mid,end) */
+      struct SplitResult {
+        bool     isLeaf = true;
+        uint32_t mid;
+        Bin      left, right;
+      };
+
+      /*! builds the BVH; only lives for the duration of BVH::build() */
+      struct Builder {
+        Builder(BVH &bvh, const box3f *primBounds, size_t numPrims,
+                const BVHBuildConfig &config)
+          : bvh(bvh), primBounds(primBounds), numPrims(numPrims),
+            config(config), prims(numPrims)
+        {
+          this->config.numBins = std::max(2,std::min(int(BVH_MAX_BINS),config.numBins));
+          this->config.maxLeafSize = std::max(1,config.maxLeafSize);
+        }
+
+        inline void build();
+
+        inline void binRange(Binning &binning, const BuildRange &range,
+                             const BinMapping &mapping) const;
+        inline SplitResult splitRange(const BuildRange &range);
+        inline void splitInTheMiddle(const BuildRange &range, SplitResult &result) const;
+
+        BVH                 &bvh;
+        const box3f   *const primBounds;
+        const size_t         numPrims;
+        BVHBuildConfig       config;
+        std::vector<PrimRef> prims;
+      };
+
+      inline void Builder::binRange(Binning &binning, const BuildRange &range,
+                                    const BinMapping &mapping) const
+      {
+        const size_t count = range.end - range.begin;
+        if (count <= PARALLEL_BINNING_THRESHOLD) {
+          for (uint32_t i=range.begin;i<range.end;i++)
+            binning.add(mapping,prims[i]);
+          return;
+        }
+
+        const size_t numChunks = (count+BINNING_CHUNK_SIZE-1)/BINNING_CHUNK_SIZE;
+        std::vector<Binning> chunkBinnings(numChunks,Binning(mapping.numBins));
+        parallel_for(numChunks,[&](size_t chunk){
+            const size_t begin = range.begin + chunk*BINNING_CHUNK_SIZE;
+            const size_t end   = std::min(begin+BINNING_CHUNK_SIZE,size_t(range.end));
+            for (size_t i=begin;i<end;i++)
+              chunkBinnings[chunk].add(mapping,prims[i]);
+          });
+        for (size_t chunk=0;chunk<numChunks;chunk++)
+          binning.merge(chunkBinnings[chunk]);
+      }
+
+      /*! fallback for when binning can't separate the prims (eg, all
+          centroids are the same): split the range in half */
+      inline void Builder::splitInTheMiddle(const BuildRange &range,
+                                            SplitResult &result) const
+      {
+        result.isLeaf = false;
+        result.mid    = (range.begin+range.end)/2;
+        result.left   = Bin();
+        result.right  = Bin();
+        for (uint32_t i=range.begin;i<range.end;i++) {
+          Bin &side = i < result.mid ? result.left : result.right;
+          side.bounds.extend(prims[i].bounds());
+          side.centroidBounds.extend(prims[i].centroid());
+          side.count++;
+        }
+      }
+
+      inline SplitResult Builder::splitRange(const BuildRange &range)
+      {
+        SplitResult result;
+        const uint32_t count = range.end - range.begin;
+        if (count == 1)
+          return result;
+
+        // small ranges don't need as many bins as there are prims
+        const int numBins = std::min(config.numBins,int(std::max(count,4u)));
+        const BinMapping mapping(range.centroidBounds,numBins);
+        Binning binning(numBins);
+        binRange(binning,range,mapping);
+
+        // sweep over all split planes of all axes; 'rightCost[i]' is
+        // the (unscaled) cost of everything in bins i and up
+        const float leafCost = config.intersectionCost*count;
+        float bestCost = std::numeric_limits<float>::infinity();
+        int   bestAxis = -1, bestBin = -1;
+        for (int axis=0;axis<3;axis++) {
+          if (mapping.scale[axis] == 0.f) continue;
+          float    rightCost[BVH_MAX_BINS];
+          box3f    right;
+          uint32_t rightCount = 0;
+          for (int i=numBins-1;i>0;--i) {
+            binning.extendBounds(right,axis,i);
+            rightCount  += binning.count[axis][i];
+            rightCost[i] = halfArea(right)*rightCount;
+          }
+          box3f    left;
+          uint32_t leftCount = 0;
+          for (int i=1;i<numBins;i++) {
+            binning.extendBounds(left,axis,i-1);
+            leftCount += binning.count[axis][i-1];
+            if (leftCount == 0 || leftCount == count) continue;
+            const float cost = halfArea(left)*leftCount + rightCost[i];
+            if (cost < bestCost) {
+              bestCost = cost;
+              bestAxis = axis;
+              bestBin  = i;
+            }
+          }
+        }
+
+        const float parentArea = halfArea(bvh.nodes[range.nodeID].bounds());
+        const float splitCost
+          = bestAxis < 0 ? std::numeric_limits<float>::infinity()
+          : config.traversalCost
+          + config.intersectionCost*(parentArea > 0.f ? bestCost/parentArea : float(count));
+        if (count <= uint32_t(config.maxLeafSize) && leafCost <= splitCost)
+          return result;
+
+        if (bestAxis < 0) {
+          splitInTheMiddle(range,result);
+          return result;
+        }
+
+        result.isLeaf = false;
+        for (int i=0;i<numBins;i++)
+          (i < bestBin ? result.left : result.right).extend(binning.bin(bestAxis,i));
+        PrimRef *begin = prims.data()+range.begin;
+        PrimRef *end   = prims.data()+range.end;
+        result.mid = uint32_t(std::partition(begin,end,[&](const PrimRef &prim){
+              return mapping.binOf(prim.centroid(),bestAxis) < bestBin;
+            }) - prims.data());
+        return result;
+      }
+
+      inline void Builder::build()
+      {
+        bvh.nodes.clear();
+        bvh.primIDs.resize(numPrims);
+        if (numPrims == 0) return;
+
+        // prim refs, and the root's bounds, in parallel chunks
+        const size_t numChunks = (numPrims+BINNING_CHUNK_SIZE-1)/BINNING_CHUNK_SIZE;
+        std::vector<Bin> chunkBounds(numChunks);
+        parallel_for(numChunks,[&](size_t chunk){
+            const size_t begin = chunk*BINNING_CHUNK_SIZE;
+            const size_t end   = std::min(begin+BINNING_CHUNK_SIZE,numPrims);
+            for (size_t i=begin;i<end;i++) {
+              prims[i] = { primBounds[i].lower, uint32_t(i), primBounds[i].upper, 0 };
+              chunkBounds[chunk].bounds.extend(primBounds[i]);
+              chunkBounds[chunk].centroidBounds.extend(prims[i].centroid());
+            }
+          });
+        Bin root;
+        for (const Bin &chunk : chunkBounds)
+          root.extend(chunk);
+
+        bvh.nodes.reserve(2*numPrims);
+        bvh.nodes.resize(1);
+        bvh.nodes[0].setBounds(root.bounds);
+
+        std::vector<BuildRange> level;
+        level.push_back({0,0,uint32_t(numPrims),root.centroidBounds});
+        std::vector<BuildRange> nextLevel;
+        std::vector<SplitResult> results;
+        while (!level.empty()) {
+          results.resize(level.size());
+          // large ranges bin in parallel, so do those one at a time ...
+          for (size_t i=0;i<level.size();i++)
+            if (level[i].end-level[i].begin > PARALLEL_BINNING_THRESHOLD)
+              results[i] = splitRange(level[i]);
+          // ... and all the small ones in parallel
+          parallel_for_blocked(0,level.size(),64,[&](size_t begin, size_t end){
+              for (size_t i=begin;i<end;i++)
+                if (level[i].end-level[i].begin <= PARALLEL_BINNING_THRESHOLD)
+                  results[i] = splitRange(level[i]);
+            });
+
+          nextLevel.clear();
+          for (size_t i=0;i<level.size();i++) {
+            const BuildRange  &range  = level[i];
+            const SplitResult &result = results[i];
+            BVHNode &node = bvh.nodes[range.nodeID];
+            if (result.isLeaf) {
+              node.offset = range.begin;
+              node.count  = range.end-range.begin;
+              continue;
+            }
+            const uint32_t childID = uint32_t(bvh.nodes.size());
+            node.offset = childID;
+            node.count  = 0;
+            bvh.nodes.resize(childID+2);
+            bvh.nodes[childID+0].setBounds(result.left.bounds);
+            bvh.nodes[childID+1].setBounds(result.right.bounds);
+            nextLevel.push_back({childID+0,range.begin,result.mid,result.left.centroidBounds});
+            nextLevel.push_back({childID+1,result.mid,range.end,result.right.centroidBounds});
+          }
+          level.swap(nextLevel);
+        }
+
+        parallel_for_blocked(0,numPrims,16*1024,[&](size_t begin, size_t end){
+            for (size_t i=begin;i<end;i++)
+              bvh.primIDs[i] = prims[i].primID;
+          });
+      }
+
+    } // ::owl::common::bvh_detail
+
+    inline void BVH::build(const box3f *primBounds, size_t numPrims,
+                           const BVHBuildConfig &config)
+    {
+      bvh_detail::Builder(*this,primBounds,numPrims,config).build();
+    }
+
+    inline void BVH::refit(const box3f *primBounds)
+    {
+      // leaves in parallel ...
+      parallel_for_blocked(0,nodes.size(),4*1024,[&](size_t begin, size_t end){
+          for (size_t nodeID=begin;nodeID<end;nodeID++) {
+            BVHNode &node = nodes[nodeID];
+            if (!node.isLeaf()) continue;
+            box3f bounds;
+            for (uint32_t i=0;i<node.count;i++)
+              bounds.extend(primBounds[primIDs[node.offset+i]]);
+            node.setBounds(bounds);
+          }
+        });
+      // ... then inner nodes bottom up; children always come after
+      // their parent
+      for (size_t nodeID=nodes.size();nodeID-- > 0;) {
+        BVHNode &node = nodes[nodeID];
+        if (node.isLeaf()) continue;
+        node.setBounds(nodes[node.offset].bounds()
+                       .including(nodes[node.offset+1].bounds()));
+      }
+    }
+
+    inline float BVH::sahCost(const BVHBuildConfig &config) const
+    {
+      if (nodes.empty()) return 0.f;
+      const float rootArea = bvh_detail::halfArea(nodes[0].bounds());
+      if (rootArea == 0.f) return config.intersectionCost*primIDs.size();
+      double cost = 0.;
+      for (const BVHNode &node : nodes)
+        cost
+          += bvh_detail::halfArea(node.bounds())
+          *  (node.isLeaf() ? config.intersectionCost*node.count : config.traversalCost);
+      return float(cost/rootArea);
+    }
+
+    inline size_t BVH::numLeaves() const
+    {
+      size_t count = 0;
+      for (const BVHNode &node : nodes)
+        if (node.isLeaf()) count++;
+      return count;
+    }
+
+    inline int BVH::depth() const
+    {
+      if (nodes.empty()) return 0;
+      // as children come after their parents, a single forward pass
+      // is enough to get every node's depth
+      std::vector<int> nodeDepth(nodes.size(),1);
+      int maxDepth = 1;
+      for (size_t nodeID=0;nodeID<nodes.size();nodeID++) {
+        const BVHNode &node = nodes[nodeID];
+        maxDepth = std::max(maxDepth,nodeDepth[nodeID]);
+        if (node.isLeaf()) continue;
+        nodeDepth[node.offset+0] = nodeDepth[nodeID]+1;
+        nodeDepth[node.offset+1] = nodeDepth[nodeID]+1;
+      }
+      return maxDepth;
+    }
+
+    template<typename Fct>
+    inline void BVH::forEachLeafPrimOverlapping(const box3f &queryBox,
+                                                const Fct &fct) const
+    {
+      if (nodes.empty() || !nodes[0].bounds().overlaps(queryBox)) return;
+      // SAH trees can get deep for badly distributed prims, so don't
+      // use a fixed-size stack
+      std::vector<uint32_t> stack;
+      stack.reserve(64);
+      stack.push_back(0);
+      while (!stack.empty()) {
+        const BVHNode &node = nodes[stack.back()];
+        stack.pop_back();
+        if (node.isLeaf()) {
+          for (uint32_t i=0;i<node.count;i++)
+            fct(primIDs[node.offset+i]);
+          continue;
+        }
+        for (int c=0;c<2;c++)
+          if (nodes[node.offset+c].bounds().overlaps(queryBox))
+            stack.push_back(node.offset+c);
+      }
+    }
+
+  } // ::owl::common
+} // ::owl
@@ -0,0 +1,393 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/bvh/BVHTraversal.h Closest-hit and any-hit ray
+    traversal of a (host-side) BVH, for single rays and for 8-wide
+    packets, using the kernels in owl/common/math/rayKernels.h.
+
+    What the prims are is up to the caller, who passes a lambda that
+    intersects one of them:
+
+      single rays: bool intersectPrim(int primID, HostRay &ray, HostHit &hit)
+      packets:     int  intersectPrim(int primID, RayPacket8 &rays,
+                                      HitPacket8 &hits, int activeMask)
+
+    On a hit closer than ray.tmax, these have to shrink tmax, fill in
+    the hit, and return true (or the mask of lanes that hit), exactly
+    like the triangle kernels in rayKernels.h do. Any-hit traversal
+    uses the same lambdas (on copies of the rays), and stops at the
+    first hit.
+
+    Packet traversal uses AVX2 if the CPU has it; otherwise it traces
+    each of the packet's rays on its own.
+
+    Host only; do not include this from device code. */
+
+#pragma once
+
+#include "owl/common/bvh/BVH.h"
+#include "owl/common/math/rayKernels.h"
+
+namespace owl {
+  namespace common {
+
+    namespace detail {
+
+      /*! traversal stack that lives on the (call) stack unless the
+          BVH is unusually deep */
+      template<typename T>
+      struct TraversalStack {
+        inline bool empty() const { return size == 0; }
+        inline void push(const T &t)
+        {
+          if (size < LOCAL_SIZE)
+            local[size] = t;
+          else
+            overflow.push_back(t);
+          ++size;
+        }
+        inline T pop()
+        {
+          --size;
+          if (size < LOCAL_SIZE) return local[size];
+          const T t = overflow.back();
+          overflow.pop_back();
+          return t;
+        }
+
+        enum { LOCAL_SIZE = 64 };
+        T              local[LOCAL_SIZE];
+        std::vector<T> overflow;
+        int            size = 0;
+      };
+
+      struct RayStackEntry {
+        uint32_t nodeID;
+        float    tNear;
+      };
+
+    } // ::owl::common::detail
+
+    /*! finds the closest hit along the ray; returns true if there was
+        any, with ray.tmax and 'hit' describing it */
+    template<typename IntersectPrim>
+    inline bool traceClosest(const BVH &bvh, HostRay &ray, HostHit &hit,
+                             const IntersectPrim &intersectPrim)
+    {
+      if (bvh.nodes.empty()) return false;
+      const RayBoxTest boxTest(ray);
+      detail::RayStackEntry current = { 0, 0.f };
+      if (!intersectBox(boxTest,bvh.nodes[0].bounds(),ray.tmin,ray.tmax,current.tNear))
+        return false;
+
+      bool found = false;
+      detail::TraversalStack<detail::RayStackEntry> stack;
+      while (true) {
+        // nodes on the stack may have become farther away than the
+        // closest hit found since they got pushed
+        if (current.tNear <= ray.tmax) {
+          const BVHNode &node = bvh.nodes[current.nodeID];
+          if (node.isLeaf()) {
+            for (uint32_t i=0;i<node.count;i++)
+              if (intersectPrim(int(bvh.primIDs[node.offset+i]),ray,hit))
+                found = true;
+          } else {
+            const BVHNode &child0 = bvh.nodes[node.offset+0];
+            const BVHNode &child1 = bvh.nodes[node.offset+1];
+            float tNear[2];
+            const int hitMask
+              = intersectBoxPair(boxTest,child0.lower,child0.upper,child1.lower,child1.upper,
+                                 ray.tmin,ray.tmax,tNear);
+            if (hitMask == 3) {
+              const int nearChild = tNear[1] < tNear[0] ? 1 : 0;
+              stack.push({ node.offset+1-nearChild, tNear[1-nearChild] });
+              current = { node.offset+nearChild, tNear[nearChild] };
+              continue;
+            }
+            if (hitMask) {
+              const int child = hitMask >> 1;
+              current = { node.offset+child, tNear[child] };
+              continue;
+            }
+          }
+        }
+        if (stack.empty()) break;
+        current = stack.pop();
+      }
+      return found;
+    }
+
+    /*! returns true if anything at all gets hit in [tmin,tmax) */
+    template<typename IntersectPrim>
+    inline bool traceAny(const BVH &bvh, const HostRay &ray,
+                         const IntersectPrim &intersectPrim)
+    {
+      if (bvh.nodes.empty()) return false;
+      const RayBoxTest boxTest(ray);
+      float tNear[2];
+      if (!intersectBox(boxTest,bvh.nodes[0].bounds(),ray.tmin,ray.tmax,tNear[0]))
+        return false;
+
+      detail::TraversalStack<uint32_t> stack;
+      uint32_t nodeID = 0;
+      while (true) {
+        const BVHNode &node = bvh.nodes[nodeID];
+        if (node.isLeaf()) {
+          for (uint32_t i=0;i<node.count;i++) {
+            HostRay scratchRay = ray;
+            HostHit scratchHit;
+            if (intersectPrim(int(bvh.primIDs[node.offset+i]),scratchRay,scratchHit))
+              return true;
+          }
+        } else {
+          const BVHNode &child0 = bvh.nodes[node.offset+0];
+          const BVHNode &child1 = bvh.nodes[node.offset+1];
+          const int hitMask
+            = intersectBoxPair(boxTest,child0.lower,child0.upper,child1.lower,child1.upper,
+                               ray.tmin,ray.tmax,tNear);
+          if (hitMask == 3) {
+            stack.push(node.offset+1);
+            nodeID = node.offset;
+            continue;
+          }
+          if (hitMask) {
+            nodeID = node.offset+(hitMask >> 1);
+            continue;
+          }
+        }
+        if (stack.empty()) return false;
+        nodeID = stack.pop();
+      }
+    }
+
+    namespace detail {
+
+      /*! traces each of a packet's (active) rays on its own */
+      template<typename IntersectPrim8>
+      inline int traceClosest8_scalar(const BVH &bvh, RayPacket8 &rays, HitPacket8 &hits,
+                                      int activeMask, const IntersectPrim8 &intersectPrim)
+      {
+        int hitMask = 0;
+        for (int lane=0;lane<8;lane++) {
+          if (!(activeMask & (1<<lane))) continue;
+          HostRay ray = rays.get(lane);
+          HostHit hit = hits.get(lane);
+          const bool found
+            = traceClosest(bvh,ray,hit,[&](int primID, HostRay &laneRay, HostHit &laneHit){
+                if (!intersectPrim(primID,rays,hits,1<<lane)) return false;
+                laneRay.tmax = rays.tmax[lane];
+                laneHit      = hits.get(lane);
+                return true;
+              });
+          if (found) hitMask |= (1<<lane);
+        }
+        return hitMask;
+      }
+
+      template<typename IntersectPrim8>
+      inline int traceAny8_scalar(const BVH &bvh, const RayPacket8 &rays,
+                                  int activeMask, const IntersectPrim8 &intersectPrim)
+      {
+        int hitMask = 0;
+        RayPacket8 scratchRays;
+        HitPacket8 scratchHits;
+        for (int lane=0;lane<8;lane++) {
+          if (!(activeMask & (1<<lane))) continue;
+          const bool found
+            = traceAny(bvh,rays.get(lane),[&](int primID, HostRay &laneRay, HostHit &){
+                scratchRays.set(lane,laneRay);
+                return intersectPrim(primID,scratchRays,scratchHits,1<<lane) != 0;
+              });
+          if (found) hitMask |= (1<<lane);
+        }
+        return hitMask;
+      }
+
+#if OWL_HAVE_AVX2_RAYS
+      struct PacketStackEntry {
+        uint32_t nodeID;
+        /*! the lanes that hit this node */
+        int      laneMask;
+        /*! the closest of these lanes' entry distances */
+        float    tNear;
+      };
+
+      OWL_TARGET_AVX2
+      inline float reduceMin8_avx2(__m256 v)
+      {
+        __m128 m = _mm_min_ps(_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1));
+        m = _mm_min_ps(m,_mm_movehl_ps(m,m));
+        m = _mm_min_ss(m,_mm_shuffle_ps(m,m,_MM_SHUFFLE(1,1,1,1)));
+        return _mm_cvtss_f32(m);
+      }
+
+      OWL_TARGET_AVX2
+      inline float reduceMax8_avx2(__m256 v)
+      {
+        __m128 m = _mm_max_ps(_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1));
+        m = _mm_max_ps(m,_mm_movehl_ps(m,m));
+        m = _mm_max_ss(m,_mm_shuffle_ps(m,m,_MM_SHUFFLE(1,1,1,1)));
+        return _mm_cvtss_f32(m);
+      }
+
+      /*! the packet's lanes traverse together: a node gets visited if
+          any of them hits it, and leaves get intersected with just
+          the lanes that hit them */
+      template<typename IntersectPrim8>
+      OWL_TARGET_AVX2
+      inline int traceClosest8_avx2(const BVH &bvh, RayPacket8 &rays, HitPacket8 &hits,
+                                    int activeMask, const IntersectPrim8 &intersectPrim)
+      {
+        if (bvh.nodes.empty() || activeMask == 0) return 0;
+        RayPacket8BoxTest_avx2 boxTest;
+        boxTest.init(rays);
+        const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+        const __m256 active = activeLanes8_avx2(activeMask);
+        __m256 tmax = _mm256_load_ps(rays.tmax);
+        __m256 tNear;
+        const __m256 rootHit
+          = intersectBox8_avx2(boxTest,bvh.nodes[0].lower,bvh.nodes[0].upper,tmax,active,tNear);
+        PacketStackEntry current
+          = { 0, _mm256_movemask_ps(rootHit), reduceMin8_avx2(_mm256_blendv_ps(inf,tNear,rootHit)) };
+        if (!current.laneMask) return 0;
+
+        int hitMask = 0;
+        // farthest closest-hit so far, over all active lanes
+        float tmaxMax = reduceMax8_avx2(_mm256_blendv_ps(_mm256_setzero_ps(),tmax,active));
+        TraversalStack<PacketStackEntry> stack;
+        while (true) {
+          if (current.tNear <= tmaxMax) {
+            const BVHNode &node = bvh.nodes[current.nodeID];
+            if (node.isLeaf()) {
+              int leafHits = 0;
+              for (uint32_t i=0;i<node.count;i++)
+                leafHits |= intersectPrim(int(bvh.primIDs[node.offset+i]),rays,hits,current.laneMask);
+              if (leafHits) {
+                hitMask |= leafHits;
+                tmax     = _mm256_load_ps(rays.tmax);
+                tmaxMax  = reduceMax8_avx2(_mm256_blendv_ps(_mm256_setzero_ps(),tmax,active));
+              }
+            } else {
+              const BVHNode &child0 = bvh.nodes[node.offset+0];
+              const BVHNode &child1 = bvh.nodes[node.offset+1];
+              const __m256 parentLanes = activeLanes8_avx2(current.laneMask);
+              __m256 tNear0, tNear1;
+              const __m256 hit0 = intersectBox8_avx2(boxTest,child0.lower,child0.upper,
+                                                     tmax,parentLanes,tNear0);
+              const __m256 hit1 = intersectBox8_avx2(boxTest,child1.lower,child1.upper,
+                                                     tmax,parentLanes,tNear1);
+              PacketStackEntry entry0
+                = { node.offset+0, _mm256_movemask_ps(hit0),
+                    reduceMin8_avx2(_mm256_blendv_ps(inf,tNear0,hit0)) };
+              PacketStackEntry entry1
+                = { node.offset+1, _mm256_movemask_ps(hit1),
+                    reduceMin8_avx2(_mm256_blendv_ps(inf,tNear1,hit1)) };
+              if (entry0.laneMask && entry1.laneMask) {
+                if (entry1.tNear < entry0.tNear) std::swap(entry0,entry1);
+                stack.push(entry1);
+                current = entry0;
+                continue;
+              }
+              if (entry0.laneMask) { current = entry0; continue; }
+              if (entry1.laneMask) { current = entry1; continue; }
+            }
+          }
+          if (stack.empty()) break;
+          current = stack.pop();
+        }
+        return hitMask;
+      }
+
+      template<typename IntersectPrim8>
+      OWL_TARGET_AVX2
+      inline int traceAny8_avx2(const BVH &bvh, const RayPacket8 &rays,
+                                int activeMask, const IntersectPrim8 &intersectPrim)
+      {
+        if (bvh.nodes.empty() || activeMask == 0) return 0;
+        RayPacket8 scratchRays = rays;
+        HitPacket8 scratchHits;
+        RayPacket8BoxTest_avx2 boxTest;
+        boxTest.init(rays);
+        const __m256 tmax = _mm256_load_ps(rays.tmax);
+        __m256 tNear;
+        PacketStackEntry current
+          = { 0, _mm256_movemask_ps(intersectBox8_avx2(boxTest,bvh.nodes[0].lower,bvh.nodes[0].upper,
+                                                       tmax,activeLanes8_avx2(activeMask),tNear)),
+              0.f };
+        int occluded = 0;
+        TraversalStack<PacketStackEntry> stack;
+        while (true) {
+          // lanes that are already occluded don't need to go on
+          current.laneMask &= ~occluded;
+          if (current.laneMask) {
+            const BVHNode &node = bvh.nodes[current.nodeID];
+            if (node.isLeaf()) {
+              for (uint32_t i=0;i<node.count && (current.laneMask & ~occluded);i++)
+                occluded |= intersectPrim(int(bvh.primIDs[node.offset+i]),scratchRays,scratchHits,
+                                          current.laneMask & ~occluded);
+              if (occluded == activeMask) break;
+            } else {
+              const BVHNode &child0 = bvh.nodes[node.offset+0];
+              const BVHNode &child1 = bvh.nodes[node.offset+1];
+              const __m256 parentLanes = activeLanes8_avx2(current.laneMask);
+              const PacketStackEntry entry0
+                = { node.offset+0,
+                    _mm256_movemask_ps(intersectBox8_avx2(boxTest,child0.lower,child0.upper,
+                                                          tmax,parentLanes,tNear)), 0.f };
+              const PacketStackEntry entry1
+                = { node.offset+1,
+                    _mm256_movemask_ps(intersectBox8_avx2(boxTest,child1.lower,child1.upper,
+                                                          tmax,parentLanes,tNear)), 0.f };
+              if (entry1.laneMask) stack.push(entry1);
+              if (entry0.laneMask) { current = entry0; continue; }
+            }
+          }
+          if (stack.empty()) break;
+          current = stack.pop();
+        }
+        return occluded;
+      }
+#endif
+    } // ::owl::common::detail
+
+    /*! closest-hit traversal for the active lanes of a packet;
+        returns the lanes that hit something */
+    template<typename IntersectPrim8>
+    inline int traceClosest8(const BVH &bvh, RayPacket8 &rays, HitPacket8 &hits,
+                             int activeMask, const IntersectPrim8 &intersectPrim)
+    {
+#if OWL_HAVE_AVX2_RAYS
+      if (detail::cpuHasAVX2())
+        return detail::traceClosest8_avx2(bvh,rays,hits,activeMask,intersectPrim);
+#endif
+      return detail::traceClosest8_scalar(bvh,rays,hits,activeMask,intersectPrim);
+    }
+
+    /*! any-hit traversal for the active lanes of a packet; returns
+        the lanes that hit something */
+    template<typename IntersectPrim8>
+    inline int traceAny8(const BVH &bvh, const RayPacket8 &rays,
+                         int activeMask, const IntersectPrim8 &intersectPrim)
+    {
+#if OWL_HAVE_AVX2_RAYS
+      if (detail::cpuHasAVX2())
+        return detail::traceAny8_avx2(bvh,rays,activeMask,intersectPrim);
+#endif
+      return detail::traceAny8_scalar(bvh,rays,activeMask,intersectPrim);
+    }
+
+  } // ::owl::common
+} // ::owl
@@ -0,0 +1,491 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/bvh/QuantizedBVH8.h A compressed, 8-wide BVH for
+    host-side ray traversal, collapsed from a binary BVH (see BVH.h).
+
+    Each node stores the bounds of up to eight children as 8-bit
+    offsets relative to its own box, on a power-of-two grid per axis
+    (along the lines of Ylitie et al., "Efficient Incoherent Ray
+    Traversal on GPUs Through Compressed Wide BVHs", HPG 2017). A
+    node is 80 bytes; compared to the 32-byte binary nodes, that is
+    about half the bytes per triangle, and a fraction of the memory
+    traffic, as one node fetch replaces three levels of binary
+    nodes. The quantized boxes are conservative: they always contain
+    the children's exact bounds.
+
+    Traversal tests all eight children of a node at once with AVX2
+    if the CPU has it, and one after the other otherwise; it uses the
+    same intersectPrim lambdas as the binary traversal in
+    BVHTraversal.h.
+
+    Host only; do not include this from device code. */
+
+#pragma once
+
+#include "owl/common/bvh/BVHTraversal.h"
+#include <cmath>
+#include <stdexcept>
+#include <string.h>
+
+/*! the traversal loops get inlined into their scalar and AVX2 entry
+    points, so the compiler can inline the AVX2 child test into the
+    loop (which it won't do across target attributes otherwise) */
+#if defined(__GNUC__) || defined(__clang__)
+# define OWL_BVH_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+# define OWL_BVH_FORCE_INLINE __forceinline
+#else
+# define OWL_BVH_FORCE_INLINE inline
+#endif
+
+namespace owl {
+  namespace common {
+
+    /*! a node of a QuantizedBVH8. The first numInner() children are
+        inner nodes, stored next to each other starting at
+        'childBase'; the others are leaves, whose prims are stored
+        next to each other (in child order) starting at 'primBase' */
+    struct QuantizedBVH8Node {
+      /*! lower corner of the node's bounds */
+      vec3f    origin;
+      /*! per axis, a child's bounds are origin+q*2^exponent, for q
+          in qlower/qupper */
+      int8_t   exponent[3];
+      /*! number of children (low nibble) and of inner children
+          (high nibble) */
+      uint8_t  childCounts;
+      uint32_t childBase;
+      uint32_t primBase;
+      /*! for leaf child i, its prims end at primBase+leafEnd[i]
+          (and begin where the previous leaf's end) */
+      uint8_t  leafEnd[8];
+      uint8_t  qlower[3][8];
+      uint8_t  qupper[3][8];
+
+      inline int   numChildren() const { return childCounts & 0xf; }
+      inline int   numInner()    const { return childCounts >> 4; }
+      inline bool  isLeaf(int i) const { return i >= numInner(); }
+      inline float scale(int axis) const
+      {
+        // 2^exponent, built directly from the bits; exponents are
+        // kept in the range of normalized floats
+        const uint32_t bits = uint32_t(exponent[axis]+127) << 23;
+        float f;
+        memcpy(&f,&bits,sizeof(f));
+        return f;
+      }
+      /*! the (conservative) bounds of the i'th child */
+      inline box3f childBounds(int i) const
+      {
+        box3f b;
+        for (int axis=0;axis<3;axis++) {
+          b.lower[axis] = origin[axis]+float(qlower[axis][i])*scale(axis);
+          b.upper[axis] = origin[axis]+float(qupper[axis][i])*scale(axis);
+        }
+        return b;
+      }
+      inline uint32_t leafBegin(int i) const
+      { return primBase + (i == numInner() ? 0 : leafEnd[i-1]); }
+      inline uint32_t leafCount(int i) const
+      { return primBase + leafEnd[i] - leafBegin(i); }
+    };
+
+    struct QuantizedBVH8 {
+      /*! builds a binary BVH over the given prim bounds, and
+          collapses it */
+      inline void build(const box3f *primBounds, size_t numPrims,
+                        const BVHBuildConfig &config = BVHBuildConfig());
+
+      /*! collapses a binary BVH into this one; prim IDs stay the
+          same. The binary BVH's leaves can have at most 31 prims */
+      inline void collapse(const BVH &binary);
+
+      inline size_t sizeInBytes() const
+      { return nodes.size()*sizeof(QuantizedBVH8Node) + primIDs.size()*sizeof(uint32_t); }
+
+      /*! nodes[0] is the root */
+      std::vector<QuantizedBVH8Node> nodes;
+      std::vector<uint32_t>          primIDs;
+    };
+
+    namespace bvh_detail {
+
+      enum { QUANTIZED_MIN_EXPONENT = -126, QUANTIZED_MAX_EXPONENT = 127 };
+
+      /*! picks the exponent for one axis of a node, and quantizes
+          the children's bounds on that axis; rounds outwards, and
+          checks with the exact same float math that traversal uses
+          to get the planes back, so quantized boxes are always
+          conservative */
+      inline void quantizeAxis(QuantizedBVH8Node &node, int axis,
+                               const box3f *childBounds, int numChildren,
+                               float upper)
+      {
+        const float origin = node.origin[axis];
+        int exponent;
+        frexpf((upper-origin)/255.f,&exponent);
+        exponent = std::max(exponent,int(QUANTIZED_MIN_EXPONENT));
+        for (;;exponent++) {
+          if (exponent > QUANTIZED_MAX_EXPONENT)
+            throw std::runtime_error("QuantizedBVH8: cannot quantize node bounds");
+          node.exponent[axis] = int8_t(exponent);
+          const float scale = node.scale(axis);
+          bool fits = true;
+          for (int i=0;i<numChildren;i++) {
+            const float lo = childBounds[i].lower[axis];
+            const float hi = childBounds[i].upper[axis];
+            int ql = int(std::min(255.f,std::max(0.f,floorf((lo-origin)/scale))));
+            while (ql > 0 && origin+float(ql)*scale > lo) --ql;
+            int qu = int(std::min(256.f,std::max(0.f,ceilf((hi-origin)/scale))));
+            while (qu <= 255 && origin+float(qu)*scale < hi) ++qu;
+            if (qu > 255) { fits = false; break; }
+            node.qlower[axis][i] = uint8_t(ql);
+            node.qupper[axis][i] = uint8_t(qu);
+          }
+          if (fits) return;
+        }
+      }
+
+      /*! greedily opens up the binary node's descendants (largest
+          surface area first) until it has eight children, or there
+          is nothing left to open; returns the number of children */
+      inline int gatherChildren(const BVH &binary, uint32_t nodeID, uint32_t children[8])
+      {
+        const BVHNode &node = binary.nodes[nodeID];
+        if (node.isLeaf()) {
+          children[0] = nodeID;
+          return 1;
+        }
+        int numChildren = 0;
+        children[numChildren++] = node.offset+0;
+        children[numChildren++] = node.offset+1;
+        while (numChildren < 8) {
+          int   toOpen = -1;
+          float maxArea = -1.f;
+          for (int i=0;i<numChildren;i++) {
+            const BVHNode &child = binary.nodes[children[i]];
+            if (child.isLeaf()) continue;
+            const float area = halfArea(child.bounds());
+            if (area > maxArea) { maxArea = area; toOpen = i; }
+          }
+          if (toOpen < 0) break;
+          const uint32_t offset = binary.nodes[children[toOpen]].offset;
+          children[toOpen]        = offset+0;
+          children[numChildren++] = offset+1;
+        }
+        // inner children first
+        std::stable_partition(children,children+numChildren,[&](uint32_t child){
+            return !binary.nodes[child].isLeaf();
+          });
+        return numChildren;
+      }
+
+    } // ::owl::common::bvh_detail
+
+    inline void QuantizedBVH8::build(const box3f *primBounds, size_t numPrims,
+                                     const BVHBuildConfig &config)
+    {
+      BVH binary;
+      binary.build(primBounds,numPrims,config);
+      collapse(binary);
+    }
+
+    inline void QuantizedBVH8::collapse(const BVH &binary)
+    {
+      nodes.clear();
+      primIDs.clear();
+      if (binary.nodes.empty()) return;
+      primIDs.reserve(binary.primIDs.size());
+
+      // breadth first, so all inner children of a node get
+      // allocated at the same time, and end up next to each other
+      std::vector<std::pair<uint32_t,uint32_t>> queue; // (binary node, wide node)
+      nodes.emplace_back();
+      queue.push_back({ 0, 0 });
+      for (size_t q=0;q<queue.size();q++) {
+        const uint32_t binaryID = queue[q].first;
+        const uint32_t wideID   = queue[q].second;
+
+        uint32_t children[8];
+        const int numChildren = bvh_detail::gatherChildren(binary,binaryID,children);
+        box3f childBounds[8], bounds;
+        int numInner = 0;
+        for (int i=0;i<numChildren;i++) {
+          childBounds[i] = binary.nodes[children[i]].bounds();
+          bounds.extend(childBounds[i]);
+          if (!binary.nodes[children[i]].isLeaf()) numInner++;
+        }
+
+        QuantizedBVH8Node node = QuantizedBVH8Node();
+        node.origin      = bounds.lower;
+        node.childCounts = uint8_t(numChildren | (numInner << 4));
+        for (int axis=0;axis<3;axis++)
+          bvh_detail::quantizeAxis(node,axis,childBounds,numChildren,bounds.upper[axis]);
+
+        node.childBase = uint32_t(nodes.size());
+        for (int i=0;i<numInner;i++)
+          queue.push_back({ children[i], uint32_t(nodes.size()+i) });
+        nodes.resize(nodes.size()+numInner);
+
+        node.primBase = uint32_t(primIDs.size());
+        for (int i=numInner;i<numChildren;i++) {
+          const BVHNode &leaf = binary.nodes[children[i]];
+          primIDs.insert(primIDs.end(),
+                         binary.primIDs.begin()+leaf.offset,
+                         binary.primIDs.begin()+leaf.offset+leaf.count);
+          if (primIDs.size()-node.primBase > 255)
+            throw std::runtime_error("QuantizedBVH8: binary BVH leaves are too large "
+                                     "(at most 31 prims per leaf)");
+          node.leafEnd[i] = uint8_t(primIDs.size()-node.primBase);
+        }
+        nodes[wideID] = node;
+      }
+    }
+
+    namespace detail {
+
+      struct WideStackEntry {
+        /*! node ID, or (for leaves) index of the first prim */
+        uint32_t begin;
+        /*! number of prims for leaves, 0 for inner nodes */
+        uint32_t count;
+        float    tNear;
+      };
+
+      inline WideStackEntry childEntry(const QuantizedBVH8Node &node, int i, float tNear)
+      {
+        if (i < node.numInner())
+          return { node.childBase+uint32_t(i), 0, tNear };
+        return { node.leafBegin(i), node.leafCount(i), tNear };
+      }
+
+      inline int lowestBit(int mask)
+      {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctz(mask);
+#else
+        int i = 0;
+        while (!(mask & (1<<i))) i++;
+        return i;
+#endif
+      }
+
+      /*! tests a ray against a node's children one at a time */
+      struct WideChildTest_scalar {
+        WideChildTest_scalar(const HostRay &ray) : ray(ray) {}
+
+        inline int operator()(const QuantizedBVH8Node &node, float tmin, float tmax,
+                              float tNear[8]) const
+        {
+          int hitMask = 0;
+          for (int i=0;i<node.numChildren();i++) {
+            float tEnter = tmin, tExit = tmax;
+            for (int axis=0;axis<3;axis++) {
+              const float scale = node.scale(axis);
+              const float lo = node.origin[axis]+float(node.qlower[axis][i])*scale;
+              const float hi = node.origin[axis]+float(node.qupper[axis][i])*scale;
+              const float t0 = (lo-ray.org[axis])*ray.rcpDir[axis];
+              const float t1 = (hi-ray.org[axis])*ray.rcpDir[axis];
+              tEnter = std::max(tEnter,std::min(t0,t1));
+              tExit  = std::min(tExit,std::max(t0,t1)*rayBoxExitScale);
+            }
+            if (tEnter <= tExit) {
+              tNear[i] = tEnter;
+              hitMask |= (1<<i);
+            }
+          }
+          return hitMask;
+        }
+
+        const RayBoxTest ray;
+      };
+
+#if OWL_HAVE_AVX2_RAYS
+      /*! tests a ray against all of a node's children at once */
+      struct WideChildTest_avx2 {
+        OWL_TARGET_AVX2 WideChildTest_avx2(const HostRay &ray)
+        {
+          const RayBoxTest boxTest(ray);
+          for (int axis=0;axis<3;axis++) {
+            org[axis]    = _mm256_set1_ps(boxTest.org[axis]);
+            rcpDir[axis] = _mm256_set1_ps(boxTest.rcpDir[axis]);
+          }
+        }
+
+        OWL_TARGET_AVX2
+        inline int operator()(const QuantizedBVH8Node &node, float tmin, float tmax,
+                              float tNear[8]) const
+        {
+          __m256 tEnter = _mm256_set1_ps(tmin);
+          __m256 tExit  = _mm256_set1_ps(tmax);
+          for (int axis=0;axis<3;axis++) {
+            const __m256 origin = _mm256_set1_ps(node.origin[axis]);
+            const __m256 scale
+              = _mm256_castsi256_ps(_mm256_set1_epi32((node.exponent[axis]+127) << 23));
+            const __m256 qlo
+              = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32
+                                   (_mm_loadl_epi64((const __m128i*)node.qlower[axis])));
+            const __m256 qhi
+              = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32
+                                   (_mm_loadl_epi64((const __m128i*)node.qupper[axis])));
+            // q*scale is exact, so this gives the very same planes
+            // the builder checked its rounding against
+            const __m256 lo = _mm256_add_ps(origin,_mm256_mul_ps(qlo,scale));
+            const __m256 hi = _mm256_add_ps(origin,_mm256_mul_ps(qhi,scale));
+            const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(lo,org[axis]),rcpDir[axis]);
+            const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(hi,org[axis]),rcpDir[axis]);
+            tEnter = _mm256_max_ps(tEnter,_mm256_min_ps(t0,t1));
+            tExit  = _mm256_min_ps(tExit, _mm256_mul_ps(_mm256_max_ps(t0,t1),
+                                                        _mm256_set1_ps(rayBoxExitScale)));
+          }
+          _mm256_storeu_ps(tNear,tEnter);
+          return _mm256_movemask_ps(_mm256_cmp_ps(tEnter,tExit,_CMP_LE_OQ))
+            & ((1<<node.numChildren())-1);
+        }
+
+        __m256 org[3], rcpDir[3];
+      };
+#endif
+
+      /*! closest-first traversal: hit children go on the stack
+          farthest first, and the closest one gets visited next */
+      template<typename ChildTest, typename IntersectPrim>
+      OWL_BVH_FORCE_INLINE bool traceClosestWide(const QuantizedBVH8 &bvh, HostRay &ray, HostHit &hit,
+                                   const ChildTest &childTest,
+                                   const IntersectPrim &intersectPrim)
+      {
+        if (bvh.nodes.empty()) return false;
+        bool found = false;
+        TraversalStack<WideStackEntry> stack;
+        WideStackEntry current = { 0, 0, ray.tmin };
+        while (true) {
+          if (current.tNear <= ray.tmax) {
+            if (current.count) {
+              for (uint32_t i=0;i<current.count;i++)
+                if (intersectPrim(int(bvh.primIDs[current.begin+i]),ray,hit))
+                  found = true;
+            } else {
+              const QuantizedBVH8Node &node = bvh.nodes[current.begin];
+              float tNear[8];
+              int hitMask = childTest(node,ray.tmin,ray.tmax,tNear);
+              if (hitMask) {
+                WideStackEntry sorted[8];
+                int numHit = 0;
+                while (hitMask) {
+                  const int i = lowestBit(hitMask);
+                  hitMask &= hitMask-1;
+                  const WideStackEntry entry = childEntry(node,i,tNear[i]);
+                  int k = numHit++;
+                  for (;k>0 && sorted[k-1].tNear < entry.tNear;k--)
+                    sorted[k] = sorted[k-1];
+                  sorted[k] = entry;
+                }
+                for (int k=0;k<numHit-1;k++)
+                  stack.push(sorted[k]);
+                current = sorted[numHit-1];
+                continue;
+              }
+            }
+          }
+          if (stack.empty()) break;
+          current = stack.pop();
+        }
+        return found;
+      }
+
+      template<typename ChildTest, typename IntersectPrim>
+      OWL_BVH_FORCE_INLINE bool traceAnyWide(const QuantizedBVH8 &bvh, const HostRay &ray,
+                               const ChildTest &childTest,
+                               const IntersectPrim &intersectPrim)
+      {
+        if (bvh.nodes.empty()) return false;
+        TraversalStack<WideStackEntry> stack;
+        WideStackEntry current = { 0, 0, ray.tmin };
+        while (true) {
+          if (current.count) {
+            for (uint32_t i=0;i<current.count;i++) {
+              HostRay scratchRay = ray;
+              HostHit scratchHit;
+              if (intersectPrim(int(bvh.primIDs[current.begin+i]),scratchRay,scratchHit))
+                return true;
+            }
+          } else {
+            const QuantizedBVH8Node &node = bvh.nodes[current.begin];
+            float tNear[8];
+            int hitMask = childTest(node,ray.tmin,ray.tmax,tNear);
+            if (hitMask) {
+              current = childEntry(node,lowestBit(hitMask),0.f);
+              hitMask &= hitMask-1;
+              while (hitMask) {
+                stack.push(childEntry(node,lowestBit(hitMask),0.f));
+                hitMask &= hitMask-1;
+              }
+              continue;
+            }
+          }
+          if (stack.empty()) return false;
+          current = stack.pop();
+        }
+      }
+
+#if OWL_HAVE_AVX2_RAYS
+      template<typename IntersectPrim>
+      OWL_TARGET_AVX2
+      inline bool traceClosest_avx2(const QuantizedBVH8 &bvh, HostRay &ray, HostHit &hit,
+                                    const IntersectPrim &intersectPrim)
+      {
+        return traceClosestWide(bvh,ray,hit,WideChildTest_avx2(ray),intersectPrim);
+      }
+
+      template<typename IntersectPrim>
+      OWL_TARGET_AVX2
+      inline bool traceAny_avx2(const QuantizedBVH8 &bvh, const HostRay &ray,
+                                const IntersectPrim &intersectPrim)
+      {
+        return traceAnyWide(bvh,ray,WideChildTest_avx2(ray),intersectPrim);
+      }
+#endif
+    } // ::owl::common::detail
+
+    /*! finds the closest hit along the ray; returns true if there was
+        any, with ray.tmax and 'hit' describing it */
+    template<typename IntersectPrim>
+    inline bool traceClosest(const QuantizedBVH8 &bvh, HostRay &ray, HostHit &hit,
+                             const IntersectPrim &intersectPrim)
+    {
+#if OWL_HAVE_AVX2_RAYS
+      if (detail::cpuHasAVX2())
+        return detail::traceClosest_avx2(bvh,ray,hit,intersectPrim);
+#endif
+      return detail::traceClosestWide(bvh,ray,hit,detail::WideChildTest_scalar(ray),
+                                      intersectPrim);
+    }
+
+    /*! returns true if anything at all gets hit in [tmin,tmax) */
+    template<typename IntersectPrim>
+    inline bool traceAny(const QuantizedBVH8 &bvh, const HostRay &ray,
+                         const IntersectPrim &intersectPrim)
+    {
+#if OWL_HAVE_AVX2_RAYS
+      if (detail::cpuHasAVX2())
+        return detail::traceAny_avx2(bvh,ray,intersectPrim);
+#endif
+      return detail::traceAnyWide(bvh,ray,detail::WideChildTest_scalar(ray),intersectPrim);
+    }
+
+  } // ::owl::common
+} // ::owl
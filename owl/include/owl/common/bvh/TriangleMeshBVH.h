@@ -0,0 +1,231 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/bvh/TriangleMeshBVH.h A ready-to-use CPU ray
+    caster for an indexed triangle mesh (the same vertex/index arrays
+    that go into an OWL triangles geom): a BVH over the triangles,
+    plus closest-hit and any-hit queries for rays and 8-wide packets.
+    The BVH is either binary (BVH.h), or an 8-wide quantized one
+    (QuantizedBVH8.h) that takes less memory.
+
+    Host only; do not include this from device code. */
+
+#pragma once
+
+#include "owl/common/bvh/QuantizedBVH8.h"
+
+namespace owl {
+  namespace common {
+
+    struct TriangleMeshBVH {
+      struct Triangle {
+        vec3f v0, v1, v2;
+      };
+
+      enum Layout { BINARY, QUANTIZED_WIDE8 };
+
+      /*! copies the mesh's triangles, and builds the BVH over them
+          in the current 'layout'; primIDs of hits are indices into
+          'indices' */
+      inline void build(const vec3f *vertices, const vec3i *indices, size_t numTriangles,
+                        const BVHBuildConfig &config = BVHBuildConfig());
+
+      inline bool closestHit(HostRay &ray, HostHit &hit) const;
+      inline bool anyHit(const HostRay &ray) const;
+      /*! returns the lanes that hit something */
+      inline int  closestHit8(RayPacket8 &rays, HitPacket8 &hits, int activeMask = 0xff) const;
+      /*! returns the lanes that hit something */
+      inline int  anyHit8(const RayPacket8 &rays, int activeMask = 0xff) const;
+
+      /*! memory used by the BVH (without the triangles) */
+      inline size_t bvhSizeInBytes() const
+      { return layout == BINARY ? bvh.sizeInBytes() : wideBVH.sizeInBytes(); }
+
+      /*! use the watertight triangle test rather than
+          Moeller-Trumbore: slower, but rays never slip through
+          between adjacent triangles */
+      bool watertight = false;
+
+      /*! which BVH build() creates, and the queries use; packet
+          queries on the quantized BVH trace each ray on its own */
+      Layout layout = BINARY;
+
+      std::vector<Triangle> triangles;
+      /*! for the BINARY layout */
+      BVH                   bvh;
+      /*! for the QUANTIZED_WIDE8 layout */
+      QuantizedBVH8         wideBVH;
+
+    private:
+      template<typename AnyBVH>
+      inline bool closestHit(const AnyBVH &bvh, HostRay &ray, HostHit &hit) const;
+      template<typename AnyBVH>
+      inline bool anyHit(const AnyBVH &bvh, const HostRay &ray) const;
+    };
+
+    inline void TriangleMeshBVH::build(const vec3f *vertices, const vec3i *indices,
+                                       size_t numTriangles, const BVHBuildConfig &config)
+    {
+      triangles.resize(numTriangles);
+      std::vector<box3f> bounds(numTriangles);
+      parallel_for_blocked(0,numTriangles,16*1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            const vec3i index = indices[i];
+            triangles[i] = { vertices[index.x], vertices[index.y], vertices[index.z] };
+            bounds[i] = box3f()
+              .including(triangles[i].v0)
+              .including(triangles[i].v1)
+              .including(triangles[i].v2);
+          }
+        });
+      bvh.build(bounds.data(),numTriangles,config);
+      wideBVH = QuantizedBVH8();
+      if (layout == QUANTIZED_WIDE8) {
+        wideBVH.collapse(bvh);
+        bvh = BVH();
+      }
+    }
+
+    inline bool TriangleMeshBVH::closestHit(HostRay &ray, HostHit &hit) const
+    {
+      return layout == BINARY ? closestHit(bvh,ray,hit) : closestHit(wideBVH,ray,hit);
+    }
+
+    inline bool TriangleMeshBVH::anyHit(const HostRay &ray) const
+    {
+      return layout == BINARY ? anyHit(bvh,ray) : anyHit(wideBVH,ray);
+    }
+
+    template<typename AnyBVH>
+    inline bool TriangleMeshBVH::closestHit(const AnyBVH &bvh, HostRay &ray, HostHit &hit) const
+    {
+      if (watertight) {
+        const WatertightRay wt(ray);
+        return traceClosest(bvh,ray,hit,[&](int primID, HostRay &ray, HostHit &hit){
+            const Triangle &tri = triangles[primID];
+            return intersectTriangle(ray,wt,hit,tri.v0,tri.v1,tri.v2,primID);
+          });
+      }
+      return traceClosest(bvh,ray,hit,[&](int primID, HostRay &ray, HostHit &hit){
+          const Triangle &tri = triangles[primID];
+          return intersectTriangle(ray,hit,tri.v0,tri.v1,tri.v2,primID);
+        });
+    }
+
+    template<typename AnyBVH>
+    inline bool TriangleMeshBVH::anyHit(const AnyBVH &bvh, const HostRay &ray) const
+    {
+      if (watertight) {
+        const WatertightRay wt(ray);
+        return traceAny(bvh,ray,[&](int primID, HostRay &ray, HostHit &hit){
+            const Triangle &tri = triangles[primID];
+            return intersectTriangle(ray,wt,hit,tri.v0,tri.v1,tri.v2,primID);
+          });
+      }
+      return traceAny(bvh,ray,[&](int primID, HostRay &ray, HostHit &hit){
+          const Triangle &tri = triangles[primID];
+          return intersectTriangle(ray,hit,tri.v0,tri.v1,tri.v2,primID);
+        });
+    }
+
+#if OWL_HAVE_AVX2_RAYS
+    namespace detail {
+      /*! packet traversal with the AVX2 triangle kernels; the
+          watertight set-up gets done once per packet, not per
+          triangle */
+      OWL_TARGET_AVX2
+      inline int closestHit8_avx2(const TriangleMeshBVH &mesh, RayPacket8 &rays,
+                                  HitPacket8 &hits, int activeMask)
+      {
+        if (mesh.watertight) {
+          WatertightRay8_avx2 wt;
+          wt.init(rays);
+          return traceClosest8_avx2
+            (mesh.bvh,rays,hits,activeMask,
+             [&](int primID, RayPacket8 &rays, HitPacket8 &hits, int activeMask){
+              const TriangleMeshBVH::Triangle &tri = mesh.triangles[primID];
+              return intersectTriangle8_avx2(rays,wt,hits,activeMask,tri.v0,tri.v1,tri.v2,primID);
+            });
+        }
+        return traceClosest8_avx2
+          (mesh.bvh,rays,hits,activeMask,
+           [&](int primID, RayPacket8 &rays, HitPacket8 &hits, int activeMask){
+            const TriangleMeshBVH::Triangle &tri = mesh.triangles[primID];
+            return intersectTriangle8_avx2(rays,hits,activeMask,tri.v0,tri.v1,tri.v2,primID);
+          });
+      }
+
+      OWL_TARGET_AVX2
+      inline int anyHit8_avx2(const TriangleMeshBVH &mesh, const RayPacket8 &rays,
+                              int activeMask)
+      {
+        if (mesh.watertight) {
+          WatertightRay8_avx2 wt;
+          wt.init(rays);
+          return traceAny8_avx2
+            (mesh.bvh,rays,activeMask,
+             [&](int primID, RayPacket8 &rays, HitPacket8 &hits, int activeMask){
+              const TriangleMeshBVH::Triangle &tri = mesh.triangles[primID];
+              return intersectTriangle8_avx2(rays,wt,hits,activeMask,tri.v0,tri.v1,tri.v2,primID);
+            });
+        }
+        return traceAny8_avx2
+          (mesh.bvh,rays,activeMask,
+           [&](int primID, RayPacket8 &rays, HitPacket8 &hits, int activeMask){
+            const TriangleMeshBVH::Triangle &tri = mesh.triangles[primID];
+            return intersectTriangle8_avx2(rays,hits,activeMask,tri.v0,tri.v1,tri.v2,primID);
+          });
+      }
+    } // ::owl::common::detail
+#endif
+
+    inline int TriangleMeshBVH::closestHit8(RayPacket8 &rays, HitPacket8 &hits,
+                                            int activeMask) const
+    {
+#if OWL_HAVE_AVX2_RAYS
+      if (layout == BINARY && detail::cpuHasAVX2())
+        return detail::closestHit8_avx2(*this,rays,hits,activeMask);
+#endif
+      int hitMask = 0;
+      for (int lane=0;lane<8;lane++) {
+        if (!(activeMask & (1<<lane))) continue;
+        HostRay ray = rays.get(lane);
+        HostHit hit = hits.get(lane);
+        if (!closestHit(ray,hit)) continue;
+        rays.tmax[lane]   = ray.tmax;
+        hits.primID[lane] = hit.primID;
+        hits.u[lane]      = hit.u;
+        hits.v[lane]      = hit.v;
+        hitMask |= (1<<lane);
+      }
+      return hitMask;
+    }
+
+    inline int TriangleMeshBVH::anyHit8(const RayPacket8 &rays, int activeMask) const
+    {
+#if OWL_HAVE_AVX2_RAYS
+      if (layout == BINARY && detail::cpuHasAVX2())
+        return detail::anyHit8_avx2(*this,rays,activeMask);
+#endif
+      int hitMask = 0;
+      for (int lane=0;lane<8;lane++)
+        if ((activeMask & (1<<lane)) && anyHit(rays.get(lane)))
+          hitMask |= (1<<lane);
+      return hitMask;
+    }
+
+  } // ::owl::common
+} // ::owl
@@ -198,5 +198,51 @@ namespace owl {
       return dst;
     }
     
+    /*! decomposes an affine transform into rotation, scale, and
+        translation, such that xfm ~= translate(translation) *
+        rotate(rotation) * scale(scale). The rotation is the
+        orthogonal factor of the polar decomposition of xfm.l, so for
+        transforms with shear it is the closest rotation, and 'scale'
+        the diagonal of the remaining stretch. Mirroring transforms
+        (negative determinant) come out as a negative scale.x */
+    inline void decompose(const affine3f &xfm,
+                          Quaternion3f &rotation,
+                          vec3f &scale,
+                          vec3f &translation)
+    {
+      translation = xfm.p;
+
+      linear3f M = xfm.l;
+      const float mirror = M.det() < 0.f ? -1.f : 1.f;
+      M.vx = mirror * M.vx;
+
+      // scaled newton iteration for the polar decomposition (Higham
+      // 1986): Q' = (g*Q + 1/g*Q^-T)/2, with g = |det(Q)|^(-1/3)
+      linear3f Q = M;
+      for (int iter=0;iter<20;iter++) {
+        const vec3f c0 = cross(Q.vy,Q.vz);
+        const vec3f c1 = cross(Q.vz,Q.vx);
+        const vec3f c2 = cross(Q.vx,Q.vy);
+        const float det = dot(Q.vx,c0);
+        if (!(fabsf(det) > 1e-30f)) {
+          // degenerate (zero scale along some axis) - no meaningful
+          // rotation to extract
+          rotation = Quaternion3f(one);
+          scale = vec3f(mirror*length(xfm.l.vx),length(xfm.l.vy),length(xfm.l.vz));
+          return;
+        }
+        const float g  = powf(fabsf(det),-1.f/3.f);
+        const float gi = 1.f/(g*det);
+        const linear3f next(.5f*(g*Q.vx + gi*c0),
+                            .5f*(g*Q.vy + gi*c1),
+                            .5f*(g*Q.vz + gi*c2));
+        const vec3f dx = next.vx-Q.vx, dy = next.vy-Q.vy, dz = next.vz-Q.vz;
+        Q = next;
+        if (dot(dx,dx)+dot(dy,dy)+dot(dz,dz) < 1e-12f) break;
+      }
+      rotation = normalize(Quaternion3f(Q.vx,Q.vy,Q.vz));
+      scale = vec3f(mirror*dot(Q.vx,M.vx),dot(Q.vy,M.vy),dot(Q.vz,M.vz));
+    }
+
   } // ::owl::common
 } // ::owl
@@ -98,9 +98,9 @@ namespace owl {
     template<typename T> __both__ QuaternionT<T> operator +( const QuaternionT<T>& a ) { return QuaternionT<T>(+a.r, +a.i, +a.j, +a.k); }
     template<typename T> __both__ QuaternionT<T> operator -( const QuaternionT<T>& a ) { return QuaternionT<T>(-a.r, -a.i, -a.j, -a.k); }
     template<typename T> __both__ QuaternionT<T> conj      ( const QuaternionT<T>& a ) { return QuaternionT<T>(a.r, -a.i, -a.j, -a.k); }
-    template<typename T> __both__ T              abs       ( const QuaternionT<T>& a ) { return sqrt(a.r*a.r + a.i*a.i + a.j*a.j + a.k*a.k); }
+    template<typename T> __both__ T              abs       ( const QuaternionT<T>& a ) { return owl::common::polymorphic::sqrt(a.r*a.r + a.i*a.i + a.j*a.j + a.k*a.k); }
     template<typename T> __both__ QuaternionT<T> rcp       ( const QuaternionT<T>& a ) { return conj(a)*rcp(a.r*a.r + a.i*a.i + a.j*a.j + a.k*a.k); }
-    template<typename T> __both__ QuaternionT<T> normalize ( const QuaternionT<T>& a ) { return a*rsqrt(a.r*a.r + a.i*a.i + a.j*a.j + a.k*a.k); }
+    template<typename T> __both__ QuaternionT<T> normalize ( const QuaternionT<T>& a ) { return a*owl::common::polymorphic::rsqrt(a.r*a.r + a.i*a.i + a.j*a.j + a.k*a.k); }
 
     ////////////////////////////////////////////////////////////////
     // Binary Operators
@@ -149,6 +149,43 @@ namespace owl {
                const typename QuaternionT<T>::Vector&       b ) 
     { return (a*QuaternionT<T>(b)*conj(a)).v(); }
 
+    ////////////////////////////////////////////////////////////////////////////////
+    /// Interpolation
+    ////////////////////////////////////////////////////////////////////////////////
+
+    template<typename T> __both__ T dot( const QuaternionT<T>& a, const QuaternionT<T>& b ) { return a.r*b.r + a.i*b.i + a.j*b.j + a.k*b.k; }
+
+    /*! normalized linear interpolation between two unit quaternions,
+        along the shorter of the two possible arcs */
+    template<typename T> __both__ QuaternionT<T>
+    nlerp( const QuaternionT<T>& a, const QuaternionT<T>& b, const T& t )
+    {
+      const T sign = dot(a,b) < T(zero) ? T(-1) : T(1);
+      return normalize((T(one)-t)*a + (sign*t)*b);
+    }
+
+    /*! spherical linear interpolation between two unit quaternions,
+        along the shorter of the two possible arcs; falls back to
+        nlerp for (nearly) identical rotations, where slerp's weights
+        become numerically unstable */
+    template<typename T> __both__ QuaternionT<T>
+    slerp( const QuaternionT<T>& a, const QuaternionT<T>& b, const T& t )
+    {
+      const T cosTheta = dot(a,b);
+      const T sign = cosTheta < T(zero) ? T(-1) : T(1);
+      if (sign*cosTheta > T(0.9995f))
+        return normalize((T(one)-t)*a + (sign*t)*b);
+      // computing the angle through atan2 rather than acos(cosTheta)
+      // keeps it accurate for small angles
+      const QuaternionT<T> d = a - sign*b, s = a + sign*b;
+      const T theta    = T(2)*atan2(owl::common::polymorphic::sqrt(dot(d,d)),
+                                    owl::common::polymorphic::sqrt(dot(s,s)));
+      const T sinTheta = sin(theta);
+      const T wa = sin((T(one)-t)*theta)/sinTheta;
+      const T wb = sin(t*theta)/sinTheta;
+      return wa*a + (sign*wb)*b;
+    }
+
     ////////////////////////////////////////////////////////////////////////////////
     /// Comparison Operators
     ////////////////////////////////////////////////////////////////////////////////
@@ -170,7 +207,7 @@ namespace owl {
       if ( vx.x + vy.y + vz.z >= T(zero) )
         {
           const T t = T(one) + (vx.x + vy.y + vz.z);
-          const T s = rsqrt(t)*T(0.5f);
+          const T s = owl::common::polymorphic::rsqrt(t)*T(0.5f);
           r = t*s;
           i = (vy.z - vz.y)*s;
           j = (vz.x - vx.z)*s;
@@ -179,7 +216,7 @@ namespace owl {
       else if ( vx.x >= max(vy.y, vz.z) )
         {
           const T t = (T(one) + vx.x) - (vy.y + vz.z);
-          const T s = rsqrt(t)*T(0.5f);
+          const T s = owl::common::polymorphic::rsqrt(t)*T(0.5f);
           r = (vy.z - vz.y)*s;
           i = t*s;
           j = (vx.y + vy.x)*s;
@@ -188,7 +225,7 @@ namespace owl {
       else if ( vy.y >= vz.z ) // if ( vy.y >= max(vz.z, vx.x) )
         {
           const T t = (T(one) + vy.y) - (vz.z + vx.x);
-          const T s = rsqrt(t)*T(0.5f);
+          const T s = owl::common::polymorphic::rsqrt(t)*T(0.5f);
           r = (vz.x - vx.z)*s;
           i = (vx.y + vy.x)*s;
           j = t*s;
@@ -197,7 +234,7 @@ namespace owl {
       else //if ( vz.z >= max(vy.y, vx.x) )
         {
           const T t = (T(one) + vz.z) - (vx.x + vy.y);
-          const T s = rsqrt(t)*T(0.5f);
+          const T s = owl::common::polymorphic::rsqrt(t)*T(0.5f);
           r = (vx.y - vy.x)*s;
           i = (vz.x + vx.z)*s;
           j = (vy.z + vz.y)*s;
@@ -0,0 +1,323 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/math/batchedTransforms.h Host-side batched
+    versions of affine3f inversion (rcp), affine3f decomposition, and
+    quaternion slerp/nlerp, for processing large instance or
+    animation arrays before uploading them.
+
+    All functions take and return plain arrays of the regular
+    (array-of-structs) types. Internally each parallel task
+    transposes groups of XFM_LANES elements into struct-of-arrays
+    form, so the arithmetic is simple fixed-length loops that
+    compilers auto-vectorize.
+
+    Host only; do not include this from device code. */
+
+#pragma once
+
+#include "owl/common/math/AffineSpace.h"
+#include "owl/common/parallel/parallel_for.h"
+
+namespace owl {
+  namespace common {
+    namespace detail {
+
+      enum {
+        /*! number of elements processed side by side in SoA form */
+        XFM_LANES = 8,
+        /*! number of elements each parallel task processes */
+        XFM_BLOCK_SIZE = 4*1024
+      };
+
+      /*! a group of XFM_LANES affine3fs, in struct-of-arrays form:
+          m[0..2] is l.vx, m[3..5] l.vy, m[6..8] l.vz, and m[9..11] p */
+      struct AffineLanes {
+        float m[12][XFM_LANES];
+
+        /*! gathers 'n' transforms; unused lanes are set to identity,
+            so they won't produce any NaNs or denormals */
+        inline void load(const affine3f *in, int n)
+        {
+          for (int lane=0;lane<XFM_LANES;lane++) {
+            const affine3f xfm = lane < n ? in[lane] : affine3f(one);
+            const float *f = &xfm.l.vx.x;
+            for (int k=0;k<12;k++) m[k][lane] = f[k];
+          }
+        }
+
+        inline void store(affine3f *out, int n) const
+        {
+          for (int lane=0;lane<n;lane++) {
+            float *f = &out[lane].l.vx.x;
+            for (int k=0;k<12;k++) f[k] = m[k][lane];
+          }
+        }
+      };
+
+      /*! SoA version of rcp(affine3f) */
+      inline void rcpLanes(AffineLanes &out, const AffineLanes &in)
+      {
+        const float (*a)[XFM_LANES] = in.m;
+        float (*o)[XFM_LANES] = out.m;
+        for (int lane=0;lane<XFM_LANES;lane++) {
+          // rows of the inverse, times det: cross(vy,vz),
+          // cross(vz,vx), cross(vx,vy)
+          const float r00 = a[4][lane]*a[8][lane] - a[5][lane]*a[7][lane];
+          const float r01 = a[5][lane]*a[6][lane] - a[3][lane]*a[8][lane];
+          const float r02 = a[3][lane]*a[7][lane] - a[4][lane]*a[6][lane];
+          const float r10 = a[7][lane]*a[2][lane] - a[8][lane]*a[1][lane];
+          const float r11 = a[8][lane]*a[0][lane] - a[6][lane]*a[2][lane];
+          const float r12 = a[6][lane]*a[1][lane] - a[7][lane]*a[0][lane];
+          const float r20 = a[1][lane]*a[5][lane] - a[2][lane]*a[4][lane];
+          const float r21 = a[2][lane]*a[3][lane] - a[0][lane]*a[5][lane];
+          const float r22 = a[0][lane]*a[4][lane] - a[1][lane]*a[3][lane];
+          const float det = a[0][lane]*r00 + a[1][lane]*r01 + a[2][lane]*r02;
+          const float inv = 1.f/det;
+          o[0][lane] = r00*inv; o[1][lane] = r10*inv; o[2][lane] = r20*inv;
+          o[3][lane] = r01*inv; o[4][lane] = r11*inv; o[5][lane] = r21*inv;
+          o[6][lane] = r02*inv; o[7][lane] = r12*inv; o[8][lane] = r22*inv;
+          const float px = a[9][lane], py = a[10][lane], pz = a[11][lane];
+          o[ 9][lane] = -(o[0][lane]*px + o[3][lane]*py + o[6][lane]*pz);
+          o[10][lane] = -(o[1][lane]*px + o[4][lane]*py + o[7][lane]*pz);
+          o[11][lane] = -(o[2][lane]*px + o[5][lane]*py + o[8][lane]*pz);
+        }
+      }
+
+      /*! SoA version of the polar decomposition in decompose(affine3f):
+          on return, 'q' holds the (column-major) rotation matrix for
+          each lane, and 'scale' the per-axis scale */
+      inline void polarLanes(float q[9][XFM_LANES],
+                             float scale[3][XFM_LANES],
+                             const AffineLanes &in)
+      {
+        float mirror[XFM_LANES];
+        float m[9][XFM_LANES];
+        for (int lane=0;lane<XFM_LANES;lane++) {
+          const float (*a)[XFM_LANES] = in.m;
+          const float det
+            = a[0][lane]*(a[4][lane]*a[8][lane] - a[5][lane]*a[7][lane])
+            + a[1][lane]*(a[5][lane]*a[6][lane] - a[3][lane]*a[8][lane])
+            + a[2][lane]*(a[3][lane]*a[7][lane] - a[4][lane]*a[6][lane]);
+          mirror[lane] = det < 0.f ? -1.f : 1.f;
+          for (int k=0;k<9;k++)
+            m[k][lane] = (k < 3 ? mirror[lane] : 1.f) * a[k][lane];
+          for (int k=0;k<9;k++)
+            q[k][lane] = m[k][lane];
+        }
+
+        for (int iter=0;iter<20;iter++) {
+          float maxDelta = 0.f;
+          for (int lane=0;lane<XFM_LANES;lane++) {
+            const float c00 = q[4][lane]*q[8][lane] - q[5][lane]*q[7][lane];
+            const float c01 = q[5][lane]*q[6][lane] - q[3][lane]*q[8][lane];
+            const float c02 = q[3][lane]*q[7][lane] - q[4][lane]*q[6][lane];
+            const float c10 = q[7][lane]*q[2][lane] - q[8][lane]*q[1][lane];
+            const float c11 = q[8][lane]*q[0][lane] - q[6][lane]*q[2][lane];
+            const float c12 = q[6][lane]*q[1][lane] - q[7][lane]*q[0][lane];
+            const float c20 = q[1][lane]*q[5][lane] - q[2][lane]*q[4][lane];
+            const float c21 = q[2][lane]*q[3][lane] - q[0][lane]*q[5][lane];
+            const float c22 = q[0][lane]*q[4][lane] - q[1][lane]*q[3][lane];
+            const float det = q[0][lane]*c00 + q[1][lane]*c01 + q[2][lane]*c02;
+            // degenerate lanes get caught by the scalar fallback below;
+            // here we just make sure they don't hold up convergence
+            const bool  valid = fabsf(det) > 1e-30f;
+            const float g  = valid ? powf(fabsf(det),-1.f/3.f) : 1.f;
+            const float gi = valid ? 1.f/(g*det) : 0.f;
+            const float c[9] = { c00,c01,c02, c10,c11,c12, c20,c21,c22 };
+            float delta = 0.f;
+            for (int k=0;k<9;k++) {
+              const float next = valid ? .5f*(g*q[k][lane] + gi*c[k]) : q[k][lane];
+              delta += (next-q[k][lane])*(next-q[k][lane]);
+              q[k][lane] = next;
+            }
+            maxDelta = max(maxDelta,delta);
+          }
+          if (maxDelta < 1e-12f) break;
+        }
+
+        for (int lane=0;lane<XFM_LANES;lane++)
+          for (int d=0;d<3;d++)
+            scale[d][lane]
+              = (d == 0 ? mirror[lane] : 1.f)
+              * (q[3*d+0][lane]*m[3*d+0][lane] +
+                 q[3*d+1][lane]*m[3*d+1][lane] +
+                 q[3*d+2][lane]*m[3*d+2][lane]);
+      }
+
+      /*! runs 'laneFct(begin,n)' over groups of (at most) XFM_LANES
+          elements, in parallel */
+      template<typename LaneFct>
+      inline void forEachLaneGroup(size_t count, const LaneFct &laneFct)
+      {
+        parallel_for_blocked
+          (0,count,XFM_BLOCK_SIZE,[&](size_t begin, size_t end){
+            for (size_t i=begin;i<end;i+=XFM_LANES)
+              laneFct(i,int(std::min(size_t(XFM_LANES),end-i)));
+          });
+      }
+
+      /*! computes out[i] = slerp(a[i],b[i],t[i]) (or, if 'normalizedLerp'
+          is set, nlerp(a[i],b[i],t[i])) for 'count' unit quaternions, in
+          parallel. 't' may be null, in which case 'tAll' gets used for
+          all elements */
+      inline void interpolate(Quaternion3f *out,
+                        const Quaternion3f *a,
+                        const Quaternion3f *b,
+                        const float *t,
+                        float tAll,
+                        size_t count,
+                        bool normalizedLerp = false)
+      {
+        forEachLaneGroup(count,[&](size_t begin, int n){
+            const int W = XFM_LANES;
+            float qa[4][W], qb[4][W], tt[W], res[4][W];
+            for (int lane=0;lane<W;lane++) {
+              const int src = lane < n ? lane : 0;
+              const Quaternion3f &A = a[begin+src];
+              const Quaternion3f &B = b[begin+src];
+              qa[0][lane] = A.r; qa[1][lane] = A.i; qa[2][lane] = A.j; qa[3][lane] = A.k;
+              qb[0][lane] = B.r; qb[1][lane] = B.i; qb[2][lane] = B.j; qb[3][lane] = B.k;
+              tt[lane] = t ? t[begin+src] : tAll;
+            }
+            for (int lane=0;lane<W;lane++) {
+              const float cosTheta
+                = qa[0][lane]*qb[0][lane] + qa[1][lane]*qb[1][lane]
+                + qa[2][lane]*qb[2][lane] + qa[3][lane]*qb[3][lane];
+              const float sign = cosTheta < 0.f ? -1.f : 1.f;
+              // same weights, and same nlerp fallback, as the scalar slerp()
+              const bool linear = normalizedLerp || sign*cosTheta > 0.9995f;
+              float wa = 1.f-tt[lane], wb = sign*tt[lane];
+              if (!linear) {
+                float d2 = 0.f, s2 = 0.f;
+                for (int k=0;k<4;k++) {
+                  const float d = qa[k][lane] - sign*qb[k][lane];
+                  const float s = qa[k][lane] + sign*qb[k][lane];
+                  d2 += d*d; s2 += s*s;
+                }
+                const float theta    = 2.f*atan2f(sqrtf(d2),sqrtf(s2));
+                const float sinTheta = sinf(theta);
+                wa = sinf(wa*theta)/sinTheta;
+                wb = sign*sinf(tt[lane]*theta)/sinTheta;
+              }
+              float len2 = 0.f;
+              for (int k=0;k<4;k++) {
+                res[k][lane] = wa*qa[k][lane] + wb*qb[k][lane];
+                len2 += res[k][lane]*res[k][lane];
+              }
+              const float scale = linear ? 1.f/sqrtf(len2) : 1.f;
+              for (int k=0;k<4;k++)
+                res[k][lane] *= scale;
+            }
+            for (int lane=0;lane<n;lane++)
+              out[begin+lane] = Quaternion3f(res[0][lane],res[1][lane],
+                                             res[2][lane],res[3][lane]);
+          });
+      }
+
+    } // ::owl::common::detail
+
+    /*! computes out[i] = rcp(in[i]) for 'count' transforms, in
+        parallel; 'out' may be the same array as 'in' */
+    inline void rcp(affine3f *out, const affine3f *in, size_t count)
+    {
+      detail::forEachLaneGroup(count,[&](size_t begin, int n){
+          detail::AffineLanes a, inv;
+          a.load(in+begin,n);
+          detail::rcpLanes(inv,a);
+          inv.store(out+begin,n);
+        });
+    }
+
+    /*! batched version of decompose(affine3f,...), in
+        parallel. Any of the three output arrays may be null if
+        that component is not needed */
+    inline void decompose(Quaternion3f *rotations,
+                          vec3f *scales,
+                          vec3f *translations,
+                          const affine3f *in,
+                          size_t count)
+    {
+      detail::forEachLaneGroup(count,[&](size_t begin, int n){
+          if (translations)
+            for (int lane=0;lane<n;lane++)
+              translations[begin+lane] = in[begin+lane].p;
+          if (!rotations && !scales)
+            return;
+
+          detail::AffineLanes a;
+          a.load(in+begin,n);
+          float q[9][detail::XFM_LANES];
+          float s[3][detail::XFM_LANES];
+          detail::polarLanes(q,s,a);
+          for (int lane=0;lane<n;lane++) {
+            const vec3f qx(q[0][lane],q[1][lane],q[2][lane]);
+            const vec3f qy(q[3][lane],q[4][lane],q[5][lane]);
+            const vec3f qz(q[6][lane],q[7][lane],q[8][lane]);
+            if (!(fabsf(dot(qx,cross(qy,qz))) > .5f)) {
+              // degenerate input - let the scalar version handle it
+              Quaternion3f r; vec3f sc, t;
+              decompose(in[begin+lane],r,sc,t);
+              if (rotations) rotations[begin+lane] = r;
+              if (scales)    scales[begin+lane]    = sc;
+              continue;
+            }
+            if (rotations)
+              rotations[begin+lane] = normalize(Quaternion3f(qx,qy,qz));
+            if (scales)
+              scales[begin+lane] = vec3f(s[0][lane],s[1][lane],s[2][lane]);
+          }
+        });
+    }
+
+    /*! computes out[i] = slerp(a[i],b[i],t[i]) for 'count' unit
+        quaternions, in parallel */
+    inline void slerp(Quaternion3f *out,
+                      const Quaternion3f *a,
+                      const Quaternion3f *b,
+                      const float *t,
+                      size_t count)
+    { detail::interpolate(out,a,b,t,0.f,count,false); }
+
+    /*! computes out[i] = slerp(a[i],b[i],t) for 'count' unit
+        quaternions, in parallel */
+    inline void slerp(Quaternion3f *out,
+                      const Quaternion3f *a,
+                      const Quaternion3f *b,
+                      float t,
+                      size_t count)
+    { detail::interpolate(out,a,b,nullptr,t,count,false); }
+
+    /*! computes out[i] = nlerp(a[i],b[i],t[i]) for 'count' unit
+        quaternions, in parallel */
+    inline void nlerp(Quaternion3f *out,
+                      const Quaternion3f *a,
+                      const Quaternion3f *b,
+                      const float *t,
+                      size_t count)
+    { detail::interpolate(out,a,b,t,0.f,count,true); }
+
+    /*! computes out[i] = nlerp(a[i],b[i],t) for 'count' unit
+        quaternions, in parallel */
+    inline void nlerp(Quaternion3f *out,
+                      const Quaternion3f *a,
+                      const Quaternion3f *b,
+                      float t,
+                      size_t count)
+    { detail::interpolate(out,a,b,nullptr,t,count,true); }
+
+  } // ::owl::common
+} // ::owl
@@ -0,0 +1,216 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/math/convert.h Host-side bulk converters between
+    float arrays and the compact storage types in half.h and
+    fixedpoint.h, for packing vertex attributes etc before uploading
+    them into OWL buffers. All converters operate on flat arrays of
+    scalars - to convert N vec3fs into N vec3hs, pass 3*N as count.
+
+    Host only; do not include this from device code. */
+
+#pragma once
+
+#include "owl/common/math/half.h"
+#include "owl/common/math/fixedpoint.h"
+#include "owl/common/parallel/parallel_for.h"
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && !defined(__CUDACC__)
+# include <immintrin.h>
+# define OWL_HAVE_SSE2_CONVERT 1
+# if defined(__GNUC__) || defined(__clang__)
+/* F16C is not part of the x86-64 baseline, so rather than requiring
+   -mf16c for everything we compile just the F16C kernels for that
+   target, and check at runtime if the CPU supports it */
+#  define OWL_HAVE_F16C_CONVERT 1
+#  define OWL_TARGET_F16C __attribute__((target("avx,f16c")))
+# elif defined(__F16C__)
+#  define OWL_HAVE_F16C_CONVERT 1
+#  define OWL_TARGET_F16C /* enabled for entire file */
+# endif
+#endif
+
+namespace owl {
+  namespace common {
+    namespace detail {
+
+      /*! number of scalars each parallel task converts */
+      enum { CONVERT_BLOCK_SIZE = 64*1024 };
+
+#if OWL_HAVE_F16C_CONVERT
+      inline bool cpuHasF16C()
+      {
+# if defined(__GNUC__) || defined(__clang__)
+        static const bool hasF16C
+          = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+        return hasF16C;
+# else
+        return true;
+# endif
+      }
+
+      OWL_TARGET_F16C
+      inline void floatToHalf_f16c(half *dst, const float *src, size_t count)
+      {
+        size_t i = 0;
+        for (;i+8<=count;i+=8) {
+          const __m256  f = _mm256_loadu_ps(src+i);
+          const __m128i h = _mm256_cvtps_ph(f,_MM_FROUND_TO_NEAREST_INT);
+          _mm_storeu_si128((__m128i*)(dst+i),h);
+        }
+        for (;i<count;i++)
+          dst[i] = half(src[i]);
+      }
+
+      OWL_TARGET_F16C
+      inline void halfToFloat_f16c(float *dst, const half *src, size_t count)
+      {
+        size_t i = 0;
+        for (;i+8<=count;i+=8) {
+          const __m128i h = _mm_loadu_si128((const __m128i*)(src+i));
+          _mm256_storeu_ps(dst+i,_mm256_cvtph_ps(h));
+        }
+        for (;i<count;i++)
+          dst[i] = float(src[i]);
+      }
+#endif
+
+#if OWL_HAVE_SSE2_CONVERT
+      /*! converts 4 floats to (clamped, rounded, and scaled) int32s,
+          using exactly the same arithmetic as FixedPoint::encode() */
+      template<typename FP>
+      inline __m128i encodeFixedPoint4(const float *src)
+      {
+        const __m128 lo = _mm_set1_ps(FP::isSigned ? -1.f : 0.f);
+        __m128 f = _mm_loadu_ps(src);
+        // note: max(f,lo) returns its second operand for NaNs, which
+        // matches what the scalar encode() does
+        f = _mm_min_ps(_mm_max_ps(f,lo),_mm_set1_ps(1.f));
+        f = _mm_mul_ps(f,_mm_set1_ps(float(FP::maxValue)));
+        const __m128 half_ = _mm_or_ps(_mm_and_ps(f,_mm_set1_ps(-0.f)),_mm_set1_ps(.5f));
+        return _mm_cvttps_epi32(_mm_add_ps(f,half_));
+      }
+
+      inline void encode16(unorm8 *dst, const float *src)
+      {
+        const __m128i a = _mm_packs_epi32(encodeFixedPoint4<unorm8>(src+0),
+                                          encodeFixedPoint4<unorm8>(src+4));
+        const __m128i b = _mm_packs_epi32(encodeFixedPoint4<unorm8>(src+8),
+                                          encodeFixedPoint4<unorm8>(src+12));
+        _mm_storeu_si128((__m128i*)dst,_mm_packus_epi16(a,b));
+      }
+
+      inline void encode16(snorm8 *dst, const float *src)
+      {
+        const __m128i a = _mm_packs_epi32(encodeFixedPoint4<snorm8>(src+0),
+                                          encodeFixedPoint4<snorm8>(src+4));
+        const __m128i b = _mm_packs_epi32(encodeFixedPoint4<snorm8>(src+8),
+                                          encodeFixedPoint4<snorm8>(src+12));
+        _mm_storeu_si128((__m128i*)dst,_mm_packs_epi16(a,b));
+      }
+
+      inline void encode16(snorm16 *dst, const float *src)
+      {
+        for (int i=0;i<16;i+=8)
+          _mm_storeu_si128((__m128i*)(dst+i),
+                           _mm_packs_epi32(encodeFixedPoint4<snorm16>(src+i+0),
+                                           encodeFixedPoint4<snorm16>(src+i+4)));
+      }
+
+      inline void encode16(unorm16 *dst, const float *src)
+      {
+        // SSE2 has no unsigned 32->16 pack, so bias into signed range,
+        // pack with signed saturation, and flip the sign bit back
+        const __m128i bias = _mm_set1_epi32(32768);
+        const __m128i flip = _mm_set1_epi16(-32768);
+        for (int i=0;i<16;i+=8) {
+          const __m128i a = _mm_sub_epi32(encodeFixedPoint4<unorm16>(src+i+0),bias);
+          const __m128i b = _mm_sub_epi32(encodeFixedPoint4<unorm16>(src+i+4),bias);
+          _mm_storeu_si128((__m128i*)(dst+i),_mm_xor_si128(_mm_packs_epi32(a,b),flip));
+        }
+      }
+#endif
+
+    } // ::owl::common::detail
+
+    /*! converts 'count' floats to halfs, in parallel, and using F16C
+        instructions where available */
+    inline void convertToHalf(half *dst, const float *src, size_t count)
+    {
+      parallel_for_blocked
+        (0,count,detail::CONVERT_BLOCK_SIZE,[&](size_t begin, size_t end){
+#if OWL_HAVE_F16C_CONVERT
+          if (detail::cpuHasF16C()) {
+            detail::floatToHalf_f16c(dst+begin,src+begin,end-begin);
+            return;
+          }
+#endif
+          for (size_t i=begin;i<end;i++)
+            dst[i] = half(src[i]);
+        });
+    }
+
+    /*! converts 'count' halfs back to floats, in parallel, and using
+        F16C instructions where available */
+    inline void convertFromHalf(float *dst, const half *src, size_t count)
+    {
+      parallel_for_blocked
+        (0,count,detail::CONVERT_BLOCK_SIZE,[&](size_t begin, size_t end){
+#if OWL_HAVE_F16C_CONVERT
+          if (detail::cpuHasF16C()) {
+            detail::halfToFloat_f16c(dst+begin,src+begin,end-begin);
+            return;
+          }
+#endif
+          for (size_t i=begin;i<end;i++)
+            dst[i] = float(src[i]);
+        });
+    }
+
+    /*! converts 'count' floats to any of the unorm8/snorm8/unorm16/
+        snorm16 fixed-point types, in parallel and using SSE where
+        available; results are bit-identical to the scalar
+        FixedPoint(float) constructor */
+    template<typename FP>
+    inline void convertToFixedPoint(FP *dst, const float *src, size_t count)
+    {
+      parallel_for_blocked
+        (0,count,detail::CONVERT_BLOCK_SIZE,[&](size_t begin, size_t end){
+          size_t i = begin;
+#if OWL_HAVE_SSE2_CONVERT
+          for (;i+16<=end;i+=16)
+            detail::encode16(dst+i,src+i);
+#endif
+          for (;i<end;i++)
+            dst[i] = FP(src[i]);
+        });
+    }
+
+    /*! converts 'count' fixed-point values back to floats, in
+        parallel. The inner loop is plain scalar code that compilers
+        auto-vectorize well, so there is no hand-written SIMD path */
+    template<typename FP>
+    inline void convertFromFixedPoint(float *dst, const FP *src, size_t count)
+    {
+      parallel_for_blocked
+        (0,count,detail::CONVERT_BLOCK_SIZE,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            dst[i] = FP::decode(src[i].bits);
+        });
+    }
+
+  } // ::owl::common
+} // ::owl
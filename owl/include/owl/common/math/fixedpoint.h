@@ -1,5 +1,5 @@
 // ======================================================================== //
-// Copyright 2018 Ingo Wald                                                 //
+// Copyright 2018-2020 Ingo Wald                                            //
 //                                                                          //
 // Licensed under the Apache License, Version 2.0 (the "License");          //
 // you may not use this file except in compliance with the License.         //
@@ -16,21 +16,82 @@
 
 #pragma once
 
-#include "gdt/gdt.h"
-#include "gdt/math/constants.h"
+#include "owl/common/math/vec.h"
 #include <iostream>
 
-namespace gdt {
+namespace owl {
+  namespace common {
 
-  /*! a n-bit fixed-point float in the [0..1] region */
-  template<typename storageT, int Nbits, int is_signed>
-  struct FixedPoint {
-    FixedPoint();
+    /*! a n-bit fixed-point float; for unsigned storage types
+        ("unorm") this encodes the [0..1] range, for signed ones
+        ("snorm") the [-1..1] range. Conversion follows the D3D/GL
+        rules: encoding clamps and rounds to nearest, and for snorm
+        both -maxValue and -maxValue-1 decode to -1.f */
+    template<typename storageT, int Nbits, bool is_signed>
+    struct FixedPoint {
+      enum {
+        maxValue = is_signed ? ((1<<(Nbits-1))-1) : ((1<<Nbits)-1),
+        isSigned = is_signed
+      };
 
-    float operator float() const {
-      return bits / float((1ULL << Nbits)-1);
-    }
-    storageT bits;
-  };
-}
- 
+      inline __both__ FixedPoint() {}
+      inline __both__ FixedPoint(const float f) : bits(encode(f)) {}
+
+      inline __both__ operator float() const { return decode(bits); }
+
+      /*! create a fixed-point value from its raw bit pattern */
+      static inline __both__ FixedPoint fromBits(const storageT bits)
+      { FixedPoint fp; fp.bits = bits; return fp; }
+
+      static inline __both__ storageT encode(const float f)
+      {
+        const float lo = is_signed ? -1.f : 0.f;
+        // note: written such that NaNs end up at the lower end of the range
+        const float clamped = (f > lo) ? ((f < 1.f) ? f : 1.f) : lo;
+        const float scaled  = clamped * float(maxValue);
+        return storageT(int(scaled + (scaled < 0.f ? -.5f : .5f)));
+      }
+
+      static inline __both__ float decode(const storageT bits)
+      {
+        const float f = float(bits) * (1.f/float(maxValue));
+        return is_signed ? (f < -1.f ? -1.f : f) : f;
+      }
+
+      storageT bits;
+    };
+
+    template<typename storageT, int Nbits, bool is_signed>
+    inline __both__ bool operator==(const FixedPoint<storageT,Nbits,is_signed> &a,
+                                    const FixedPoint<storageT,Nbits,is_signed> &b)
+    { return a.bits == b.bits; }
+
+    template<typename storageT, int Nbits, bool is_signed>
+    inline __both__ bool operator!=(const FixedPoint<storageT,Nbits,is_signed> &a,
+                                    const FixedPoint<storageT,Nbits,is_signed> &b)
+    { return a.bits != b.bits; }
+
+    template<typename storageT, int Nbits, bool is_signed>
+    inline __owl_host std::ostream &operator<<(std::ostream &o,
+                                               const FixedPoint<storageT,Nbits,is_signed> &fp)
+    { o << float(fp); return o; }
+
+    typedef FixedPoint<uint8_t, 8, false> unorm8;
+    typedef FixedPoint<int8_t,  8, true>  snorm8;
+    typedef FixedPoint<uint16_t,16,false> unorm16;
+    typedef FixedPoint<int16_t, 16,true>  snorm16;
+
+#define _define_fixedpoint_vec_types(T)         \
+    using vec2##T = vec_t<T,2>;                 \
+    using vec3##T = vec_t<T,3>;                 \
+    using vec4##T = vec_t<T,4>;                 \
+
+    _define_fixedpoint_vec_types(unorm8);
+    _define_fixedpoint_vec_types(snorm8);
+    _define_fixedpoint_vec_types(unorm16);
+    _define_fixedpoint_vec_types(snorm16);
+
+#undef _define_fixedpoint_vec_types
+
+  } // ::owl::common
+} // ::owl
@@ -0,0 +1,130 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/common/math/vec.h"
+#include <string.h>
+
+namespace owl {
+  namespace common {
+
+    /*! reinterpret the bits of a float as a uint32, and vice versa;
+        works on both host and device */
+    inline __both__ uint32_t floatAsBits(const float f)
+    {
+#ifdef __CUDA_ARCH__
+      return __float_as_uint(f);
+#else
+      uint32_t u; memcpy(&u,&f,sizeof(u)); return u;
+#endif
+    }
+
+    inline __both__ float bitsAsFloat(const uint32_t u)
+    {
+#ifdef __CUDA_ARCH__
+      return __uint_as_float(u);
+#else
+      float f; memcpy(&f,&u,sizeof(f)); return f;
+#endif
+    }
+
+    /*! converts a float to IEEE 754 binary16 bits, with
+        round-to-nearest-even; values too large for a half become
+        +/-inf, and NaNs stay (quiet) NaNs. This produces the same bits
+        as the F16C and CUDA __float2half_rn conversions. */
+    inline __both__ uint16_t floatToHalfBits(const float f)
+    {
+      const uint32_t f32infty     = 255u << 23;
+      const uint32_t f16max       = (127u + 16u) << 23;
+      const uint32_t denorm_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+      uint32_t x = floatAsBits(f);
+      const uint32_t sign = x & 0x80000000u;
+      x ^= sign;
+
+      uint32_t o;
+      if (x >= f16max) {
+        // overflow to inf, or NaN
+        o = (x > f32infty) ? 0x7e00u : 0x7c00u;
+      } else if (x < (113u << 23)) {
+        // result is a half denormal (or zero): let the FPU do the
+        // rounding by adding a magic number
+        o = floatAsBits(bitsAsFloat(x) + bitsAsFloat(denorm_magic)) - denorm_magic;
+      } else {
+        // normalized half: rebias the exponent and round the mantissa
+        const uint32_t mant_odd = (x >> 13) & 1u;
+        x += ((15u - 127u) << 23) + 0xfffu;
+        x += mant_odd;
+        o = x >> 13;
+      }
+      return uint16_t(o | (sign >> 16));
+    }
+
+    /*! converts IEEE 754 binary16 bits back to a float; this
+        conversion is always exact */
+    inline __both__ float halfBitsToFloat(const uint16_t h)
+    {
+      const uint32_t magic       = 113u << 23;
+      const uint32_t shifted_exp = 0x7c00u << 13;
+
+      uint32_t o = (h & 0x7fffu) << 13;
+      const uint32_t exp = shifted_exp & o;
+      o += (127u - 15u) << 23;
+
+      if (exp == shifted_exp) {
+        // inf/NaN
+        o += (128u - 16u) << 23;
+      } else if (exp == 0) {
+        // zero or denormal: renormalize
+        o += 1u << 23;
+        o = floatAsBits(bitsAsFloat(o) - bitsAsFloat(magic));
+      }
+      return bitsAsFloat(o | (uint32_t(h & 0x8000u) << 16));
+    }
+
+    /*! an IEEE 754 16-bit "half" storage type. This is meant for
+        storing data compactly (in buffers and SBT records); all
+        arithmetic is supposed to happen on the float it converts
+        to. Layout-compatible with CUDA's __half, so a buffer of
+        'half's can be read as '__half's on the device */
+    struct half {
+      inline __both__ half() {}
+      inline __both__ half(const float f) : bits(floatToHalfBits(f)) {}
+
+      inline __both__ operator float() const { return halfBitsToFloat(bits); }
+
+      /*! create a half from its raw bit pattern */
+      static inline __both__ half fromBits(const uint16_t bits)
+      { half h; h.bits = bits; return h; }
+
+      uint16_t bits;
+    };
+
+    inline __both__ bool operator==(const half &a, const half &b)
+    { return a.bits == b.bits; }
+    inline __both__ bool operator!=(const half &a, const half &b)
+    { return a.bits != b.bits; }
+
+    inline __owl_host std::ostream &operator<<(std::ostream &o, const half &h)
+    { o << float(h); return o; }
+
+    using vec2h = vec_t<half,2>;
+    using vec3h = vec_t<half,3>;
+    using vec4h = vec_t<half,4>;
+
+  } // ::owl::common
+} // ::owl
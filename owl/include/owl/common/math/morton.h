@@ -0,0 +1,456 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/math/morton.h 3D Morton (Z-order) and Hilbert
+    space-filling curve keys, in 30-bit (10 bits per axis, in a
+    uint32_t) and 63-bit (21 bits per axis, in a uint64_t) flavors.
+
+    The scalar encoders/decoders work on both host and device; the
+    batched "compute*Codes" variants at the bottom are host-only, and
+    quantize points relative to a given box3f before encoding, in
+    parallel and with SSE/BMI2 where available. */
+
+#pragma once
+
+#include "owl/common/math/box.h"
+#ifndef __CUDACC__
+# include "owl/common/parallel/parallel_for.h"
+#endif
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && !defined(__CUDACC__)
+# include <immintrin.h>
+# define OWL_HAVE_SSE2_MORTON 1
+# if defined(__GNUC__) || defined(__clang__)
+/* pdep is only available with BMI2, which is not part of the x86-64
+   baseline; compile only those kernels for BMI2, and check at runtime
+   if the CPU supports it */
+#  define OWL_HAVE_BMI2_MORTON 1
+#  define OWL_TARGET_BMI2 __attribute__((target("bmi2")))
+# elif defined(__BMI2__)
+#  define OWL_HAVE_BMI2_MORTON 1
+#  define OWL_TARGET_BMI2 /* enabled for entire file */
+# endif
+#endif
+
+namespace owl {
+  namespace common {
+
+    // ==================================================================
+    // bit (de-)interleaving
+    // ==================================================================
+
+    /*! spreads the lower 10 bits of x such that there are two zero
+        bits between each of them */
+    inline __both__ uint32_t mortonExpandBits30(uint32_t x)
+    {
+      x &= 0x3ffu;
+      x = (x | (x << 16)) & 0x030000ffu;
+      x = (x | (x <<  8)) & 0x0300f00fu;
+      x = (x | (x <<  4)) & 0x030c30c3u;
+      x = (x | (x <<  2)) & 0x09249249u;
+      return x;
+    }
+
+    /*! inverse of mortonExpandBits30 */
+    inline __both__ uint32_t mortonCompactBits30(uint32_t x)
+    {
+      x &= 0x09249249u;
+      x = (x ^ (x >>  2)) & 0x030c30c3u;
+      x = (x ^ (x >>  4)) & 0x0300f00fu;
+      x = (x ^ (x >>  8)) & 0xff0000ffu;
+      x = (x ^ (x >> 16)) & 0x000003ffu;
+      return x;
+    }
+
+    /*! spreads the lower 21 bits of x such that there are two zero
+        bits between each of them */
+    inline __both__ uint64_t mortonExpandBits63(uint64_t x)
+    {
+      x &= 0x1fffffull;
+      x = (x | (x << 32)) & 0x001f00000000ffffull;
+      x = (x | (x << 16)) & 0x001f0000ff0000ffull;
+      x = (x | (x <<  8)) & 0x100f00f00f00f00full;
+      x = (x | (x <<  4)) & 0x10c30c30c30c30c3ull;
+      x = (x | (x <<  2)) & 0x1249249249249249ull;
+      return x;
+    }
+
+    /*! inverse of mortonExpandBits63 */
+    inline __both__ uint64_t mortonCompactBits63(uint64_t x)
+    {
+      x &= 0x1249249249249249ull;
+      x = (x ^ (x >>  2)) & 0x10c30c30c30c30c3ull;
+      x = (x ^ (x >>  4)) & 0x100f00f00f00f00full;
+      x = (x ^ (x >>  8)) & 0x001f0000ff0000ffull;
+      x = (x ^ (x >> 16)) & 0x001f00000000ffffull;
+      x = (x ^ (x >> 32)) & 0x00000000001fffffull;
+      return x;
+    }
+
+    // ==================================================================
+    // morton
+    // ==================================================================
+
+    /*! 30-bit morton code of a point on a 1024^3 grid; x ends up in
+        the lowest bit of each 3-bit group */
+    inline __both__ uint32_t mortonEncode30(const vec3ui &cell)
+    {
+      return
+        (mortonExpandBits30(cell.x)     ) |
+        (mortonExpandBits30(cell.y) << 1) |
+        (mortonExpandBits30(cell.z) << 2);
+    }
+
+    inline __both__ vec3ui mortonDecode30(const uint32_t code)
+    {
+      return vec3ui(mortonCompactBits30(code     ),
+                    mortonCompactBits30(code >> 1),
+                    mortonCompactBits30(code >> 2));
+    }
+
+    /*! 63-bit morton code of a point on a 2097152^3 (2^21) grid */
+    inline __both__ uint64_t mortonEncode63(const vec3ui &cell)
+    {
+      return
+        (mortonExpandBits63(cell.x)     ) |
+        (mortonExpandBits63(cell.y) << 1) |
+        (mortonExpandBits63(cell.z) << 2);
+    }
+
+    inline __both__ vec3ui mortonDecode63(const uint64_t code)
+    {
+      return vec3ui(uint32_t(mortonCompactBits63(code     )),
+                    uint32_t(mortonCompactBits63(code >> 1)),
+                    uint32_t(mortonCompactBits63(code >> 2)));
+    }
+
+    // ==================================================================
+    // hilbert
+    // ==================================================================
+
+    /*! J. Skilling's in-place transform ("Programming the Hilbert
+        curve", AIP 2004) from a point's axes to the "transposed"
+        hilbert index, whose interleaved bits (X[0] being the most
+        significant of each group) form the actual hilbert index */
+    inline __both__ void hilbertAxesToTranspose(uint32_t X[3], const int numBits)
+    {
+      const uint32_t M = 1u << (numBits-1);
+      // inverse undo
+      for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        const uint32_t P = Q - 1;
+        for (int i = 0; i < 3; i++) {
+          if (X[i] & Q)
+            X[0] ^= P;
+          else {
+            const uint32_t t = (X[0] ^ X[i]) & P;
+            X[0] ^= t;
+            X[i] ^= t;
+          }
+        }
+      }
+      // gray encode
+      X[1] ^= X[0];
+      X[2] ^= X[1];
+      uint32_t t = 0;
+      for (uint32_t Q = M; Q > 1; Q >>= 1)
+        if (X[2] & Q) t ^= Q - 1;
+      X[0] ^= t;
+      X[1] ^= t;
+      X[2] ^= t;
+    }
+
+    /*! inverse of \see hilbertAxesToTranspose */
+    inline __both__ void hilbertTransposeToAxes(uint32_t X[3], const int numBits)
+    {
+      const uint32_t N = 2u << (numBits-1);
+      // gray decode
+      uint32_t t = X[2] >> 1;
+      X[2] ^= X[1];
+      X[1] ^= X[0];
+      X[0] ^= t;
+      // undo excess work
+      for (uint32_t Q = 2; Q != N; Q <<= 1) {
+        const uint32_t P = Q - 1;
+        for (int i = 2; i >= 0; i--) {
+          if (X[i] & Q)
+            X[0] ^= P;
+          else {
+            t = (X[0] ^ X[i]) & P;
+            X[0] ^= t;
+            X[i] ^= t;
+          }
+        }
+      }
+    }
+
+    /*! 30-bit hilbert index of a point on a 1024^3 grid */
+    inline __both__ uint32_t hilbertEncode30(const vec3ui &cell)
+    {
+      uint32_t X[3] = { cell.x & 0x3ffu, cell.y & 0x3ffu, cell.z & 0x3ffu };
+      hilbertAxesToTranspose(X,10);
+      return mortonEncode30(vec3ui(X[2],X[1],X[0]));
+    }
+
+    inline __both__ vec3ui hilbertDecode30(const uint32_t code)
+    {
+      const vec3ui T = mortonDecode30(code);
+      uint32_t X[3] = { T.z, T.y, T.x };
+      hilbertTransposeToAxes(X,10);
+      return vec3ui(X[0],X[1],X[2]);
+    }
+
+    /*! 63-bit hilbert index of a point on a 2^21^3 grid */
+    inline __both__ uint64_t hilbertEncode63(const vec3ui &cell)
+    {
+      uint32_t X[3] = { cell.x & 0x1fffffu, cell.y & 0x1fffffu, cell.z & 0x1fffffu };
+      hilbertAxesToTranspose(X,21);
+      return mortonEncode63(vec3ui(X[2],X[1],X[0]));
+    }
+
+    inline __both__ vec3ui hilbertDecode63(const uint64_t code)
+    {
+      const vec3ui T = mortonDecode63(code);
+      uint32_t X[3] = { T.z, T.y, T.x };
+      hilbertTransposeToAxes(X,21);
+      return vec3ui(X[0],X[1],X[2]);
+    }
+
+    // ==================================================================
+    // quantization
+    // ==================================================================
+
+    /*! helper that maps points inside a given box to integer grid
+        cells of 2^numBits cells per axis; points outside the box get
+        clamped, degenerate (flat) box dimensions map to cell 0 */
+    struct MortonQuantizer {
+      inline __both__ MortonQuantizer(const box3f &bounds, const int numBits)
+        : lower(bounds.lower),
+          maxCell(float((1u<<numBits)-1))
+      {
+        const float numCells = float(1u<<numBits);
+        const vec3f size = bounds.size();
+        scale = vec3f(size.x > 0.f ? numCells/size.x : 0.f,
+                      size.y > 0.f ? numCells/size.y : 0.f,
+                      size.z > 0.f ? numCells/size.z : 0.f);
+      }
+
+      inline __both__ uint32_t quantize(const float f, const float lo, const float s) const
+      {
+        const float c = (f - lo) * s;
+        // note: written such that NaNs end up in cell 0
+        return uint32_t(c > 0.f ? (c < maxCell ? c : maxCell) : 0.f);
+      }
+
+      inline __both__ vec3ui operator()(const vec3f &P) const
+      {
+        return vec3ui(quantize(P.x,lower.x,scale.x),
+                      quantize(P.y,lower.y,scale.y),
+                      quantize(P.z,lower.z,scale.z));
+      }
+
+      vec3f lower;
+      vec3f scale;
+      float maxCell;
+    };
+
+#ifndef __CUDACC__
+    // ==================================================================
+    // host-side batched variants
+    // ==================================================================
+    namespace detail {
+
+      /*! number of points each parallel task encodes */
+      enum { MORTON_BLOCK_SIZE = 16*1024 };
+
+#if OWL_HAVE_BMI2_MORTON
+      inline bool cpuHasBMI2()
+      {
+# if defined(__GNUC__) || defined(__clang__)
+        static const bool hasBMI2 = __builtin_cpu_supports("bmi2");
+        return hasBMI2;
+# else
+        return true;
+# endif
+      }
+
+      /*! morton encoding using the 'pdep' bit deposit
+          instruction. Note that on AMD CPUs before Zen3 pdep is
+          microcoded and (much) slower than the shift-and-mask
+          version; if that matters, define OWL_DISABLE_BMI2_MORTON */
+      OWL_TARGET_BMI2
+      inline uint64_t mortonEncode63_bmi2(const vec3ui &cell)
+      {
+        return
+          _pdep_u64(cell.x,0x1249249249249249ull) |
+          _pdep_u64(cell.y,0x2492492492492492ull) |
+          _pdep_u64(cell.z,0x4924924924924924ull);
+      }
+
+      OWL_TARGET_BMI2
+      inline vec3ui mortonDecode63_bmi2(const uint64_t code)
+      {
+        return vec3ui(uint32_t(_pext_u64(code,0x1249249249249249ull)),
+                      uint32_t(_pext_u64(code,0x2492492492492492ull)),
+                      uint32_t(_pext_u64(code,0x4924924924924924ull)));
+      }
+
+      OWL_TARGET_BMI2
+      inline void mortonEncode63_bmi2(uint64_t *codes,
+                                      const vec3f *points,
+                                      size_t begin, size_t end,
+                                      const MortonQuantizer &quantizer)
+      {
+        for (size_t i=begin;i<end;i++)
+          codes[i] = mortonEncode63_bmi2(quantizer(points[i]));
+      }
+#endif
+
+#if OWL_HAVE_SSE2_MORTON
+      inline __m128i mortonExpandBits30_sse(__m128i x)
+      {
+        x = _mm_and_si128(_mm_or_si128(x,_mm_slli_epi32(x,16)),_mm_set1_epi32(0x030000ff));
+        x = _mm_and_si128(_mm_or_si128(x,_mm_slli_epi32(x, 8)),_mm_set1_epi32(0x0300f00f));
+        x = _mm_and_si128(_mm_or_si128(x,_mm_slli_epi32(x, 4)),_mm_set1_epi32(0x030c30c3));
+        x = _mm_and_si128(_mm_or_si128(x,_mm_slli_epi32(x, 2)),_mm_set1_epi32(0x09249249));
+        return x;
+      }
+
+      /*! quantizes 4 floats exactly the way MortonQuantizer::quantize
+          does */
+      inline __m128i mortonQuantize_sse(__m128 f, float lo, float s, float maxCell)
+      {
+        __m128 c = _mm_mul_ps(_mm_sub_ps(f,_mm_set1_ps(lo)),_mm_set1_ps(s));
+        // max(c,0) returns 0 for NaNs, same as the scalar code
+        c = _mm_min_ps(_mm_max_ps(c,_mm_setzero_ps()),_mm_set1_ps(maxCell));
+        return _mm_cvttps_epi32(c);
+      }
+
+      inline void mortonEncode30_sse(uint32_t *codes,
+                                     const vec3f *points,
+                                     size_t begin, size_t end,
+                                     const MortonQuantizer &q)
+      {
+        size_t i = begin;
+        for (;i+4<=end;i+=4) {
+          const vec3f *p = points+i;
+          const __m128i x = mortonQuantize_sse(_mm_setr_ps(p[0].x,p[1].x,p[2].x,p[3].x),
+                                               q.lower.x,q.scale.x,q.maxCell);
+          const __m128i y = mortonQuantize_sse(_mm_setr_ps(p[0].y,p[1].y,p[2].y,p[3].y),
+                                               q.lower.y,q.scale.y,q.maxCell);
+          const __m128i z = mortonQuantize_sse(_mm_setr_ps(p[0].z,p[1].z,p[2].z,p[3].z),
+                                               q.lower.z,q.scale.z,q.maxCell);
+          const __m128i code
+            = _mm_or_si128(mortonExpandBits30_sse(x),
+                           _mm_or_si128(_mm_slli_epi32(mortonExpandBits30_sse(y),1),
+                                        _mm_slli_epi32(mortonExpandBits30_sse(z),2)));
+          _mm_storeu_si128((__m128i*)(codes+i),code);
+        }
+        for (;i<end;i++)
+          codes[i] = mortonEncode30(q(points[i]));
+      }
+#endif
+    } // ::owl::common::detail
+
+    /*! computes 30-bit morton codes for 'count' points, quantized
+        relative to the given bounds */
+    inline void computeMortonCodes(uint32_t *codes,
+                                   const vec3f *points,
+                                   size_t count,
+                                   const box3f &bounds)
+    {
+      const MortonQuantizer quantizer(bounds,10);
+      parallel_for_blocked
+        (0,count,detail::MORTON_BLOCK_SIZE,[&](size_t begin, size_t end){
+#if OWL_HAVE_SSE2_MORTON
+          detail::mortonEncode30_sse(codes,points,begin,end,quantizer);
+#else
+          for (size_t i=begin;i<end;i++)
+            codes[i] = mortonEncode30(quantizer(points[i]));
+#endif
+        });
+    }
+
+    /*! computes 63-bit morton codes for 'count' points, quantized
+        relative to the given bounds */
+    inline void computeMortonCodes(uint64_t *codes,
+                                   const vec3f *points,
+                                   size_t count,
+                                   const box3f &bounds)
+    {
+      const MortonQuantizer quantizer(bounds,21);
+      parallel_for_blocked
+        (0,count,detail::MORTON_BLOCK_SIZE,[&](size_t begin, size_t end){
+#if OWL_HAVE_BMI2_MORTON && !defined(OWL_DISABLE_BMI2_MORTON)
+          if (detail::cpuHasBMI2()) {
+            detail::mortonEncode63_bmi2(codes,points,begin,end,quantizer);
+            return;
+          }
+#endif
+          for (size_t i=begin;i<end;i++)
+            codes[i] = mortonEncode63(quantizer(points[i]));
+        });
+    }
+
+    /*! computes 30-bit hilbert indices for 'count' points, quantized
+        relative to the given bounds */
+    inline void computeHilbertCodes(uint32_t *codes,
+                                    const vec3f *points,
+                                    size_t count,
+                                    const box3f &bounds)
+    {
+      const MortonQuantizer quantizer(bounds,10);
+      parallel_for_blocked
+        (0,count,detail::MORTON_BLOCK_SIZE,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            codes[i] = hilbertEncode30(quantizer(points[i]));
+        });
+    }
+
+    /*! computes 63-bit hilbert indices for 'count' points, quantized
+        relative to the given bounds */
+    inline void computeHilbertCodes(uint64_t *codes,
+                                    const vec3f *points,
+                                    size_t count,
+                                    const box3f &bounds)
+    {
+      const MortonQuantizer quantizer(bounds,21);
+      parallel_for_blocked
+        (0,count,detail::MORTON_BLOCK_SIZE,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            codes[i] = hilbertEncode63(quantizer(points[i]));
+        });
+    }
+
+    /*! computes the bounds of a set of points, eg, to then pass to
+        computeMortonCodes */
+    inline box3f computeBounds(const vec3f *points, size_t count)
+    {
+      box3f bounds;
+      std::mutex mutex;
+      parallel_for_blocked
+        (0,count,detail::MORTON_BLOCK_SIZE,[&](size_t begin, size_t end){
+          box3f blockBounds;
+          for (size_t i=begin;i<end;i++)
+            blockBounds.extend(points[i]);
+          std::lock_guard<std::mutex> lock(mutex);
+          bounds.extend(blockBounds);
+        });
+      return bounds;
+    }
+#endif
+
+  } // ::owl::common
+} // ::owl
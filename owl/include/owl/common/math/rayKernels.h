@@ -0,0 +1,656 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/math/rayKernels.h Host-side ray/box and
+    ray/triangle intersection kernels, for ray casting on the CPU
+    (validating renders without a GPU, picking, baking, ...).
+
+    Single rays test two boxes at a time with SSE (which is what a
+    binary BVH needs), and intersect triangles with either
+    Moeller-Trumbore, or the watertight test of Woop et al. ("Watertight
+    Ray/Triangle Intersection", JCGT 2013) that never lets a ray slip
+    through a shared edge or vertex.
+
+    RayPacket8 holds 8 rays in SoA layout; the packet kernels use AVX2
+    if the CPU has it (checked at runtime, the rest of the code does
+    not need to be compiled for AVX2), and plain loops otherwise.
+
+    Closest-hit conventions are the same for rays and packets: on a
+    hit, the kernels shrink the ray's tmax to the hit distance, and
+    update the HostHit(s).
+
+    Host only; do not include this from device code. */
+
+#pragma once
+
+#include "owl/common/math/box.h"
+#include <limits>
+#include <utility>
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && !defined(__CUDACC__)
+# include <immintrin.h>
+# define OWL_HAVE_SSE2_RAYS 1
+# if defined(__GNUC__) || defined(__clang__)
+/* AVX2 is not part of the x86-64 baseline; compile only the packet
+   kernels for it, and check at runtime if the CPU supports it. Note
+   this is "avx2" without "fma", so results match the scalar code */
+#  define OWL_HAVE_AVX2_RAYS 1
+#  define OWL_TARGET_AVX2 __attribute__((target("avx2")))
+# elif defined(__AVX2__)
+#  define OWL_HAVE_AVX2_RAYS 1
+#  define OWL_TARGET_AVX2 /* enabled for entire file */
+# endif
+#endif
+
+namespace owl {
+  namespace common {
+
+    struct HostRay {
+      HostRay() = default;
+      HostRay(const vec3f &origin, const vec3f &direction,
+              float tmin = 0.f,
+              float tmax = std::numeric_limits<float>::infinity())
+        : origin(origin), tmin(tmin), direction(direction), tmax(tmax)
+      {}
+
+      vec3f origin;
+      float tmin = 0.f;
+      vec3f direction;
+      /*! for closest-hit queries, the distance to the closest hit so
+          far */
+      float tmax = std::numeric_limits<float>::infinity();
+    };
+
+    struct HostHit {
+      /*! -1 if nothing got hit */
+      int   primID = -1;
+      /*! barycentrics of the hit point, for vertex 1 and vertex 2 of
+          the triangle */
+      float u = 0.f, v = 0.f;
+    };
+
+    /*! 8 rays in SoA layout; tmax works like HostRay::tmax */
+    struct alignas(32) RayPacket8 {
+      inline void    set(int lane, const HostRay &ray);
+      inline HostRay get(int lane) const;
+
+      float orgX[8], orgY[8], orgZ[8];
+      float dirX[8], dirY[8], dirZ[8];
+      float tmin[8], tmax[8];
+    };
+
+    struct alignas(32) HitPacket8 {
+      inline void    clear() { for (int i=0;i<8;i++) { primID[i] = -1; u[i] = v[i] = 0.f; } }
+      inline HostHit get(int lane) const;
+
+      int   primID[8];
+      float u[8], v[8];
+    };
+
+    inline void RayPacket8::set(int lane, const HostRay &ray)
+    {
+      orgX[lane] = ray.origin.x;    orgY[lane] = ray.origin.y;    orgZ[lane] = ray.origin.z;
+      dirX[lane] = ray.direction.x; dirY[lane] = ray.direction.y; dirZ[lane] = ray.direction.z;
+      tmin[lane] = ray.tmin;
+      tmax[lane] = ray.tmax;
+    }
+
+    inline HostRay RayPacket8::get(int lane) const
+    {
+      return HostRay(vec3f(orgX[lane],orgY[lane],orgZ[lane]),
+                     vec3f(dirX[lane],dirY[lane],dirZ[lane]),
+                     tmin[lane],tmax[lane]);
+    }
+
+    inline HostHit HitPacket8::get(int lane) const
+    {
+      HostHit hit;
+      hit.primID = primID[lane];
+      hit.u      = u[lane];
+      hit.v      = v[lane];
+      return hit;
+    }
+
+    /*! reciprocal of a ray direction's component; zero maps to a
+        (finite) huge value with the right sign, so slab tests never
+        compute 0*inf */
+    inline float safeRcp(float f)
+    {
+      const float huge = 1e30f;
+      return f == 0.f ? (std::signbit(f) ? -huge : huge) : 1.f/f;
+    }
+
+    // ==================================================================
+    // ray/box
+    // ==================================================================
+
+    /*! rounding in the slab test can make a ray miss a box it grazes
+        (in particular, a flat one). Scaling the exit distance by
+        1+2*gamma(3) makes the test conservative; see Ize, "Robust
+        BVH Ray Traversal", JCGT 2013 */
+    static const float rayBoxExitScale = 1.f+2.f*(3.f*0.5f*std::numeric_limits<float>::epsilon())
+                                              /(1.f-3.f*0.5f*std::numeric_limits<float>::epsilon());
+
+    /*! what a ray needs for slab tests against many boxes */
+    struct RayBoxTest {
+      RayBoxTest(const HostRay &ray)
+        : org(ray.origin),
+          rcpDir(safeRcp(ray.direction.x),safeRcp(ray.direction.y),safeRcp(ray.direction.z))
+      {
+        for (int axis=0;axis<3;axis++)
+          dirIsNeg[axis] = rcpDir[axis] < 0.f;
+      }
+
+      vec3f org, rcpDir;
+      /*! for each axis, whether a box's upper rather than lower plane
+          is the one the ray enters through */
+      bool  dirIsNeg[3];
+    };
+
+    /*! slab test; returns whether [tmin,tmax] overlaps the box, and
+        where the ray enters it */
+    inline bool intersectBox(const RayBoxTest &ray, const box3f &box,
+                             float tmin, float tmax, float &tNear)
+    {
+      for (int axis=0;axis<3;axis++) {
+        const float t0 = ((ray.dirIsNeg[axis] ? box.upper : box.lower)[axis]-ray.org[axis])*ray.rcpDir[axis];
+        const float t1 = ((ray.dirIsNeg[axis] ? box.lower : box.upper)[axis]-ray.org[axis])*ray.rcpDir[axis];
+        tmin = std::max(tmin,t0);
+        tmax = std::min(tmax,t1*rayBoxExitScale);
+      }
+      tNear = tmin;
+      return tmin <= tmax;
+    }
+
+    /*! tests two boxes at once; returns a bit mask of which ones got
+        hit, and writes their entry distances to tNear[] */
+    inline int intersectBoxPair(const RayBoxTest &ray,
+                                const vec3f &lower0, const vec3f &upper0,
+                                const vec3f &lower1, const vec3f &upper1,
+                                float tmin, float tmax, float tNear[2])
+    {
+#if OWL_HAVE_SSE2_RAYS
+      // per axis, lanes are (near plane of box 0, of box 1, far plane
+      // of box 0, of box 1)
+      __m128 tEnter = _mm_setr_ps(tmin,tmin,-tmax,-tmax);
+      for (int axis=0;axis<3;axis++) {
+        const vec3f &near0 = ray.dirIsNeg[axis] ? upper0 : lower0;
+        const vec3f &near1 = ray.dirIsNeg[axis] ? upper1 : lower1;
+        const vec3f &far0  = ray.dirIsNeg[axis] ? lower0 : upper0;
+        const vec3f &far1  = ray.dirIsNeg[axis] ? lower1 : upper1;
+        const __m128 planes = _mm_setr_ps(near0[axis],near1[axis],far0[axis],far1[axis]);
+        const __m128 t
+          = _mm_mul_ps(_mm_sub_ps(planes,_mm_set1_ps(ray.org[axis])),
+                       _mm_set1_ps(ray.rcpDir[axis]));
+        // negating the far distances turns min() into max(), so all
+        // four lanes can use the same instruction
+        tEnter = _mm_max_ps(tEnter,_mm_mul_ps(t,_mm_setr_ps(1.f,1.f,-rayBoxExitScale,-rayBoxExitScale)));
+      }
+      const __m128 tExit = _mm_xor_ps(_mm_movehl_ps(tEnter,tEnter),_mm_set1_ps(-0.f));
+      const int mask = _mm_movemask_ps(_mm_cmple_ps(tEnter,tExit)) & 3;
+      tNear[0] = _mm_cvtss_f32(tEnter);
+      tNear[1] = _mm_cvtss_f32(_mm_shuffle_ps(tEnter,tEnter,_MM_SHUFFLE(1,1,1,1)));
+      return mask;
+#else
+      return
+        (intersectBox(ray,box3f(lower0,upper0),tmin,tmax,tNear[0]) ? 1 : 0) |
+        (intersectBox(ray,box3f(lower1,upper1),tmin,tmax,tNear[1]) ? 2 : 0);
+#endif
+    }
+
+    // ==================================================================
+    // ray/triangle
+    // ==================================================================
+
+    /*! Moeller-Trumbore; returns true (and updates ray.tmax and hit)
+        if the ray hits the triangle in [tmin,tmax) */
+    inline bool intersectTriangle(HostRay &ray, HostHit &hit,
+                                  const vec3f &v0, const vec3f &v1, const vec3f &v2,
+                                  int primID)
+    {
+      const vec3f e1  = v1-v0;
+      const vec3f e2  = v2-v0;
+      const vec3f p   = cross(ray.direction,e2);
+      const float det = dot(e1,p);
+      if (det == 0.f) return false;
+      const float rcpDet = 1.f/det;
+      const vec3f s = ray.origin-v0;
+      const float u = dot(s,p)*rcpDet;
+      if (!(u >= 0.f && u <= 1.f)) return false;
+      const vec3f q = cross(s,e1);
+      const float v = dot(ray.direction,q)*rcpDet;
+      if (!(v >= 0.f && u+v <= 1.f)) return false;
+      const float t = dot(e2,q)*rcpDet;
+      if (!(t >= ray.tmin && t < ray.tmax)) return false;
+      ray.tmax   = t;
+      hit.primID = primID;
+      hit.u      = u;
+      hit.v      = v;
+      return true;
+    }
+
+    /*! per-ray set-up of the watertight test: the ray direction's
+        dominant axis becomes 'z', and x/y get sheared such that the
+        ray points along z */
+    struct WatertightRay {
+      WatertightRay(const HostRay &ray)
+      {
+        const vec3f &d = ray.direction;
+        kz = arg_max(abs(d));
+        kx = (kz+1)%3;
+        ky = (kx+1)%3;
+        // keep the winding (and thus the signs of U,V,W) the same
+        if (d[kz] < 0.f) std::swap(kx,ky);
+        Sx = d[kx]/d[kz];
+        Sy = d[ky]/d[kz];
+        Sz = 1.f/d[kz];
+      }
+
+      int   kx, ky, kz;
+      float Sx, Sy, Sz;
+    };
+
+    namespace detail {
+      /*! the watertight test's edge functions, in double precision,
+          for when the float ones come out exactly zero */
+      inline void watertightEdgesDouble(float Ax, float Ay, float Bx, float By,
+                                        float Cx, float Cy,
+                                        float &U, float &V, float &W)
+      {
+        U = float(double(Cx)*double(By)-double(Cy)*double(Bx));
+        V = float(double(Ax)*double(Cy)-double(Ay)*double(Cx));
+        W = float(double(Bx)*double(Ay)-double(By)*double(Ax));
+      }
+    }
+
+    /*! watertight ray/triangle test; same conventions as the
+        Moeller-Trumbore intersectTriangle() */
+    inline bool intersectTriangle(HostRay &ray, const WatertightRay &wt, HostHit &hit,
+                                  const vec3f &v0, const vec3f &v1, const vec3f &v2,
+                                  int primID)
+    {
+      const vec3f A = v0-ray.origin;
+      const vec3f B = v1-ray.origin;
+      const vec3f C = v2-ray.origin;
+      const float Ax = A[wt.kx]-wt.Sx*A[wt.kz];
+      const float Ay = A[wt.ky]-wt.Sy*A[wt.kz];
+      const float Bx = B[wt.kx]-wt.Sx*B[wt.kz];
+      const float By = B[wt.ky]-wt.Sy*B[wt.kz];
+      const float Cx = C[wt.kx]-wt.Sx*C[wt.kz];
+      const float Cy = C[wt.ky]-wt.Sy*C[wt.kz];
+      float U = Cx*By-Cy*Bx;
+      float V = Ax*Cy-Ay*Cx;
+      float W = Bx*Ay-By*Ax;
+      if (U == 0.f || V == 0.f || W == 0.f)
+        detail::watertightEdgesDouble(Ax,Ay,Bx,By,Cx,Cy,U,V,W);
+      if ((U < 0.f || V < 0.f || W < 0.f) && (U > 0.f || V > 0.f || W > 0.f))
+        return false;
+      const float det = U+V+W;
+      if (det == 0.f) return false;
+      const float T = U*(wt.Sz*A[wt.kz]) + V*(wt.Sz*B[wt.kz]) + W*(wt.Sz*C[wt.kz]);
+      const float rcpDet = 1.f/det;
+      const float t = T*rcpDet;
+      if (!(t >= ray.tmin && t < ray.tmax)) return false;
+      ray.tmax   = t;
+      hit.primID = primID;
+      hit.u      = V*rcpDet;
+      hit.v      = W*rcpDet;
+      return true;
+    }
+
+    // ==================================================================
+    // 8-wide packets
+    // ==================================================================
+
+    namespace detail {
+
+      inline bool cpuHasAVX2()
+      {
+#if OWL_HAVE_AVX2_RAYS
+# if defined(__GNUC__) || defined(__clang__)
+        static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+        return hasAVX2;
+# else
+        return true;
+# endif
+#else
+        return false;
+#endif
+      }
+
+#if OWL_HAVE_AVX2_RAYS
+      /*! a packet's per-traversal constants, in registers */
+      struct RayPacket8BoxTest_avx2 {
+        OWL_TARGET_AVX2 inline void init(const RayPacket8 &rays)
+        {
+          for (int axis=0;axis<3;axis++) {
+            const float *org = axis == 0 ? rays.orgX : axis == 1 ? rays.orgY : rays.orgZ;
+            const float *dir = axis == 0 ? rays.dirX : axis == 1 ? rays.dirY : rays.dirZ;
+            alignas(32) float r[8];
+            for (int i=0;i<8;i++) r[i] = safeRcp(dir[i]);
+            rcpDir[axis] = _mm256_load_ps(r);
+            this->org[axis] = _mm256_load_ps(org);
+          }
+          tmin = _mm256_load_ps(rays.tmin);
+        }
+
+        __m256 rcpDir[3], org[3], tmin;
+      };
+
+      /*! returns the lanes (in 'active') that hit the box in
+          [tmin,tmax], and their entry distances */
+      OWL_TARGET_AVX2
+      inline __m256 intersectBox8_avx2(const RayPacket8BoxTest_avx2 &rays,
+                                       const vec3f &lower, const vec3f &upper,
+                                       __m256 tmax, __m256 active, __m256 &tNear)
+      {
+        __m256 tEnter = rays.tmin, tExit = tmax;
+        for (int axis=0;axis<3;axis++) {
+          // (plane-org)*rcpDir, not plane*rcpDir-org*rcpDir: the
+          // latter is one op less, but rayBoxExitScale doesn't cover
+          // its rounding error
+          const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(lower[axis]),rays.org[axis]),
+                                          rays.rcpDir[axis]);
+          const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(upper[axis]),rays.org[axis]),
+                                          rays.rcpDir[axis]);
+          tEnter = _mm256_max_ps(tEnter,_mm256_min_ps(t0,t1));
+          tExit  = _mm256_min_ps(tExit, _mm256_mul_ps(_mm256_max_ps(t0,t1),
+                                                      _mm256_set1_ps(rayBoxExitScale)));
+        }
+        tNear = tEnter;
+        return _mm256_and_ps(active,_mm256_cmp_ps(tEnter,tExit,_CMP_LE_OQ));
+      }
+
+      OWL_TARGET_AVX2
+      inline __m256 activeLanes8_avx2(int mask)
+      {
+        const __m256i bits = _mm256_setr_epi32(1,2,4,8,16,32,64,128);
+        return _mm256_castsi256_ps
+          (_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(mask),bits),bits));
+      }
+
+      /*! stores the lanes where 'hit' is set */
+      OWL_TARGET_AVX2
+      inline int commitHits8_avx2(RayPacket8 &rays, HitPacket8 &hits, __m256 hit,
+                                  __m256 t, __m256 u, __m256 v, int primID)
+      {
+        _mm256_store_ps(rays.tmax,_mm256_blendv_ps(_mm256_load_ps(rays.tmax),t,hit));
+        _mm256_store_ps(hits.u,_mm256_blendv_ps(_mm256_load_ps(hits.u),u,hit));
+        _mm256_store_ps(hits.v,_mm256_blendv_ps(_mm256_load_ps(hits.v),v,hit));
+        _mm256_store_si256((__m256i*)hits.primID,
+                           _mm256_castps_si256
+                           (_mm256_blendv_ps(_mm256_load_ps((const float*)hits.primID),
+                                             _mm256_castsi256_ps(_mm256_set1_epi32(primID)),
+                                             hit)));
+        return _mm256_movemask_ps(hit);
+      }
+
+      /*! 8-wide Moeller-Trumbore, same math as the scalar version */
+      OWL_TARGET_AVX2
+      inline int intersectTriangle8_avx2(RayPacket8 &rays, HitPacket8 &hits, int activeMask,
+                                         const vec3f &v0, const vec3f &v1, const vec3f &v2,
+                                         int primID)
+      {
+        const vec3f e1 = v1-v0, e2 = v2-v0;
+        const __m256 dx = _mm256_load_ps(rays.dirX);
+        const __m256 dy = _mm256_load_ps(rays.dirY);
+        const __m256 dz = _mm256_load_ps(rays.dirZ);
+        const __m256 e1x = _mm256_set1_ps(e1.x), e1y = _mm256_set1_ps(e1.y), e1z = _mm256_set1_ps(e1.z);
+        const __m256 e2x = _mm256_set1_ps(e2.x), e2y = _mm256_set1_ps(e2.y), e2z = _mm256_set1_ps(e2.z);
+        // p = cross(d,e2)
+        const __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy,e2z),_mm256_mul_ps(dz,e2y));
+        const __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz,e2x),_mm256_mul_ps(dx,e2z));
+        const __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx,e2y),_mm256_mul_ps(dy,e2x));
+        const __m256 det
+          = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x,px),_mm256_mul_ps(e1y,py)),_mm256_mul_ps(e1z,pz));
+        const __m256 rcpDet = _mm256_div_ps(_mm256_set1_ps(1.f),det);
+        const __m256 sx = _mm256_sub_ps(_mm256_load_ps(rays.orgX),_mm256_set1_ps(v0.x));
+        const __m256 sy = _mm256_sub_ps(_mm256_load_ps(rays.orgY),_mm256_set1_ps(v0.y));
+        const __m256 sz = _mm256_sub_ps(_mm256_load_ps(rays.orgZ),_mm256_set1_ps(v0.z));
+        const __m256 u
+          = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx,px),_mm256_mul_ps(sy,py)),
+                                        _mm256_mul_ps(sz,pz)),rcpDet);
+        // q = cross(s,e1)
+        const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy,e1z),_mm256_mul_ps(sz,e1y));
+        const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz,e1x),_mm256_mul_ps(sx,e1z));
+        const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx,e1y),_mm256_mul_ps(sy,e1x));
+        const __m256 v
+          = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx,qx),_mm256_mul_ps(dy,qy)),
+                                        _mm256_mul_ps(dz,qz)),rcpDet);
+        const __m256 t
+          = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x,qx),_mm256_mul_ps(e2y,qy)),
+                                        _mm256_mul_ps(e2z,qz)),rcpDet);
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f);
+        __m256 hit = activeLanes8_avx2(activeMask);
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(det,zero,_CMP_NEQ_OQ));
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(u,zero,_CMP_GE_OQ));
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(u,one,_CMP_LE_OQ));
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(v,zero,_CMP_GE_OQ));
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(_mm256_add_ps(u,v),one,_CMP_LE_OQ));
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(t,_mm256_load_ps(rays.tmin),_CMP_GE_OQ));
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(t,_mm256_load_ps(rays.tmax),_CMP_LT_OQ));
+        if (_mm256_testz_ps(hit,hit)) return 0;
+        return commitHits8_avx2(rays,hits,hit,t,u,v,primID);
+      }
+
+      /*! picks, per lane, component 0, 1, or 2 of (x,y,z) */
+      OWL_TARGET_AVX2
+      inline __m256 select3_avx2(__m256i k, __m256 x, __m256 y, __m256 z)
+      {
+        const __m256 is0 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(k,_mm256_setzero_si256()));
+        const __m256 is1 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(k,_mm256_set1_epi32(1)));
+        return _mm256_blendv_ps(_mm256_blendv_ps(z,y,is1),x,is0);
+      }
+
+      /*! a packet's watertight set-up, see WatertightRay */
+      struct WatertightRay8_avx2 {
+        OWL_TARGET_AVX2 inline void init(const RayPacket8 &rays)
+        {
+          alignas(32) int32_t k[3][8];
+          alignas(32) float   s[3][8];
+          for (int i=0;i<8;i++) {
+            const WatertightRay wt(rays.get(i));
+            k[0][i] = wt.kx; k[1][i] = wt.ky; k[2][i] = wt.kz;
+            s[0][i] = wt.Sx; s[1][i] = wt.Sy; s[2][i] = wt.Sz;
+          }
+          kx = _mm256_load_si256((const __m256i*)k[0]);
+          ky = _mm256_load_si256((const __m256i*)k[1]);
+          kz = _mm256_load_si256((const __m256i*)k[2]);
+          Sx = _mm256_load_ps(s[0]);
+          Sy = _mm256_load_ps(s[1]);
+          Sz = _mm256_load_ps(s[2]);
+        }
+
+        __m256i kx, ky, kz;
+        __m256  Sx, Sy, Sz;
+      };
+
+      /*! 8-wide watertight test; lanes whose edge functions come out
+          exactly zero fall back to the scalar (double precision)
+          path */
+      OWL_TARGET_AVX2
+      inline int intersectTriangle8_avx2(RayPacket8 &rays, const WatertightRay8_avx2 &wt,
+                                         HitPacket8 &hits, int activeMask,
+                                         const vec3f &v0, const vec3f &v1, const vec3f &v2,
+                                         int primID)
+      {
+        const __m256 ox = _mm256_load_ps(rays.orgX);
+        const __m256 oy = _mm256_load_ps(rays.orgY);
+        const __m256 oz = _mm256_load_ps(rays.orgZ);
+        __m256 proj[3][3];
+        const vec3f *vtx[3] = { &v0, &v1, &v2 };
+        for (int i=0;i<3;i++) {
+          const __m256 x = _mm256_sub_ps(_mm256_set1_ps(vtx[i]->x),ox);
+          const __m256 y = _mm256_sub_ps(_mm256_set1_ps(vtx[i]->y),oy);
+          const __m256 z = _mm256_sub_ps(_mm256_set1_ps(vtx[i]->z),oz);
+          const __m256 pz = select3_avx2(wt.kz,x,y,z);
+          proj[i][0] = _mm256_sub_ps(select3_avx2(wt.kx,x,y,z),_mm256_mul_ps(wt.Sx,pz));
+          proj[i][1] = _mm256_sub_ps(select3_avx2(wt.ky,x,y,z),_mm256_mul_ps(wt.Sy,pz));
+          proj[i][2] = _mm256_mul_ps(wt.Sz,pz);
+        }
+        const __m256 Ax = proj[0][0], Ay = proj[0][1];
+        const __m256 Bx = proj[1][0], By = proj[1][1];
+        const __m256 Cx = proj[2][0], Cy = proj[2][1];
+        const __m256 U = _mm256_sub_ps(_mm256_mul_ps(Cx,By),_mm256_mul_ps(Cy,Bx));
+        const __m256 V = _mm256_sub_ps(_mm256_mul_ps(Ax,Cy),_mm256_mul_ps(Ay,Cx));
+        const __m256 W = _mm256_sub_ps(_mm256_mul_ps(Bx,Ay),_mm256_mul_ps(By,Ax));
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 active = activeLanes8_avx2(activeMask);
+
+        const __m256 anyZero
+          = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(U,zero,_CMP_EQ_OQ),_mm256_cmp_ps(V,zero,_CMP_EQ_OQ)),
+                         _mm256_cmp_ps(W,zero,_CMP_EQ_OQ));
+        const int scalarLanes = _mm256_movemask_ps(_mm256_and_ps(active,anyZero));
+
+        const __m256 anyNeg
+          = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(U,zero,_CMP_LT_OQ),_mm256_cmp_ps(V,zero,_CMP_LT_OQ)),
+                         _mm256_cmp_ps(W,zero,_CMP_LT_OQ));
+        const __m256 anyPos
+          = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(U,zero,_CMP_GT_OQ),_mm256_cmp_ps(V,zero,_CMP_GT_OQ)),
+                         _mm256_cmp_ps(W,zero,_CMP_GT_OQ));
+        const __m256 det = _mm256_add_ps(_mm256_add_ps(U,V),W);
+        const __m256 T
+          = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(U,proj[0][2]),_mm256_mul_ps(V,proj[1][2])),
+                          _mm256_mul_ps(W,proj[2][2]));
+        const __m256 rcpDet = _mm256_div_ps(_mm256_set1_ps(1.f),det);
+        const __m256 t = _mm256_mul_ps(T,rcpDet);
+        __m256 hit = _mm256_andnot_ps(anyZero,active);
+        hit = _mm256_andnot_ps(_mm256_and_ps(anyNeg,anyPos),hit);
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(det,zero,_CMP_NEQ_OQ));
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(t,_mm256_load_ps(rays.tmin),_CMP_GE_OQ));
+        hit = _mm256_and_ps(hit,_mm256_cmp_ps(t,_mm256_load_ps(rays.tmax),_CMP_LT_OQ));
+        int hitMask = 0;
+        if (!_mm256_testz_ps(hit,hit))
+          hitMask = commitHits8_avx2(rays,hits,hit,t,
+                                     _mm256_mul_ps(V,rcpDet),_mm256_mul_ps(W,rcpDet),primID);
+        for (int lane=0;lane<8;lane++) {
+          if (!(scalarLanes & (1<<lane))) continue;
+          HostRay ray = rays.get(lane);
+          HostHit laneHit = hits.get(lane);
+          if (!intersectTriangle(ray,WatertightRay(ray),laneHit,v0,v1,v2,primID)) continue;
+          rays.tmax[lane]    = ray.tmax;
+          hits.primID[lane]  = laneHit.primID;
+          hits.u[lane]       = laneHit.u;
+          hits.v[lane]       = laneHit.v;
+          hitMask |= (1<<lane);
+        }
+        return hitMask;
+      }
+#endif
+    } // ::owl::common::detail
+
+#if OWL_HAVE_AVX2_RAYS
+    namespace detail {
+      OWL_TARGET_AVX2
+      inline int intersectBox8_avx2(const RayPacket8 &rays, int activeMask,
+                                    const box3f &box, float tNear[8])
+      {
+        RayPacket8BoxTest_avx2 test;
+        test.init(rays);
+        __m256 tn;
+        const __m256 hit
+          = intersectBox8_avx2(test,box.lower,box.upper,_mm256_load_ps(rays.tmax),
+                               activeLanes8_avx2(activeMask),tn);
+        _mm256_storeu_ps(tNear,tn);
+        return _mm256_movemask_ps(hit);
+      }
+
+      OWL_TARGET_AVX2
+      inline int intersectTriangle8Watertight_avx2(RayPacket8 &rays, HitPacket8 &hits,
+                                                   int activeMask,
+                                                   const vec3f &v0, const vec3f &v1,
+                                                   const vec3f &v2, int primID)
+      {
+        WatertightRay8_avx2 wt;
+        wt.init(rays);
+        return intersectTriangle8_avx2(rays,wt,hits,activeMask,v0,v1,v2,primID);
+      }
+    }
+#endif
+
+    /*! box test for the active lanes of a packet; returns the lanes
+        that hit (writing their entry distances to tNear[]) */
+    inline int intersectBox8(const RayPacket8 &rays, int activeMask,
+                             const box3f &box, float tNear[8])
+    {
+#if OWL_HAVE_AVX2_RAYS
+      if (detail::cpuHasAVX2())
+        return detail::intersectBox8_avx2(rays,activeMask,box,tNear);
+#endif
+      int hitMask = 0;
+      for (int lane=0;lane<8;lane++) {
+        if (!(activeMask & (1<<lane))) continue;
+        const HostRay ray = rays.get(lane);
+        if (intersectBox(RayBoxTest(ray),box,ray.tmin,ray.tmax,tNear[lane]))
+          hitMask |= (1<<lane);
+      }
+      return hitMask;
+    }
+
+    /*! Moeller-Trumbore for the active lanes of a packet; returns the
+        lanes that hit (and updates their tmax and hit) */
+    inline int intersectTriangle8(RayPacket8 &rays, HitPacket8 &hits, int activeMask,
+                                  const vec3f &v0, const vec3f &v1, const vec3f &v2,
+                                  int primID)
+    {
+#if OWL_HAVE_AVX2_RAYS
+      if (detail::cpuHasAVX2())
+        return detail::intersectTriangle8_avx2(rays,hits,activeMask,v0,v1,v2,primID);
+#endif
+      int hitMask = 0;
+      for (int lane=0;lane<8;lane++) {
+        if (!(activeMask & (1<<lane))) continue;
+        HostRay ray = rays.get(lane);
+        HostHit hit = hits.get(lane);
+        if (!intersectTriangle(ray,hit,v0,v1,v2,primID)) continue;
+        rays.tmax[lane]   = ray.tmax;
+        hits.primID[lane] = hit.primID;
+        hits.u[lane]      = hit.u;
+        hits.v[lane]      = hit.v;
+        hitMask |= (1<<lane);
+      }
+      return hitMask;
+    }
+
+    /*! watertight test for the active lanes of a packet; same
+        conventions as intersectTriangle8(). Each call re-does the
+        packet's set-up, traversal code that tests many triangles
+        should do that once instead */
+    inline int intersectTriangle8Watertight(RayPacket8 &rays, HitPacket8 &hits, int activeMask,
+                                            const vec3f &v0, const vec3f &v1, const vec3f &v2,
+                                            int primID)
+    {
+#if OWL_HAVE_AVX2_RAYS
+      if (detail::cpuHasAVX2())
+        return detail::intersectTriangle8Watertight_avx2(rays,hits,activeMask,v0,v1,v2,primID);
+#endif
+      int hitMask = 0;
+      for (int lane=0;lane<8;lane++) {
+        if (!(activeMask & (1<<lane))) continue;
+        HostRay ray = rays.get(lane);
+        HostHit hit = hits.get(lane);
+        if (!intersectTriangle(ray,WatertightRay(ray),hit,v0,v1,v2,primID)) continue;
+        rays.tmax[lane]   = ray.tmax;
+        hits.primID[lane] = hit.primID;
+        hits.u[lane]      = hit.u;
+        hits.v[lane]      = hit.v;
+        hitMask |= (1<<lane);
+      }
+      return hitMask;
+    }
+
+  } // ::owl::common
+} // ::owl
@@ -0,0 +1,117 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/math/rayReorder.h Reordering of (incoherent) ray
+    batches for better traversal coherence: rays get sorted by the
+    octant of their direction first, and by the 30-bit morton code of
+    their origin (quantized within the scene bounds) second, with the
+    parallel radix sort from owl/common/parallel/radixSort.h. The
+    resulting permutation is kept, to gather rays into sorted order
+    before tracing, and to scatter results back into the original
+    order afterwards.
+
+    Host only; do not include this from device code. */
+
+#pragma once
+
+#include "owl/common/math/morton.h"
+#include "owl/common/math/rayKernels.h"
+#include "owl/common/parallel/radixSort.h"
+#include <stdexcept>
+
+namespace owl {
+  namespace common {
+
+    /*! 3 bits direction octant, above 30 bits morton code of the
+        origin */
+    inline uint64_t rayCoherenceKey(const MortonQuantizer &quantizer,
+                                    const vec3f &origin, const vec3f &direction)
+    {
+      const uint64_t octant
+        = (direction.x < 0.f ? 1 : 0)
+        | (direction.y < 0.f ? 2 : 0)
+        | (direction.z < 0.f ? 4 : 0);
+      return (octant << 30) | mortonEncode30(quantizer(origin));
+    }
+
+    struct RayReorder {
+      enum { NUM_KEY_BITS = 33, BLOCK_SIZE = 16*1024 };
+
+      /*! computes the permutation for 'numRays' rays, with
+          getRay(rayID) returning a HostRay (or anything else with an
+          'origin' and a 'direction'); origins outside 'sceneBounds'
+          get clamped to it */
+      template<typename GetRayT>
+      inline void compute(size_t numRays, const box3f &sceneBounds, const GetRayT &getRay);
+
+      inline void compute(const HostRay *rays, size_t numRays, const box3f &sceneBounds)
+      { compute(numRays,sceneBounds,[rays](size_t rayID){ return rays[rayID]; }); }
+
+      inline size_t size() const { return permutation.size(); }
+
+      /*! sorted[i] = inOriginalOrder[permutation[i]] */
+      template<typename T>
+      inline void gather(T *sorted, const T *inOriginalOrder) const;
+
+      /*! inOriginalOrder[permutation[i]] = sorted[i] */
+      template<typename T>
+      inline void scatter(T *inOriginalOrder, const T *sorted) const;
+
+      /*! for each position in sorted order, the ID of the ray that
+          goes there */
+      std::vector<uint32_t> permutation;
+    };
+
+    template<typename GetRayT>
+    inline void RayReorder::compute(size_t numRays, const box3f &sceneBounds,
+                                    const GetRayT &getRay)
+    {
+      if (numRays > size_t(std::numeric_limits<uint32_t>::max()))
+        throw std::runtime_error("#owl: too many rays to reorder");
+
+      const MortonQuantizer quantizer(sceneBounds,10);
+      std::vector<uint64_t> keys(numRays);
+      permutation.resize(numRays);
+      parallel_for_blocked(0,numRays,BLOCK_SIZE,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            const auto ray = getRay(i);
+            keys[i] = rayCoherenceKey(quantizer,ray.origin,ray.direction);
+            permutation[i] = uint32_t(i);
+          }
+        });
+      radixSort(keys.data(),permutation.data(),numRays,NUM_KEY_BITS);
+    }
+
+    template<typename T>
+    inline void RayReorder::gather(T *sorted, const T *inOriginalOrder) const
+    {
+      parallel_for_blocked(0,permutation.size(),BLOCK_SIZE,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            sorted[i] = inOriginalOrder[permutation[i]];
+        });
+    }
+
+    template<typename T>
+    inline void RayReorder::scatter(T *inOriginalOrder, const T *sorted) const
+    {
+      parallel_for_blocked(0,permutation.size(),BLOCK_SIZE,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            inOriginalOrder[permutation[i]] = sorted[i];
+        });
+    }
+
+  } // ::owl::common
+} // ::owl
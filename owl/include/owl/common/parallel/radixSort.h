@@ -0,0 +1,106 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/parallel/radixSort.h Host-side parallel LSD radix
+    sort of key/value pairs, for unsigned integer keys: each pass
+    builds per-block digit histograms in parallel, prefix-sums them,
+    and then scatters each block in parallel, which keeps the sort
+    stable. Passes in which all keys have the same digit get
+    skipped. */
+
+#pragma once
+
+#include "owl/common/parallel/parallel_for.h"
+#include <algorithm>
+#include <vector>
+
+namespace owl {
+  namespace common {
+
+    namespace detail {
+      enum { RADIX_SORT_BITS_PER_PASS = 11,
+             RADIX_SORT_NUM_BUCKETS   = 1<<RADIX_SORT_BITS_PER_PASS,
+             RADIX_SORT_BLOCK_SIZE    = 64*1024 };
+    }
+
+    /*! stably sorts 'keys' - and 'values' along with them - by the
+        lower 'numKeyBits' bits of the keys (all other bits must be
+        zero) */
+    template<typename KeyT, typename ValueT>
+    inline void radixSort(KeyT *keys, ValueT *values, size_t count,
+                          int numKeyBits = 8*sizeof(KeyT))
+    {
+      using namespace detail;
+      const size_t numBlocks = (count+RADIX_SORT_BLOCK_SIZE-1)/RADIX_SORT_BLOCK_SIZE;
+      std::vector<KeyT>   tmpKeys(count);
+      std::vector<ValueT> tmpValues(count);
+      // [blockID*RADIX_SORT_NUM_BUCKETS+digit]
+      std::vector<size_t> offsets(numBlocks*RADIX_SORT_NUM_BUCKETS);
+
+      KeyT   *srcKeys = keys,   *dstKeys = tmpKeys.data();
+      ValueT *srcValues = values, *dstValues = tmpValues.data();
+      for (int shift=0;shift<numKeyBits;shift+=RADIX_SORT_BITS_PER_PASS) {
+        const KeyT digitMask = KeyT(RADIX_SORT_NUM_BUCKETS-1);
+        // per-block histograms ...
+        parallel_for(numBlocks,[&](size_t blockID){
+            size_t *histogram = offsets.data()+blockID*RADIX_SORT_NUM_BUCKETS;
+            std::fill(histogram,histogram+RADIX_SORT_NUM_BUCKETS,size_t(0));
+            const size_t begin = blockID*RADIX_SORT_BLOCK_SIZE;
+            const size_t end   = std::min(begin+RADIX_SORT_BLOCK_SIZE,count);
+            for (size_t i=begin;i<end;i++)
+              histogram[(srcKeys[i] >> shift) & digitMask]++;
+          });
+
+        // ... turned into where each block's keys of each digit go
+        size_t sum = 0;
+        bool allSameDigit = false;
+        for (int digit=0;digit<RADIX_SORT_NUM_BUCKETS;digit++) {
+          size_t digitCount = 0;
+          for (size_t blockID=0;blockID<numBlocks;blockID++) {
+            size_t &offset = offsets[blockID*RADIX_SORT_NUM_BUCKETS+digit];
+            const size_t blockCount = offset;
+            offset = sum;
+            sum += blockCount;
+            digitCount += blockCount;
+          }
+          if (digitCount == count) allSameDigit = true;
+        }
+        if (allSameDigit) continue;
+
+        parallel_for(numBlocks,[&](size_t blockID){
+            size_t *offset = offsets.data()+blockID*RADIX_SORT_NUM_BUCKETS;
+            const size_t begin = blockID*RADIX_SORT_BLOCK_SIZE;
+            const size_t end   = std::min(begin+RADIX_SORT_BLOCK_SIZE,count);
+            for (size_t i=begin;i<end;i++) {
+              const size_t pos = offset[(srcKeys[i] >> shift) & digitMask]++;
+              dstKeys[pos]   = srcKeys[i];
+              dstValues[pos] = srcValues[i];
+            }
+          });
+        std::swap(srcKeys,dstKeys);
+        std::swap(srcValues,dstValues);
+      }
+
+      if (srcKeys != keys) {
+        parallel_for_blocked(0,count,RADIX_SORT_BLOCK_SIZE,[&](size_t begin, size_t end){
+            std::copy(srcKeys+begin,srcKeys+end,keys+begin);
+            std::copy(srcValues+begin,srcValues+end,values+begin);
+          });
+      }
+    }
+
+  } // ::owl::common
+} // ::owl
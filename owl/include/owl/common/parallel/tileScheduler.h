@@ -0,0 +1,268 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file owl/common/parallel/tileScheduler.h Host-side adaptive
+    scheduling of a frame's pixels across devices of different speed
+    (or load), and compositing of the results.
+
+    The frame gets split into fixed-size tiles, in morton order; each
+    device (typically, one host thread per device, launching with
+    owlAsyncLaunch2DOnDevice()) repeatedly grabs the next batch of
+    tiles from a shared atomic queue, renders it, and reports how long
+    that took. Batches are runs of consecutive tiles - which, thanks
+    to the morton order, are spatially compact - whose length adapts
+    to each device: it's the device's throughput (an exponentially
+    weighted moving average over its batches, kept across frames)
+    times a target time per batch, so every device checks back at
+    about the same rate; and towards the end of the frame batches get
+    shorter, so no device is left with a big chunk while the others
+    are done.
+
+    TileCompositor copies rendered batches into one frame buffer.
+
+    Host only; do not include this from device code. */
+
+#pragma once
+
+#include "owl/common/math/morton.h"
+#include "owl/common/parallel/radixSort.h"
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+namespace owl {
+  namespace common {
+
+    /*! a rectangle of pixels, [lower,upper) */
+    struct Tile {
+      inline vec2i  size()      const { return upper-lower; }
+      inline size_t numPixels() const { return size_t(size().x)*size().y; }
+
+      vec2i lower, upper;
+    };
+
+    /*! a run of consecutive tiles (in the scheduler's morton order) */
+    struct TileBatch {
+      inline size_t numTiles() const { return end-begin; }
+
+      size_t begin = 0, end = 0;
+      /*! sum of the tiles' pixels */
+      size_t numPixels = 0;
+    };
+
+    struct TileSchedulerConfig {
+      /*! size of a tile; the last row/column of tiles gets clipped
+          to the frame */
+      vec2i  tileSize = vec2i(32);
+      /*! time each batch should take */
+      double targetBatchTime = 2e-3;
+      /*! weight of the latest batch in the throughput average */
+      double ewmaWeight = .25;
+      /*! first batch of a device without a throughput estimate */
+      size_t initialTilesPerBatch = 1;
+      size_t maxTilesPerBatch = 1024;
+    };
+
+    struct TileScheduler {
+      /*! per-device state; only touched by that device's own
+          nextBatch()/reportTime() calls */
+      struct Device {
+        /*! the throughput estimate; 0 until the first report */
+        double tilesPerSecond = 0.;
+        /*! for the current frame */
+        size_t numBatches = 0, numTiles = 0, numPixels = 0;
+        double busyTime = 0.;
+      };
+
+      inline TileScheduler(const vec2i &frameSize, int numDevices,
+                           const TileSchedulerConfig &config = TileSchedulerConfig());
+
+      /*! starts a new frame; all devices must be done with the
+          previous one */
+      inline void beginFrame();
+
+      /*! grabs the next batch of tiles for the given device; returns
+          false if all of the frame's tiles are taken */
+      inline bool nextBatch(int deviceID, TileBatch &batch);
+
+      /*! the given device took 'seconds' to render the batch it got
+          from its last nextBatch() */
+      inline void reportTime(int deviceID, const TileBatch &batch, double seconds);
+
+      inline const Tile &tile(size_t tileID) const { return tiles[tileID]; }
+      inline size_t numTiles() const { return tiles.size(); }
+      inline int    numDevices() const { return int(devices.size()); }
+
+      const vec2i               frameSize;
+      const TileSchedulerConfig config;
+      /*! all of the frame's tiles, in morton order */
+      std::vector<Tile>         tiles;
+      std::vector<Device>       devices;
+
+    private:
+      std::atomic<size_t> nextTile;
+    };
+
+    /*! gathers rendered tiles into one frame buffer */
+    template<typename PixelT>
+    struct TileCompositor {
+      inline TileCompositor(const vec2i &frameSize)
+        : frameSize(frameSize),
+          frameBuffer(size_t(frameSize.x)*frameSize.y),
+          numPixelsWritten(0)
+      {}
+
+      /*! copies a tile's pixels (row by row, tile.size().x pixels
+          per row) to where they go in the frame buffer; tiles may get
+          written from different threads at the same time, as long as
+          they don't overlap */
+      inline void write(const Tile &tile, const PixelT *tilePixels);
+
+      /*! writes all tiles of a batch, whose pixels are stored one
+          tile after another */
+      inline void write(const TileScheduler &scheduler, const TileBatch &batch,
+                        const PixelT *batchPixels);
+
+      /*! resets the count of written pixels for the next frame */
+      inline void beginFrame() { numPixelsWritten = 0; }
+
+      /*! whether (as many pixels as) the whole frame got written */
+      inline bool complete() const
+      { return numPixelsWritten == frameBuffer.size(); }
+
+      const vec2i         frameSize;
+      std::vector<PixelT> frameBuffer;
+
+    private:
+      std::atomic<size_t> numPixelsWritten;
+    };
+
+    // ==================================================================
+    // TileScheduler
+    // ==================================================================
+
+    inline TileScheduler::TileScheduler(const vec2i &frameSize, int numDevices,
+                                        const TileSchedulerConfig &config)
+      : frameSize(frameSize),
+        config(config),
+        devices(std::max(numDevices,0)),
+        nextTile(0)
+    {
+      if (numDevices < 1)
+        throw std::runtime_error("#owl: tile scheduler needs at least one device");
+      if (config.tileSize.x < 1 || config.tileSize.y < 1)
+        throw std::runtime_error("#owl: invalid tile size for tile scheduler");
+
+      const vec2i numTiles = divRoundUp(frameSize,config.tileSize);
+      const size_t count = size_t(max(numTiles.x,0))*max(numTiles.y,0);
+      std::vector<uint64_t> keys(count);
+      std::vector<uint32_t> order(count);
+      for (size_t i=0;i<count;i++) {
+        keys[i]  = mortonEncode63(vec3ui(uint32_t(i%numTiles.x),uint32_t(i/numTiles.x),0));
+        order[i] = uint32_t(i);
+      }
+      radixSort(keys.data(),order.data(),count);
+
+      tiles.resize(count);
+      for (size_t i=0;i<count;i++) {
+        const vec2i tileID(int(order[i]%numTiles.x),int(order[i]/numTiles.x));
+        tiles[i].lower = tileID*config.tileSize;
+        tiles[i].upper = min(tiles[i].lower+config.tileSize,frameSize);
+      }
+    }
+
+    inline void TileScheduler::beginFrame()
+    {
+      nextTile = 0;
+      for (auto &device : devices) {
+        device.numBatches = device.numTiles = device.numPixels = 0;
+        device.busyTime = 0.;
+      }
+    }
+
+    inline bool TileScheduler::nextBatch(int deviceID, TileBatch &batch)
+    {
+      const Device &device = devices[deviceID];
+      size_t wanted
+        = device.tilesPerSecond == 0.
+        ? config.initialTilesPerBatch
+        : size_t(device.tilesPerSecond*config.targetBatchTime+.5);
+
+      // towards the end of the frame, take at most half of the even
+      // share of what's left (the queue is shared, so this is an
+      // estimate: others may be taking tiles at the same time)
+      const size_t taken = nextTile.load();
+      if (taken >= tiles.size()) return false;
+      const size_t fairShare
+        = std::max(size_t(1),(tiles.size()-taken)/(2*devices.size()));
+      wanted = std::max(size_t(1),std::min(wanted,std::min(fairShare,config.maxTilesPerBatch)));
+
+      batch.begin = nextTile.fetch_add(wanted);
+      if (batch.begin >= tiles.size()) return false;
+      batch.end = std::min(batch.begin+wanted,tiles.size());
+      batch.numPixels = 0;
+      for (size_t i=batch.begin;i<batch.end;i++)
+        batch.numPixels += tiles[i].numPixels();
+      return true;
+    }
+
+    inline void TileScheduler::reportTime(int deviceID, const TileBatch &batch, double seconds)
+    {
+      Device &device = devices[deviceID];
+      device.numBatches++;
+      device.numTiles  += batch.numTiles();
+      device.numPixels += batch.numPixels;
+      device.busyTime  += seconds;
+
+      // in tiles of full size, so clipped tiles don't skew it
+      const double fullTiles
+        = double(batch.numPixels)/(double(config.tileSize.x)*config.tileSize.y);
+      const double tilesPerSecond = fullTiles/std::max(seconds,1e-9);
+      device.tilesPerSecond
+        = device.tilesPerSecond == 0.
+        ? tilesPerSecond
+        : (1.-config.ewmaWeight)*device.tilesPerSecond+config.ewmaWeight*tilesPerSecond;
+    }
+
+    // ==================================================================
+    // TileCompositor
+    // ==================================================================
+
+    template<typename PixelT>
+    inline void TileCompositor<PixelT>::write(const Tile &tile, const PixelT *tilePixels)
+    {
+      const vec2i size = tile.size();
+      for (int iy=0;iy<size.y;iy++)
+        memcpy(&frameBuffer[size_t(tile.lower.y+iy)*frameSize.x+tile.lower.x],
+               tilePixels+size_t(iy)*size.x,
+               size.x*sizeof(PixelT));
+      numPixelsWritten += tile.numPixels();
+    }
+
+    template<typename PixelT>
+    inline void TileCompositor<PixelT>::write(const TileScheduler &scheduler,
+                                              const TileBatch &batch,
+                                              const PixelT *batchPixels)
+    {
+      for (size_t i=batch.begin;i<batch.end;i++) {
+        const Tile &tile = scheduler.tile(i);
+        write(tile,batchPixels);
+        batchPixels += tile.numPixels();
+      }
+    }
+
+  } // ::owl::common
+} // ::owl
@@ -189,6 +189,39 @@ typedef enum
    OWL_BOOL2,
    OWL_BOOL3,
    OWL_BOOL4,
+
+   /* compact storage types (see owl/common/math/half.h and
+      owl/common/math/fixedpoint.h). Variables of these types get set
+      through the respective float setters (ie, owlVariableSet3f()
+      on a OWL_HALF3), and get converted when written to the SBT */
+   OWL_HALF=1100,
+   OWL_HALF2,
+   OWL_HALF3,
+   OWL_HALF4,
+
+   /*! 8-bit unsigned normalized, [0..1] */
+   OWL_UNORM8=1110,
+   OWL_UNORM8_2,
+   OWL_UNORM8_3,
+   OWL_UNORM8_4,
+
+   /*! 8-bit signed normalized, [-1..1] */
+   OWL_SNORM8=1120,
+   OWL_SNORM8_2,
+   OWL_SNORM8_3,
+   OWL_SNORM8_4,
+
+   /*! 16-bit unsigned normalized, [0..1] */
+   OWL_UNORM16=1130,
+   OWL_UNORM16_2,
+   OWL_UNORM16_3,
+   OWL_UNORM16_4,
+
+   /*! 16-bit signed normalized, [-1..1] */
+   OWL_SNORM16=1140,
+   OWL_SNORM16_2,
+   OWL_SNORM16_3,
+   OWL_SNORM16_4,
    
    /*! just another name for a 64-bit data type - unlike
      OWL_BUFFER_POINTER's (which gets translated from OWLBuffer's
@@ -282,7 +315,18 @@ typedef enum {
   OWL_TEXEL_FORMAT_RGBA8,
   OWL_TEXEL_FORMAT_RGBA32F,
   OWL_TEXEL_FORMAT_R8,
-  OWL_TEXEL_FORMAT_R32F
+  OWL_TEXEL_FORMAT_R32F,
+  /*! block compressed formats, storing 4x4 texel blocks: BC1 is
+      opaque RGB at 4 bits per texel; BC4 a single channel (red) at 4
+      bits; BC5 two channels (red, green) at 8 bits; and BC7 RGBA at
+      8 bits. Textures of these formats get created either from
+      already compressed blocks (owlTexture2DCreate), or from RGBA8
+      texels that get compressed on the host
+      (owlTexture2DCreateCompressed). Requires CUDA 11.5 or newer */
+  OWL_TEXEL_FORMAT_BC1,
+  OWL_TEXEL_FORMAT_BC4,
+  OWL_TEXEL_FORMAT_BC5,
+  OWL_TEXEL_FORMAT_BC7
 }
 OWLTexelFormat;
 
@@ -309,6 +353,61 @@ typedef enum {
 }
 OWLTextureColorSpace;
 
+/*! filters that OWL can generate mip levels with; see
+    owlTexture2DCreateMipmapped */
+typedef enum {
+  /*! plain average of the texels each texel covers */
+  OWL_MIPMAP_FILTER_BOX,
+  /*! Kaiser-windowed sinc; sharper than box, at a slightly higher
+      cost */
+  OWL_MIPMAP_FILTER_KAISER
+}
+OWLMipmapFilter;
+
+/*! severity levels of OWL's log messages; setting a given level
+  (owlLogSetLevel()) enables all messages of that level and above */
+typedef enum {
+  OWL_LOG_LEVEL_DEBUG,
+  OWL_LOG_LEVEL_INFO,
+  /*! successful completion of a step (eg, "built accel") */
+  OWL_LOG_LEVEL_OK,
+  OWL_LOG_LEVEL_WARNING,
+  OWL_LOG_LEVEL_ERROR,
+  /*! disables all logging */
+  OWL_LOG_LEVEL_NONE
+}
+OWLLogLevel;
+
+/*! what device memory gets used for; see owlContextGetMemoryUsage() */
+typedef enum {
+  /*! device and managed buffers (managed ones get counted on device
+    0; host pinned buffers live in host memory, and don't get
+    counted at all) */
+  OWL_MEMORY_BUFFER,
+  /*! texture arrays (sizes estimated from format and dimensions) */
+  OWL_MEMORY_TEXTURE,
+  /*! shader binding table records */
+  OWL_MEMORY_SBT,
+  OWL_MEMORY_LAUNCH_PARAMS,
+  /*! final (compacted) acceleration structures, instance lists, and
+    geometry data kept for them (eg, user geom bounds) */
+  OWL_MEMORY_ACCEL,
+  /*! what only lives during accel builds: temp and uncompacted
+    output buffers, and the like */
+  OWL_MEMORY_ACCEL_TEMP,
+  OWL_MEMORY_OTHER,
+  OWL_MEMORY_NUM_CATEGORIES,
+  /*! passed to queries, the sum over all categories */
+  OWL_MEMORY_ALL = OWL_MEMORY_NUM_CATEGORIES
+}
+OWLMemoryCategory;
+
+/*! user-supplied receiver of log messages, see owlLogSetCallback();
+  gets called from OWL's logging thread, never concurrently */
+typedef void (*OWLLogCallback)(OWLLogLevel level,
+                               const char *message,
+                               void *userData);
+
 // ------------------------------------------------------------------
 // device-objects - size of those _HAS_ to match the device-side
 // definition of these types
@@ -347,6 +446,18 @@ OWL_API void owlBuildSBT(OWLContext context,
 OWL_API int32_t
 owlGetDeviceCount(OWLContext context);
 
+/*! device ID that, passed to owlContextCreate(), creates a "null"
+  device: one without a GPU behind it, on which "device" memory is
+  host memory, module, program, pipeline and accel builds and launches
+  are stubbed out (though accel builds still allocate the memory
+  they'd roughly take), and SBT records and launch params still get
+  fully packed (into host memory). Null devices are for testing and
+  benchmarking the host side of owl on machines that don't have a
+  GPU; they can't be mixed with real ones. Setting the environment
+  variable OWL_BACKEND=null turns every device requested from
+  owlContextCreate() into a null device. */
+#define OWL_NULL_DEVICE -1
+
 /*! creates a new device context with the gives list of devices. 
 
   If requested device IDs list if null it implicitly refers to the
@@ -361,7 +472,10 @@ owlGetDeviceCount(OWLContext context);
   - int gpu=2;owlContextCreate(&gpu,1) will create a context on GPU #2
   (where 2 refers to the CUDA device ordinal; from that point on, from
   owl's standpoint (eg, during owlBufferGetPointer() this GPU will
-  from that point on be known as device #0 */
+  from that point on be known as device #0
+
+  - int dev=OWL_NULL_DEVICE;owlContextCreate(&dev,1) will create a
+  context on one null device (see OWL_NULL_DEVICE) */
 OWL_API OWLContext
 owlContextCreate(int32_t *requestedDeviceIDs OWL_IF_CPP(=nullptr),
                  int numDevices OWL_IF_CPP(=0));
@@ -425,6 +539,112 @@ owlContextDestroy(OWLContext context);
 OWL_API CUstream
 owlContextGetStream(OWLContext context, int deviceID);
 
+/*! returns how much device memory the given device currently uses,
+  and has used at most since the context got created (or since
+  owlContextResetMemoryPeaks()), for the given category of memory
+  (or OWL_MEMORY_ALL). This counts all memory that owl itself
+  allocates - buffers, textures, SBT, launch params, accels and
+  their build-time temporaries - but not what CUDA and OptiX use
+  internally. Passing a NULL pointer for either value is valid */
+OWL_API void
+owlContextGetMemoryUsage(OWLContext context,
+                         int deviceID,
+                         OWLMemoryCategory category,
+                         size_t *p_current,
+                         size_t *p_peak);
+
+/*! resets the peaks reported by owlContextGetMemoryUsage() to the
+  current usage, on all devices */
+OWL_API void
+owlContextResetMemoryPeaks(OWLContext context);
+
+/*! limits how much device memory owl may use on the given device (or
+  on each device, for deviceID -1); 0 means no limit, which is the
+  default. The limit is on what owl's allocations actually take up -
+  including rounding to the size classes of the memory cache (see
+  owlContextSetMemoryCacheSize()), and what that cache holds on to.
+  An allocation that would go over the limit first releases the
+  cache; if it still doesn't fit, it fails before it even gets
+  tried, with an exception whose message says what got allocated,
+  and what is using the memory already */
+OWL_API void
+owlContextSetMemoryBudget(OWLContext context,
+                          int deviceID,
+                          size_t maxBytes);
+
+/*! writes current and peak memory usage, per device and category,
+  and the devices' budgets, into the given file, as JSON; as well as
+  the counters (hit rate, fragmentation, etc) of each device's memory
+  cache (see owlContextSetMemoryCacheSize()) */
+OWL_API void
+owlContextWriteMemoryReport(OWLContext context,
+                            const char *fileName);
+
+/*! accel memory (build temporaries, and BVHs) and SBT tables that owl
+  frees by default get cached - per device, in size classes -
+  to be handed out again, rather than freed right away; this sets how
+  much unused memory each device may keep that way (256MB by
+  default), and 0 disables caching. Cached memory doesn't count
+  towards owlContextGetMemoryUsage(), but does count towards memory
+  budgets; and it gets released when it'd be in the way of staying
+  within a budget, or once a device runs out of memory while owl
+  allocates buffers, textures, or managed memory. (Buffers, textures
+  and launch params never get cached, since they may still be in use
+  by an async launch when they get freed.) Memory the app
+  allocates itself doesn't do that; call
+  owlContextReleaseCachedMemory() first if that runs short */
+OWL_API void
+owlContextSetMemoryCacheSize(OWLContext context,
+                             size_t maxCachedBytes);
+
+/*! frees all memory cached on any of the context's devices (see
+  owlContextSetMemoryCacheSize()) */
+OWL_API void
+owlContextReleaseCachedMemory(OWLContext context);
+
+/*! writes the timings of all build phases (modules, programs,
+  pipeline, SBT, accel builds, buffer uploads) recorded so far into
+  the given file, in Chrome trace format (viewable in
+  chrome://tracing or ui.perfetto.dev). Timings only get recorded if
+  OWL was built with OWL_ENABLE_PROFILING; otherwise this prints a
+  warning and does nothing */
+OWL_API void
+owlProfilerWriteTrace(const char *fileName);
+
+/*! prints a summary of the build phase timings recorded so far -
+  number of calls, total/self/max time, and bytes uploaded - per
+  call path. See owlProfilerWriteTrace() */
+OWL_API void
+owlProfilerPrintSummary(void);
+
+/*! discards all profiling events recorded so far */
+OWL_API void
+owlProfilerReset(void);
+
+/*! sets the minimum severity of log messages that get emitted. The
+  default is OWL_LOG_LEVEL_INFO for debug builds, and
+  OWL_LOG_LEVEL_WARNING for release builds; it can also be set through
+  the OWL_LOG_LEVEL environment variable (debug, info, ok, warning,
+  error, or none). Messages below this level cost (almost) nothing -
+  they don't even get formatted */
+OWL_API void
+owlLogSetLevel(OWLLogLevel level);
+
+/*! redirects all log messages into the given file (which gets
+  truncated); passing null restores the default, stderr */
+OWL_API void
+owlLogSetFile(const char *fileName);
+
+/*! redirects all log messages to the given callback; passing null
+  restores the default, stderr */
+OWL_API void
+owlLogSetCallback(OWLLogCallback callback, void *userData);
+
+/*! log messages get written asynchronously by a background thread;
+  this blocks until all messages logged so far have been written */
+OWL_API void
+owlLogFlush(void);
+
 /* return the optix context associated with the given device. */
 OWL_API OptixDeviceContext
 owlContextGetOptixContext(OWLContext context, int deviceID);
@@ -569,7 +789,96 @@ OWL_API void owlGroupRefitAccel(OWLGroup group);
 OWL_API void owlGroupGetAccelSize(OWLGroup group,
                                   size_t *p_memFinal,
                                   size_t *p_memPeak);
-                                  
+
+/*! one ray of a ray batch traced with \see owlGroupTraceRays or \see
+  owlGroupTraceRaysOnHost */
+typedef struct _OWLBatchRay {
+  float    origin[3];
+  float    tmin;
+  float    direction[3];
+  float    tmax;
+  /*! the ray can only hit instances whose visibility mask (\see
+    owlInstanceGroupSetVisibilityMasks) shares a bit with this one;
+    ignored for rays traced against a geom group */
+  uint32_t mask;
+} OWLBatchRay;
+
+/*! what a ray of a ray batch hit; primID is -1 for rays that didn't
+  hit anything (and all other IDs are then -1, too) */
+typedef struct _OWLBatchHit {
+  /*! distance along the (not necessarily normalized) ray direction;
+    infinity for rays that didn't hit anything */
+  float   t;
+  int32_t primID;
+  /*! the instance ID (\see owlInstanceGroupSetInstanceIDs) of the
+    instance that got hit; -1 when tracing a geom group */
+  int32_t instID;
+  /*! index of the geom that got hit within its geom group */
+  int32_t geomID;
+  /*! barycentrics of the hit point, for the triangle's second and
+    third vertex */
+  float   u, v;
+} OWLBatchHit;
+
+typedef enum
+  {
+   OWL_RAY_BATCH_DEFAULT   = 0x0,
+   /*! terminate each ray on the first hit found, rather than the
+     closest one; all fields of the hit are then for that first hit
+     (use this for visibility/occlusion queries) */
+   OWL_RAY_BATCH_ANY_HIT   = 0x1,
+   /*! reorder the rays for coherence (by direction octant and origin)
+     before tracing them; hits still get returned in the order the
+     rays came in. Only owlGroupTraceRaysOnHost (and owlGroupTraceRays
+     on null devices) sorts; on the GPU, sort the rays yourself */
+   OWL_RAY_BATCH_SORT_RAYS = 0x2
+  } OWLRayBatchFlags;
+
+/*! traces a batch of rays against the given group (and everything
+  instantiated in it) on the device, without any user programs: rays
+  are read from 'rays', and one hit record per ray gets written to
+  'hits', both of which are buffers of (at least) numRays
+  OWLBatchRay's and OWLBatchHit's, respectively (eg, device buffers of
+  OWL_USER_TYPE(OWLBatchRay)). This is meant for wavefront-style and
+  non-rendering queries - visibility between sets of points,
+  collision probes, sensor simulation - where the rays are produced
+  (and the hits consumed) by your own CUDA kernels or raygen
+  launches.
+
+  The rays get traced against the group's optix accel - which must
+  have been built - by a built-in raygen/closest-hit/any-hit program
+  set with its own pipeline and SBT, so neither the context's programs
+  nor its SBT need to be built. Only triangle geometry is supported,
+  and motion blur gets traced at time 0. As with owlLaunch2D, each
+  device traces all rays (on its own copies of the buffers), and this
+  returns once all devices are done. On null devices (\see
+  OWL_NULL_DEVICE), the rays get traced as in
+  owlGroupTraceRaysOnHost. */
+OWL_API void owlGroupTraceRays(OWLGroup group,
+                               OWLBuffer rays,
+                               OWLBuffer hits,
+                               size_t numRays,
+                               uint32_t flags OWL_IF_CPP(=OWL_RAY_BATCH_DEFAULT));
+
+/*! like owlGroupTraceRays, but traces rays and hits in host memory
+  *on the host*, which is useful for testing, and for batches too
+  small to be worth a round trip to the GPU.
+
+  This does not use the GPU, or the group's optix accel: it traces
+  (in parallel, on the CPU) host-side BVHs that get built from the
+  group's geometry on first use, and that owlGroupBuildAccel and
+  owlGroupRefitAccel drop again. On GPU contexts, building those
+  copies the vertex and index buffers of device buffers back to the
+  host. Only triangle geometry is supported, and motion blur uses the
+  t=0 vertices and transforms. Buffers, transforms, etc, must be set
+  up as for a regular launch, but the programs and SBT need not be
+  built (and neither does the accel). */
+OWL_API void owlGroupTraceRaysOnHost(OWLGroup group,
+                                     const OWLBatchRay *rays,
+                                     OWLBatchHit *hits,
+                                     size_t numRays,
+                                     uint32_t flags OWL_IF_CPP(=OWL_RAY_BATCH_DEFAULT));
+
 OWL_API OWLGeomType
 owlGeomTypeCreate(OWLContext context,
                   OWLGeomKind kind,
@@ -594,10 +903,101 @@ owlTexture2DCreate(OWLContext context,
                    OWLTextureAddressMode addressMode OWL_IF_CPP(=OWL_TEXTURE_CLAMP),
                    OWLTextureColorSpace colorSpace OWL_IF_CPP(=OWL_COLOR_SPACE_LINEAR),
                    /*! number of bytes between one line of texels and
-                     the next; '0' means 'size_x * sizeof(texel)' */
+                     the next; '0' means 'size_x * sizeof(texel)'. For
+                     block compressed formats 'texels' are the
+                     (already compressed) 4x4 blocks, and this is
+                     the number of bytes between one row of blocks
+                     and the next */
                    uint32_t linePitchInBytes       OWL_IF_CPP(=0)
                    );
 
+/*! create a new mip-mapped texture of given format and (level 0)
+  dimensions. The first 'numLevels' levels are given in 'levels' -
+  level i has max(1,size>>i) texels in each dimension, tightly packed
+  - and all remaining levels down to 1x1 get generated on the host,
+  with the given filter. Filtering respects the color space (ie,
+  sRGB textures get filtered on linearized values) and the address
+  mode; and for OWL_TEXTURE_LINEAR textures, filtering between
+  levels is linear, too. Note that device code has to use
+  tex2DLod/tex2DGrad to actually sample any level other than 0 */
+OWL_API OWLTexture
+owlTexture2DCreateMipmapped(OWLContext context,
+                            OWLTexelFormat texelFormat,
+                            /*! number of texels of level 0 in x dimension */
+                            uint32_t size_x,
+                            /*! number of texels of level 0 in y dimension */
+                            uint32_t size_y,
+                            /*! pointers to the texels of the first
+                                'numLevels' levels */
+                            const void **levels,
+                            /*! number of levels given; 1 means 'only
+                                level 0, generate all others' */
+                            uint32_t numLevels,
+                            OWLMipmapFilter mipmapFilter OWL_IF_CPP(=OWL_MIPMAP_FILTER_KAISER),
+                            OWLTextureFilterMode filterMode OWL_IF_CPP(=OWL_TEXTURE_LINEAR),
+                            OWLTextureAddressMode addressMode OWL_IF_CPP(=OWL_TEXTURE_CLAMP),
+                            OWLTextureColorSpace colorSpace OWL_IF_CPP(=OWL_COLOR_SPACE_LINEAR)
+                            );
+
+/*! create a new texture of a block compressed format
+  (OWL_TEXEL_FORMAT_BC1/4/5/7) from RGBA8 texels, which get
+  compressed on the host (in parallel). BC4 stores only the red
+  channel, BC5 red and green, and BC1 drops alpha. Sizes do not have
+  to be multiples of four */
+OWL_API OWLTexture
+owlTexture2DCreateCompressed(OWLContext context,
+                             OWLTexelFormat compressedFormat,
+                             /*! number of texels in x dimension */
+                             uint32_t size_x,
+                             /*! number of texels in y dimension */
+                             uint32_t size_y,
+                             const void *rgba8Texels,
+                             OWLTextureFilterMode filterMode OWL_IF_CPP(=OWL_TEXTURE_LINEAR),
+                             OWLTextureAddressMode addressMode OWL_IF_CPP(=OWL_TEXTURE_CLAMP),
+                             OWLTextureColorSpace colorSpace OWL_IF_CPP(=OWL_COLOR_SPACE_LINEAR),
+                             /*! number of bytes between one line of
+                               texels and the next; '0' means
+                               'size_x * 4' */
+                             uint32_t linePitchInBytes OWL_IF_CPP(=0)
+                             );
+
+/*! where owlTextureAtlasCreate put one of its input textures */
+typedef struct {
+  /*! index of the atlas (in the 'atlases' array) this texture went
+      into; or -1 if it was too large for an atlas, in which case it
+      should remain a texture of its own */
+  int32_t atlasID;
+  /*! texture coordinate 'uv' (in [0,1]) of the input texture
+      corresponds to 'uv * uvScale + uvOffset' in its atlas. Note
+      that this does not work for uvs that rely on wrapping */
+  owl2f   uvScale;
+  owl2f   uvOffset;
+} OWLTextureAtlasPlacement;
+
+/*! packs many (small) textures of the same format into as few
+  atlas textures (of at most maxAtlasSize x maxAtlasSize texels) as
+  possible, with a gutter of replicated edge texels around each
+  input texture so bilinear filtering does not bleed between them.
+  Creates the atlas textures (with OWL_TEXTURE_CLAMP addressing),
+  writes them into 'atlases' - which needs room for up to
+  numTextures entries - and returns how many there are; and writes
+  where each input texture ended up into 'placements'. */
+OWL_API int
+owlTextureAtlasCreate(OWLContext context,
+                      OWLTexelFormat texelFormat,
+                      uint32_t numTextures,
+                      /*! size (in texels) of each input texture */
+                      const owl2i *sizes,
+                      /*! tightly packed texels of each input texture */
+                      const void **texels,
+                      OWLTexture *atlases,
+                      OWLTextureAtlasPlacement *placements,
+                      uint32_t maxAtlasSize OWL_IF_CPP(=4096),
+                      uint32_t gutter OWL_IF_CPP(=2),
+                      OWLTextureFilterMode filterMode OWL_IF_CPP(=OWL_TEXTURE_LINEAR),
+                      OWLTextureColorSpace colorSpace OWL_IF_CPP(=OWL_COLOR_SPACE_LINEAR)
+                      );
+
 /*! returns the device handle of the given texture for the given
     device ID. Useful for custom texture object arrays. */
 OWL_API CUtexObject
@@ -22,48 +22,108 @@
 #include "stb/stb_image.h"
 
 //std
-#include <set>
-
-namespace std {
-  inline bool operator<(const tinyobj::index_t &a,
-                        const tinyobj::index_t &b)
-  {
-    if (a.vertex_index < b.vertex_index) return true;
-    if (a.vertex_index > b.vertex_index) return false;
-    
-    if (a.normal_index < b.normal_index) return true;
-    if (a.normal_index > b.normal_index) return false;
-    
-    if (a.texcoord_index < b.texcoord_index) return true;
-    if (a.texcoord_index > b.texcoord_index) return false;
-    
-    return false;
-  }
-}
+#include <map>
+// owl
+#include "owl/common/parallel/parallel_for.h"
 
 /*! \namespace osc - Optix Siggraph Course */
 namespace osc {
   
+  /*! open-addressing (linear probing) hash table that maps OBJ
+      vertex/normal/texcoord index triplets to the ID of the mesh
+      vertex they got turned into. With millions of vertices this is
+      way cheaper than a std::map: one flat array,
+      no allocation per vertex, and (on average) one or two probes
+      per lookup */
+  struct VertexHash {
+    struct Entry {
+      tinyobj::index_t idx;
+      int              vertexID;
+    };
 
+    /*! start with room for 'expected' vertices at a load factor of
+        (at most) 1/2; grows if that guess was too small */
+    VertexHash(size_t expected)
+    {
+      size_t capacity = 16;
+      while (capacity < 2*expected) capacity *= 2;
+      entries.resize(capacity,Entry{{-1,-1,-1},-1});
+    }
+
+    static inline size_t hash(const tinyobj::index_t &idx)
+    {
+      uint64_t h
+        = uint64_t(uint32_t(idx.vertex_index))   * 0x9E3779B97F4A7C15ull
+        ^ uint64_t(uint32_t(idx.normal_index))   * 0xC2B2AE3D27D4EB4Full
+        ^ uint64_t(uint32_t(idx.texcoord_index)) * 0x165667B19E3779F9ull;
+      return size_t(h ^ (h >> 29));
+    }
+
+    static inline bool equal(const tinyobj::index_t &a,
+                             const tinyobj::index_t &b)
+    {
+      return
+        a.vertex_index   == b.vertex_index &&
+        a.normal_index   == b.normal_index &&
+        a.texcoord_index == b.texcoord_index;
+    }
+
+    /*! returns the vertex ID stored for 'idx'; or, if there is none
+        yet, stores (and returns) 'newID' */
+    int findOrInsert(const tinyobj::index_t &idx, int newID)
+    {
+      if (2*(numEntries+1) > entries.size())
+        grow();
+      const size_t mask = entries.size()-1;
+      for (size_t slot = hash(idx) & mask;; slot = (slot+1) & mask) {
+        Entry &entry = entries[slot];
+        if (entry.vertexID < 0) {
+          entry.idx      = idx;
+          entry.vertexID = newID;
+          ++numEntries;
+          return newID;
+        }
+        if (equal(entry.idx,idx))
+          return entry.vertexID;
+      }
+    }
+
+  private:
+    void grow()
+    {
+      std::vector<Entry> old(2*entries.size(),Entry{{-1,-1,-1},-1});
+      old.swap(entries);
+      const size_t mask = entries.size()-1;
+      for (auto &entry : old) {
+        if (entry.vertexID < 0) continue;
+        size_t slot = hash(entry.idx) & mask;
+        while (entries[slot].vertexID >= 0)
+          slot = (slot+1) & mask;
+        entries[slot] = entry;
+      }
+    }
+
+    std::vector<Entry> entries;
+    size_t             numEntries { 0 };
+  };
 
   /*! find vertex with given position, normal, texcoord, and return
       its vertex ID, or, if it doesn't exit, add it to the mesh, and
       its just-created index */
   int addVertex(TriangleMesh *mesh,
-                tinyobj::attrib_t &attributes,
+                const tinyobj::attrib_t &attributes,
                 const tinyobj::index_t &idx,
-                std::map<tinyobj::index_t,int> &knownVertices)
+                VertexHash &knownVertices)
   {
-    if (knownVertices.find(idx) != knownVertices.end())
-      return knownVertices[idx];
+    const int newID = (int)mesh->vertex.size();
+    const int vertexID = knownVertices.findOrInsert(idx,newID);
+    if (vertexID != newID)
+      return vertexID;
 
     const vec3f *vertex_array   = (const vec3f*)attributes.vertices.data();
     const vec3f *normal_array   = (const vec3f*)attributes.normals.data();
     const vec2f *texcoord_array = (const vec2f*)attributes.texcoords.data();
     
-    int newID = (int)mesh->vertex.size();
-    knownVertices[idx] = newID;
-
     mesh->vertex.push_back(vertex_array[idx.vertex_index]);
     if (idx.normal_index >= 0) {
       while (mesh->normal.size() < mesh->vertex.size())
@@ -77,60 +137,123 @@ namespace osc {
     return newID;
   }
 
-  /*! load a texture (if not already loaded), and return its ID in the
-      model's textures[] vector. Textures that could not get loaded
-      return -1 */
-  int loadTexture(Model *model,
-                  std::map<std::string,int> &knownTextures,
-                  const std::string &inFileName,
-                  const std::string &modelPath)
+  /*! a mesh created from one shape's faces with the same material */
+  struct MaterialMesh {
+    int           materialID;
+    TriangleMesh *mesh;
+  };
+
+  /*! turns one OBJ shape into one mesh per material used in that
+      shape: first buckets the faces by material (counting sort, one
+      pass over the faces), then builds each bucket's mesh */
+  std::vector<MaterialMesh> createMeshes(const tinyobj::attrib_t &attributes,
+                                         const tinyobj::shape_t &shape,
+                                         int numMaterials)
   {
-    if (inFileName == "")
-      return -1;
+    const size_t numFaces = shape.mesh.material_ids.size();
+    
+    // material IDs are in [-1,numMaterials), so bucket 'materialID+1'
+    std::vector<size_t> bucketBegin(numMaterials+2,0);
+    for (size_t faceID=0;faceID<numFaces;faceID++) {
+      if (shape.mesh.num_face_vertices[faceID] != 3)
+        throw std::runtime_error("not properly tessellated");
+      const int materialID = shape.mesh.material_ids[faceID];
+      if (materialID < -1 || materialID >= numMaterials)
+        throw std::runtime_error("invalid material ID");
+      bucketBegin[materialID+2]++;
+    }
+    for (int b=1;b<(int)bucketBegin.size();b++)
+      bucketBegin[b] += bucketBegin[b-1];
+    std::vector<size_t> sortedFaces(numFaces);
+    {
+      std::vector<size_t> bucketPos(bucketBegin.begin(),bucketBegin.end()-1);
+      for (size_t faceID=0;faceID<numFaces;faceID++)
+        sortedFaces[bucketPos[shape.mesh.material_ids[faceID]+1]++] = faceID;
+    }
     
-    if (knownTextures.find(inFileName) != knownTextures.end())
-      return knownTextures[inFileName];
+    std::vector<MaterialMesh> result;
+    for (int bucket=0;bucket<=numMaterials;bucket++) {
+      const size_t begin = bucketBegin[bucket];
+      const size_t end   = bucketBegin[bucket+1];
+      if (begin == end) continue;
+      
+      TriangleMesh *mesh = new TriangleMesh;
+      // note: vertices are deduplicated only within each material's
+      // mesh, which is also what the vertex arrays require
+      VertexHash knownVertices(end-begin);
+      mesh->index.reserve(end-begin);
+      for (size_t i=begin;i<end;i++) {
+        const size_t faceID = sortedFaces[i];
+        const tinyobj::index_t idx0 = shape.mesh.indices[3*faceID+0];
+        const tinyobj::index_t idx1 = shape.mesh.indices[3*faceID+1];
+        const tinyobj::index_t idx2 = shape.mesh.indices[3*faceID+2];
+        
+        vec3i idx(addVertex(mesh, attributes, idx0, knownVertices),
+                  addVertex(mesh, attributes, idx1, knownVertices),
+                  addVertex(mesh, attributes, idx2, knownVertices));
+        mesh->index.push_back(idx);
+      }
 
-    std::string fileName = inFileName;
-    // first, fix backspaces:
-    for (auto &c : fileName)
-      if (c == '\\') c = '/';
-    fileName = modelPath+"/"+fileName;
+      // just for sanity's sake:
+      if (mesh->texcoord.size() > 0)
+        mesh->texcoord.resize(mesh->vertex.size());
+      // just for sanity's sake:
+      if (mesh->normal.size() > 0)
+        mesh->normal.resize(mesh->vertex.size());
 
+      for (auto idx : mesh->index) {
+        if (idx.x < 0 || idx.x >= (int)mesh->vertex.size() ||
+            idx.y < 0 || idx.y >= (int)mesh->vertex.size() ||
+            idx.z < 0 || idx.z >= (int)mesh->vertex.size())
+          throw std::runtime_error("invalid triangle indices");
+      }
+      result.push_back({bucket-1,mesh});
+    }
+    return result;
+  }
+
+  /*! decodes the given image file into an RGBA8 texture, or returns
+      null if it couldn't get loaded. stb_image's first row is the
+      top of the image while ours is the bottom, so this relies on
+      stb's (global) flip-on-load flag being set; see
+      decodeTextures() */
+  static Texture *decodeImage(const std::string &fileName)
+  {
     vec2i res;
     int   comp;
     unsigned char* image = stbi_load(fileName.c_str(),
                                      &res.x, &res.y, &comp, STBI_rgb_alpha);
-    int textureID = -1;
-    if (image) {
-      textureID = (int)model->textures.size();
-      Texture *texture = new Texture;
-      texture->resolution = res;
-      texture->pixel      = (uint32_t*)image;
-
-      /* iw - actually, it seems that stbi loads the pictures
-         mirrored along the y axis - mirror them here */
-      for (int y=0;y<res.y/2;y++) {
-        uint32_t *line_y = texture->pixel + y * res.x;
-        uint32_t *mirrored_y = texture->pixel + (res.y-1-y) * res.x;
-        for (int x=0;x<res.x;x++) {
-          std::swap(line_y[x],mirrored_y[x]);
-        }
-      }
-      
-      model->textures.push_back(texture);
-    } else {
-      std::cout << OWL_TERMINAL_RED
-                << "Could not load texture from " << fileName << "!"
-                << OWL_TERMINAL_DEFAULT << std::endl;
-    }
+    if (!image)
+      return nullptr;
     
-    knownTextures[inFileName] = textureID;
-    return textureID;
+    Texture *texture = new Texture;
+    texture->resolution = res;
+    texture->pixel      = (uint32_t*)image;
+    return texture;
+  }
+
+  /*! the tasks that decodeTextures() and loadOBJ() run in parallel
+      call decodeImage(), which requires stb to flip images on load;
+      and since that is a global flag, this sets (and resets) it
+      around all of them */
+  struct FlipImagesOnLoad {
+    FlipImagesOnLoad()  { stbi_set_flip_vertically_on_load(true); }
+    ~FlipImagesOnLoad() { stbi_set_flip_vertically_on_load(false); }
+  };
+  
+  std::vector<Texture *> decodeTextures(const std::vector<std::string> &fileNames)
+  {
+    std::vector<Texture *> textures(fileNames.size());
+    FlipImagesOnLoad flip;
+    parallel_for(fileNames.size(),[&](size_t i){
+        textures[i] = decodeImage(fileNames[i]);
+      });
+    return textures;
   }
   
   Model *loadOBJ(const std::string &objFile)
   {
+    const double t_begin = getCurrentTime();
     Model *model = new Model;
 
     const std::string modelDir
@@ -157,70 +280,107 @@ namespace osc {
     if (materials.empty())
       throw std::runtime_error("could not parse materials ...");
 
+    const double t_parsed = getCurrentTime();
     std::cout << "Done loading obj file - found " << shapes.size() << " shapes with " << materials.size() << " materials" << std::endl;
-    for (int shapeID=0;shapeID<(int)shapes.size();shapeID++) {
-      tinyobj::shape_t &shape = shapes[shapeID];
 
-      std::set<int> materialIDs;
-      for (auto faceMatID : shape.mesh.material_ids)
-        materialIDs.insert(faceMatID);
-      
-      std::map<tinyobj::index_t,int> knownVertices;
-      std::map<std::string,int>      knownTextures;
-      
-      for (int materialID : materialIDs) {
-        TriangleMesh *mesh = new TriangleMesh;
-        
-        for (size_t faceID=0;faceID<shape.mesh.material_ids.size();faceID++) {
-          if (shape.mesh.material_ids[faceID] != materialID) continue;
-          if (shape.mesh.num_face_vertices[faceID] != 3)
-            throw std::runtime_error("not properly tessellated");
-          tinyobj::index_t idx0 = shape.mesh.indices[3*faceID+0];
-          tinyobj::index_t idx1 = shape.mesh.indices[3*faceID+1];
-          tinyobj::index_t idx2 = shape.mesh.indices[3*faceID+2];
-          
-          vec3i idx(addVertex(mesh, attributes, idx0, knownVertices),
-                    addVertex(mesh, attributes, idx1, knownVertices),
-                    addVertex(mesh, attributes, idx2, knownVertices));
-          mesh->index.push_back(idx);
-          if (materialID < 0) {
-            mesh->diffuse = vec3f(1,0,0);
-            mesh->diffuseTextureID = -1;
-          } else {
-            mesh->diffuse = (const vec3f&)materials[materialID].diffuse;
-            mesh->diffuseTextureID = loadTexture(model,
-                                                 knownTextures,
-                                                 materials[materialID].diffuse_texname,
-                                                 modelDir);
-          }
-        }
+    // find all textures used by any face, and assign each one a slot
+    // - done up front (and serially) so that decoding can then
+    // proceed concurrently without any of the decoders having to
+    // look up or modify the list of known textures
+    std::vector<bool> materialUsed(materials.size(),false);
+    for (auto &shape : shapes)
+      for (auto materialID : shape.mesh.material_ids)
+        if (materialID >= 0 && materialID < (int)materials.size())
+          materialUsed[materialID] = true;
+    std::map<std::string,int> knownTextures;
+    std::vector<std::string>  textureFiles;
+    std::vector<int>          materialTextureSlot(materials.size(),-1);
+    for (size_t materialID=0;materialID<materials.size();materialID++) {
+      const std::string &inFileName = materials[materialID].diffuse_texname;
+      if (!materialUsed[materialID] || inFileName == "")
+        continue;
+      auto known = knownTextures.find(inFileName);
+      if (known != knownTextures.end()) {
+        materialTextureSlot[materialID] = known->second;
+        continue;
+      }
+      std::string fileName = inFileName;
+      // first, fix backspaces:
+      for (auto &c : fileName)
+        if (c == '\\') c = '/';
+      materialTextureSlot[materialID]
+        = knownTextures[inFileName]
+        = (int)textureFiles.size();
+      textureFiles.push_back(modelDir+fileName);
+    }
 
-        if (mesh->vertex.empty())
-          delete mesh;
-        else {
-          // just for sanity's sake:
-          if (mesh->texcoord.size() > 0)
-            mesh->texcoord.resize(mesh->vertex.size());
-          // just for sanity's sake:
-          if (mesh->normal.size() > 0)
-            mesh->normal.resize(mesh->vertex.size());
-
-          for (auto idx : mesh->index) {
-            if (idx.x < 0 || idx.x >= (int)mesh->vertex.size() ||
-                idx.y < 0 || idx.y >= (int)mesh->vertex.size() ||
-                idx.z < 0 || idx.z >= (int)mesh->vertex.size())
-              throw std::runtime_error("invalid triangle indices");
+    // decode textures and create the shapes' meshes, all at the same
+    // time: textures first, since those tend to be the bigger tasks
+    std::vector<Texture *> decoded(textureFiles.size());
+    std::vector<std::vector<MaterialMesh>> shapeMeshes(shapes.size());
+    {
+      FlipImagesOnLoad flip;
+      parallel_for(textureFiles.size()+shapes.size(),[&](size_t taskID){
+          if (taskID < textureFiles.size())
+            decoded[taskID] = decodeImage(textureFiles[taskID]);
+          else {
+            const size_t shapeID = taskID-textureFiles.size();
+            shapeMeshes[shapeID] = createMeshes(attributes,shapes[shapeID],
+                                                (int)materials.size());
           }
-          model->meshes.push_back(mesh);
+        });
+    }
+    const double t_meshes = getCurrentTime();
+
+    // textures that couldn't get loaded don't get an ID
+    std::vector<int> slotTextureID(decoded.size(),-1);
+    for (size_t slot=0;slot<decoded.size();slot++) {
+      if (decoded[slot]) {
+        slotTextureID[slot] = (int)model->textures.size();
+        model->textures.push_back(decoded[slot]);
+      } else
+        std::cout << OWL_TERMINAL_RED
+                  << "Could not load texture from " << textureFiles[slot] << "!"
+                  << OWL_TERMINAL_DEFAULT << std::endl;
+    }
+    for (auto &meshes : shapeMeshes)
+      for (auto &mm : meshes) {
+        TriangleMesh *mesh = mm.mesh;
+        if (mm.materialID < 0) {
+          mesh->diffuse = vec3f(1,0,0);
+          mesh->diffuseTextureID = -1;
+        } else {
+          const int slot = materialTextureSlot[mm.materialID];
+          mesh->diffuse = (const vec3f&)materials[mm.materialID].diffuse;
+          mesh->diffuseTextureID = slot < 0 ? -1 : slotTextureID[slot];
         }
+        model->meshes.push_back(mesh);
       }
-    }
+    const double t_materials = getCurrentTime();
+
+    std::vector<box3f> meshBounds(model->meshes.size());
+    parallel_for(model->meshes.size(),[&](size_t meshID){
+        for (auto vtx : model->meshes[meshID]->vertex)
+          meshBounds[meshID].extend(vtx);
+      });
+    for (auto &bounds : meshBounds)
+      model->bounds.extend(bounds);
+    const double t_bounds = getCurrentTime();
 
-    // of course, you should be using tbb::parallel_for for stuff
-    // like this:
-    for (auto mesh : model->meshes)
-      for (auto vtx : mesh->vertex)
-        model->bounds.extend(vtx);
+    size_t numTriangles = 0, numVertices = 0;
+    for (auto mesh : model->meshes) {
+      numTriangles += mesh->index.size();
+      numVertices  += mesh->vertex.size();
+    }
+    std::cout << "created " << model->meshes.size() << " meshes with "
+              << prettyNumber(numTriangles) << " triangles and "
+              << prettyNumber(numVertices) << " vertices in "
+              << prettyDouble(t_bounds-t_begin) << "s" << std::endl
+              << " - parsing obj     : " << prettyDouble(t_parsed-t_begin) << "s" << std::endl
+              << " - meshes+textures : " << prettyDouble(t_meshes-t_parsed) << "s ("
+              << model->textures.size() << " textures)" << std::endl
+              << " - materials       : " << prettyDouble(t_materials-t_meshes) << "s" << std::endl
+              << " - bounds          : " << prettyDouble(t_bounds-t_materials) << "s" << std::endl;
     
     return model;
   }
@@ -19,19 +19,59 @@
 #include <owl/owl.h>
 #include <owl/common/math/AffineSpace.h>
 #include <vector>
+#include <memory>
+#include <assert.h>
+#include <stdlib.h>
 
 /*! \namespace osc - Optix Siggraph Course */
 namespace osc {
   using namespace owl;
   using namespace owl::common;
   
+  /*! a std::vector-like array that either owns its elements (as
+      when created by the OBJ loader), or is a view of memory owned
+      by someone else - such as a memory-mapped model cache, see
+      ModelCache.h */
+  template<typename T>
+  struct Array {
+    size_t   size()  const { return view ? viewSize : owned.size(); }
+    bool     empty() const { return size() == 0; }
+    T       *data()        { return view ? view : owned.data(); }
+    const T *data()  const { return view ? view : owned.data(); }
+    T       *begin()       { return data(); }
+    const T *begin() const { return data(); }
+    T       *end()         { return data()+size(); }
+    const T *end()   const { return data()+size(); }
+    T       &operator[](size_t i)       { return data()[i]; }
+    const T &operator[](size_t i) const { return data()[i]; }
+
+    /*! @{ only valid for arrays that own their elements */
+    void push_back(const T &t) { assert(!view); owned.push_back(t); }
+    void resize(size_t n)      { assert(!view); owned.resize(n); }
+    void reserve(size_t n)     { assert(!view); owned.reserve(n); }
+    /*! @} */
+
+    /*! turns this into a view of 'count' elements at 'elements' */
+    void setView(T *elements, size_t count)
+    {
+      std::vector<T>().swap(owned);
+      view     = elements;
+      viewSize = count;
+    }
+    
+  private:
+    std::vector<T> owned;
+    T             *view     { nullptr };
+    size_t         viewSize { 0 };
+  };
+  
   /*! a simple indexed triangle mesh that our sample renderer will
       render */
   struct TriangleMesh {
-    std::vector<vec3f> vertex;
-    std::vector<vec3f> normal;
-    std::vector<vec2f> texcoord;
-    std::vector<vec3i> index;
+    Array<vec3f> vertex;
+    Array<vec3f> normal;
+    Array<vec2f> texcoord;
+    Array<vec3i> index;
 
     // material data:
     vec3f              diffuse;
@@ -43,11 +83,14 @@ namespace osc {
   };
   
   struct Texture {
+    /*! pixels come from stbi_load(), which malloc()s them */
     ~Texture()
-    { if (pixel) delete[] pixel; }
+    { if (pixel && ownsPixels) free(pixel); }
     
     uint32_t *pixel      { nullptr };
     vec2i     resolution { -1 };
+    /*! false if 'pixel' points into a model cache */
+    bool      ownsPixels { true };
   };
   
   struct Model {
@@ -61,7 +104,15 @@ namespace osc {
     std::vector<Texture *>      textures;
     //! bounding box of all vertices in the model
     box3f bounds;
+    /*! if loaded from a model cache: the (memory-mapped) cache file
+        that meshes' and textures' arrays point into */
+    std::shared_ptr<void>       cacheMapping;
   };
 
   Model *loadOBJ(const std::string &objFile);
+
+  /*! decodes the given image files (in parallel) into (vertically
+      flipped, ie, bottom row first) RGBA8 textures; files that could
+      not get loaded result in null textures */
+  std::vector<Texture *> decodeTextures(const std::vector<std::string> &fileNames);
 }
@@ -0,0 +1,313 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "ModelCache.h"
+// std
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+# include <stdlib.h>
+#else
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+/*! \namespace osc - Optix Siggraph Course */
+namespace osc {
+
+  static const char cacheMagic[8] = { 'O','S','C','M','O','D','E','L' };
+
+  /*! size and modification time of given file; false if it doesn't
+      exist */
+  static bool getFileInfo(const std::string &fileName,
+                          uint64_t &size, int64_t &mtime)
+  {
+    struct stat info;
+    if (stat(fileName.c_str(),&info) != 0)
+      return false;
+    size  = (uint64_t)info.st_size;
+    mtime = (int64_t)info.st_mtime;
+    return true;
+  }
+
+  /*! FNV-1a hash over source file's size and mtime (and the cache
+      version, so a format change invalidates every cache) */
+  static uint64_t computeSourceKey(uint64_t size, int64_t mtime)
+  {
+    const uint64_t values[3] = { size, (uint64_t)mtime, ModelCache::VERSION };
+    const uint8_t *bytes = (const uint8_t *)values;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i=0;i<sizeof(values);i++) {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  static inline uint64_t alignUp(uint64_t offset)
+  {
+    return (offset + ModelCache::ALIGNMENT-1) & ~uint64_t(ModelCache::ALIGNMENT-1);
+  }
+
+  void ModelCache::save(const Model *model,
+                        const std::string &cacheFile,
+                        const std::string &sourceFile)
+  {
+    Header header;
+    memset((void*)&header,0,sizeof(header));
+    memcpy(header.magic,cacheMagic,sizeof(cacheMagic));
+    header.version     = VERSION;
+    header.alignment   = ALIGNMENT;
+    if (!getFileInfo(sourceFile,header.sourceSize,header.sourceMTime))
+      throw std::runtime_error("could not stat model source file "+sourceFile);
+    header.sourceKey   = computeSourceKey(header.sourceSize,header.sourceMTime);
+    header.numMeshes   = (uint32_t)model->meshes.size();
+    header.numTextures = (uint32_t)model->textures.size();
+    header.bounds      = model->bounds;
+
+    // first, compute where everything goes ...
+    uint64_t offset
+      = sizeof(Header)
+      + header.numMeshes   * sizeof(MeshRecord)
+      + header.numTextures * sizeof(TextureRecord);
+    auto allocate = [&](size_t numBytes) {
+      if (numBytes == 0) return uint64_t(0);
+      offset = alignUp(offset);
+      const uint64_t begin = offset;
+      offset += numBytes;
+      return begin;
+    };
+    std::vector<MeshRecord> meshRecords(header.numMeshes);
+    for (size_t meshID=0;meshID<meshRecords.size();meshID++) {
+      const TriangleMesh *mesh = model->meshes[meshID];
+      MeshRecord &rec = meshRecords[meshID];
+      memset((void*)&rec,0,sizeof(rec));
+      rec.numVertices      = mesh->vertex.size();
+      rec.vertexOffset     = allocate(rec.numVertices*sizeof(vec3f));
+      rec.numNormals       = mesh->normal.size();
+      rec.normalOffset     = allocate(rec.numNormals*sizeof(vec3f));
+      rec.numTexcoords     = mesh->texcoord.size();
+      rec.texcoordOffset   = allocate(rec.numTexcoords*sizeof(vec2f));
+      rec.numIndices       = mesh->index.size();
+      rec.indexOffset      = allocate(rec.numIndices*sizeof(vec3i));
+      rec.diffuse          = mesh->diffuse;
+      rec.diffuseTextureID = mesh->diffuseTextureID;
+    }
+    std::vector<TextureRecord> textureRecords(header.numTextures);
+    for (size_t texID=0;texID<textureRecords.size();texID++) {
+      const Texture *texture = model->textures[texID];
+      TextureRecord &rec = textureRecords[texID];
+      memset((void*)&rec,0,sizeof(rec));
+      rec.resolution  = texture->resolution;
+      rec.pixelOffset
+        = allocate(size_t(texture->resolution.x)*texture->resolution.y*sizeof(uint32_t));
+    }
+    header.fileSize = offset;
+
+    // ... then write it; into a temporary file that only gets
+    // renamed once complete, so a crash (or a concurrent run) can
+    // never leave a truncated cache behind
+    const std::string tmpFile = cacheFile+".tmp";
+    FILE *file = fopen(tmpFile.c_str(),"wb");
+    if (!file)
+      throw std::runtime_error("could not open model cache file "+tmpFile);
+    uint64_t written = 0;
+    bool ok = true;
+    auto write = [&](uint64_t at, const void *data, size_t numBytes) {
+      static const char zeroes[ALIGNMENT] = { 0 };
+      while (ok && written < at) {
+        const size_t pad = (size_t)std::min(at-written,(uint64_t)ALIGNMENT);
+        ok = (fwrite(zeroes,1,pad,file) == pad);
+        written += pad;
+      }
+      if (ok && numBytes)
+        ok = (fwrite(data,1,numBytes,file) == numBytes);
+      written += numBytes;
+    };
+    write(0,&header,sizeof(header));
+    write(written,meshRecords.data(),meshRecords.size()*sizeof(MeshRecord));
+    write(written,textureRecords.data(),textureRecords.size()*sizeof(TextureRecord));
+    for (size_t meshID=0;meshID<meshRecords.size();meshID++) {
+      const TriangleMesh *mesh = model->meshes[meshID];
+      const MeshRecord &rec = meshRecords[meshID];
+      write(rec.vertexOffset,  mesh->vertex.data(),  rec.numVertices*sizeof(vec3f));
+      write(rec.normalOffset,  mesh->normal.data(),  rec.numNormals*sizeof(vec3f));
+      write(rec.texcoordOffset,mesh->texcoord.data(),rec.numTexcoords*sizeof(vec2f));
+      write(rec.indexOffset,   mesh->index.data(),   rec.numIndices*sizeof(vec3i));
+    }
+    for (size_t texID=0;texID<textureRecords.size();texID++) {
+      const TextureRecord &rec = textureRecords[texID];
+      write(rec.pixelOffset,model->textures[texID]->pixel,
+            size_t(rec.resolution.x)*rec.resolution.y*sizeof(uint32_t));
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || written != header.fileSize) {
+      remove(tmpFile.c_str());
+      throw std::runtime_error("could not write model cache file "+tmpFile);
+    }
+    remove(cacheFile.c_str());
+    if (rename(tmpFile.c_str(),cacheFile.c_str()) != 0) {
+      remove(tmpFile.c_str());
+      throw std::runtime_error("could not create model cache file "+cacheFile);
+    }
+  }
+
+  /*! maps the entire file into memory; the mapping is private
+      (copy-on-write), so the model's arrays can get modified without
+      that ever affecting the file. Returns null on failure */
+  static std::shared_ptr<void> mapFile(const std::string &fileName,
+                                       uint64_t &fileSize)
+  {
+#ifdef _WIN32
+    // no mmap on windows; just read the whole thing
+    FILE *file = fopen(fileName.c_str(),"rb");
+    if (!file) return nullptr;
+    fseek(file,0,SEEK_END);
+    fileSize = (uint64_t)_ftelli64(file);
+    fseek(file,0,SEEK_SET);
+    std::shared_ptr<void> mem(malloc(fileSize ? fileSize : 1),free);
+    const bool ok = mem && (fread(mem.get(),1,fileSize,file) == fileSize);
+    fclose(file);
+    return ok ? mem : nullptr;
+#else
+    const int fd = open(fileName.c_str(),O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat info;
+    if (fstat(fd,&info) != 0 || info.st_size < (off_t)sizeof(ModelCache::Header)) {
+      close(fd);
+      return nullptr;
+    }
+    fileSize = (uint64_t)info.st_size;
+    void *mem = mmap(nullptr,fileSize,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+    // the mapping stays valid after closing the file
+    close(fd);
+    if (mem == MAP_FAILED) return nullptr;
+    const size_t mappedSize = fileSize;
+    return std::shared_ptr<void>(mem,[mappedSize](void *mem){ munmap(mem,mappedSize); });
+#endif
+  }
+  
+  Model *ModelCache::load(const std::string &cacheFile,
+                          const std::string &sourceFile)
+  {
+    uint64_t sourceSize;
+    int64_t  sourceMTime;
+    if (!getFileInfo(sourceFile,sourceSize,sourceMTime))
+      return nullptr;
+
+    uint64_t fileSize = 0;
+    std::shared_ptr<void> mapping = mapFile(cacheFile,fileSize);
+    if (!mapping || fileSize < sizeof(Header))
+      return nullptr;
+    uint8_t *base = (uint8_t *)mapping.get();
+
+    const Header &header = *(const Header *)base;
+    if (memcmp(header.magic,cacheMagic,sizeof(cacheMagic)) != 0 ||
+        header.version   != VERSION ||
+        header.alignment != ALIGNMENT ||
+        header.fileSize  != fileSize ||
+        header.sourceKey != computeSourceKey(sourceSize,sourceMTime))
+      return nullptr;
+
+    const uint64_t recordsEnd
+      = sizeof(Header)
+      + uint64_t(header.numMeshes)   * sizeof(MeshRecord)
+      + uint64_t(header.numTextures) * sizeof(TextureRecord);
+    if (recordsEnd > fileSize)
+      return nullptr;
+    // whether the given array lies entirely within the file
+    auto valid = [&](uint64_t offset, uint64_t count, size_t elementSize) {
+      return count == 0
+        || (offset >= recordsEnd &&
+            offset % ALIGNMENT == 0 &&
+            count <= (fileSize-offset)/elementSize);
+    };
+    
+    const MeshRecord *meshRecords
+      = (const MeshRecord *)(base+sizeof(Header));
+    const TextureRecord *textureRecords
+      = (const TextureRecord *)(meshRecords+header.numMeshes);
+
+    Model *model = new Model;
+    model->cacheMapping = mapping;
+    model->bounds       = header.bounds;
+    bool ok = true;
+    for (uint32_t meshID=0;ok && meshID<header.numMeshes;meshID++) {
+      const MeshRecord &rec = meshRecords[meshID];
+      ok
+        =  valid(rec.vertexOffset,  rec.numVertices, sizeof(vec3f))
+        && valid(rec.normalOffset,  rec.numNormals,  sizeof(vec3f))
+        && valid(rec.texcoordOffset,rec.numTexcoords,sizeof(vec2f))
+        && valid(rec.indexOffset,   rec.numIndices,  sizeof(vec3i))
+        && rec.diffuseTextureID < (int)header.numTextures;
+      if (!ok) break;
+      TriangleMesh *mesh = new TriangleMesh;
+      mesh->vertex.setView  ((vec3f*)(base+rec.vertexOffset),  rec.numVertices);
+      mesh->normal.setView  ((vec3f*)(base+rec.normalOffset),  rec.numNormals);
+      mesh->texcoord.setView((vec2f*)(base+rec.texcoordOffset),rec.numTexcoords);
+      mesh->index.setView   ((vec3i*)(base+rec.indexOffset),   rec.numIndices);
+      mesh->diffuse          = rec.diffuse;
+      mesh->diffuseTextureID = rec.diffuseTextureID;
+      model->meshes.push_back(mesh);
+    }
+    for (uint32_t texID=0;ok && texID<header.numTextures;texID++) {
+      const TextureRecord &rec = textureRecords[texID];
+      ok
+        =  rec.resolution.x > 0 && rec.resolution.y > 0
+        && valid(rec.pixelOffset,uint64_t(rec.resolution.x)*rec.resolution.y,
+                 sizeof(uint32_t));
+      if (!ok) break;
+      Texture *texture = new Texture;
+      texture->pixel      = (uint32_t*)(base+rec.pixelOffset);
+      texture->resolution = rec.resolution;
+      texture->ownsPixels = false;
+      model->textures.push_back(texture);
+    }
+    if (!ok) {
+      delete model;
+      return nullptr;
+    }
+    return model;
+  }
+
+  Model *loadModel(const std::string &objFile)
+  {
+    const std::string cacheFile = ModelCache::defaultFileName(objFile);
+    const double t0 = getCurrentTime();
+    Model *model = ModelCache::load(cacheFile,objFile);
+    if (model) {
+      std::cout << "loaded model from cache " << cacheFile << " in "
+                << prettyDouble(getCurrentTime()-t0) << "s" << std::endl;
+      return model;
+    }
+    
+    model = loadOBJ(objFile);
+    try {
+      ModelCache::save(model,cacheFile,objFile);
+      std::cout << "wrote model cache " << cacheFile << std::endl;
+    } catch (std::exception &e) {
+      // not being able to write the cache (read-only directory, full
+      // disk, ...) is no reason not to render
+      std::cout << OWL_TERMINAL_RED
+                << "could not write model cache: " << e.what()
+                << OWL_TERMINAL_DEFAULT << std::endl;
+    }
+    return model;
+  }
+  
+}
@@ -0,0 +1,93 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "Model.h"
+
+/*! \namespace osc - Optix Siggraph Course */
+namespace osc {
+
+  /*! \file ModelCache.h A binary cache for loaded models.
+
+      Parsing the OBJ file and decoding all its textures takes way
+      longer than just reading the result back from disk; so we can
+      write a Model (its meshes' arrays, materials, and decoded
+      texture pixels) into a binary cache file, and on the next run
+      memory-map that file, with the meshes and textures pointing
+      straight into the mapping.
+
+      File layout: a Header, followed by a MeshRecord for each mesh
+      and a TextureRecord for each texture, followed by the actual
+      arrays; every array starts at a multiple of
+      ModelCache::ALIGNMENT. The header records size and modification
+      time of the OBJ file the cache was created from, and caches
+      whose source file changed (or that have a different format
+      version) get ignored. */
+  struct ModelCache {
+    enum { VERSION = 1, ALIGNMENT = 64 };
+
+    struct Header {
+      char     magic[8];
+      uint32_t version;
+      uint32_t alignment;
+      /*! size of the entire file, for sanity checking */
+      uint64_t fileSize;
+      /*! hash of size and modification time of the source file */
+      uint64_t sourceKey;
+      uint64_t sourceSize;
+      int64_t  sourceMTime;
+      uint32_t numMeshes;
+      uint32_t numTextures;
+      box3f    bounds;
+    };
+
+    struct MeshRecord {
+      uint64_t vertexOffset,  numVertices;
+      uint64_t normalOffset,  numNormals;
+      uint64_t texcoordOffset, numTexcoords;
+      uint64_t indexOffset,   numIndices;
+      vec3f    diffuse;
+      int32_t  diffuseTextureID;
+    };
+
+    struct TextureRecord {
+      uint64_t pixelOffset;
+      vec2i    resolution;
+    };
+
+    /*! writes 'model' into 'cacheFile', tagged with size and
+        modification time of 'sourceFile'; throws on error */
+    static void save(const Model *model,
+                     const std::string &cacheFile,
+                     const std::string &sourceFile);
+
+    /*! loads a model from 'cacheFile' if that exists, and is valid
+        and up to date with 'sourceFile'; returns null otherwise */
+    static Model *load(const std::string &cacheFile,
+                       const std::string &sourceFile);
+
+    /*! the cache file that loadModel() uses for the given OBJ file */
+    static std::string defaultFileName(const std::string &objFile)
+    { return objFile+".osccache"; }
+  };
+
+  /*! loads the given OBJ file - from its model cache if that is up
+      to date, otherwise from the OBJ itself, in which case it
+      (tries to) write the cache for the next run */
+  Model *loadModel(const std::string &objFile);
+  
+}
@@ -26,9 +26,13 @@ namespace osc {
 
   /*! constructor - performs all setup, including initializing
     optix, creates module, pipeline, programs, SBT, etc. */
-  SampleRenderer::SampleRenderer(const Model *model, const QuadLight &light)
+  SampleRenderer::SampleRenderer(const Model *model, const QuadLight &light,
+                                 bool useTextureAtlas)
     : model(model)
   {
+#if OWL_TEXTURES
+    this->useTextureAtlas = useTextureAtlas;
+#endif
     // createContext();
     std::cout << "for now, create exactly one device" << std::endl;
     context = owlContextCreate(nullptr,1);
@@ -87,12 +91,78 @@ namespace osc {
     owlParamsSet3f(launchParams,"light.power",(const owl3f&)light.power);
   }
 
+#if OWL_TEXTURES
+  /*! packs all textures that can be into atlases; ie, those that no
+      mesh uses with texture coordinates outside [0,1] (that'd require
+      wrapping, which doesn't work within an atlas) */
+  void SampleRenderer::createTextureAtlases()
+  {
+    const int numTextures = (int)model->textures.size();
+    std::vector<bool> canBePacked(numTextures,true);
+    for (auto mesh : model->meshes) {
+      if (mesh->diffuseTextureID < 0) continue;
+      for (auto tc : mesh->texcoord)
+        if (tc.x < 0.f || tc.x > 1.f || tc.y < 0.f || tc.y > 1.f) {
+          canBePacked[mesh->diffuseTextureID] = false;
+          break;
+        }
+    }
+    std::vector<int>         packedIDs;
+    std::vector<owl2i>       sizes;
+    std::vector<const void*> texels;
+    for (int textureID=0;textureID<numTextures;textureID++) {
+      if (!canBePacked[textureID]) continue;
+      packedIDs.push_back(textureID);
+      sizes.push_back((const owl2i&)model->textures[textureID]->resolution);
+      texels.push_back(model->textures[textureID]->pixel);
+    }
+    std::vector<OWLTexture> atlases(packedIDs.size());
+    std::vector<OWLTextureAtlasPlacement> placements(packedIDs.size());
+    const int numAtlases
+      = owlTextureAtlasCreate(context,OWL_TEXEL_FORMAT_RGBA8,
+                              (uint32_t)packedIDs.size(),
+                              sizes.data(),texels.data(),
+                              atlases.data(),placements.data());
+
+    // textures that didn't get packed keep their own texture, with
+    // an identity transform
+    texturePlacements.resize(numTextures);
+    for (auto &placement : texturePlacements)
+      placement = { -1, { 1.f, 1.f }, { 0.f, 0.f } };
+    for (size_t i=0;i<packedIDs.size();i++)
+      if (placements[i].atlasID >= 0) {
+        texturePlacements[packedIDs[i]] = placements[i];
+        textures[packedIDs[i]] = atlases[placements[i].atlasID];
+      }
+    int numOwn = 0;
+    for (int textureID=0;textureID<numTextures;textureID++) {
+      if (texturePlacements[textureID].atlasID >= 0) continue;
+      auto texture = model->textures[textureID];
+      textures[textureID]
+        = owlTexture2DCreate(context,
+                             OWL_TEXEL_FORMAT_RGBA8,
+                             texture->resolution.x,
+                             texture->resolution.y,
+                             texture->pixel,
+                             OWL_TEXTURE_LINEAR,
+                             OWL_TEXTURE_CLAMP);
+      numOwn++;
+    }
+    std::cout << "packed " << (numTextures-numOwn) << " of " << numTextures
+              << " textures into " << numAtlases << " atlases" << std::endl;
+  }
+#endif
+  
   void SampleRenderer::createTextures()
   {
     int numTextures = (int)model->textures.size();
 
 #if OWL_TEXTURES
     textures.resize(numTextures);
+    if (useTextureAtlas) {
+      createTextureAtlases();
+      return;
+    }
 #else
     textureArrays.resize(numTextures);
     textureObjects.resize(numTextures);
@@ -206,11 +276,28 @@ namespace osc {
         ? nullptr
         : owlDeviceBufferCreate(context,OWL_FLOAT3,mesh.normal.size(),
                                 mesh.normal.data());
+      const vec2f *texcoords = mesh.texcoord.data();
+#if OWL_TEXTURES
+      // meshes whose texture went into an atlas need their texture
+      // coordinates transformed into that atlas
+      std::vector<vec2f> atlasTexcoords;
+      if (!texturePlacements.empty() && mesh.diffuseTextureID >= 0) {
+        const OWLTextureAtlasPlacement &placement
+          = texturePlacements[mesh.diffuseTextureID];
+        if (placement.atlasID >= 0) {
+          const vec2f scale  = (const vec2f&)placement.uvScale;
+          const vec2f offset = (const vec2f&)placement.uvOffset;
+          for (auto tc : mesh.texcoord)
+            atlasTexcoords.push_back(tc*scale+offset);
+          texcoords = atlasTexcoords.data();
+        }
+      }
+#endif
       OWLBuffer texcoordBuffer
         = mesh.texcoord.empty()
         ? nullptr
         : owlDeviceBufferCreate(context,OWL_FLOAT2,mesh.texcoord.size(),
-                                mesh.texcoord.data());
+                                texcoords);
       // create the geom
       OWLGeom geom
         = owlGeomCreate(context,triMeshGeomType);
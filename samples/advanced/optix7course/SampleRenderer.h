@@ -53,7 +53,8 @@ namespace osc {
   public:
     /*! constructor - performs all setup, including initializing
       optix, creates module, pipeline, programs, SBT, etc. */
-    SampleRenderer(const Model *model, const QuadLight &light);
+    SampleRenderer(const Model *model, const QuadLight &light,
+                   bool useTextureAtlas = false);
 
     /*! render one frame */
     void render();
@@ -110,6 +111,10 @@ namespace osc {
 
     /*! upload textures, and create cuda texture objects for them */
     void createTextures();
+#if OWL_TEXTURES
+    /*! same, but packing textures into atlases where possible */
+    void createTextureAtlases();
+#endif
 
     OWLContext      context = nullptr;
     OWLModule       module = nullptr;
@@ -157,6 +162,11 @@ namespace osc {
     /*! @{ one texture object and pixel array per used texture */
 #if OWL_TEXTURES
     std::vector<OWLTexture> textures;
+    /*! if textures got packed into atlases: for each texture, the
+        transform from its texture coordinates to those in its
+        atlas; empty otherwise */
+    std::vector<OWLTextureAtlasPlacement> texturePlacements;
+    bool useTextureAtlas = false;
 #else
     std::vector<cudaArray_t>         textureArrays;
     std::vector<cudaTextureObject_t> textureObjects;
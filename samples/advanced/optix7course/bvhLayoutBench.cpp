@@ -0,0 +1,130 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file bvhLayoutBench.cpp Compares the host-side binary BVH with
+    the quantized 8-wide one (owl/common/bvh/QuantizedBVH8.h) on a
+    model: BVH memory per triangle, build time, and single-core
+    closest-hit/any-hit throughput for the primary rays of the
+    sample's camera. */
+
+#include "ModelCache.h"
+#include "owl/common/bvh/TriangleMeshBVH.h"
+
+using namespace osc;
+
+void usage(const std::string &error = "")
+{
+  if (error != "")
+    std::cout << OWL_TERMINAL_RED << "Error: " << error
+              << OWL_TERMINAL_DEFAULT << std::endl << std::endl;
+  std::cout << "Usage: ./adv_optix7course_bvhLayoutBench <model.obj> [args]" << std::endl;
+  std::cout << "w/ args:" << std::endl;
+  std::cout << "  --size <w> <h>       : frame size (default: 1024 768)" << std::endl;
+  std::cout << "  --camera <from> <at> : camera, as 6 floats (default: the sample's sponza camera)" << std::endl;
+  exit(error != "");
+}
+
+int main(int ac, char **av)
+{
+  std::string objFile;
+  vec2i fbSize(1024,768);
+  bool  haveCamera = false;
+  vec3f from, at;
+  for (int i=1;i<ac;i++) {
+    const std::string arg = av[i];
+    if (arg == "--size" && i+2<ac) {
+      fbSize.x = atoi(av[++i]);
+      fbSize.y = atoi(av[++i]);
+    } else if (arg == "--camera" && i+6<ac) {
+      for (int k=0;k<3;k++) from[k] = (float)atof(av[++i]);
+      for (int k=0;k<3;k++) at[k]   = (float)atof(av[++i]);
+      haveCamera = true;
+    } else if (arg == "-h" || arg == "--help")
+      usage();
+    else if (arg[0] == '-')
+      usage("unknown argument '"+arg+"'");
+    else
+      objFile = arg;
+  }
+  if (objFile == "")
+    usage("no input file specified");
+
+  try {
+    Model *model = loadModel(objFile);
+    std::vector<vec3f> vertices;
+    std::vector<vec3i> indices;
+    for (auto mesh : model->meshes) {
+      const int base = int(vertices.size());
+      vertices.insert(vertices.end(),mesh->vertex.begin(),mesh->vertex.end());
+      for (const vec3i &index : mesh->index)
+        indices.push_back(index+vec3i(base));
+    }
+    if (!haveCamera) {
+      // same as in main.cpp
+      from = vec3f(-1293.07f, 154.681f, -0.7304f);
+      at   = model->bounds.center()-vec3f(0,400,0);
+    }
+    delete model;
+
+    // same as the sample's ray gen program
+    const vec3f up(0.f,1.f,0.f);
+    const float cosFovy = 0.66f;
+    const vec3f direction = normalize(at-from);
+    const vec3f horizontal
+      = cosFovy * float(fbSize.x)/float(fbSize.y) * normalize(cross(direction,up));
+    const vec3f vertical = cosFovy * normalize(cross(horizontal,direction));
+    auto primaryRay = [&](int ix, int iy) {
+      const vec2f screen = vec2f((ix+.5f)/fbSize.x,(iy+.5f)/fbSize.y) - vec2f(.5f);
+      return HostRay(from,normalize(direction+screen.x*horizontal+screen.y*vertical));
+    };
+
+    const size_t numTriangles = indices.size();
+    const size_t numRays      = size_t(fbSize.x)*fbSize.y;
+    std::cout << "model: " << prettyNumber(numTriangles) << " triangles, tracing "
+              << fbSize.x << "x" << fbSize.y << " primary rays" << std::endl;
+    for (auto layout : { TriangleMeshBVH::BINARY, TriangleMeshBVH::QUANTIZED_WIDE8 }) {
+      TriangleMeshBVH mesh;
+      mesh.layout = layout;
+      const double t0 = getCurrentTime();
+      mesh.build(vertices.data(),indices.data(),numTriangles);
+      const double t1 = getCurrentTime();
+      size_t numHits = 0;
+      for (int iy=0;iy<fbSize.y;iy++)
+        for (int ix=0;ix<fbSize.x;ix++) {
+          HostRay ray = primaryRay(ix,iy);
+          HostHit hit;
+          numHits += mesh.closestHit(ray,hit);
+        }
+      const double t2 = getCurrentTime();
+      for (int iy=0;iy<fbSize.y;iy++)
+        for (int ix=0;ix<fbSize.x;ix++)
+          mesh.anyHit(primaryRay(ix,iy));
+      const double t3 = getCurrentTime();
+      std::cout << (layout == TriangleMeshBVH::BINARY ? "binary BVH          : "
+                                                      : "quantized 8-wide BVH: ")
+                << prettyDouble(mesh.bvhSizeInBytes()/double(numTriangles)) << " bytes/triangle"
+                << ", build " << prettyDouble(t1-t0) << "s"
+                << ", closest " << prettyDouble(numRays/(t2-t1)) << "rays/s"
+                << ", any " << prettyDouble(numRays/(t3-t2)) << "rays/s"
+                << " (" << int(100.*numHits/numRays) << "% hit)" << std::endl;
+    }
+  } catch (std::exception &e) {
+    std::cout << OWL_TERMINAL_RED << "Fatal error: " << e.what()
+              << OWL_TERMINAL_DEFAULT << std::endl;
+    exit(1);
+  }
+  return 0;
+}
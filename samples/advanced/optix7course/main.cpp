@@ -15,6 +15,7 @@
 // ======================================================================== //
 
 #include "SampleRenderer.h"
+#include "ModelCache.h"
 
 // our helper library for window handling
 #include "owlViewer/OWLViewer.h"
@@ -29,10 +30,11 @@ namespace osc {
                  const Model *model,
                  const Camera &camera,
                  const QuadLight &light,
-                 const float worldScale)
+                 const float worldScale,
+                 bool useTextureAtlas)
       : OWLViewer(title// ,camera.from,camera.at,camera.up,worldScale
                   ),
-        sample(model,light)
+        sample(model,light,useTextureAtlas)
     {
       this->camera.setOrientation(camera.from,
                                   camera.at,
@@ -114,10 +116,16 @@ namespace osc {
       //      "../models/sponza.obj"
 #endif
       ;
-    if (ac == 2)
-      inFileName = av[1];
+    bool useTextureAtlas = false;
+    for (int i=1;i<ac;i++) {
+      const std::string arg = av[i];
+      if (arg == "--atlas")
+        useTextureAtlas = true;
+      else
+        inFileName = arg;
+    }
     try {
-      Model *model = loadOBJ(inFileName);
+      Model *model = loadModel(inFileName);
       Camera camera = { /*from*/vec3f(-1293.07f, 154.681f, -0.7304f),
                         /* at */model->bounds.center()-vec3f(0,400,0),
                         /* up */vec3f(0.f,1.f,0.f) };
@@ -134,7 +142,8 @@ namespace osc {
       const float worldScale = length(model->bounds.span());
 
       SampleWindow *window = new SampleWindow("Optix 7 Course Example (on OWL)",
-                                              model,camera,light,worldScale);
+                                              model,camera,light,worldScale,
+                                              useTextureAtlas);
       window->enableFlyMode();
       
       std::cout << "Press 'A' to enable/disable accumulation/progressive refinement" << std::endl;
@@ -0,0 +1,135 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file modelCacheTool.cpp Creates the binary model cache (see
+    ModelCache.h) for an OBJ file, so the optix7course sample starts
+    up fast even on its very first run; and/or benchmarks loading
+    from OBJ vs loading from the cache. */
+
+#include "ModelCache.h"
+
+using namespace osc;
+
+void usage(const std::string &error = "")
+{
+  if (error != "")
+    std::cout << OWL_TERMINAL_RED << "Error: " << error
+              << OWL_TERMINAL_DEFAULT << std::endl << std::endl;
+  std::cout << "Usage: ./adv_optix7course_modelCache <model.obj> [args]" << std::endl;
+  std::cout << "w/ args:" << std::endl;
+  std::cout << "  -o <cacheFile>  : cache file to write (default: <model.obj>.osccache)" << std::endl;
+  std::cout << "  --benchmark|-b  : compare load times of OBJ vs cache" << std::endl;
+  std::cout << "  -n <numRuns>    : number of cache loads to average over (default: 10)" << std::endl;
+  exit(error != "");
+}
+
+/*! reads every byte of the model's arrays (so for a freshly mapped
+    cache, makes sure everything actually got paged in); returns
+    number of bytes touched */
+size_t touchAll(const Model *model, uint32_t &checksum)
+{
+  size_t numBytes = 0;
+  auto touch = [&](const void *data, size_t size) {
+    const uint32_t *words = (const uint32_t *)data;
+    for (size_t i=0;i<size/sizeof(uint32_t);i++)
+      checksum += words[i];
+    numBytes += size;
+  };
+  for (auto mesh : model->meshes) {
+    touch(mesh->vertex.data(),  mesh->vertex.size()*sizeof(vec3f));
+    touch(mesh->normal.data(),  mesh->normal.size()*sizeof(vec3f));
+    touch(mesh->texcoord.data(),mesh->texcoord.size()*sizeof(vec2f));
+    touch(mesh->index.data(),   mesh->index.size()*sizeof(vec3i));
+  }
+  for (auto texture : model->textures)
+    touch(texture->pixel,
+          size_t(texture->resolution.x)*texture->resolution.y*sizeof(uint32_t));
+  return numBytes;
+}
+
+int main(int ac, char **av)
+{
+  std::string objFile, cacheFile;
+  bool benchmark = false;
+  int  numRuns   = 10;
+  for (int i=1;i<ac;i++) {
+    const std::string arg = av[i];
+    if (arg == "-o" && i+1<ac)
+      cacheFile = av[++i];
+    else if (arg == "-b" || arg == "--benchmark")
+      benchmark = true;
+    else if (arg == "-n" && i+1<ac)
+      numRuns = std::max(1,atoi(av[++i]));
+    else if (arg == "-h" || arg == "--help")
+      usage();
+    else if (arg[0] == '-')
+      usage("unknown argument '"+arg+"'");
+    else
+      objFile = arg;
+  }
+  if (objFile == "")
+    usage("no input file specified");
+  if (cacheFile == "")
+    cacheFile = ModelCache::defaultFileName(objFile);
+
+  try {
+    double t0 = getCurrentTime();
+    Model *model = loadOBJ(objFile);
+    double t1 = getCurrentTime();
+    ModelCache::save(model,cacheFile,objFile);
+    double t2 = getCurrentTime();
+    uint32_t objChecksum = 0;
+    const size_t numBytes = touchAll(model,objChecksum);
+    delete model;
+    std::cout << OWL_TERMINAL_GREEN
+              << "wrote " << prettyNumber(numBytes) << "B of model data to "
+              << cacheFile << OWL_TERMINAL_DEFAULT << std::endl;
+    
+    if (!benchmark)
+      return 0;
+
+    // first load might or might not come from the page cache; later
+    // ones almost certainly will
+    double sumMap = 0.f, sumTouch = 0.f;
+    for (int run=0;run<numRuns;run++) {
+      const double begin = getCurrentTime();
+      model = ModelCache::load(cacheFile,objFile);
+      const double mapped = getCurrentTime();
+      if (!model)
+        throw std::runtime_error("could not load the cache we just wrote!?");
+      uint32_t checksum = 0;
+      touchAll(model,checksum);
+      const double touched = getCurrentTime();
+      if (checksum != objChecksum)
+        throw std::runtime_error("cached model differs from OBJ model");
+      delete model;
+      sumMap   += mapped-begin;
+      sumTouch += touched-begin;
+    }
+    const double avgTouch = sumTouch/numRuns;
+    std::cout << "load from OBJ (parse + decode)  : " << prettyDouble(t1-t0) << "s" << std::endl;
+    std::cout << "write cache                     : " << prettyDouble(t2-t1) << "s" << std::endl;
+    std::cout << "load from cache (map only)      : " << prettyDouble(sumMap/numRuns) << "s" << std::endl;
+    std::cout << "load from cache (+ touch all)   : " << prettyDouble(avgTouch) << "s ("
+              << prettyNumber(size_t(numBytes/avgTouch)) << "B/s, "
+              << int((t1-t0)/avgTouch+.5) << "x faster than OBJ)" << std::endl;
+  } catch (std::exception &e) {
+    std::cout << OWL_TERMINAL_RED << "Fatal error: " << e.what()
+              << OWL_TERMINAL_DEFAULT << std::endl;
+    exit(1);
+  }
+  return 0;
+}
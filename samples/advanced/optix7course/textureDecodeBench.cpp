@@ -0,0 +1,148 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file textureDecodeBench.cpp Benchmarks decoding all PNG/JPG/TGA
+    textures in a directory: serially, flipping each image in a
+    second pass (the way the model loader used to), vs in parallel
+    with stb flipping the images during decode (the way it does now) */
+
+#include "Model.h"
+#include "stb/stb_image.h"
+#include <algorithm>
+#include <string.h>
+#include <thread>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <dirent.h>
+#endif
+
+using namespace osc;
+
+std::vector<std::string> listImages(const std::string &dir)
+{
+  std::vector<std::string> names;
+#ifdef _WIN32
+  WIN32_FIND_DATAA data;
+  HANDLE handle = FindFirstFileA((dir+"/*").c_str(),&data);
+  if (handle != INVALID_HANDLE_VALUE) {
+    do names.push_back(data.cFileName); while (FindNextFileA(handle,&data));
+    FindClose(handle);
+  }
+#else
+  DIR *d = opendir(dir.c_str());
+  if (!d)
+    throw std::runtime_error("could not open directory "+dir);
+  while (struct dirent *entry = readdir(d))
+    names.push_back(entry->d_name);
+  closedir(d);
+#endif
+  std::vector<std::string> images;
+  for (auto name : names) {
+    std::string ext = name.substr(name.rfind('.')+1);
+    std::transform(ext.begin(),ext.end(),ext.begin(),::tolower);
+    if (ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "tga")
+      images.push_back(dir+"/"+name);
+  }
+  std::sort(images.begin(),images.end());
+  return images;
+}
+
+/*! what loadTexture() used to do: decode, then flip, pixel by pixel */
+std::vector<Texture *> decodeSerialAndFlip(const std::vector<std::string> &fileNames)
+{
+  std::vector<Texture *> textures;
+  for (auto fileName : fileNames) {
+    vec2i res;
+    int   comp;
+    unsigned char* image = stbi_load(fileName.c_str(),
+                                     &res.x, &res.y, &comp, STBI_rgb_alpha);
+    if (!image) {
+      textures.push_back(nullptr);
+      continue;
+    }
+    Texture *texture = new Texture;
+    texture->resolution = res;
+    texture->pixel      = (uint32_t*)image;
+    for (int y=0;y<res.y/2;y++) {
+      uint32_t *line_y = texture->pixel + y * res.x;
+      uint32_t *mirrored_y = texture->pixel + (res.y-1-y) * res.x;
+      for (int x=0;x<res.x;x++) {
+        std::swap(line_y[x],mirrored_y[x]);
+      }
+    }
+    textures.push_back(texture);
+  }
+  return textures;
+}
+
+int main(int ac, char **av)
+{
+  if (ac < 2) {
+    std::cout << "Usage: ./adv_optix7course_textureDecodeBench <directory> [numRuns]" << std::endl;
+    exit(1);
+  }
+  const int numRuns = ac > 2 ? std::max(1,atoi(av[2])) : 3;
+  try {
+    const std::vector<std::string> files = listImages(av[1]);
+    if (files.empty())
+      throw std::runtime_error(std::string("no images found in ")+av[1]);
+
+    double bestSerial = 1e20, bestParallel = 1e20;
+    size_t numPixels = 0, numFailed = 0;
+    for (int run=0;run<numRuns;run++) {
+      double t0 = getCurrentTime();
+      std::vector<Texture *> serial = decodeSerialAndFlip(files);
+      double t1 = getCurrentTime();
+      std::vector<Texture *> parallel = decodeTextures(files);
+      double t2 = getCurrentTime();
+      bestSerial   = std::min(bestSerial,t1-t0);
+      bestParallel = std::min(bestParallel,t2-t1);
+
+      numPixels = numFailed = 0;
+      for (size_t i=0;i<files.size();i++) {
+        if (!serial[i] || !parallel[i]) {
+          if (serial[i] || parallel[i])
+            throw std::runtime_error("only one of the two could load "+files[i]);
+          numFailed++;
+          continue;
+        }
+        const vec2i res = serial[i]->resolution;
+        if (parallel[i]->resolution != res ||
+            memcmp(serial[i]->pixel,parallel[i]->pixel,
+                   size_t(res.x)*res.y*sizeof(uint32_t)) != 0)
+          throw std::runtime_error("decoded images differ for "+files[i]);
+        numPixels += size_t(res.x)*res.y;
+        delete serial[i];
+        delete parallel[i];
+      }
+    }
+    std::cout << "decoded " << (files.size()-numFailed) << " images ("
+              << prettyNumber(numPixels) << " pixels, " << numFailed
+              << " failed) on " << std::thread::hardware_concurrency()
+              << " hardware threads" << std::endl;
+    std::cout << "serial decode + flip pass : " << prettyDouble(bestSerial) << "s ("
+              << prettyNumber(size_t(numPixels/bestSerial)) << "pixels/s)" << std::endl;
+    std::cout << "parallel decode w/ flip   : " << prettyDouble(bestParallel) << "s ("
+              << prettyNumber(size_t(numPixels/bestParallel)) << "pixels/s)" << std::endl;
+    std::cout << "speedup                   : " << prettyDouble(bestSerial/bestParallel) << std::endl;
+  } catch (std::exception &e) {
+    std::cout << OWL_TERMINAL_RED << "Fatal error: " << e.what()
+              << OWL_TERMINAL_DEFAULT << std::endl;
+    exit(1);
+  }
+  return 0;
+}
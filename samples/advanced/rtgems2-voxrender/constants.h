@@ -20,6 +20,7 @@
 #endif
 
 #define BLOCKLEN 8  // in bricks, per side
+#define BLOCK_UNIFORM 0x80000000u  // block map entry flag: all bricks of the block have the same color
 #define OUTLINE_SCALE 1.2f
 
 enum VisibilityMasks {
@@ -656,7 +656,15 @@ void intersectVoxBlockGeom()
       sgn.y < 0 ? -1 : blockDim.y,
       sgn.z < 0 ? -1 : blockDim.z);
 
-  const int brickOffset = primID*blockDim.x*blockDim.y*blockDim.z;
+  // Uniform blocks don't have colors of their own in colorIndices
+  const uint32_t blockEntry = self.blockMap[primID];
+  const bool isUniform = (blockEntry & BLOCK_UNIFORM) != 0;
+  const unsigned char *blockColors = isUniform ? nullptr
+    : self.colorIndices + size_t(blockEntry)*blockDim.x*blockDim.y*blockDim.z;
+  auto colorOfCell = [&](const vec3i &cell) -> int {
+    return isUniform ? int(blockEntry & 0xff)
+      : blockColors[cell.x + cell.y*blockDim.x + cell.z*blockDim.x*blockDim.y];
+  };
 
 
   // Things that change during traversal
@@ -672,8 +680,7 @@ void intersectVoxBlockGeom()
 
   // Color at entry cell, provided the ray started outside the block.  Updated during DDA.
   // Note: we ignore the case where a ray starts inside an opaque cell (probably due to shadow bias).
-  int brickIdx = brickOffset + cell.x + cell.y*blockDim.x + cell.z*blockDim.x*blockDim.y;
-  int colorIdx = tnear > rayTmin ? self.colorIndices[brickIdx] : -1;
+  int colorIdx = tnear > rayTmin ? colorOfCell(cell) : -1;
 
   // DDA traversal
   // Note: profiling shows small gain from using a fixed size loop here even though we always break.
@@ -707,8 +714,7 @@ void intersectVoxBlockGeom()
     } 
     nextCrossingT += deltaT*vec3f(axismask);
 
-    brickIdx = brickOffset + cell.x + cell.y*blockDim.x + cell.z*blockDim.x*blockDim.y;
-    colorIdx = self.colorIndices[brickIdx];
+    colorIdx = colorOfCell(cell);
   }
 
 }
@@ -65,6 +65,9 @@ struct VoxGeomData {
 // Each prim is a "block" of NxNxN bricks
 struct VoxBlockGeomData {
   uchar3 *prims;  // xyz indices of LL corners of blocks.  Each block is a cube of bricks.
+  // Per prim: BLOCK_UNIFORM | color index if all its bricks have the same color,
+  // else which NxNxN set of colorIndices it uses (identical blocks share those).
+  uint32_t *blockMap;
   unsigned char *colorIndices; 
   uchar4 *colorPalette;
 
@@ -23,16 +23,22 @@
 // viewer base class, for window and user interaction
 #include "owlViewer/OWLViewer.h"
 #include "owl/common/math/AffineSpace.h"
+#include "owl/common/parallel/parallel_for.h"
+#include "owl/common/bvh/TriangleMeshBVH.h"
 
 #include "constants.h"
 #include "ogt_vox.h"
 #include "readVox.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <map>
-#include <tuple>
 #include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 
 #define LOG(message)                                            \
@@ -65,6 +71,7 @@ struct Viewer : public owl::viewer::OWLViewer
     bool enableGround = true;
     bool enableClipping = true;
     bool enableToonOutline = true;
+    bool enableCulling = true;  // only takes effect without clipping
   };
 
   Viewer(const ogt_vox_scene *scene, SceneType sceneType, const GlobalOptions &options);
@@ -116,6 +123,7 @@ struct Viewer : public owl::viewer::OWLViewer
   bool enableGround = true;
   bool enableClipping = true;  // enable clipping plane in shader
   bool enableToonOutline = true;
+  bool cullHidden = false;  // drop enclosed voxels and hidden faces
   
 };
 
@@ -211,117 +219,820 @@ void Viewer::key(char key, const vec2i &where)
 
 // Adapted from ogt demo code. 
 // The OGT format stores voxels as solid grids; we only need to store the nonempty entries on device.
+//
+// Both extractors below work in two parallel passes: the first one
+// counts what each z-slice (or block) will produce, a parallel scan
+// over those counts gives each its offset in the output, and the
+// second pass writes the output directly - no dense intermediate, and
+// in exactly the order a serial walk over the grid would produce.
+
+// Exclusive prefix sum over 'counts', in place; returns the total.
+// Chunks get summed up in parallel, the (few) chunk sums get scanned
+// serially, and then each chunk gets scanned in parallel.
+size_t parallelExclusiveScan(std::vector<size_t> &counts)
+{
+  const size_t chunkSize = 4096;
+  const size_t numChunks = (counts.size() + chunkSize - 1)/chunkSize;
+  std::vector<size_t> chunkOffsets(numChunks, 0);
+  owl::common::parallel_for(numChunks, [&](size_t chunk) {
+    const size_t begin = chunk*chunkSize;
+    const size_t end = std::min(begin+chunkSize, counts.size());
+    size_t sum = 0;
+    for (size_t i = begin; i < end; ++i)
+      sum += counts[i];
+    chunkOffsets[chunk] = sum;
+  });
+  size_t total = 0;
+  for (size_t &offset : chunkOffsets) {
+    const size_t sum = offset;
+    offset = total;
+    total += sum;
+  }
+  owl::common::parallel_for(numChunks, [&](size_t chunk) {
+    const size_t begin = chunk*chunkSize;
+    const size_t end = std::min(begin+chunkSize, counts.size());
+    size_t offset = chunkOffsets[chunk];
+    for (size_t i = begin; i < end; ++i) {
+      const size_t count = counts[i];
+      counts[i] = offset;
+      offset += count;
+    }
+  });
+  return total;
+}
 
-std::vector<uchar4> extractSolidVoxelsFromModel(const ogt_vox_model* model)
+// For eight consecutive voxels: a mask with the top bit of each
+// non-zero byte set.
+inline uint64_t nonZeroBytes(const uint8_t *voxels)
 {
-  // is the voxel at the given index opaque?
-  auto isOpaque = [model](int x, int y, int z) -> bool {
-    if (x < 0 || x >= (int)model->size_x) return false;
-    if (y < 0 || y >= (int)model->size_y) return false;
-    if (z < 0 || z >= (int)model->size_z) return false;
-    int index = z*model->size_x*model->size_y + y*model->size_x + x;
-    uint8_t ci = model->voxel_data[index];
-    return ci != 0;
-  };
+  const uint64_t lowBits = 0x7f7f7f7f7f7f7f7full;
+  uint64_t eight;
+  memcpy(&eight, voxels, 8);
+  return (((eight & lowBits) + lowBits) | eight) & ~lowBits;
+}
+
+inline int lowestSetBit(uint64_t mask)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return int(index);
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
 
-  uint32_t voxel_index = 0;
-  std::vector<uchar4> solid_voxels;
-  solid_voxels.reserve(model->size_z * model->size_y * model->size_x);
-  for (int z = 0; z < (int)model->size_z; z++) {
-    for (int y = 0; y < (int)model->size_y; y++) {
-      for (int x = 0; x < (int)model->size_x; x++, voxel_index++) {
-        uint8_t ci = model->voxel_data[voxel_index];
-        if (ci) {
-          solid_voxels.push_back(
-              // Switch to Y-up
-              make_uchar4(uint8_t(x), uint8_t(y), uint8_t(z), ci));
+std::vector<uchar4> extractSolidVoxelsFromModel(const ogt_vox_model* model)
+{
+  const double t0 = owl::common::getCurrentTime();
+  const int sizeX = (int)model->size_x;
+  const int sizeY = (int)model->size_y;
+  const int sizeZ = (int)model->size_z;
+  const size_t sliceSize = size_t(sizeX)*sizeY;
+
+  // pass 1: number of solid voxels in each z slice
+  std::vector<size_t> sliceOffsets(sizeZ);
+  owl::common::parallel_for(sizeZ, [&](int z) {
+    const uint8_t *slice = model->voxel_data + z*sliceSize;
+    size_t count = 0;
+    size_t i = 0;
+    // eight voxels at a time, summing up the non-zero bits with a multiply
+    for (; i + 8 <= sliceSize; i += 8)
+      count += ((nonZeroBytes(slice + i) >> 7) * 0x0101010101010101ull) >> 56;
+    for (; i < sliceSize; ++i)
+      count += (slice[i] != 0);
+    sliceOffsets[z] = count;
+  });
+  const size_t numSolid = parallelExclusiveScan(sliceOffsets);
+
+  // pass 2: each slice writes its voxels, starting at its offset
+  std::vector<uchar4> solid_voxels(numSolid);
+  owl::common::parallel_for(sizeZ, [&](int z) {
+    const uint8_t *slice = model->voxel_data + z*sliceSize;
+    uchar4 *out = solid_voxels.data() + sliceOffsets[z];
+    for (int y = 0; y < sizeY; y++) {
+      const uint8_t *row = slice + y*sizeX;
+      int x = 0;
+      // eight voxels at a time, visiting only the non-zero ones
+      for (; x + 8 <= sizeX; x += 8) {
+        uint64_t nonZero = nonZeroBytes(row + x);
+        while (nonZero) {
+          const int i = x + lowestSetBit(nonZero)/8;
+          *out++ = make_uchar4(uint8_t(i), uint8_t(y), uint8_t(z), row[i]);
+          nonZero &= nonZero - 1;
         }
       }
+      for (; x < sizeX; x++) {
+        const uint8_t ci = row[x];
+        if (ci)
+          *out++ = make_uchar4(uint8_t(x), uint8_t(y), uint8_t(z), ci);
+      }
     }
-  }
-  LOG("solid voxel count: " << solid_voxels.size());
+  });
+  LOG("solid voxel count: " << solid_voxels.size()
+      << " (extracted in " << owl::common::prettyDouble(owl::common::getCurrentTime()-t0) << "s)");
   return solid_voxels;
 }
 
+// Calls 'rowFct(bz, by, row, rowLen)' for each row of bricks (in x) of
+// the given block that lies inside the model; 'row' points to the
+// model's voxels, 'rowLen' can be less than blockDim.x for blocks
+// sticking out of the model.
+template<typename RowFct>
+inline void forEachRowOfBlock(const ogt_vox_model* model, const vec3i &gridIdx,
+    const vec3i &blockDim, const RowFct &rowFct)
+{
+  const vec3i modelSize(model->size_x, model->size_y, model->size_z);
+  const vec3i lower = gridIdx * blockDim;
+  const vec3i upper = min(lower + blockDim, modelSize);
+  for (int z = lower.z; z < upper.z; ++z)
+    for (int y = lower.y; y < upper.y; ++y)
+      rowFct(z - lower.z, y - lower.y,
+             model->voxel_data + (size_t(z)*modelSize.y + y)*modelSize.x + lower.x,
+             upper.x - lower.x);
+}
+
 // Similar to above, but extract small dense grids ("blocks") of voxels.
+// Only non-empty blocks get written; within each block, bricks are
+// stored x-fastest, and bricks outside the model are empty (0).
 void extractBlocksFromModel(const ogt_vox_model* model, int blockLen,
     std::vector<uchar3> &blockOriginsOut, std::vector<unsigned char> &colorIndicesOut)
 {
+  const double t0 = owl::common::getCurrentTime();
   const vec3i blockDim(blockLen);
   const int bricksPerBlock = blockDim.x * blockDim.y * blockDim.z;
 
   // Use CUDA notation to keep this straight:
   //  block: an NxNxN cube of bricks (original voxels)
   //  grid: a cube of blocks, however many needed to hold all voxels
-  vec3i gridDim(
+  const vec3i gridDim(
       (model->size_x + blockDim.x - 1)/blockDim.x,  // ceil(size_x/blockDim.x); using integer math
       (model->size_y + blockDim.y - 1)/blockDim.y,
       (model->size_z + blockDim.z - 1)/blockDim.z);
+  const size_t numBlocks = size_t(gridDim.x) * gridDim.y * gridDim.z;
 
-  std::vector<uchar3> blockOrigins(gridDim.x * gridDim.y * gridDim.z);
+  // blocks are processed one row of blocks (ie, all blocks of a
+  // given gridY and gridZ) per task
+  const int numBlockRows = gridDim.y * gridDim.z;
+  auto gridIdxOf = [&](int blockRow, int gridX) {
+    return vec3i(gridX, blockRow % gridDim.y, blockRow / gridDim.y);
+  };
 
-  // Fill in block origins
-  {
-    int blockIdx = 0;
-    for (int gridZ = 0; gridZ < gridDim.z; ++gridZ) {
-      for (int gridY = 0; gridY < gridDim.y; ++gridY) {
-        for (int gridX = 0; gridX < gridDim.x; ++gridX) {
+  // pass 1: which blocks are non-empty
+  std::vector<size_t> blockOffsets(numBlocks);
+  owl::common::parallel_for(numBlockRows, [&](int blockRow) {
+    for (int gridX = 0; gridX < gridDim.x; ++gridX) {
+      bool visible = false;
+      forEachRowOfBlock(model, gridIdxOf(blockRow, gridX), blockDim, [&](int, int, const uint8_t *row, int rowLen) {
+        for (int i = 0; i < rowLen && !visible; ++i)
+          visible = (row[i] != 0);
+      });
+      blockOffsets[size_t(blockRow)*gridDim.x + gridX] = visible ? 1 : 0;
+    }
+  });
+  const size_t numVisible = parallelExclusiveScan(blockOffsets);
+
+  // pass 2: write out the non-empty blocks
+  blockOriginsOut.resize(numVisible);
+  colorIndicesOut.assign(numVisible*bricksPerBlock, 0);
+  owl::common::parallel_for(numBlockRows, [&](int blockRow) {
+    for (int gridX = 0; gridX < gridDim.x; ++gridX) {
+      const size_t blockIdx = size_t(blockRow)*gridDim.x + gridX;
+      const size_t outIdx = blockOffsets[blockIdx];
+      const bool visible = (blockIdx+1 < numBlocks ? blockOffsets[blockIdx+1] : numVisible) != outIdx;
+      if (!visible)
+        continue;
+      const vec3i gridIdx = gridIdxOf(blockRow, gridX);
+      blockOriginsOut[outIdx] = make_uchar3(gridIdx.x*blockDim.x, gridIdx.y*blockDim.y, gridIdx.z*blockDim.z);
+      unsigned char *block = colorIndicesOut.data() + outIdx*bricksPerBlock;
+      forEachRowOfBlock(model, gridIdx, blockDim, [&](int bz, int by, const uint8_t *row, int rowLen) {
+        memcpy(block + (bz*blockDim.y + by)*blockDim.x, row, rowLen);
+      });
+    }
+  });
+  LOG("non-empty block count: " << numVisible << " of " << numBlocks
+      << " (extracted in " << owl::common::prettyDouble(owl::common::getCurrentTime()-t0) << "s)");
+}
 
-          blockOrigins[blockIdx] = make_uchar3(gridX*blockDim.x, gridY*blockDim.y, gridZ*blockDim.z);
-          blockIdx++;
-        }
+// Sparse block map (or "brick map"): the non-empty blocks from above,
+// minus the redundancy. Blocks whose bricks all have the same color
+// collapse to just that color, and blocks with identical contents get
+// stored only once; per block, the map says which of the two it is.
+struct BlockMap {
+  std::vector<uchar3>        blockOrigins;  // per non-empty block
+  // per non-empty block: either BLOCK_UNIFORM | color index, or the
+  // index of the block's colors in uniqueColorIndices
+  std::vector<uint32_t>      blockMap;
+  std::vector<unsigned char> uniqueColorIndices;
+
+  size_t numUniform = 0;
+  size_t numUnique = 0;
+};
+
+BlockMap buildBlockMap(const ogt_vox_model* model, int blockLen)
+{
+  BlockMap result;
+  std::vector<unsigned char> colorIndices;
+  extractBlocksFromModel(model, blockLen, result.blockOrigins, colorIndices);
+
+  const double t0 = owl::common::getCurrentTime();
+  const size_t bricksPerBlock = size_t(blockLen)*blockLen*blockLen;
+  const size_t numBlocks = result.blockOrigins.size();
+  auto blockColors = [&](size_t blockIdx) { return colorIndices.data() + blockIdx*bricksPerBlock; };
+
+  // pass 1, in parallel: which blocks are uniform, and a hash of the
+  // contents of all others (64-bit FNV-1a, eight bricks at a time)
+  std::vector<uint64_t> hashes(numBlocks);
+  std::vector<uint8_t> uniformColors(numBlocks);
+  owl::common::parallel_for(numBlocks, [&](size_t blockIdx) {
+    const unsigned char *colors = blockColors(blockIdx);
+    uniformColors[blockIdx]
+      = size_t(std::count(colors, colors + bricksPerBlock, colors[0])) == bricksPerBlock
+      ? colors[0] : 0;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t i = 0;
+    for (; i + 8 <= bricksPerBlock; i += 8) {
+      uint64_t eight;
+      memcpy(&eight, colors + i, 8);
+      hash = (hash ^ eight) * 0x100000001b3ull;
+    }
+    for (; i < bricksPerBlock; ++i)
+      hash = (hash ^ colors[i]) * 0x100000001b3ull;
+    hashes[blockIdx] = hash;
+  });
+
+  // pass 2, serially: dedupe non-uniform blocks through a flat hash
+  // table of unique block indices; contents only get compared when
+  // hashes match
+  size_t tableSize = 16;
+  while (tableSize < 2*numBlocks)
+    tableSize *= 2;
+  std::vector<int> table(tableSize, -1);
+  std::vector<size_t> uniqueBlocks;  // unique block -> one block with its contents
+  result.blockMap.resize(numBlocks);
+  for (size_t blockIdx = 0; blockIdx < numBlocks; ++blockIdx) {
+    if (uniformColors[blockIdx]) {
+      result.blockMap[blockIdx] = BLOCK_UNIFORM | uniformColors[blockIdx];
+      ++result.numUniform;
+      continue;
+    }
+    const uint64_t hash = hashes[blockIdx];
+    size_t slot = size_t(hash) & (tableSize - 1);
+    while (true) {
+      const int unique = table[slot];
+      if (unique < 0) {
+        table[slot] = int(uniqueBlocks.size());
+        result.blockMap[blockIdx] = uint32_t(uniqueBlocks.size());
+        uniqueBlocks.push_back(blockIdx);
+        break;
       }
+      const size_t other = uniqueBlocks[unique];
+      if (hashes[other] == hash && memcmp(blockColors(other), blockColors(blockIdx), bricksPerBlock) == 0) {
+        result.blockMap[blockIdx] = uint32_t(unique);
+        break;
+      }
+      slot = (slot + 1) & (tableSize - 1);
     }
   }
+  result.numUnique = uniqueBlocks.size();
+
+  // pass 3, in parallel: gather the unique blocks' colors
+  result.uniqueColorIndices.resize(result.numUnique*bricksPerBlock);
+  owl::common::parallel_for(result.numUnique, [&](size_t unique) {
+    memcpy(result.uniqueColorIndices.data() + unique*bricksPerBlock,
+           blockColors(uniqueBlocks[unique]), bricksPerBlock);
+  });
+
+  LOG("block map: " << numBlocks << " non-empty blocks, " << result.numUniform << " uniform, "
+      << result.numUnique << " unique non-uniform, "
+      << (numBlocks - result.numUniform - result.numUnique) << " duplicates; colors take "
+      << owl::common::prettyNumber(result.uniqueColorIndices.size() + result.blockMap.size()*sizeof(uint32_t))
+      << "B instead of " << owl::common::prettyNumber(colorIndices.size())
+      << "B (built in " << owl::common::prettyDouble(owl::common::getCurrentTime()-t0) << "s)");
+  return result;
+}
 
-  // iterate over the voxels and scatter color indices into block order
-  std::vector<unsigned char> colorIndices(blockOrigins.size()*bricksPerBlock, 0);
+// Hidden voxel culling.
+//
+// A voxel whose six neighbours are all solid can never be hit, and
+// neither can a face that two solid voxels share - at least as long as
+// nothing cuts the model open, like the clipping plane does. To find
+// those, a model first gets converted to a bit-packed occupancy grid,
+// with one bit per voxel and 64 voxels (along x) per word; that way
+// the neighbour tests for 64 voxels at a time are a few shifts and
+// ANDs of whole words.
+
+enum BrickFace {
+  FACE_NEG_X = 1 << 0,
+  FACE_POS_X = 1 << 1,
+  FACE_NEG_Y = 1 << 2,
+  FACE_POS_Y = 1 << 3,
+  FACE_NEG_Z = 1 << 4,
+  FACE_POS_Z = 1 << 5,
+  ALL_FACES  = 0x3f
+};
 
-  int voxel_index = 0;
-  for (int z = 0; z < (int)model->size_z; z++) {
-    for (int y = 0; y < (int)model->size_y; y++) {
-      for (int x = 0; x < (int)model->size_x; x++, voxel_index++) {
-        uint8_t ci = model->voxel_data[voxel_index];
+inline int popCount(uint64_t bits)
+{
+#ifdef _MSC_VER
+  return int(__popcnt64(bits));
+#else
+  return __builtin_popcountll(bits);
+#endif
+}
 
-        // Note: some of this could be moved out of the innermost loop
-        vec3i blockIdx (x/blockDim.x, y/blockDim.y, z/blockDim.z);
-        int blockOffsetInGrid = blockIdx.x + blockIdx.y*gridDim.x + blockIdx.z*gridDim.x*gridDim.y;
-        int blockOffset = blockOffsetInGrid*bricksPerBlock;
+struct VoxelOccupancy
+{
+  VoxelOccupancy(const ogt_vox_model *model);
 
-        // local brick coords inside a block
-        int bx = x - blockIdx.x*blockDim.x;
-        int by = y - blockIdx.y*blockDim.y;
-        int bz = z - blockIdx.z*blockDim.z;
+  // The words of row (y,z); rows outside the model read as empty.
+  const uint64_t *row(int y, int z) const
+  {
+    if (y < 0 || y >= size.y || z < 0 || z >= size.z)
+      return emptyRow.data();
+    return bits.data() + (size_t(z)*size.y + y)*wordsPerRow;
+  }
 
-        int brickOffsetInBlock = bx + by*blockDim.x + bz*blockDim.x*blockDim.y;
-        int brickOffset = blockOffset + brickOffsetInBlock;
+  bool isSolid(int x, int y, int z) const
+  {
+    if (x < 0 || x >= size.x)
+      return false;
+    return (row(y, z)[x/64] >> (x%64)) & 1;
+  }
+
+  // FACE_XXX bits of those faces of voxel (x,y,z) whose neighbour is empty
+  uint8_t exposedFaces(int x, int y, int z) const
+  {
+    return (isSolid(x-1, y, z) ? 0 : FACE_NEG_X)
+      |    (isSolid(x+1, y, z) ? 0 : FACE_POS_X)
+      |    (isSolid(x, y-1, z) ? 0 : FACE_NEG_Y)
+      |    (isSolid(x, y+1, z) ? 0 : FACE_POS_Y)
+      |    (isSolid(x, y, z-1) ? 0 : FACE_NEG_Z)
+      |    (isSolid(x, y, z+1) ? 0 : FACE_POS_Z);
+  }
+
+  // For the 64 voxels of word w of row (y,z): the solid ones whose
+  // neighbours are all solid, too.
+  uint64_t enclosed(int w, int y, int z) const
+  {
+    const uint64_t *voxels = row(y, z);
+    const uint64_t solid = voxels[w];
+    const uint64_t prev = w > 0 ? voxels[w-1] : 0;
+    const uint64_t next = w+1 < wordsPerRow ? voxels[w+1] : 0;
+    const uint64_t negX = (solid << 1) | (prev >> 63);
+    const uint64_t posX = (solid >> 1) | (next << 63);
+    return solid & negX & posX
+      & row(y-1, z)[w] & row(y+1, z)[w]
+      & row(y, z-1)[w] & row(y, z+1)[w];
+  }
+
+  const vec3i size;
+  const int   wordsPerRow;
+  std::vector<uint64_t> bits;
+  const std::vector<uint64_t> emptyRow;
+  size_t numSolid = 0;
+};
+
+VoxelOccupancy::VoxelOccupancy(const ogt_vox_model *model)
+  : size(model->size_x, model->size_y, model->size_z),
+    wordsPerRow((size.x + 63)/64),
+    bits(size_t(wordsPerRow)*size.y*size.z, 0),
+    emptyRow(wordsPerRow, 0)
+{
+  std::vector<size_t> solidPerSlice(size.z);
+  owl::common::parallel_for(size.z, [&](int z) {
+    size_t count = 0;
+    for (int y = 0; y < size.y; ++y) {
+      const uint8_t *voxels = model->voxel_data + (size_t(z)*size.y + y)*size.x;
+      uint64_t *words = bits.data() + (size_t(z)*size.y + y)*wordsPerRow;
+      int x = 0;
+      // eight voxels at a time; the multiply gathers the (shifted)
+      // top bits of nonZeroBytes into the mask's top byte
+      for (; x + 8 <= size.x; x += 8)
+        words[x/64] |= (((nonZeroBytes(voxels + x) >> 7) * 0x0102040810204080ull) >> 56) << (x%64);
+      for (; x < size.x; ++x)
+        if (voxels[x])
+          words[x/64] |= 1ull << (x%64);
+      for (int w = 0; w < wordsPerRow; ++w)
+        count += popCount(words[w]);
+    }
+    solidPerSlice[z] = count;
+  });
+  for (size_t count : solidPerSlice)
+    numSolid += count;
+}
+
+// A vox model with its enclosed voxels removed (if requested), along
+// with the occupancy needed to also cull hidden faces.
+struct CulledModel
+{
+  CulledModel(const ogt_vox_model *model, bool removeEnclosed);
+
+  // the model to build geometry from: either the original one, or a
+  // copy without the enclosed voxels
+  const ogt_vox_model *get() const
+  { return removeEnclosed ? &culled : original; }
+
+  const ogt_vox_model  *const original;
+  const bool            removeEnclosed;
+  const VoxelOccupancy  occupancy;
+  std::vector<uint8_t>  culledVoxels;
+  ogt_vox_model         culled;
+  // solid voxels with at least one empty neighbour; gets counted
+  // either way, for logSceneMemory
+  size_t                numSurface = 0;
+};
+
+CulledModel::CulledModel(const ogt_vox_model *model, bool removeEnclosed)
+  : original(model),
+    removeEnclosed(removeEnclosed),
+    occupancy(model),
+    culled(*model)
+{
+  const double t0 = owl::common::getCurrentTime();
+  const vec3i size = occupancy.size;
+  if (removeEnclosed) {
+    culledVoxels.assign(model->voxel_data, model->voxel_data + size_t(size.x)*size.y*size.z);
+    culled.voxel_data = culledVoxels.data();
+  }
 
-        assert(brickOffset < colorIndices.size());
-        colorIndices[brickOffset] = ci;
-        
+  std::vector<size_t> enclosedPerSlice(size.z);
+  owl::common::parallel_for(size.z, [&](int z) {
+    size_t count = 0;
+    for (int y = 0; y < size.y; ++y) {
+      uint8_t *voxels = removeEnclosed
+        ? culledVoxels.data() + (size_t(z)*size.y + y)*size.x
+        : nullptr;
+      for (int w = 0; w < occupancy.wordsPerRow; ++w) {
+        uint64_t enclosed = occupancy.enclosed(w, y, z);
+        count += popCount(enclosed);
+        if (!voxels)
+          continue;
+        while (enclosed) {
+          voxels[w*64 + lowestSetBit(enclosed)] = 0;
+          enclosed &= enclosed - 1;
+        }
       }
     }
+    enclosedPerSlice[z] = count;
+  });
+  size_t numEnclosed = 0;
+  for (size_t count : enclosedPerSlice)
+    numEnclosed += count;
+  numSurface = occupancy.numSolid - numEnclosed;
+
+  LOG("surface voxel count: " << numSurface << " of " << occupancy.numSolid << " solid"
+      << (removeEnclosed ? ", enclosed ones removed" : "")
+      << " (in " << owl::common::prettyDouble(owl::common::getCurrentTime()-t0) << "s)");
+}
+
+// For each triangle of the brick: the (FACE_XXX bit of the) face of
+// the unit cube it lies in, or 0 if it doesn't lie in any (like the
+// bevels of the beveled brick do); those get kept whenever the voxel
+// is visible at all.
+std::vector<uint8_t> computeBrickTriangleFaces()
+{
+  std::vector<uint8_t> faces(NUM_BRICK_FACES, 0);
+  for (int i = 0; i < NUM_BRICK_FACES; ++i) {
+    const vec3f &a = brickVertices[brickIndices[i].x];
+    const vec3f &b = brickVertices[brickIndices[i].y];
+    const vec3f &c = brickVertices[brickIndices[i].z];
+    for (int axis = 0; axis < 3; ++axis) {
+      if (a[axis] == 0.f && b[axis] == 0.f && c[axis] == 0.f)
+        faces[i] = uint8_t(1 << (2*axis));
+      if (a[axis] == 1.f && b[axis] == 1.f && c[axis] == 1.f)
+        faces[i] = uint8_t(1 << (2*axis+1));
+    }
   }
+  return faces;
+}
+
+// Greedy meshing, for the flat triangle scene.
+//
+// Rather than a brick per voxel, coplanar faces of the same color get
+// merged into maximal rectangles ("quads"). For each of the six face
+// directions, each slice of the model gets a 2D mask with the color of
+// the face to emit per cell (0 for none), and rectangles get grown from
+// that mask in scan order - first as wide as the color allows, then as
+// high as all of that span allows. Slices are independent, so those
+// get meshed in parallel.
+
+struct VoxelQuad {
+  vec3i corner[4];  // counter-clockwise, seen from outside
+  uint8_t colorIndex;
+};
 
-  // Compact by removing empty blocks
-  blockOriginsOut.reserve(blockOrigins.size());
-  colorIndicesOut.reserve(colorIndices.size());
-  for (int blockIdx = 0; blockIdx < int(blockOrigins.size()); ++blockIdx) {
-    bool visible = false;
-    for (int i = blockIdx*bricksPerBlock, k = 0; k < bricksPerBlock; ++i, ++k) {
-      if (colorIndices[i] > 0) {
-        visible = true;
+// Meshes the faces of the model's solid voxels; with
+// 'onlyExposedFaces', faces with a solid neighbour get skipped.
+std::vector<VoxelQuad> greedyMeshModel(const ogt_vox_model *model, bool onlyExposedFaces)
+{
+  const double t0 = owl::common::getCurrentTime();
+  const vec3i size(model->size_x, model->size_y, model->size_z);
+
+  // one task per slice per direction, in the order of the FACE_XXX bits
+  const int numTasks = 2*(size.x + size.y + size.z);
+  std::vector<std::vector<VoxelQuad>> quadsPerTask(numTasks);
+  owl::common::parallel_for(numTasks, [&](int task) {
+    int dir = 0;
+    int slice = task;
+    while (slice >= size[dir/2]) {
+      slice -= size[dir/2];
+      ++dir;
+    }
+    const int axis = dir/2;
+    const int step = (dir & 1) ? +1 : -1;
+    // (u,v,axis) are right-handed, so u x v points along +axis
+    const int uAxis = (axis+1)%3;
+    const int vAxis = (axis+2)%3;
+    const int sizeU = size[uAxis];
+    const int sizeV = size[vAxis];
+
+    const vec3i stride(1, size.x, size.x*size.y);
+    const uint8_t *sliceVoxels = model->voxel_data + size_t(slice)*stride[axis];
+    // offset to the neighbour the faces look at, if that's inside the model
+    const bool hasNeighbour = onlyExposedFaces && slice + step >= 0 && slice + step < size[axis];
+    const ptrdiff_t neighbourOffset = step*ptrdiff_t(stride[axis]);
+
+    std::vector<uint8_t> mask(size_t(sizeU)*sizeV);
+    for (int v = 0; v < sizeV; ++v) {
+      for (int u = 0; u < sizeU; ++u) {
+        const uint8_t *voxel = sliceVoxels + size_t(u)*stride[uAxis] + size_t(v)*stride[vAxis];
+        const bool hidden = hasNeighbour && voxel[neighbourOffset];
+        mask[size_t(v)*sizeU + u] = hidden ? 0 : *voxel;
+      }
+    }
+
+    std::vector<VoxelQuad> &quads = quadsPerTask[task];
+    for (int v = 0; v < sizeV; ++v) {
+      for (int u = 0; u < sizeU; ) {
+        const uint8_t ci = mask[size_t(v)*sizeU + u];
+        if (!ci) {
+          ++u;
+          continue;
+        }
+        int width = 1;
+        while (u + width < sizeU && mask[size_t(v)*sizeU + u + width] == ci)
+          ++width;
+        int height = 1;
+        for (; v + height < sizeV; ++height) {
+          const uint8_t *row = mask.data() + size_t(v + height)*sizeU + u;
+          if (std::count(row, row + width, ci) != width)
+            break;
+        }
+        for (int dv = 0; dv < height; ++dv)
+          memset(mask.data() + size_t(v + dv)*sizeU + u, 0, width);
+
+        vec3i corner(0);
+        corner[axis] = slice + (step > 0 ? 1 : 0);
+        VoxelQuad quad;
+        quad.colorIndex = ci;
+        for (int i = 0; i < 4; ++i) {
+          // (u,v), (u+w,v), (u+w,v+h), (u,v+h) is counter-clockwise
+          // seen from +axis; flip that for faces looking down -axis
+          const int c = step > 0 ? i : (4 - i) % 4;
+          corner[uAxis] = u + ((c == 1 || c == 2) ? width : 0);
+          corner[vAxis] = v + ((c == 2 || c == 3) ? height : 0);
+          quad.corner[i] = corner;
+        }
+        quads.push_back(quad);
+        u += width;
+      }
+    }
+  });
+
+  size_t numQuads = 0;
+  for (const auto &quads : quadsPerTask)
+    numQuads += quads.size();
+  std::vector<VoxelQuad> allQuads;
+  allQuads.reserve(numQuads);
+  for (const auto &quads : quadsPerTask)
+    allQuads.insert(allQuads.end(), quads.begin(), quads.end());
+  LOG("greedy meshing: " << numQuads << " quads"
+      << " (in " << owl::common::prettyDouble(owl::common::getCurrentTime()-t0) << "s)");
+  return allQuads;
+}
+
+// Maps (integer) vertex positions to mesh vertex indices, for sharing
+// vertices between quads: open addressing with linear probing in one
+// flat array, which is a lot cheaper than a tree map of tuples.
+struct MeshVertexHash
+{
+  MeshVertexHash(size_t expectedNumVertices)
+  {
+    size_t capacity = 16;
+    while (capacity < 2*expectedNumVertices)
+      capacity *= 2;
+    resize(capacity);
+  }
+
+  // index of the mesh vertex at 'pos'; adds it to 'vertices' if it's new
+  int findOrAdd(const vec3i &pos, std::vector<vec3f> &vertices)
+  {
+    if (2*(numUsed+1) > slots.size())
+      grow();
+    const uint64_t key = keyOf(pos);
+    size_t i = hashOf(key);
+    while (slots[i].key != key) {
+      if (slots[i].key == EMPTY_KEY) {
+        slots[i] = Slot{ key, int(vertices.size()) };
+        vertices.push_back(vec3f(pos));
+        ++numUsed;
         break;
       }
+      i = (i + 1) & (slots.size() - 1);
+    }
+    return slots[i].index;
+  }
+
+private:
+  struct Slot {
+    uint64_t key;
+    int      index;
+  };
+  static constexpr uint64_t EMPTY_KEY = ~0ull;
+
+  static uint64_t keyOf(const vec3i &pos)
+  {
+    return uint64_t(uint32_t(pos.x))
+      | (uint64_t(uint32_t(pos.y)) << 21)
+      | (uint64_t(uint32_t(pos.z)) << 42);
+  }
+
+  size_t hashOf(uint64_t key) const
+  {
+    // fibonacci hashing; the top bits are the well mixed ones
+    return size_t((key * 0x9E3779B97F4A7C15ull) >> hashShift);
+  }
+
+  void resize(size_t capacity)
+  {
+    slots.assign(capacity, Slot{ EMPTY_KEY, -1 });
+    hashShift = 64;
+    for (size_t c = capacity; c > 1; c /= 2)
+      --hashShift;
+  }
+
+  void grow()
+  {
+    std::vector<Slot> old;
+    old.swap(slots);
+    resize(2*old.size());
+    for (const Slot &slot : old) {
+      if (slot.key == EMPTY_KEY)
+        continue;
+      size_t i = hashOf(slot.key);
+      while (slots[i].key != EMPTY_KEY)
+        i = (i + 1) & (slots.size() - 1);
+      slots[i] = slot;
+    }
+  }
+
+  std::vector<Slot> slots;
+  int               hashShift = 64;
+  size_t            numUsed = 0;
+};
+
+// Merging faces into quads only works for the simple brick; other
+// bricks get meshed one brick per voxel.
+constexpr bool GREEDY_MESHING = (NUM_BRICK_VERTICES == 8 && NUM_BRICK_FACES == 12);
+
+// The flat triangle scene's mesh of one model, in object space where
+// each brick is 1x1x1: greedy-meshed quads, two triangles each (for the
+// simple brick), or else the kept triangles of one brick per voxel.
+// Bricks only keep some of their triangles (if culling) or get merged
+// (if greedy meshing), so there is one color per triangle, and
+// primCountPerBrick is 1 - unless neither applies, which is what the
+// return value says.
+bool buildFlatModelMesh(const CulledModel &culledModel, bool cullHidden,
+                        const std::vector<uint8_t> &brickTriangleFaces,
+                        std::vector<vec3f> &meshVertices,
+                        std::vector<vec3i> &meshIndices,
+                        std::vector<unsigned char> &colorIndicesPerBrick)
+{
+  const bool colorPerTriangle = GREEDY_MESHING || cullHidden;
+
+  if (GREEDY_MESHING) {
+    const std::vector<VoxelQuad> quads
+      = greedyMeshModel(culledModel.original, cullHidden);
+    meshIndices.reserve(2*quads.size());
+    colorIndicesPerBrick.reserve(2*quads.size());
+    MeshVertexHash vertexHash(quads.size());
+    for (const VoxelQuad &quad : quads) {
+      int index[4];
+      for (int i = 0; i < 4; ++i)
+        index[i] = vertexHash.findOrAdd(quad.corner[i], meshVertices);
+      meshIndices.push_back(vec3i(index[0], index[1], index[2]));
+      meshIndices.push_back(vec3i(index[0], index[2], index[3]));
+      colorIndicesPerBrick.push_back(quad.colorIndex);
+      colorIndicesPerBrick.push_back(quad.colorIndex);
     }
-    if (visible) {
-      blockOriginsOut.push_back(blockOrigins[blockIdx]);
-      for (int i = blockIdx*bricksPerBlock, k = 0; k < bricksPerBlock; ++i, ++k) {
-        colorIndicesOut.push_back(colorIndices[i]);
+  } else {
+    std::vector<uchar4> voxdata = extractSolidVoxelsFromModel(culledModel.get());
+    meshVertices.reserve(voxdata.size() * NUM_BRICK_VERTICES);  // worst case
+    meshIndices.reserve(voxdata.size() * NUM_BRICK_FACES);
+    colorIndicesPerBrick.reserve(voxdata.size());
+
+    // Build mesh in object space where each brick is 1x1x1
+    std::vector<int> indexRemap(NUM_BRICK_VERTICES);  // local brick vertex --> flat mesh vertex
+    for (uchar4 voxel : voxdata) {
+      const vec3f brickTranslation(voxel.x, voxel.y, voxel.z);
+      const uint8_t exposedFaces = cullHidden
+        ? culledModel.occupancy.exposedFaces(voxel.x, voxel.y, voxel.z)
+        : uint8_t(ALL_FACES);
+      // only add the vertices of triangles that get kept
+      std::fill(indexRemap.begin(), indexRemap.end(), -1);
+      for (int i = 0; i < NUM_BRICK_FACES; ++i) {
+        if (brickTriangleFaces[i] && !(brickTriangleFaces[i] & exposedFaces))
+          continue;
+        const vec3i &index = brickIndices[i];
+        for (int v : { index.x, index.y, index.z }) {
+          if (indexRemap[v] < 0) {
+            meshVertices.push_back(brickTranslation + brickVertices[v]);
+            indexRemap[v] = int(meshVertices.size())-1;  // brick vertex -> flat mesh vertex
+          }
+        }
+        meshIndices.push_back(vec3i(indexRemap[index.x], indexRemap[index.y], indexRemap[index.z]));
+        if (colorPerTriangle)
+          colorIndicesPerBrick.push_back(voxel.w);
       }
+      if (!colorPerTriangle)
+        colorIndicesPerBrick.push_back(voxel.w);
     }
   }
+  return colorPerTriangle;
+}
 
+// Host BVH layout comparison (--bvh-bench): for each model, builds the
+// binary and the quantized 8-wide CPU BVHs over the same mesh the flat
+// scene renders (buildFlatModelMesh), and reports BVH memory per
+// triangle and single-core traversal speed for an isometric view of
+// the model.
+void benchmarkHostBVHLayouts(const ogt_vox_scene *scene, bool cullHidden)
+{
+  using owl::common::TriangleMeshBVH;
+  using owl::common::HostRay;
+  using owl::common::HostHit;
+  using owl::common::prettyDouble;
+  using owl::common::getCurrentTime;
+
+  const vec2i fbSize(1024, 1024);
+  const std::vector<uint8_t> brickTriangleFaces = computeBrickTriangleFaces();
+  for (uint32_t modelIndex = 0; modelIndex < scene->num_models; ++modelIndex) {
+    const ogt_vox_model *vox_model = scene->models[modelIndex];
+    const CulledModel culledModel(vox_model, cullHidden);
+    std::vector<vec3f> meshVertices;
+    std::vector<vec3i> meshIndices;
+    std::vector<unsigned char> colorIndices;
+    buildFlatModelMesh(culledModel, cullHidden, brickTriangleFaces,
+                       meshVertices, meshIndices, colorIndices);
+    if (meshIndices.empty())
+      continue;
+
+    // look at the model from the same direction as the default camera
+    const owl::box3f bounds(vec3f(0.f), vec3f(vox_model->size_x, vox_model->size_y, vox_model->size_z));
+    const float isometricAngle = 35.564f * M_PIf/180.0f;
+    const vec3f viewDir = xfmVector(owl::affine3f::rotate(vec3f(0,0,1), M_PIf/4.0f) *
+                                    owl::affine3f::rotate(vec3f(-1,0,0), isometricAngle),
+                                    vec3f(0.f, 1.f, 0.f));
+    const vec3f from = bounds.center() - 1.5f*length(bounds.span())*viewDir;
+    const vec3f horizontal = 0.66f * normalize(cross(viewDir, vec3f(0.f, 0.f, 1.f)));
+    const vec3f vertical = 0.66f * normalize(cross(horizontal, viewDir));
+    auto primaryRay = [&](int ix, int iy) {
+      const float sx = (ix+.5f)/fbSize.x - .5f;
+      const float sy = (iy+.5f)/fbSize.y - .5f;
+      return HostRay(from, normalize(viewDir + sx*horizontal + sy*vertical));
+    };
+
+    const size_t numTriangles = meshIndices.size();
+    const size_t numRays = size_t(fbSize.x)*fbSize.y;
+    LOG("model " << modelIndex << ": " << numTriangles << " triangles");
+    for (auto layout : { TriangleMeshBVH::BINARY, TriangleMeshBVH::QUANTIZED_WIDE8 }) {
+      TriangleMeshBVH mesh;
+      mesh.layout = layout;
+      const double t0 = getCurrentTime();
+      mesh.build(meshVertices.data(), meshIndices.data(), numTriangles);
+      const double t1 = getCurrentTime();
+      size_t numHits = 0;
+      for (int iy = 0; iy < fbSize.y; ++iy)
+        for (int ix = 0; ix < fbSize.x; ++ix) {
+          HostRay ray = primaryRay(ix, iy);
+          HostHit hit;
+          numHits += mesh.closestHit(ray, hit);
+        }
+      const double t2 = getCurrentTime();
+      for (int iy = 0; iy < fbSize.y; ++iy)
+        for (int ix = 0; ix < fbSize.x; ++ix)
+          mesh.anyHit(primaryRay(ix, iy));
+      const double t3 = getCurrentTime();
+      LOG("  " << (layout == TriangleMeshBVH::BINARY ? "binary BVH          : "
+                                                     : "quantized 8-wide BVH: ")
+          << prettyDouble(mesh.bvhSizeInBytes()/double(numTriangles)) << " bytes/triangle"
+          << ", build " << prettyDouble(t1-t0) << "s"
+          << ", closest " << prettyDouble(numRays/(t2-t1)) << "rays/s"
+          << ", any " << prettyDouble(numRays/(t3-t2)) << "rays/s"
+          << " (" << int(100.*numHits/numRays) << "% hit)");
+    }
+  }
 }
 
 // Simple memory tracker
@@ -339,10 +1050,26 @@ struct BufferAllocator {
   size_t bytesAllocated = 0u;
 };
 
+// Voxels of all instanced models
+struct VoxelCounts {
+  size_t solid = 0;
+  size_t surface = 0;  // solid ones with at least one empty neighbour
+
+  void add(const CulledModel &model, size_t numInstances)
+  {
+    solid += model.occupancy.numSolid * numInstances;
+    surface += model.numSurface * numInstances;
+  }
+};
+
 void logSceneMemory(size_t bottomLevelBvhSizeInBytes,
                     size_t topLevelBvhSizeInBytes,
-                    const BufferAllocator &allocator)
+                    const BufferAllocator &allocator,
+                    const VoxelCounts &voxelCounts)
 {
+  LOG("Scene solid voxels: " << voxelCounts.solid << " (" << owl::common::prettyNumber(voxelCounts.solid) << ")");
+  LOG("Scene surface voxels: " << voxelCounts.surface << " (" << owl::common::prettyNumber(voxelCounts.surface) << ", "
+      << int(voxelCounts.solid ? 100.0*voxelCounts.surface/voxelCounts.solid : 100.0) << "% of solid)");
   LOG("Scene GAS memory: " << owl::common::prettyNumber(bottomLevelBvhSizeInBytes));
   LOG("Scene IAS memory: " << owl::common::prettyNumber(topLevelBvhSizeInBytes));
   LOG("Scene buffer memory: " << owl::common::prettyNumber(allocator.bytesAllocated));
@@ -450,7 +1177,7 @@ OWLGroup Viewer::createUserGeometryScene(OWLModule module, const ogt_vox_scene *
   std::vector<owl::affine3f> instanceTransforms;
   instanceTransforms.reserve(scene->num_instances);
 
-  size_t totalSolidVoxelCount = 0;
+  VoxelCounts voxelCounts;
   size_t bottomLevelBvhSizeInBytes = 0;
   
   // Make instance transforms
@@ -458,7 +1185,9 @@ OWLGroup Viewer::createUserGeometryScene(OWLModule module, const ogt_vox_scene *
 
     const ogt_vox_model *vox_model = scene->models[it.first];
     assert(vox_model);
-    std::vector<uchar4> voxdata = extractSolidVoxelsFromModel(vox_model);
+    const CulledModel culledModel(vox_model, this->cullHidden);
+    std::vector<uchar4> voxdata = extractSolidVoxelsFromModel(culledModel.get());
+    voxelCounts.add(culledModel, it.second.size());
 
     LOG("building user geometry for model ...");
 
@@ -483,8 +1212,6 @@ OWLGroup Viewer::createUserGeometryScene(OWLModule module, const ogt_vox_scene *
     owlGroupBuildAccel(userGeomGroup);
     bottomLevelBvhSizeInBytes += getAccelSizeInBytes(userGeomGroup);
 
-    totalSolidVoxelCount += voxdata.size() * it.second.size();
-
     LOG("adding (" << it.second.size() << ") instance transforms for model ...");
     appendInstanceTransforms(scene, vox_model, it.second, instanceTransforms, sceneBox);
     for (uint32_t instanceIndex : it.second) {
@@ -493,8 +1220,6 @@ OWLGroup Viewer::createUserGeometryScene(OWLModule module, const ogt_vox_scene *
 
   }
 
-  LOG("Total solid voxels in all instanced models: " << totalSolidVoxelCount);
-
   const vec3f sceneCenter = sceneBox.center();
   const vec3f sceneSpan = sceneBox.span();
 
@@ -543,7 +1268,7 @@ OWLGroup Viewer::createUserGeometryScene(OWLModule module, const ogt_vox_scene *
   owlGroupBuildAccel(world);
 
   uint64_t topLevelBvhSizeInBytes = getAccelSizeInBytes(world);
-  logSceneMemory(bottomLevelBvhSizeInBytes, topLevelBvhSizeInBytes, allocator);
+  logSceneMemory(bottomLevelBvhSizeInBytes, topLevelBvhSizeInBytes, allocator, voxelCounts);
 
   return world;
 
@@ -564,6 +1289,7 @@ OWLGroup Viewer::createUserBlocksGeometryScene(OWLModule module, const ogt_vox_s
 
   OWLVarDecl voxGeomVars[] = {
     { "prims",  OWL_BUFPTR, OWL_OFFSETOF(VoxBlockGeomData,prims)},
+    { "blockMap",  OWL_BUFPTR, OWL_OFFSETOF(VoxBlockGeomData,blockMap)},
     { "colorIndices",  OWL_BUFPTR, OWL_OFFSETOF(VoxBlockGeomData,colorIndices)},
     { "colorPalette",  OWL_BUFPTR, OWL_OFFSETOF(VoxBlockGeomData,colorPalette)},
     { /* sentinel to mark end of list */ }
@@ -607,6 +1333,7 @@ OWLGroup Viewer::createUserBlocksGeometryScene(OWLModule module, const ogt_vox_s
   instanceTransforms.reserve(scene->num_instances);
 
   size_t totalPrimCount = 0;
+  VoxelCounts voxelCounts;
   size_t bottomLevelBvhSizeInBytes = 0;
   
   // Make instance transforms
@@ -614,10 +1341,12 @@ OWLGroup Viewer::createUserBlocksGeometryScene(OWLModule module, const ogt_vox_s
 
     const ogt_vox_model *vox_model = scene->models[it.first];
     assert(vox_model);
-    std::vector<uchar3> blockOrigins;
-    std::vector<unsigned char> colorIndices;
+    const CulledModel culledModel(vox_model, this->cullHidden);
+    voxelCounts.add(culledModel, it.second.size());
 
-    extractBlocksFromModel(vox_model, BLOCKLEN, blockOrigins, colorIndices);
+    // blocks that only hold enclosed voxels don't become prims at all
+    const BlockMap blocks = buildBlockMap(culledModel.get(), BLOCKLEN);
+    const std::vector<uchar3> &blockOrigins = blocks.blockOrigins;
 
     LOG("building user blocks (dda " << BLOCKLEN << "x" << BLOCKLEN << "x" << BLOCKLEN << ") geometry for model ...");
 
@@ -626,14 +1355,17 @@ OWLGroup Viewer::createUserBlocksGeometryScene(OWLModule module, const ogt_vox_s
     // ------------------------------------------------------------------
     OWLBuffer primBuffer 
       = allocator.deviceBufferCreate(context, OWL_UCHAR3, blockOrigins.size(), blockOrigins.data());
+    OWLBuffer blockMapBuffer
+      = allocator.deviceBufferCreate(context, OWL_UINT, blocks.blockMap.size(), blocks.blockMap.data());
     OWLBuffer colorIndexBuffer
-      = allocator.deviceBufferCreate(context, OWL_UCHAR, colorIndices.size(), colorIndices.data());
+      = allocator.deviceBufferCreate(context, OWL_UCHAR, blocks.uniqueColorIndices.size(), blocks.uniqueColorIndices.data());
 
     OWLGeom voxGeom = owlGeomCreate(context, voxGeomType);
     
     owlGeomSetPrimCount(voxGeom, blockOrigins.size());
 
     owlGeomSetBuffer(voxGeom, "prims", primBuffer);
+    owlGeomSetBuffer(voxGeom, "blockMap", blockMapBuffer);
     owlGeomSetBuffer(voxGeom, "colorIndices", colorIndexBuffer);
     owlGeomSetBuffer(voxGeom, "colorPalette", paletteBuffer);
 
@@ -665,17 +1397,21 @@ OWLGroup Viewer::createUserBlocksGeometryScene(OWLModule module, const ogt_vox_s
     // ------------------------------------------------------------------
     
     std::vector<uchar3> blockOrigins {make_uchar3(0,0,0)};
-    std::vector<unsigned char> colorIndices(BLOCKLEN*BLOCKLEN*BLOCKLEN, 249);
+    std::vector<uint32_t> blockMap {BLOCK_UNIFORM | 249};  // grey in default palette
     OWLBuffer primBuffer 
       = allocator.deviceBufferCreate(context, OWL_UCHAR3, blockOrigins.size(), blockOrigins.data());
+    OWLBuffer blockMapBuffer
+      = allocator.deviceBufferCreate(context, OWL_UINT, blockMap.size(), blockMap.data());
+    // no colors needed for a uniform block
     OWLBuffer colorIndexBuffer
-      = allocator.deviceBufferCreate(context, OWL_UCHAR, colorIndices.size(), colorIndices.data());
+      = allocator.deviceBufferCreate(context, OWL_UCHAR, 0, nullptr);
 
     OWLGeom voxGeom = owlGeomCreate(context, voxGeomType);
     
     owlGeomSetPrimCount(voxGeom, blockOrigins.size());
 
     owlGeomSetBuffer(voxGeom, "prims", primBuffer);
+    owlGeomSetBuffer(voxGeom, "blockMap", blockMapBuffer);
     owlGeomSetBuffer(voxGeom, "colorIndices", colorIndexBuffer);
     owlGeomSetBuffer(voxGeom, "colorPalette", paletteBuffer);
 
@@ -707,7 +1443,7 @@ OWLGroup Viewer::createUserBlocksGeometryScene(OWLModule module, const ogt_vox_s
   owlGroupBuildAccel(world);
 
   uint64_t topLevelBvhSizeInBytes = getAccelSizeInBytes(world);
-  logSceneMemory(bottomLevelBvhSizeInBytes, topLevelBvhSizeInBytes, allocator);
+  logSceneMemory(bottomLevelBvhSizeInBytes, topLevelBvhSizeInBytes, allocator, voxelCounts);
 
   return world;
 
@@ -764,61 +1500,29 @@ OWLGroup Viewer::createFlatTriangleGeometryScene(OWLModule module, const ogt_vox
   std::vector<owl::affine3f> instanceTransforms;
   instanceTransforms.reserve(scene->num_instances);
 
-  size_t totalSolidVoxelCount = 0;
+  VoxelCounts voxelCounts;
   size_t bottomLevelBvhSizeInBytes = 0;
 
+  const std::vector<uint8_t> brickTriangleFaces = computeBrickTriangleFaces();
+
   // Make instance transforms
   for (auto it : modelToInstances) {
     const ogt_vox_model *vox_model = scene->models[it.first];
     assert(vox_model);
-    std::vector<uchar4> voxdata = extractSolidVoxelsFromModel(vox_model);
+    const CulledModel culledModel(vox_model, this->cullHidden);
+    voxelCounts.add(culledModel, it.second.size());
 
     LOG("building flat triangle geometry for model ...");
 
     std::vector<vec3f> meshVertices;
-    meshVertices.reserve(voxdata.size() * NUM_BRICK_VERTICES);  // worst case
     std::vector<vec3i> meshIndices;
-    meshIndices.reserve(voxdata.size() * NUM_BRICK_FACES);
     std::vector<unsigned char> colorIndicesPerBrick;
-    colorIndicesPerBrick.reserve(voxdata.size());
-
-    // Share vertices between voxels to save a little memory.  Only works for simple brick.
-    constexpr bool SHARE_BRICK_VERTICES = (NUM_BRICK_VERTICES == 8 && NUM_BRICK_FACES == 12);
-    std::map<std::tuple<int, int, int>, int> brickVertexToMeshVertexIndex;
-
-    // Build mesh in object space where each brick is 1x1x1
-    std::vector<int> indexRemap(NUM_BRICK_VERTICES);  // local brick vertex --> flat mesh vertex
-    for (uchar4 voxel : voxdata) {
-      const vec3i brickTranslation(voxel.x, voxel.y, voxel.z);
-      for (int i = 0; i < NUM_BRICK_VERTICES; ++i) {
-        const vec3f &v = brickVertices[i];
-        std::tuple<int,int,int> brickVertex = std::make_tuple(
-            brickTranslation.x + int(v.x),
-            brickTranslation.y + int(v.y),
-            brickTranslation.z + int(v.z));
-        int vertexIndexInMesh = -1;
-        if (SHARE_BRICK_VERTICES) {
-          const auto it = brickVertexToMeshVertexIndex.find(brickVertex);
-          if (it != brickVertexToMeshVertexIndex.end()) {
-            vertexIndexInMesh = it->second;
-          } else {
-            meshVertices.push_back(vec3f(brickTranslation) + v);
-            vertexIndexInMesh = int(meshVertices.size())-1;
-            brickVertexToMeshVertexIndex[brickVertex] = vertexIndexInMesh;
-          }
-        } else {
-          // do not share vertices
-          meshVertices.push_back(vec3f(brickTranslation) + v);
-          vertexIndexInMesh = int(meshVertices.size())-1;
-        }
-        indexRemap[i] = vertexIndexInMesh;  // brick vertex -> flat mesh vertex
-      }
-      for (const vec3i &index : brickIndices) {
-        vec3i face(indexRemap[index.x], indexRemap[index.y], indexRemap[index.z]);
-        meshIndices.push_back(face);
-      }
-      colorIndicesPerBrick.push_back(voxel.w);
-    }
+    const bool colorPerTriangle
+      = buildFlatModelMesh(culledModel, this->cullHidden, brickTriangleFaces,
+                           meshVertices, meshIndices, colorIndicesPerBrick);
+    if (GREEDY_MESHING)
+      LOG("Mesh triangles vs. one brick per voxel: " << meshIndices.size() << " vs. "
+          << culledModel.occupancy.numSolid*NUM_BRICK_FACES);
 
     LOG("Mesh vertex count: " << meshVertices.size());
     LOG("Mesh face count: " << meshIndices.size());
@@ -836,7 +1540,7 @@ OWLGroup Viewer::createFlatTriangleGeometryScene(OWLModule module, const ogt_vox
     owlGeomSetBuffer(trianglesGeom, "vertex", vertexBuffer);
     owlGeomSetBuffer(trianglesGeom, "index", indexBuffer);
     owlGeomSetBuffer(trianglesGeom, "colorPalette", paletteBuffer);
-    owlGeomSet1i(trianglesGeom, "primCountPerBrick", NUM_BRICK_FACES);
+    owlGeomSet1i(trianglesGeom, "primCountPerBrick", colorPerTriangle ? 1 : NUM_BRICK_FACES);
 
     OWLBuffer colorIndexBuffer
       = allocator.deviceBufferCreate(context, OWL_UCHAR, colorIndicesPerBrick.size(), colorIndicesPerBrick.data());
@@ -848,8 +1552,6 @@ OWLGroup Viewer::createFlatTriangleGeometryScene(OWLModule module, const ogt_vox
     OWLGroup trianglesGroup = owlTrianglesGeomGroupCreate(context, 1, &trianglesGeom);
     owlGroupBuildAccel(trianglesGroup);
     bottomLevelBvhSizeInBytes += getAccelSizeInBytes(trianglesGroup);
-      
-    totalSolidVoxelCount += voxdata.size() * it.second.size();
 
     LOG("adding (" << it.second.size() << ") instance transforms for model ...");
     appendInstanceTransforms(scene, vox_model, it.second, instanceTransforms, sceneBox);
@@ -859,8 +1561,6 @@ OWLGroup Viewer::createFlatTriangleGeometryScene(OWLModule module, const ogt_vox
     
   }
 
-  LOG("Total solid voxels in all instanced models: " << totalSolidVoxelCount);
-
   const vec3f sceneCenter = sceneBox.center();
   const vec3f sceneSpan = sceneBox.span();
 
@@ -923,7 +1623,7 @@ OWLGroup Viewer::createFlatTriangleGeometryScene(OWLModule module, const ogt_vox
   owlGroupBuildAccel(world);
 
   uint64_t topLevelBvhSizeInBytes = getAccelSizeInBytes(world);
-  logSceneMemory(bottomLevelBvhSizeInBytes, topLevelBvhSizeInBytes, allocator);
+  logSceneMemory(bottomLevelBvhSizeInBytes, topLevelBvhSizeInBytes, allocator, voxelCounts);
 
   return world;
 
@@ -1015,7 +1715,7 @@ OWLGroup Viewer::createInstancedTriangleGeometryScene(OWLModule module, const og
     }
   }
 
-  size_t totalSolidVoxelCount = 0;
+  VoxelCounts voxelCounts;
 
   const affine3f instanceInflateOutline =
     affine3f::translate(vec3f(0.5f)) * affine3f::scale(vec3f(OUTLINE_SCALE)) * affine3f::translate(vec3f(-0.5f));
@@ -1024,8 +1724,9 @@ OWLGroup Viewer::createInstancedTriangleGeometryScene(OWLModule module, const og
   for (auto it : modelToInstances) {
     const ogt_vox_model *vox_model = scene->models[it.first];
     assert(vox_model);
-    std::vector<uchar4> voxdata = extractSolidVoxelsFromModel(vox_model);
-    totalSolidVoxelCount += voxdata.size() * it.second.size();
+    const CulledModel culledModel(vox_model, this->cullHidden);
+    std::vector<uchar4> voxdata = extractSolidVoxelsFromModel(culledModel.get());
+    voxelCounts.add(culledModel, it.second.size());
 
     std::vector<owl::affine3f> instanceTransforms;
     LOG("adding (" << it.second.size() << ") instance transforms for model ...");
@@ -1049,8 +1750,6 @@ OWLGroup Viewer::createInstancedTriangleGeometryScene(OWLModule module, const og
     }
   }
 
-  LOG("Total solid voxels in all instanced models: " << totalSolidVoxelCount);
-
   const vec3f sceneSpan = sceneBox.span();
   const vec3f sceneCenter = sceneBox.center();
 
@@ -1100,7 +1799,7 @@ OWLGroup Viewer::createInstancedTriangleGeometryScene(OWLModule module, const og
   owlGroupBuildAccel(world);
 
   uint64_t topLevelBvhSizeInBytes = getAccelSizeInBytes(world);
-  logSceneMemory(bottomLevelBvhSizeInBytes, topLevelBvhSizeInBytes, allocator);
+  logSceneMemory(bottomLevelBvhSizeInBytes, topLevelBvhSizeInBytes, allocator, voxelCounts);
 
   return world;
   
@@ -1109,8 +1808,14 @@ OWLGroup Viewer::createInstancedTriangleGeometryScene(OWLModule module, const og
 Viewer::Viewer(const ogt_vox_scene *scene, SceneType sceneType, const GlobalOptions &options)
   : enableGround(options.enableGround), 
   enableClipping(options.enableClipping), 
-  enableToonOutline(options.enableToonOutline)
+  enableToonOutline(options.enableToonOutline),
+  // the clipping plane can cut models open and expose their insides
+  cullHidden(options.enableCulling && !options.enableClipping)
 {
+  if (options.enableCulling && options.enableClipping) {
+    LOG("hidden voxel culling is disabled while the clipping plane is enabled (use --no-clipping)");
+  }
+
   // create a context on the first device:
   context = owlContextCreate(nullptr,1);
   OWLModule module = owlModuleCreate(context,ptxCode);
@@ -1313,8 +2018,10 @@ void printUsageAndExit(const char *progName)
             << "   --no-ground      : disable ground plane \n"
             << "   --no-clipping    : disable clipping plane controls \n"
             << "   --no-outlines    : disable toon outlines \n"
+            << "   --no-culling     : keep enclosed voxels and hidden faces (only culled with --no-clipping)\n"
             << "   --save <out.png> : save an image with a lot of samples and exit.  For generating figures.\n"
-            << "   --scenetype <s>  : user, userblocks, instanced, flat.  Default is instanced.\n";
+            << "   --scenetype <s>  : user, userblocks, instanced, flat.  Default is instanced.\n"
+            << "   --bvh-bench      : compare host-side binary and quantized 8-wide BVHs on each model, and exit\n";
 
   std::cout << "\n"
             << "If no vox files are given then a small default scene is shown\n"
@@ -1347,6 +2054,7 @@ int main(int ac, char **av)
 
   std::vector<std::string> infiles;
   std::string outFileName;
+  bool bvhBench = false;
 
   for (int i = 1; i < ac; ++i) {
     std::string arg = av[i];
@@ -1363,6 +2071,12 @@ int main(int ac, char **av)
     else if (arg == "--no-outlines") {
       options.enableToonOutline = false;
     }
+    else if (arg == "--no-culling") {
+      options.enableCulling = false;
+    }
+    else if (arg == "--bvh-bench") {
+      bvhBench = true;
+    }
     else if (arg == "--save") {
       checkArgValue(i, arg);
       outFileName = av[i+1];
@@ -1406,6 +2120,12 @@ int main(int ac, char **av)
       exit(1);
   }
 
+  if (bvhBench) {
+    benchmarkHostBVHLayouts(scene, options.enableCulling);
+    ogt_vox_destroy_scene(scene);
+    return 0;
+  }
+
   Viewer viewer(scene, sceneType, options);
   viewer.camera.setOrientation(lookFrom,
                                lookAt,
@@ -0,0 +1,775 @@
+// ======================================================================== //
+// Copyright 2019 Ingo Wald                                                 //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file s10-rtow-cpuReference/hostCode.cpp A multi-threaded CPU path
+    tracer for the "Ray Tracing in One Weekend" scenes of s05-rtow,
+    s06-rtow-mixedGeometries and s07-rtow-multiGPU: same scene
+    generation, camera, random number sequences and shading as those
+    samples' device code, traced against a host-side BVH (see
+    owl/common/bvh/), and written out in the same image format.
+
+    The frame gets rendered in tiles that worker threads pull from a
+    shared counter; since every pixel seeds its own random number
+    generator, the image doesn't depend on the number of threads or
+    the order tiles get rendered in, which makes this a deterministic
+    reference for the GPU samples, as well as a CPU throughput
+    baseline (--scaling reports samples/s for 1,2,4,... threads). */
+
+// our device-side data structures, and the materials
+#include "../s06-rtow-mixedGeometries/GeomTypes.h"
+// host-side BVH and ray kernels
+#include <owl/common/bvh/BVHTraversal.h>
+// external helper stuff for image output
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+
+using namespace owl::common;
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.sample(main): " << message << std::endl;    \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.sample(main): " << message << std::endl;    \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+/*! what differs between the three GPU samples we can serve as a
+    reference for */
+struct SampleConfig {
+  const char *name;
+  /*! s06 and s07 replace about half the spheres with boxes */
+  bool        withBoxes;
+  /*! NUM_SAMPLES_PER_PIXEL in the sample's device code */
+  int         spp;
+  /*! s05's ray gen doesn't normalize primary ray directions */
+  bool        normalizePrimaryRays;
+};
+
+const SampleConfig sampleConfigs[] = {
+  { "s05-rtow",                 false, 16, false },
+  { "s06-rtow-mixedGeometries", true,  32, true  },
+  { "s07-rtow-multiGPU",        true,  16, true  },
+};
+
+vec2i fbSize(1600,800);
+const vec3f lookFrom(13, 2, 3);
+const vec3f lookAt(0, 0, 0);
+const vec3f lookUp(0.f,1.f,0.f);
+const float fovy = 20.f;
+
+// ==================================================================
+// scene creation - the same as in s05 (without boxes), and s06/s07
+// (with boxes); this has to draw the exact same random numbers as
+// those samples do, else we'd be rendering a different scene
+// ==================================================================
+
+std::vector<DielectricSphere> dielectricSpheres;
+std::vector<LambertianSphere> lambertianSpheres;
+std::vector<MetalSphere>      metalSpheres;
+
+struct {
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  std::vector<Dielectric> materials;
+} dielectricBoxes;
+struct {
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  std::vector<Metal> materials;
+} metalBoxes;
+struct {
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  std::vector<Lambertian> materials;
+} lambertianBoxes;
+
+inline float rnd()
+{
+  static std::mt19937 gen(0); //Standard mersenne_twister_engine seeded with rd()
+  static std::uniform_real_distribution<float> dis(0.f, 1.f);
+  return dis(gen);
+}
+
+inline vec3f rnd3f() { return vec3f(rnd(),rnd(),rnd()); }
+
+inline vec3f randomPointInUnitSphere()
+{
+  vec3f p;
+  do {
+    p = 2.f*vec3f(rnd(),rnd(),rnd()) - vec3f(1.f);
+  } while (dot(p,p) >= 1.f);
+  return p;
+}
+
+template<typename BoxArray, typename Material>
+void addRandomBox(BoxArray &boxes,
+                  const vec3f &center,
+                  const float size,
+                  const Material &material)
+{
+  const int NUM_VERTICES = 8;
+  static const vec3f unitBoxVertices[NUM_VERTICES] =
+    {
+      {-1.f, -1.f, -1.f},
+      {+1.f, -1.f, -1.f},
+      {+1.f, +1.f, -1.f},
+      {-1.f, +1.f, -1.f},
+      {-1.f, +1.f, +1.f},
+      {+1.f, +1.f, +1.f},
+      {+1.f, -1.f, +1.f},
+      {-1.f, -1.f, +1.f},
+    };
+
+  const int NUM_INDICES = 12;
+  static const vec3i unitBoxIndices[NUM_INDICES] =
+    {
+      {0, 2, 1}, //face front
+      {0, 3, 2},
+      {2, 3, 4}, //face top
+      {2, 4, 5},
+      {1, 2, 5}, //face right
+      {1, 5, 6},
+      {0, 7, 4}, //face left
+      {0, 4, 3},
+      {5, 4, 7}, //face back
+      {5, 7, 6},
+      {0, 6, 7}, //face bottom
+      {0, 1, 6}
+    };
+
+  const vec3f U = normalize(randomPointInUnitSphere());
+  owl::affine3f xfm = owl::frame(U);
+  xfm = owl::affine3f(owl::linear3f::rotate(U,rnd())) * xfm;
+  xfm = owl::affine3f(owl::linear3f::scale(.7f*size)) * xfm;
+  xfm = owl::affine3f(owl::affine3f::translate(center)) * xfm;
+  
+  const int startIndex = (int)boxes.vertices.size();
+  for (int i=0;i<NUM_VERTICES;i++)
+    boxes.vertices.push_back(owl::xfmPoint(xfm,unitBoxVertices[i]));
+  for (int i=0;i<NUM_INDICES;i++)
+    boxes.indices.push_back(unitBoxIndices[i]+vec3i(startIndex));
+  boxes.materials.push_back(material);
+}
+
+void createScene(bool withBoxes)
+{
+  lambertianSpheres.push_back({Sphere{vec3f(0.f, -1000.0f, -1.f), 1000.f},
+        Lambertian{vec3f(0.5f, 0.5f, 0.5f)}});
+  
+  for (int a = -11; a < 11; a++) {
+    for (int b = -11; b < 11; b++) {
+      float choose_mat = rnd();
+      // s05 doesn't draw this one
+      float choose_shape = withBoxes ? rnd() : 0.f;
+      vec3f center(a + rnd(), 0.2f, b + rnd());
+      if (choose_mat < 0.8f) {
+        if (choose_shape > .5f) {
+          addRandomBox(lambertianBoxes,center,.2f,
+                       Lambertian{rnd3f()*rnd3f()});
+        } else
+          lambertianSpheres.push_back({Sphere{center, 0.2f},
+                Lambertian{rnd3f()*rnd3f()}});
+      } else if (choose_mat < 0.95f) {
+        if (choose_shape > .5f) {
+          addRandomBox(metalBoxes,center,.2f,
+                       Metal{0.5f*(1.f+rnd3f()),0.5f*rnd()});
+        } else
+          metalSpheres.push_back({Sphere{center, 0.2f},
+                Metal{0.5f*(1.f+rnd3f()),0.5f*rnd()}});
+      } else {
+        if (choose_shape > .5f) {
+          addRandomBox(dielectricBoxes,center,.2f,
+                       Dielectric{1.5f});
+        } else
+          dielectricSpheres.push_back({Sphere{center, 0.2f},
+                Dielectric{1.5f}});
+      }
+    }
+  }
+  dielectricSpheres.push_back({Sphere{vec3f(0.f, 1.f, 0.f), 1.f},
+        Dielectric{1.5f}});
+  lambertianSpheres.push_back({Sphere{vec3f(-4.f,1.f, 0.f), 1.f},
+        Lambertian{vec3f(0.4f, 0.2f, 0.1f)}});
+  metalSpheres.push_back({Sphere{vec3f(4.f, 1.f, 0.f), 1.f},
+        Metal{vec3f(0.7f, 0.6f, 0.5f), 0.0f}});
+}
+
+// ==================================================================
+// materials - host versions of what s05-rtow/Materials.h does on the
+// device, with the ray direction passed in rather than queried from
+// optix
+// ==================================================================
+
+typedef enum {
+              /*! ray could get properly bounced, and is still alive */
+              rayGotBounced,
+              /*! ray could not get scattered, and should get cancelled */
+              rayGotCancelled,
+              /*! ray didn't hit anything, and went into the environment */
+              rayDidntHitAnything
+} ScatterEvent;
+
+/*! what the device code's per ray data carries */
+struct PerRayData
+{
+  Random random;
+  struct {
+    ScatterEvent scatterEvent;
+    vec3f        scattered_origin;
+    vec3f        scattered_direction;
+    vec3f        attenuation;
+  } out;
+};
+
+inline float schlick(float cosine,
+                     float ref_idx)
+{
+  float r0 = (1.0f - ref_idx) / (1.0f + ref_idx);
+  r0 = r0 * r0;
+  return r0 + (1.0f - r0)*powf((1.0f - cosine), 5.0f);
+}
+
+inline bool refract(const vec3f& v,
+                    const vec3f& n,
+                    float ni_over_nt,
+                    vec3f &refracted)
+{
+  vec3f uv = normalize(v);
+  float dt = dot(uv, n);
+  float discriminant = 1.0f - ni_over_nt * ni_over_nt*(1 - dt * dt);
+  if (discriminant > 0.f) {
+    refracted = ni_over_nt * (uv - n * dt) - n * sqrtf(discriminant);
+    return true;
+  }
+  else
+    return false;
+}
+
+inline vec3f reflect(const vec3f &v,
+                     const vec3f &n)
+{
+  return v - 2.0f*dot(v, n)*n;
+}
+
+inline vec3f randomPointInUnitSphere(Random &rnd)
+{
+  vec3f p;
+  do {
+    p = 2.0f*vec3f(rnd(),rnd(),rnd()) - vec3f(1, 1, 1);
+  } while (dot(p,p) >= 1.0f);
+  return p;
+}
+
+inline bool scatter(const Lambertian &lambertian,
+                    const vec3f &dir,
+                    const vec3f &P,
+                    vec3f N,
+                    PerRayData &prd)
+{
+  if (dot(N,dir)  > 0.f)
+    N = -N;
+  N = normalize(N);
+
+  const vec3f target
+    = P + (N + randomPointInUnitSphere(prd.random));
+  
+  prd.out.scattered_origin    = P;
+  prd.out.scattered_direction = (target-P);
+  prd.out.attenuation         = lambertian.albedo;
+  return true;
+}
+
+inline bool scatter(const Dielectric &dielectric,
+                    const vec3f &rayDir,
+                    const vec3f &P,
+                    vec3f N,
+                    PerRayData &prd)
+{
+  const vec3f dir = normalize(rayDir);
+
+  N = normalize(N);
+  vec3f outward_normal;
+  vec3f reflected = reflect(dir,N);
+  float ni_over_nt;
+  prd.out.attenuation = vec3f(1.f, 1.f, 1.f); 
+  vec3f refracted = 0.f;
+  float reflect_prob;
+  float cosine;
+  
+  if (dot(dir,N) > 0.f) {
+    outward_normal = -N;
+    ni_over_nt = dielectric.ref_idx;
+    cosine = dot(dir, N);
+    cosine = sqrtf(1.f - dielectric.ref_idx*dielectric.ref_idx*(1.f-cosine*cosine));
+  }
+  else {
+    outward_normal = N;
+    ni_over_nt = 1.0f / dielectric.ref_idx;
+    cosine = -dot(dir, N);
+  }
+  if (refract(dir, outward_normal, ni_over_nt, refracted)) 
+    reflect_prob = schlick(cosine, dielectric.ref_idx);
+  else 
+    reflect_prob = 1.f;
+
+  prd.out.scattered_origin = P;
+  if (prd.random() < reflect_prob) 
+    prd.out.scattered_direction = reflected;
+  else 
+    prd.out.scattered_direction = refracted;
+  
+  return true;
+}
+
+inline bool scatter(const Metal &metal,
+                    const vec3f &dir,
+                    const vec3f &P,
+                    vec3f N,
+                    PerRayData &prd)
+{
+  if (dot(N,dir)  > 0.f)
+    N = -N;
+  N = normalize(N);
+  
+  vec3f reflected = reflect(normalize(dir),N);
+  prd.out.scattered_origin    = P;
+  prd.out.scattered_direction
+    = (reflected+metal.fuzz*randomPointInUnitSphere(prd.random));
+  prd.out.attenuation         = metal.albedo;
+  return (dot(prd.out.scattered_direction, N) > 0.f);
+}
+
+// ==================================================================
+// the scene, as seen by the CPU tracer: one BVH over all spheres and
+// box triangles
+// ==================================================================
+
+struct CPUScene {
+  /*! which of the scene's arrays a BVH prim refers to */
+  enum PrimType {
+    LAMBERTIAN_SPHERE, METAL_SPHERE, DIELECTRIC_SPHERE,
+    LAMBERTIAN_BOX,    METAL_BOX,    DIELECTRIC_BOX
+  };
+  struct PrimRef {
+    PrimType type;
+    /*! index of the sphere, or of the box triangle */
+    int      index;
+  };
+
+  void build();
+
+  /*! closest-hit, plus what the sample's closest hit programs would
+      then do; returns false if the ray didn't hit anything */
+  bool traceAndScatter(HostRay &ray, PerRayData &prd) const;
+
+  inline bool intersectPrim(int primID, HostRay &ray, HostHit &hit) const;
+
+  std::vector<PrimRef> prims;
+  BVH                  bvh;
+};
+
+inline const Sphere &getSphere(const CPUScene::PrimRef &prim)
+{
+  switch (prim.type) {
+  case CPUScene::LAMBERTIAN_SPHERE: return lambertianSpheres[prim.index].sphere;
+  case CPUScene::METAL_SPHERE:      return metalSpheres[prim.index].sphere;
+  default:                          return dielectricSpheres[prim.index].sphere;
+  }
+}
+
+template<typename Boxes>
+inline void getTriangle(const Boxes &boxes, int triID, vec3f &A, vec3f &B, vec3f &C)
+{
+  const vec3i index = boxes.indices[triID];
+  A = boxes.vertices[index.x];
+  B = boxes.vertices[index.y];
+  C = boxes.vertices[index.z];
+}
+
+inline void getTriangle(const CPUScene::PrimRef &prim, vec3f &A, vec3f &B, vec3f &C)
+{
+  switch (prim.type) {
+  case CPUScene::LAMBERTIAN_BOX: getTriangle(lambertianBoxes,prim.index,A,B,C); break;
+  case CPUScene::METAL_BOX:      getTriangle(metalBoxes,prim.index,A,B,C);      break;
+  default:                       getTriangle(dielectricBoxes,prim.index,A,B,C); break;
+  }
+}
+
+void CPUScene::build()
+{
+  prims.clear();
+  for (size_t i=0;i<lambertianSpheres.size();i++) prims.push_back({LAMBERTIAN_SPHERE,int(i)});
+  for (size_t i=0;i<metalSpheres.size();i++)      prims.push_back({METAL_SPHERE,int(i)});
+  for (size_t i=0;i<dielectricSpheres.size();i++) prims.push_back({DIELECTRIC_SPHERE,int(i)});
+  for (size_t i=0;i<lambertianBoxes.indices.size();i++) prims.push_back({LAMBERTIAN_BOX,int(i)});
+  for (size_t i=0;i<metalBoxes.indices.size();i++)      prims.push_back({METAL_BOX,int(i)});
+  for (size_t i=0;i<dielectricBoxes.indices.size();i++) prims.push_back({DIELECTRIC_BOX,int(i)});
+
+  std::vector<box3f> bounds(prims.size());
+  for (size_t i=0;i<prims.size();i++) {
+    const PrimRef &prim = prims[i];
+    if (prim.type <= DIELECTRIC_SPHERE) {
+      const Sphere &sphere = getSphere(prim);
+      bounds[i] = box3f(sphere.center - sphere.radius,
+                        sphere.center + sphere.radius);
+    } else {
+      vec3f A, B, C;
+      getTriangle(prim,A,B,C);
+      bounds[i] = box3f().including(A).including(B).including(C);
+    }
+  }
+  bvh.build(bounds.data(),bounds.size());
+}
+
+/*! same as the samples' sphere intersection programs */
+inline bool intersectSphere(const Sphere &sphere, HostRay &ray)
+{
+  const vec3f org  = ray.origin;
+  const vec3f dir  = ray.direction;
+  float hit_t      = ray.tmax;
+  const float tmin = ray.tmin;
+
+  const vec3f oc = org - sphere.center;
+  const float a = dot(dir,dir);
+  const float b = dot(oc, dir);
+  const float c = dot(oc, oc) - sphere.radius * sphere.radius;
+  const float discriminant = b * b - a * c;
+  
+  if (discriminant < 0.f) return false;
+
+  {
+    float temp = (-b - sqrtf(discriminant)) / a;
+    if (temp < hit_t && temp > tmin) 
+      hit_t = temp;
+  }
+      
+  {
+    float temp = (-b + sqrtf(discriminant)) / a;
+    if (temp < hit_t && temp > tmin) 
+      hit_t = temp;
+  }
+  if (hit_t < ray.tmax) {
+    ray.tmax = hit_t;
+    return true;
+  }
+  return false;
+}
+
+inline bool CPUScene::intersectPrim(int primID, HostRay &ray, HostHit &hit) const
+{
+  const PrimRef &prim = prims[primID];
+  if (prim.type <= DIELECTRIC_SPHERE) {
+    if (!intersectSphere(getSphere(prim),ray)) return false;
+    hit.primID = primID;
+    return true;
+  }
+  vec3f A, B, C;
+  getTriangle(prim,A,B,C);
+  return intersectTriangle(ray,hit,A,B,C,primID);
+}
+
+bool CPUScene::traceAndScatter(HostRay &ray, PerRayData &prd) const
+{
+  HostHit hit;
+  if (!traceClosest(bvh,ray,hit,[this](int primID, HostRay &ray, HostHit &hit){
+        return intersectPrim(primID,ray,hit);
+      }))
+    return false;
+  
+  const PrimRef &prim = prims[hit.primID];
+  const vec3f dir   = ray.direction;
+  const vec3f hit_P = ray.origin + ray.tmax * dir;
+  bool bounced = false;
+  if (prim.type <= DIELECTRIC_SPHERE) {
+    const vec3f N = hit_P - getSphere(prim).center;
+    switch (prim.type) {
+    case LAMBERTIAN_SPHERE:
+      bounced = scatter(lambertianSpheres[prim.index].material,dir,hit_P,N,prd); break;
+    case METAL_SPHERE:
+      bounced = scatter(metalSpheres[prim.index].material,dir,hit_P,N,prd); break;
+    default:
+      bounced = scatter(dielectricSpheres[prim.index].material,dir,hit_P,N,prd); break;
+    }
+  } else {
+    vec3f A, B, C;
+    getTriangle(prim,A,B,C);
+    const vec3f N = normalize(cross(B-A,C-A));
+    // there's 12 tris per box:
+    const int materialID = prim.index / 12;
+    switch (prim.type) {
+    case LAMBERTIAN_BOX:
+      bounced = scatter(lambertianBoxes.materials[materialID],dir,hit_P,N,prd); break;
+    case METAL_BOX:
+      bounced = scatter(metalBoxes.materials[materialID],dir,hit_P,N,prd); break;
+    default:
+      bounced = scatter(dielectricBoxes.materials[materialID],dir,hit_P,N,prd); break;
+    }
+  }
+  prd.out.scatterEvent = bounced ? rayGotBounced : rayGotCancelled;
+  return true;
+}
+
+// ==================================================================
+// the path tracer itself
+// ==================================================================
+
+struct Camera {
+  vec3f origin;
+  vec3f lower_left_corner;
+  vec3f horizontal;
+  vec3f vertical;
+};
+
+/*! the same camera that the samples' host code sets up */
+Camera createCamera()
+{
+  const float vfov = fovy;
+  const vec3f vup = lookUp;
+  const float aspect = fbSize.x / float(fbSize.y);
+  const float theta = vfov * ((float)M_PI) / 180.0f;
+  const float half_height = tanf(theta / 2.0f);
+  const float half_width = aspect * half_height;
+  const float focusDist = 10.f;
+  const vec3f origin = lookFrom;
+  const vec3f w = normalize(lookFrom - lookAt);
+  const vec3f u = normalize(cross(vup, w));
+  const vec3f v = cross(w, u);
+  Camera camera;
+  camera.origin = origin;
+  camera.lower_left_corner
+    = origin - half_width * focusDist*u - half_height * focusDist*v - focusDist * w;
+  camera.horizontal = 2.0f*half_width*focusDist*u;
+  camera.vertical = 2.0f*half_height*focusDist*v;
+  return camera;
+}
+
+inline vec3f missColor(const HostRay &ray)
+{
+  const vec3f rayDir = normalize(ray.direction);
+  const float t = 0.5f*(rayDir.y + 1.0f);
+  const vec3f c = (1.0f - t)*vec3f(1.0f, 1.0f, 1.0f) + t * vec3f(0.5f, 0.7f, 1.0f);
+  return c;
+}
+
+inline vec3f tracePath(const CPUScene &scene, HostRay &ray, PerRayData &prd)
+{
+  vec3f attenuation = vec3f(1.f);
+  
+  /* iterative version of recursion, up to depth 50 */
+  for (int depth=0;depth<50;depth++) {
+    if (!scene.traceAndScatter(ray,prd))
+      /* ray got 'lost' to the environment - 'light' it with miss
+         shader */
+      return attenuation * missColor(ray);
+    else if (prd.out.scatterEvent == rayGotCancelled)
+      return vec3f(0.f);
+
+    else { // ray is still alive, and got properly bounced
+      attenuation *= prd.out.attenuation;
+      ray = HostRay(/* origin   : */ prd.out.scattered_origin,
+                    /* direction: */ prd.out.scattered_direction,
+                    /* tmin     : */ 1e-3f,
+                    /* tmax     : */ 1e10f);
+    }
+  }
+  // recursion did not terminate - cancel it
+  return vec3f(0.f);
+}
+
+/*! host version of owl::make_rgba() */
+inline uint32_t make_rgba(const vec3f color)
+{
+  auto make_8bit = [](const float f) -> uint32_t
+    { return std::min(255,std::max(0,int(f*256.f))); };
+  return
+    (make_8bit(color.x) << 0) +
+    (make_8bit(color.y) << 8) +
+    (make_8bit(color.z) << 16) +
+    (0xffU << 24);
+}
+
+/*! what the samples' ray gen program does for one pixel */
+inline uint32_t renderPixel(const CPUScene &scene, const Camera &camera,
+                            const SampleConfig &config, const vec2i &pixelID)
+{
+  PerRayData prd;
+  prd.random.init(pixelID.x,pixelID.y);
+  
+  vec3f color = 0.f;
+  for (int sampleID=0;sampleID<config.spp;sampleID++) {
+    const vec2f pixelSample(prd.random(),prd.random());
+    const vec2f screen
+      = (vec2f(pixelID)+pixelSample)
+      / vec2f(fbSize);
+    const vec3f direction
+      = camera.lower_left_corner
+      + screen.u * camera.horizontal
+      + screen.v * camera.vertical
+      - camera.origin;
+    // same tmin/tmax as an owl::Ray's defaults
+    HostRay ray(camera.origin,
+                config.normalizePrimaryRays ? normalize(direction) : direction,
+                0.f,1e30f);
+    color += tracePath(scene, ray, prd);
+  }
+  return make_rgba(color * (1.f / config.spp));
+}
+
+/*! renders the frame in tiles of tileSize^2 pixels, on 'numThreads'
+    threads that each keep pulling the next not-yet-rendered tile
+    until there are none left */
+void renderFrame(const CPUScene &scene, const Camera &camera,
+                 const SampleConfig &config, int numThreads, uint32_t *fb)
+{
+  const int tileSize = 16;
+  const vec2i numTiles = (fbSize+vec2i(tileSize-1))/vec2i(tileSize);
+  std::atomic<int> nextTile(0);
+  auto worker = [&]() {
+    while (true) {
+      const int tileID = nextTile++;
+      if (tileID >= numTiles.x*numTiles.y) break;
+      const vec2i begin = vec2i(tileID % numTiles.x, tileID / numTiles.x)*tileSize;
+      const vec2i end   = min(begin+vec2i(tileSize),fbSize);
+      for (int iy=begin.y;iy<end.y;iy++)
+        for (int ix=begin.x;ix<end.x;ix++) {
+          const int pixelIdx = ix+fbSize.x*(fbSize.y-1-iy);
+          fb[pixelIdx] = renderPixel(scene,camera,config,vec2i(ix,iy));
+        }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i=1;i<numThreads;i++)
+    threads.push_back(std::thread(worker));
+  worker();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+void usage(const std::string &error = "")
+{
+  if (error != "")
+    std::cout << OWL_TERMINAL_RED << "Error: " << error
+              << OWL_TERMINAL_DEFAULT << std::endl << std::endl;
+  std::cout << "Usage: ./sample10-rtow-cpuReference [args]" << std::endl;
+  std::cout << "w/ args:" << std::endl;
+  std::cout << "  --sample <name>  : which sample to render the scene of: s05-rtow," << std::endl;
+  std::cout << "                     s06-rtow-mixedGeometries (default), or s07-rtow-multiGPU" << std::endl;
+  std::cout << "  --size <w> <h>   : frame size (default: 1600 800, as in the samples)" << std::endl;
+  std::cout << "  --spp <n>        : samples per pixel (default: the sample's)" << std::endl;
+  std::cout << "  --threads <n>    : number of threads (default: all hardware threads)" << std::endl;
+  std::cout << "  --scaling        : render with 1,2,4,... threads, report samples/s for" << std::endl;
+  std::cout << "                     each, and check that all give the same image" << std::endl;
+  std::cout << "  -o <file.png>    : output file (default: <sample>-cpu.png)" << std::endl;
+  exit(error != "");
+}
+
+int main(int ac, char **av)
+{
+  LOG("owl example '" << av[0] << "' starting up");
+
+  SampleConfig config = sampleConfigs[1];
+  int numThreads = std::max(1,(int)std::thread::hardware_concurrency());
+  bool scaling = false;
+  std::string outFileName;
+  for (int i=1;i<ac;i++) {
+    const std::string arg = av[i];
+    if (arg == "--sample" && i+1<ac) {
+      const std::string name = av[++i];
+      bool found = false;
+      for (auto &c : sampleConfigs)
+        if (name == c.name) { config = c; found = true; }
+      if (!found)
+        usage("unknown sample '"+name+"'");
+    } else if (arg == "--size" && i+2<ac) {
+      fbSize.x = atoi(av[++i]);
+      fbSize.y = atoi(av[++i]);
+    } else if (arg == "--spp" && i+1<ac)
+      config.spp = std::max(1,atoi(av[++i]));
+    else if (arg == "--threads" && i+1<ac)
+      numThreads = std::max(1,atoi(av[++i]));
+    else if (arg == "--scaling")
+      scaling = true;
+    else if (arg == "-o" && i+1<ac)
+      outFileName = av[++i];
+    else if (arg == "-h" || arg == "--help")
+      usage();
+    else
+      usage("unknown argument '"+arg+"'");
+  }
+  if (fbSize.x <= 0 || fbSize.y <= 0)
+    usage("invalid frame size");
+  if (outFileName == "")
+    outFileName = std::string(config.name)+"-cpu.png";
+
+  LOG("creating the scene of " << config.name << " ...");
+  createScene(config.withBoxes);
+  LOG_OK("created scene:");
+  LOG_OK(" num lambertian spheres: " << lambertianSpheres.size());
+  LOG_OK(" num dielectric spheres: " << dielectricSpheres.size());
+  LOG_OK(" num metal spheres     : " << metalSpheres.size());
+  LOG_OK(" num boxes             : " << (lambertianBoxes.materials.size()
+                                         +dielectricBoxes.materials.size()
+                                         +metalBoxes.materials.size()));
+
+  CPUScene scene;
+  double t0 = getCurrentTime();
+  scene.build();
+  LOG_OK("built BVH over " << scene.prims.size() << " prims in "
+         << prettyDouble(getCurrentTime()-t0) << "s");
+  const Camera camera = createCamera();
+
+  const size_t numPixels  = size_t(fbSize.x)*fbSize.y;
+  const size_t numSamples = numPixels*config.spp;
+  std::vector<uint32_t> fb(numPixels);
+  std::vector<int> threadCounts;
+  if (scaling) {
+    for (int n=1;n<numThreads;n*=2)
+      threadCounts.push_back(n);
+  }
+  threadCounts.push_back(numThreads);
+
+  double singleThreadTime = 0.;
+  std::vector<uint32_t> referenceFB;
+  for (int n : threadCounts) {
+    LOG("rendering " << fbSize.x << "x" << fbSize.y << " at " << config.spp
+        << " spp on " << n << " thread(s) ...");
+    t0 = getCurrentTime();
+    renderFrame(scene,camera,config,n,fb.data());
+    const double t = getCurrentTime()-t0;
+    if (n == 1) singleThreadTime = t;
+    char speedup[64] = "";
+    if (singleThreadTime > 0. && n > 1)
+      snprintf(speedup,sizeof(speedup)," (%.2fx the single-thread rate)",singleThreadTime/t);
+    LOG_OK("done in " << prettyDouble(t) << "s: "
+           << prettyDouble(numSamples/t) << " samples/s" << speedup);
+    if (referenceFB.empty())
+      referenceFB = fb;
+    else if (fb != referenceFB)
+      throw std::runtime_error("rendering on "+std::to_string(n)
+                               +" threads gave a different image");
+  }
+
+  LOG("done with rendering, writing picture ...");
+  stbi_write_png(outFileName.c_str(),fbSize.x,fbSize.y,4,
+                 fb.data(),fbSize.x*sizeof(uint32_t));
+  LOG_OK("written rendered frame buffer to file "<<outFileName);
+  return 0;
+}
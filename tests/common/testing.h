@@ -0,0 +1,85 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file tests/common/testing.h What the host-side tests share:
+    LOG/LOG_OK (prefixed with "#owl.test(<OWL_TEST_NAME>): ", so
+    OWL_TEST_NAME has to be defined before including this), CHECK,
+    which fails the test (with exit code 1) if a condition doesn't
+    hold, and a seeded random number generator */
+
+#pragma once
+
+#include "owl/common/math/vec.h"
+#include <cstdlib>
+#include <random>
+
+#ifndef OWL_TEST_NAME
+# error "#define OWL_TEST_NAME before including tests/common/testing.h"
+#endif
+
+#define LOG(message)                                                    \
+  do {                                                                  \
+    std::cout << OWL_TERMINAL_BLUE;                                     \
+    std::cout << "#owl.test(" OWL_TEST_NAME "): " << message << std::endl; \
+    std::cout << OWL_TERMINAL_DEFAULT;                                  \
+  } while (0)
+
+#define LOG_OK(message)                                                 \
+  do {                                                                  \
+    std::cout << OWL_TERMINAL_LIGHT_BLUE;                               \
+    std::cout << "#owl.test(" OWL_TEST_NAME "): " << message << std::endl; \
+    std::cout << OWL_TERMINAL_DEFAULT;                                  \
+  } while (0)
+
+#define CHECK(cond)                                                     \
+  do {                                                                  \
+    if (!(cond)) {                                                      \
+      std::cerr << OWL_TERMINAL_RED << "test failed: " << #cond         \
+                << " (" << __FILE__ << ":" << __LINE__ << ")"           \
+                << OWL_TERMINAL_DEFAULT << std::endl;                   \
+      exit(1);                                                          \
+    }                                                                   \
+  } while (0)
+
+/*! deterministic (per seed) random numbers, points and directions */
+struct Random {
+  Random(int seed) : rng(seed) {}
+
+  /*! uniform in [lo,hi) */
+  float operator()(float lo, float hi)
+  { return std::uniform_real_distribution<float>(lo,hi)(rng); }
+
+  /*! uniform in [lo,hi] */
+  size_t size(size_t lo, size_t hi)
+  { return std::uniform_int_distribution<size_t>(lo,hi)(rng); }
+
+  float gaussian(float sigma)
+  { return std::normal_distribution<float>(0.f,sigma)(rng); }
+
+  owl::common::vec3f point(float lo, float hi)
+  { return owl::common::vec3f((*this)(lo,hi),(*this)(lo,hi),(*this)(lo,hi)); }
+
+  /*! uniform on the unit sphere */
+  owl::common::vec3f direction()
+  {
+    while (true) {
+      const owl::common::vec3f d = point(-1.f,1.f);
+      if (dot(d,d) > 1e-4f && dot(d,d) <= 1.f) return normalize(d);
+    }
+  }
+
+  std::mt19937 rng;
+};
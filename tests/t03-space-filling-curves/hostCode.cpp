@@ -0,0 +1,176 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t03-space-filling-curves/hostCode.cpp - host-only unit test
+    and benchmark for the morton and hilbert encoders/decoders in
+    owl/common/math/morton.h */
+
+#include "owl/common/math/morton.h"
+#include <random>
+#include <vector>
+
+#define OWL_TEST_NAME "sfc"
+#include "tests/common/testing.h"
+
+using namespace owl::common;
+
+inline uint32_t manhattan(const vec3ui &a, const vec3ui &b)
+{
+  return
+    (a.x > b.x ? a.x-b.x : b.x-a.x) +
+    (a.y > b.y ? a.y-b.y : b.y-a.y) +
+    (a.z > b.z ? a.z-b.z : b.z-a.z);
+}
+
+void testMorton()
+{
+  std::mt19937 rng(0x1234);
+  // exhaustive on a 64^3 sub-grid, and random over the full range
+  for (uint32_t z=0;z<64;z++)
+    for (uint32_t y=0;y<64;y++)
+      for (uint32_t x=0;x<64;x++) {
+        const vec3ui c(x,y,z);
+        CHECK(mortonDecode30(mortonEncode30(c)) == c);
+        CHECK(mortonDecode63(mortonEncode63(c)) == c);
+      }
+  for (int i=0;i<1000000;i++) {
+    const vec3ui c10(rng()&0x3ff,rng()&0x3ff,rng()&0x3ff);
+    CHECK(mortonDecode30(mortonEncode30(c10)) == c10);
+    const vec3ui c21(rng()&0x1fffff,rng()&0x1fffff,rng()&0x1fffff);
+    CHECK(mortonDecode63(mortonEncode63(c21)) == c21);
+    // the 30-bit code has to be the top bits of the 63-bit code
+    // for the same relative position
+    CHECK((mortonEncode63(c10*2048u) >> 33) == mortonEncode30(c10));
+#if OWL_HAVE_BMI2_MORTON
+    if (detail::cpuHasBMI2()) {
+      CHECK(detail::mortonEncode63_bmi2(c21) == mortonEncode63(c21));
+      CHECK(detail::mortonDecode63_bmi2(mortonEncode63(c21)) == c21);
+    }
+#endif
+  }
+  CHECK(mortonEncode30(vec3ui(1,0,0)) == 1);
+  CHECK(mortonEncode30(vec3ui(0,1,0)) == 2);
+  CHECK(mortonEncode30(vec3ui(0,0,1)) == 4);
+  CHECK(mortonEncode30(vec3ui(0x3ff)) == 0x3fffffffu);
+  CHECK(mortonEncode63(vec3ui(0x1fffff)) == 0x7fffffffffffffffull);
+  LOG_OK("morton encode/decode ok");
+}
+
+void testHilbert()
+{
+  // along the curve, every step has to move to a direct neighbor
+  // (which is what makes it a hilbert curve), and every cell has to
+  // be visited exactly once
+  const int numBits = 5;
+  const uint32_t numCells = 1u<<(3*numBits);
+  std::vector<bool> visited(numCells,false);
+  vec3ui prev;
+  for (uint32_t i=0;i<numCells;i++) {
+    // use the generic transform for a 5-bit curve directly
+    const vec3ui T = mortonDecode30(i);
+    uint32_t X[3] = { T.z, T.y, T.x };
+    hilbertTransposeToAxes(X,numBits);
+    const vec3ui cell(X[0],X[1],X[2]);
+    CHECK(cell.x < 32 && cell.y < 32 && cell.z < 32);
+    const uint32_t cellID = cell.x+32*(cell.y+32*cell.z);
+    CHECK(!visited[cellID]);
+    visited[cellID] = true;
+    if (i > 0) CHECK(manhattan(cell,prev) == 1);
+    prev = cell;
+
+    uint32_t Y[3] = { cell.x, cell.y, cell.z };
+    hilbertAxesToTranspose(Y,numBits);
+    CHECK(mortonEncode30(vec3ui(Y[2],Y[1],Y[0])) == i);
+  }
+
+  std::mt19937 rng(0x4321);
+  for (int i=0;i<1000000;i++) {
+    const vec3ui c10(rng()&0x3ff,rng()&0x3ff,rng()&0x3ff);
+    CHECK(hilbertDecode30(hilbertEncode30(c10)) == c10);
+    const vec3ui c21(rng()&0x1fffff,rng()&0x1fffff,rng()&0x1fffff);
+    CHECK(hilbertDecode63(hilbertEncode63(c21)) == c21);
+  }
+  for (uint32_t i=1;i<1000000;i++)
+    CHECK(manhattan(hilbertDecode30(i),hilbertDecode30(i-1)) == 1);
+  for (uint64_t i=1;i<1000000;i++)
+    CHECK(manhattan(hilbertDecode63(i),hilbertDecode63(i-1)) == 1);
+  LOG_OK("hilbert encode/decode ok");
+}
+
+void testAndBenchBatched()
+{
+  const size_t N = 4*1024*1024+3;
+  std::vector<vec3f> points(N);
+  std::mt19937 rng(0x777);
+  std::uniform_real_distribution<float> rnd(-10.f,10.f);
+  for (auto &p : points) p = vec3f(rnd(rng),rnd(rng),rnd(rng));
+  // make sure we also exercise clamping, and NaNs
+  points[0] = vec3f(-100.f);
+  points[1] = vec3f(+100.f);
+  points[2] = vec3f(NAN);
+  const box3f bounds = computeBounds(points.data()+3,N-3);
+  const MortonQuantizer q10(bounds,10);
+  const MortonQuantizer q21(bounds,21);
+
+  std::vector<uint32_t> codes30(N);
+  std::vector<uint64_t> codes63(N);
+
+  double t0 = getCurrentTime();
+  computeMortonCodes(codes30.data(),points.data(),N,bounds);
+  double t1 = getCurrentTime();
+  LOG("30-bit morton  : " << prettyDouble(N/(t1-t0)) << " points/s");
+  for (size_t i=0;i<N;i++)
+    CHECK(codes30[i] == mortonEncode30(q10(points[i])));
+  CHECK(codes30[0] == 0 && codes30[1] == 0x3fffffffu && codes30[2] == 0);
+
+  t0 = getCurrentTime();
+  computeMortonCodes(codes63.data(),points.data(),N,bounds);
+  t1 = getCurrentTime();
+  LOG("63-bit morton  : " << prettyDouble(N/(t1-t0)) << " points/s");
+  for (size_t i=0;i<N;i++)
+    CHECK(codes63[i] == mortonEncode63(q21(points[i])));
+
+  t0 = getCurrentTime();
+  computeHilbertCodes(codes30.data(),points.data(),N,bounds);
+  t1 = getCurrentTime();
+  LOG("30-bit hilbert : " << prettyDouble(N/(t1-t0)) << " points/s");
+  for (size_t i=0;i<N;i++)
+    CHECK(codes30[i] == hilbertEncode30(q10(points[i])));
+
+  t0 = getCurrentTime();
+  computeHilbertCodes(codes63.data(),points.data(),N,bounds);
+  t1 = getCurrentTime();
+  LOG("63-bit hilbert : " << prettyDouble(N/(t1-t0)) << " points/s");
+  for (size_t i=0;i<N;i++)
+    CHECK(codes63[i] == hilbertEncode63(q21(points[i])));
+
+  // scalar reference, for comparison
+  t0 = getCurrentTime();
+  for (size_t i=0;i<N;i++)
+    codes30[i] = mortonEncode30(q10(points[i]));
+  t1 = getCurrentTime();
+  LOG("30-bit morton, scalar reference: " << prettyDouble(N/(t1-t0)) << " points/s");
+  LOG_OK("batched encoders ok");
+}
+
+int main(int ac, char **av)
+{
+  testMorton();
+  testHilbert();
+  testAndBenchBatched();
+  LOG_OK("all tests passed");
+  return 0;
+}
@@ -0,0 +1,215 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t04-batched-transforms/hostCode.cpp - host-only unit test
+    and benchmark for the batched affine3f inversion, decomposition,
+    and quaternion interpolation in owl/common/math/batchedTransforms.h */
+
+#include "owl/common/math/batchedTransforms.h"
+#include <random>
+#include <vector>
+
+#define OWL_TEST_NAME "xfm"
+#include "tests/common/testing.h"
+
+using namespace owl::common;
+
+inline float maxDiff(const affine3f &a, const affine3f &b)
+{
+  const float *fa = &a.l.vx.x, *fb = &b.l.vx.x;
+  float d = 0.f;
+  for (int k=0;k<12;k++) d = std::max(d,fabsf(fa[k]-fb[k]));
+  return d;
+}
+
+/*! difference between two quaternions, modulo the q == -q ambiguity */
+inline float maxDiff(const Quaternion3f &a, const Quaternion3f &b)
+{
+  const float s = dot(a,b) < 0.f ? -1.f : 1.f;
+  return std::max(std::max(fabsf(a.r-s*b.r),fabsf(a.i-s*b.i)),
+                  std::max(fabsf(a.j-s*b.j),fabsf(a.k-s*b.k)));
+}
+
+inline float maxDiff(const vec3f &a, const vec3f &b)
+{
+  return reduce_max(abs(a-b));
+}
+
+inline affine3f compose(const Quaternion3f &r, const vec3f &s, const vec3f &t)
+{
+  return affine3f(linear3f(r)*linear3f::scale(s),t);
+}
+
+Quaternion3f randomRotation(Random &rnd)
+{
+  return normalize(Quaternion3f(rnd(-1.f,1.f),rnd(-1.f,1.f),
+                                rnd(-1.f,1.f),rnd(-1.f,1.f)));
+}
+
+const size_t N = 1024*1024+5;
+
+void testRcp()
+{
+  Random rnd(0x1234);
+  std::vector<affine3f> xfms(N), inv(N);
+  for (auto &xfm : xfms)
+    xfm = compose(randomRotation(rnd),
+                  vec3f(rnd(.1f,10.f),rnd(.1f,10.f),rnd(.1f,10.f)),
+                  vec3f(rnd(-100.f,100.f),rnd(-100.f,100.f),rnd(-100.f,100.f)));
+
+  double t0 = getCurrentTime();
+  rcp(inv.data(),xfms.data(),N);
+  double t1 = getCurrentTime();
+  LOG("batched rcp    : " << prettyDouble(N/(t1-t0)) << " xfms/s");
+
+  for (size_t i=0;i<N;i++) {
+    const affine3f ref = rcp(xfms[i]);
+    CHECK(maxDiff(inv[i],ref) <= 1e-4f*(1.f+reduce_max(abs(ref.p))));
+    CHECK(maxDiff(xfms[i]*inv[i],affine3f(one)) < 1e-3f);
+  }
+
+  // in-place has to give the same result
+  std::vector<affine3f> inPlace = xfms;
+  rcp(inPlace.data(),inPlace.data(),N);
+  for (size_t i=0;i<N;i++)
+    CHECK(maxDiff(inPlace[i],inv[i]) == 0.f);
+
+  t0 = getCurrentTime();
+  for (size_t i=0;i<N;i++)
+    inv[i] = rcp(xfms[i]);
+  t1 = getCurrentTime();
+  LOG("scalar rcp     : " << prettyDouble(N/(t1-t0)) << " xfms/s");
+  LOG_OK("batched rcp ok");
+}
+
+void testDecompose()
+{
+  Random rnd(0x4321);
+  std::vector<affine3f>     xfms(N);
+  std::vector<Quaternion3f> rot(N), rotRef(N);
+  std::vector<vec3f>        scale(N), scaleRef(N), translation(N);
+  for (size_t i=0;i<N;i++) {
+    rotRef[i]   = randomRotation(rnd);
+    scaleRef[i] = vec3f(rnd(.1f,10.f),rnd(.1f,10.f),rnd(.1f,10.f));
+    // every 7th transform mirrors
+    if (i % 7 == 3) scaleRef[i].x = -scaleRef[i].x;
+    xfms[i] = compose(rotRef[i],scaleRef[i],
+                      vec3f(rnd(-100.f,100.f),rnd(-100.f,100.f),rnd(-100.f,100.f)));
+  }
+  // some degenerate ones, too
+  xfms[5].l.vy = vec3f(0.f);
+  xfms[6] = affine3f(linear3f(zero),vec3f(1.f,2.f,3.f));
+
+  double t0 = getCurrentTime();
+  decompose(rot.data(),scale.data(),translation.data(),xfms.data(),N);
+  double t1 = getCurrentTime();
+  LOG("batched decompose: " << prettyDouble(N/(t1-t0)) << " xfms/s");
+
+  for (size_t i=0;i<N;i++) {
+    Quaternion3f r; vec3f s, t;
+    decompose(xfms[i],r,s,t);
+    CHECK(maxDiff(rot[i],r) < 1e-4f);
+    CHECK(maxDiff(scale[i],s) < 1e-4f*(1.f+reduce_max(abs(s))));
+    CHECK(translation[i] == t);
+    if (i == 5 || i == 6) continue;
+    // ... and both have to recover what we built the transform from
+    CHECK(maxDiff(r,rotRef[i]) < 1e-4f);
+    CHECK(maxDiff(s,scaleRef[i]) < 1e-4f*(1.f+reduce_max(abs(s))));
+    CHECK(maxDiff(compose(r,s,t),xfms[i]) < 1e-3f);
+  }
+  CHECK(rot[6] == Quaternion3f(one));
+  CHECK(scale[6] == vec3f(0.f));
+
+  // sheared transforms: the rotation has to be orthonormal, and
+  // agree with the scalar version
+  for (size_t i=0;i<N;i++)
+    xfms[i].l.vy += rnd(-.5f,.5f)*xfms[i].l.vx;
+  decompose(rot.data(),nullptr,nullptr,xfms.data(),N);
+  for (size_t i=0;i<N;i+=17) {
+    Quaternion3f r; vec3f s, t;
+    decompose(xfms[i],r,s,t);
+    if (i == 5 || i == 6) continue;
+    CHECK(maxDiff(rot[i],r) < 1e-4f);
+    CHECK(fabsf(dot(rot[i],rot[i])-1.f) < 1e-5f);
+  }
+
+  t0 = getCurrentTime();
+  for (size_t i=0;i<N;i++)
+    decompose(xfms[i],rot[i],scale[i],translation[i]);
+  t1 = getCurrentTime();
+  LOG("scalar decompose : " << prettyDouble(N/(t1-t0)) << " xfms/s");
+  LOG_OK("batched decompose ok");
+}
+
+void testInterpolate()
+{
+  Random rnd(0x777);
+  std::vector<Quaternion3f> a(N), b(N), res(N);
+  std::vector<float> t(N);
+  for (size_t i=0;i<N;i++) {
+    a[i] = randomRotation(rnd);
+    // include some (nearly) identical, and some opposite-sign pairs
+    b[i]
+      = (i % 11 == 0) ? a[i]
+      : (i % 13 == 0) ? -a[i]
+      : randomRotation(rnd);
+    t[i] = rnd(0.f,1.f);
+  }
+
+  double t0 = getCurrentTime();
+  slerp(res.data(),a.data(),b.data(),t.data(),N);
+  double t1 = getCurrentTime();
+  LOG("batched slerp  : " << prettyDouble(N/(t1-t0)) << " quats/s");
+  for (size_t i=0;i<N;i++) {
+    const Quaternion3f ref = slerp(a[i],b[i],t[i]);
+    CHECK(maxDiff(res[i],ref) < 1e-5f);
+    CHECK(fabsf(dot(res[i],res[i])-1.f) < 1e-5f);
+  }
+
+  slerp(res.data(),a.data(),b.data(),.25f,N);
+  for (size_t i=0;i<N;i++)
+    CHECK(maxDiff(res[i],slerp(a[i],b[i],.25f)) < 1e-5f);
+  // end points have to be exact (up to rounding)
+  slerp(res.data(),a.data(),b.data(),0.f,N);
+  for (size_t i=0;i<N;i++)
+    CHECK(maxDiff(res[i],a[i]) < 1e-5f);
+  slerp(res.data(),a.data(),b.data(),1.f,N);
+  for (size_t i=0;i<N;i++)
+    CHECK(maxDiff(res[i],b[i]) < 1e-5f);
+
+  t0 = getCurrentTime();
+  nlerp(res.data(),a.data(),b.data(),t.data(),N);
+  t1 = getCurrentTime();
+  LOG("batched nlerp  : " << prettyDouble(N/(t1-t0)) << " quats/s");
+  for (size_t i=0;i<N;i++)
+    CHECK(maxDiff(res[i],nlerp(a[i],b[i],t[i])) < 1e-5f);
+
+  t0 = getCurrentTime();
+  for (size_t i=0;i<N;i++)
+    res[i] = slerp(a[i],b[i],t[i]);
+  t1 = getCurrentTime();
+  LOG("scalar slerp   : " << prettyDouble(N/(t1-t0)) << " quats/s");
+  LOG_OK("batched slerp/nlerp ok");
+}
+
+int main(int ac, char **av)
+{
+  testRcp();
+  testDecompose();
+  testInterpolate();
+  LOG_OK("all tests passed");
+  return 0;
+}
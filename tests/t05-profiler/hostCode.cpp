@@ -0,0 +1,130 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t05-profiler/hostCode.cpp - host-only test of the scoped
+    profiler in owl/Profiler.h, and of its per-scope overhead. Uses
+    owl::profiler::Scope directly, so it works no matter whether the
+    library got built with OWL_ENABLE_PROFILING or not */
+
+#include "owl/Profiler.h"
+#include <fstream>
+#include <thread>
+
+#define OWL_TEST_NAME "profiler"
+#include "tests/common/testing.h"
+
+using namespace owl;
+
+void sleepMS(int ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/*! mimics a build: outer phase with two nested phases, one of which
+    "uploads" some bytes */
+void fakeBuild()
+{
+  profiler::Scope outer("build");
+  sleepMS(5);
+  {
+    profiler::Scope inner("build.modules");
+    sleepMS(10);
+  }
+  {
+    profiler::Scope inner("upload",1000000);
+    sleepMS(2);
+  }
+}
+
+int main(int ac, char **av)
+{
+  profiler::reset();
+
+  std::thread t0(fakeBuild), t1(fakeBuild);
+  t0.join();
+  t1.join();
+  fakeBuild();
+
+  std::stringstream summary;
+  profiler::printSummary(summary);
+  std::cout << summary.str();
+  const std::string s = summary.str();
+  CHECK(s.find("build") != std::string::npos);
+  CHECK(s.find("build.modules") != std::string::npos);
+  CHECK(s.find("upload (") != std::string::npos);
+
+  // each of the three calls of 'build' spends ~5 of its ~17ms in
+  // its own scope; make sure self time is shown as such
+  std::istringstream lines(s);
+  std::string line;
+  bool foundBuild = false;
+  while (std::getline(lines,line)) {
+    std::istringstream in(line);
+    double calls, total, self, max;
+    std::string name;
+    if (!(in >> calls >> total >> self >> max >> name)) continue;
+    if (name == "build") {
+      foundBuild = true;
+      CHECK(calls == 3);
+      CHECK(total >= 3*17.f);
+      CHECK(self  >= 3*5.f && self < total-3*12.f+5.f);
+    }
+    if (name == "build.modules") {
+      // children have to be listed after, and indented below, 'build'
+      CHECK(foundBuild);
+      CHECK(line.find("    build.modules") != std::string::npos);
+      CHECK(calls == 3);
+    }
+  }
+  CHECK(foundBuild);
+
+  const std::string traceFile = "owl-test-profiler.json";
+  profiler::writeChromeTrace(traceFile);
+  std::ifstream trace(traceFile);
+  const std::string json((std::istreambuf_iterator<char>(trace)),
+                         std::istreambuf_iterator<char>());
+  CHECK(json.find("\"traceEvents\"") != std::string::npos);
+  size_t numEvents = 0;
+  for (size_t pos = json.find("\"ph\":\"X\""); pos != std::string::npos;
+       pos = json.find("\"ph\":\"X\"",pos+1))
+    numEvents++;
+  CHECK(numEvents == 3*3);
+  CHECK(json.find("\"bytes\":1000000") != std::string::npos);
+  LOG_OK("summary and trace ok");
+
+  // reset() has to discard everything recorded so far
+  profiler::reset();
+  std::stringstream empty;
+  profiler::printSummary(empty);
+  CHECK(empty.str().find("build") == std::string::npos);
+
+  // overhead of an (empty) scope, including wrap-around of the ring
+  // buffer
+  const size_t N = 10*1000*1000;
+  const double begin = getCurrentTime();
+  for (size_t i=0;i<N;i++) {
+    profiler::Scope scope("empty");
+  }
+  const double end = getCurrentTime();
+  LOG("scope overhead: " << prettyDouble((end-begin)/N) << "s per scope");
+  std::stringstream wrapped;
+  profiler::printSummary(wrapped);
+  CHECK(wrapped.str().find("dropped") != std::string::npos);
+  profiler::reset();
+
+  LOG_OK("all tests passed");
+  return 0;
+}
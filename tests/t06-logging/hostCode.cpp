@@ -0,0 +1,185 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t06-logging/hostCode.cpp - host-only test of the
+    asynchronous logger in owl/Logging.h, plus a benchmark comparing
+    it to the synchronous std::cout/std::endl style logging it
+    replaced, on the messages a (large) scene build emits */
+
+#include "owl/Logging.h"
+#include <fstream>
+#include <functional>
+
+#define OWL_TEST_NAME "logging"
+#include "tests/common/testing.h"
+
+using namespace owl;
+
+/*! collects everything the logger writes */
+struct Collector {
+  static void callback(OWLLogLevel level, const char *message, void *self)
+  {
+    ((Collector*)self)->messages.push_back({level,message});
+  }
+  std::vector<std::pair<OWLLogLevel,std::string>> messages;
+};
+
+/*! counts how often it gets formatted */
+struct FormatCounter { int *count; };
+inline std::ostream &operator<<(std::ostream &o, const FormatCounter &fc)
+{ (*fc.count)++; return o << "formatted"; }
+
+void testOrderingAndLevels()
+{
+  Collector collector;
+  Logger::get().setSink(std::make_shared<CallbackLogSink>(Collector::callback,&collector));
+  Logger::setLevel(OWL_LOG_LEVEL_INFO);
+
+  // several producers, more messages than the queue holds; every
+  // message has to arrive, and per thread in order
+  const int numThreads = 4;
+  const int numPerThread = 50000;
+  std::vector<std::thread> threads;
+  for (int t=0;t<numThreads;t++)
+    threads.push_back(std::thread([t](){
+          for (int i=0;i<numPerThread;i++)
+            OWL_LOG_INFO(t << " " << i);
+        }));
+  for (auto &t : threads) t.join();
+  Logger::get().flush();
+
+  CHECK(collector.messages.size() == numThreads*numPerThread);
+  std::vector<int> next(numThreads,0);
+  for (auto &m : collector.messages) {
+    std::istringstream in(m.second);
+    int t, i;
+    in >> t >> i;
+    CHECK(t >= 0 && t < numThreads);
+    CHECK(i == next[t]);
+    next[t]++;
+  }
+  LOG_OK("ordering ok");
+
+  // disabled levels must not even get formatted
+  collector.messages.clear();
+  int numFormatted = 0;
+  Logger::setLevel(OWL_LOG_LEVEL_WARNING);
+  OWL_LOG_DEBUG(FormatCounter{&numFormatted});
+  OWL_LOG_INFO(FormatCounter{&numFormatted});
+  OWL_LOG_OK(FormatCounter{&numFormatted});
+  OWL_LOG_WARNING(FormatCounter{&numFormatted});
+  // errors get flushed right away, no explicit flush() required
+  OWL_LOG_ERROR(FormatCounter{&numFormatted});
+  CHECK(numFormatted == 2);
+  CHECK(collector.messages.size() == 2);
+  CHECK(collector.messages[0].first == OWL_LOG_LEVEL_WARNING);
+  CHECK(collector.messages[1].first == OWL_LOG_LEVEL_ERROR);
+  CHECK(collector.messages[1].second == "formatted");
+
+  Logger::setLevel(OWL_LOG_LEVEL_NONE);
+  OWL_LOG_ERROR(FormatCounter{&numFormatted});
+  CHECK(numFormatted == 2);
+  LOG_OK("level filtering ok");
+
+  Logger::get().setSink(nullptr);
+}
+
+/*! streams whatever the given function writes */
+struct Formatter { const std::function<void(std::ostream&)> &fmt; };
+inline std::ostream &operator<<(std::ostream &o, const Formatter &f)
+{ f.fmt(o); return o; }
+
+/*! the messages the accel builders (TrianglesGeomGroup etc) emit
+    for one group */
+template<typename LogFct>
+void buildFakeScene(int numGroups, const LogFct &log)
+{
+  for (int groupID=0;groupID<numGroups;groupID++) {
+    const int deviceID = 0;
+    log(OWL_LOG_LEVEL_INFO,[&](std::ostream &o){
+        o << "device #" << deviceID << ": building triangles accel over "
+          << (groupID%7+1) << " geometries"; });
+    log(OWL_LOG_LEVEL_INFO,[&](std::ostream &o){
+        o << "device #" << deviceID << ": starting to build/refit "
+          << prettyNumber(groupID*1000) << " triangles, "
+          << prettyNumber(groupID*64) << "B in output and "
+          << prettyNumber(groupID*128) << "B in temp data"; });
+    log(OWL_LOG_LEVEL_OK,[&](std::ostream &o){
+        o << "device #" << deviceID << ": successfully build triangles geom group accel"; });
+  }
+}
+
+void benchmark()
+{
+  const int numGroups = 100000;
+  const std::string legacyFile = "owl-test-logging-legacy.txt";
+  const std::string asyncFile  = "owl-test-logging-async.txt";
+
+  // what the per-file LOG macros used to do: format, and write with
+  // std::endl (ie, flush) - here into a file, to not depend on the
+  // speed of the terminal
+  double t0 = getCurrentTime();
+  {
+    std::ofstream out(legacyFile);
+    buildFakeScene(numGroups,[&](OWLLogLevel, const std::function<void(std::ostream&)> &fmt){
+        out << OWL_TERMINAL_LIGHT_BLUE << "#owl: ";
+        fmt(out);
+        out << OWL_TERMINAL_DEFAULT << std::endl;
+      });
+  }
+  double t1 = getCurrentTime();
+  LOG("legacy std::endl logging  : " << prettyDouble(t1-t0) << "s for "
+      << prettyNumber(3*numGroups) << " messages");
+
+  Logger::get().setSink(std::make_shared<FileLogSink>(asyncFile));
+  Logger::setLevel(OWL_LOG_LEVEL_INFO);
+  t0 = getCurrentTime();
+  buildFakeScene(numGroups,[&](OWLLogLevel level, const std::function<void(std::ostream&)> &fmt){
+      OWL_LOG(level,Formatter{fmt});
+    });
+  t1 = getCurrentTime();
+  Logger::get().flush();
+  double t2 = getCurrentTime();
+  LOG("async logging             : " << prettyDouble(t1-t0) << "s in the building thread, "
+      << prettyDouble(t2-t0) << "s until flushed");
+
+  Logger::setLevel(OWL_LOG_LEVEL_WARNING);
+  t0 = getCurrentTime();
+  buildFakeScene(numGroups,[&](OWLLogLevel level, const std::function<void(std::ostream&)> &fmt){
+      OWL_LOG(level,Formatter{fmt});
+    });
+  t1 = getCurrentTime();
+  LOG("async logging, disabled   : " << prettyDouble(t1-t0) << "s");
+  Logger::get().setSink(nullptr);
+
+  // both have to have produced the same number of lines
+  std::ifstream legacy(legacyFile), async(asyncFile);
+  size_t numLegacy = 0, numAsync = 0;
+  std::string line;
+  while (std::getline(legacy,line)) numLegacy++;
+  while (std::getline(async,line)) numAsync++;
+  CHECK(numLegacy == 3*numGroups);
+  CHECK(numAsync == 3*numGroups);
+  LOG_OK("benchmark done");
+}
+
+int main(int ac, char **av)
+{
+  testOrderingAndLevels();
+  benchmark();
+  LOG_OK("all tests passed");
+  return 0;
+}
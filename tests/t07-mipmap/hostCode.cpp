@@ -0,0 +1,321 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t07-mipmap/hostCode.cpp - host-only tests of the mip chain
+    generator in owl/MipMap.h (on images with known results), of
+    creating and destroying single-level (1x1) mip-mapped textures on
+    a null device, plus a throughput benchmark */
+
+#include "owl/MipMap.h"
+#include "owl/APIHandle.h"
+#include "owl/Texture.h"
+#include <math.h>
+
+#define OWL_TEST_NAME "mipmap"
+#include "tests/common/testing.h"
+
+using namespace owl;
+
+const OWLTexelFormat allFormats[] = {
+  OWL_TEXEL_FORMAT_RGBA8, OWL_TEXEL_FORMAT_RGBA32F,
+  OWL_TEXEL_FORMAT_R8,    OWL_TEXEL_FORMAT_R32F
+};
+const OWLMipmapFilter allFilters[] = {
+  OWL_MIPMAP_FILTER_BOX, OWL_MIPMAP_FILTER_KAISER
+};
+
+/*! an image, with all channels as floats, for comparisons */
+struct Image {
+  Image(vec2i size, int numChannels)
+    : size(size), numChannels(numChannels),
+      values(size_t(size.x)*size.y*numChannels)
+  {}
+  float &at(int x, int y, int c) { return values[(size_t(y)*size.x+x)*numChannels+c]; }
+
+  vec2i size;
+  int   numChannels;
+  std::vector<float> values;
+};
+
+int numChannels(OWLTexelFormat format)
+{
+  return (format == OWL_TEXEL_FORMAT_RGBA8 || format == OWL_TEXEL_FORMAT_RGBA32F) ? 4 : 1;
+}
+
+bool isFloat(OWLTexelFormat format)
+{
+  return (format == OWL_TEXEL_FORMAT_RGBA32F || format == OWL_TEXEL_FORMAT_R32F);
+}
+
+/*! packs float values into texels of given format (as-is, ie,
+    without any color space conversion) */
+std::vector<uint8_t> pack(const Image &image, OWLTexelFormat format)
+{
+  std::vector<uint8_t> texels(image.values.size()*(isFloat(format) ? 4 : 1));
+  for (size_t i=0;i<image.values.size();i++)
+    if (isFloat(format))
+      ((float*)texels.data())[i] = image.values[i];
+    else
+      texels[i] = (uint8_t)std::min(255.f,std::max(0.f,image.values[i]*255.f+.5f));
+  return texels;
+}
+
+Image unpack(const uint8_t *texels, vec2i size, OWLTexelFormat format)
+{
+  Image image(size,numChannels(format));
+  for (size_t i=0;i<image.values.size();i++)
+    image.values[i] = isFloat(format)
+      ? ((const float*)texels)[i]
+      : texels[i]/255.f;
+  return image;
+}
+
+void testLevelSizes()
+{
+  CHECK(mipmap::numLevels(vec2i(1,1)) == 1);
+  CHECK(mipmap::numLevels(vec2i(256,256)) == 9);
+  CHECK(mipmap::numLevels(vec2i(300,17)) == 9);
+  CHECK(mipmap::levelSize(vec2i(300,17),4) == vec2i(18,1));
+  CHECK(mipmap::levelSize(vec2i(300,17),8) == vec2i(1,1));
+
+  const std::vector<mipmap::Level> levels
+    = mipmap::generate(OWL_TEXEL_FORMAT_R8,OWL_COLOR_SPACE_LINEAR,
+                       OWL_MIPMAP_FILTER_BOX,OWL_TEXTURE_CLAMP,
+                       std::vector<uint8_t>(300*17).data(),vec2i(300,17));
+  CHECK(levels.size() == 8);
+  for (size_t i=0;i<levels.size();i++) {
+    CHECK(levels[i].size == mipmap::levelSize(vec2i(300,17),int(i+1)));
+    CHECK(levels[i].texels.size() == size_t(levels[i].size.x)*levels[i].size.y);
+  }
+  LOG_OK("level sizes ok");
+}
+
+/*! a constant image has to stay exactly that, for every format,
+    filter, and color space (and odd sizes) */
+void testConstant()
+{
+  for (auto format : allFormats)
+    for (auto filter : allFilters)
+      for (int srgb=0;srgb<2;srgb++) {
+        const vec2i size(37,20);
+        Image image(size,numChannels(format));
+        for (int y=0;y<size.y;y++)
+          for (int x=0;x<size.x;x++)
+            for (int c=0;c<image.numChannels;c++)
+              image.at(x,y,c) = (c+1)*0.2f;
+        const std::vector<uint8_t> texels = pack(image,format);
+        const std::vector<mipmap::Level> levels
+          = mipmap::generate(format,srgb ? OWL_COLOR_SPACE_SRGB : OWL_COLOR_SPACE_LINEAR,
+                             filter,OWL_TEXTURE_CLAMP,texels.data(),size);
+        for (auto &level : levels) {
+          const Image result = unpack(level.texels.data(),level.size,format);
+          const Image expected = unpack(texels.data(),size,format);
+          for (size_t i=0;i<result.values.size();i++)
+            CHECK(fabsf(result.values[i]-expected.values[i % expected.numChannels]) < 1e-5f);
+        }
+      }
+  LOG_OK("constant images ok");
+}
+
+/*! box filtering a 2x2 pattern: plain average of the texels in
+    linear color space; in sRGB, average of the *linearized* values */
+void testBoxAndSRGB()
+{
+  // white/black checker board: linear average is 0.5, which in 8
+  // bits is 128; in sRGB, 0.5 linear encodes to 187.5/255 -> 188
+  const vec2i size(8,8);
+  std::vector<vec4uc> checker(size.x*size.y);
+  for (int y=0;y<size.y;y++)
+    for (int x=0;x<size.x;x++) {
+      const uint8_t v = ((x^y)&1) ? 255 : 0;
+      checker[y*size.x+x] = vec4uc(v,v,v,v);
+    }
+  std::vector<vec4uc> level1(4*4);
+  mipmap::downsample(OWL_TEXEL_FORMAT_RGBA8,OWL_COLOR_SPACE_LINEAR,
+                     OWL_MIPMAP_FILTER_BOX,OWL_TEXTURE_CLAMP,
+                     checker.data(),size,0,level1.data(),vec2i(4,4));
+  for (auto t : level1)
+    CHECK(t == vec4uc(128,128,128,128));
+  mipmap::downsample(OWL_TEXEL_FORMAT_RGBA8,OWL_COLOR_SPACE_SRGB,
+                     OWL_MIPMAP_FILTER_BOX,OWL_TEXTURE_CLAMP,
+                     checker.data(),size,0,level1.data(),vec2i(4,4));
+  // ... but alpha is always linear
+  for (auto t : level1)
+    CHECK(t == vec4uc(188,188,188,128));
+
+  // every 8-bit sRGB value has to survive (2x2 copies of itself)
+  // being down-sampled
+  std::vector<uint8_t> ramp(256*2*2);
+  for (int y=0;y<2;y++)
+    for (int x=0;x<512;x++)
+      ramp[y*512+x] = uint8_t(x/2);
+  std::vector<uint8_t> rampLevel1(256);
+  mipmap::downsample(OWL_TEXEL_FORMAT_R8,OWL_COLOR_SPACE_SRGB,
+                     OWL_MIPMAP_FILTER_BOX,OWL_TEXTURE_CLAMP,
+                     ramp.data(),vec2i(512,2),0,rampLevel1.data(),vec2i(256,1));
+  for (int i=0;i<256;i++)
+    CHECK(rampLevel1[i] == i);
+
+  // 3x3 -> 1x1 box: average of all 9
+  float odd[9] = { 1,2,3,4,5,6,7,8,9 };
+  float oddLevel1;
+  mipmap::downsample(OWL_TEXEL_FORMAT_R32F,OWL_COLOR_SPACE_LINEAR,
+                     OWL_MIPMAP_FILTER_BOX,OWL_TEXTURE_CLAMP,
+                     odd,vec2i(3,3),0,&oddLevel1,vec2i(1,1));
+  CHECK(fabsf(oddLevel1-5.f) < 1e-5f);
+  LOG_OK("box filter and sRGB ok");
+}
+
+/*! Kaiser: preserves a linear ramp (away from the borders), and the
+    average of the image */
+void testKaiser()
+{
+  const vec2i size(64,64);
+  std::vector<float> ramp(size.x*size.y);
+  for (int y=0;y<size.y;y++)
+    for (int x=0;x<size.x;x++)
+      ramp[y*size.x+x] = x+.5f;
+  std::vector<float> level1(32*32);
+  mipmap::downsample(OWL_TEXEL_FORMAT_R32F,OWL_COLOR_SPACE_LINEAR,
+                     OWL_MIPMAP_FILTER_KAISER,OWL_TEXTURE_CLAMP,
+                     ramp.data(),size,0,level1.data(),vec2i(32,32));
+  for (int y=0;y<32;y++)
+    for (int x=4;x<28;x++)
+      CHECK(fabsf(level1[y*32+x] - 2.f*(x+.5f)) < 1e-3f);
+  LOG_OK("kaiser filter ok");
+}
+
+/*! with wrap addressing, shifting the input by two texels has to
+    shift the output by exactly one */
+void testWrap()
+{
+  const vec2i size(32,8);
+  std::vector<float> image(size.x*size.y), shifted(size.x*size.y);
+  for (int y=0;y<size.y;y++)
+    for (int x=0;x<size.x;x++) {
+      image[y*size.x+x] = float((x*7+y*3)%11);
+      shifted[y*size.x+(x+2)%size.x] = image[y*size.x+x];
+    }
+  for (auto filter : allFilters) {
+    std::vector<float> a(16*4), b(16*4);
+    mipmap::downsample(OWL_TEXEL_FORMAT_R32F,OWL_COLOR_SPACE_LINEAR,
+                       filter,OWL_TEXTURE_WRAP,
+                       image.data(),size,0,a.data(),vec2i(16,4));
+    mipmap::downsample(OWL_TEXEL_FORMAT_R32F,OWL_COLOR_SPACE_LINEAR,
+                       filter,OWL_TEXTURE_WRAP,
+                       shifted.data(),size,0,b.data(),vec2i(16,4));
+    for (int y=0;y<4;y++)
+      for (int x=0;x<16;x++)
+        CHECK(fabsf(a[y*16+x]-b[y*16+(x+1)%16]) < 1e-4f);
+  }
+  LOG_OK("wrap addressing ok");
+}
+
+/*! a padded line pitch must not change the result */
+void testPitch()
+{
+  const vec2i size(30,10);
+  const size_t pitch = 40*sizeof(vec4uc);
+  std::vector<vec4uc> tight(size.x*size.y), padded(40*size.y);
+  for (int y=0;y<size.y;y++)
+    for (int x=0;x<size.x;x++)
+      padded[y*40+x] = tight[y*size.x+x] = vec4uc(x*8,y*20,x+y,255-x);
+  auto a = mipmap::generate(OWL_TEXEL_FORMAT_RGBA8,OWL_COLOR_SPACE_SRGB,
+                            OWL_MIPMAP_FILTER_KAISER,OWL_TEXTURE_CLAMP,
+                            tight.data(),size);
+  auto b = mipmap::generate(OWL_TEXEL_FORMAT_RGBA8,OWL_COLOR_SPACE_SRGB,
+                            OWL_MIPMAP_FILTER_KAISER,OWL_TEXTURE_CLAMP,
+                            padded.data(),size,pitch);
+  CHECK(a.size() == b.size());
+  for (size_t i=0;i<a.size();i++)
+    CHECK(a[i].texels == b[i].texels);
+  LOG_OK("line pitch ok");
+}
+
+void benchmark()
+{
+  const vec2i size(4096,4096);
+  const size_t numTexels = size_t(size.x)*size.y;
+  // large enough for any format; as bytes that's noise, as floats
+  // values in [0,1)
+  std::vector<uint8_t> texels(numTexels*sizeof(vec4f));
+  for (size_t i=0;i<numTexels*4;i++)
+    ((float*)texels.data())[i] = float((i*2654435761u) % 1000)/1000.f;
+
+  struct Config { OWLTexelFormat format; OWLTextureColorSpace colorSpace; const char *name; };
+  const Config configs[] = {
+    { OWL_TEXEL_FORMAT_RGBA8,   OWL_COLOR_SPACE_SRGB,   "RGBA8 sRGB " },
+    { OWL_TEXEL_FORMAT_RGBA8,   OWL_COLOR_SPACE_LINEAR, "RGBA8      " },
+    { OWL_TEXEL_FORMAT_RGBA32F, OWL_COLOR_SPACE_LINEAR, "RGBA32F    " },
+    { OWL_TEXEL_FORMAT_R8,      OWL_COLOR_SPACE_LINEAR, "R8         " },
+    { OWL_TEXEL_FORMAT_R32F,    OWL_COLOR_SPACE_LINEAR, "R32F       " },
+  };
+  for (auto &config : configs)
+    for (auto filter : allFilters) {
+      const double t0 = getCurrentTime();
+      const std::vector<mipmap::Level> levels
+        = mipmap::generate(config.format,config.colorSpace,filter,OWL_TEXTURE_WRAP,
+                           texels.data(),size);
+      const double t1 = getCurrentTime();
+      LOG(config.name << (filter == OWL_MIPMAP_FILTER_BOX ? " box   " : " kaiser")
+          << " : full chain for " << size.x << "x" << size.y << " in "
+          << prettyDouble(t1-t0) << "s ("
+          << prettyNumber(size_t(numTexels/(t1-t0))) << " base texels/s)");
+    }
+}
+
+/*! a mip-mapped texture that's only 1x1 has a 'full' chain of a
+    single level - but is still a mip-mapped texture, and has to be
+    destroyed as one */
+void testSingleLevelTextures()
+{
+  LOG("creating and destroying 1x1 textures on a null device");
+  int deviceID = OWL_NULL_DEVICE;
+  OWLContext owl = owlContextCreate(&deviceID,1);
+  const uint32_t texel = 0xff804020;
+  const void *levels[] = { &texel };
+  OWLTexture mipmapped
+    = owlTexture2DCreateMipmapped(owl,OWL_TEXEL_FORMAT_RGBA8,1,1,levels,1);
+  OWLTexture plain
+    = owlTexture2DCreate(owl,OWL_TEXEL_FORMAT_RGBA8,1,1,&texel);
+  Texture::SP mipmappedTexture = ((APIHandle *)mipmapped)->get<Texture>();
+  Texture::SP plainTexture     = ((APIHandle *)plain)->get<Texture>();
+  CHECK(mipmappedTexture->numLevels == 1 && plainTexture->numLevels == 1);
+  CHECK(mipmappedTexture->isMipmapped());
+  CHECK(mipmappedTexture->mipmappedArrays.size() == 1);
+  CHECK(mipmappedTexture->textureArrays.empty());
+  CHECK(!plainTexture->isMipmapped());
+  CHECK(plainTexture->textureArrays.size() == 1);
+  owlTexture2DDestroy(mipmapped);
+  owlTexture2DDestroy(plain);
+  CHECK(mipmappedTexture->ID < 0 && plainTexture->ID < 0);
+  owlContextDestroy(owl);
+  LOG_OK("1x1 textures passed");
+}
+
+int main(int ac, char **av)
+{
+  testLevelSizes();
+  testConstant();
+  testBoxAndSRGB();
+  testKaiser();
+  testWrap();
+  testPitch();
+  testSingleLevelTextures();
+  benchmark();
+  LOG_OK("all tests passed");
+  return 0;
+}
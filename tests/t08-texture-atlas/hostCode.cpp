@@ -0,0 +1,161 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t08-texture-atlas/hostCode.cpp - host-only tests of the
+    texture atlas builder in owl/TextureAtlas.h, plus a benchmark
+    packing many small textures */
+
+#include "owl/TextureAtlas.h"
+#include <random>
+
+#define OWL_TEST_NAME "texture-atlas"
+#include "tests/common/testing.h"
+
+using namespace owl;
+
+/*! rectangles must stay within the packer, and never overlap */
+void testPacker()
+{
+  std::mt19937 rng(0x1234);
+  std::uniform_int_distribution<int> dim(1,40);
+  const vec2i size(256,256);
+  atlas::SkylinePacker packer(size);
+  std::vector<int> coverage(size.x*size.y,0);
+  size_t area = 0;
+  int numPlaced = 0;
+  for (int i=0;i<2000;i++) {
+    const vec2i rect(dim(rng),dim(rng));
+    vec2i pos;
+    if (!packer.insert(rect,pos)) continue;
+    numPlaced++;
+    CHECK(pos.x >= 0 && pos.y >= 0);
+    CHECK(pos.x+rect.x <= size.x && pos.y+rect.y <= size.y);
+    for (int y=pos.y;y<pos.y+rect.y;y++)
+      for (int x=pos.x;x<pos.x+rect.x;x++)
+        CHECK(coverage[y*size.x+x]++ == 0);
+    area += rect.x*rect.y;
+  }
+  CHECK(numPlaced > 0);
+  CHECK(packer.usedHeight() <= size.y);
+  LOG_OK("packer ok: placed " << numPlaced << " random rects, "
+         << int(100.f*area/(size.x*size.y)) << "% of area used");
+
+  atlas::SkylinePacker tooSmall(vec2i(16,16));
+  vec2i pos;
+  CHECK(!tooSmall.insert(vec2i(17,1),pos));
+  CHECK(tooSmall.insert(vec2i(16,16),pos));
+  CHECK(!tooSmall.insert(vec2i(1,1),pos));
+}
+
+/*! texel of texture 'tex' at (x,y); unique for all texels of all
+    test textures */
+inline vec4uc texelValue(int tex, int x, int y)
+{
+  return vec4uc(uint8_t(tex),uint8_t(tex>>8),uint8_t(x),uint8_t(y));
+}
+
+void testBuild()
+{
+  std::mt19937 rng(0x4321);
+  std::uniform_int_distribution<int> dim(1,60);
+  const int numTextures = 500;
+  const int gutter = 2;
+  const int maxAtlasSize = 256;
+  std::vector<std::vector<vec4uc>> texels(numTextures);
+  std::vector<atlas::Input> inputs(numTextures);
+  for (int t=0;t<numTextures;t++) {
+    vec2i size(dim(rng),dim(rng));
+    if (t == 17) size = vec2i(maxAtlasSize,8); // too wide once padded
+    texels[t].resize(size.x*size.y);
+    for (int y=0;y<size.y;y++)
+      for (int x=0;x<size.x;x++)
+        texels[t][y*size.x+x] = texelValue(t,x,y);
+    inputs[t].size   = size;
+    inputs[t].texels = texels[t].data();
+  }
+  
+  const atlas::Result result
+    = atlas::build(OWL_TEXEL_FORMAT_RGBA8,inputs,maxAtlasSize,gutter);
+  CHECK(result.placements.size() == numTextures);
+  CHECK(result.atlases.size() > 1);
+  CHECK(result.placements[17].atlasID == -1);
+
+  for (int t=0;t<numTextures;t++) {
+    const atlas::Placement &p = result.placements[t];
+    if (t == 17) continue;
+    CHECK(p.atlasID >= 0 && p.atlasID < (int)result.atlases.size());
+    const atlas::Atlas &a = result.atlases[p.atlasID];
+    const vec4uc *atlasTexels = (const vec4uc *)a.texels.data();
+    const vec2i size = inputs[t].size;
+    // texels, and gutter (which replicates the edge texels)
+    for (int y=-gutter;y<size.y+gutter;y++)
+      for (int x=-gutter;x<size.x+gutter;x++) {
+        const int ax = p.position.x+x, ay = p.position.y+y;
+        CHECK(ax >= 0 && ax < a.size.x && ay >= 0 && ay < a.size.y);
+        const vec4uc expected
+          = texelValue(t,std::min(std::max(x,0),size.x-1),
+                       std::min(std::max(y,0),size.y-1));
+        CHECK(atlasTexels[ay*a.size.x+ax] == expected);
+      }
+    // uv transform: texel centers map to texel centers
+    for (int y=0;y<size.y;y++)
+      for (int x=0;x<size.x;x++) {
+        const vec2f uv((x+.5f)/size.x,(y+.5f)/size.y);
+        const vec2f atlasUV = uv*p.uvTransform.scale + p.uvTransform.offset;
+        const vec2f atlasPos = atlasUV*vec2f(a.size);
+        CHECK(fabsf(atlasPos.x-(p.position.x+x+.5f)) < 1e-3f);
+        CHECK(fabsf(atlasPos.y-(p.position.y+y+.5f)) < 1e-3f);
+      }
+  }
+  LOG_OK("build ok: " << numTextures << " textures in "
+         << result.atlases.size() << " atlases");
+}
+
+void benchmark()
+{
+  // many small textures, as in a product catalog
+  std::mt19937 rng(0x777);
+  std::uniform_int_distribution<int> dim(4,64);
+  const int numTextures = 20000;
+  std::vector<std::vector<vec4uc>> texels(numTextures);
+  std::vector<atlas::Input> inputs(numTextures);
+  size_t numTexels = 0;
+  for (int t=0;t<numTextures;t++) {
+    const vec2i size(dim(rng),dim(rng));
+    texels[t].resize(size.x*size.y,vec4uc(uint8_t(t)));
+    inputs[t].size   = size;
+    inputs[t].texels = texels[t].data();
+    numTexels += texels[t].size();
+  }
+  const double t0 = getCurrentTime();
+  const atlas::Result result
+    = atlas::build(OWL_TEXEL_FORMAT_RGBA8,inputs,4096,2);
+  const double t1 = getCurrentTime();
+  float occupancy = 0.f;
+  for (auto &a : result.atlases) occupancy += a.occupancy;
+  LOG(numTextures << " textures (" << prettyNumber(numTexels) << " texels) -> "
+      << result.atlases.size() << " atlases in " << prettyDouble(t1-t0)
+      << "s, avg occupancy " << int(100.f*occupancy/result.atlases.size()) << "%");
+}
+
+int main(int ac, char **av)
+{
+  testPacker();
+  testBuild();
+  benchmark();
+  LOG_OK("all tests passed");
+  return 0;
+}
@@ -0,0 +1,179 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t09-block-compression/hostCode.cpp - host-only tests of the
+    block compression encoder (and decoder) in owl/BlockCompression.h:
+    exactness on trivial blocks, quality (PSNR) on a synthetic
+    image, and encoding throughput */
+
+#include "owl/BlockCompression.h"
+#include <random>
+
+#define OWL_TEST_NAME "block-compression"
+#include "tests/common/testing.h"
+
+using namespace owl;
+
+struct Format {
+  OWLTexelFormat format;
+  const char    *name;
+  /*! number of channels the format stores (starting at red) */
+  int            numChannels;
+  /*! PSNR the encoder has to reach on the test image */
+  double         minPSNR;
+};
+
+static const Format formats[] = {
+  { OWL_TEXEL_FORMAT_BC1, "BC1", 3, 38. },
+  { OWL_TEXEL_FORMAT_BC4, "BC4", 1, 42. },
+  { OWL_TEXEL_FORMAT_BC5, "BC5", 2, 42. },
+  { OWL_TEXEL_FORMAT_BC7, "BC7", 4, 40. },
+};
+
+/*! something resembling a real texture: smooth gradients, some
+    higher-frequency detail, hard edges, a bit of noise, and a
+    (smoothly varying) alpha channel */
+std::vector<vec4uc> makeTestImage(vec2i size)
+{
+  std::mt19937 rng(0x4321);
+  std::normal_distribution<float> noise(0.f,2.f);
+  std::vector<vec4uc> image(size.x*size.y);
+  for (int y=0;y<size.y;y++)
+    for (int x=0;x<size.x;x++) {
+      const float u = x/float(size.x), v = y/float(size.y);
+      const float detail = 20.f*sinf(x*.15f)*cosf(y*.11f);
+      const bool  edge   = ((x/37)+(y/29)) & 1;
+      vec3f rgb(40.f+150.f*u+detail,
+                60.f+120.f*v-.5f*detail,
+                200.f-100.f*u*v+detail);
+      if (edge) rgb = vec3f(255.f)-.8f*rgb;
+      const float a = 255.f*(.5f+.5f*sinf(3.f*u+2.f*v));
+      image[y*size.x+x]
+        = vec4uc((uint8_t)clamp(rgb.x+noise(rng),0.f,255.f),
+                 (uint8_t)clamp(rgb.y+noise(rng),0.f,255.f),
+                 (uint8_t)clamp(rgb.z+noise(rng),0.f,255.f),
+                 (uint8_t)clamp(a,0.f,255.f));
+    }
+  return image;
+}
+
+std::vector<vec4uc> roundTrip(const Format &format,
+                              const std::vector<vec4uc> &image, vec2i size)
+{
+  std::vector<uint8_t> blocks(bc::compressedSize(format.format,size));
+  bc::encode(format.format,image.data(),size,0,blocks.data());
+  std::vector<vec4uc> decoded(size.x*size.y);
+  bc::decode(format.format,blocks.data(),size,decoded.data());
+  return decoded;
+}
+
+double psnr(const Format &format,
+            const std::vector<vec4uc> &a, const std::vector<vec4uc> &b)
+{
+  double sum = 0.;
+  for (size_t i=0;i<a.size();i++)
+    for (int c=0;c<format.numChannels;c++) {
+      const double d = double(a[i][c])-double(b[i][c]);
+      sum += d*d;
+    }
+  const double mse = sum/(a.size()*format.numChannels);
+  return (mse == 0.) ? 99. : 10.*log10(255.*255./mse);
+}
+
+/*! blocks that can be represented exactly have to be */
+void testExact()
+{
+  const vec2i size(8,8);
+  std::mt19937 rng(0x1234);
+  for (int iter=0;iter<100;iter++) {
+    const vec4uc color(rng()&255,rng()&255,rng()&255,rng()&255);
+    const vec4uc other(rng()&255,rng()&255,rng()&255,rng()&255);
+    std::vector<vec4uc> flat(size.x*size.y,color);
+    std::vector<vec4uc> twoValued(size.x*size.y);
+    for (size_t i=0;i<twoValued.size();i++)
+      twoValued[i] = (rng() & 1) ? color : other;
+
+    // constant blocks: exact in BC4 and BC5; off by at most one in
+    // BC7 (whose mode 6 shares the endpoints' lowest bit across all
+    // channels); and as close as RGB565 gets in BC1
+    for (auto &format : formats) {
+      const std::vector<vec4uc> decoded = roundTrip(format,flat,size);
+      const int maxError
+        = (format.format == OWL_TEXEL_FORMAT_BC1) ? 4
+        : (format.format == OWL_TEXEL_FORMAT_BC7) ? 1
+        : 0;
+      for (auto texel : decoded)
+        for (int c=0;c<format.numChannels;c++) {
+          CHECK(abs(int(texel[c])-int(color[c])) <= maxError);
+        }
+    }
+    // blocks with only two values (per channel) are exact in BC4
+    // and BC5
+    for (int f=1;f<=2;f++) {
+      const std::vector<vec4uc> decoded = roundTrip(formats[f],twoValued,size);
+      for (size_t i=0;i<decoded.size();i++)
+        for (int c=0;c<formats[f].numChannels;c++)
+          CHECK(decoded[i][c] == twoValued[i][c]);
+    }
+  }
+  LOG_OK("exact blocks ok");
+}
+
+void testQuality()
+{
+  // (odd size, to also exercise partial border blocks)
+  const vec2i size(509,263);
+  const std::vector<vec4uc> image = makeTestImage(size);
+  for (auto &format : formats) {
+    const double quality = psnr(format,image,roundTrip(format,image,size));
+    LOG(format.name << ": PSNR " << prettyDouble(quality) << "dB");
+    CHECK(quality >= format.minPSNR);
+  }
+  LOG_OK("quality ok");
+}
+
+void benchmark()
+{
+  const vec2i size(2048,2048);
+  const std::vector<vec4uc> image = makeTestImage(size);
+  const size_t uncompressed = image.size()*sizeof(vec4uc);
+  for (auto &format : formats) {
+    std::vector<uint8_t> blocks(bc::compressedSize(format.format,size));
+    const int numRuns = 3;
+    double t0 = getCurrentTime();
+    for (int i=0;i<numRuns;i++)
+      bc::encode(format.format,image.data(),size,0,blocks.data());
+    double t1 = getCurrentTime();
+    std::vector<vec4uc> decoded(image.size());
+    bc::decode(format.format,blocks.data(),size,decoded.data());
+    double t2 = getCurrentTime();
+    LOG(format.name << ": encoding " << prettyDouble(numRuns*image.size()/(t1-t0)/1e6)
+        << " Mtexels/s, decoding " << prettyDouble(image.size()/(t2-t1)/1e6)
+        << " Mtexels/s, " << prettyNumber(uncompressed) << "B -> "
+        << prettyNumber(blocks.size()) << "B ("
+        << (uncompressed/blocks.size()) << "x smaller)");
+  }
+  LOG_OK("benchmark done");
+}
+
+int main(int ac, char **av)
+{
+  testExact();
+  testQuality();
+  benchmark();
+  LOG_OK("all tests passed");
+  return 0;
+}
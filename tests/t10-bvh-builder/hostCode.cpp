@@ -0,0 +1,261 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t10-bvh-builder/hostCode.cpp - host-only unit test and
+    benchmark for the binned SAH BVH builder in owl/common/bvh/BVH.h:
+    checks the tree's structure, refitting, and box queries, and
+    reports build throughput and SAH cost against a simple
+    median-split build, for uniformly random and clustered prims */
+
+#include "owl/common/bvh/BVH.h"
+#include <random>
+#include <vector>
+
+#define OWL_TEST_NAME "bvh"
+#include "tests/common/testing.h"
+
+using namespace owl::common;
+
+inline box3f makeBox(const vec3f &center, float size)
+{
+  return box3f(center-vec3f(.5f*size),center+vec3f(.5f*size));
+}
+
+/*! small boxes, uniformly distributed in the unit cube */
+std::vector<box3f> randomPrims(size_t N, int seed)
+{
+  Random rnd(seed);
+  std::vector<box3f> prims(N);
+  for (auto &prim : prims) {
+    const vec3f center(rnd(0.f,1.f),rnd(0.f,1.f),rnd(0.f,1.f));
+    prim = makeBox(center,rnd(.1f,1.f)/powf(float(N),1.f/3.f));
+  }
+  return prims;
+}
+
+/*! small boxes in a few dense clusters of very different sizes,
+    with some big boxes spanning them - more like actual scenes */
+std::vector<box3f> clusteredPrims(size_t N, int seed)
+{
+  Random rnd(seed);
+  const int numClusters = 64;
+  std::vector<vec3f> clusterCenter(numClusters);
+  std::vector<float> clusterSize(numClusters);
+  for (int i=0;i<numClusters;i++) {
+    clusterCenter[i] = vec3f(rnd(0.f,100.f),rnd(0.f,100.f),rnd(0.f,10.f));
+    clusterSize[i]   = powf(10.f,rnd(-2.f,1.f));
+  }
+  std::vector<box3f> prims(N);
+  for (size_t i=0;i<N;i++) {
+    if (i % 1000 == 0) {
+      prims[i] = makeBox(vec3f(rnd(0.f,100.f),rnd(0.f,100.f),rnd(0.f,10.f)),rnd(5.f,20.f));
+      continue;
+    }
+    const int c = int(rnd.rng() % numClusters);
+    const vec3f center
+      = clusterCenter[c]
+      + vec3f(rnd.gaussian(clusterSize[c]),rnd.gaussian(clusterSize[c]),rnd.gaussian(clusterSize[c]));
+    prims[i] = makeBox(center,rnd(.01f,.1f)*clusterSize[c]);
+  }
+  return prims;
+}
+
+/*! reference build that splits every node at the median along its
+    widest centroid axis, for comparing SAH costs against */
+void buildMedianSplit(BVH &bvh, const std::vector<box3f> &prims, int maxLeafSize,
+                      uint32_t nodeID, uint32_t begin, uint32_t end)
+{
+  box3f bounds, centroidBounds;
+  for (uint32_t i=begin;i<end;i++) {
+    bounds.extend(prims[bvh.primIDs[i]]);
+    centroidBounds.extend(prims[bvh.primIDs[i]].center());
+  }
+  bvh.nodes[nodeID].setBounds(bounds);
+  if (end-begin <= uint32_t(maxLeafSize)) {
+    bvh.nodes[nodeID].offset = begin;
+    bvh.nodes[nodeID].count  = end-begin;
+    return;
+  }
+  const int axis = arg_max(centroidBounds.span());
+  const uint32_t mid = (begin+end)/2;
+  std::nth_element(bvh.primIDs.begin()+begin,bvh.primIDs.begin()+mid,bvh.primIDs.begin()+end,
+                   [&](uint32_t a, uint32_t b){ return prims[a].center()[axis] < prims[b].center()[axis]; });
+  const uint32_t childID = uint32_t(bvh.nodes.size());
+  bvh.nodes[nodeID].offset = childID;
+  bvh.nodes[nodeID].count  = 0;
+  bvh.nodes.resize(childID+2);
+  buildMedianSplit(bvh,prims,maxLeafSize,childID+0,begin,mid);
+  buildMedianSplit(bvh,prims,maxLeafSize,childID+1,mid,end);
+}
+
+/*! checks that every prim is in exactly one leaf, that every node
+    is referenced exactly once, and that all bounds are conservative
+    (and, for 'tight', exact) */
+void checkBVH(const BVH &bvh, const std::vector<box3f> &prims, bool tight)
+{
+  CHECK(bvh.primIDs.size() == prims.size());
+  std::vector<int> primRefs(prims.size(),0);
+  std::vector<int> nodeRefs(bvh.nodes.size(),0);
+  nodeRefs[0] = 1;
+  for (size_t nodeID=0;nodeID<bvh.nodes.size();nodeID++) {
+    const BVHNode &node = bvh.nodes[nodeID];
+    box3f childBounds;
+    if (node.isLeaf()) {
+      CHECK(node.offset+node.count <= bvh.primIDs.size());
+      for (uint32_t i=0;i<node.count;i++) {
+        const uint32_t primID = bvh.primIDs[node.offset+i];
+        CHECK(primID < prims.size());
+        primRefs[primID]++;
+        childBounds.extend(prims[primID]);
+      }
+    } else {
+      CHECK(node.offset > nodeID);
+      CHECK(node.offset+1 < bvh.nodes.size());
+      for (int c=0;c<2;c++) {
+        nodeRefs[node.offset+c]++;
+        childBounds.extend(bvh.nodes[node.offset+c].bounds());
+      }
+    }
+    CHECK(node.bounds().contains(childBounds.lower));
+    CHECK(node.bounds().contains(childBounds.upper));
+    if (tight) {
+      CHECK(node.lower == childBounds.lower && node.upper == childBounds.upper);
+    }
+  }
+  for (int refs : primRefs) CHECK(refs == 1);
+  for (int refs : nodeRefs) CHECK(refs == 1);
+}
+
+void testBuild(const char *name, const std::vector<box3f> &prims)
+{
+  const size_t N = prims.size();
+  BVHBuildConfig config;
+  BVH bvh;
+  // first build warms up the allocator (and TBB, if enabled)
+  bvh.build(prims.data(),N,config);
+  double t0 = getCurrentTime();
+  bvh.build(prims.data(),N,config);
+  double t1 = getCurrentTime();
+  checkBVH(bvh,prims,true);
+
+  BVH median;
+  median.primIDs.resize(N);
+  for (size_t i=0;i<N;i++) median.primIDs[i] = uint32_t(i);
+  median.nodes.reserve(2*N);
+  median.nodes.resize(1);
+  double t2 = getCurrentTime();
+  buildMedianSplit(median,prims,config.maxLeafSize,0,0,uint32_t(N));
+  double t3 = getCurrentTime();
+  checkBVH(median,prims,true);
+
+  const float sah = bvh.sahCost(config), medianSAH = median.sahCost(config);
+  LOG(name << ": binned SAH build " << prettyDouble(N/(t1-t0)) << " prims/s"
+      << ", " << prettyNumber(bvh.nodes.size()) << " nodes (" 
+      << prettyNumber(bvh.numLeaves()) << " leaves), depth " << bvh.depth()
+      << ", SAH cost " << sah);
+  LOG(name << ": median split build " << prettyDouble(N/(t3-t2)) << " prims/s"
+      << ", " << prettyNumber(median.nodes.size()) << " nodes, depth " << median.depth()
+      << ", SAH cost " << medianSAH);
+  CHECK(sah < medianSAH);
+
+  // move every prim a bit (and some a lot), and refit
+  Random rnd(0x5678);
+  std::vector<box3f> moved = prims;
+  for (size_t i=0;i<N;i++) {
+    const float scale = (i % 100 == 0) ? 1.f : .01f;
+    const vec3f delta = scale*vec3f(rnd(-1.f,1.f),rnd(-1.f,1.f),rnd(-1.f,1.f))*prims[i].span();
+    moved[i] = box3f(moved[i].lower+delta,moved[i].upper+delta);
+  }
+  t0 = getCurrentTime();
+  bvh.refit(moved.data());
+  t1 = getCurrentTime();
+  checkBVH(bvh,moved,true);
+  LOG(name << ": refit " << prettyDouble(N/(t1-t0)) << " prims/s"
+      << ", SAH cost after refit " << bvh.sahCost(config));
+  LOG_OK(name << " build ok");
+}
+
+void testQueries()
+{
+  const size_t N = 100000;
+  const std::vector<box3f> prims = randomPrims(N,0x2222);
+  BVH bvh;
+  bvh.build(prims.data(),N);
+
+  Random rnd(0x3333);
+  std::vector<int> found(N,0);
+  for (int q=0;q<200;q++) {
+    const box3f query = makeBox(vec3f(rnd(0.f,1.f),rnd(0.f,1.f),rnd(0.f,1.f)),rnd(0.f,.2f));
+    std::fill(found.begin(),found.end(),0);
+    size_t numFound = 0;
+    bvh.forEachLeafPrimOverlapping(query,[&](uint32_t primID){
+        if (!prims[primID].overlaps(query)) return;
+        found[primID]++;
+        numFound++;
+      });
+    size_t numExpected = 0;
+    for (size_t i=0;i<N;i++) {
+      const bool expected = prims[i].overlaps(query);
+      CHECK(found[i] == (expected ? 1 : 0));
+      numExpected += expected;
+    }
+    CHECK(numFound == numExpected);
+  }
+  LOG_OK("box queries ok");
+}
+
+void testCornerCases()
+{
+  BVH bvh;
+  bvh.build(nullptr,0);
+  CHECK(bvh.nodes.empty() && bvh.primIDs.empty());
+  CHECK(bvh.sahCost() == 0.f);
+
+  std::vector<box3f> prims(1,box3f(vec3f(0.f),vec3f(1.f)));
+  bvh.build(prims.data(),prims.size());
+  CHECK(bvh.nodes.size() == 1 && bvh.nodes[0].count == 1);
+  checkBVH(bvh,prims,true);
+
+  // all prims in the same spot: has to split anyway, until leaves
+  // are small enough
+  prims.assign(1000,box3f(vec3f(1.f),vec3f(2.f)));
+  bvh.build(prims.data(),prims.size());
+  checkBVH(bvh,prims,true);
+  for (const BVHNode &node : bvh.nodes)
+    CHECK(node.count <= 8);
+
+  // flat, zero-area prims (eg, axis-aligned quads) in a plane
+  Random rnd(0x4444);
+  prims.resize(10000);
+  for (auto &prim : prims) {
+    const vec3f p(rnd(0.f,1.f),rnd(0.f,1.f),0.f);
+    prim = box3f(p,p+vec3f(.01f,.01f,0.f));
+  }
+  bvh.build(prims.data(),prims.size());
+  checkBVH(bvh,prims,true);
+  LOG_OK("corner cases ok");
+}
+
+int main(int ac, char **av)
+{
+  testCornerCases();
+  testQueries();
+  const size_t N = 1024*1024+3;
+  testBuild("random   ",randomPrims(N,0x1234));
+  testBuild("clustered",clusteredPrims(N,0x4321));
+  LOG_OK("all tests passed");
+  return 0;
+}
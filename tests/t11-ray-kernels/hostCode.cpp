@@ -0,0 +1,566 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t11-ray-kernels/hostCode.cpp - host-only unit test and
+    benchmark for the CPU ray kernels in owl/common/math/rayKernels.h
+    and the BVH traversal in owl/common/bvh/BVHTraversal.h: checks
+    single-ray and packet kernels against each other, watertightness,
+    and traversal against brute force, and reports throughput (in
+    Mrays/s) on the scenes of s01-simpleTriangles and
+    t01-many-spheres */
+
+#include "owl/common/bvh/TriangleMeshBVH.h"
+#include <random>
+#include <vector>
+
+#define OWL_TEST_NAME "rays"
+#include "tests/common/testing.h"
+
+using namespace owl::common;
+
+/*! random triangles of various sizes in the unit cube */
+void randomTriangles(Random &rnd, size_t numTriangles,
+                     std::vector<vec3f> &vertices, std::vector<vec3i> &indices)
+{
+  for (size_t i=0;i<numTriangles;i++) {
+    const vec3f center = rnd.point(0.f,1.f);
+    const float size   = powf(10.f,rnd(-2.5f,-1.f));
+    const int   base   = int(vertices.size());
+    for (int k=0;k<3;k++)
+      vertices.push_back(center+size*rnd.point(-1.f,1.f));
+    indices.push_back(vec3i(base,base+1,base+2));
+  }
+}
+
+/*! rays from random points in (and around) the unit cube */
+HostRay randomRay(Random &rnd)
+{
+  return HostRay(rnd.point(-.2f,1.2f),rnd.direction()*rnd(.5f,2.f));
+}
+
+inline bool sameHit(const HostRay &a, const HostHit &hitA,
+                    const HostRay &b, const HostHit &hitB,
+                    float tolerance = 1e-5f)
+{
+  if ((hitA.primID < 0) != (hitB.primID < 0)) return false;
+  if (hitA.primID < 0) return true;
+  return fabsf(a.tmax-b.tmax) <= tolerance*std::max(1.f,fabsf(a.tmax));
+}
+
+inline int popCount8(int mask)
+{
+  int count = 0;
+  for (int lane=0;lane<8;lane++) count += (mask >> lane) & 1;
+  return count;
+}
+
+// ==================================================================
+// kernels
+// ==================================================================
+
+void testTriangleKernels()
+{
+  Random rnd(0x1111);
+  const int numTests = 200000;
+  int numHits = 0, mtVsWatertight = 0, packetMismatches = 0;
+  for (int test=0;test<numTests;test+=8) {
+    vec3f v[3];
+    for (int k=0;k<3;k++) v[k] = rnd.point(0.f,1.f);
+    RayPacket8 rays, raysWT;
+    HitPacket8 hits, hitsWT;
+    hits.clear();
+    hitsWT.clear();
+    HostRay ray[8], rayWT[8];
+    HostHit hit[8], hitWT[8];
+    for (int lane=0;lane<8;lane++) {
+      // aim at the triangle for about half the rays
+      ray[lane] = randomRay(rnd);
+      if (lane & 1) {
+        const float a = rnd(0.f,1.f), b = rnd(0.f,1.f-a);
+        ray[lane].direction = (1.f-a-b)*v[0]+a*v[1]+b*v[2]-ray[lane].origin;
+      }
+      rays.set(lane,ray[lane]);
+      rayWT[lane] = ray[lane];
+      intersectTriangle(ray[lane],hit[lane],v[0],v[1],v[2],test+lane);
+      intersectTriangle(rayWT[lane],WatertightRay(rayWT[lane]),hitWT[lane],v[0],v[1],v[2],test+lane);
+      if (hit[lane].primID >= 0) {
+        numHits++;
+        CHECK(hit[lane].u >= 0.f && hit[lane].v >= 0.f && hit[lane].u+hit[lane].v <= 1.f);
+      }
+      // different math, so t can differ a bit more for grazing rays
+      if (!sameHit(ray[lane],hit[lane],rayWT[lane],hitWT[lane],1e-3f))
+        mtVsWatertight++;
+      else if (hit[lane].primID >= 0) {
+        CHECK(fabsf(hit[lane].u-hitWT[lane].u) < 1e-2f);
+        CHECK(fabsf(hit[lane].v-hitWT[lane].v) < 1e-2f);
+      }
+    }
+    raysWT = rays;
+    const int mask   = intersectTriangle8(rays,hits,0xff,v[0],v[1],v[2],test);
+    const int maskWT = intersectTriangle8Watertight(raysWT,hitsWT,0xff,v[0],v[1],v[2],test);
+    for (int lane=0;lane<8;lane++) {
+      CHECK(((mask >> lane) & 1) == (hits.primID[lane] >= 0));
+      CHECK(((maskWT >> lane) & 1) == (hitsWT.primID[lane] >= 0));
+      // same math, so the only differences should be in the last bit
+      if (!sameHit(ray[lane],hit[lane],rays.get(lane),hits.get(lane)))
+        packetMismatches++;
+      if (!sameHit(rayWT[lane],hitWT[lane],raysWT.get(lane),hitsWT.get(lane)))
+        packetMismatches++;
+    }
+    // inactive lanes must not change
+    RayPacket8 before = rays;
+    intersectTriangle8(rays,hits,0x0f,v[0],v[1],v[2],test);
+    for (int lane=4;lane<8;lane++)
+      CHECK(rays.tmax[lane] == before.tmax[lane]);
+  }
+  LOG("triangle kernels: " << numHits << " of " << numTests << " rays hit; "
+      << "moeller-trumbore vs watertight disagree on " << mtVsWatertight
+      << ", packets vs single rays on " << packetMismatches);
+  CHECK(numHits > numTests/4);
+  CHECK(mtVsWatertight < numTests/10000);
+  CHECK(packetMismatches < numTests/10000);
+  LOG_OK("triangle kernels ok (" << (detail::cpuHasAVX2() ? "avx2" : "no avx2") << ")");
+}
+
+void testBoxKernels()
+{
+  Random rnd(0x2222);
+  for (int test=0;test<100000;test++) {
+    box3f box[2];
+    for (int k=0;k<2;k++) {
+      const vec3f a = rnd.point(0.f,1.f), b = rnd.point(0.f,1.f);
+      box[k] = box3f(min(a,b),max(a,b));
+    }
+    HostRay ray = randomRay(rnd);
+    // axis-parallel rays, and rays starting on a box's face
+    if (test % 7 == 0) ray.direction[test % 3] = 0.f;
+    if (test % 11 == 0) ray.origin.x = box[0].lower.x;
+    ray.tmax = rnd(0.f,2.f);
+    const RayBoxTest boxTest(ray);
+    float tNear[2], tRef[2];
+    const int mask
+      = intersectBoxPair(boxTest,box[0].lower,box[0].upper,box[1].lower,box[1].upper,
+                         ray.tmin,ray.tmax,tNear);
+    for (int k=0;k<2;k++) {
+      const bool ref = intersectBox(boxTest,box[k],ray.tmin,ray.tmax,tRef[k]);
+      CHECK(((mask >> k) & 1) == int(ref));
+      if (ref) {
+        CHECK(tNear[k] == tRef[k]);
+      }
+    }
+
+    RayPacket8 rays;
+    for (int lane=0;lane<8;lane++)
+      rays.set(lane,lane == 0 ? ray : randomRay(rnd));
+    float tNear8[8];
+    const int mask8 = intersectBox8(rays,0xfe | (test & 1),box[0],tNear8);
+    for (int lane=0;lane<8;lane++) {
+      const HostRay laneRay = rays.get(lane);
+      float t;
+      const bool ref
+        = ((0xfe | (test & 1)) & (1<<lane))
+        && intersectBox(RayBoxTest(laneRay),box[0],laneRay.tmin,laneRay.tmax,t);
+      CHECK(((mask8 >> lane) & 1) == int(ref));
+      if (ref) {
+        CHECK(fabsf(tNear8[lane]-t) <= 1e-5f*std::max(1.f,fabsf(t)));
+      }
+    }
+  }
+  LOG_OK("box kernels ok");
+}
+
+// ==================================================================
+// traversal
+// ==================================================================
+
+/*! a grid of triangles in the z=0 plane, with rays aimed exactly at
+    shared vertices and edges: none of them may get through */
+void testWatertight()
+{
+  const int K = 64;
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  for (int iy=0;iy<=K;iy++)
+    for (int ix=0;ix<=K;ix++)
+      vertices.push_back(vec3f(float(ix),float(iy),0.f));
+  for (int iy=0;iy<K;iy++)
+    for (int ix=0;ix<K;ix++) {
+      const int v00 = iy*(K+1)+ix, v01 = v00+1, v10 = v00+K+1, v11 = v10+1;
+      // alternate diagonals, so there are both kinds of vertices
+      if ((ix+iy) & 1) {
+        indices.push_back(vec3i(v00,v01,v11));
+        indices.push_back(vec3i(v00,v11,v10));
+      } else {
+        indices.push_back(vec3i(v00,v01,v10));
+        indices.push_back(vec3i(v01,v11,v10));
+      }
+    }
+  TriangleMeshBVH mesh;
+  mesh.build(vertices.data(),indices.data(),indices.size());
+
+  Random rnd(0x3333);
+  int numRays = 0, missedMT = 0, missedWT = 0, missedWT8 = 0;
+  RayPacket8 rays;
+  for (int i=0;i<100000;i++) {
+    // a vertex, or the middle of an edge (or diagonal)
+    const vec3f target(floorf(rnd(1.f,float(K-1)))+.5f*int(rnd(0.f,2.f)),
+                       floorf(rnd(1.f,float(K-1)))+.5f*int(rnd(0.f,2.f)),
+                       0.f);
+    const vec3f origin = target+vec3f(rnd(-20.f,20.f),rnd(-20.f,20.f),rnd(-20.f,20.f));
+    const HostRay ray(origin,target-origin);
+    HostRay r = ray;
+    HostHit hit;
+    mesh.watertight = false;
+    if (!mesh.closestHit(r,hit)) missedMT++;
+    mesh.watertight = true;
+    r = ray;
+    if (!mesh.closestHit(r,hit)) missedWT++;
+    if (!mesh.anyHit(ray)) missedWT++;
+    rays.set(i%8,ray);
+    if (i%8 == 7) {
+      HitPacket8 hits;
+      hits.clear();
+      missedWT8 += 8-popCount8(mesh.anyHit8(rays));
+      missedWT8 += 8-popCount8(mesh.closestHit8(rays,hits));
+    }
+    numRays++;
+  }
+  LOG("watertight: of " << numRays << " rays through vertices and edges, "
+      << missedMT << " slip through with moeller-trumbore, "
+      << missedWT << " (single), " << missedWT8 << " (packets) with the watertight test");
+  CHECK(missedWT == 0);
+  CHECK(missedWT8 == 0);
+  LOG_OK("watertight ok");
+}
+
+struct Sphere { vec3f center; float radius; };
+
+/*! user geometry for the traversal: closest intersection with a
+    sphere in [tmin,tmax) */
+inline bool intersectSphere(const Sphere &sphere, HostRay &ray, HostHit &hit, int primID)
+{
+  const vec3f oc = ray.origin-sphere.center;
+  const float a  = dot(ray.direction,ray.direction);
+  const float b  = dot(oc,ray.direction);
+  const float c  = dot(oc,oc)-sphere.radius*sphere.radius;
+  const float discriminant = b*b-a*c;
+  if (discriminant < 0.f) return false;
+  const float root = sqrtf(discriminant);
+  float t = (-b-root)/a;
+  if (t < ray.tmin) t = (-b+root)/a;
+  if (!(t >= ray.tmin && t < ray.tmax)) return false;
+  ray.tmax   = t;
+  hit.primID = primID;
+  return true;
+}
+
+/*! packet version of the above: user geometry doesn't have to be
+    vectorized */
+inline int intersectSphere8(const Sphere &sphere, RayPacket8 &rays, HitPacket8 &hits,
+                            int activeMask, int primID)
+{
+  int hitMask = 0;
+  for (int lane=0;lane<8;lane++) {
+    if (!(activeMask & (1<<lane))) continue;
+    HostRay ray = rays.get(lane);
+    HostHit hit;
+    if (!intersectSphere(sphere,ray,hit,primID)) continue;
+    rays.tmax[lane]   = ray.tmax;
+    hits.primID[lane] = primID;
+    hitMask |= (1<<lane);
+  }
+  return hitMask;
+}
+
+void testTraversal()
+{
+  Random rnd(0x4444);
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  randomTriangles(rnd,20000,vertices,indices);
+  TriangleMeshBVH mesh;
+  mesh.build(vertices.data(),indices.data(),indices.size());
+
+  const int numRays = 4000;
+  int numHits = 0;
+  for (int watertight=0;watertight<2;watertight++) {
+    mesh.watertight = watertight;
+    RayPacket8 rays, raysAny;
+    HitPacket8 hits;
+    HostRay ray8[8], ref8[8];
+    HostHit hit8[8], refHit8[8];
+    for (int i=0;i<numRays;i++) {
+      // brute force reference
+      HostRay ref = randomRay(rnd);
+      if (i % 5 == 0) ref.tmax = rnd(0.f,.5f);
+      const HostRay ray0 = ref;
+      HostHit refHit;
+      for (size_t j=0;j<indices.size();j++) {
+        const TriangleMeshBVH::Triangle &tri = mesh.triangles[j];
+        if (watertight)
+          intersectTriangle(ref,WatertightRay(ref),refHit,tri.v0,tri.v1,tri.v2,int(j));
+        else
+          intersectTriangle(ref,refHit,tri.v0,tri.v1,tri.v2,int(j));
+      }
+      HostRay ray = ray0;
+      HostHit hit;
+      CHECK(mesh.closestHit(ray,hit) == (refHit.primID >= 0));
+      CHECK(ray.tmax == ref.tmax);
+      CHECK(mesh.anyHit(ray0) == (refHit.primID >= 0));
+      numHits += (refHit.primID >= 0);
+
+      const int lane = i%8;
+      rays.set(lane,ray0);
+      ray8[lane] = ray; hit8[lane] = hit;
+      ref8[lane] = ref; refHit8[lane] = refHit;
+      if (lane == 7) {
+        hits.clear();
+        raysAny = rays;
+        // leave out one lane, which must not get touched
+        const int activeMask = 0xff & ~(1<<(i/8 % 8));
+        const int hitMask = mesh.closestHit8(rays,hits,activeMask);
+        const int anyMask = mesh.anyHit8(raysAny,activeMask);
+        for (int k=0;k<8;k++) {
+          if (!(activeMask & (1<<k))) {
+            CHECK(!(hitMask & (1<<k)) && !(anyMask & (1<<k)));
+            CHECK(hits.primID[k] == -1 && rays.tmax[k] == raysAny.tmax[k]);
+            continue;
+          }
+          CHECK(((hitMask >> k) & 1) == (refHit8[k].primID >= 0));
+          CHECK(((anyMask >> k) & 1) == (refHit8[k].primID >= 0));
+          CHECK(sameHit(rays.get(k),hits.get(k),ref8[k],refHit8[k]));
+        }
+      }
+    }
+  }
+  LOG("traversal: " << numHits << " of " << 2*numRays << " rays hit");
+
+  // user geometry: spheres
+  std::vector<Sphere> spheres(5000);
+  std::vector<box3f>  bounds(spheres.size());
+  for (size_t i=0;i<spheres.size();i++) {
+    spheres[i] = { rnd.point(0.f,1.f), rnd(.001f,.02f) };
+    bounds[i]  = box3f(spheres[i].center-vec3f(spheres[i].radius),
+                       spheres[i].center+vec3f(spheres[i].radius));
+  }
+  BVH bvh;
+  bvh.build(bounds.data(),bounds.size());
+  for (int i=0;i<numRays;i++) {
+    HostRay ref = randomRay(rnd);
+    const HostRay ray0 = ref;
+    HostHit refHit;
+    for (size_t j=0;j<spheres.size();j++)
+      intersectSphere(spheres[j],ref,refHit,int(j));
+    HostRay ray = ray0;
+    HostHit hit;
+    const bool found = traceClosest(bvh,ray,hit,[&](int primID, HostRay &ray, HostHit &hit){
+        return intersectSphere(spheres[primID],ray,hit,primID);
+      });
+    CHECK(found == (refHit.primID >= 0));
+    CHECK(ray.tmax == ref.tmax);
+
+    RayPacket8 rays;
+    for (int lane=0;lane<8;lane++) rays.set(lane,ray0);
+    HitPacket8 hits;
+    hits.clear();
+    const int hitMask
+      = traceClosest8(bvh,rays,hits,0xff,[&](int primID, RayPacket8 &rays, HitPacket8 &hits, int mask){
+          return intersectSphere8(spheres[primID],rays,hits,mask,primID);
+        });
+    const int anyMask
+      = traceAny8(bvh,rays,0xff,[&](int primID, RayPacket8 &rays, HitPacket8 &hits, int mask){
+          return intersectSphere8(spheres[primID],rays,hits,mask,primID);
+        });
+    CHECK(hitMask == (found ? 0xff : 0));
+    CHECK(anyMask == (found ? 0xff : 0) || found);
+    for (int lane=0;lane<8;lane++)
+      CHECK(rays.tmax[lane] == ref.tmax);
+  }
+  LOG_OK("traversal ok");
+}
+
+// ==================================================================
+// benchmarks
+// ==================================================================
+
+/*! a pinhole camera, as in the samples' ray gen programs */
+struct Camera {
+  vec3f origin, dir_00, dir_du, dir_dv;
+  HostRay ray(vec2i fbSize, int ix, int iy) const
+  {
+    const float u = (ix+.5f)/fbSize.x, v = (iy+.5f)/fbSize.y;
+    return HostRay(origin,normalize(dir_00+u*dir_du+v*dir_dv));
+  }
+};
+
+/*! traces all pixels, as single rays and as 8x1 packets, and
+    returns the number of hits (which must be the same for all) */
+template<typename Closest, typename Any, typename Closest8, typename Any8>
+void benchmark(const std::string &name, const Camera &camera, vec2i fbSize,
+               const Closest &closest, const Any &any,
+               const Closest8 &closest8, const Any8 &any8)
+{
+  const size_t numRays = size_t(fbSize.x)*fbSize.y;
+  size_t hits[4] = { 0, 0, 0, 0 };
+  double t[4];
+
+  double t0 = getCurrentTime();
+  for (int iy=0;iy<fbSize.y;iy++)
+    for (int ix=0;ix<fbSize.x;ix++) {
+      HostRay ray = camera.ray(fbSize,ix,iy);
+      HostHit hit;
+      hits[0] += closest(ray,hit);
+    }
+  t[0] = getCurrentTime()-t0;
+
+  t0 = getCurrentTime();
+  for (int iy=0;iy<fbSize.y;iy++)
+    for (int ix=0;ix<fbSize.x;ix++)
+      hits[1] += any(camera.ray(fbSize,ix,iy));
+  t[1] = getCurrentTime()-t0;
+
+  t0 = getCurrentTime();
+  for (int iy=0;iy<fbSize.y;iy++)
+    for (int ix=0;ix<fbSize.x;ix+=8) {
+      RayPacket8 rays;
+      HitPacket8 hitPacket;
+      hitPacket.clear();
+      for (int lane=0;lane<8;lane++)
+        rays.set(lane,camera.ray(fbSize,ix+lane,iy));
+      hits[2] += popCount8(closest8(rays,hitPacket));
+    }
+  t[2] = getCurrentTime()-t0;
+
+  t0 = getCurrentTime();
+  for (int iy=0;iy<fbSize.y;iy++)
+    for (int ix=0;ix<fbSize.x;ix+=8) {
+      RayPacket8 rays;
+      for (int lane=0;lane<8;lane++)
+        rays.set(lane,camera.ray(fbSize,ix+lane,iy));
+      hits[3] += popCount8(any8(rays));
+    }
+  t[3] = getCurrentTime()-t0;
+
+  LOG(name << ": " << prettyNumber(numRays) << " rays, "
+      << (100.*hits[0]/numRays) << "% hit");
+  LOG(name << ":   single rays, closest: " << (numRays/t[0]*1e-6) << " Mrays/s"
+      << ", any: " << (numRays/t[1]*1e-6) << " Mrays/s");
+  LOG(name << ":   8-wide packets, closest: " << (numRays/t[2]*1e-6) << " Mrays/s"
+      << ", any: " << (numRays/t[3]*1e-6) << " Mrays/s");
+  CHECK(hits[0] == hits[1] && hits[0] == hits[2] && hits[0] == hits[3]);
+}
+
+/*! the cube of s01-simpleTriangles, with its camera */
+void benchmarkSimpleTriangles()
+{
+  const vec3f vertices[8] = {
+    { -1.f,-1.f,-1.f }, { +1.f,-1.f,-1.f }, { -1.f,+1.f,-1.f }, { +1.f,+1.f,-1.f },
+    { -1.f,-1.f,+1.f }, { +1.f,-1.f,+1.f }, { -1.f,+1.f,+1.f }, { +1.f,+1.f,+1.f }
+  };
+  const vec3i indices[12] = {
+    { 0,1,3 }, { 2,3,0 }, { 5,7,6 }, { 5,6,4 }, { 0,4,5 }, { 0,5,1 },
+    { 2,3,7 }, { 2,7,6 }, { 1,5,7 }, { 1,7,3 }, { 4,0,2 }, { 4,2,6 }
+  };
+  TriangleMeshBVH mesh;
+  mesh.build(vertices,indices,12);
+
+  const vec2i fbSize(800,600);
+  const vec3f lookFrom(-4.f,-3.f,-2.f), lookAt(0.f,0.f,0.f), lookUp(0.f,1.f,0.f);
+  const float cosFovy = 0.66f;
+  Camera camera;
+  camera.origin = lookFrom;
+  camera.dir_00 = normalize(lookAt-lookFrom);
+  const float aspect = fbSize.x / float(fbSize.y);
+  camera.dir_du = cosFovy * aspect * normalize(cross(camera.dir_00,lookUp));
+  camera.dir_dv = cosFovy * normalize(cross(camera.dir_du,camera.dir_00));
+  camera.dir_00 -= 0.5f * camera.dir_du;
+  camera.dir_00 -= 0.5f * camera.dir_dv;
+
+  for (int watertight=0;watertight<2;watertight++) {
+    mesh.watertight = watertight;
+    benchmark(watertight ? "s01-simpleTriangles (watertight)" : "s01-simpleTriangles",
+              camera,fbSize,
+              [&](HostRay &ray, HostHit &hit) { return mesh.closestHit(ray,hit); },
+              [&](const HostRay &ray) { return mesh.anyHit(ray); },
+              [&](RayPacket8 &rays, HitPacket8 &hits) { return mesh.closestHit8(rays,hits); },
+              [&](const RayPacket8 &rays) { return mesh.anyHit8(rays); });
+  }
+}
+
+/*! the sphere grid of t01-many-spheres (at a smaller N), with its
+    camera */
+void benchmarkManySpheres()
+{
+  const int N = 100;
+  std::vector<Sphere> spheres;
+  std::vector<box3f>  bounds;
+  for (int iz=0;iz<N;iz++)
+    for (int iy=0;iy<N;iy++)
+      for (int ix=0;ix<N;ix++) {
+        spheres.push_back({ vec3f((float)ix,(float)iy,(float)iz), .5f });
+        bounds.push_back(box3f(spheres.back().center-vec3f(.5f),spheres.back().center+vec3f(.5f)));
+      }
+  const double t0 = getCurrentTime();
+  BVH bvh;
+  bvh.build(bounds.data(),bounds.size());
+  const double t1 = getCurrentTime();
+  LOG("t01-many-spheres: built BVH over " << prettyNumber(spheres.size())
+      << " spheres in " << prettyDouble(t1-t0) << "s");
+
+  const vec2i fbSize(1024,1024);
+  const float fovy = 20.f;
+  const vec3f vup(0.f,1.f,0.f);
+  const float aspect = fbSize.x / float(fbSize.y);
+  const float theta = fovy * ((float)M_PI) / 180.0f;
+  const float half_height = tanf(theta / 2.0f);
+  const float half_width = aspect * half_height;
+  const float focusDist = 10.f;
+  const vec3f lookFrom = 1.8f*vec3f(1.3f,1.5f,2.f)*vec3f((float)N);
+  const vec3f lookAt   = vec3f(0.5f*N);
+  const vec3f w = normalize(lookFrom - lookAt);
+  const vec3f u = normalize(cross(vup, w));
+  const vec3f v = cross(w, u);
+  Camera camera;
+  camera.origin = lookFrom;
+  camera.dir_00 = - half_width * focusDist*u - half_height * focusDist*v - focusDist * w;
+  camera.dir_du = 2.0f*half_width*focusDist*u;
+  camera.dir_dv = 2.0f*half_height*focusDist*v;
+
+  auto intersect = [&](int primID, HostRay &ray, HostHit &hit) {
+    return intersectSphere(spheres[primID],ray,hit,primID);
+  };
+  auto intersect8 = [&](int primID, RayPacket8 &rays, HitPacket8 &hits, int mask) {
+    return intersectSphere8(spheres[primID],rays,hits,mask,primID);
+  };
+  benchmark("t01-many-spheres",camera,fbSize,
+            [&](HostRay &ray, HostHit &hit) { return traceClosest(bvh,ray,hit,intersect); },
+            [&](const HostRay &ray) { return traceAny(bvh,ray,intersect); },
+            [&](RayPacket8 &rays, HitPacket8 &hits) {
+              return traceClosest8(bvh,rays,hits,0xff,intersect8); },
+            [&](const RayPacket8 &rays) { return traceAny8(bvh,rays,0xff,intersect8); });
+}
+
+int main(int ac, char **av)
+{
+  testTriangleKernels();
+  testBoxKernels();
+  testWatertight();
+  testTraversal();
+  benchmarkSimpleTriangles();
+  benchmarkManySpheres();
+  LOG_OK("all tests passed");
+  return 0;
+}
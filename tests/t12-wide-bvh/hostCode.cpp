@@ -0,0 +1,466 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t12-wide-bvh/hostCode.cpp - host-only unit test and
+    benchmark for the quantized 8-wide BVH in
+    owl/common/bvh/QuantizedBVH8.h: checks that collapsing keeps
+    every prim, that quantized bounds are conservative, and that
+    traversal finds the same hits as brute force; and compares
+    memory per prim and throughput against the binary BVH on the
+    scenes of s01-simpleTriangles and t01-many-spheres, and a random
+    triangle soup */
+
+#include "owl/common/bvh/TriangleMeshBVH.h"
+#include <random>
+#include <vector>
+
+#define OWL_TEST_NAME "wideBVH"
+#include "tests/common/testing.h"
+
+using namespace owl::common;
+
+inline float halfArea(const box3f &b)
+{
+  const vec3f d = b.span();
+  return d.x*d.y+d.y*d.z+d.z*d.x;
+}
+
+// ==================================================================
+// collapse
+// ==================================================================
+
+/*! checks the subtree under the given child, and returns the exact
+    bounds of its prims */
+box3f checkChild(const QuantizedBVH8 &bvh, const box3f *primBounds,
+                 const QuantizedBVH8Node &node, int i,
+                 std::vector<int> &primRefs, double &sumArea, double &sumExactArea);
+
+box3f checkNode(const QuantizedBVH8 &bvh, const box3f *primBounds, uint32_t nodeID,
+                std::vector<int> &nodeRefs, std::vector<int> &primRefs,
+                double &sumArea, double &sumExactArea)
+{
+  CHECK(nodeID < bvh.nodes.size());
+  nodeRefs[nodeID]++;
+  const QuantizedBVH8Node &node = bvh.nodes[nodeID];
+  CHECK(node.numChildren() >= 1 && node.numChildren() <= 8);
+  CHECK(node.numInner() <= node.numChildren());
+  box3f bounds;
+  for (int i=0;i<node.numChildren();i++) {
+    if (node.isLeaf(i))
+      bounds.extend(checkChild(bvh,primBounds,node,i,primRefs,sumArea,sumExactArea));
+    else {
+      const box3f exact = checkNode(bvh,primBounds,node.childBase+i,
+                                    nodeRefs,primRefs,sumArea,sumExactArea);
+      const box3f quantized = node.childBounds(i);
+      CHECK(quantized.contains(exact.lower) && quantized.contains(exact.upper));
+      sumArea      += halfArea(quantized);
+      sumExactArea += halfArea(exact);
+      bounds.extend(exact);
+    }
+  }
+  return bounds;
+}
+
+box3f checkChild(const QuantizedBVH8 &bvh, const box3f *primBounds,
+                 const QuantizedBVH8Node &node, int i,
+                 std::vector<int> &primRefs, double &sumArea, double &sumExactArea)
+{
+  CHECK(node.leafCount(i) >= 1);
+  box3f exact;
+  for (uint32_t j=node.leafBegin(i);j<node.leafBegin(i)+node.leafCount(i);j++) {
+    CHECK(j < bvh.primIDs.size());
+    primRefs[bvh.primIDs[j]]++;
+    exact.extend(primBounds[bvh.primIDs[j]]);
+  }
+  const box3f quantized = node.childBounds(i);
+  CHECK(quantized.contains(exact.lower) && quantized.contains(exact.upper));
+  sumArea      += halfArea(quantized);
+  sumExactArea += halfArea(exact);
+  return exact;
+}
+
+/*! checks every node and prim gets referenced exactly once, and all
+    quantized bounds are conservative; returns how much bigger (in
+    surface area) quantized boxes are than exact ones, on average */
+double checkBVH(const QuantizedBVH8 &bvh, const std::vector<box3f> &primBounds)
+{
+  std::vector<int> nodeRefs(bvh.nodes.size(),0), primRefs(primBounds.size(),0);
+  double sumArea = 0., sumExactArea = 0.;
+  if (!primBounds.empty())
+    checkNode(bvh,primBounds.data(),0,nodeRefs,primRefs,sumArea,sumExactArea);
+  for (int refs : nodeRefs) CHECK(refs == 1);
+  for (int refs : primRefs) CHECK(refs == 1);
+  CHECK(bvh.primIDs.size() == primBounds.size());
+  return sumExactArea > 0. ? sumArea/sumExactArea : 1.;
+}
+
+std::vector<box3f> randomBoxes(Random &rnd, size_t numBoxes, vec3f offset, float size,
+                               bool flat)
+{
+  std::vector<box3f> boxes(numBoxes);
+  for (auto &box : boxes) {
+    const vec3f center = offset+rnd.point(0.f,1.f);
+    vec3f radius = vec3f(size)*rnd.point(0.f,1.f);
+    if (flat) radius.z = 0.f;
+    box = box3f(center-radius,center+radius);
+  }
+  return boxes;
+}
+
+void testCollapse()
+{
+  CHECK(sizeof(QuantizedBVH8Node) == 80);
+
+  // corner cases: nothing, a root that's a leaf, all the same box
+  QuantizedBVH8 bvh;
+  bvh.build(nullptr,0);
+  CHECK(bvh.nodes.empty() && bvh.primIDs.empty());
+
+  std::vector<box3f> one = { box3f(vec3f(1.f),vec3f(2.f)) };
+  bvh.build(one.data(),one.size());
+  checkBVH(bvh,one);
+  CHECK(bvh.nodes.size() == 1 && bvh.nodes[0].numChildren() == 1);
+
+  std::vector<box3f> same(1000,box3f(vec3f(1.f),vec3f(1.f)));
+  bvh.build(same.data(),same.size());
+  checkBVH(bvh,same);
+
+  // leaves too large for the 8-bit leaf offsets
+  std::vector<box3f> many(10000,box3f(vec3f(0.f),vec3f(1.f)));
+  BVHBuildConfig bigLeaves;
+  bigLeaves.maxLeafSize = 64;
+  bool threw = false;
+  try { bvh.build(many.data(),many.size(),bigLeaves); }
+  catch (std::runtime_error &) { threw = true; }
+  CHECK(threw);
+
+  Random rnd(0x1234);
+  struct { const char *name; vec3f offset; float size; bool flat; } cases[] = {
+    { "random",          vec3f(0.f),          .02f,  false },
+    { "flat",            vec3f(0.f),          .02f,  true  },
+    { "tiny",            vec3f(0.f),          1e-6f, false },
+    { "far from origin", vec3f(1e5f,-3e5f,0), .02f,  false },
+  };
+  for (auto &c : cases) {
+    const std::vector<box3f> boxes = randomBoxes(rnd,100000,c.offset,c.size,c.flat);
+    BVH binary;
+    binary.build(boxes.data(),boxes.size());
+    bvh.collapse(binary);
+    const double areaRatio = checkBVH(bvh,boxes);
+    LOG("collapse (" << c.name << "): " << binary.nodes.size() << " binary nodes -> "
+        << bvh.nodes.size() << " wide nodes; quantized boxes have "
+        << prettyDouble(100.*(areaRatio-1.)) << "% more surface area");
+  }
+  LOG_OK("collapse ok");
+}
+
+// ==================================================================
+// traversal
+// ==================================================================
+
+void randomTriangles(Random &rnd, size_t numTriangles,
+                     std::vector<vec3f> &vertices, std::vector<vec3i> &indices)
+{
+  for (size_t i=0;i<numTriangles;i++) {
+    const vec3f center = rnd.point(0.f,1.f);
+    const float size   = powf(10.f,rnd(-2.5f,-1.f));
+    const int   base   = int(vertices.size());
+    for (int k=0;k<3;k++)
+      vertices.push_back(center+size*rnd.point(-1.f,1.f));
+    indices.push_back(vec3i(base,base+1,base+2));
+  }
+}
+
+HostRay randomRay(Random &rnd)
+{
+  return HostRay(rnd.point(-.2f,1.2f),rnd.direction()*rnd(.5f,2.f));
+}
+
+struct Sphere { vec3f center; float radius; };
+
+inline bool intersectSphere(const Sphere &sphere, HostRay &ray, HostHit &hit, int primID)
+{
+  const vec3f oc = ray.origin-sphere.center;
+  const float a  = dot(ray.direction,ray.direction);
+  const float b  = dot(oc,ray.direction);
+  const float c  = dot(oc,oc)-sphere.radius*sphere.radius;
+  const float discriminant = b*b-a*c;
+  if (discriminant < 0.f) return false;
+  const float root = sqrtf(discriminant);
+  float t = (-b-root)/a;
+  if (t < ray.tmin) t = (-b+root)/a;
+  if (!(t >= ray.tmin && t < ray.tmax)) return false;
+  ray.tmax   = t;
+  hit.primID = primID;
+  return true;
+}
+
+void testTraversal()
+{
+  Random rnd(0x5555);
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  randomTriangles(rnd,20000,vertices,indices);
+  TriangleMeshBVH mesh;
+  mesh.layout = TriangleMeshBVH::QUANTIZED_WIDE8;
+  mesh.build(vertices.data(),indices.data(),indices.size());
+  CHECK(mesh.bvh.nodes.empty() && !mesh.wideBVH.nodes.empty());
+
+  const int numRays = 4000;
+  int numHits = 0;
+  for (int watertight=0;watertight<2;watertight++) {
+    mesh.watertight = watertight;
+    for (int i=0;i<numRays;i++) {
+      HostRay ref = randomRay(rnd);
+      if (i % 5 == 0) ref.tmax = rnd(0.f,.5f);
+      const HostRay ray0 = ref;
+      HostHit refHit;
+      for (size_t j=0;j<indices.size();j++) {
+        const TriangleMeshBVH::Triangle &tri = mesh.triangles[j];
+        if (watertight)
+          intersectTriangle(ref,WatertightRay(ref),refHit,tri.v0,tri.v1,tri.v2,int(j));
+        else
+          intersectTriangle(ref,refHit,tri.v0,tri.v1,tri.v2,int(j));
+      }
+      HostRay ray = ray0;
+      HostHit hit;
+      CHECK(mesh.closestHit(ray,hit) == (refHit.primID >= 0));
+      CHECK(ray.tmax == ref.tmax);
+      CHECK(mesh.anyHit(ray0) == (refHit.primID >= 0));
+      numHits += (refHit.primID >= 0);
+
+      // packet queries fall back to single rays
+      RayPacket8 rays;
+      HitPacket8 hits;
+      hits.clear();
+      for (int lane=0;lane<8;lane++) rays.set(lane,ray0);
+      CHECK(mesh.closestHit8(rays,hits) == (refHit.primID >= 0 ? 0xff : 0));
+      CHECK(rays.tmax[i%8] == ref.tmax);
+    }
+  }
+  LOG("traversal: " << numHits << " of " << 2*numRays << " rays hit");
+
+  // user geometry, with both the SIMD and the scalar child test
+  std::vector<Sphere> spheres(5000);
+  std::vector<box3f>  bounds(spheres.size());
+  for (size_t i=0;i<spheres.size();i++) {
+    spheres[i] = { rnd.point(0.f,1.f), rnd(.001f,.02f) };
+    bounds[i]  = box3f(spheres[i].center-vec3f(spheres[i].radius),
+                       spheres[i].center+vec3f(spheres[i].radius));
+  }
+  QuantizedBVH8 bvh;
+  bvh.build(bounds.data(),bounds.size());
+  auto intersect = [&](int primID, HostRay &ray, HostHit &hit) {
+    return intersectSphere(spheres[primID],ray,hit,primID);
+  };
+  for (int i=0;i<numRays;i++) {
+    HostRay ref = randomRay(rnd);
+    const HostRay ray0 = ref;
+    HostHit refHit;
+    for (size_t j=0;j<spheres.size();j++)
+      intersectSphere(spheres[j],ref,refHit,int(j));
+
+    HostRay ray = ray0;
+    HostHit hit;
+    CHECK(traceClosest(bvh,ray,hit,intersect) == (refHit.primID >= 0));
+    CHECK(ray.tmax == ref.tmax && hit.primID == refHit.primID);
+    CHECK(traceAny(bvh,ray0,intersect) == (refHit.primID >= 0));
+
+    ray = ray0;
+    hit = HostHit();
+    CHECK(detail::traceClosestWide(bvh,ray,hit,detail::WideChildTest_scalar(ray0),intersect)
+          == (refHit.primID >= 0));
+    CHECK(ray.tmax == ref.tmax && hit.primID == refHit.primID);
+    CHECK(detail::traceAnyWide(bvh,ray0,detail::WideChildTest_scalar(ray0),intersect)
+          == (refHit.primID >= 0));
+  }
+  LOG_OK("traversal ok");
+}
+
+// ==================================================================
+// benchmarks
+// ==================================================================
+
+/*! a pinhole camera, as in the samples' ray gen programs */
+struct Camera {
+  vec3f origin, dir_00, dir_du, dir_dv;
+  HostRay ray(vec2i fbSize, int ix, int iy) const
+  {
+    const float u = (ix+.5f)/fbSize.x, v = (iy+.5f)/fbSize.y;
+    return HostRay(origin,normalize(dir_00+u*dir_du+v*dir_dv));
+  }
+};
+
+Camera lookAtCamera(vec3f lookFrom, vec3f lookAt, vec3f lookUp, float cosFovy,
+                    vec2i fbSize)
+{
+  Camera camera;
+  camera.origin = lookFrom;
+  camera.dir_00 = normalize(lookAt-lookFrom);
+  const float aspect = fbSize.x / float(fbSize.y);
+  camera.dir_du = cosFovy * aspect * normalize(cross(camera.dir_00,lookUp));
+  camera.dir_dv = cosFovy * normalize(cross(camera.dir_du,camera.dir_00));
+  camera.dir_00 -= 0.5f * camera.dir_du;
+  camera.dir_00 -= 0.5f * camera.dir_dv;
+  return camera;
+}
+
+/*! traces all pixels with closest-hit and any-hit traversal;
+    returns the number of hits */
+template<typename Closest, typename Any>
+size_t traceFrame(const std::string &name, const Camera &camera, vec2i fbSize,
+                  const Closest &closest, const Any &any)
+{
+  const size_t numRays = size_t(fbSize.x)*fbSize.y;
+  size_t hits[2] = { 0, 0 };
+  double t0 = getCurrentTime();
+  for (int iy=0;iy<fbSize.y;iy++)
+    for (int ix=0;ix<fbSize.x;ix++) {
+      HostRay ray = camera.ray(fbSize,ix,iy);
+      HostHit hit;
+      hits[0] += closest(ray,hit);
+    }
+  double t1 = getCurrentTime();
+  for (int iy=0;iy<fbSize.y;iy++)
+    for (int ix=0;ix<fbSize.x;ix++)
+      hits[1] += any(camera.ray(fbSize,ix,iy));
+  double t2 = getCurrentTime();
+  LOG(name << ": closest: " << (numRays/(t1-t0)*1e-6) << " Mrays/s"
+      << ", any: " << (numRays/(t2-t1)*1e-6) << " Mrays/s"
+      << " (" << (100.*hits[0]/numRays) << "% hit)");
+  CHECK(hits[0] == hits[1]);
+  return hits[0];
+}
+
+void benchmarkMesh(const std::string &name, const vec3f *vertices, const vec3i *indices,
+                   size_t numTriangles, const Camera &camera, vec2i fbSize)
+{
+  size_t hits[2];
+  for (int layout=0;layout<2;layout++) {
+    TriangleMeshBVH mesh;
+    mesh.layout = layout ? TriangleMeshBVH::QUANTIZED_WIDE8 : TriangleMeshBVH::BINARY;
+    const double t0 = getCurrentTime();
+    mesh.build(vertices,indices,numTriangles);
+    const double t1 = getCurrentTime();
+    const std::string layoutName = name + (layout ? " (quantized 8-wide)" : " (binary)");
+    LOG(layoutName << ": " << prettyNumber(numTriangles) << " triangles, "
+        << prettyDouble(mesh.bvhSizeInBytes()/double(numTriangles)) << " BVH bytes/triangle, "
+        << "built in " << prettyDouble(t1-t0) << "s");
+    hits[layout]
+      = traceFrame(layoutName,camera,fbSize,
+                   [&](HostRay &ray, HostHit &hit) { return mesh.closestHit(ray,hit); },
+                   [&](const HostRay &ray) { return mesh.anyHit(ray); });
+  }
+  CHECK(hits[0] == hits[1]);
+}
+
+/*! the cube of s01-simpleTriangles, with its camera */
+void benchmarkSimpleTriangles()
+{
+  const vec3f vertices[8] = {
+    { -1.f,-1.f,-1.f }, { +1.f,-1.f,-1.f }, { -1.f,+1.f,-1.f }, { +1.f,+1.f,-1.f },
+    { -1.f,-1.f,+1.f }, { +1.f,-1.f,+1.f }, { -1.f,+1.f,+1.f }, { +1.f,+1.f,+1.f }
+  };
+  const vec3i indices[12] = {
+    { 0,1,3 }, { 2,3,0 }, { 5,7,6 }, { 5,6,4 }, { 0,4,5 }, { 0,5,1 },
+    { 2,3,7 }, { 2,7,6 }, { 1,5,7 }, { 1,7,3 }, { 4,0,2 }, { 4,2,6 }
+  };
+  const vec2i fbSize(800,600);
+  benchmarkMesh("s01-simpleTriangles",vertices,indices,12,
+                lookAtCamera(vec3f(-4.f,-3.f,-2.f),vec3f(0.f),vec3f(0.f,1.f,0.f),.66f,fbSize),
+                fbSize);
+}
+
+/*! a million random triangles, looked at from outside */
+void benchmarkTriangleSoup()
+{
+  Random rnd(0x7777);
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  randomTriangles(rnd,1000000,vertices,indices);
+  const vec2i fbSize(512,512);
+  benchmarkMesh("triangle soup",vertices.data(),indices.data(),indices.size(),
+                lookAtCamera(vec3f(-1.f,-.5f,-1.5f),vec3f(.5f),vec3f(0.f,1.f,0.f),.66f,fbSize),
+                fbSize);
+}
+
+/*! the sphere grid of t01-many-spheres (at a smaller N), with its
+    camera */
+void benchmarkManySpheres()
+{
+  const int N = 100;
+  std::vector<Sphere> spheres;
+  std::vector<box3f>  bounds;
+  for (int iz=0;iz<N;iz++)
+    for (int iy=0;iy<N;iy++)
+      for (int ix=0;ix<N;ix++) {
+        spheres.push_back({ vec3f((float)ix,(float)iy,(float)iz), .5f });
+        bounds.push_back(box3f(spheres.back().center-vec3f(.5f),spheres.back().center+vec3f(.5f)));
+      }
+  BVH binary;
+  binary.build(bounds.data(),bounds.size());
+  const double t0 = getCurrentTime();
+  QuantizedBVH8 wide;
+  wide.collapse(binary);
+  const double t1 = getCurrentTime();
+  LOG("t01-many-spheres: " << prettyNumber(spheres.size()) << " spheres, BVH bytes/sphere: "
+      << prettyDouble(binary.sizeInBytes()/double(spheres.size())) << " (binary) vs "
+      << prettyDouble(wide.sizeInBytes()/double(spheres.size())) << " (quantized 8-wide, "
+      << "collapsed in " << prettyDouble(t1-t0) << "s)");
+
+  const vec2i fbSize(1024,1024);
+  const float fovy = 20.f;
+  const vec3f vup(0.f,1.f,0.f);
+  const float aspect = fbSize.x / float(fbSize.y);
+  const float theta = fovy * ((float)M_PI) / 180.0f;
+  const float half_height = tanf(theta / 2.0f);
+  const float half_width = aspect * half_height;
+  const float focusDist = 10.f;
+  const vec3f lookFrom = 1.8f*vec3f(1.3f,1.5f,2.f)*vec3f((float)N);
+  const vec3f lookAt   = vec3f(0.5f*N);
+  const vec3f w = normalize(lookFrom - lookAt);
+  const vec3f u = normalize(cross(vup, w));
+  const vec3f v = cross(w, u);
+  Camera camera;
+  camera.origin = lookFrom;
+  camera.dir_00 = - half_width * focusDist*u - half_height * focusDist*v - focusDist * w;
+  camera.dir_du = 2.0f*half_width*focusDist*u;
+  camera.dir_dv = 2.0f*half_height*focusDist*v;
+
+  auto intersect = [&](int primID, HostRay &ray, HostHit &hit) {
+    return intersectSphere(spheres[primID],ray,hit,primID);
+  };
+  const size_t binaryHits
+    = traceFrame("t01-many-spheres (binary)",camera,fbSize,
+                 [&](HostRay &ray, HostHit &hit) { return traceClosest(binary,ray,hit,intersect); },
+                 [&](const HostRay &ray) { return traceAny(binary,ray,intersect); });
+  const size_t wideHits
+    = traceFrame("t01-many-spheres (quantized 8-wide)",camera,fbSize,
+                 [&](HostRay &ray, HostHit &hit) { return traceClosest(wide,ray,hit,intersect); },
+                 [&](const HostRay &ray) { return traceAny(wide,ray,intersect); });
+  CHECK(binaryHits == wideHits);
+}
+
+int main(int ac, char **av)
+{
+  testCollapse();
+  testTraversal();
+  benchmarkSimpleTriangles();
+  benchmarkTriangleSoup();
+  benchmarkManySpheres();
+  LOG_OK("all tests passed");
+  return 0;
+}
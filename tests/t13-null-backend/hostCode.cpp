@@ -0,0 +1,329 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t13-null-backend/hostCode.cpp - host-only test and
+    benchmark for the null device backend (OWL_NULL_DEVICE): runs the
+    full host-side pipeline of a small triangles scene - buffers,
+    accels, programs, SBT, launch params and launch - on two null
+    devices, and checks what ended up in the (host-memory) SBT, launch
+    params and instance buffers; then times SBT building for a scene
+    with many geoms */
+
+#include "owl/owl_host.h"
+#include "owl/APIHandle.h"
+#include "owl/APIContext.h"
+#include "owl/InstanceGroup.h"
+#include "owl/TrianglesGeomGroup.h"
+#include "owl/LaunchParams.h"
+#include <random>
+#include <vector>
+
+#define OWL_TEST_NAME "nullBackend"
+#include "tests/common/testing.h"
+
+using namespace owl;
+using namespace owl::common;
+
+/*! nothing ever compiles this on a null device, but the module still
+    needs some 'ptx' to be created from */
+const char *dummyPTX = "// null device test; no actual device code\n";
+
+struct TrianglesGeomData {
+  vec3f  color;
+  vec3f *vertex;
+  vec3i *index;
+};
+
+struct RayGenData {
+  int                    frameID;
+  OptixTraversableHandle world;
+};
+
+struct LaunchParamsData {
+  int                    accumID;
+  OptixTraversableHandle world;
+};
+
+/*! a unit cube's 12 triangles, moved to 'center' */
+void addCube(std::vector<vec3f> &vertices, std::vector<vec3i> &indices,
+             const vec3f &center)
+{
+  const int base = (int)vertices.size();
+  for (int i=0;i<8;i++)
+    vertices.push_back(center+vec3f(i&1?.5f:-.5f,i&2?.5f:-.5f,i&4?.5f:-.5f));
+  const int faces[12][3] = {
+    {0,1,3},{2,0,3},{5,4,6},{5,6,7},{0,4,5},{0,5,1},
+    {2,3,7},{2,7,6},{1,5,7},{1,7,3},{4,0,2},{4,2,6}
+  };
+  for (auto &f : faces)
+    indices.push_back(vec3i(f[0],f[1],f[2])+vec3i(base));
+}
+
+/*! the (host-memory) contents of a null device's device memory */
+template<typename T>
+inline const T *onHost(const DeviceMemory &mem)
+{
+  CHECK(mem.onHost);
+  return (const T *)mem.d_pointer;
+}
+
+void testScene()
+{
+  LOG("running a small scene on two null devices");
+  int deviceIDs[2] = { OWL_NULL_DEVICE, OWL_NULL_DEVICE };
+  OWLContext owl = owlContextCreate(deviceIDs,2);
+  CHECK(owlGetDeviceCount(owl) == 2);
+  OWLModule module = owlModuleCreate(owl,dummyPTX);
+
+  OWLVarDecl trianglesGeomVars[] = {
+    { "color",  OWL_FLOAT3, OWL_OFFSETOF(TrianglesGeomData,color)},
+    { "vertex", OWL_BUFPTR, OWL_OFFSETOF(TrianglesGeomData,vertex)},
+    { "index",  OWL_BUFPTR, OWL_OFFSETOF(TrianglesGeomData,index)},
+    { /* sentinel to mark end of list */ }
+  };
+  OWLGeomType trianglesGeomType
+    = owlGeomTypeCreate(owl,OWL_TRIANGLES,sizeof(TrianglesGeomData),
+                        trianglesGeomVars,-1);
+  owlGeomTypeSetClosestHit(trianglesGeomType,0,module,"TriangleMesh");
+
+  // ------------------------------------------------------------------
+  // a few cubes, each its own geom, all in one triangles group
+  // ------------------------------------------------------------------
+  const int numGeoms = 5;
+  Random random(13);
+  std::vector<OWLGeom>   geoms;
+  std::vector<OWLBuffer> vertexBuffers, indexBuffers;
+  std::vector<vec3f>     colors;
+  std::vector<box3f>     cubeBounds;
+  for (int i=0;i<numGeoms;i++) {
+    std::vector<vec3f> vertices;
+    std::vector<vec3i> indices;
+    const vec3f center = random.point(-10.f,10.f);
+    addCube(vertices,indices,center);
+    cubeBounds.push_back(box3f(center-vec3f(.5f),center+vec3f(.5f)));
+
+    OWLBuffer vertexBuffer
+      = owlDeviceBufferCreate(owl,OWL_FLOAT3,vertices.size(),vertices.data());
+    OWLBuffer indexBuffer
+      = owlDeviceBufferCreate(owl,OWL_INT3,indices.size(),indices.data());
+    for (int d=0;d<2;d++) {
+      const vec3f *vertex = (const vec3f *)owlBufferGetPointer(vertexBuffer,d);
+      const vec3i *index  = (const vec3i *)owlBufferGetPointer(indexBuffer,d);
+      CHECK(vertex && index);
+      CHECK(!memcmp(vertex,vertices.data(),vertices.size()*sizeof(vec3f)));
+      CHECK(!memcmp(index,indices.data(),indices.size()*sizeof(vec3i)));
+    }
+
+    OWLGeom geom = owlGeomCreate(owl,trianglesGeomType);
+    owlTrianglesSetVertices(geom,vertexBuffer,vertices.size(),sizeof(vec3f),0);
+    owlTrianglesSetIndices(geom,indexBuffer,indices.size(),sizeof(vec3i),0);
+    colors.push_back(random.point(0.f,1.f));
+    owlGeomSet3f(geom,"color",owl3f{colors.back().x,colors.back().y,colors.back().z});
+    owlGeomSetBuffer(geom,"vertex",vertexBuffer);
+    owlGeomSetBuffer(geom,"index",indexBuffer);
+    geoms.push_back(geom);
+    vertexBuffers.push_back(vertexBuffer);
+    indexBuffers.push_back(indexBuffer);
+  }
+  OWLGroup trianglesGroup
+    = owlTrianglesGeomGroupCreate(owl,geoms.size(),geoms.data());
+  owlGroupBuildAccel(trianglesGroup);
+  OWLGroup world
+    = owlInstanceGroupCreate(owl,1,&trianglesGroup);
+  owlGroupBuildAccel(world);
+
+  size_t accelSize = 0, accelPeak = 0;
+  owlGroupGetAccelSize(trianglesGroup,&accelSize,&accelPeak);
+  CHECK(accelSize > 0);
+  CHECK(accelPeak >= accelSize);
+
+  // ------------------------------------------------------------------
+  // programs, pipeline, SBT, launch
+  // ------------------------------------------------------------------
+  OWLVarDecl rayGenVars[] = {
+    { "frameID", OWL_INT,   OWL_OFFSETOF(RayGenData,frameID)},
+    { "world",   OWL_GROUP, OWL_OFFSETOF(RayGenData,world)},
+    { /* sentinel to mark end of list */ }
+  };
+  OWLRayGen rayGen
+    = owlRayGenCreate(owl,module,"simpleRayGen",
+                      sizeof(RayGenData),rayGenVars,-1);
+  owlRayGenSet1i(rayGen,"frameID",7);
+  owlRayGenSetGroup(rayGen,"world",world);
+  OWLMissProg missProg
+    = owlMissProgCreate(owl,module,"miss",0,nullptr,0);
+  (void)missProg;
+
+  OWLVarDecl launchParamsVars[] = {
+    { "accumID", OWL_INT,   OWL_OFFSETOF(LaunchParamsData,accumID)},
+    { "world",   OWL_GROUP, OWL_OFFSETOF(LaunchParamsData,world)},
+    { /* sentinel to mark end of list */ }
+  };
+  OWLParams params
+    = owlParamsCreate(owl,sizeof(LaunchParamsData),launchParamsVars,-1);
+  owlParamsSet1i(params,"accumID",42);
+  owlParamsSetGroup(params,"world",world);
+
+  owlBuildPrograms(owl);
+  owlBuildPipeline(owl);
+  owlBuildSBT(owl);
+  owlLaunch2D(rayGen,64,32,params);
+
+  // ------------------------------------------------------------------
+  // now look at what each device got
+  // ------------------------------------------------------------------
+  APIContext::SP context = ((APIHandle *)owl)->getContext();
+  CHECK(context->onNullDevices());
+  InstanceGroup::SP instanceGroup = ((APIHandle *)world)->get<InstanceGroup>();
+  Group::SP         meshGroup     = ((APIHandle *)trianglesGroup)->get<Group>();
+  LaunchParams::SP  launchParams  = ((APIHandle *)params)->get<LaunchParams>();
+  for (int d=0;d<2;d++) {
+    DeviceContext::SP device = context->getDevice(d);
+    CHECK(device->isNull());
+
+    // one triangles group with numGeoms geoms, one ray type
+    const SBT &sbt = device->sbt;
+    CHECK(sbt.hitGroupRecordCount == size_t(numGeoms+1));
+    CHECK(sbt.hitGroupRecordSize >= OPTIX_SBT_RECORD_HEADER_SIZE+sizeof(TrianglesGeomData));
+    const uint8_t *hitGroupRecords = onHost<uint8_t>(sbt.hitGroupRecordsBuffer);
+    for (int i=0;i<numGeoms;i++) {
+      const uint8_t *record = hitGroupRecords + i*sbt.hitGroupRecordSize;
+      OptixProgramGroup pg = 0;
+      memcpy(&pg,record,sizeof(pg));
+      CHECK(pg != 0);
+      const TrianglesGeomData &data
+        = *(const TrianglesGeomData *)(record+OPTIX_SBT_RECORD_HEADER_SIZE);
+      CHECK(data.color == colors[i]);
+      CHECK(data.vertex == owlBufferGetPointer(vertexBuffers[i],d));
+      CHECK(data.index  == owlBufferGetPointer(indexBuffers[i],d));
+    }
+
+    // each raygen keeps its own SBT record
+    RayGen::SP rg = ((APIHandle *)rayGen)->get<RayGen>();
+    const uint8_t *rayGenRecord = onHost<uint8_t>(rg->getDD(device).sbtRecordBuffer);
+    const RayGenData &rayGenData
+      = *(const RayGenData *)(rayGenRecord+OPTIX_SBT_RECORD_HEADER_SIZE);
+    CHECK(rayGenData.frameID == 7);
+    CHECK(rayGenData.world == instanceGroup->getTraversable(device));
+
+    const LaunchParamsData &lpData
+      = *onHost<LaunchParamsData>(launchParams->getDD(device).deviceMemory);
+    CHECK(lpData.accumID == 42);
+    CHECK(lpData.world != 0);
+    CHECK(lpData.world == instanceGroup->getTraversable(device));
+
+    const OptixInstance &instance
+      = *onHost<OptixInstance>(instanceGroup->getDD(device).optixInstanceBuffer);
+    CHECK(instance.traversableHandle == meshGroup->getTraversable(device));
+    CHECK(instance.transform[0] == 1.f && instance.transform[5] == 1.f
+          && instance.transform[10] == 1.f && instance.transform[3] == 0.f);
+
+    const NullDeviceStats &stats = device->nullStats;
+    CHECK(stats.numModules     == 1);
+    // ray gen, miss, and one hit group for our one ray type
+    CHECK(stats.numPrograms    == 3);
+    CHECK(stats.numPipelines   == 1);
+    CHECK(stats.numAccelBuilds == 2);
+    CHECK(stats.accelBytes     >= accelSize);
+    CHECK(stats.numLaunches    == 1);
+    CHECK(stats.numLaunchedRays == 64*32);
+  }
+
+  // the triangles group's bounds (only kept up to date with motion
+  // blur on) come out of the null devices' host-side vertices
+  box3f expectedBounds;
+  for (auto &b : cubeBounds) expectedBounds.extend(b);
+  std::shared_ptr<TrianglesGeomGroup> trianglesGeomGroup
+    = std::dynamic_pointer_cast<TrianglesGeomGroup>(meshGroup);
+  CHECK(trianglesGeomGroup);
+  trianglesGeomGroup->updateMotionBounds();
+  CHECK(meshGroup->bounds[0] == expectedBounds);
+  
+  owlContextDestroy(owl);
+  LOG_OK("scene test passed");
+}
+
+/*! builds an SBT (and group accels) for a scene with many small
+    geoms, on one null device: on a null device that's purely the host
+    side of SBT building */
+void benchmarkSBT(int numGeoms)
+{
+  int deviceID = OWL_NULL_DEVICE;
+  OWLContext owl = owlContextCreate(&deviceID,1);
+  OWLModule module = owlModuleCreate(owl,dummyPTX);
+  OWLVarDecl trianglesGeomVars[] = {
+    { "color",  OWL_FLOAT3, OWL_OFFSETOF(TrianglesGeomData,color)},
+    { "vertex", OWL_BUFPTR, OWL_OFFSETOF(TrianglesGeomData,vertex)},
+    { "index",  OWL_BUFPTR, OWL_OFFSETOF(TrianglesGeomData,index)},
+    { /* sentinel to mark end of list */ }
+  };
+  OWLGeomType trianglesGeomType
+    = owlGeomTypeCreate(owl,OWL_TRIANGLES,sizeof(TrianglesGeomData),
+                        trianglesGeomVars,-1);
+  owlGeomTypeSetClosestHit(trianglesGeomType,0,module,"TriangleMesh");
+  owlContextSetRayTypeCount(owl,2);
+
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  addCube(vertices,indices,vec3f(0.f));
+  OWLBuffer vertexBuffer
+    = owlDeviceBufferCreate(owl,OWL_FLOAT3,vertices.size(),vertices.data());
+  OWLBuffer indexBuffer
+    = owlDeviceBufferCreate(owl,OWL_INT3,indices.size(),indices.data());
+  std::vector<OWLGeom> geoms;
+  for (int i=0;i<numGeoms;i++) {
+    OWLGeom geom = owlGeomCreate(owl,trianglesGeomType);
+    owlTrianglesSetVertices(geom,vertexBuffer,vertices.size(),sizeof(vec3f),0);
+    owlTrianglesSetIndices(geom,indexBuffer,indices.size(),sizeof(vec3i),0);
+    owlGeomSet3f(geom,"color",owl3f{float(i),0.f,0.f});
+    owlGeomSetBuffer(geom,"vertex",vertexBuffer);
+    owlGeomSetBuffer(geom,"index",indexBuffer);
+    geoms.push_back(geom);
+  }
+  const double t0 = getCurrentTime();
+  OWLGroup group = owlTrianglesGeomGroupCreate(owl,geoms.size(),geoms.data());
+  owlGroupBuildAccel(group);
+  const double t1 = getCurrentTime();
+  owlBuildPrograms(owl);
+  owlBuildPipeline(owl);
+  const double t2 = getCurrentTime();
+  owlBuildSBT(owl);
+  const double t3 = getCurrentTime();
+
+  APIContext::SP context = ((APIHandle *)owl)->getContext();
+  const SBT &sbt = context->getDevice(0)->sbt;
+  CHECK(sbt.hitGroupRecordCount == size_t(2*numGeoms+1));
+  const TrianglesGeomData &lastData
+    = *(const TrianglesGeomData *)(onHost<uint8_t>(sbt.hitGroupRecordsBuffer)
+                                   +(2*numGeoms-1)*sbt.hitGroupRecordSize
+                                   +OPTIX_SBT_RECORD_HEADER_SIZE);
+  CHECK(lastData.color.x == float(numGeoms-1));
+  LOG_OK(prettyNumber(numGeoms) << " geoms, 2 ray types: accel "
+         << prettyDouble(t1-t0) << "s, programs+pipeline "
+         << prettyDouble(t2-t1) << "s, SBT "
+         << prettyDouble(t3-t2) << "s ("
+         << prettyDouble(sbt.hitGroupRecordCount/(t3-t2)) << " records/s)");
+  owlContextDestroy(owl);
+}
+
+int main(int ac, char **av)
+{
+  testScene();
+  for (int numGeoms : { 1000, 10000, 100000 })
+    benchmarkSBT(numGeoms);
+  LOG_OK("all tests passed");
+  return 0;
+}
@@ -0,0 +1,363 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t14-ray-batch/hostCode.cpp - host-only test and benchmark
+    for owlGroupTraceRaysOnHost(), on a null device: traces random rays
+    against a triangles group - and against an instance group with
+    transformed, masked instances of it - and checks closest hits,
+    any hits and misses against brute force, and that
+    owlGroupTraceRays() through (null device) buffers gets the same
+    hits; then measures rays/s for incoherent ray batches of
+    different sizes, with and without sorting the rays */
+
+#include "owl/owl_host.h"
+#include "owl/common/math/AffineSpace.h"
+#include "owl/common/math/rayKernels.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#define OWL_TEST_NAME "rayBatch"
+#include "tests/common/testing.h"
+
+using namespace owl::common;
+
+/*! nothing ever compiles this on a null device, but the module still
+    needs some 'ptx' to be created from */
+const char *dummyPTX = "// null device test; no actual device code\n";
+
+struct Mesh {
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+};
+
+struct TestInstance {
+  affine3f objectToWorld;
+  uint32_t instID;
+  uint8_t  visibilityMask;
+};
+
+/*! a triangles group with a few meshes of random triangles, and an
+    instance group with a few transformed instances of it */
+struct Scene {
+  Scene(int numMeshes, int trianglesPerMesh, float triangleSize, int seed);
+  ~Scene() { owlContextDestroy(owl); }
+
+  /*! (re-)sets the instance group's transforms, IDs and masks, and
+      rebuilds its accel */
+  void setInstances(const std::vector<TestInstance> &instances);
+
+  OWLContext                owl;
+  OWLGroup                  trianglesGroup;
+  OWLGroup                  world;
+  std::vector<Mesh>         meshes;
+  std::vector<TestInstance> instances;
+};
+
+Scene::Scene(int numMeshes, int trianglesPerMesh, float triangleSize, int seed)
+{
+  int deviceID = OWL_NULL_DEVICE;
+  owl = owlContextCreate(&deviceID,1);
+  OWLGeomType trianglesGeomType
+    = owlGeomTypeCreate(owl,OWL_TRIANGLES,0,nullptr,0);
+
+  Random random(seed);
+  std::vector<OWLGeom> geoms;
+  for (int meshID=0;meshID<numMeshes;meshID++) {
+    Mesh mesh;
+    for (int i=0;i<trianglesPerMesh;i++) {
+      const vec3f center = random.point(-1.f,1.f);
+      const int base = int(mesh.vertices.size());
+      for (int k=0;k<3;k++)
+        mesh.vertices.push_back(center+random.point(-triangleSize,triangleSize));
+      mesh.indices.push_back(vec3i(base,base+1,base+2));
+    }
+    // put the vertices in reverse order, so index != vertex ID
+    std::reverse(mesh.vertices.begin(),mesh.vertices.end());
+    for (auto &index : mesh.indices)
+      index = vec3i(int(mesh.vertices.size())-1)-index;
+
+    OWLBuffer vertexBuffer
+      = owlDeviceBufferCreate(owl,OWL_FLOAT3,mesh.vertices.size(),mesh.vertices.data());
+    OWLBuffer indexBuffer
+      = owlDeviceBufferCreate(owl,OWL_INT3,mesh.indices.size(),mesh.indices.data());
+    OWLGeom geom = owlGeomCreate(owl,trianglesGeomType);
+    owlTrianglesSetVertices(geom,vertexBuffer,mesh.vertices.size(),sizeof(vec3f),0);
+    owlTrianglesSetIndices(geom,indexBuffer,mesh.indices.size(),sizeof(vec3i),0);
+    geoms.push_back(geom);
+    meshes.push_back(mesh);
+  }
+  trianglesGroup = owlTrianglesGeomGroupCreate(owl,geoms.size(),geoms.data());
+  owlGroupBuildAccel(trianglesGroup);
+
+  std::vector<TestInstance> instances(4);
+  for (size_t i=0;i<instances.size();i++) {
+    const vec3f axis = normalize(random.point(-1.f,1.f)+vec3f(1e-3f));
+    instances[i].objectToWorld
+      = affine3f::translate(random.point(-2.f,2.f))
+      * affine3f::rotate(axis,random(0.f,6.f))
+      * affine3f::scale(vec3f(random(.5f,2.f)));
+    instances[i].instID = 100+uint32_t(i);
+    instances[i].visibilityMask = (i == 3) ? 0x2 : 0x3;
+  }
+  std::vector<OWLGroup> children(instances.size(),trianglesGroup);
+  world = owlInstanceGroupCreate(owl,children.size(),children.data());
+  setInstances(instances);
+}
+
+void Scene::setInstances(const std::vector<TestInstance> &newInstances)
+{
+  instances = newInstances;
+  std::vector<uint32_t> instIDs;
+  std::vector<uint8_t>  visibilityMasks;
+  for (size_t i=0;i<instances.size();i++) {
+    owlInstanceGroupSetTransform(world,int(i),(const float *)&instances[i].objectToWorld,
+                                 OWL_MATRIX_FORMAT_OWL);
+    instIDs.push_back(instances[i].instID);
+    visibilityMasks.push_back(instances[i].visibilityMask);
+  }
+  owlInstanceGroupSetInstanceIDs(world,instIDs.data());
+  owlInstanceGroupSetVisibilityMasks(world,visibilityMasks.data());
+  owlGroupBuildAccel(world);
+}
+
+/*! closest hit within one mesh (or instance thereof), by brute force */
+void bruteForceMeshes(const Scene &scene, HostRay &ray, OWLBatchHit &hit, int instID)
+{
+  for (size_t geomID=0;geomID<scene.meshes.size();geomID++) {
+    const Mesh &mesh = scene.meshes[geomID];
+    for (size_t primID=0;primID<mesh.indices.size();primID++) {
+      const vec3i index = mesh.indices[primID];
+      HostHit hostHit;
+      if (!intersectTriangle(ray,hostHit,
+                             mesh.vertices[index.x],
+                             mesh.vertices[index.y],
+                             mesh.vertices[index.z],int(primID)))
+        continue;
+      hit.t      = ray.tmax;
+      hit.primID = int32_t(primID);
+      hit.geomID = int32_t(geomID);
+      hit.instID = instID;
+      hit.u      = hostHit.u;
+      hit.v      = hostHit.v;
+    }
+  }
+}
+
+/*! closest hit by brute force, either in the triangles group or in
+    the instance group */
+OWLBatchHit bruteForce(const Scene &scene, const OWLBatchRay &in, bool instanced)
+{
+  OWLBatchHit hit;
+  hit.t      = std::numeric_limits<float>::infinity();
+  hit.primID = hit.instID = hit.geomID = -1;
+  hit.u      = hit.v = 0.f;
+  HostRay ray(vec3f(in.origin[0],in.origin[1],in.origin[2]),
+              vec3f(in.direction[0],in.direction[1],in.direction[2]),
+              in.tmin,in.tmax);
+  if (!instanced) {
+    bruteForceMeshes(scene,ray,hit,-1);
+    return hit;
+  }
+  for (auto &instance : scene.instances) {
+    if (!(instance.visibilityMask & in.mask)) continue;
+    const affine3f worldToObject = rcp(instance.objectToWorld);
+    HostRay objectRay(xfmPoint(worldToObject,ray.origin),
+                      xfmVector(worldToObject,ray.direction),
+                      ray.tmin,ray.tmax);
+    bruteForceMeshes(scene,objectRay,hit,int(instance.instID));
+    ray.tmax = objectRay.tmax;
+  }
+  return hit;
+}
+
+std::vector<OWLBatchRay> randomRays(size_t numRays, int seed)
+{
+  Random random(seed);
+  std::vector<OWLBatchRay> rays(numRays);
+  for (auto &ray : rays) {
+    // all over the place, but (mostly) pointing at the scene
+    const vec3f origin    = random.point(-4.f,4.f);
+    const vec3f direction = random.point(-2.f,2.f)-origin;
+    for (int k=0;k<3;k++) {
+      ray.origin[k]    = origin[k];
+      ray.direction[k] = direction[k];
+    }
+    ray.tmin = random(0.f,.1f);
+    // some rays that are too short to reach anything
+    ray.tmax = random(0.f,1.f) < .1f ? random(0.f,.2f) : 1e20f;
+    const float whichMask = random(0.f,1.f);
+    ray.mask = whichMask < .1f ? 0x0 : (whichMask < .5f ? 0x1 : 0xff);
+  }
+  return rays;
+}
+
+bool operator==(const OWLBatchHit &a, const OWLBatchHit &b)
+{
+  return !memcmp(&a,&b,sizeof(a));
+}
+
+/*! traces the rays with owlGroupTraceRays(), through device buffers
+    - which on a null device are host memory */
+std::vector<OWLBatchHit> traceBuffers(const Scene &scene, OWLGroup group,
+                                      const std::vector<OWLBatchRay> &rays,
+                                      uint32_t flags)
+{
+  OWLBuffer rayBuffer
+    = owlDeviceBufferCreate(scene.owl,OWL_USER_TYPE(OWLBatchRay),
+                            rays.size(),rays.data());
+  OWLBuffer hitBuffer
+    = owlDeviceBufferCreate(scene.owl,OWL_USER_TYPE(OWLBatchHit),
+                            rays.size(),nullptr);
+  owlGroupTraceRays(group,rayBuffer,hitBuffer,rays.size(),flags);
+  const OWLBatchHit *hits = (const OWLBatchHit *)owlBufferGetPointer(hitBuffer,0);
+  std::vector<OWLBatchHit> result(hits,hits+rays.size());
+  owlBufferRelease(rayBuffer);
+  owlBufferRelease(hitBuffer);
+  return result;
+}
+
+/*! checks closest hits against brute force, that any hits are hits,
+    that sorting the rays doesn't change any of the results, and that
+    tracing through buffers doesn't, either */
+void checkGroup(const Scene &scene, OWLGroup group, bool instanced,
+                const std::vector<OWLBatchRay> &rays)
+{
+  std::vector<OWLBatchHit> hits(rays.size()), sortedHits(rays.size());
+  owlGroupTraceRaysOnHost(group,rays.data(),hits.data(),rays.size());
+  owlGroupTraceRaysOnHost(group,rays.data(),sortedHits.data(),rays.size(),
+                          OWL_RAY_BATCH_SORT_RAYS);
+  size_t numHits = 0;
+  for (size_t i=0;i<rays.size();i++) {
+    const OWLBatchHit expected = bruteForce(scene,rays[i],instanced);
+    CHECK(hits[i] == expected);
+    CHECK(sortedHits[i] == expected);
+    numHits += (expected.primID >= 0);
+  }
+  // make sure there's a good mix of hits and misses
+  CHECK(numHits > rays.size()/10);
+  CHECK(numHits < rays.size()*9/10);
+
+  std::vector<OWLBatchHit> anyHits(rays.size()), sortedAnyHits(rays.size());
+  owlGroupTraceRaysOnHost(group,rays.data(),anyHits.data(),rays.size(),
+                          OWL_RAY_BATCH_ANY_HIT);
+  owlGroupTraceRaysOnHost(group,rays.data(),sortedAnyHits.data(),rays.size(),
+                          OWL_RAY_BATCH_ANY_HIT|OWL_RAY_BATCH_SORT_RAYS);
+  for (size_t i=0;i<rays.size();i++) {
+    const OWLBatchHit &hit = anyHits[i];
+    CHECK(sortedAnyHits[i] == hit);
+    CHECK((hit.primID >= 0) == (hits[i].primID >= 0));
+    if (hit.primID < 0) {
+      CHECK(hit == hits[i]);
+      continue;
+    }
+    // any hit, but still a proper one
+    CHECK(hit.t >= rays[i].tmin && hit.t < rays[i].tmax);
+    CHECK(hit.t >= hits[i].t);
+    CHECK(hit.geomID >= 0 && hit.geomID < int(scene.meshes.size()));
+    CHECK(hit.primID < int(scene.meshes[hit.geomID].indices.size()));
+    CHECK(instanced ? hit.instID >= 100 : hit.instID == -1);
+  }
+
+  CHECK(traceBuffers(scene,group,rays,OWL_RAY_BATCH_DEFAULT) == hits);
+  CHECK(traceBuffers(scene,group,rays,OWL_RAY_BATCH_ANY_HIT) == anyHits);
+}
+
+void testCorrectness()
+{
+  LOG("checking closest hits, any hits and misses against brute force");
+  Scene scene(3,300,.2f,7);
+  std::vector<OWLBatchRay> rays = randomRays(4000,13);
+
+  checkGroup(scene,scene.trianglesGroup,false,rays);
+  checkGroup(scene,scene.world,true,rays);
+
+  // the masks have to matter: with mask 0x1, instance 3 isn't
+  // visible; with mask 0 nothing is
+  size_t numMaskedOut = 0;
+  for (auto &ray : rays) {
+    OWLBatchRay allVisible = ray;
+    allVisible.mask = 0xff;
+    const OWLBatchHit hit = bruteForce(scene,allVisible,true);
+    if (ray.mask == 0x0) CHECK(bruteForce(scene,ray,true).primID == -1);
+    numMaskedOut += (hit.primID >= 0 && !(bruteForce(scene,ray,true) == hit));
+  }
+  CHECK(numMaskedOut > 0);
+
+  // moving the instances around (and rebuilding) has to get picked
+  // up by the next batch
+  std::vector<TestInstance> moved = scene.instances;
+  for (auto &instance : moved)
+    instance.objectToWorld.p += vec3f(.5f,-.25f,.1f);
+  scene.setInstances(moved);
+  checkGroup(scene,scene.world,true,rays);
+
+  // empty batches are fine, but buffers too small for the batch
+  // aren't
+  owlGroupTraceRaysOnHost(scene.world,nullptr,nullptr,0);
+  OWLBuffer rayBuffer
+    = owlDeviceBufferCreate(scene.owl,OWL_USER_TYPE(OWLBatchRay),
+                            rays.size(),rays.data());
+  OWLBuffer hitBuffer
+    = owlDeviceBufferCreate(scene.owl,OWL_USER_TYPE(OWLBatchHit),
+                            rays.size()-1,nullptr);
+  owlGroupTraceRays(scene.world,rayBuffer,hitBuffer,0);
+  bool threw = false;
+  try { owlGroupTraceRays(scene.world,rayBuffer,hitBuffer,rays.size()); }
+  catch (std::runtime_error &) { threw = true; }
+  CHECK(threw);
+  owlBufferRelease(rayBuffer);
+  owlBufferRelease(hitBuffer);
+  LOG_OK("correctness test passed");
+}
+
+void benchmark(const Scene &scene, size_t numRays)
+{
+  std::vector<OWLBatchRay> rays = randomRays(numRays,numRays);
+  for (auto &ray : rays) {
+    ray.tmin = 0.f;
+    ray.tmax = 1e20f;
+    ray.mask = 0xff;
+  }
+  std::vector<OWLBatchHit> hits(numRays), sortedHits(numRays);
+  const double t0 = getCurrentTime();
+  owlGroupTraceRaysOnHost(scene.world,rays.data(),hits.data(),numRays);
+  const double t1 = getCurrentTime();
+  owlGroupTraceRaysOnHost(scene.world,rays.data(),sortedHits.data(),numRays,
+                          OWL_RAY_BATCH_SORT_RAYS);
+  const double t2 = getCurrentTime();
+  CHECK(!memcmp(hits.data(),sortedHits.data(),numRays*sizeof(OWLBatchHit)));
+  LOG_OK(prettyNumber(numRays) << " incoherent rays: "
+         << prettyDouble(numRays/(t1-t0)) << "rays/s unsorted, "
+         << prettyDouble(numRays/(t2-t1)) << "rays/s sorted");
+}
+
+int main(int ac, char **av)
+{
+  testCorrectness();
+
+  LOG("benchmarking 4 instances of 3x100K triangles");
+  Scene scene(3,100000,.02f,1);
+  // first batch builds the host-side accels
+  OWLBatchRay ray = randomRays(1,0)[0];
+  OWLBatchHit hit;
+  owlGroupTraceRaysOnHost(scene.world,&ray,&hit,1);
+  for (size_t numRays : { 1000, 10000, 100000, 1000000 })
+    benchmark(scene,numRays);
+  LOG_OK("all tests passed");
+  return 0;
+}
@@ -0,0 +1,249 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t15-ray-reorder/hostCode.cpp - host-only unit test and
+    benchmark for the parallel radix sort in
+    owl/common/parallel/radixSort.h and the ray reordering in
+    owl/common/math/rayReorder.h: checks the sort against
+    std::stable_sort, and that reordered rays (gathered into sorted
+    order, traced, and scattered back) give the same hits as the
+    original ones; then measures, for batches of incoherent secondary
+    rays on a triangle soup, what reordering costs vs what it saves in
+    traversal */
+
+#include "owl/common/bvh/TriangleMeshBVH.h"
+#include "owl/common/math/rayReorder.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#define OWL_TEST_NAME "rayReorder"
+#include "tests/common/testing.h"
+
+using namespace owl::common;
+
+// ==================================================================
+// radix sort
+// ==================================================================
+
+template<typename KeyT>
+void testRadixSort(size_t count, int numKeyBits, int seed)
+{
+  std::mt19937_64 rng(seed);
+  const KeyT keyMask
+    = numKeyBits >= int(8*sizeof(KeyT)) ? KeyT(~KeyT(0)) : KeyT((KeyT(1) << numKeyBits)-1);
+  std::vector<KeyT>     keys(count);
+  std::vector<uint32_t> values(count);
+  for (size_t i=0;i<count;i++) {
+    // few distinct keys, so the sort has to be stable to pass
+    keys[i]   = KeyT(rng()) & keyMask & (i % 3 ? ~KeyT(0xff) : ~KeyT(0));
+    values[i] = uint32_t(i);
+  }
+  std::vector<std::pair<KeyT,uint32_t>> expected(count);
+  for (size_t i=0;i<count;i++)
+    expected[i] = { keys[i], values[i] };
+  std::stable_sort(expected.begin(),expected.end(),
+                   [](const std::pair<KeyT,uint32_t> &a, const std::pair<KeyT,uint32_t> &b)
+                   { return a.first < b.first; });
+
+  radixSort(keys.data(),values.data(),count,numKeyBits);
+  for (size_t i=0;i<count;i++) {
+    CHECK(keys[i]   == expected[i].first);
+    CHECK(values[i] == expected[i].second);
+  }
+}
+
+void testRadixSort()
+{
+  LOG("checking radix sort against std::stable_sort");
+  for (size_t count : { 0, 1, 2, 1000, 300000 }) {
+    for (int numKeyBits : { 1, 8, 11, 20, 33, 64 })
+      testRadixSort<uint64_t>(count,numKeyBits,int(count)+numKeyBits);
+    testRadixSort<uint32_t>(count,32,int(count));
+  }
+  // all keys the same: every pass gets skipped
+  std::vector<uint32_t> keys(100000,0x12345678u), values(keys.size());
+  for (size_t i=0;i<values.size();i++) values[i] = uint32_t(i);
+  radixSort(keys.data(),values.data(),keys.size());
+  for (size_t i=0;i<values.size();i++)
+    CHECK(keys[i] == 0x12345678u && values[i] == uint32_t(i));
+  LOG_OK("radix sort test passed");
+}
+
+// ==================================================================
+// ray reordering
+// ==================================================================
+
+/*! a soup of small random triangles in [-1,1]^3 */
+void createSoup(std::vector<vec3f> &vertices, std::vector<vec3i> &indices,
+                size_t numTriangles, float size, int seed)
+{
+  Random random(seed);
+  for (size_t i=0;i<numTriangles;i++) {
+    const vec3f center = random.point(-1.f,1.f);
+    const int base = int(vertices.size());
+    for (int k=0;k<3;k++)
+      vertices.push_back(center+random.point(-size,size));
+    indices.push_back(vec3i(base,base+1,base+2));
+  }
+}
+
+/*! what secondary rays look like: starting at random points on random
+    triangles, in random directions */
+std::vector<HostRay> secondaryRays(const TriangleMeshBVH &mesh, size_t numRays, int seed)
+{
+  Random random(seed);
+  std::uniform_int_distribution<size_t> whichTriangle(0,mesh.triangles.size()-1);
+  std::vector<HostRay> rays(numRays);
+  for (auto &ray : rays) {
+    const TriangleMeshBVH::Triangle &tri = mesh.triangles[whichTriangle(random.rng)];
+    float u = random(0.f,1.f), v = random(0.f,1.f);
+    if (u+v > 1.f) { u = 1.f-u; v = 1.f-v; }
+    ray = HostRay(tri.v0+u*(tri.v1-tri.v0)+v*(tri.v2-tri.v0),random.direction(),1e-4f);
+  }
+  return rays;
+}
+
+void traceAll(const TriangleMeshBVH &mesh, const HostRay *rays, HostHit *hits, size_t numRays)
+{
+  parallel_for_blocked(0,numRays,1024,[&](size_t begin, size_t end){
+      for (size_t i=begin;i<end;i++) {
+        HostRay ray = rays[i];
+        hits[i] = HostHit();
+        mesh.closestHit(ray,hits[i]);
+      }
+    });
+}
+
+bool sameHits(const std::vector<HostHit> &a, const std::vector<HostHit> &b)
+{
+  if (a.size() != b.size()) return false;
+  for (size_t i=0;i<a.size();i++)
+    if (a[i].primID != b[i].primID || a[i].u != b[i].u || a[i].v != b[i].v)
+      return false;
+  return true;
+}
+
+void testRayReorder()
+{
+  LOG("checking ray reordering");
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  createSoup(vertices,indices,20000,.05f,3);
+  TriangleMeshBVH mesh;
+  mesh.build(vertices.data(),indices.data(),indices.size());
+  const box3f sceneBounds = mesh.bvh.bounds();
+  std::vector<HostRay> rays = secondaryRays(mesh,100000,5);
+  // some origins outside the scene bounds, which get clamped
+  for (size_t i=0;i<rays.size();i+=10)
+    rays[i].origin = rays[i].origin*4.f;
+
+  RayReorder reorder;
+  reorder.compute(rays.data(),rays.size(),sceneBounds);
+  CHECK(reorder.size() == rays.size());
+
+  // a permutation, and one that sorts by the keys
+  std::vector<bool> seen(rays.size(),false);
+  const MortonQuantizer quantizer(sceneBounds,10);
+  uint64_t lastKey = 0;
+  for (size_t i=0;i<reorder.size();i++) {
+    const uint32_t rayID = reorder.permutation[i];
+    CHECK(rayID < rays.size() && !seen[rayID]);
+    seen[rayID] = true;
+    const uint64_t key
+      = rayCoherenceKey(quantizer,rays[rayID].origin,rays[rayID].direction);
+    CHECK(key >= lastKey);
+    lastKey = key;
+  }
+
+  // gather, trace, scatter == trace
+  std::vector<HostHit> hits(rays.size());
+  traceAll(mesh,rays.data(),hits.data(),rays.size());
+  std::vector<HostRay> sortedRays(rays.size());
+  std::vector<HostHit> sortedHits(rays.size()), scatteredHits(rays.size());
+  reorder.gather(sortedRays.data(),rays.data());
+  traceAll(mesh,sortedRays.data(),sortedHits.data(),rays.size());
+  reorder.scatter(scatteredHits.data(),sortedHits.data());
+  CHECK(sameHits(hits,scatteredHits));
+  size_t numHits = 0;
+  for (auto &hit : hits) numHits += (hit.primID >= 0);
+  CHECK(numHits > 0 && numHits < hits.size());
+
+  RayReorder empty;
+  empty.compute(nullptr,0,sceneBounds);
+  CHECK(empty.size() == 0);
+  LOG_OK("ray reordering test passed");
+}
+
+// ==================================================================
+// benchmark
+// ==================================================================
+
+std::string speedup(double before, double after)
+{
+  char text[32];
+  snprintf(text,sizeof(text),"%.2fx",before/after);
+  return text;
+}
+
+void benchmark(const TriangleMeshBVH &mesh, size_t numRays)
+{
+  const box3f sceneBounds = mesh.bvh.bounds();
+  std::vector<HostRay> rays = secondaryRays(mesh,numRays,int(numRays));
+  std::vector<HostHit> hits(numRays);
+  const double t0 = getCurrentTime();
+  traceAll(mesh,rays.data(),hits.data(),numRays);
+  const double t1 = getCurrentTime();
+
+  RayReorder reorder;
+  std::vector<HostRay> sortedRays(numRays);
+  std::vector<HostHit> sortedHits(numRays), scatteredHits(numRays);
+  const double t2 = getCurrentTime();
+  reorder.compute(rays.data(),numRays,sceneBounds);
+  reorder.gather(sortedRays.data(),rays.data());
+  const double t3 = getCurrentTime();
+  traceAll(mesh,sortedRays.data(),sortedHits.data(),numRays);
+  const double t4 = getCurrentTime();
+  reorder.scatter(scatteredHits.data(),sortedHits.data());
+  const double t5 = getCurrentTime();
+  CHECK(sameHits(hits,scatteredHits));
+
+  const double reorderTime = (t3-t2)+(t5-t4);
+  LOG_OK(prettyNumber(numRays) << " secondary rays: trace "
+         << prettyDouble(t1-t0) << "s unsorted, "
+         << prettyDouble(t4-t3) << "s sorted ("
+         << speedup(t1-t0,t4-t3) << "); reorder+gather+scatter "
+         << prettyDouble(reorderTime) << "s ("
+         << prettyDouble(numRays/reorderTime) << "rays/s); net "
+         << speedup(t1-t0,t4-t3+reorderTime));
+}
+
+int main(int ac, char **av)
+{
+  testRadixSort();
+  testRayReorder();
+
+  LOG("benchmarking on a soup of 1M triangles");
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  createSoup(vertices,indices,1000000,.01f,1);
+  TriangleMeshBVH mesh;
+  mesh.build(vertices.data(),indices.data(),indices.size());
+  for (size_t numRays : { 10000, 100000, 1000000 })
+    benchmark(mesh,numRays);
+  LOG_OK("all tests passed");
+  return 0;
+}
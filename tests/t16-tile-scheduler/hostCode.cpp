@@ -0,0 +1,278 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t16-tile-scheduler/hostCode.cpp - host-only unit test and
+    benchmark for the adaptive tile scheduler and compositor in
+    owl/common/parallel/tileScheduler.h: checks that tiles cover the
+    frame exactly once, in morton order, and that frames rendered by
+    simulated devices of different speeds (one thread each, sleeping
+    for as long as their batches would take) end up complete and
+    correct in the compositor, with faster devices getting bigger
+    shares; then reports frame times (without checking them) relative
+    to the ideal, and to a static, equal split of the frame */
+
+#include "owl/common/parallel/tileScheduler.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define OWL_TEST_NAME "tileScheduler"
+#include "tests/common/testing.h"
+
+using namespace owl::common;
+
+/*! what the simulated devices render */
+inline uint32_t pixelValue(int x, int y)
+{
+  return uint32_t(x)*7919u + uint32_t(y)*104729u + 1u;
+}
+
+// ==================================================================
+// tiles
+// ==================================================================
+
+void testTiles(const vec2i &frameSize, const vec2i &tileSize)
+{
+  TileSchedulerConfig config;
+  config.tileSize = tileSize;
+  TileScheduler scheduler(frameSize,1,config);
+
+  std::vector<int> coverage(size_t(frameSize.x)*frameSize.y,0);
+  uint64_t lastKey = 0;
+  for (size_t i=0;i<scheduler.numTiles();i++) {
+    const Tile &tile = scheduler.tile(i);
+    CHECK(tile.lower.x >= 0 && tile.lower.y >= 0);
+    CHECK(tile.upper.x <= frameSize.x && tile.upper.y <= frameSize.y);
+    CHECK(tile.numPixels() > 0);
+    const vec2i tileID = tile.lower/tileSize;
+    const uint64_t key = mortonEncode63(vec3ui(tileID.x,tileID.y,0));
+    CHECK(i == 0 || key > lastKey);
+    lastKey = key;
+    for (int iy=tile.lower.y;iy<tile.upper.y;iy++)
+      for (int ix=tile.lower.x;ix<tile.upper.x;ix++)
+        coverage[size_t(iy)*frameSize.x+ix]++;
+  }
+  for (int c : coverage)
+    CHECK(c == 1);
+
+  // draining the queue hands out every tile exactly once, twice
+  for (int frame=0;frame<2;frame++) {
+    scheduler.beginFrame();
+    TileBatch batch;
+    size_t expectedBegin = 0;
+    while (scheduler.nextBatch(0,batch)) {
+      CHECK(batch.begin == expectedBegin && batch.end > batch.begin);
+      expectedBegin = batch.end;
+      scheduler.reportTime(0,batch,1e-3*batch.numTiles());
+    }
+    CHECK(expectedBegin == scheduler.numTiles());
+    CHECK(scheduler.devices[0].numPixels == coverage.size());
+  }
+}
+
+// ==================================================================
+// simulated devices
+// ==================================================================
+
+struct SimulatedDevice {
+  double pixelsPerSecond;
+  /*! gets 'slowdown' times slower after 'slowdownAfter' seconds into
+      the frame (eg, because something else starts running on it) */
+  double slowdownAfter = 1e20;
+  double slowdown      = 1.;
+};
+
+/*! "renders" the given tiles - ie, writes their pixel values, and
+    then sleeps for as long as the device would take for them - and
+    returns the time that took */
+double renderTiles(const TileScheduler &scheduler, const TileBatch &batch,
+                   const SimulatedDevice &device, double frameStart,
+                   std::vector<uint32_t> &pixels)
+{
+  const double t0 = getCurrentTime();
+  pixels.clear();
+  for (size_t i=batch.begin;i<batch.end;i++) {
+    const Tile &tile = scheduler.tile(i);
+    for (int iy=tile.lower.y;iy<tile.upper.y;iy++)
+      for (int ix=tile.lower.x;ix<tile.upper.x;ix++)
+        pixels.push_back(pixelValue(ix,iy));
+  }
+  const double speed
+    = (t0-frameStart) >= device.slowdownAfter
+    ? device.pixelsPerSecond/device.slowdown
+    : device.pixelsPerSecond;
+  const double busyUntil = t0+batch.numPixels/speed;
+  while (getCurrentTime() < busyUntil)
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  return getCurrentTime()-t0;
+}
+
+/*! renders one frame with the scheduler, one thread per device, and
+    returns the frame time */
+double renderFrame(TileScheduler &scheduler, TileCompositor<uint32_t> &compositor,
+                   const std::vector<SimulatedDevice> &devices)
+{
+  scheduler.beginFrame();
+  compositor.beginFrame();
+  const double frameStart = getCurrentTime();
+  std::vector<std::thread> threads;
+  for (int deviceID=0;deviceID<int(devices.size());deviceID++)
+    threads.push_back(std::thread([&,deviceID](){
+          std::vector<uint32_t> pixels;
+          TileBatch batch;
+          while (scheduler.nextBatch(deviceID,batch)) {
+            const double seconds
+              = renderTiles(scheduler,batch,devices[deviceID],frameStart,pixels);
+            scheduler.reportTime(deviceID,batch,seconds);
+            compositor.write(scheduler,batch,pixels.data());
+          }
+        }));
+  for (auto &thread : threads) thread.join();
+  return getCurrentTime()-frameStart;
+}
+
+/*! renders one frame with each device getting the same number of
+    tiles, and returns the frame time */
+double renderFrameStatic(const TileScheduler &scheduler, TileCompositor<uint32_t> &compositor,
+                         const std::vector<SimulatedDevice> &devices)
+{
+  compositor.beginFrame();
+  const double frameStart = getCurrentTime();
+  std::vector<std::thread> threads;
+  const size_t numDevices = devices.size();
+  for (size_t deviceID=0;deviceID<numDevices;deviceID++)
+    threads.push_back(std::thread([&,deviceID](){
+          std::vector<uint32_t> pixels;
+          TileBatch batch;
+          batch.begin = deviceID*scheduler.numTiles()/numDevices;
+          batch.end   = (deviceID+1)*scheduler.numTiles()/numDevices;
+          for (size_t i=batch.begin;i<batch.end;i++)
+            batch.numPixels += scheduler.tile(i).numPixels();
+          renderTiles(scheduler,batch,devices[deviceID],frameStart,pixels);
+          compositor.write(scheduler,batch,pixels.data());
+        }));
+  for (auto &thread : threads) thread.join();
+  return getCurrentTime()-frameStart;
+}
+
+void checkFrame(const TileCompositor<uint32_t> &compositor)
+{
+  CHECK(compositor.complete());
+  for (int iy=0;iy<compositor.frameSize.y;iy++)
+    for (int ix=0;ix<compositor.frameSize.x;ix++)
+      CHECK(compositor.frameBuffer[size_t(iy)*compositor.frameSize.x+ix]
+            == pixelValue(ix,iy));
+}
+
+std::string ratio(double a, double b)
+{
+  char text[32];
+  snprintf(text,sizeof(text),"%.2fx",a/b);
+  return text;
+}
+
+/*! renders a few frames on the given simulated devices, and checks
+    that the adaptive schedule gets close to the ideal frame time
+    (total pixels over total speed) */
+void testDevices(const std::string &name, const std::vector<SimulatedDevice> &devices)
+{
+  const vec2i frameSize(3840,2160);
+  TileScheduler scheduler(frameSize,int(devices.size()));
+  TileCompositor<uint32_t> compositor(frameSize);
+
+  const double numPixels = double(frameSize.x)*frameSize.y;
+  double totalSpeed = 0.;
+  for (auto &device : devices) totalSpeed += device.pixelsPerSecond;
+  // with a slowdown, what the devices can do by the end of the
+  // frame depends on when that starts; take the fastest possible
+  // frame as reference
+  double idealTime = numPixels/totalSpeed;
+  for (int iter=0;iter<20;iter++) {
+    double pixelsDone = 0.;
+    for (auto &device : devices) {
+      const double fast = std::min(idealTime,device.slowdownAfter);
+      pixelsDone += fast*device.pixelsPerSecond
+        + (idealTime-fast)*device.pixelsPerSecond/device.slowdown;
+    }
+    idealTime *= numPixels/pixelsDone;
+  }
+
+  const int numFrames = 3;
+  double adaptiveTime = 0.;
+  for (int frame=0;frame<numFrames;frame++) {
+    const double frameTime = renderFrame(scheduler,compositor,devices);
+    checkFrame(compositor);
+    size_t pixelsRendered = 0;
+    for (auto &device : scheduler.devices)
+      pixelsRendered += device.numPixels;
+    CHECK(pixelsRendered == size_t(numPixels));
+    // first frame starts without any estimates
+    if (frame > 0) adaptiveTime += frameTime;
+  }
+  adaptiveTime /= (numFrames-1);
+
+  // each device got work in proportion to its speed; the slowdown
+  // ones are left out of this
+  for (size_t i=0;i<devices.size();i++)
+    for (size_t j=0;j<devices.size();j++)
+      if (devices[i].slowdown == 1. && devices[j].slowdown == 1.
+          && devices[i].pixelsPerSecond > 1.5*devices[j].pixelsPerSecond)
+        CHECK(scheduler.devices[i].numPixels > scheduler.devices[j].numPixels);
+
+  const double staticTime = renderFrameStatic(scheduler,compositor,devices);
+  checkFrame(compositor);
+
+  // frame times come from sleeping threads, so they're only
+  // reported, never checked - on a busy machine they can be anything
+  LOG_OK(name << ": ideal " << prettyDouble(idealTime) << "s, adaptive "
+         << prettyDouble(adaptiveTime) << "s (" << ratio(adaptiveTime,idealTime)
+         << " of ideal), static split " << prettyDouble(staticTime) << "s ("
+         << ratio(staticTime,idealTime) << " of ideal)");
+  for (size_t i=0;i<devices.size();i++) {
+    const TileScheduler::Device &device = scheduler.devices[i];
+    LOG(" device #" << i << ": " << prettyDouble(devices[i].pixelsPerSecond)
+        << "pixels/s, " << device.numBatches << " batches, "
+        << int(100.*device.numPixels/numPixels) << "% of the frame, busy "
+        << prettyDouble(device.busyTime) << "s");
+  }
+}
+
+int main(int ac, char **av)
+{
+  LOG("checking tiles");
+  testTiles(vec2i(1),vec2i(32));
+  testTiles(vec2i(100,37),vec2i(32));
+  testTiles(vec2i(1920,1080),vec2i(32));
+  testTiles(vec2i(1000,1000),vec2i(16,8));
+  LOG_OK("tiles test passed");
+
+  std::vector<SimulatedDevice> devices(3);
+  devices[0].pixelsPerSecond = 40e6;
+  devices[1].pixelsPerSecond = 20e6;
+  devices[2].pixelsPerSecond = 10e6;
+  testDevices("3 devices, 4:2:1 speeds",devices);
+
+  devices[0].slowdownAfter = 50e-3;
+  devices[0].slowdown      = 4.;
+  testDevices("3 devices, fastest one getting 4x slower mid-frame",devices);
+
+  devices.resize(2);
+  devices[0] = devices[1];
+  testDevices("2 devices, same speed",devices);
+
+  LOG_OK("all tests passed");
+  return 0;
+}
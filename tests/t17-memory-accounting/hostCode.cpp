@@ -0,0 +1,392 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t17-memory-accounting/hostCode.cpp - host-only test and
+    benchmark for the per-device memory accounting
+    (owlContextGetMemoryUsage() and friends, owl/MemoryTracker.h): on
+    two null devices, checks what buffers, accel builds (including
+    their temp memory peaks), SBT and launch params add up to per
+    category, that releasing things gives the memory back, that a
+    budget makes allocations fail before they happen (with a report
+    that says why), and what the JSON report contains; then measures
+    what tracking costs per allocation */
+
+#include "owl/owl_host.h"
+#include "owl/APIHandle.h"
+#include "owl/APIContext.h"
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#define OWL_TEST_NAME "memoryAccounting"
+#include "tests/common/testing.h"
+
+using namespace owl;
+using namespace owl::common;
+
+/*! nothing ever compiles this on a null device, but the module still
+    needs some 'ptx' to be created from */
+const char *dummyPTX = "// null device test; no actual device code\n";
+
+struct TrianglesGeomData {
+  vec3f *vertex;
+  vec3i *index;
+};
+
+struct RayGenData {
+  OptixTraversableHandle world;
+};
+
+struct LaunchParamsData {
+  int                    accumID;
+  OptixTraversableHandle world;
+};
+
+size_t current(OWLContext owl, int deviceID, OWLMemoryCategory category)
+{
+  size_t value = 0;
+  owlContextGetMemoryUsage(owl,deviceID,category,&value,nullptr);
+  return value;
+}
+
+size_t peak(OWLContext owl, int deviceID, OWLMemoryCategory category)
+{
+  size_t value = 0;
+  owlContextGetMemoryUsage(owl,deviceID,category,nullptr,&value);
+  return value;
+}
+
+/*! checks that the categories add up to the total */
+void checkTotals(OWLContext owl)
+{
+  for (int d=0;d<owlGetDeviceCount(owl);d++) {
+    size_t sum = 0;
+    for (int c=0;c<OWL_MEMORY_NUM_CATEGORIES;c++) {
+      sum += current(owl,d,(OWLMemoryCategory)c);
+      CHECK(peak(owl,d,(OWLMemoryCategory)c) >= current(owl,d,(OWLMemoryCategory)c));
+    }
+    CHECK(sum == current(owl,d,OWL_MEMORY_ALL));
+  }
+}
+
+/*! runs 'f', and returns the message of the std::runtime_error it
+    throws; fails if it doesn't throw */
+template<typename Lambda>
+std::string expectThrow(const Lambda &f)
+{
+  try {
+    f();
+  } catch (const std::runtime_error &e) {
+    return e.what();
+  }
+  CHECK(!"expected an exception");
+  return "";
+}
+
+bool contains(const std::string &s, const std::string &what)
+{
+  return s.find(what) != std::string::npos;
+}
+
+/*! a soup of random triangles, as one triangles geom */
+OWLGeom createSoup(OWLContext owl, OWLGeomType geomType, size_t numTriangles, int seed)
+{
+  Random random(seed);
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  for (size_t i=0;i<numTriangles;i++) {
+    const vec3f center = random.point(-1.f,1.f);
+    for (int k=0;k<3;k++)
+      vertices.push_back(center+random.point(-.1f,.1f));
+    indices.push_back(vec3i(3*int(i))+vec3i(0,1,2));
+  }
+  OWLBuffer vertexBuffer
+    = owlDeviceBufferCreate(owl,OWL_FLOAT3,vertices.size(),vertices.data());
+  OWLBuffer indexBuffer
+    = owlDeviceBufferCreate(owl,OWL_INT3,indices.size(),indices.data());
+  OWLGeom geom = owlGeomCreate(owl,geomType);
+  owlTrianglesSetVertices(geom,vertexBuffer,vertices.size(),sizeof(vec3f),0);
+  owlTrianglesSetIndices(geom,indexBuffer,indices.size(),sizeof(vec3i),0);
+  owlGeomSetBuffer(geom,"vertex",vertexBuffer);
+  owlGeomSetBuffer(geom,"index",indexBuffer);
+  return geom;
+}
+
+void testAccounting()
+{
+  LOG("checking memory accounting on two null devices");
+  int deviceIDs[2] = { OWL_NULL_DEVICE, OWL_NULL_DEVICE };
+  OWLContext owl = owlContextCreate(deviceIDs,2);
+  for (int d=0;d<2;d++)
+    CHECK(current(owl,d,OWL_MEMORY_ALL) == 0);
+
+  // ------------------------------------------------------------------
+  // buffers
+  // ------------------------------------------------------------------
+  std::vector<float> values(1000,1.f);
+  OWLBuffer deviceBuffer
+    = owlDeviceBufferCreate(owl,OWL_FLOAT,values.size(),values.data());
+  for (int d=0;d<2;d++) {
+    CHECK(current(owl,d,OWL_MEMORY_BUFFER) == values.size()*sizeof(float));
+    CHECK(current(owl,d,OWL_MEMORY_ALL) == values.size()*sizeof(float));
+  }
+  owlBufferResize(deviceBuffer,2*values.size());
+  for (int d=0;d<2;d++) {
+    CHECK(current(owl,d,OWL_MEMORY_BUFFER) == 2*values.size()*sizeof(float));
+    CHECK(peak(owl,d,OWL_MEMORY_BUFFER) == 2*values.size()*sizeof(float));
+  }
+  // managed memory is shared, and only counts on device 0
+  OWLBuffer managedBuffer
+    = owlManagedMemoryBufferCreate(owl,OWL_FLOAT,values.size(),values.data());
+  CHECK(current(owl,0,OWL_MEMORY_BUFFER) == 3*values.size()*sizeof(float));
+  CHECK(current(owl,1,OWL_MEMORY_BUFFER) == 2*values.size()*sizeof(float));
+  owlBufferRelease(deviceBuffer);
+  CHECK(current(owl,0,OWL_MEMORY_BUFFER) == values.size()*sizeof(float));
+  CHECK(current(owl,1,OWL_MEMORY_BUFFER) == 0);
+  CHECK(peak(owl,1,OWL_MEMORY_BUFFER) == 2*values.size()*sizeof(float));
+  owlContextResetMemoryPeaks(owl);
+  CHECK(peak(owl,1,OWL_MEMORY_BUFFER) == 0);
+  checkTotals(owl);
+
+  // ------------------------------------------------------------------
+  // accels
+  // ------------------------------------------------------------------
+  OWLModule module = owlModuleCreate(owl,dummyPTX);
+  OWLVarDecl trianglesGeomVars[] = {
+    { "vertex", OWL_BUFPTR, OWL_OFFSETOF(TrianglesGeomData,vertex)},
+    { "index",  OWL_BUFPTR, OWL_OFFSETOF(TrianglesGeomData,index)},
+    { /* sentinel to mark end of list */ }
+  };
+  OWLGeomType trianglesGeomType
+    = owlGeomTypeCreate(owl,OWL_TRIANGLES,sizeof(TrianglesGeomData),
+                        trianglesGeomVars,-1);
+  owlGeomTypeSetClosestHit(trianglesGeomType,0,module,"TriangleMesh");
+
+  OWLGeom geoms[2] = {
+    createSoup(owl,trianglesGeomType,1000,1),
+    createSoup(owl,trianglesGeomType,3000,2)
+  };
+  const size_t buffersBefore = current(owl,0,OWL_MEMORY_BUFFER);
+  OWLGroup meshGroup = owlTrianglesGeomGroupCreate(owl,2,geoms);
+  owlGroupBuildAccel(meshGroup);
+  size_t meshFinal = 0, meshPeak = 0;
+  owlGroupGetAccelSize(meshGroup,&meshFinal,&meshPeak);
+  CHECK(meshFinal > 0 && meshPeak > meshFinal);
+  for (int d=0;d<2;d++) {
+    // what the group itself reports, only broken down
+    CHECK(current(owl,d,OWL_MEMORY_ACCEL) == meshFinal);
+    CHECK(current(owl,d,OWL_MEMORY_ACCEL_TEMP) == 0);
+    CHECK(peak(owl,d,OWL_MEMORY_ACCEL_TEMP) == meshPeak-meshFinal);
+    CHECK(peak(owl,d,OWL_MEMORY_ACCEL) == meshFinal);
+  }
+  // peak includes what was there before the build (temp and
+  // uncompacted output were alive at the same time as the compacted
+  // output)
+  CHECK(peak(owl,0,OWL_MEMORY_ALL) == buffersBefore+meshPeak);
+
+  // another group, that nothing refers to, goes away on release
+  OWLGroup otherGroup = owlTrianglesGeomGroupCreate(owl,1,geoms);
+  owlGroupBuildAccel(otherGroup);
+  for (int d=0;d<2;d++)
+    CHECK(current(owl,d,OWL_MEMORY_ACCEL) > meshFinal);
+  owlGroupRelease(otherGroup);
+  for (int d=0;d<2;d++)
+    CHECK(current(owl,d,OWL_MEMORY_ACCEL) == meshFinal);
+
+  OWLGroup world = owlInstanceGroupCreate(owl,3);
+  for (int i=0;i<3;i++)
+    owlInstanceGroupSetChild(world,i,meshGroup);
+  owlGroupBuildAccel(world);
+  size_t worldFinal = 0;
+  owlGroupGetAccelSize(world,&worldFinal,nullptr);
+  for (int d=0;d<2;d++) {
+    // plus the list of instances
+    CHECK(current(owl,d,OWL_MEMORY_ACCEL) == meshFinal+worldFinal+3*sizeof(OptixInstance));
+    CHECK(current(owl,d,OWL_MEMORY_ACCEL_TEMP) == 0);
+  }
+  checkTotals(owl);
+
+  // ------------------------------------------------------------------
+  // SBT and launch params
+  // ------------------------------------------------------------------
+  OWLVarDecl rayGenVars[] = {
+    { "world", OWL_GROUP, OWL_OFFSETOF(RayGenData,world)},
+    { /* sentinel to mark end of list */ }
+  };
+  OWLRayGen rayGen
+    = owlRayGenCreate(owl,module,"simpleRayGen",
+                      sizeof(RayGenData),rayGenVars,-1);
+  owlRayGenSetGroup(rayGen,"world",world);
+  owlMissProgCreate(owl,module,"miss",0,nullptr,0);
+  OWLVarDecl launchParamsVars[] = {
+    { "accumID", OWL_INT,   OWL_OFFSETOF(LaunchParamsData,accumID)},
+    { "world",   OWL_GROUP, OWL_OFFSETOF(LaunchParamsData,world)},
+    { /* sentinel to mark end of list */ }
+  };
+  OWLParams params
+    = owlParamsCreate(owl,sizeof(LaunchParamsData),launchParamsVars,-1);
+  owlParamsSetGroup(params,"world",world);
+  owlBuildPrograms(owl);
+  owlBuildPipeline(owl);
+  owlBuildSBT(owl);
+  owlLaunch2D(rayGen,16,16,params);
+
+  APIContext::SP context = ((APIHandle *)owl)->getContext();
+  for (int d=0;d<2;d++) {
+    const SBT &sbt = context->getDevice(d)->sbt;
+    CHECK(current(owl,d,OWL_MEMORY_SBT)
+          == sbt.hitGroupRecordsBuffer.size()
+          +  sbt.missProgRecordsBuffer.size()
+          +  OPTIX_SBT_RECORD_HEADER_SIZE
+          +  smallestMultipleOf<OPTIX_SBT_RECORD_ALIGNMENT>(sizeof(RayGenData)));
+    CHECK(current(owl,d,OWL_MEMORY_LAUNCH_PARAMS) == sizeof(LaunchParamsData));
+  }
+  // rebuilding the SBT replaces the old tables, rather than adding to
+  // them
+  const size_t sbtBytes = current(owl,0,OWL_MEMORY_SBT);
+  owlBuildSBT(owl);
+  CHECK(current(owl,0,OWL_MEMORY_SBT) == sbtBytes);
+  checkTotals(owl);
+
+  // ------------------------------------------------------------------
+  // budget
+  // ------------------------------------------------------------------
+  const size_t used[2] = {
+    current(owl,0,OWL_MEMORY_ALL), current(owl,1,OWL_MEMORY_ALL)
+  };
+  // the budget is on what allocations take up once rounded to the
+  // pool's size classes; and the pool's cache counts, too, so
+  // release that to have the budget be all about what's in use
+  owlContextReleaseCachedMemory(owl);
+  size_t reserved[2];
+  for (int d=0;d<2;d++) {
+    reserved[d] = context->getDevice(d)->memoryTracker.reserved();
+    CHECK(reserved[d] >= used[d]);
+  }
+  owlContextSetMemoryBudget(owl,-1,std::max(reserved[0],reserved[1])+1000);
+  std::string message = expectThrow([&](){
+      owlDeviceBufferCreate(owl,OWL_FLOAT,2000,nullptr);
+    });
+  LOG("buffer over budget: " << message);
+  CHECK(contains(message,"device #0") && contains(message,"budget")
+        && contains(message,"of buffer memory") && contains(message,"accel:"));
+  for (int d=0;d<2;d++)
+    CHECK(current(owl,d,OWL_MEMORY_ALL) == used[d]);
+  // small enough to fit
+  OWLBuffer smallBuffer = owlDeviceBufferCreate(owl,OWL_FLOAT,100,nullptr);
+  owlBufferRelease(smallBuffer);
+
+  // a rebuild needs temp and uncompacted output memory on top of
+  // what's there already
+  owlContextSetMemoryBudget(owl,1,reserved[1]+1);
+  owlContextSetMemoryBudget(owl,0,0);
+  message = expectThrow([&](){ owlGroupBuildAccel(meshGroup); });
+  LOG("accel rebuild over budget: " << message);
+  CHECK(contains(message,"device #1") && contains(message,"of accelTemp memory"));
+  // the failed build's temp memory got freed again
+  for (int d=0;d<2;d++)
+    CHECK(current(owl,d,OWL_MEMORY_ACCEL_TEMP) == 0);
+  CHECK(current(owl,1,OWL_MEMORY_ALL) <= used[1]);
+  owlContextSetMemoryBudget(owl,1,0);
+  owlGroupBuildAccel(meshGroup);
+  owlGroupBuildAccel(world);
+  for (int d=0;d<2;d++)
+    CHECK(current(owl,d,OWL_MEMORY_ALL) == used[d]);
+  checkTotals(owl);
+
+  // ------------------------------------------------------------------
+  // JSON report
+  // ------------------------------------------------------------------
+  owlContextSetMemoryBudget(owl,1,12345678);
+  const std::string fileName = "owl-t17-memory-report.json";
+  owlContextWriteMemoryReport(owl,fileName.c_str());
+  std::ifstream in(fileName);
+  std::stringstream json;
+  json << in.rdbuf();
+  std::remove(fileName.c_str());
+  const std::string report = json.str();
+  std::stringstream device1;
+  device1 << "{\"deviceID\":1,\"budget\":12345678,\"current\":" << used[1]
+          << ",\"reserved\":" << context->getDevice(1)->memoryTracker.reserved()
+          << ",\"peak\":" << peak(owl,1,OWL_MEMORY_ALL);
+  CHECK(contains(report,"{\"devices\":["));
+  CHECK(contains(report,"{\"deviceID\":0,\"budget\":0,"));
+  CHECK(contains(report,device1.str()));
+  std::stringstream accel;
+  accel << "\"accel\":{\"current\":" << current(owl,1,OWL_MEMORY_ACCEL);
+  CHECK(contains(report,accel.str()));
+  int depth = 0;
+  for (char c : report) {
+    depth += (c == '{' || c == '[') - (c == '}' || c == ']');
+    CHECK(depth >= 0);
+  }
+  CHECK(depth == 0);
+
+  // invalid devices and categories
+  expectThrow([&](){ current(owl,2,OWL_MEMORY_ALL); });
+  expectThrow([&](){ current(owl,0,(OWLMemoryCategory)42); });
+
+  owlBufferRelease(managedBuffer);
+  owlContextDestroy(owl);
+  LOG_OK("memory accounting test passed");
+}
+
+// ==================================================================
+// benchmark
+// ==================================================================
+
+/*! average time for one alloc/free pair of a DeviceMemory on a null
+    device, with or without a tracker */
+double timeAllocFree(MemoryTracker *tracker, size_t numPairs)
+{
+  detail::activeDeviceIsNull()  = true;
+  detail::activeMemoryTracker() = tracker;
+  std::vector<DeviceMemory> mems(64);
+  const double t0 = getCurrentTime();
+  for (size_t i=0;i<numPairs;i++) {
+    DeviceMemory &mem = mems[i%mems.size()];
+    mem.alloc(256+(i%7)*64,OWL_MEMORY_BUFFER);
+    mem.free();
+  }
+  const double t1 = getCurrentTime();
+  detail::activeDeviceIsNull()  = false;
+  detail::activeMemoryTracker() = nullptr;
+  return (t1-t0)/numPairs;
+}
+
+void benchmark()
+{
+  LOG("measuring the cost of tracking, per allocation");
+  const size_t numPairs = 2000000;
+  MemoryTracker tracker(0);
+  // warm up
+  timeAllocFree(&tracker,numPairs/10);
+  const double untracked = timeAllocFree(nullptr,numPairs);
+  const double tracked   = timeAllocFree(&tracker,numPairs);
+  CHECK(tracker.current(OWL_MEMORY_ALL) == 0);
+  LOG_OK("alloc+free of host memory: " << prettyDouble(untracked) << "s untracked, "
+         << prettyDouble(tracked) << "s tracked (+"
+         << prettyDouble(tracked-untracked) << "s per allocation)");
+}
+
+int main(int ac, char **av)
+{
+  testAccounting();
+  benchmark();
+  LOG_OK("all tests passed");
+  return 0;
+}
@@ -0,0 +1,549 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file t18-caching-allocator/hostCode.cpp - host-only test and
+    benchmark for the size-class caching allocator that device memory
+    comes from (owl/DeviceAllocator.h): over a fake backing allocator
+    (that hands out made-up addresses, and can run out of memory),
+    checks size classes, re-use, the hit rate and fragmentation
+    counters, the cache limit, releasing the cache when running out of
+    memory, and a random alloc/free stress run; then checks that on
+    null devices, rebuilding accels and the SBT gets served from the
+    pool, and that memory budgets count (and release) what the pool
+    holds on to; and finally measures what the pool saves on an accel-rebuild
+    like alloc/free pattern when every backing allocation is slow (as
+    cudaMalloc is) */
+
+#include "owl/owl_host.h"
+#include "owl/APIHandle.h"
+#include "owl/APIContext.h"
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#define OWL_TEST_NAME "cachingAllocator"
+#include "tests/common/testing.h"
+
+using namespace owl;
+using namespace owl::common;
+
+/*! a backing allocator that hands out made-up (never dereferenced)
+    addresses, remembers what's live, runs out of memory past its
+    capacity, and can make every call take a while, like cudaMalloc
+    and cudaFree do */
+struct FakeAllocator : public DeviceAllocator {
+  typedef std::shared_ptr<FakeAllocator> SP;
+
+  FakeAllocator(size_t capacity = size_t(-1), double latency = 0.)
+    : capacity(capacity), latency(latency)
+  {}
+
+  void *allocate(size_t size) override
+  {
+    wait();
+    numAllocs++;
+    if (size == 0 || liveBytes+size > capacity) return nullptr;
+    void *ptr = (void *)nextAddress;
+    nextAddress += smallestMultipleOf<256>(size);
+    live[ptr] = size;
+    liveBytes += size;
+    return ptr;
+  }
+
+  void free(void *ptr) override
+  {
+    if (!ptr) return;
+    wait();
+    numFrees++;
+    auto it = live.find(ptr);
+    CHECK(it != live.end());
+    liveBytes -= it->second;
+    live.erase(it);
+  }
+
+  void wait() const
+  {
+    if (latency == 0.) return;
+    const double t0 = getCurrentTime();
+    while (getCurrentTime()-t0 < latency);
+  }
+
+  const size_t capacity;
+  const double latency;
+  size_t    nextAddress = 0x10000;
+  size_t    liveBytes   = 0;
+  size_t    numAllocs   = 0;
+  size_t    numFrees    = 0;
+  std::map<void *,size_t> live;
+};
+
+/*! a pool over a fake allocator */
+CachingAllocator::SP createPool(FakeAllocator::SP backing,
+                                size_t maxCachedBytes = size_t(256)<<20)
+{
+  CachingAllocatorConfig config;
+  config.maxCachedBytes = maxCachedBytes;
+  return std::make_shared<CachingAllocator>(backing,config);
+}
+
+bool contains(const std::string &s, const std::string &what)
+{
+  return s.find(what) != std::string::npos;
+}
+
+void testSizeClasses()
+{
+  LOG("checking size classes");
+  CachingAllocator::SP pool = createPool(std::make_shared<FakeAllocator>());
+  const CachingAllocatorConfig config;
+  CHECK(pool->sizeClassOf(1) == config.minBlockSize);
+  CHECK(pool->sizeClassOf(config.minBlockSize) == config.minBlockSize);
+  size_t prevClass = 0;
+  std::set<size_t> classes;
+  for (size_t size=1;size<(size_t(1)<<20);size+=1+size/64) {
+    const size_t sizeClass = pool->sizeClassOf(size);
+    CHECK(sizeClass >= size);
+    CHECK(sizeClass >= prevClass);
+    // with four classes per power of two, rounding up never wastes a
+    // quarter of what got asked for
+    if (size > config.minBlockSize)
+      CHECK(4*(sizeClass-size) < size);
+    // a class is its own class
+    CHECK(pool->sizeClassOf(sizeClass) == sizeClass);
+    prevClass = sizeClass;
+    classes.insert(sizeClass);
+  }
+  // 512 .. 1M: 11 powers of two, 4 classes each, plus 1M itself
+  CHECK(classes.size() == 4*11+1);
+  CHECK(pool->sizeClassOf(1000)  == 1024);
+  CHECK(pool->sizeClassOf(1025)  == 1280);
+  CHECK(pool->sizeClassOf(5000)  == 5120);
+  LOG_OK("size classes passed");
+}
+
+void testReuse()
+{
+  LOG("checking re-use, hit rate and fragmentation");
+  FakeAllocator::SP backing = std::make_shared<FakeAllocator>();
+  CachingAllocator::SP pool = createPool(backing);
+  CHECK(pool->allocate(0) == nullptr);
+
+  void *a = pool->allocate(1000);
+  CHECK(a && backing->numAllocs == 1 && backing->live[a] == 1024);
+  pool->free(a);
+  CHECK(backing->numFrees == 0);
+  CHECK(pool->getStats().bytesCached == 1024);
+
+  // same class: same block, and no call to the backing allocator
+  void *b = pool->allocate(900);
+  CHECK(b == a && backing->numAllocs == 1);
+  // different class: a new one
+  void *c = pool->allocate(2000);
+  CHECK(c != a && backing->numAllocs == 2);
+
+  CachingAllocatorStats stats = pool->getStats();
+  CHECK(stats.numAllocs == 3 && stats.numHits == 1 && stats.numMisses == 2);
+  CHECK(stats.numBackingAllocs == 2 && stats.numFrees == 1);
+  CHECK(stats.bytesRequested == 900+2000);
+  CHECK(stats.bytesInUse == 1024+2048);
+  CHECK(stats.bytesCached == 0);
+  CHECK(stats.peakBytesReserved == 1024+2048);
+  CHECK(std::abs(stats.hitRate()-1./3.) < 1e-9);
+  CHECK(std::abs(stats.fragmentation()-(1.-2900./3072.)) < 1e-9);
+
+  const std::string json = pool->toJSON();
+  CHECK(contains(json,"\"numHits\":1") && contains(json,"\"hitRate\":")
+        && contains(json,"\"fragmentation\":") && contains(json,"\"bytesInUse\":3072"));
+
+  pool->free(b);
+  pool->free(c);
+  CHECK(pool->getStats().bytesCached == 1024+2048);
+  CHECK(backing->liveBytes == 1024+2048);
+  pool->releaseCached();
+  CHECK(pool->getStats().bytesCached == 0);
+  CHECK(backing->liveBytes == 0 && backing->numFrees == 2);
+
+  // something the pool didn't allocate goes straight back
+  void *foreign = backing->allocate(100);
+  pool->free(foreign);
+  CHECK(backing->live.empty());
+  CHECK(pool->getStats().numFrees == 3);
+  LOG_OK("re-use passed");
+}
+
+void testCacheLimit()
+{
+  LOG("checking the cache limit");
+  FakeAllocator::SP backing = std::make_shared<FakeAllocator>();
+  CachingAllocator::SP pool = createPool(backing,4096);
+  std::vector<void *> blocks;
+  for (int i=0;i<4;i++)
+    blocks.push_back(pool->allocate(1024));
+  // bigger than the whole cache: can never be kept
+  blocks.push_back(pool->allocate(8192));
+  for (auto block : blocks)
+    pool->free(block);
+  CachingAllocatorStats stats = pool->getStats();
+  CHECK(stats.bytesCached == 4096);
+  CHECK(stats.numBackingFrees == 1);
+  CHECK(backing->liveBytes == 4096);
+
+  // a free that goes over the limit releases the largest blocks
+  void *big = pool->allocate(3000);
+  CHECK(backing->liveBytes == 4096+3072);
+  pool->free(big);
+  CHECK(pool->getStats().bytesCached <= 4096);
+  CHECK(backing->live.size() == 4 && backing->liveBytes == 4096);
+
+  // lowering the limit releases right away
+  pool->setMaxCachedBytes(2048);
+  CHECK(pool->getStats().bytesCached == 2048);
+  CHECK(backing->liveBytes == 2048);
+
+  // a limit of 0 turns caching off
+  pool->setMaxCachedBytes(0);
+  CHECK(backing->liveBytes == 0);
+  const size_t backingAllocs = backing->numAllocs;
+  for (int i=0;i<10;i++)
+    pool->free(pool->allocate(1000));
+  CHECK(backing->numAllocs == backingAllocs+10);
+  CHECK(backing->liveBytes == 0);
+  CHECK(pool->getStats().numHits == 0);
+  LOG_OK("cache limit passed");
+}
+
+void testPressure()
+{
+  LOG("checking releasing the cache when out of memory");
+  FakeAllocator::SP backing = std::make_shared<FakeAllocator>(8192);
+  CachingAllocator::SP pool = createPool(backing);
+  pool->free(pool->allocate(4096));
+  CHECK(pool->getStats().bytesCached == 4096);
+
+  // doesn't fit next to what's cached, but does once that's released
+  void *a = pool->allocate(6000);
+  CHECK(a);
+  CachingAllocatorStats stats = pool->getStats();
+  CHECK(stats.numPressureReleases == 1);
+  CHECK(stats.bytesCached == 0);
+  CHECK(stats.bytesInUse == 6144);
+
+  // nothing left to release: really out of memory
+  CHECK(pool->allocate(4096) == nullptr);
+  CHECK(pool->getStats().numPressureReleases == 1);
+  bool threw = false;
+  try {
+    detail::allocateOrThrow(pool.get(),4096);
+  } catch (const std::runtime_error &e) {
+    threw = contains(e.what(),"out of device memory");
+  }
+  CHECK(threw);
+  CHECK(pool->getStats().bytesInUse == 6144);
+  pool->free(a);
+  LOG_OK("out of memory passed");
+}
+
+void testStress()
+{
+  LOG("random alloc/free stress test");
+  FakeAllocator::SP backing = std::make_shared<FakeAllocator>(size_t(64)<<20);
+  const size_t maxCachedBytes = size_t(8)<<20;
+  CachingAllocator::SP pool = createPool(backing,maxCachedBytes);
+  Random random(0x18);
+  std::map<void *,size_t> live;
+  size_t numFailed = 0;
+  for (int step=0;step<20000;step++) {
+    if (live.empty() || random(0.f,1.f) < .55f) {
+      // mostly small, some large
+      const size_t size
+        = random(0.f,1.f) < .9f
+        ? random.size(1,64<<10)
+        : random.size(64<<10,4<<20);
+      void *ptr = pool->allocate(size);
+      if (!ptr) { numFailed++; continue; }
+      CHECK(live.find(ptr) == live.end());
+      live[ptr] = size;
+    } else {
+      auto it = live.begin();
+      std::advance(it,random.size(0,live.size()-1));
+      pool->free(it->first);
+      live.erase(it);
+    }
+    const CachingAllocatorStats stats = pool->getStats();
+    size_t requested = 0, inUse = 0;
+    for (auto &block : live) {
+      requested += block.second;
+      inUse     += pool->sizeClassOf(block.second);
+    }
+    CHECK(stats.bytesRequested == requested);
+    CHECK(stats.bytesInUse == inUse);
+    CHECK(stats.bytesCached <= maxCachedBytes);
+    CHECK(backing->liveBytes == stats.bytesInUse+stats.bytesCached);
+    CHECK(stats.peakBytesReserved <= backing->capacity);
+    CHECK(stats.numHits+stats.numMisses == stats.numAllocs);
+  }
+  const CachingAllocatorStats stats = pool->getStats();
+  char hitRate[20], fragmentation[20];
+  snprintf(hitRate,sizeof(hitRate),"%.2f",stats.hitRate());
+  snprintf(fragmentation,sizeof(fragmentation),"%.2f",stats.fragmentation());
+  LOG("after " << stats.numAllocs << " allocations: hit rate " << hitRate
+      << ", fragmentation " << fragmentation
+      << ", " << numFailed << " out of memory, "
+      << stats.numPressureReleases << " pressure releases");
+  CHECK(stats.numHits > 0 && stats.numPressureReleases > 0);
+  CHECK(stats.fragmentation() < .25);
+
+  for (auto &block : live)
+    pool->free(block.first);
+  pool->releaseCached();
+  CHECK(backing->live.empty());
+  LOG_OK("stress test passed");
+}
+
+// ------------------------------------------------------------------
+// the pool, as used by owl itself
+// ------------------------------------------------------------------
+
+/*! nothing ever compiles this on a null device, but the module still
+    needs some 'ptx' to be created from */
+const char *dummyPTX = "// null device test; no actual device code\n";
+
+struct TrianglesGeomData {
+  vec3f *vertex;
+  vec3i *index;
+};
+
+struct RayGenData {
+  OptixTraversableHandle world;
+};
+
+/*! a soup of random triangles, as one triangles geom */
+OWLGeom createSoup(OWLContext owl, OWLGeomType geomType, size_t numTriangles, int seed)
+{
+  Random random(seed);
+  std::vector<vec3f> vertices;
+  std::vector<vec3i> indices;
+  for (size_t i=0;i<numTriangles;i++) {
+    const vec3f center = random.point(-1.f,1.f);
+    for (int k=0;k<3;k++)
+      vertices.push_back(center+random.point(-.1f,.1f));
+    indices.push_back(vec3i(3*int(i))+vec3i(0,1,2));
+  }
+  OWLBuffer vertexBuffer
+    = owlDeviceBufferCreate(owl,OWL_FLOAT3,vertices.size(),vertices.data());
+  OWLBuffer indexBuffer
+    = owlDeviceBufferCreate(owl,OWL_INT3,indices.size(),indices.data());
+  OWLGeom geom = owlGeomCreate(owl,geomType);
+  owlTrianglesSetVertices(geom,vertexBuffer,vertices.size(),sizeof(vec3f),0);
+  owlTrianglesSetIndices(geom,indexBuffer,indices.size(),sizeof(vec3i),0);
+  owlGeomSetBuffer(geom,"vertex",vertexBuffer);
+  owlGeomSetBuffer(geom,"index",indexBuffer);
+  return geom;
+}
+
+void testContext()
+{
+  LOG("checking accel and SBT rebuilds on two null devices");
+  int deviceIDs[2] = { OWL_NULL_DEVICE, OWL_NULL_DEVICE };
+  OWLContext owl = owlContextCreate(deviceIDs,2);
+  APIContext::SP context = ((APIHandle *)owl)->getContext();
+  CachingAllocator::SP pools[2];
+  for (int d=0;d<2;d++) {
+    pools[d] = std::dynamic_pointer_cast<CachingAllocator>
+      (context->getDevice(d)->allocator);
+    CHECK(pools[d]);
+  }
+
+  OWLModule module = owlModuleCreate(owl,dummyPTX);
+  OWLVarDecl trianglesGeomVars[] = {
+    { "vertex", OWL_BUFPTR, OWL_OFFSETOF(TrianglesGeomData,vertex)},
+    { "index",  OWL_BUFPTR, OWL_OFFSETOF(TrianglesGeomData,index)},
+    { /* sentinel to mark end of list */ }
+  };
+  OWLGeomType trianglesGeomType
+    = owlGeomTypeCreate(owl,OWL_TRIANGLES,sizeof(TrianglesGeomData),
+                        trianglesGeomVars,-1);
+  owlGeomTypeSetClosestHit(trianglesGeomType,0,module,"TriangleMesh");
+  OWLGeom geom = createSoup(owl,trianglesGeomType,2000,1);
+  OWLGroup meshGroup = owlTrianglesGeomGroupCreate(owl,1,&geom);
+  OWLGroup world = owlInstanceGroupCreate(owl,1,&meshGroup);
+  OWLVarDecl rayGenVars[] = {
+    { "world", OWL_GROUP, OWL_OFFSETOF(RayGenData,world)},
+    { /* sentinel to mark end of list */ }
+  };
+  OWLRayGen rayGen
+    = owlRayGenCreate(owl,module,"simpleRayGen",
+                      sizeof(RayGenData),rayGenVars,-1);
+  owlRayGenSetGroup(rayGen,"world",world);
+  owlBuildPrograms(owl);
+  owlBuildPipeline(owl);
+
+  owlGroupBuildAccel(meshGroup);
+  owlGroupBuildAccel(world);
+  owlBuildSBT(owl);
+  size_t hitsBefore[2];
+  for (int d=0;d<2;d++) {
+    hitsBefore[d] = pools[d]->getStats().numHits;
+    // the accel temp memory is back in the cache
+    CHECK(pools[d]->getStats().bytesCached > 0);
+  }
+
+  // rebuilding allocates the same sizes again; all of that now comes
+  // from the pool
+  const int numRebuilds = 5;
+  for (int i=0;i<numRebuilds;i++) {
+    owlGroupBuildAccel(meshGroup);
+    owlGroupBuildAccel(world);
+    owlBuildSBT(owl);
+  }
+  for (int d=0;d<2;d++) {
+    const CachingAllocatorStats stats = pools[d]->getStats();
+    CHECK(stats.numHits >= hitsBefore[d]+numRebuilds*3);
+    // ... and the tracker still only sees what's actually in use;
+    // of which only accel and SBT memory is pooled
+    size_t accel = 0, accelTemp = 0, sbt = 0;
+    owlContextGetMemoryUsage(owl,d,OWL_MEMORY_ACCEL,&accel,nullptr);
+    owlContextGetMemoryUsage(owl,d,OWL_MEMORY_ACCEL_TEMP,&accelTemp,nullptr);
+    owlContextGetMemoryUsage(owl,d,OWL_MEMORY_SBT,&sbt,nullptr);
+    CHECK(accelTemp == 0);
+    CHECK(accel+sbt == stats.bytesRequested);
+  }
+  const std::string report = context->memoryReportJSON();
+  CHECK(contains(report,"\"pools\":[") && contains(report,"\"hitRate\":"));
+
+  // budgets are on what the pool actually holds: rounded up to size
+  // classes, and cached
+  MemoryTracker &tracker = context->getDevice(0)->memoryTracker;
+  const CachingAllocatorStats stats = pools[0]->getStats();
+  CHECK(tracker.reserved()
+        == tracker.current(OWL_MEMORY_ALL)-stats.bytesRequested+stats.bytesInUse);
+  const size_t cached = stats.bytesCached;
+  CHECK(cached > 4000);
+  // a 4000 byte buffer (which, not being pooled, takes exactly that)
+  // only fits once the cache is released
+  const size_t budget = tracker.reserved()+4000+cached-1;
+  owlContextSetMemoryBudget(owl,0,budget);
+  OWLBuffer buffer = owlDeviceBufferCreate(owl,OWL_FLOAT,1000,nullptr);
+  CHECK(pools[0]->getStats().bytesCached == 0);
+  // buffers don't come from the pool, as an async launch may still
+  // read them after they got freed
+  CHECK(pools[0]->getStats().bytesRequested == stats.bytesRequested);
+  CHECK(tracker.reserved() == tracker.current(OWL_MEMORY_ALL)
+        -stats.bytesRequested+stats.bytesInUse);
+  CHECK(pools[1]->getStats().bytesCached > 0);
+  CHECK(tracker.reserved() <= budget);
+  // what won't fit even without the cache still fails
+  bool threw = false;
+  try {
+    owlDeviceBufferCreate(owl,OWL_FLOAT,cached/4,nullptr);
+  } catch (const std::runtime_error &e) {
+    threw = contains(e.what(),"memory budget");
+  }
+  CHECK(threw);
+  owlBufferRelease(buffer);
+  owlContextSetMemoryBudget(owl,0,0);
+
+  owlContextReleaseCachedMemory(owl);
+  for (int d=0;d<2;d++)
+    CHECK(pools[d]->getStats().bytesCached == 0);
+
+  owlContextSetMemoryCacheSize(owl,0);
+  owlGroupBuildAccel(meshGroup);
+  owlBuildSBT(owl);
+  for (int d=0;d<2;d++)
+    CHECK(pools[d]->getStats().bytesCached == 0);
+
+  owlContextDestroy(owl);
+  LOG_OK("accel and SBT rebuilds passed");
+}
+
+// ------------------------------------------------------------------
+// benchmark
+// ------------------------------------------------------------------
+
+/*! time for 'numBuilds' rounds of what an accel rebuild and an SBT
+    rebuild allocate and free */
+double timeRebuilds(DeviceAllocator *allocator, int numBuilds)
+{
+  Random random(0x50);
+  void *bvh = nullptr;
+  void *hitGroupRecords = nullptr;
+  const double t0 = getCurrentTime();
+  for (int i=0;i<numBuilds;i++) {
+    // the geometry changes a bit from frame to frame, and so do the
+    // sizes
+    const size_t tempSize   = random.size(30<<20,32<<20);
+    const size_t outputSize = random.size(60<<20,64<<20);
+    void *temp         = allocator->allocate(tempSize);
+    void *output       = allocator->allocate(outputSize);
+    void *compactedSize = allocator->allocate(sizeof(uint64_t));
+    allocator->free(bvh);
+    bvh = allocator->allocate(outputSize/2);
+    allocator->free(output);
+    allocator->free(temp);
+    allocator->free(compactedSize);
+    allocator->free(hitGroupRecords);
+    hitGroupRecords = allocator->allocate(random.size(60000,64000));
+  }
+  const double t1 = getCurrentTime();
+  allocator->free(bvh);
+  allocator->free(hitGroupRecords);
+  return t1-t0;
+}
+
+void benchmark()
+{
+  const double latency = 10e-6;
+  LOG("measuring accel+SBT rebuilds, with " << prettyDouble(latency)
+      << "s per backing alloc/free");
+  const int numBuilds = 2000;
+  FakeAllocator::SP backing
+    = std::make_shared<FakeAllocator>(size_t(1)<<40,latency);
+  const double direct = timeRebuilds(backing.get(),numBuilds);
+  CHECK(backing->live.empty());
+  const size_t directCalls = backing->numAllocs+backing->numFrees;
+
+  backing->numAllocs = backing->numFrees = 0;
+  CachingAllocator::SP pool = createPool(backing);
+  const double pooled = timeRebuilds(pool.get(),numBuilds);
+  const size_t pooledCalls = backing->numAllocs+backing->numFrees;
+  const CachingAllocatorStats stats = pool->getStats();
+  CHECK(pooledCalls < directCalls/10);
+
+  char speedup[20], hitRate[20];
+  snprintf(speedup,sizeof(speedup),"%.2fx",direct/pooled);
+  snprintf(hitRate,sizeof(hitRate),"%.2f",stats.hitRate());
+  LOG_OK(numBuilds << " rebuilds: " << prettyDouble(direct) << "s direct ("
+         << directCalls << " backing calls), "
+         << prettyDouble(pooled) << "s pooled (" << pooledCalls
+         << " backing calls, hit rate " << hitRate << ", "
+         << prettyBytes(stats.peakBytesReserved) << "B reserved at peak): "
+         << speedup << " faster");
+}
+
+int main(int ac, char **av)
+{
+  testSizeClasses();
+  testReuse();
+  testCacheLimit();
+  testPressure();
+  testStress();
+  testContext();
+  benchmark();
+  LOG_OK("all tests passed");
+  return 0;
+}